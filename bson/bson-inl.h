@@ -68,17 +68,14 @@ namespace mongo {
             if( r.type() == NumberLong ) {
                 long long L = l._numberLong();
                 long long R = r._numberLong();
-                if( L < R ) return -1;
-                if( L == R ) return 0;
-                return 1;
+                return (L > R) - (L < R); // branch-free -1/0/1
             }
             goto dodouble;
         case NumberInt:
             if( r.type() == NumberInt ) {
                 int L = l._numberInt();
                 int R = r._numberInt();
-                if( L < R ) return -1;
-                return L == R ? 0 : 1;
+                return (L > R) - (L < R);
             }
             // else fall through
         case NumberDouble: 
@@ -155,18 +152,20 @@ dodouble:
     */
     inline int BSONElement::woCompare( const BSONElement &e,
                                 bool considerFieldName ) const {
-        int lt = (int) canonicalType();
-        int rt = (int) e.canonicalType();
-        int x = lt - rt;
-        if( x != 0 && (!isNumber() || !e.isNumber()) )
-            return x;
+        if ( type() != e.type() ) {
+            // only the numeric types compare by value across type boundaries
+            int lt = (int) canonicalType();
+            int rt = (int) e.canonicalType();
+            int x = lt - rt;
+            if( x != 0 && (!isNumber() || !e.isNumber()) )
+                return x;
+        }
         if ( considerFieldName ) {
-            x = strcmp(fieldName(), e.fieldName());
+            int x = strcmp(fieldName(), e.fieldName());
             if ( x != 0 )
                 return x;
         }
-        x = compareElementValues(*this, e);
-        return x;
+        return compareElementValues(*this, e);
     }
 
     inline BSONObjIterator BSONObj::begin() const {
@@ -264,10 +263,15 @@ dodouble:
     }
 
     inline BSONElement BSONObj::getField(const StringData& name) const {
+        // only the first name.size() bytes of name are examined, so callers may
+        // pass a non-terminated slice (one component of a dotted path).  the
+        // element's field name length is cached from the size computation, so
+        // mismatched lengths are rejected without touching the characters.
         BSONObjIterator i(*this);
         while ( i.more() ) {
             BSONElement e = i.next();
-            if ( strcmp(e.fieldName(), name.data()) == 0 )
+            if ( (unsigned) e.fieldNameSize() == name.size() + 1 &&
+                 memcmp( e.fieldName(), name.data(), name.size() ) == 0 )
                 return e;
         }
         return BSONElement();
@@ -779,8 +783,7 @@ dodouble:
         if ( e.eoo() ) {
             const char *p = strchr(name, '.');
             if ( p ) {
-                string left(name, p-name);
-                BSONObj sub = getObjectField(left.c_str());
+                BSONObj sub = getObjectField( StringData( name, p - name ) );
                 return sub.isEmpty() ? BSONElement() : sub.getFieldDotted(p+1);
             }
         }
@@ -788,7 +791,7 @@ dodouble:
         return e;
     }
 
-    inline BSONObj BSONObj::getObjectField(const char *name) const {
+    inline BSONObj BSONObj::getObjectField(const StringData& name) const {
         BSONElement e = getField(name);
         BSONType t = e.type();
         return t == Object || t == Array ? e.embeddedObject() : BSONObj();
@@ -143,6 +143,15 @@ namespace mongo {
             return data + 1;
         }
 
+        /** number of bytes in the field name, including the terminating null
+            (i.e. strlen(fieldName()) + 1).  cached, so cheaper than a strlen
+            once the element's size has been computed. */
+        int fieldNameSize() const {
+            if ( fieldNameSize_ == -1 )
+                fieldNameSize_ = (int)strlen( fieldName() ) + 1;
+            return fieldNameSize_;
+        }
+
         /** raw data of the element's value (so be careful). */
         const char * value() const {
             return (data + fieldNameSize() + 1);
@@ -412,11 +421,6 @@ namespace mongo {
     private:
         const char *data;
         mutable int fieldNameSize_; // cached value
-        int fieldNameSize() const {
-            if ( fieldNameSize_ == -1 )
-                fieldNameSize_ = (int)strlen( fieldName() ) + 1;
-            return fieldNameSize_;
-        }
         mutable int totalSize; /* caches the computed size */
 
         friend class BSONObjIterator;
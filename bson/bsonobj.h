@@ -30,6 +30,8 @@ namespace mongo {
     typedef set< BSONElement, BSONElementCmpWithoutField > BSONElementSet;
     typedef multiset< BSONElement, BSONElementCmpWithoutField > BSONElementMSet;
 
+    class BSONObjFieldIndex; // bsonobjiterator.h
+
     /**
        C++ representation of a "BSON" object -- that is, an extended JSON-style
        object in a binary representation.
@@ -177,9 +179,12 @@ namespace mongo {
         /** Like getFieldDotted(), but expands arrays and returns all matching objects.
          *  Turning off expandLastArray allows you to retrieve nested array objects instead of
          *  their contents.
+         *  topIndex, when supplied, is a field table for this object (see
+         *  BSONObjFieldIndex) used for the top level lookups, so a caller resolving
+         *  many paths against the same document scans it only once.
          */
-        void getFieldsDotted(const StringData& name, BSONElementSet &ret, bool expandLastArray = true ) const;
-        void getFieldsDotted(const StringData& name, BSONElementMSet &ret, bool expandLastArray = true ) const;
+        void getFieldsDotted(const StringData& name, BSONElementSet &ret, bool expandLastArray = true , BSONObjFieldIndex *topIndex = 0 ) const;
+        void getFieldsDotted(const StringData& name, BSONElementMSet &ret, bool expandLastArray = true , BSONObjFieldIndex *topIndex = 0 ) const;
 
         /** Like getFieldDotted(), but returns first array encountered while traversing the
             dotted fields of name.  The name variable is updated to represent field
@@ -188,6 +193,8 @@ namespace mongo {
 
         /** Get the field of the specified name. eoo() is true on the returned
             element if not found.
+            only the first name.size() bytes are examined, so a non-terminated
+            slice of a dotted path may be passed (see stringdata.h).
         */
         BSONElement getField(const StringData& name) const;
 
@@ -214,7 +221,7 @@ namespace mongo {
             StringBuilder ss;
             ss << field;
             string s = ss.str();
-            return getField(s.c_str());
+            return getField(s);
         }
 
         /** @return true if field exists */
@@ -226,7 +233,7 @@ namespace mongo {
         const char * getStringField(const char *name) const;
 
         /** @return subobject of the given name */
-        BSONObj getObjectField(const char *name) const;
+        BSONObj getObjectField(const StringData& name) const;
 
         /** @return INT_MIN if not present - does some type conversions */
         int getIntField(const char *name) const;
@@ -391,7 +398,8 @@ namespace mongo {
             opELEM_MATCH = 0x12,
             opNEAR = 0x13,
             opWITHIN = 0x14,
-            opMAX_DISTANCE=0x15
+            opMAX_DISTANCE=0x15,
+            opTEXT = 0x16 // { x : { $text : "some words" } } - see db/text.cpp
         };
 
         /** add all elements of the object to the specified vector */
@@ -17,8 +17,11 @@
 
 #pragma once
 
+#include <algorithm> // for stable_sort
 #include <boost/preprocessor/cat.hpp> // like the ## operator but works with __LINE__
 
+#include "stringdata.h"
+
 namespace mongo {
 
     /** iterator for a BSONObj
@@ -109,6 +112,138 @@ namespace mongo {
         int _cur;
     };
 
+    /** lazily built field name -> element table for one BSONObj.
+
+        the first lookup walks the object once and records every top level
+        element sorted by field name; subsequent lookups are binary searches
+        instead of fresh linear scans.  entries carry a hash of their field
+        name so the searches compare integers and only fall back to a byte
+        compare on a hash match.  worthwhile when several different fields of
+        the same object will be fetched (compound index key extraction, for
+        example); for a single field a plain getField() is cheaper.  the
+        object must stay in scope: elements point into it.
+    */
+    class BSONObjFieldIndex {
+    public:
+        BSONObjFieldIndex( const BSONObj& o ) : _obj( o ), _built( false ) {}
+
+        /** same semantics as BSONObj::getField(): the first element with the
+            given field name, or an eoo element if there is none.  only the
+            first size() bytes of a StringData are examined, so a
+            non-terminated slice of a dotted path may be passed. */
+        BSONElement getField( const char* name ) {
+            return _find( name , strlen( name ) );
+        }
+        BSONElement getField( const string& name ) {
+            return _find( name.c_str() , name.size() );
+        }
+        BSONElement getField( const StringData& name ) {
+            return _find( name.data() , name.size() );
+        }
+
+        /** same semantics as BSONObj::getFieldDottedOrArray(), resolving the
+            first path component through the table */
+        BSONElement getFieldDottedOrArray( const char *&name ) {
+            const char *p = strchr( name , '.' );
+            BSONElement sub;
+            if ( p ) {
+                sub = _find( name , p - name );
+                name = p + 1;
+            }
+            else {
+                sub = _find( name , strlen( name ) );
+                name = name + strlen( name );
+            }
+            if ( sub.eoo() )
+                return BSONElement();
+            else if ( sub.type() == Array || name[0] == '\0' )
+                return sub;
+            else if ( sub.type() == Object )
+                return sub.embeddedObject().getFieldDottedOrArray( name );
+            return BSONElement();
+        }
+
+    private:
+        struct Entry {
+            unsigned hash;
+            BSONElement e;
+        };
+
+        /** hash of exactly len bytes of name.  identical names always hash
+            identically, so entries sorted by (hash, name) keep equal names
+            adjacent and most search comparisons are a single integer compare. */
+        static unsigned _hash( const char* name , unsigned len ) {
+            unsigned h = 0;
+            for ( unsigned i = 0; i < len; i++ )
+                h = h * 131 + (unsigned char)name[i];
+            return h;
+        }
+
+        /** @return 0 if the first len bytes of name equal fn and fn ends there */
+        static int _cmp( const char* name , unsigned len , const char* fn ) {
+            int x = strncmp( name , fn , len );
+            if ( x )
+                return x;
+            return fn[len] ? -1 : 0; // name is a strict prefix of fn: name sorts first
+        }
+
+        static int _cmp( unsigned h , const char* name , unsigned len , const Entry& entry ) {
+            if ( h != entry.hash )
+                return h < entry.hash ? -1 : 1;
+            return _cmp( name , len , entry.e.fieldName() );
+        }
+
+        BSONElement _find( const char* name , unsigned len ) {
+            if ( ! _built )
+                _build();
+            const unsigned h = _hash( name , len );
+            int lo = 0;
+            int hi = (int)_fields.size() - 1;
+            while ( lo <= hi ) {
+                int mid = ( lo + hi ) / 2;
+                int x = _cmp( h , name , len , _fields[mid] );
+                if ( x == 0 ) {
+                    // step back over duplicate names: as with getField() the
+                    // first occurrence in the document wins, and the stable
+                    // sort keeps document order within equal names
+                    while ( mid > 0 && _cmp( h , name , len , _fields[mid-1] ) == 0 )
+                        mid--;
+                    return _fields[mid].e;
+                }
+                if ( x < 0 )
+                    hi = mid - 1;
+                else
+                    lo = mid + 1;
+            }
+            return BSONElement();
+        }
+
+        void _build() {
+            BSONObjIterator i( _obj );
+            while ( i.more() ) {
+                Entry x;
+                x.e = i.next();
+                const char *fn = x.e.fieldName();
+                x.hash = _hash( fn , (unsigned)strlen( fn ) );
+                _fields.push_back( x );
+            }
+            std::stable_sort( _fields.begin() , _fields.end() , EntryCmp() );
+            _built = true;
+        }
+
+        struct EntryCmp {
+            bool operator()( const Entry& l , const Entry& r ) const {
+                if ( l.hash != r.hash )
+                    return l.hash < r.hash;
+                return strcmp( l.e.fieldName() , r.e.fieldName() ) < 0;
+            }
+        };
+
+        BSONObj _obj;
+        bool _built;
+        vector<Entry> _fields;
+    };
+
     /** transform a BSON array into a vector of BSONElements.
         we match array # positions with their vector position, and ignore
         any fields with non-numeric field names.
@@ -44,6 +44,11 @@ namespace mongo {
          * is already known. 'c' must be a pointer to a null-terminated string, and strlenOfc
          * must be the length that std::strlen(c) would return, a.k.a the index of the
          * terminator in c.
+         *
+         * Exception: a consumer that documents it only examines the first size() bytes
+         * (e.g. BSONObj::getField) may be handed a non-terminated slice, such as one
+         * component of a dotted path.  Such a StringData must not be passed on to
+         * anything that expects c_str() semantics.
          */
         StringData( const char* c, unsigned len )
             : _data(c), _size(len) {}
@@ -80,6 +80,18 @@ namespace mongo {
         char buf[SZ];
     };
 
+    /** hooks for operation-scoped scratch allocation.  the server points these at a
+        per-thread arena (see db/oparena.h); standalone users of bson leave them unset,
+        in which case builders constructed with UseOpScratch fall back to malloc. */
+    struct OpScratchHooks {
+        void* (*malloc_)(size_t);
+        void* (*realloc_)(void*, size_t);
+    };
+    inline OpScratchHooks& opScratchHooks() {
+        static OpScratchHooks hooks = { 0, 0 };
+        return hooks;
+    }
+
     template< class Allocator >
     class _BufBuilder {
         // non-copyable, non-assignable
@@ -87,22 +99,23 @@ namespace mongo {
         _BufBuilder& operator=( const _BufBuilder& );
         Allocator al;
     public:
-        _BufBuilder(int initsize = 512) : size(initsize) {
-            if ( size > 0 ) {
-                data = (char *) al.Malloc(size);
-                if( data == 0 )
-                    msgasserted(10000, "out of memory BufBuilder");
-            }
-            else {
-                data = 0;
-            }
-            l = 0;
+        /** tag for the op scratch constructor below */
+        struct UseOpScratch { };
+
+        _BufBuilder(int initsize = 512) : size(initsize), _opScratch(false) {
+            _init();
+        }
+        /** scratch variant: memory comes from the installed op-scratch hooks (a
+            per-operation arena on the server) and is never freed by this builder.
+            the buffer must not be decouple()d and must not outlive the operation. */
+        _BufBuilder(UseOpScratch, int initsize) : size(initsize), _opScratch(opScratchHooks().malloc_ != 0) {
+            _init();
         }
         ~_BufBuilder() { kill(); }
 
         void kill() {
             if ( data ) {
-                al.Free(data);
+                _free(data);
                 data = 0;
             }
         }
@@ -113,8 +126,8 @@ namespace mongo {
         void reset( int maxSize ) {
             l = 0;
             if ( maxSize && size > maxSize ) {
-                al.Free(data);
-                data = (char*)al.Malloc(maxSize);
+                _free(data);
+                data = (char*)_malloc(maxSize);
                 if ( data == 0 )
                     msgasserted( 15913 , "out of memory BufBuilder::reset" );
                 size = maxSize;
@@ -130,8 +143,16 @@ namespace mongo {
         char* buf() { return data; }
         const char* buf() const { return data; }
 
-        /* assume ownership of the buffer - you must then free() it */
-        void decouple() { data = 0; }
+        /* assume ownership of the buffer - you must then free() it.
+           not legal for op-scratch builders; the arena owns their memory. */
+        void decouple() {
+            if ( _opScratch )
+                msgasserted(16232, "can't decouple an op scratch BufBuilder");
+            data = 0;
+        }
+
+        /** @return true if this builder draws from the per-operation scratch arena */
+        bool opScratch() const { return _opScratch; }
 
         void appendUChar(unsigned char j) {
             *((unsigned char*)grow(sizeof(unsigned char))) = j;
@@ -195,6 +216,25 @@ namespace mongo {
         }
 
     private:
+        void _init() {
+            if ( size > 0 ) {
+                data = (char *) _malloc(size);
+                if( data == 0 )
+                    msgasserted(10000, "out of memory BufBuilder");
+            }
+            else {
+                data = 0;
+            }
+            l = 0;
+        }
+
+        void* _malloc(size_t sz) { return _opScratch ? opScratchHooks().malloc_(sz) : al.Malloc(sz); }
+        void* _realloc(void *p, size_t sz) { return _opScratch ? opScratchHooks().realloc_(p, sz) : al.Realloc(p, sz); }
+        void _free(void *p) {
+            if( !_opScratch )
+                al.Free(p);
+        }
+
         /* "slow" portion of 'grow()'  */
         void NOINLINE_DECL grow_reallocate() {
             int a = size * 2;
@@ -204,13 +244,14 @@ namespace mongo {
                 a = l + 16 * 1024;
             if ( a > BufferMaxSize )
                 msgasserted(13548, "BufBuilder grow() > 64MB");
-            data = (char *) al.Realloc(data, a);
+            data = (char *) _realloc(data, a);
             size= a;
         }
 
         char *data;
         int l;
         int size;
+        bool _opScratch;
 
         friend class StringBuilder;
     };
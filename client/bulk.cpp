@@ -0,0 +1,141 @@
+// @file bulk.cpp
+
+/*    Copyright 2011 10gen Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "pch.h"
+#include "bulk.h"
+
+namespace mongo {
+
+    BulkOperationBuilder::BulkOperationBuilder( DBClientBase& conn , const string& ns , int insertFlags )
+        : _conn( conn ) ,
+          _pipeline( dynamic_cast<DBClientConnection*>( &conn ) ) ,
+          _ns( ns ) ,
+          _insertFlags( insertFlags ) ,
+          _batchOps( 0 ) ,
+          _batchBytes( 0 ) ,
+          _executed( 0 ) {
+    }
+
+    BulkOperationBuilder::~BulkOperationBuilder() {
+        if ( _batchOps == 0 )
+            return;
+        try {
+            _dispatch();
+        }
+        catch ( std::exception& e ) {
+            // never throw from a destructor; the writes are lost
+            log() << "exception dispatching remaining bulk operations for " << _ns
+                  << ": " << e.what() << endl;
+        }
+    }
+
+    void BulkOperationBuilder::insert( const BSONObj& obj ) {
+        if ( _pipeline ) {
+            _pipeline->pipelineInsert( _ns , obj , _insertFlags );
+        }
+        else {
+            // the object may point into a caller-owned buffer that's reused
+            // before the buffered message goes out
+            _insertBuf.push_back( obj.getOwned() );
+        }
+        _accounted( obj.objsize() );
+    }
+
+    void BulkOperationBuilder::update( const Query& query , const BSONObj& obj , bool upsert , bool multi ) {
+        if ( _pipeline ) {
+            _pipeline->pipelineUpdate( _ns , query , obj , upsert , multi );
+        }
+        else {
+            // can't coalesce an update into an insert message; send the buffered
+            // inserts first so the queued order is preserved on the server
+            if ( _insertBuf.size() ) {
+                _conn.insert( _ns , _insertBuf , _insertFlags );
+                _insertBuf.clear();
+            }
+            _conn.update( _ns , query , obj , upsert , multi );
+        }
+        _accounted( query.obj.objsize() + obj.objsize() );
+    }
+
+    void BulkOperationBuilder::remove( const Query& query , bool justOne ) {
+        if ( _pipeline ) {
+            _pipeline->pipelineRemove( _ns , query , justOne );
+        }
+        else {
+            if ( _insertBuf.size() ) {
+                _conn.insert( _ns , _insertBuf , _insertFlags );
+                _insertBuf.clear();
+            }
+            _conn.remove( _ns , query , justOne );
+        }
+        _accounted( query.obj.objsize() );
+    }
+
+    void BulkOperationBuilder::_accounted( int bytes ) {
+        _batchOps++;
+        _batchBytes += bytes;
+        if ( _batchOps >= MaxBatchOperations || _batchBytes >= MaxBatchBytes )
+            _dispatch();
+    }
+
+    void BulkOperationBuilder::_dispatch() {
+        if ( _batchOps == 0 )
+            return;
+
+        string err;
+        if ( _pipeline ) {
+            BSONObj res = _pipeline->pipelineFlush();
+            if ( res["batchErr"].type() == String )
+                err = res["batchErr"].String();
+        }
+        else {
+            if ( _insertBuf.size() ) {
+                _conn.insert( _ns , _insertBuf , _insertFlags );
+                _insertBuf.clear();
+            }
+            err = _conn.getLastError();
+        }
+
+        if ( err.size() && _firstErr.empty() )
+            _firstErr = err;
+
+        _executed += _batchOps;
+        _batchOps = 0;
+        _batchBytes = 0;
+    }
+
+    int BulkOperationBuilder::execute( string* err , int w , int wtimeout ) {
+        _dispatch();
+
+        // the per-sub-batch round trips used the default write concern; an
+        // explicit w covers everything dispatched on this connection so far
+        if ( w > 1 ) {
+            string e = _conn.getLastError( false , false , w , wtimeout );
+            if ( e.size() && _firstErr.empty() )
+                _firstErr = e;
+        }
+
+        if ( err )
+            *err = _firstErr;
+
+        int n = _executed;
+        _executed = 0;
+        _firstErr.clear();
+        return n;
+    }
+
+}  // namespace mongo
@@ -0,0 +1,94 @@
+// @file bulk.h
+
+/*    Copyright 2011 10gen Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include "dbclient.h"
+
+namespace mongo {
+
+    /** Queues inserts, updates and removes against one namespace and dispatches
+        them in sub-batches: writes stream out without waiting, and one
+        getLastError round trip covers each sub-batch instead of one per write.
+        Sub-batches split automatically at MaxBatchOperations operations or
+        MaxBatchBytes of queued data, so callers can feed arbitrarily large jobs
+        without tripping the wire message size limit.
+
+        Operations are dispatched in the order they were queued.  On a plain
+        DBClientConnection the pipelined write path is used; on other connection
+        types (replica sets, mongos) inserts still coalesce into multi-object
+        insert messages and the per-sub-batch round trip applies the same way.
+
+        Dispatch continues past a failed sub-batch - as with ContinueOnError,
+        one bad document shouldn't discard the rest of the job.  execute()
+        reports the first error seen; call it once at the end (it also flushes
+        whatever is still queued).
+
+            BulkOperationBuilder bulk( conn , "test.foo" );
+            for ( ... )
+                bulk.insert( obj );
+            string err;
+            bulk.execute( &err );
+    */
+    class BulkOperationBuilder : boost::noncopyable {
+    public:
+        static const int MaxBatchOperations = 1000;
+        static const int MaxBatchBytes = 4 * 1024 * 1024;
+
+        /** @param insertFlags passed through to every insert message, e.g.
+                   InsertOption_ContinueOnError */
+        BulkOperationBuilder( DBClientBase& conn , const string& ns , int insertFlags = 0 );
+
+        /** anything not covered by an execute() is still dispatched, but errors
+            from the final sub-batch go unobserved - call execute() instead. */
+        ~BulkOperationBuilder();
+
+        void insert( const BSONObj& obj );
+        void update( const Query& query , const BSONObj& obj , bool upsert = false , bool multi = false );
+        void remove( const Query& query , bool justOne = false );
+
+        /** dispatch anything still queued and wait for the last sub-batch.
+            @param err set to the first error seen across sub-batches since the
+                   last execute(), or cleared if there was none
+            @param w as getLastError(); the per-sub-batch round trips already
+                   performed used the default write concern
+            @return number of operations dispatched since the last execute() */
+        int execute( string* err = 0 , int w = 0 , int wtimeout = 0 );
+
+        /** operations queued and not yet covered by a round trip */
+        int pending() const { return _batchOps; }
+
+    private:
+        /** send the queued sub-batch and run its getLastError round trip */
+        void _dispatch();
+
+        /** note an op of the given wire size queued; splits when limits hit */
+        void _accounted( int bytes );
+
+        DBClientBase& _conn;
+        DBClientConnection* _pipeline; // non-NULL when _conn supports pipelined writes
+        const string _ns;
+        const int _insertFlags;
+
+        vector<BSONObj> _insertBuf;  // generic path only; pipelined path queues in _pipeline
+        int _batchOps;               // ops in the current sub-batch
+        int _batchBytes;             // their approximate wire size
+        int _executed;               // ops dispatched since the last execute()
+        string _firstErr;            // first error seen since the last execute()
+    };
+
+}  // namespace mongo
@@ -84,6 +84,23 @@ namespace mongo {
         }
     }
 
+    void PoolForHost::getIdleConnections( time_t now , int idleSecs , vector<StoredConnection>& idle ) {
+        vector<StoredConnection> all;
+        while ( ! _pool.empty() ) {
+            StoredConnection c = _pool.top();
+            _pool.pop();
+
+            if ( ( now - c.when ) > idleSecs )
+                idle.push_back( c );
+            else
+                all.push_back( c );
+        }
+
+        for ( size_t i=0; i<all.size(); i++ ) {
+            _pool.push( all[i] );
+        }
+    }
+
     void PoolForHost::getStaleConnections( vector<DBClientBase*>& stale ) {
         time_t now = time(0);
 
@@ -126,10 +143,50 @@ namespace mongo {
 
     DBConnectionPool pool;
 
-    DBConnectionPool::DBConnectionPool() 
-        : _mutex("DBConnectionPool") , 
-          _name( "dbconnectionpool" ) , 
-          _hooks( new list<DBConnectionHook*>() ) { 
+    DBConnectionPool::DBConnectionPool()
+        : _mutex("DBConnectionPool") ,
+          _name( "dbconnectionpool" ) ,
+          _targetAvail( 0 ) ,
+          _hooks( new list<DBConnectionHook*>() ) {
+    }
+
+    // ------ host health ------
+
+    void DBConnectionPool::_noteGood( const string& ident ) {
+        scoped_lock L(_mutex);
+        _health.erase( ident );
+    }
+
+    void DBConnectionPool::_noteBad( const string& ident ) {
+        scoped_lock L(_mutex);
+        HostHealth& h = _health[ident];
+        h.failures++;
+        h.lastFailAt = time(0);
+    }
+
+    bool DBConnectionPool::_isDown_inlock( const string& ident , time_t now ) const {
+        HealthMap::const_iterator i = _health.find( ident );
+        if ( i == _health.end() )
+            return false;
+
+        const HostHealth& h = i->second;
+        if ( h.failures < 2 )
+            return false; // one failure could be anything; don't punish yet
+
+        // back off 5s per consecutive failure, capped at 30s.  when the window
+        // expires a single caller (or the background task) pays for the retry;
+        // everyone else keeps failing fast until it succeeds.
+        int window = h.failures < 6 ? h.failures * 5 : 30;
+        return ( now - h.lastFailAt ) < window;
+    }
+
+    void DBConnectionPool::_checkNotDown( const string& ident ) {
+        scoped_lock L(_mutex);
+        if ( _isDown_inlock( ident , time(0) ) ) {
+            throw SocketException( SocketException::CONNECT_ERROR , ident , 11002 ,
+                                   str::stream() << _name << " error: " << ident
+                                                 << " is known down, failing fast" );
+        }
     }
 
     DBClientBase* DBConnectionPool::_get(const string& ident , double socketTimeout ) {
@@ -144,8 +201,9 @@ namespace mongo {
             scoped_lock L(_mutex);
             PoolForHost& p = _pools[PoolKey(host,socketTimeout)];
             p.createdOne( conn );
+            _health.erase( host ); // a successful connect clears the host's bad marks
         }
-        
+
         try {
             onCreate( conn );
             onHandedOut( conn );
@@ -171,8 +229,12 @@ namespace mongo {
             return c;
         }
 
+        _checkNotDown( url.toString() );
+
         string errmsg;
         c = url.connect( errmsg, socketTimeout );
+        if ( ! c )
+            _noteBad( url.toString() );
         uassert( 13328 ,  _name + ": connect failed " + url.toString() + " : " + errmsg , c );
 
         return _finishCreate( url.toString() , socketTimeout , c );
@@ -195,9 +257,13 @@ namespace mongo {
         ConnectionString cs = ConnectionString::parse( host , errmsg );
         uassert( 13071 , (string)"invalid hostname [" + host + "]" + errmsg , cs.isValid() );
 
+        _checkNotDown( host );
+
         c = cs.connect( errmsg, socketTimeout );
-        if ( ! c )
+        if ( ! c ) {
+            _noteBad( host );
             throw SocketException( SocketException::CONNECT_ERROR , host , 11002 , str::stream() << _name << " error: " << errmsg );
+        }
         return _finishCreate( host , socketTimeout , c );
     }
 
@@ -277,6 +343,8 @@ namespace mongo {
                 BSONObjBuilder temp( bb.subobjStart( s ) );
                 temp.append( "available" , i->second.numAvailable() );
                 temp.appendNumber( "created" , i->second.numCreated() );
+                if ( _isDown_inlock( i->first.ident , time(0) ) )
+                    temp.appendBool( "down" , true );
                 temp.done();
 
                 avail += i->second.numAvailable();
@@ -361,15 +429,39 @@ namespace mongo {
     }
 
 
-    void DBConnectionPool::taskDoWork() { 
+    void DBConnectionPool::taskDoWork() {
+        if ( inShutdown() )
+            return;
+
+        const int validateIdleSecs = 60;
+
         vector<DBClientBase*> toDelete;
-        
+        vector< pair<PoolKey,PoolForHost::StoredConnection> > toValidate;
+        vector< pair<PoolKey,int> > toWarm; // pool , how many connections short
+
+        time_t now = time(0);
+
         {
             // we need to get the connections inside the lock
-            // but we can actually delete them outside
+            // but we can actually delete and ping them outside
             scoped_lock lk( _mutex );
             for ( PoolMap::iterator i=_pools.begin(); i!=_pools.end(); ++i ) {
                 i->second.getStaleConnections( toDelete );
+
+                vector<PoolForHost::StoredConnection> idle;
+                i->second.getIdleConnections( now , validateIdleSecs , idle );
+                for ( size_t j=0; j<idle.size(); j++ )
+                    toValidate.push_back( make_pair( i->first , idle[j] ) );
+
+                if ( _targetAvail > 0 &&
+                     i->second.numCreated() > 0 &&
+                     ! _isDown_inlock( i->first.ident , now ) ) {
+                    // connections out for validation come back below, so they
+                    // still count toward the watermark
+                    int deficit = (int)_targetAvail - i->second.numAvailable() - (int)idle.size();
+                    if ( deficit > 0 )
+                        toWarm.push_back( make_pair( i->first , deficit ) );
+                }
             }
         }
 
@@ -382,6 +474,71 @@ namespace mongo {
                 // we don't care if there was a socket error
             }
         }
+
+        // revalidate idle connections with a ping so a dead server is noticed
+        // here, once, instead of by every thread that draws a bad socket
+        for ( size_t i=0; i<toValidate.size(); i++ ) {
+            const PoolKey& key = toValidate[i].first;
+            PoolForHost::StoredConnection& sc = toValidate[i].second;
+
+            bool ok = false;
+            try {
+                ok = sc.conn->simpleCommand( "admin" , 0 , "ping" ) && ! sc.conn->isFailed();
+            }
+            catch ( ... ) {
+                ok = false;
+            }
+
+            if ( ok ) {
+                scoped_lock lk( _mutex );
+                _pools[key].restore( sc );
+            }
+            else {
+                log() << _name << " dropping idle connection to " << key.ident
+                      << " that failed validation" << endl;
+                _noteBad( key.ident );
+                try {
+                    onDestroy( sc.conn );
+                    delete sc.conn;
+                }
+                catch ( ... ) {
+                }
+            }
+        }
+
+        // top pools up to the warm watermark so post-restart / post-trim
+        // requests find an established connection waiting
+        for ( size_t i=0; i<toWarm.size(); i++ ) {
+            const PoolKey& key = toWarm[i].first;
+            for ( int j=0; j<toWarm[i].second; j++ ) {
+                try {
+                    string errmsg;
+                    ConnectionString cs = ConnectionString::parse( key.ident , errmsg );
+                    if ( ! cs.isValid() )
+                        break;
+
+                    DBClientBase * c = cs.connect( errmsg , key.timeout );
+                    if ( ! c ) {
+                        _noteBad( key.ident );
+                        break;
+                    }
+
+                    {
+                        scoped_lock lk( _mutex );
+                        _pools[key].createdOne( c );
+                        _health.erase( key.ident );
+                    }
+                    onCreate( c ); // but not onHandedOut: nobody has it yet
+                    release( key.ident , c );
+                }
+                catch ( std::exception& e ) {
+                    log() << _name << " warm-up connect to " << key.ident
+                          << " failed: " << e.what() << endl;
+                    _noteBad( key.ident );
+                    break;
+                }
+            }
+        }
     }
 
     // ------ ScopedDbConnection ------
@@ -34,6 +34,17 @@ namespace mongo {
      */
     class PoolForHost {
     public:
+
+        struct StoredConnection {
+            StoredConnection( DBClientBase * c );
+            StoredConnection( DBClientBase * c , time_t w ) : conn( c ) , when( w ) {}
+
+            bool ok( time_t now );
+
+            DBClientBase* conn;
+            time_t when; // pooled since; preserved across background validation
+        };
+
         PoolForHost()
             : _created(0) {}
 
@@ -60,22 +71,22 @@ namespace mongo {
         void done( DBConnectionPool * pool , DBClientBase * c );
 
         void flush();
-        
+
         void getStaleConnections( vector<DBClientBase*>& stale );
 
+        /**
+         * pops connections idle for more than idleSecs so the background task
+         * can validate them outside the pool lock; put them back with restore()
+         * so their pooled-since time (and thus the stale cull) is preserved
+         */
+        void getIdleConnections( time_t now , int idleSecs , vector<StoredConnection>& idle );
+
+        void restore( const StoredConnection& sc ) { _pool.push( sc ); }
+
         static void setMaxPerHost( unsigned max ) { _maxPerHost = max; }
         static unsigned getMaxPerHost() { return _maxPerHost; }
     private:
 
-        struct StoredConnection {
-            StoredConnection( DBClientBase * c );
-
-            bool ok( time_t now );
-
-            DBClientBase* conn;
-            time_t when;
-        };
-
         std::stack<StoredConnection> _pool;
         
         long long _created;
@@ -117,6 +128,12 @@ namespace mongo {
         /** right now just controls some asserts.  defaults to "dbconnectionpool" */
         void setName( const string& name ) { _name = name; }
 
+        /** keep this many pre-established connections available per host; the
+            background task tops pools up to the watermark so the first requests
+            after a restart or a trim don't each pay connect latency.  0 (the
+            default) disables warm-up. */
+        void setTargetAvailable( unsigned n ) { _targetAvail = n; }
+
         void onCreate( DBClientBase * conn );
         void onHandedOut( DBClientBase * conn );
         void onDestroy( DBClientBase * conn );
@@ -137,15 +154,35 @@ namespace mongo {
         };
 
         virtual string taskName() const { return "DBConnectionPool-cleaner"; }
-        virtual void taskDoWork();        
+
+        /** background maintenance: culls stale connections, revalidates idle
+            ones with a ping, and tops pools up to the warm watermark */
+        virtual void taskDoWork();
 
     private:
         DBConnectionPool( DBConnectionPool& p );
-        
+
         DBClientBase* _get( const string& ident , double socketTimeout );
 
         DBClientBase* _finishCreate( const string& ident , double socketTimeout, DBClientBase* conn );
-        
+
+        /** consecutive connect/validation failures against one host, shared by
+            all threads so a dead host is discovered once, not once per thread */
+        struct HostHealth {
+            HostHealth() : failures(0) , lastFailAt(0) {}
+            int failures;
+            time_t lastFailAt;
+        };
+
+        void _noteGood( const string& ident );
+        void _noteBad( const string& ident );
+
+        /** true while the host is in its fail-fast window */
+        bool _isDown_inlock( const string& ident , time_t now ) const;
+
+        /** throws the same way a failed connect would, without paying for one */
+        void _checkNotDown( const string& ident );
+
         struct PoolKey {
             PoolKey( string i , double t ) : ident( i ) , timeout( t ) {}
             string ident;
@@ -157,11 +194,14 @@ namespace mongo {
         };
 
         typedef map<PoolKey,PoolForHost,poolKeyCompare> PoolMap; // servername -> pool
+        typedef map<string,HostHealth,serverNameCompare> HealthMap;
 
         mongo::mutex _mutex;
         string _name;
-        
+
         PoolMap _pools;
+        HealthMap _health;
+        unsigned _targetAvail;
 
         // pointers owned by me, right now they leak on shutdown
         // _hooks itself also leaks because it creates a shutdown race condition
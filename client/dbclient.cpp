@@ -617,6 +617,12 @@ namespace mongo {
         }
 #endif
 
+        if ( cmdLine.networkCompression ) {
+            // we initiate, so we opt in; the server starts compressing once it sees
+            // compressed traffic from us
+            p->setCompression( true );
+        }
+
         return true;
     }
 
@@ -736,24 +742,66 @@ namespace mongo {
             /* connection CANNOT be used anymore as more data may be on the way from the server.
                we have to reconnect.
                */
-            _failed = true;
-            p->shutdown();
+            shutdown();
             throw;
         }
 
         return n;
     }
 
-    void DBClientBase::insert( const string & ns , BSONObj obj , int flags) {
-        Message toSend;
+    void DBClientConnection::shutdown() {
+        _failed = true;
+        if ( p )
+            p->shutdown();
+    }
 
-        BufBuilder b;
-        b.appendNum( flags );
-        b.appendStr( ns );
-        obj.appendSelfToBufBuilder( b );
+    namespace {
+        // build the wire form of a write message; shared by the plain
+        // fire-and-forget paths below and the pipelined write paths in
+        // DBClientConnection
+
+        void assembleInsert( Message& toSend , const string& ns , const BSONObj& obj , int flags ) {
+            BufBuilder b;
+            b.appendNum( flags );
+            b.appendStr( ns );
+            obj.appendSelfToBufBuilder( b );
+            toSend.setData( dbInsert , b.buf() , b.len() );
+        }
 
-        toSend.setData( dbInsert , b.buf() , b.len() );
+        void assembleRemove( Message& toSend , const string& ns , const Query& obj , bool justOne ) {
+            BufBuilder b;
+            int opts = 0;
+            b.appendNum( opts );
+            b.appendStr( ns );
 
+            int flags = 0;
+            if ( justOne )
+                flags |= RemoveOption_JustOne;
+            b.appendNum( flags );
+
+            obj.obj.appendSelfToBufBuilder( b );
+            toSend.setData( dbDelete , b.buf() , b.len() );
+        }
+
+        void assembleUpdate( Message& toSend , const string& ns , const Query& query , const BSONObj& obj , bool upsert , bool multi ) {
+            BufBuilder b;
+            b.appendNum( (int)0 ); // reserved
+            b.appendStr( ns );
+
+            int flags = 0;
+            if ( upsert ) flags |= UpdateOption_Upsert;
+            if ( multi ) flags |= UpdateOption_Multi;
+            b.appendNum( flags );
+
+            query.obj.appendSelfToBufBuilder( b );
+            obj.appendSelfToBufBuilder( b );
+            toSend.setData( dbUpdate , b.buf() , b.len() );
+        }
+    }
+
+    void DBClientBase::insert( const string & ns , BSONObj obj , int flags) {
+        Message toSend;
+        assembleInsert( toSend , ns , obj , flags );
         say( toSend );
     }
 
@@ -773,44 +821,14 @@ namespace mongo {
 
     void DBClientBase::remove( const string & ns , Query obj , bool justOne ) {
         Message toSend;
-
-        BufBuilder b;
-        int opts = 0;
-        b.appendNum( opts );
-        b.appendStr( ns );
-
-        int flags = 0;
-        if ( justOne )
-            flags |= RemoveOption_JustOne;
-        b.appendNum( flags );
-
-        obj.obj.appendSelfToBufBuilder( b );
-
-        toSend.setData( dbDelete , b.buf() , b.len() );
-
+        assembleRemove( toSend , ns , obj , justOne );
         say( toSend );
     }
 
     void DBClientBase::update( const string & ns , Query query , BSONObj obj , bool upsert , bool multi ) {
-
-        BufBuilder b;
-        b.appendNum( (int)0 ); // reserved
-        b.appendStr( ns );
-
-        int flags = 0;
-        if ( upsert ) flags |= UpdateOption_Upsert;
-        if ( multi ) flags |= UpdateOption_Multi;
-        b.appendNum( flags );
-
-        query.obj.appendSelfToBufBuilder( b );
-        obj.appendSelfToBufBuilder( b );
-
         Message toSend;
-        toSend.setData( dbUpdate , b.buf() , b.len() );
-
+        assembleUpdate( toSend , ns , query , obj , upsert , multi );
         say( toSend );
-
-
     }
 
 
@@ -945,6 +963,7 @@ namespace mongo {
 
     void DBClientConnection::say( Message &toSend, bool isRetry ) {
         checkConnection();
+        _pipelineSend(); // writes queued earlier must reach the server first
         try {
             port().say( toSend );
         }
@@ -958,6 +977,88 @@ namespace mongo {
         port().piggyBack( toSend );
     }
 
+    void DBClientConnection::pipelineInsert( const string &ns , BSONObj obj , int flags ) {
+        Message toSend;
+        assembleInsert( toSend , ns , obj , flags );
+        _pipelinePush( toSend );
+    }
+
+    void DBClientConnection::pipelineUpdate( const string &ns , Query query , BSONObj obj , bool upsert , bool multi ) {
+        Message toSend;
+        assembleUpdate( toSend , ns , query , obj , upsert , multi );
+        _pipelinePush( toSend );
+    }
+
+    void DBClientConnection::pipelineRemove( const string &ns , Query q , bool justOne ) {
+        Message toSend;
+        assembleRemove( toSend , ns , q , justOne );
+        _pipelinePush( toSend );
+    }
+
+    void DBClientConnection::_pipelinePush( Message& toSend ) {
+        checkConnection();
+        toSend.header()->id = nextMessageId();
+        toSend.header()->responseTo = -1;
+
+        // assembled writes are a single contiguous buffer, header included
+        const MsgData* d = toSend.singleData();
+        _pipelineBuf.appendBuf( (const void*)d , d->len );
+        _pipelineCount++;
+
+        // don't queue unbounded amounts of data client side; sending early
+        // costs nothing since no reply is expected until the flush
+        if ( _pipelineBuf.len() > 4 * 1024 * 1024 )
+            _pipelineSend();
+    }
+
+    void DBClientConnection::_pipelineSend() {
+        if ( _pipelineBuf.len() == 0 )
+            return;
+        try {
+            port().send( _pipelineBuf.buf() , _pipelineBuf.len() , "pipelineSend" );
+        }
+        catch ( SocketException& ) {
+            _failed = true;
+            _pipelineBuf.reset();
+            _pipelineCount = 0;
+            throw;
+        }
+        _pipelineBuf.reset();
+    }
+
+    BSONObj DBClientConnection::pipelineFlush( bool fsync, bool j, int w, int wtimeout ) {
+        _pipelineSend();
+        int n = _pipelineCount;
+        _pipelineCount = 0;
+        if ( n == 0 )
+            return BSONObj();
+
+        BSONObj last = getLastErrorDetailed( fsync , j , w , wtimeout );
+
+        BSONObjBuilder b;
+        b.appendElements( last );
+        b.append( "nBatch" , n );
+        if ( last["err"].type() == String ) {
+            // getLastError always reports on the most recent write
+            b.append( "batchErr" , last["err"].String() );
+            b.append( "batchErrIndex" , n - 1 );
+        }
+        else if ( n > 1 ) {
+            // the last write was clean, but an earlier one in the batch may not
+            // have been.  the server remembers its most recent error and how many
+            // operations ago it happened (nPrev), which maps back to a position
+            // in the batch.  only the most recent failure can be attributed.
+            BSONObj prev = getPrevError();
+            int nPrev = prev["nPrev"].numberInt();
+            if ( prev["err"].type() == String && nPrev >= 1 && nPrev <= n ) {
+                b.append( "batchErr" , prev["err"].String() );
+                b.append( "batchErrIndex" , n - nPrev );
+                resetError(); // so the next flush doesn't see this error again
+            }
+        }
+        return b.obj();
+    }
+
     bool DBClientConnection::recv( Message &m ) {
         return port().recv(m);
     }
@@ -967,6 +1068,7 @@ namespace mongo {
                  an exception.  we should make it return void and just throw an exception anytime
                  it fails
         */
+        _pipelineSend(); // writes queued earlier must reach the server first
         try {
             if ( !port().call(toSend, response) ) {
                 _failed = true;
@@ -67,10 +67,14 @@ namespace mongo {
 
         /** Stream the data down full blast in multiple "more" packages, on the assumption that the client
             will fully read all data queried.  Faster when you are pulling a lot of data and know you want to
-            pull it all down.  Note: it is not allowed to not read all the data unless you close the connection.
+            pull it all down: the server pushes successive batches without waiting for a getMore round trip,
+            and while a batch is being iterated the next one is already in flight.
 
-            Use the query( boost::function<void(const BSONObj&)> f, ... ) version of the connection's query()
-            method, and it will take care of all the details for you.
+            Works through the ordinary cursor interface (DBClientCursor fetches subsequent batches off the
+            stream instead of issuing getMore), or via the query( boost::function<void(const BSONObj&)> f, ... )
+            version of the connection's query() method.  Only supported on a direct DBClientConnection.
+            Note: a cursor abandoned before the stream is exhausted closes its connection, as the remaining
+            batches cannot be skipped.
         */
         QueryOption_Exhaust = 1 << 6,
 
@@ -821,7 +825,7 @@ namespace mongo {
            Connect timeout is fixed, but short, at 5 seconds.
          */
         DBClientConnection(bool _autoReconnect=false, DBClientReplicaSet* cp=0, double so_timeout=0) :
-            clientSet(cp), _failed(false), autoReconnect(_autoReconnect), lastReconnectTry(0), _so_timeout(so_timeout) {
+            clientSet(cp), _pipelineCount(0), _failed(false), autoReconnect(_autoReconnect), lastReconnectTry(0), _so_timeout(so_timeout) {
             _numConnections++;
         }
 
@@ -896,6 +900,11 @@ namespace mongo {
          */
         bool isFailed() const { return _failed; }
 
+        /** closes the socket and marks the connection failed so pools and callers
+            discard it.  used when the wire state is unrecoverable, e.g. an exhaust
+            stream abandoned with batches still inbound. */
+        void shutdown();
+
         MessagingPort& port() { assert(p); return *p; }
 
         string toStringLong() const {
@@ -922,6 +931,32 @@ namespace mongo {
 
         virtual bool lazySupported() const { return true; }
 
+        /** Pipelined writes.
+            pipelineInsert/pipelineUpdate/pipelineRemove queue a write message locally;
+            nothing blocks on the server until pipelineFlush(), which streams any queued
+            messages in one socket write and runs a single getLastError covering the
+            whole batch.  that's one round trip per batch instead of one per write, so a
+            single thread is no longer capped at 1/RTT writes per second.
+
+            pipelineFlush returns the getLastError result with "nBatch" (number of
+            writes covered) added.  if a write failed, "batchErr"/"batchErrIndex" name
+            the error and the zero-based position of the failed write within the batch.
+            the server only remembers its most recent error, so when several writes in
+            one batch fail only the last failure is attributed.
+
+            queued writes are sent before any other operation on this connection, so
+            interleaved queries still observe them.
+        */
+        void pipelineInsert( const string &ns , BSONObj obj , int flags=0 );
+        void pipelineUpdate( const string &ns , Query query , BSONObj obj , bool upsert = false , bool multi = false );
+        void pipelineRemove( const string &ns , Query q , bool justOne = 0 );
+
+        /** send queued writes and collect the batch result.  parameters as getLastErrorDetailed(). */
+        BSONObj pipelineFlush( bool fsync = false, bool j = false, int w = 0, int wtimeout = 0 );
+
+        /** number of writes queued and not yet covered by a pipelineFlush */
+        int pipelinePending() const { return _pipelineCount; }
+
         static int getNumConnections() {
             return _numConnections;
         }
@@ -933,7 +968,12 @@ namespace mongo {
         friend class SyncClusterConnection;
         virtual void sayPiggyBack( Message &toSend );
 
+        void _pipelinePush( Message& toSend );
+        void _pipelineSend();
+
         DBClientReplicaSet *clientSet;
+        BufBuilder _pipelineBuf; // queued write messages, back to back
+        int _pipelineCount;      // how many are queued and/or unaccounted for by a flush
         boost::scoped_ptr<MessagingPort> p;
         boost::scoped_ptr<SockAddr> server;
         bool _failed;
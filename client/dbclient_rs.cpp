@@ -83,27 +83,46 @@ namespace mongo {
             warning() << "replica set name empty, first node: " << servers[0] << endl;
         }
 
-        string errmsg;
+        // connect to the seeds concurrently, so a down seed costs the whole list one
+        // connect timeout instead of one per seed
+        {
+            vector< shared_ptr<boost::thread> > ts;
+            for ( unsigned i=0; i<servers.size(); i++ )
+                ts.push_back( shared_ptr<boost::thread>(
+                                  new boost::thread( boost::bind( &ReplicaSetMonitor::_connectSeed , this , servers[i] ) ) ) );
+            for ( unsigned i=0; i<ts.size(); i++ )
+                ts[i]->join();
+        }
 
-        for ( unsigned i=0; i<servers.size(); i++ ) {
+        _check( true );
+    }
 
-            bool haveAlready = false;
-            for ( unsigned n = 0; n < _nodes.size() && ! haveAlready; n++ )
-                haveAlready = ( _nodes[n].addr == servers[i] );
-            if( haveAlready ) continue;
+    void ReplicaSetMonitor::_connectSeed( HostAndPort server ) {
+        try {
+            {
+                scoped_lock lk( _lock );
+                if ( _find_inlock( server.toString() ) >= 0 )
+                    return;
+            }
 
             auto_ptr<DBClientConnection> conn( new DBClientConnection( true , 0, 5.0 ) );
-            if (!conn->connect( servers[i] , errmsg ) ) {
-                log(1) << "error connecting to seed " << servers[i] << ": " << errmsg << endl;
+            string errmsg;
+            if ( !conn->connect( server , errmsg ) ) {
+                log(1) << "error connecting to seed " << server << ": " << errmsg << endl;
                 // skip seeds that don't work
-                continue;
+                return;
             }
 
-            _nodes.push_back( Node( servers[i] , conn.release() ) );
-            
-            int myLoc = _nodes.size() - 1;
-            string maybePrimary;
-            _checkConnection( _nodes[myLoc].conn.get() , maybePrimary, false, myLoc );
+            scoped_lock lk( _lock );
+            if ( _find_inlock( server.toString() ) >= 0 )
+                return;
+            _nodes.push_back( Node( server , conn.release() ) );
+        }
+        catch ( std::exception& e ) {
+            error() << "couldn't connect to seed " << server << ' ' << e.what() << endl;
+        }
+        catch ( ... ) {
+            error() << "couldn't connect to seed " << server << endl;
         }
     }
 
@@ -216,7 +235,7 @@ namespace mongo {
         return _nodes[_master].addr;
     }
     
-    HostAndPort ReplicaSetMonitor::getSlave( const HostAndPort& prev ) {
+    HostAndPort ReplicaSetMonitor::getSlave( const HostAndPort& prev , const BSONObj& tag ) {
         // make sure its valid
 
         bool wasFound = false;
@@ -227,12 +246,12 @@ namespace mongo {
         if( prev.host().size() ){
             scoped_lock lk( _lock );
             for ( unsigned i=0; i<_nodes.size(); i++ ) {
-                if ( prev != _nodes[i].addr ) 
+                if ( prev != _nodes[i].addr )
                     continue;
 
                 wasFound = true;
 
-                if ( _nodes[i].okForSecondaryQueries() )
+                if ( _nodes[i].okForSecondaryQueries() && _nodes[i].matchesTag( tag ) )
                     return prev;
 
                 wasMaster = _nodes[i].ok && ! _nodes[i].secondary;
@@ -240,7 +259,7 @@ namespace mongo {
                 break;
             }
         }
-        
+
         if( prev.host().size() ){
             if( wasFound ){ LOG(1) << "slave '" << prev << ( wasMaster ? "' is master node, trying to find another node" :
                                                                          "' is no longer ok to use" ) << endl; }
@@ -248,22 +267,57 @@ namespace mongo {
         }
         else LOG(1) << "slave '" << prev << "' is not initialized or invalid" << endl;
 
-        return getSlave();
+        return getSlave( tag );
     }
 
-    HostAndPort ReplicaSetMonitor::getSlave() {
-        LOG(2) << "dbclient_rs getSlave " << getServerAddress() << endl;
-
-        scoped_lock lk( _lock );
+    bool ReplicaSetMonitor::_getSlave_inlock( const BSONObj& tag , HostAndPort& out ) {
+        // find the closest eligible member, then round-robin among everyone within
+        // the latency window of it: nearby members share the load but a
+        // cross-datacenter member doesn't take reads it would slow down
+        double best = std::numeric_limits<double>::max();
+        for ( unsigned i = 0; i < _nodes.size(); i++ ) {
+            if ( (int)i == _master )
+                continue;
+            if ( ! _nodes[i].okForSecondaryQueries() || ! _nodes[i].matchesTag( tag ) )
+                continue;
+            if ( _nodes[i].pingTimeMillis < best )
+                best = _nodes[i].pingTimeMillis;
+        }
 
         for ( unsigned ii = 0; ii < _nodes.size(); ii++ ) {
             _nextSlave = ( _nextSlave + 1 ) % _nodes.size();
-            if ( _nextSlave != _master ) {
-                if ( _nodes[ _nextSlave ].okForSecondaryQueries() )
-                    return _nodes[ _nextSlave ].addr;
-                LOG(2) << "dbclient_rs getSlave not selecting " << _nodes[_nextSlave] << ", not currently okForSecondaryQueries" << endl;
+            if ( _nextSlave == _master )
+                continue;
+            if ( ! _nodes[ _nextSlave ].okForSecondaryQueries() || ! _nodes[ _nextSlave ].matchesTag( tag ) ) {
+                LOG(2) << "dbclient_rs getSlave not selecting " << _nodes[_nextSlave] << ", not currently okForSecondaryQueries or tag mismatch" << endl;
+                continue;
+            }
+            if ( _nodes[ _nextSlave ].pingTimeMillis > best + _latencyWindowMillis ) {
+                LOG(2) << "dbclient_rs getSlave not selecting " << _nodes[_nextSlave] << ", "
+                       << _nodes[_nextSlave].pingTimeMillis << "ms ping is outside the latency window (closest: " << best << "ms)" << endl;
+                continue;
             }
+            out = _nodes[ _nextSlave ].addr;
+            return true;
         }
+        return false;
+    }
+
+    HostAndPort ReplicaSetMonitor::getSlave( const BSONObj& tag ) {
+        LOG(2) << "dbclient_rs getSlave " << getServerAddress() << endl;
+
+        scoped_lock lk( _lock );
+
+        HostAndPort out;
+        if ( _getSlave_inlock( tag , out ) )
+            return out;
+
+        // a tagged read with no eligible matching member falls back to the whole pool
+        if ( ! tag.isEmpty() && _getSlave_inlock( BSONObj() , out ) ) {
+            LOG(1) << "dbclient_rs getSlave no member matching tag " << tag << ", using untagged member " << out << endl;
+            return out;
+        }
+
         uassert(15899, str::stream() << "No suitable member found for slaveOk query in replica set: " << _name, _master >= 0 && _nodes[_master].ok);
 
         // Fall back to primary
@@ -352,24 +406,34 @@ namespace mongo {
     
 
     bool ReplicaSetMonitor::_checkConnection( DBClientConnection * c , string& maybePrimary , bool verbose , int nodesOffset ) {
-        scoped_lock lk( _checkConnectionLock );
         bool isMaster = false;
         bool changed = false;
         try {
             Timer t;
             BSONObj o;
             c->isMaster(isMaster, &o);
-            
+
             if ( o["setName"].type() != String || o["setName"].String() != _name ) {
-                warning() << "node: " << c->getServerAddress() << " isn't a part of set: " << _name 
+                warning() << "node: " << c->getServerAddress() << " isn't a part of set: " << _name
                           << " ismaster: " << o << endl;
-                if ( nodesOffset >= 0 )
+                if ( nodesOffset >= 0 ) {
+                    scoped_lock lk( _lock );
                     _nodes[nodesOffset].ok = false;
+                }
                 return false;
             }
 
             if ( nodesOffset >= 0 ) {
-                _nodes[nodesOffset].pingTimeMillis = t.millis();
+                // publish in one short critical section, so request threads reading
+                // under _lock always see a consistent view of the member
+                scoped_lock lk( _lock );
+
+                // fold the sample into the EWMA; a single slow check (e.g. a
+                // dropped packet) shouldn't evict a member from the latency window
+                if ( _nodes[nodesOffset].pingTimeMillis == 0 )
+                    _nodes[nodesOffset].pingTimeMillis = t.millis();
+                else
+                    _nodes[nodesOffset].pingTimeMillis = 0.75 * _nodes[nodesOffset].pingTimeMillis + 0.25 * t.millis();
                 _nodes[nodesOffset].hidden = o["hidden"].trueValue();
                 _nodes[nodesOffset].secondary = o["secondary"].trueValue();
                 _nodes[nodesOffset].ismaster = o["ismaster"].trueValue();
@@ -378,7 +442,7 @@ namespace mongo {
             }
 
             log( ! verbose ) << "ReplicaSetMonitor::_checkConnection: " << c->toString() << ' ' << o << endl;
-            
+
             // add other nodes
             if ( o["hosts"].type() == Array ) {
                 if ( o["primary"].type() == String )
@@ -389,14 +453,17 @@ namespace mongo {
             if (o.hasField("passives") && o["passives"].type() == Array) {
                 _checkHosts(o["passives"].Obj(), changed);
             }
-            
+
             _checkStatus(c);
 
-            
+
         }
         catch ( std::exception& e ) {
             log( ! verbose ) << "ReplicaSetMonitor::_checkConnection: caught exception " << c->toString() << ' ' << e.what() << endl;
-            _nodes[nodesOffset].ok = false;
+            if ( nodesOffset >= 0 ) {
+                scoped_lock lk( _lock );
+                _nodes[nodesOffset].ok = false;
+            }
         }
 
         if ( changed && _hook )
@@ -405,64 +472,84 @@ namespace mongo {
         return isMaster;
     }
 
-    void ReplicaSetMonitor::_check( bool checkAllSecondaries ) {
+    void ReplicaSetMonitor::_probeNode( int i , string* maybePrimary , int* isMaster ) {
+        shared_ptr<DBClientConnection> c;
+        {
+            scoped_lock lk( _lock );
+            c = _nodes[i].conn;
+        }
+        try {
+            *isMaster = _checkConnection( c.get() , *maybePrimary , false , i );
+        }
+        catch ( ... ) {
+            // _checkConnection traps the expected failures; nothing may escape a
+            // probe thread
+            *isMaster = false;
+        }
+    }
 
-        bool triedQuickCheck = false;
+    void ReplicaSetMonitor::_check( bool checkAllSecondaries ) {
 
         LOG(1) <<  "_check : " << getServerAddress() << endl;
 
-        int newMaster = -1;
-        
-        for ( int retry = 0; retry < 2; retry++ ) {
-            for ( unsigned i=0; i<_nodes.size(); i++ ) {
-                shared_ptr<DBClientConnection> c;
-                {
-                    scoped_lock lk( _lock );
-                    c = _nodes[i].conn;
-                }
-
-                string maybePrimary;
-                if ( _checkConnection( c.get() , maybePrimary , retry , i ) ) {
-                    _master = i;
-                    newMaster = i;
-                    if ( ! checkAllSecondaries )
-                        return;
-                }
+        // one probe sweep at a time - a sweep owns the members' check connections.
+        // request threads never take this lock; they read the node table under
+        // _lock, which probes only hold while publishing results.
+        scoped_lock chk( _checkConnectionLock );
 
-                if ( ! triedQuickCheck && maybePrimary.size() ) {
-                    int x = _find( maybePrimary );
-                    if ( x >= 0 ) {
-                        triedQuickCheck = true;
-                        string dummy;
-                        shared_ptr<DBClientConnection> testConn;
-                        {
-                            scoped_lock lk( _lock );
-                            testConn = _nodes[x].conn;
-                        }
-                        if ( _checkConnection( testConn.get() , dummy , false , x ) ) {
-                            _master = x;
-                            newMaster = x;
-                            if ( ! checkAllSecondaries )
-                                return;
-                        }
-                    }
-                }
+        for ( int retry = 0; retry < 2; retry++ ) {
+            unsigned n;
+            {
+                scoped_lock lk( _lock );
+                n = _nodes.size();
+            }
+            if ( n == 0 )
+                return;
 
+            // probe all members concurrently; a hung member costs the sweep one
+            // socket timeout instead of stalling every probe queued behind it
+            vector<string> maybePrimaries( n );
+            vector<int> isMasters( n , 0 );
+            {
+                vector< shared_ptr<boost::thread> > ts;
+                for ( unsigned i=0; i<n; i++ )
+                    ts.push_back( shared_ptr<boost::thread>(
+                                      new boost::thread( boost::bind( &ReplicaSetMonitor::_probeNode , this ,
+                                                                      (int)i , &maybePrimaries[i] , &isMasters[i] ) ) ) );
+                for ( unsigned i=0; i<ts.size(); i++ )
+                    ts[i]->join();
             }
-            
-            if ( newMaster >= 0 )
+
+            for ( unsigned i=0; i<n; i++ ) {
+                if ( ! isMasters[i] )
+                    continue;
+                scoped_lock lk( _lock );
+                _master = i;
                 return;
+            }
 
+            // no master seen; hosts discovered during the probes (_checkHosts) are
+            // covered by the next round
             sleepsecs(1);
         }
 
     }
 
     void ReplicaSetMonitor::check( bool checkAllSecondaries ) {
+        shared_ptr<DBClientConnection> c;
+        int master;
+        {
+            scoped_lock lk( _lock );
+            master = _master;
+            if ( master >= 0 )
+                c = _nodes[master].conn;
+        }
+
         // first see if the current master is fine
-        if ( _master >= 0 ) {
+        if ( master >= 0 ) {
+            scoped_lock chk( _checkConnectionLock );
             string temp;
-            if ( _checkConnection( _nodes[_master].conn.get() , temp , false , _master ) ) {
+            if ( _checkConnection( c.get() , temp , false , master ) ) {
                 if ( ! checkAllSecondaries ) {
                     // current master is fine, so we're done
                     return;
@@ -552,14 +639,14 @@ namespace mongo {
     }
 
     DBClientConnection * DBClientReplicaSet::checkSlave() {
-        HostAndPort h = _monitor->getSlave( _slaveHost );
+        HostAndPort h = _monitor->getSlave( _slaveHost , _slaveTag );
 
         if ( h == _slaveHost && _slave ) {
             if ( ! _slave->isFailed() )
                 return _slave.get();
             _monitor->notifySlaveFailure( _slaveHost );
-            _slaveHost = _monitor->getSlave();
-        } 
+            _slaveHost = _monitor->getSlave( _slaveTag );
+        }
         else {
             _slaveHost = h;
         }
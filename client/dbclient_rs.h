@@ -72,11 +72,17 @@ namespace mongo {
          */
         void notifyFailure( const HostAndPort& server );
 
-        /** @return prev if its still ok, and if not returns a random slave that is ok for reads */
-        HostAndPort getSlave( const HostAndPort& prev );
+        /** @return prev if its still ok, and if not returns a slave per getSlave() below */
+        HostAndPort getSlave( const HostAndPort& prev , const BSONObj& tag = BSONObj() );
 
-        /** @return a random slave that is ok for reads */
-        HostAndPort getSlave();
+        /** @return a slave that is ok for reads.  selection is latency aware: the
+            members within _latencyWindowMillis of the closest one (by EWMA ping)
+            share the reads round-robin, so a cross-datacenter member isn't handed
+            the same share as a local one.  a non-empty 'tag' restricts the choice
+            to members whose replica set tags match it (e.g. to pin analytics reads
+            to designated members); if no tagged member is eligible, falls back to
+            the whole pool. */
+        HostAndPort getSlave( const BSONObj& tag = BSONObj() );
 
 
         /**
@@ -106,8 +112,18 @@ namespace mongo {
          */
         ReplicaSetMonitor( const string& name , const vector<HostAndPort>& servers );
 
+        /** connect to one seed and add it to the node table; used by the
+            constructor's concurrent seed fan-out.  traps all errors. */
+        void _connectSeed( HostAndPort server );
+
+        /** probe sweep: all members checked concurrently, so a hung member costs
+            one socket timeout instead of stalling the probes queued behind it */
         void _check( bool checkAllSecondaries );
 
+        /** one probe thread of _check(); runs _checkConnection on node i and
+            reports through the out params.  traps all errors. */
+        void _probeNode( int i , string* maybePrimary , int* isMaster );
+
         /**
          * Use replSetGetStatus command to make sure hosts in host list are up
          * and readable.  Sets Node::ok appropriately.
@@ -123,7 +139,10 @@ namespace mongo {
         void _checkHosts(const BSONObj& hostList, bool& changed);
 
         /**
-         * Updates host list.
+         * Updates host list.  Does blocking network i/o with no lock held; takes
+         * _lock only briefly to publish results, so request threads reading the
+         * node table never wait on a probe.  Caller must hold _checkConnectionLock
+         * (probe sweeps are serialized and own the members' check connections).
          * @param c the connection to check
          * @param maybePrimary OUT
          * @param verbose
@@ -136,8 +155,11 @@ namespace mongo {
         int _find_inlock( const string& server ) const ;
         int _find( const HostAndPort& server ) const ;
 
-        mutable mongo::mutex _lock; // protects _nodes
-        mutable mongo::mutex  _checkConnectionLock;
+        /** getSlave() selection pass for one tag; @return true if 'out' was set */
+        bool _getSlave_inlock( const BSONObj& tag , HostAndPort& out );
+
+        mutable mongo::mutex _lock; // protects _nodes; only ever held for short, non-blocking sections
+        mutable mongo::mutex  _checkConnectionLock; // serializes probe sweeps; never taken by request paths
 
         string _name;
         struct Node {
@@ -150,6 +172,23 @@ namespace mongo {
                 return ok && secondary && ! hidden;
             }
 
+            /** @return true if every field of 'tag' appears with an equal value in
+                this member's replica set tags (as reported by ismaster) */
+            bool matchesTag( const BSONObj& tag ) const {
+                if ( tag.isEmpty() )
+                    return true;
+                if ( lastIsMaster["tags"].type() != Object )
+                    return false;
+                BSONObj myTags = lastIsMaster["tags"].Obj();
+                BSONObjIterator i( tag );
+                while ( i.more() ) {
+                    BSONElement e = i.next();
+                    if ( myTags[e.fieldName()].woCompare( e , false ) != 0 )
+                        return false;
+                }
+                return true;
+            }
+
             BSONObj toBSON() const {
                 return BSON( "addr" << addr.toString() <<
                              "isMaster" << ismaster <<
@@ -174,10 +213,13 @@ namespace mongo {
             BSONObj lastIsMaster;
 
             bool ismaster;
-            bool secondary; 
+            bool secondary;
             bool hidden;
-            
-            int pingTimeMillis;
+
+            // exponentially weighted moving average of the ismaster round trip,
+            // so routing prefers consistently near members but adapts when
+            // latency shifts.  0 until the first sample.
+            double pingTimeMillis;
 
         };
 
@@ -189,6 +231,10 @@ namespace mongo {
         int _master; // which node is the current master.  -1 means no master is known
         int _nextSlave; // which node is the current slave
 
+        // slaves whose EWMA ping is within this many millis of the closest
+        // eligible member share the reads round-robin; anyone farther is skipped
+        static const int _latencyWindowMillis = 15;
+
         static mongo::mutex _setsLock; // protects _sets
         static map<string,ReplicaSetMonitorPtr> _sets; // set name to Monitor
 
@@ -247,6 +293,14 @@ namespace mongo {
         DBClientConnection& masterConn();
         DBClientConnection& slaveConn();
 
+        /** restrict this connection's slave reads to members whose replica set tags
+            match 'tag' (e.g. pin an analytics client to designated members).  takes
+            effect on the next slave selection; an empty obj clears the pin. */
+        void pinSlaveTag( const BSONObj& tag ) {
+            _slaveTag = tag.getOwned();
+            _slave.reset();
+        }
+
         // ---- callback pieces -------
 
         virtual void say( Message &toSend, bool isRetry = false );
@@ -302,7 +356,11 @@ namespace mongo {
 
         HostAndPort _slaveHost;
         scoped_ptr<DBClientConnection> _slave;
-        
+
+        // when non-empty, slave selection is restricted to members matching these
+        // replica set tags (see pinSlaveTag())
+        BSONObj _slaveTag;
+
         double _so_timeout;
 
         /**
@@ -102,6 +102,13 @@ namespace mongo {
     void DBClientCursor::requestMore() {
         assert( cursorId && b.pos == b.nReturned );
 
+        if ( opts & QueryOption_Exhaust ) {
+            // the server streams successive batches on its own; there is no
+            // getMore round trip, the next batch is already on the wire
+            exhaustReceiveMore();
+            return;
+        }
+
         if (haveLimit) {
             nToReturn -= b.nReturned;
             assert(nToReturn > 0);
@@ -139,10 +146,9 @@ namespace mongo {
         assert( !haveLimit );
         auto_ptr<Message> response(new Message());
         assert( _client );
-        if ( _client->recv(*response) ) {
-            b.m = response;
-            dataReceived();
-        }
+        massert( 16238, "dbclient error receiving exhaust batch", _client->recv(*response) );
+        b.m = response;
+        dataReceived();
     }
 
     void DBClientCursor::dataReceived( bool& retry, string& host ) {
@@ -264,6 +270,10 @@ namespace mongo {
         assert( _scopedHost.size() == 0 );
         assert( conn );
         assert( conn->get() );
+        // an exhaust cursor owns its socket until the stream ends; it cannot be
+        // detached and resumed through the pool
+        massert( 16239, "can't detach an exhaust cursor mid stream",
+                 ! ( opts & QueryOption_Exhaust ) || cursorId == 0 );
 
         if ( conn->get()->type() == ConnectionString::SET ||
              conn->get()->type() == ConnectionString::SYNC ) {
@@ -290,6 +300,14 @@ namespace mongo {
         DESTRUCTOR_GUARD (
 
         if ( cursorId && _ownCursor && ! inShutdown() ) {
+            if ( opts & QueryOption_Exhaust ) {
+                /* the server is still pushing batches; there is no way to hand this
+                   socket back in a clean state, so close it rather than let the
+                   unread batches poison the next operation on the connection */
+                if ( _client && typeid(*_client) == typeid(DBClientConnection) )
+                    static_cast<DBClientConnection*>(_client)->shutdown();
+                return;
+            }
             BufBuilder b;
             b.appendNum( (int)0 ); // reserved
             b.appendNum( (int)1 ); // number
@@ -20,6 +20,7 @@
 #include <utility>
 
 #include "gridfs.h"
+#include "../util/compress.h"
 #include <boost/smart_ptr.hpp>
 
 #if defined(_WIN32)
@@ -33,6 +34,7 @@
 namespace mongo {
 
     const unsigned DEFAULT_CHUNK_SIZE = 256 * 1024;
+    const unsigned DEFAULT_PIPELINE_DEPTH = 8;
 
     GridFSChunk::GridFSChunk( BSONObj o ) {
         _data = o;
@@ -46,11 +48,23 @@ namespace mongo {
         _data = b.obj();
     }
 
+    const char * GridFSChunk::data( int & len ) const {
+        const char * raw = _data["data"].binDataClean( len );
+        if ( ! _data["z"].trueValue() )
+            return raw;
+        if ( _inflated.empty() ) {
+            uassert( 16245 , "corrupt compressed chunk" , uncompress( raw , len , &_inflated ) );
+        }
+        len = (int) _inflated.size();
+        return _inflated.data();
+    }
 
     GridFS::GridFS( DBClientBase& client , const string& dbName , const string& prefix ) : _client( client ) , _dbName( dbName ) , _prefix( prefix ) {
         _filesNS = dbName + "." + prefix + ".files";
         _chunksNS = dbName + "." + prefix + ".chunks";
         _chunkSize = DEFAULT_CHUNK_SIZE;
+        _pipelineDepth = DEFAULT_PIPELINE_DEPTH;
+        _compressChunks = false;
 
         client.ensureIndex( _filesNS , BSON( "filename" << 1 ) );
         client.ensureIndex( _chunksNS , BSON( "files_id" << 1 << "n" << 1 ) );
@@ -65,6 +79,37 @@ namespace mongo {
         _chunkSize = size;
     }
 
+    void GridFS::setPipelineDepth(unsigned int depth) {
+        massert( 16246 , "invalid pipeline depth is specified", depth > 0 );
+        _pipelineDepth = depth;
+    }
+
+    BSONObj GridFS::_chunkObj( const BSONObj& idObj , int chunkNumber , const char * data , int len ) const {
+        if ( _compressChunks ) {
+            string z;
+            size_t zlen = compress( data , len , &z );
+            if ( zlen < (size_t) len ) {
+                BSONObjBuilder b;
+                b.appendAs( idObj["_id"] , "files_id" );
+                b.append( "n" , chunkNumber );
+                b.appendBinData( "data" , (int) zlen , BinDataGeneral , z.data() );
+                b.appendBool( "z" , true );
+                return b.obj();
+            }
+            // incompressible chunk - store it plain so reads skip the inflate
+        }
+        return GridFSChunk( idObj , chunkNumber , data , len )._data;
+    }
+
+    void GridFS::_flushChunks( vector<BSONObj>& batch ) {
+        if ( batch.empty() )
+            return;
+        _client.insert( _chunksNS.c_str() , batch );
+        string err = _client.getLastError();
+        uassert( 16247 , str::stream() << "error inserting chunks: " << err , err.empty() );
+        batch.clear();
+    }
+
     BSONObj GridFS::storeFile( const char* data , size_t length , const string& remoteName , const string& contentType) {
         char const * const end = data + length;
 
@@ -73,14 +118,17 @@ namespace mongo {
         BSONObj idObj = BSON("_id" << id);
 
         int chunkNumber = 0;
+        vector<BSONObj> batch;
         while (data < end) {
             int chunkLen = MIN(_chunkSize, (unsigned)(end-data));
-            GridFSChunk c(idObj, chunkNumber, data, chunkLen);
-            _client.insert( _chunksNS.c_str() , c._data );
+            batch.push_back( _chunkObj(idObj, chunkNumber, data, chunkLen) );
+            if ( batch.size() >= _pipelineDepth )
+                _flushChunks( batch );
 
             chunkNumber++;
             data += chunkLen;
         }
+        _flushChunks( batch );
 
         return insertFile(remoteName, id, length, contentType);
     }
@@ -102,10 +150,10 @@ namespace mongo {
 
         int chunkNumber = 0;
         gridfs_offset length = 0;
+        vector<BSONObj> batch;
+        boost::scoped_array<char> buf( new char[_chunkSize] );
         while (!feof(fd)) {
-            //boost::scoped_array<char>buf (new char[_chunkSize+1]);
-            char * buf = new char[_chunkSize+1];
-            char* bufPos = buf;//.get();
+            char* bufPos = buf.get();
             unsigned int chunkLen = 0; // how much in the chunk now
             while(chunkLen != _chunkSize && !feof(fd)) {
                 int readLen = fread(bufPos, 1, _chunkSize - chunkLen, fd);
@@ -115,13 +163,15 @@ namespace mongo {
                 assert(chunkLen <= _chunkSize);
             }
 
-            GridFSChunk c(idObj, chunkNumber, buf, chunkLen);
-            _client.insert( _chunksNS.c_str() , c._data );
+            // the chunk object owns a copy of the data, so the buffer can be reused
+            batch.push_back( _chunkObj(idObj, chunkNumber, buf.get(), chunkLen) );
+            if ( batch.size() >= _pipelineDepth )
+                _flushChunks( batch );
 
             length += chunkLen;
             chunkNumber++;
-            delete[] buf;
         }
+        _flushChunks( batch );
 
         if (fd != stdin)
             fclose( fd );
@@ -216,13 +266,26 @@ namespace mongo {
 
         const int num = getNumChunks();
 
-        for ( int i=0; i<num; i++ ) {
-            GridFSChunk c = getChunk( i );
+        /* stream the chunks with a single query on the files_id+n index rather
+           than a findOne round trip per chunk.  the cursor's batches mean the
+           server is reading ahead the next chunks while we write this one out. */
+        BSONObjBuilder q;
+        q.appendAs( _obj["_id"] , "files_id" );
+        auto_ptr<DBClientCursor> c = _grid->_client.query( _grid->_chunksNS.c_str() ,
+                                                           Query( q.obj() ).sort( BSON( "n" << 1 ) ) );
+
+        int i = 0;
+        while ( c->more() ) {
+            BSONObj o = c->next();
+            uassert( 16248 , "chunks out of order" , o["n"].numberInt() == i );
+            GridFSChunk chunk( o );
 
             int len;
-            const char * data = c.data( len );
+            const char * data = chunk.data( len );
             out.write( data , len );
+            i++;
         }
+        uassert( 16249 , "not all chunks found" , i == num );
 
         return getContentLength();
     }
@@ -34,17 +34,20 @@ namespace mongo {
 
         int len() const {
             int len;
-            _data["data"].binDataClean( len );
+            data( len );
             return len;
         }
 
-        const char * data( int & len ) const {
-            return _data["data"].binDataClean( len );
-        }
+        /** @return the chunk payload, transparently decompressing chunks that were
+            stored with compression on.  the pointer is valid for the life of this
+            GridFSChunk. */
+        const char * data( int & len ) const;
 
     private:
         BSONObj _data;
+        mutable string _inflated; // decompressed payload, filled lazily for compressed chunks
         friend class GridFS;
+        friend class GridFile;
     };
 
 
@@ -67,6 +70,22 @@ namespace mongo {
          */
         void setChunkSize(unsigned int size);
 
+        /**
+         * number of chunks written per round trip when storing a file.  each batch
+         * is one insert message followed by one getLastError, so larger values
+         * amortize the round trip at the cost of (depth * chunkSize) bytes queued
+         * client side.  default 8.
+         */
+        void setPipelineDepth(unsigned int depth);
+
+        /**
+         * snappy-compress each chunk before inserting it (skipped per chunk when
+         * compression doesn't shrink the data).  reads via GridFile decompress
+         * transparently; note that other drivers will not, and that the stored md5
+         * covers the bytes as stored.  default off.
+         */
+        void setCompressChunks(bool compress) { _compressChunks = compress; }
+
         /**
          * puts the file reference by fileName into the db
          * @param fileName local filename relative to process
@@ -124,10 +143,18 @@ namespace mongo {
         string _filesNS;
         string _chunksNS;
         unsigned int _chunkSize;
+        unsigned int _pipelineDepth;
+        bool _compressChunks;
 
         // insert fileobject. All chunks must be in DB.
         BSONObj insertFile(const string& name, const OID& id, gridfs_offset length, const string& contentType);
 
+        // build one chunk object, compressing the payload if enabled and worthwhile
+        BSONObj _chunkObj( const BSONObj& idObj , int chunkNumber , const char * data , int len ) const;
+
+        // insert the batched chunks in one message and wait for the covering getLastError
+        void _flushChunks( vector<BSONObj>& batch );
+
         friend class GridFile;
     };
 
@@ -67,7 +67,9 @@
 #include "clientOnly.cpp"
 #include "gridfs.cpp"
 #include "dbclientcursor.cpp"
+#include "bulk.cpp"
 #include "../util/text.cpp"
+#include "../util/memaccount.cpp"
 #include "dbclient_rs.cpp"
 #include "../bson/oid.cpp"
 #include "../db/lasterror.cpp"
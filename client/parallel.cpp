@@ -366,6 +366,7 @@ namespace mongo {
     void ParallelSortClusteredCursor::_finishCons() {
         _numServers = _servers.size();
         _cursors = 0;
+        _heapInit = false;
 
         if ( ! _sortKey.isEmpty() && ! _fields.isEmpty() ) {
             // we need to make sure the sort key is in the projection
@@ -687,44 +688,104 @@ namespace mongo {
         return false;
     }
 
+    namespace {
+        /* merge order for the head-selection heap.  std::*_heap keeps the
+           "largest" element at the front, so this says a's head sorts after
+           b's.  ties go to the higher index, which is what the old linear scan
+           did (later servers won them). */
+        struct HeadSortsAfter {
+            HeadSortsAfter( FilteringClientCursor * cursors , const BSONObj& sortKey )
+                : _cursors( cursors ) , _sortKey( sortKey ) {}
+            bool operator()( int a , int b ) const {
+                int comp = _cursors[a].peek().woSortOrder( _cursors[b].peek() , _sortKey , true );
+                if ( comp != 0 )
+                    return comp > 0;
+                return a < b;
+            }
+            FilteringClientCursor * _cursors;
+            BSONObj _sortKey;
+        };
+    }
+
     BSONObj ParallelSortClusteredCursor::next() {
-        BSONObj best = BSONObj();
-        int bestFrom = -1;
+        if ( _sortKey.isEmpty() ) {
+            // no merge order -- drain the cursors in turn
+            for ( int i=0; i<_numServers; i++ ) {
+                if ( ! _cursors[i].more() )
+                    continue;
+                BSONObj doc = _cursors[i].peek();
+                _cursors[i].next();
+                return doc;
+            }
+            uassert( 10019 ,  "no more elements" , false );
+        }
 
-        for ( int i=0; i<_numServers; i++) {
-            if ( ! _cursors[i].more() )
-                continue;
+        HeadSortsAfter order( _cursors , _sortKey );
+
+        if ( ! _heapInit ) {
+            // seed the heap with every cursor that has a head; each cursor's
+            // head only changes when we pop it, so the order stays valid
+            _heap.clear();
+            for ( int i=0; i<_numServers; i++ )
+                if ( _cursors[i].more() )
+                    _heap.push_back( i );
+            std::make_heap( _heap.begin() , _heap.end() , order );
+            _heapInit = true;
+        }
 
-            BSONObj me = _cursors[i].peek();
+        uassert( 10019 ,  "no more elements" , ! _heap.empty() );
 
-            if ( best.isEmpty() ) {
-                best = me;
-                bestFrom = i;
-                if( _sortKey.isEmpty() ) break;
-                continue;
-            }
+        std::pop_heap( _heap.begin() , _heap.end() , order );
+        int from = _heap.back();
+        _heap.pop_back();
 
-            int comp = best.woSortOrder( me , _sortKey , true );
-            if ( comp < 0 )
-                continue;
-
-            best = me;
-            bestFrom = i;
+        BSONObj best = _cursors[from].peek();
+        _cursors[from].next();
+        if ( _cursors[from].more() ) {
+            _heap.push_back( from );
+            std::push_heap( _heap.begin() , _heap.end() , order );
         }
 
-        uassert( 10019 ,  "no more elements" , ! best.isEmpty() );
-        _cursors[bestFrom].next();
-
         return best;
     }
 
     void ParallelSortClusteredCursor::_explain( map< string,list<BSONObj> >& out ) {
-        for ( set<ServerAndQuery>::iterator i=_servers.begin(); i!=_servers.end(); ++i ) {
-            const ServerAndQuery& sq = *i;
-            list<BSONObj> & l = out[sq._server];
-            l.push_back( explain( sq._server , sq._extra ) );
+        // fan the explains out the way _init fans out the real queries: send
+        // them all lazily, then collect, so we pay the slowest shard's round
+        // trip rather than the sum of all of them
+        vector<ServerAndQuery> servers( _servers.begin() , _servers.end() );
+        vector< shared_ptr<ShardConnection> > conns( servers.size() );
+        vector< shared_ptr<DBClientCursor> > cursors( servers.size() );
+
+        for ( size_t i = 0; i < servers.size(); i++ ) {
+            const ServerAndQuery& sq = servers[i];
+
+            BSONObj q = _query;
+            if ( ! sq._extra.isEmpty() )
+                q = concatQuery( q , sq._extra );
+
+            conns[i].reset( new ShardConnection( sq._server , _ns ) );
+            cursors[i].reset( new DBClientCursor( conns[i]->get() , _ns , Query( q ).explain().obj ,
+                                                  abs( _batchSize ) * -1 , 0 ,
+                                                  _fields.isEmpty() ? 0 : &_fields , 0 , 0 ) );
+            cursors[i]->initLazy();
         }
 
+        for ( size_t i = 0; i < servers.size(); i++ ) {
+            const ServerAndQuery& sq = servers[i];
+
+            bool retry = false;
+            massert( 16237 , str::stream() << "error receiving explain from " << sq._server ,
+                     cursors[i]->initLazyFinish( retry ) );
+
+            BSONObj o;
+            if ( cursors[i]->more() )
+                o = cursors[i]->next().getOwned();
+            out[sq._server].push_back( o );
+
+            cursors[i].reset(); // before returning the conn to the pool
+            conns[i]->done();
+        }
     }
 
     // -----------------
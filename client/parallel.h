@@ -246,6 +246,11 @@ namespace mongo {
 
         FilteringClientCursor * _cursors;
         int _needToSkip;
+
+        // merge heap of cursor indices ordered by their heads, so next() is
+        // O(log servers) instead of a scan of every head
+        vector<int> _heap;
+        bool _heapInit;
     };
 
     /**
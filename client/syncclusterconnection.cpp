@@ -73,50 +73,81 @@ namespace mongo {
         return fsync( errmsg );
     }
 
+    void SyncClusterConnection::_fsyncOne( size_t i, string* err ) {
+        BSONObj res;
+        try {
+            if ( _conns[i]->simpleCommand( "admin" , &res , "fsync" ) )
+                return;
+        }
+        catch ( DBException& e ) {
+            *err += e.toString();
+        }
+        catch ( std::exception& e ) {
+            *err += e.what();
+        }
+        catch ( ... ) {
+        }
+        *err += " " + _conns[i]->toString() + ":" + res.toString();
+    }
+
     bool SyncClusterConnection::fsync( string& errmsg ) {
-        bool ok = true;
         errmsg = "";
-        for ( size_t i=0; i<_conns.size(); i++ ) {
-            BSONObj res;
-            try {
-                if ( _conns[i]->simpleCommand( "admin" , &res , "fsync" ) )
-                    continue;
-            }
-            catch ( DBException& e ) {
-                errmsg += e.toString();
-            }
-            catch ( std::exception& e ) {
-                errmsg += e.what();
-            }
-            catch ( ... ) {
-            }
+
+        // an fsync is a full round trip per member, so fan out and wait for all of
+        // them - the prepare phase then costs the slowest server, not the sum
+        vector<string> errs( _conns.size() );
+        {
+            vector< shared_ptr<boost::thread> > ts;
+            for ( size_t i=0; i<_conns.size(); i++ )
+                ts.push_back( shared_ptr<boost::thread>(
+                                  new boost::thread( boost::bind( &SyncClusterConnection::_fsyncOne , this , i , &errs[i] ) ) ) );
+            for ( size_t i=0; i<ts.size(); i++ )
+                ts[i]->join();
+        }
+
+        bool ok = true;
+        for ( size_t i=0; i<errs.size(); i++ ) {
+            if ( errs[i].empty() )
+                continue;
             ok = false;
-            errmsg += " " + _conns[i]->toString() + ":" + res.toString();
+            errmsg += errs[i];
         }
         return ok;
     }
 
+    void SyncClusterConnection::_checkLastOne( size_t i, BSONObj* res, string* err ) {
+        BSONObj r;
+        try {
+            if ( ! _conns[i]->runCommand( "admin" , BSON( "getlasterror" << 1 << "fsync" << 1 ) , r ) )
+                *err = "cmd failed: ";
+        }
+        catch ( std::exception& e ) {
+            *err += e.what();
+        }
+        catch ( ... ) {
+            *err += "unknown failure";
+        }
+        *res = r.getOwned();
+    }
+
     void SyncClusterConnection::_checkLast() {
         _lastErrors.clear();
-        vector<string> errors;
 
-        for ( size_t i=0; i<_conns.size(); i++ ) {
-            BSONObj res;
-            string err;
-            try {
-                if ( ! _conns[i]->runCommand( "admin" , BSON( "getlasterror" << 1 << "fsync" << 1 ) , res ) )
-                    err = "cmd failed: ";
-            }
-            catch ( std::exception& e ) {
-                err += e.what();
-            }
-            catch ( ... ) {
-                err += "unknown failure";
-            }
-            _lastErrors.push_back( res.getOwned() );
-            errors.push_back( err );
+        // getlasterror+fsync round trips run concurrently, same as fsync() above
+        vector<BSONObj> res( _conns.size() );
+        vector<string> errors( _conns.size() );
+        {
+            vector< shared_ptr<boost::thread> > ts;
+            for ( size_t i=0; i<_conns.size(); i++ )
+                ts.push_back( shared_ptr<boost::thread>(
+                                  new boost::thread( boost::bind( &SyncClusterConnection::_checkLastOne , this , i , &res[i] , &errors[i] ) ) ) );
+            for ( size_t i=0; i<ts.size(); i++ )
+                ts[i]->join();
         }
 
+        for ( size_t i=0; i<res.size(); i++ )
+            _lastErrors.push_back( res[i] );
+
         assert( _lastErrors.size() == errors.size() && _lastErrors.size() == _conns.size() );
 
         stringstream err;
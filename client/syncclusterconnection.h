@@ -107,6 +107,12 @@ namespace mongo {
         void _checkLast();
         void _connect( string host );
 
+        // per-member workers for the parallel fan-outs in fsync() and _checkLast().
+        // they catch everything; failures are reported through the out params so
+        // the caller can aggregate and unwind consistently after joining.
+        void _fsyncOne( size_t i, string* err );
+        void _checkLastOne( size_t i, BSONObj* res, string* err );
+
         string _address;
         vector<string> _connAddresses;
         vector<DBClientConnection*> _conns;
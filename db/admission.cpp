@@ -0,0 +1,152 @@
+// admission.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "admission.h"
+#include "client.h"
+#include "commands.h"
+
+namespace mongo {
+
+    const char * admissionClassName( AdmissionClass cls ) {
+        switch ( cls ) {
+        case Admission_Interactive: return "interactive";
+        case Admission_Batch:       return "batch";
+        case Admission_System:      return "system";
+        default:                    return "";
+        }
+    }
+
+    AdmissionController::AdmissionController() : _lock( "AdmissionController" ) {
+        memset( _classes , 0 , sizeof(_classes) );
+
+        // interactive ops get most of the concurrency and a real queue;
+        // batch ops get a sliver and fail fast once it is full, so a tenant's
+        // scans back up on that tenant instead of on everyone
+        _classes[ Admission_Interactive ].limit = 64;
+        _classes[ Admission_Interactive ].maxQueueMillis = 100;
+        _classes[ Admission_Batch ].limit = 8;
+        _classes[ Admission_Batch ].maxQueueMillis = 10;
+        _classes[ Admission_System ].limit = 0; // shedding replication just moves the pain
+
+        for ( int i = 0; i < Admission_NumClasses; i++ )
+            _classes[i].name = admissionClassName( (AdmissionClass)i );
+    }
+
+    bool AdmissionController::admit( AdmissionClass cls ) {
+        scoped_lock lk( _lock );
+        PerClass& c = _classes[ cls ];
+
+        if ( c.limit == 0 || c.running < c.limit ) {
+            c.running++;
+            c.admitted++;
+            return true;
+        }
+
+        // queue until a slot frees or the class's deadline passes
+        boost::xtime deadline;
+        boost::xtime_get( &deadline , boost::TIME_UTC );
+        deadline.nsec += c.maxQueueMillis * 1000*1000;
+        if ( deadline.nsec >= 1000*1000*1000 ) {
+            deadline.nsec -= 1000*1000*1000;
+            deadline.sec += 1;
+        }
+
+        c.queued++;
+        while ( c.running >= c.limit ) {
+            if ( ! _freed.timed_wait( lk.boost() , deadline ) )
+                break;
+        }
+        c.queued--;
+
+        if ( c.running >= c.limit ) {
+            c.shed++;
+            return false;
+        }
+
+        c.running++;
+        c.admitted++;
+        return true;
+    }
+
+    void AdmissionController::release( AdmissionClass cls ) {
+        scoped_lock lk( _lock );
+        _classes[ cls ].running--;
+        dassert( _classes[ cls ].running >= 0 );
+        // one condition is shared by all classes, so wake everyone and let
+        // them recheck their own limit
+        _freed.notify_all();
+    }
+
+    void AdmissionController::append( BSONObjBuilder& b ) {
+        scoped_lock lk( _lock );
+        for ( int i = 0; i < Admission_NumClasses; i++ ) {
+            const PerClass& c = _classes[i];
+            BSONObjBuilder cb( b.subobjStart( c.name ) );
+            cb.append( "limit" , c.limit );
+            cb.append( "running" , c.running );
+            cb.append( "queued" , c.queued );
+            cb.appendNumber( "admitted" , c.admitted );
+            cb.appendNumber( "shed" , c.shed );
+            cb.done();
+        }
+    }
+
+    AdmissionController::Ticket::~Ticket() {
+        if ( _held )
+            admissionController.release( _cls );
+    }
+
+    bool AdmissionController::Ticket::admit( AdmissionClass cls ) {
+        dassert( ! _held );
+        _cls = cls;
+        _held = admissionController.admit( cls );
+        return _held;
+    }
+
+    AdmissionController admissionController;
+
+    /** lets a connection reclassify itself, e.g. a nightly report run tags
+        itself batch so its scans yield to interactive traffic under load */
+    class CmdSetAdmissionClass : public Command {
+    public:
+        CmdSetAdmissionClass() : Command( "setAdmissionClass" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help( stringstream& help ) const {
+            help << "{ setAdmissionClass : 'interactive'|'batch' }\n"
+                    "sets this connection's scheduling class for admission control";
+        }
+        virtual bool run( const string& , BSONObj& cmdObj , int , string& errmsg , BSONObjBuilder& result , bool ) {
+            string s = cmdObj.firstElement().valuestrsafe();
+            AdmissionClass cls;
+            if ( s == "interactive" )
+                cls = Admission_Interactive;
+            else if ( s == "batch" )
+                cls = Admission_Batch;
+            else {
+                errmsg = "admission class must be 'interactive' or 'batch'";
+                return false;
+            }
+            result.append( "was" , admissionClassName( cc().admissionClass() ) );
+            cc().setAdmissionClass( cls );
+            return true;
+        }
+    } cmdSetAdmissionClass;
+
+}
@@ -0,0 +1,83 @@
+// admission.h
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "../pch.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /** scheduling class of an operation.  connections default to interactive
+        and can reclassify themselves with the setAdmissionClass command;
+        replication traffic is recognized as system regardless of the tag. */
+    enum AdmissionClass {
+        Admission_Interactive = 0,  // point reads/writes; favored under load
+        Admission_Batch,            // scans, analytics; first to be shed
+        Admission_System,           // replication and the like; never shed
+        Admission_NumClasses
+    };
+
+    const char * admissionClassName( AdmissionClass cls );
+
+    /** bounded per-class concurrency, checked before any lock acquisition so
+        that under overload one tenant's table scans queue (and then fast-fail)
+        instead of starving everyone's point reads.  an op that cannot get a
+        slot waits up to its class's queue deadline and is then shed. */
+    class AdmissionController : boost::noncopyable {
+    public:
+        AdmissionController();
+
+        /** @return true if the op may proceed.  may block up to the class's
+            queue deadline first; false means the op should be shed. */
+        bool admit( AdmissionClass cls );
+        void release( AdmissionClass cls );
+
+        /** serverStatus: per-class running/queued/admitted/shed */
+        void append( BSONObjBuilder& b );
+
+        /** holds (at most) one admission slot, releasing it on destruction */
+        class Ticket : boost::noncopyable {
+        public:
+            Ticket() : _held(false), _cls(Admission_Interactive) {}
+            ~Ticket();
+            bool admit( AdmissionClass cls );
+        private:
+            bool _held;
+            AdmissionClass _cls;
+        };
+
+    private:
+        struct PerClass {
+            const char * name;
+            int limit;           // concurrent ops; 0 = unlimited
+            int maxQueueMillis;  // how long an op may wait for a slot
+            int running;
+            int queued;
+            long long admitted;
+            long long shed;
+        };
+
+        mongo::mutex _lock;
+        boost::condition _freed;
+        PerClass _classes[ Admission_NumClasses ];
+    };
+
+    extern AdmissionController admissionController;
+}
@@ -0,0 +1,229 @@
+/** @file backup.cpp
+    hot backup of the datafiles plus journal over the wire
+
+    with journaling on, the datafiles together with the journal are a recoverable
+    set: replaying the journal over a copy of the datafiles brings the copy to the
+    state at the end of the journal, no matter when during the copy each page was
+    read.  so a consistent backup does not need to block writes - it just needs the
+    journal files from the start of the copy onward to survive until the copy ends.
+
+    protocol:
+      { backupStart : 1 [, throttleMBps : <n>] }  freeze journal aging, commit a
+          sequence point, return the list of files to copy
+      { backupFetch : 1, file : <name>, offset : <n> [, length : <n>] }  one chunk
+      { backupEnd : 1 }  resume journal aging
+
+    the client copies the datafiles first and the journal files last (re-listing
+    them via backupStart's files array is not needed - fetch by name works for any
+    file that appears in the journal directory).  the journal 'lsn' file is
+    deliberately excluded: the restored copy must replay the whole preserved
+    journal, not skip sections the source had already flushed.
+*/
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "commands.h"
+#include "cmdline.h"
+#include "dur.h"
+#include "concurrency.h"
+#include "client.h"
+#include "../util/file.h"
+#include "../util/timer.h"
+
+using namespace boost::filesystem;
+
+namespace mongo {
+
+    namespace dur {
+        void setAgeOutJournalFiles(bool rotate);
+    }
+
+    /** state for the one backup allowed at a time */
+    class BackupState {
+    public:
+        BackupState() : m("backup"), active(false), throttleMBps(0), bytesSent(0) { }
+        mongo::mutex m;
+        bool active;
+        int throttleMBps; // 0 = unthrottled
+        long long bytesSent;
+        Timer since; // since backupStart, for throttling
+    } backupState;
+
+    static void listBackupFiles( const path& dir, const string& prefix, vector< pair<string,unsigned long long> >& out ) {
+        for( directory_iterator i( dir ); i != directory_iterator(); ++i ) {
+            path p = *i;
+            string name = p.leaf();
+            if( is_directory( p ) ) {
+                listBackupFiles( p, prefix + name + "/", out );
+                continue;
+            }
+            if( name == "mongod.lock" )
+                continue;
+            if( name == "lsn" || str::startsWith( name, "prealloc" ) )
+                continue; // see file comment re lsn; prealloc files are zeroes
+            out.push_back( make_pair( prefix + name, (unsigned long long) file_size( p ) ) );
+        }
+    }
+
+    class BackupStartCmd : public Command {
+    public:
+        BackupStartCmd() : Command( "backupStart" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual bool adminOnly() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help( stringstream& h ) const {
+            h << "begin a hot backup: freeze journal file aging and list the files to copy.\n"
+                 "{ backupStart : 1 [, throttleMBps : <n>] }\n"
+                 "requires --journal.  copy the journal files last, then call backupEnd -\n"
+                 "journal files accumulate on disk until you do.";
+        }
+
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
+            uassert( 16260, "backupStart requires --journal", cmdLine.dur );
+
+            scoped_lock lk( backupState.m );
+            if( backupState.active ) {
+                errmsg = "a backup is already in progress; call backupEnd first";
+                return false;
+            }
+
+            // preserve the journal from here on, then write a sequence point: every
+            // change after this commit is covered by a journal file we keep
+            dur::setAgeOutJournalFiles( false );
+            {
+                writelock w;
+                getDur().commitNow();
+            }
+
+            vector< pair<string,unsigned long long> > files;
+            listBackupFiles( path( dbpath ), "", files );
+
+            BSONArrayBuilder a( result.subarrayStart( "files" ) );
+            for( unsigned i = 0; i < files.size(); i++ ) {
+                BSONObjBuilder b( a.subobjStart() );
+                b.append( "name", files[i].first );
+                b.appendNumber( "size", (long long) files[i].second );
+                b.done();
+            }
+            a.done();
+
+            backupState.active = true;
+            backupState.throttleMBps = cmdObj["throttleMBps"].numberInt();
+            backupState.bytesSent = 0;
+            backupState.since.reset();
+            log() << "backupStart: journal aging frozen, " << files.size() << " files listed" << endl;
+            return true;
+        }
+    } backupStartCmd;
+
+    class BackupFetchCmd : public Command {
+    public:
+        BackupFetchCmd() : Command( "backupFetch" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual bool adminOnly() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help( stringstream& h ) const {
+            h << "fetch one chunk of a file during a hot backup - see backupStart.\n"
+                 "{ backupFetch : 1, file : <name>, offset : <n> [, length : <n>] }";
+        }
+
+        enum { MaxChunk = 8 * 1024 * 1024 };
+
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
+            int throttleMBps;
+            {
+                scoped_lock lk( backupState.m );
+                if( !backupState.active ) {
+                    errmsg = "no backup in progress; call backupStart first";
+                    return false;
+                }
+                throttleMBps = backupState.throttleMBps;
+            }
+
+            string name = cmdObj["file"].valuestrsafe();
+            uassert( 16261, "backupFetch: missing file name", !name.empty() );
+            uassert( 16262, "backupFetch: bad file name",
+                     name[0] != '/' && name[0] != '\\' && !str::contains( name, ".." ) );
+            uassert( 16263, "backupFetch: cannot fetch the journal lsn file",
+                     path( name ).leaf() != "lsn" );
+
+            long long offset = cmdObj["offset"].numberLong();
+            uassert( 16264, "backupFetch: bad offset", offset >= 0 );
+            long long length = cmdObj.hasElement( "length" ) ? cmdObj["length"].numberLong() : (long long) MaxChunk;
+            uassert( 16265, "backupFetch: bad length", length > 0 && length <= (long long) MaxChunk );
+
+            path full = path( dbpath ) / name;
+            uassert( 16268, str::stream() << "backupFetch: no such file " << name, exists( full ) );
+            File f;
+            f.open( full.string().c_str(), true );
+            uassert( 16266, str::stream() << "backupFetch: can't open " << name, f.is_open() && !f.bad() );
+
+            long long sz = f.len();
+            if( offset > sz )
+                offset = sz;
+            if( offset + length > sz )
+                length = sz - offset; // a file can shrink mid backup (journal rotation)
+
+            boost::scoped_array<char> buf( new char[length ? length : 1] );
+            if( length ) {
+                f.read( offset, buf.get(), (unsigned) length );
+                uassert( 16267, str::stream() << "backupFetch: read error on " << name, !f.bad() );
+            }
+
+            result.append( "file", name );
+            result.appendNumber( "offset", offset );
+            result.appendNumber( "fileSize", sz );
+            result.appendBinData( "data", (int) length, BinDataGeneral, buf.get() );
+
+            if( throttleMBps > 0 ) {
+                scoped_lock lk( backupState.m );
+                backupState.bytesSent += length;
+                long long expectedMillis = backupState.bytesSent / ( 1024 * 1024 / 1000 * throttleMBps );
+                long long aheadMillis = expectedMillis - backupState.since.millis();
+                if( aheadMillis > 0 )
+                    sleepmillis( (int) std::min( aheadMillis, (long long) 1000 ) );
+            }
+            return true;
+        }
+    } backupFetchCmd;
+
+    class BackupEndCmd : public Command {
+    public:
+        BackupEndCmd() : Command( "backupEnd" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual bool adminOnly() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help( stringstream& h ) const {
+            h << "finish a hot backup and resume journal file aging - see backupStart";
+        }
+
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
+            scoped_lock lk( backupState.m );
+            if( !backupState.active ) {
+                errmsg = "no backup in progress";
+                return false;
+            }
+            dur::setAgeOutJournalFiles( true );
+            backupState.active = false;
+            result.appendNumber( "bytesSent", backupState.bytesSent );
+            log() << "backupEnd: journal aging resumed, " << backupState.bytesSent << " bytes were streamed" << endl;
+            return true;
+        }
+    } backupEndCmd;
+
+}
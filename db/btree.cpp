@@ -192,6 +192,167 @@ namespace mongo {
         return kc;
     }
 
+    template< class V >
+    long long BtreeBucket<V>::countSubtree(const DiskLoc thisLoc) const {
+        killCurrentOp.checkForInterrupt();
+        long long kc = 0;
+        for ( int i = 0; i < this->n; i++ ) {
+            if ( this->k(i).isUsed() )
+                kc++;
+            const DiskLoc left = this->k(i).prevChildBucket;
+            if ( !left.isNull() )
+                kc += left.btree<V>()->countSubtree(left);
+        }
+        if ( !this->nextChild.isNull() ) {
+            DiskLoc ll = this->nextChild;
+            kc += ll.btree<V>()->countSubtree(ll);
+        }
+        return kc;
+    }
+
+    template< class V >
+    long long BtreeBucket<V>::rangeCount(const DiskLoc thisLoc, const Ordering &order,
+                                         const Key &lo, bool loInclusive,
+                                         const Key &hi, bool hiInclusive) const {
+        killCurrentOp.checkForInterrupt();
+
+        // lowPos: first position at or past the lower bound.  unused keys still
+        // participate in the tree's ordering, so comparing against them is fine -
+        // they are only skipped when counting.
+        int lowPos = this->n;
+        {
+            int l = 0, h = this->n - 1;
+            while ( l <= h ) {
+                int m = ( l + h ) / 2;
+                int x = this->keyNode(m).key.woCompare( lo, order );
+                if ( x > 0 || ( x == 0 && loInclusive ) ) {
+                    lowPos = m;
+                    h = m - 1;
+                }
+                else {
+                    l = m + 1;
+                }
+            }
+        }
+        // highPos: first position past the upper bound
+        int highPos = this->n;
+        {
+            int l = lowPos, h = this->n - 1;
+            while ( l <= h ) {
+                int m = ( l + h ) / 2;
+                int x = this->keyNode(m).key.woCompare( hi, order );
+                if ( x > 0 || ( x == 0 && !hiInclusive ) ) {
+                    highPos = m;
+                    h = m - 1;
+                }
+                else {
+                    l = m + 1;
+                }
+            }
+        }
+
+        long long kc = 0;
+        for ( int i = lowPos; i < highPos; i++ ) {
+            if ( this->k(i).isUsed() )
+                kc++;
+        }
+
+        if ( lowPos == highPos ) {
+            // the whole range falls between two adjacent keys of this bucket
+            const DiskLoc only = this->childForPos(lowPos);
+            if ( !only.isNull() )
+                kc += only.btree<V>()->rangeCount(only, order, lo, loInclusive, hi, hiInclusive);
+            return kc;
+        }
+
+        // the edge children can straddle a bound - descend into them with the bounds
+        const DiskLoc first = this->childForPos(lowPos);
+        if ( !first.isNull() )
+            kc += first.btree<V>()->rangeCount(first, order, lo, loInclusive, hi, hiInclusive);
+        const DiskLoc last = this->childForPos(highPos);
+        if ( !last.isNull() )
+            kc += last.btree<V>()->rangeCount(last, order, lo, loInclusive, hi, hiInclusive);
+
+        // children bracketed by two in-range keys are entirely within the range -
+        // count them without any further key comparisons
+        for ( int p = lowPos + 1; p < highPos; p++ ) {
+            const DiskLoc mid = this->childForPos(p);
+            if ( !mid.isNull() )
+                kc += mid.btree<V>()->countSubtree(mid);
+        }
+
+        return kc;
+    }
+
+    /** minimum keys in a bucket's in-range window before we trust picking a
+        separator key from it rather than descending a level for finer grain */
+    static const int QuantileMinKeys = 16;
+
+    template< class V >
+    bool BtreeBucket<V>::keyAtApproxQuantile(const DiskLoc thisLoc, const Ordering &order,
+                                             const Key &lo, const Key &hi,
+                                             double f, BSONObj& result) const {
+        killCurrentOp.checkForInterrupt();
+
+        // window of this bucket's keys lying in [lo, hi) - same searches as
+        // rangeCount() above, with chunk range inclusivity baked in
+        int lowPos = this->n;
+        {
+            int l = 0, h = this->n - 1;
+            while ( l <= h ) {
+                int m = ( l + h ) / 2;
+                if ( this->keyNode(m).key.woCompare( lo, order ) >= 0 ) {
+                    lowPos = m;
+                    h = m - 1;
+                }
+                else {
+                    l = m + 1;
+                }
+            }
+        }
+        int highPos = this->n;
+        {
+            int l = lowPos, h = this->n - 1;
+            while ( l <= h ) {
+                int m = ( l + h ) / 2;
+                if ( this->keyNode(m).key.woCompare( hi, order ) >= 0 ) {
+                    highPos = m;
+                    h = m - 1;
+                }
+                else {
+                    l = m + 1;
+                }
+            }
+        }
+
+        const int w = highPos - lowPos;
+
+        // view the window as w+1 equally weighted child slots separated by w
+        // keys and place the fraction among them
+        double t = f * ( w + 1 );
+        int slot = (int) t;
+        if ( slot > w )
+            slot = w;
+
+        if ( w < QuantileMinKeys ) {
+            // too few separators here to resolve f - descend for finer grain.
+            // the bounds are passed through unchanged: for an interior child the
+            // searches above just select the child's whole window.
+            const DiskLoc child = this->childForPos( lowPos + slot );
+            if ( !child.isNull() )
+                return child.btree<V>()->keyAtApproxQuantile( child, order, lo, hi, t - slot, result );
+        }
+
+        if ( w == 0 )
+            return false;
+
+        int i = lowPos + slot;
+        if ( i > highPos - 1 )
+            i = highPos - 1;
+        result = this->keyNode(i).key.toBson();
+        return true;
+    }
+
     int nDumped = 0;
 
     template< class V >
@@ -544,14 +705,17 @@ namespace mongo {
      * This function is expected to be called on a packed bucket.
      */
     template< class V >
-    int BucketBasics<V>::splitPos( int keypos ) const {
+    int BucketBasics<V>::splitPos( int keypos, int fillFactor ) const {
         assert( this->n > 2 );
+        dassert( fillFactor >= 50 && fillFactor <= 99 );
         int split = 0;
         int rightSize = 0;
-        // when splitting a btree node, if the new key is greater than all the other keys, we should not do an even split, but a 90/10 split.
+        // when splitting a btree node, if the new key is greater than all the other keys, we should
+        // not do an even split, but a fillFactor (by default 90/10) split.
         // see SERVER-983
         // TODO I think we only want to do the 90% split on the rhs node of the tree.
-        int rightSizeLimit = ( this->topSize + sizeof( _KeyNode ) * this->n ) / ( keypos == this->n ? 10 : 2 );
+        int totalSize = this->topSize + sizeof( _KeyNode ) * this->n;
+        int rightSizeLimit = keypos == this->n ? totalSize * ( 100 - fillFactor ) / 100 : totalSize / 2;
         for( int i = this->n - 1; i > -1; --i ) {
             rightSize += keyNode( i ).key.dataSize() + sizeof( _KeyNode );
             if ( rightSize > rightSizeLimit ) {
@@ -758,9 +922,20 @@ namespace mongo {
         if( guessIncreasing ) {
             m = h;
         }
+        // leading fields of key known equal to the fence keys just below l and just above h.
+        // every candidate key sorts between the fences, so it shares at least
+        // min(loMatched,hiMatched) leading fields with key and compares can skip them.
+        // a big win for compound indexes whose early fields have few distinct values.
+        int loMatched = 0, hiMatched = 0;
+        const bool compactKey = key.isCompactFormat();
         while ( l <= h ) {
             KeyNode M = this->keyNode(m);
-            int x = key.woCompare(M.key, order);
+            int x;
+            int matched = 0;
+            if( compactKey && M.key.isCompactFormat() )
+                x = key.woCompareSkipMatched(M.key, order, min(loMatched, hiMatched), &matched);
+            else
+                x = key.woCompare(M.key, order);
             if ( x == 0 ) {
                 if( assertIfDup ) {
                     if( k(m).isUnused() ) {
@@ -789,10 +964,14 @@ namespace mongo {
                 unusedRL.GETOFS() &= ~1; // so we can test equality without the used bit messing us up
                 x = recordLoc.compare(unusedRL);
             }
-            if ( x < 0 ) // key < M.key
+            if ( x < 0 ) { // key < M.key
                 h = m-1;
-            else if ( x > 0 )
+                hiMatched = matched;
+            }
+            else if ( x > 0 ) {
                 l = m+1;
+                loMatched = matched;
+            }
             else {
                 // found it.
                 pos = m;
@@ -1226,6 +1405,33 @@ namespace mongo {
         return false;
     }
 
+    template< class V >
+    void BtreeBucket<V>::_findUnderfull( const DiskLoc& thisLoc, bool isRoot, vector<DiskLoc>& candidates ) {
+        const BtreeBucket *b = BTREE(thisLoc);
+        if ( !isRoot && b->packedDataSize( 0 ) < lowWaterMark() ) {
+            candidates.push_back( thisLoc );
+        }
+        for ( int i = 0; i <= b->n; i++ ) {
+            DiskLoc child = b->childForPos( i );
+            if ( !child.isNull() ) {
+                _findUnderfull( child, false, candidates );
+            }
+        }
+    }
+
+    template< class V >
+    void BtreeBucket<V>::findUnderfullBuckets( const DiskLoc& thisLoc, vector<DiskLoc>& candidates ) {
+        _findUnderfull( thisLoc, true, candidates );
+    }
+
+    template< class V >
+    bool BtreeBucket<V>::rebalanceBucket( const DiskLoc& loc, IndexDetails& id, const Ordering& order ) {
+        // mayBalanceWithNeighbors declines stale candidates itself: a freed bucket
+        // has a null parent (deallocBucket) and one that grew back is no longer
+        // below the water mark.
+        return BTREE(loc)->mayBalanceWithNeighbors( loc, id, order );
+    }
+
     /** remove a key from the index */
     template< class V >
     bool BtreeBucket<V>::unindex(const DiskLoc thisLoc, IndexDetails& id, const BSONObj& key, const DiskLoc recordLoc ) const {
@@ -1366,7 +1572,7 @@ namespace mongo {
         if ( split_debug )
             out() << "    " << thisLoc.toString() << ".split" << endl;
 
-        int split = this->splitPos( keypos );
+        int split = this->splitPos( keypos, idx.splitFillFactor() );
         DiskLoc rLoc = addBucket(idx);
         BtreeBucket *r = rLoc.btreemod<V>();
         if ( split_debug )
@@ -1518,6 +1724,7 @@ namespace mongo {
 
     template< class V >
     DiskLoc BtreeBucket<V>::locate(const IndexDetails& idx, const DiskLoc& thisLoc, const Key& key, const Ordering &order, int& pos, bool& found, const DiskLoc &recordLoc, int direction) const {
+        noteIndexPageAccess( this ); // runs at every level of the descent
         int p;
         found = find(idx, key, recordLoc, order, p, /*assertIfDup*/ false);
         if ( found ) {
@@ -1582,6 +1789,45 @@ namespace mongo {
      */
     template< class V >
     void BtreeBucket<V>::advanceTo(DiskLoc &thisLoc, int &keyOfs, const BSONObj &keyBegin, int keyBeginLen, bool afterKey, const vector< const BSONElement * > &keyEnd, const vector< bool > &keyEndInclusive, const Ordering &order, int direction ) const {
+        // multi interval bounds ($in etc.) call this once per interval and
+        // consecutive intervals usually land within a few keys of the current
+        // position.  probe the next few keys of this bucket first so the common
+        // case costs one or two comparisons instead of a binary search (or a
+        // climb toward the root) per interval.  no hit within the probe window
+        // means the target is far; fall through to the regular machinery.
+        {
+            const int MaxLinearProbe = 8;
+            if ( direction > 0 ) {
+                int end = this->n - 1;
+                if ( end - keyOfs > MaxLinearProbe )
+                    end = keyOfs + MaxLinearProbe;
+                for ( int p = keyOfs + 1; p <= end; p++ ) {
+                    if ( customBSONCmp( keyNode( p ).key.toBson(), keyBegin, keyBeginLen, afterKey, keyEnd, keyEndInclusive, order, direction ) >= 0 ) {
+                        if ( this->k( p ).prevChildBucket.isNull() ) {
+                            // keys before p are < target and nothing hangs in between
+                            keyOfs = p;
+                            return;
+                        }
+                        break; // target may be in the subtree left of p
+                    }
+                }
+            }
+            else {
+                int end = 0;
+                if ( keyOfs - end > MaxLinearProbe )
+                    end = keyOfs - MaxLinearProbe;
+                for ( int p = keyOfs - 1; p >= end; p-- ) {
+                    if ( customBSONCmp( keyNode( p ).key.toBson(), keyBegin, keyBeginLen, afterKey, keyEnd, keyEndInclusive, order, direction ) <= 0 ) {
+                        if ( this->k( p + 1 ).prevChildBucket.isNull() ) {
+                            keyOfs = p;
+                            return;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
         int l,h;
         bool dontGoUp;
         if ( direction > 0 ) {
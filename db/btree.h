@@ -546,8 +546,11 @@ namespace mongo {
          * @return the key index to be promoted on split
          * @param keypos The requested index of a key to insert, which may affect
          *  the choice of split position.
+         * @param fillFactor percent of the bucket kept on the left when the insert
+         *  is at the right edge (mostly ascending keys) - see
+         *  IndexDetails::splitFillFactor().
          */
-        int splitPos( int keypos ) const;
+        int splitPos( int keypos, int fillFactor = 90 ) const;
 
         /**
          * Preconditions: nAdd * sizeof( _KeyNode ) <= emptySize
@@ -624,6 +627,35 @@ namespace mongo {
         void dumpTree(const DiskLoc &thisLoc, const BSONObj &order) const;
         long long fullValidate(const DiskLoc& thisLoc, const BSONObj &order, long long *unusedCount = 0, bool strict = false, unsigned depth=0) const; /* traverses everything */
 
+        /**
+         * Count the used keys between lo and hi (inclusivity per the flags)
+         * beneath this bucket without materializing a cursor.  Keys sitting in
+         * a bucket are counted in place and children lying strictly between
+         * two in-range keys are counted whole via countSubtree(), so key
+         * comparisons only happen along the two edge paths of the range.
+         * lo must not sort after hi in 'order'.  Caller must hold at least a
+         * read lock; like fullValidate() this does not yield.
+         */
+        long long rangeCount(const DiskLoc thisLoc, const Ordering &order,
+                             const Key &lo, bool loInclusive,
+                             const Key &hi, bool hiInclusive) const;
+
+        /** count every used key at and below this bucket */
+        long long countSubtree(const DiskLoc thisLoc) const;
+
+        /**
+         * Approximate the key lying at fraction 'f' (0 < f < 1) of the keys
+         * in [lo, hi) by descending on bucket key counts instead of walking
+         * entries.  Buckets do not store subtree sizes, so sibling subtrees
+         * are assumed evenly filled; the error is bounded by the slot
+         * granularity of the bucket the key is finally read from.  O(tree
+         * depth).  Used for split point estimation (s/d_split.cpp).
+         * @return false if the range resolves to no keys.
+         */
+        bool keyAtApproxQuantile(const DiskLoc thisLoc, const Ordering &order,
+                                 const Key &lo, const Key &hi,
+                                 double f, BSONObj& result) const;
+
         bool isUsed( int i ) const { return this->k(i).isUsed(); }
         string bucketSummary() const;
         void dump(unsigned depth=0) const;
@@ -699,6 +731,25 @@ namespace mongo {
          */
         bool unindex(const DiskLoc thisLoc, IndexDetails& id, const BSONObj& key, const DiskLoc recordLoc) const;
 
+        /**
+         * Depth first scan collecting every non root bucket whose packed data size
+         * is below lowWaterMark - the candidates for an online rebalance pass (see
+         * the rebalanceIndexes command).
+         */
+        static void findUnderfullBuckets( const DiskLoc& thisLoc, vector<DiskLoc>& candidates );
+
+        /**
+         * One step of the online rebalance pass: balance or merge the candidate
+         * bucket with a neighbor via mayBalanceWithNeighbors.  The candidate may be
+         * stale if the write lock was yielded since findUnderfullBuckets: a bucket
+         * freed by an earlier merge has a null parent and is left alone (bucket
+         * storage is recycled within its own index namespace only, so the location
+         * can never refer to another index), as is one that has grown back over the
+         * water mark.
+         * @return true if the tree was changed
+         */
+        static bool rebalanceBucket( const DiskLoc& loc, IndexDetails& id, const Ordering& order );
+
         /**
          * locate may return an "unused" key that is just a marker.  so be careful.
          *   looks for a key:recordloc pair.
@@ -786,6 +837,9 @@ namespace mongo {
          */
         bool mayBalanceWithNeighbors(const DiskLoc thisLoc, IndexDetails &id, const Ordering &order) const;
 
+        /** recursive helper for findUnderfullBuckets - the root itself is never a candidate */
+        static void _findUnderfull( const DiskLoc& thisLoc, bool isRoot, vector<DiskLoc>& candidates );
+
         /**
          * Preconditions:
          *  - 0 <= leftIndex < n
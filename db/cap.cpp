@@ -110,15 +110,15 @@ namespace mongo {
             //capFirstNewRecord = DiskLoc();
             capFirstNewRecord.writing().setInvalid();
             // put all the DeletedRecords in cappedListOfAllDeletedRecords()
-            for ( int i = 1; i < Buckets; ++i ) {
-                DiskLoc first = deletedList[ i ];
+            for ( int i = 1; i < AllocBuckets; ++i ) { // logical bucket 0 is physical slot 0 == cappedListOfAllDeletedRecords()
+                DiskLoc first = deletedListEntry( i );
                 if ( first.isNull() )
                     continue;
                 DiskLoc last = first;
                 for (; !last.drec()->nextDeleted.isNull(); last = last.drec()->nextDeleted );
                 last.drec()->nextDeleted.writing() = cappedListOfAllDeletedRecords();
                 cappedListOfAllDeletedRecords().writing() = first;
-                deletedList[i].writing() = DiskLoc();
+                deletedListEntry(i).writing() = DiskLoc();
             }
             // NOTE cappedLastDelRecLastExtent() set to DiskLoc() in above
 
@@ -250,7 +250,30 @@ namespace mongo {
             }
 
             DiskLoc fr = theCapExtent()->firstRecord;
+
+            /* slot reuse fast path.  in the looped steady state record sizes are
+               usually fixed-ish, so the oldest record's slot is exactly what we
+               need: free it and claim it directly, skipping compact() and the
+               rescan.  we require another deleted record in the cap extent first
+               so the every-extent-has-a-deleted-record invariant holds even when
+               the fit is exact (alloc() then skips carving off a sliver).
+            */
+            bool reuse = false;
+            if ( fr.rec()->lengthWithHeaders >= len ) {
+                DiskLoc firstDel = cappedFirstDeletedInCurExtent();
+                reuse = !firstDel.isNull() && inCapExtent( firstDel );
+            }
+
             theDataFileMgr.deleteRecord(ns, fr.rec(), fr, true); // ZZZZZZZZZZZZ
+
+            if ( reuse && cappedFirstDeletedInCurExtent() == fr ) {
+                // the freed slot is the head of this extent's delete chain; unlink it
+                getDur().writingDiskLoc( cappedFirstDeletedInCurExtent() ) = fr.drec()->nextDeleted;
+                fr.drec()->nextDeleted.writing().setInvalid(); // defensive.
+                loc = fr;
+                break;
+            }
+
             compact();
             if( ++passes > maxPasses ) {
                 log() << "passes ns:" << ns << " len:" << len << " maxPasses: " << maxPasses << '\n';
@@ -34,8 +34,14 @@
 #include "../util/mongoutils/checksum.h"
 #include "../util/file_allocator.h"
 #include "repl/rs.h"
+#include "stats/lockstat.h"
 #include "../scripting/engine.h"
 
+#if defined(__linux__)
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
 namespace mongo {
   
     Client* Client::syncThread;
@@ -105,13 +111,26 @@ namespace mongo {
         return *c;
     }
 
+    Client* Client::detachThread() {
+        Client *c = currentClient.release();
+        assert( c );
+        return c;
+    }
+
+    void Client::attachThread( Client* c ) {
+        assert( c );
+        assert( currentClient.get() == 0 );
+        currentClient.reset( c );
+    }
+
     Client::Client(const char *desc, AbstractMessagingPort *p) :
         _context(0),
         _shutdown(false),
         _desc(desc),
         _god(0),
         _lastOp(0),
-        _mp(p) {
+        _mp(p),
+        _admissionClass(Admission_Interactive) {
         _connectionId = setThreadName(desc);
         _curOp = new CurOp( this );
 #ifndef _WIN32
@@ -263,7 +282,10 @@ namespace mongo {
             break;
         default: {
             string errmsg;
-            if ( ! shardVersionOk( _ns , errmsg ) ) {
+            // commands arrive as dbQuery but may carry writes (findAndModify,
+            // mapreduce with out, ...), so only a plain query counts as a read
+            bool isRead = _client->_curOp->getOp() == dbQuery && ! _client->_curOp->isCommand();
+            if ( ! shardVersionOk( _ns , isRead , errmsg ) ) {
                 ostringstream os;
                 os << "[" << _ns << "] shard version not ok in Client::Context: " << errmsg;
                 throw SendStaleConfigException( _ns, os.str() );
@@ -282,6 +304,7 @@ namespace mongo {
         _db(db)
     {
         assert(_db);
+        _db->lastUse = time(0);
         checkNotStale();
         _client->_context = this;
         _client->_curOp->enter( this );
@@ -298,6 +321,7 @@ namespace mongo {
         }
         _db = dbHolderUnchecked().getOrCreate( _ns , _path , _justCreated );
         assert(_db);
+        _db->lastUse = time(0);
         checkNotStale();
         _client->_context = this;
         _client->_curOp->enter( this );
@@ -380,6 +404,28 @@ namespace mongo {
             co->gotLock();
     }
 
+    /** see mongomutex.h.  attributes the hold to the op running on this thread;
+        internal threads (journal, repl writers) that have no client show as
+        "internal". */
+    void lockProfilerRecordWriteLock( unsigned long long holdMicros , unsigned long long waitMicros ) {
+        char desc[ LockHoldProfile::DescSize ];
+        Client * c = currentClient.get();
+        CurOp * co = c ? c->curop() : 0;
+        if ( co ) {
+            strncpy( desc , opToString( co->getOp() ) , sizeof(desc) - 1 );
+            desc[ sizeof(desc) - 1 ] = 0;
+            const char * ns = co->getNS();
+            if ( ns && ns[0] ) {
+                strncat( desc , " " , sizeof(desc) - strlen(desc) - 1 );
+                strncat( desc , ns , sizeof(desc) - strlen(desc) - 1 );
+            }
+        }
+        else {
+            strcpy( desc , "internal" );
+        }
+        lockHoldProfile.record( desc , holdMicros , waitMicros );
+    }
+
     void KillCurrentOp::interruptJs( AtomicUInt *op ) {
         if ( !globalScriptEngine )
             return;
@@ -437,6 +483,45 @@ namespace mongo {
         _checkpoint = now;
     }
 
+    void CurOp::markResourceStart() {
+        _cpuStartNanos = 0;
+        _minfltStart = _majfltStart = -1;
+#if defined(__linux__)
+        timespec ts;
+        if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID , &ts ) == 0 )
+            _cpuStartNanos = (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#if defined(RUSAGE_THREAD)
+        rusage ru;
+        if ( getrusage( RUSAGE_THREAD , &ru ) == 0 ) {
+            _minfltStart = ru.ru_minflt;
+            _majfltStart = ru.ru_majflt;
+        }
+#endif
+#endif
+    }
+
+    void CurOp::recordResourceUsage() {
+#if defined(__linux__)
+        if ( _cpuStartNanos ) {
+            timespec ts;
+            if ( clock_gettime( CLOCK_THREAD_CPUTIME_ID , &ts ) == 0 ) {
+                unsigned long long now = (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+                if ( now > _cpuStartNanos )
+                    _debug.cpuMicros = (long long)( ( now - _cpuStartNanos ) / 1000 );
+            }
+        }
+#if defined(RUSAGE_THREAD)
+        if ( _minfltStart >= 0 ) {
+            rusage ru;
+            if ( getrusage( RUSAGE_THREAD , &ru ) == 0 ) {
+                _debug.minorFaults = (int)( ru.ru_minflt - _minfltStart );
+                _debug.majorFaults = (int)( ru.ru_majflt - _majfltStart );
+            }
+        }
+#endif
+#endif
+    }
+
 
     BSONObj CurOp::infoNoauth() {
         BSONObjBuilder b;
@@ -681,7 +766,11 @@ namespace mongo {
         fastmodinsert = false;
         upsert = false;
         keyUpdates = 0;  // unsigned, so -1 not possible
-        
+
+        cpuMicros = 0;
+        minorFaults = 0;
+        majorFaults = 0;
+
         exceptionInfo.reset();
         
         executionTime = 0;
@@ -725,7 +814,11 @@ namespace mongo {
         OPDEBUG_TOSTRING_HELP( fastmodinsert );
         OPDEBUG_TOSTRING_HELP( upsert );
         OPDEBUG_TOSTRING_HELP( keyUpdates );
-        
+
+        OPDEBUG_TOSTRING_HELP( cpuMicros );
+        OPDEBUG_TOSTRING_HELP( minorFaults );
+        OPDEBUG_TOSTRING_HELP( majorFaults );
+
         if ( extra.len() )
             s << " " << extra.str();
 
@@ -770,7 +863,14 @@ namespace mongo {
         OPDEBUG_APPEND_BOOL( upsert );
         OPDEBUG_APPEND_NUMBER( keyUpdates );
 
-        if ( ! exceptionInfo.empty() ) 
+        if ( cpuMicros )
+            b.appendNumber( "cpuMicros" , cpuMicros );
+        if ( minorFaults )
+            b.append( "minorFaults" , minorFaults );
+        if ( majorFaults )
+            b.append( "majorFaults" , majorFaults );
+
+        if ( ! exceptionInfo.empty() )
             exceptionInfo.append( b , "exception" , "exceptionCode" );
         
         OPDEBUG_APPEND_NUMBER( nreturned );
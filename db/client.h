@@ -29,6 +29,8 @@
 #include "security.h"
 #include "namespace-inl.h"
 #include "lasterror.h"
+#include "oparena.h"
+#include "admission.h"
 #include "stats/top.h"
 #include "../util/concurrency/threadlocal.h"
 #include "../db/client_common.h"
@@ -67,12 +69,23 @@ namespace mongo {
         */
         static Client& initThread(const char *desc, AbstractMessagingPort *mp = 0);
 
-        static void initThreadIfNotAlready(const char *desc) { 
+        static void initThreadIfNotAlready(const char *desc) {
             if( currentClient.get() )
                 return;
             initThread(desc);
         }
 
+        /** take this thread's Client out of TLS without destroying it, so an
+         *  event-driven message server can park a connection's state while no
+         *  thread is servicing it.  pair with attachThread().
+         */
+        static Client* detachThread();
+
+        /** re-associate a Client previously returned by detachThread() with the
+         *  current thread.  the thread must not already have a Client.
+         */
+        static void attachThread( Client* c );
+
         /** this has to be called as the client goes away, but before thread termination
          *  @return true if anything was done
          */
@@ -114,6 +127,13 @@ namespace mongo {
         AbstractMessagingPort * port() const { return _mp; }
         ConnectionId getConnectionId() const { return _connectionId; }
 
+        /** per-operation scratch memory - see OpArena for the lifetime rules */
+        OpArena& opArena() { return _opArena; }
+
+        /** scheduling class used by admission control - see db/admission.h */
+        AdmissionClass admissionClass() const { return _admissionClass; }
+        void setAdmissionClass( AdmissionClass cls ) { _admissionClass = cls; }
+
     private:
         Client(const char *desc, AbstractMessagingPort *p = 0);
         friend class CurOp;
@@ -130,6 +150,8 @@ namespace mongo {
         BSONObj _remoteId;
         AbstractMessagingPort * const _mp;
         unsigned _sometimes;
+        OpArena _opArena;
+        AdmissionClass _admissionClass;
 
     public:
         /** the concept here is the same as MONGO_SOMETIMES.  however that 
@@ -29,25 +29,71 @@
 #include "db.h"
 #include "commands.h"
 #include "repl_block.h"
+#include "ops/query.h"
 #include "../util/processinfo.h"
 #include "../util/timer.h"
+#include "../util/concurrency/spin_lock.h"
 
 namespace mongo {
 
-    CCById ClientCursor::clientCursorsById;
+    ClientCursor::IdBucket ClientCursor::_idBuckets[ClientCursor::NumIdBuckets];
     boost::recursive_mutex& ClientCursor::ccmutex( *(new boost::recursive_mutex()) );
     long long ClientCursor::numberTimedOut = 0;
 
     void aboutToDeleteForSharding( const Database* db , const DiskLoc& dl ); // from s/d_logic.h
 
+    /** erase cc from its id bucket, taking ownership of deleting it.
+        whoever wins the claim deletes; a loser must not touch the cursor again
+        once it stops holding a lock the winner's destructor will want (the
+        destructor reacquires ccmutex and the bucket itself, so a claim loser
+        holding either of those keeps the object alive until it releases).
+    */
+    bool ClientCursor::_claim(ClientCursor *cc) {
+        IdBucket& b = _bucketFor(cc->_cursorid);
+        recursive_scoped_lock lock(b.m);
+        CCById::iterator it = b.byId.find(cc->_cursorid);
+        if ( it == b.byId.end() || it->second != cc )
+            return false; // someone else claimed it
+        b.byId.erase(it);
+        return true;
+    }
+
+    bool ClientCursor::erase(CursorId id) {
+        ClientCursor *cc;
+        {
+            IdBucket& b = _bucketFor(id);
+            recursive_scoped_lock lock(b.m);
+            cc = find_inlock(b, id);
+            if ( !cc )
+                return false;
+            assert( cc->_pinValue < 100 ); // you can't still have an active ClientCursor::Pointer
+            b.byId.erase(id); // claimed
+        }
+        // not in the bucket anymore so no one else can claim it; safe to delete
+        // outside the bucket mutex (the destructor takes ccmutex for byLoc)
+        delete cc;
+        return true;
+    }
+
+    unsigned ClientCursor::numCursors() {
+        unsigned sum = 0;
+        for( int i = 0; i < NumIdBuckets; i++ ) {
+            recursive_scoped_lock lock(_idBuckets[i].m);
+            sum += _idBuckets[i].byId.size();
+        }
+        return sum;
+    }
+
     /*static*/ void ClientCursor::assertNoCursors() {
-        recursive_scoped_lock lock(ccmutex);
-        if( clientCursorsById.size() ) {
-            log() << "ERROR clientcursors exist but should not at this point" << endl;
-            ClientCursor *cc = clientCursorsById.begin()->second;
-            log() << "first one: " << cc->_cursorid << ' ' << cc->_ns << endl;
-            clientCursorsById.clear();
-            assert(false);
+        for( int i = 0; i < NumIdBuckets; i++ ) {
+            recursive_scoped_lock lock(_idBuckets[i].m);
+            if( _idBuckets[i].byId.size() ) {
+                log() << "ERROR clientcursors exist but should not at this point" << endl;
+                ClientCursor *cc = _idBuckets[i].byId.begin()->second;
+                log() << "first one: " << cc->_cursorid << ' ' << *cc->_ns << endl;
+                _idBuckets[i].byId.clear();
+                assert(false);
+            }
         }
     }
 
@@ -67,6 +113,7 @@ namespace mongo {
         if ( !L.isNull() )
             bl[ByLocKey(L,_cursorid)] = this;
         _lastLoc = L;
+        _db->ccByLocCount = (int) bl.size();
     }
 
     /* ------------------------------------------- */
@@ -86,29 +133,41 @@ namespace mongo {
 
         {
             //cout << "\nTEMP invalidate " << ns << endl;
-            recursive_scoped_lock lock(ccmutex);
-
             Database *db = cc().database();
             assert(db);
             assert( str::startsWith(ns, db->name) );
 
-            for( CCById::iterator i = clientCursorsById.begin(); i != clientCursorsById.end(); /*++i*/ ) {
-                ClientCursor *cc = i->second;
-
-                ++i; // we may be removing this node
-
-                if( cc->_db != db )
-                    continue;
-
-                if (isDB) {
-                    // already checked that db matched above
-                    dassert( str::startsWith(cc->_ns.c_str(), ns) );
-                    delete cc; //removes self from ccByID
-                }
-                else {
-                    if ( str::equals(cc->_ns.c_str(), ns) )
-                        delete cc; //removes self from ccByID
+            for( int bi = 0; bi < NumIdBuckets; bi++ ) {
+                vector<ClientCursor*> toDelete;
+                {
+                    IdBucket& b = _idBuckets[bi];
+                    recursive_scoped_lock lock(b.m);
+                    for( CCById::iterator i = b.byId.begin(); i != b.byId.end(); /*++i*/ ) {
+                        ClientCursor *cc = i->second;
+
+                        ++i; // we may be removing this node
+
+                        if( cc->_db != db )
+                            continue;
+
+                        bool kill;
+                        if (isDB) {
+                            // already checked that db matched above
+                            dassert( str::startsWith(cc->_ns->c_str(), ns) );
+                            kill = true;
+                        }
+                        else {
+                            kill = str::equals(cc->_ns->c_str(), ns);
+                        }
+                        if ( kill ) {
+                            b.byId.erase( cc->_cursorid ); // claimed - a racing killCursors won't find it
+                            toDelete.push_back(cc);
+                        }
+                    }
                 }
+                // delete outside the bucket mutex; the destructor takes ccmutex for byLoc
+                for( vector<ClientCursor*>::iterator i = toDelete.begin(); i != toDelete.end(); ++i )
+                    delete *i;
             }
 
             /*
@@ -146,42 +205,52 @@ namespace mongo {
         // two passes so that we don't need to readlock unless we really do some timeouts
         // we assume here that incrementing _idleAgeMillis outside readlock is ok.
         {
-            recursive_scoped_lock lock(ccmutex);
+            unsigned sz = 0;
+            for( int bi = 0; bi < NumIdBuckets; bi++ ) {
+                IdBucket& b = _idBuckets[bi];
+                recursive_scoped_lock lock(b.m);
+                sz += b.byId.size();
+                for ( CCById::iterator i = b.byId.begin(); i != b.byId.end(); ++i ) {
+                    if( i->second->shouldTimeout( millis ) )
+                        foundSomeToTimeout = true;
+                }
+            }
             {
-                unsigned sz = clientCursorsById.size();
                 static time_t last;
-                if( sz >= 100000 ) { 
+                if( sz >= 100000 ) {
                     if( time(0) - last > 300 ) {
                         last = time(0);
                         log() << "warning number of open cursors is very large: " << sz << endl;
                     }
                 }
             }
-            for ( CCById::iterator i = clientCursorsById.begin(); i != clientCursorsById.end();  ) {
-                CCById::iterator j = i;
-                i++;
-                if( j->second->shouldTimeout( millis ) ) {
-                    foundSomeToTimeout = true;
-                    break;
-                }
-            }
         }
 
         if( foundSomeToTimeout ) {
-            // todo: ideally all readlocks automatically note what we are locking for so this 
+            // todo: ideally all readlocks automatically note what we are locking for so this
             // can be reported in currentop command. e.g. something like:
             //   readlock lk("", "timeout cursors");
             readlock lk("");
-            recursive_scoped_lock lock(ccmutex);
-            for ( CCById::iterator i = clientCursorsById.begin(); i != clientCursorsById.end();  ) {
-                CCById::iterator j = i;
-                i++;
-                if( j->second->shouldTimeout(0) ) {
-                    numberTimedOut++;
-                    LOG(1) << "killing old cursor " << j->second->_cursorid << ' ' << j->second->_ns
-                           << " idle:" << j->second->idleTime() << "ms\n";
-                    delete j->second;
+            for( int bi = 0; bi < NumIdBuckets; bi++ ) {
+                vector<ClientCursor*> toDelete;
+                {
+                    IdBucket& b = _idBuckets[bi];
+                    recursive_scoped_lock lock(b.m);
+                    for ( CCById::iterator i = b.byId.begin(); i != b.byId.end();  ) {
+                        CCById::iterator j = i;
+                        i++;
+                        if( j->second->shouldTimeout(0) ) {
+                            numberTimedOut++; // only written by this monitor thread
+                            LOG(1) << "killing old cursor " << j->second->_cursorid << ' ' << *j->second->_ns
+                                   << " idle:" << j->second->idleTime() << "ms\n";
+                            toDelete.push_back(j->second);
+                            b.byId.erase(j); // claimed
+                        }
+                    }
                 }
+                // delete outside the bucket mutex; the destructor takes ccmutex for byLoc
+                for( vector<ClientCursor*>::iterator i = toDelete.begin(); i != toDelete.end(); ++i )
+                    delete *i;
             }
         }
     }
@@ -190,8 +259,10 @@ namespace mongo {
        note this is potentially slow
     */
     void ClientCursor::informAboutToDeleteBucket(const DiskLoc& b) {
-        recursive_scoped_lock lock(ccmutex);
         Database *db = cc().database();
+        if( db->ccByLocCount == 0 )
+            return; // see aboutToDelete for why this unlocked check is safe
+        recursive_scoped_lock lock(ccmutex);
         CCByLoc& bl = db->ccByLoc;
         RARELY if ( bl.size() > 70 ) {
             log() << "perf warning: byLoc.size=" << bl.size() << " in aboutToDeleteBucket\n";
@@ -208,12 +279,19 @@ namespace mongo {
 
     /* must call this on a delete so we clean up the cursors. */
     void ClientCursor::aboutToDelete(const DiskLoc& dl) {
-        recursive_scoped_lock lock(ccmutex);
-
         Database *db = cc().database();
         assert(db);
 
-        aboutToDeleteForSharding( db , dl );
+        aboutToDeleteForSharding( db , dl ); // has its own locking
+
+        // fast path: no cursor in this database has a saved position, so don't
+        // touch ccmutex at all.  cursors can only gain a position under at least
+        // a read lock, which our write lock excludes; the unlocked read can at
+        // worst see a dying cursor's count as nonzero and take the slow path.
+        if( db->ccByLocCount == 0 )
+            return;
+
+        recursive_scoped_lock lock(ccmutex);
 
         CCByLoc& bl = db->ccByLoc;
         CCByLoc::iterator j = bl.lower_bound(ByLocKey::min(dl));
@@ -234,8 +312,8 @@ namespace mongo {
         if( toAdvance.size() >= 3000 ) {
             log() << "perf warning MPW101: " << toAdvance.size() << " cursors for one diskloc "
                   << dl.toString()
-                  << ' ' << toAdvance[1000]->_ns
-                  << ' ' << toAdvance[2000]->_ns
+                  << ' ' << *toAdvance[1000]->_ns
+                  << ' ' << *toAdvance[2000]->_ns
                   << ' ' << toAdvance[1000]->_pinValue
                   << ' ' << toAdvance[2000]->_pinValue
                   << ' ' << toAdvance[1000]->_pos
@@ -260,7 +338,10 @@ namespace mongo {
                    have "caught" the reader.  skipping ahead, the reader would miss postentially
                    important data.
                    */
-                delete cc;
+                if ( _claim(cc) )
+                    delete cc;
+                // else a racing killCursors won the claim; its destructor is
+                // blocked on ccmutex (held here) so cc stays valid meanwhile
                 continue;
             }
 
@@ -287,22 +368,141 @@ namespace mongo {
     }
     void aboutToDelete(const DiskLoc& dl) { ClientCursor::aboutToDelete(dl); }
 
+    /* ----- interning ---------------------------------------------------------
+       with very many cursors open (think 100k tailing cursors) the per-cursor
+       bookkeeping itself adds up.  identical ns strings and query objects are
+       shared across cursors instead of copied per cursor.
+    */
+    namespace {
+        SpinLock internLock;
+
+        // ns strings: many cursors, few distinct collections
+        typedef map< string , shared_ptr<const string> > NSPool;
+        NSPool nsPool;
+
+        shared_ptr<const string> internNS( const string& ns ) {
+            scoped_spinlock lk( internLock );
+            shared_ptr<const string>& slot = nsPool[ns];
+            if ( !slot )
+                slot.reset( new string( ns ) );
+            shared_ptr<const string> ret = slot;
+            if ( nsPool.size() > 10000 ) {
+                // dropped collections leave dead entries behind; shed the ones no
+                // cursor references any more
+                for ( NSPool::iterator i = nsPool.begin(); i != nsPool.end(); ) {
+                    if ( i->second.unique() )
+                        nsPool.erase( i++ );
+                    else
+                        ++i;
+                }
+            }
+            return ret;
+        }
+
+        // query objects: tailing/polling workloads reissue byte-identical queries
+        const int MaxInternedQuerySize = 512;
+        const size_t MaxInternedQueries = 4096;
+        typedef multimap< unsigned , BSONObj > QueryPool;
+        QueryPool queryPool;
+
+        unsigned hashBytes( const char* p , int len ) {
+            unsigned h = 0;
+            while ( len-- )
+                h = h * 131 + (unsigned char) *p++;
+            return h;
+        }
+
+        /** @return an owned object equal to q, sharing a buffer with other cursors when possible */
+        BSONObj internQuery( const BSONObj& q ) {
+            if ( q.isEmpty() )
+                return BSONObj();
+            if ( q.objsize() > MaxInternedQuerySize )
+                return q.getOwned(); // big and probably distinct - not worth pooling
+            unsigned h = hashBytes( q.objdata() , q.objsize() );
+            scoped_spinlock lk( internLock );
+            for ( QueryPool::const_iterator i = queryPool.lower_bound( h ); i != queryPool.end() && i->first == h; ++i ) {
+                if ( i->second.binaryEqual( q ) )
+                    return i->second; // shares the underlying (refcounted) buffer
+            }
+            if ( queryPool.size() >= MaxInternedQueries ) {
+                // cursors using pooled copies keep their buffers alive; start fresh
+                queryPool.clear();
+            }
+            BSONObj owned = q.getOwned();
+            queryPool.insert( make_pair( h , owned ) );
+            return owned;
+        }
+    }
+
+    /* ----- pooled allocation -------------------------------------------------
+       ClientCursors are all one size and churn at request rates; reuse blocks
+       via a free list rather than hitting the heap every time.
+    */
+    namespace {
+        SpinLock ccFreeListLock;
+        vector<void*> ccFreeList;
+        const size_t MaxFreeListBlocks = 8192;
+    }
+
+    void* ClientCursor::operator new( size_t sz ) {
+        assert( sz == sizeof(ClientCursor) );
+        {
+            scoped_spinlock lk( ccFreeListLock );
+            if ( !ccFreeList.empty() ) {
+                void *p = ccFreeList.back();
+                ccFreeList.pop_back();
+                return p;
+            }
+        }
+        return ::operator new( sz );
+    }
+
+    void ClientCursor::operator delete( void* p , size_t sz ) {
+        if ( !p )
+            return;
+        {
+            scoped_spinlock lk( ccFreeListLock );
+            if ( ccFreeList.size() < MaxFreeListBlocks ) {
+                ccFreeList.push_back( p );
+                return;
+            }
+        }
+        ::operator delete( p );
+    }
+
     ClientCursor::ClientCursor(int queryOptions, const shared_ptr<Cursor>& c, const string& ns, BSONObj query ) :
-        _ns(ns), _db( cc().database() ),
-        _c(c), _pos(0),
-        _query(query),  _queryOptions(queryOptions),
+        _ns( internNS( ns ) ), _db( cc().database() ),
+        _c(c), _pos(0), _nextBatchBytes(0),
+        _query( internQuery( query ) ),  _queryOptions(queryOptions),
         _idleAgeMillis(0), _pinValue(0),
-        _doingDeletes(false), _yieldSometimesTracker(128,10) {
+        _doingDeletes(false),
+        _stagedBuf(0), _stagedLen(0), _stagedOffset(0), _stagedN(0), _stagedStart(0),
+        _stagedFinal(false), _lastBatchNtoreturn(0),
+        _prefetchWanted(false), _prefetchPinned(false), _prefetchInterrupt(false),
+        _yieldSometimesTracker(128,10), _writerWaitingTracker(16,1) {
 
         dbMutex.assertAtLeastReadLocked();
 
         assert( _db );
-        assert( str::startsWith(_ns, _db->name) );
+        assert( str::startsWith(*_ns, _db->name) );
         if( queryOptions & QueryOption_NoCursorTimeout )
             noTimeout();
-        recursive_scoped_lock lock(ccmutex);
-        _cursorid = allocCursorId_inlock();
-        clientCursorsById.insert( make_pair(_cursorid, this) );
+
+        // pick an id and register; the uniqueness check and the insert are atomic
+        // within the id's bucket
+        while( 1 ) {
+            long long ctm = curTimeMillis64();
+            dassert( ctm );
+            long long x = (((long long)rand()) << 32) ^ ctm;
+            if( x == 0 )
+                continue;
+            IdBucket& b = _bucketFor(x);
+            recursive_scoped_lock lock(b.m);
+            if( b.byId.insert( make_pair(x, this) ).second ) {
+                _cursorid = x;
+                break;
+            }
+        }
 
         if ( ! _c->modifiedKeys() ) {
             // store index information so we can decide if we can
@@ -323,6 +523,16 @@ namespace mongo {
     }
 
 
+    int ClientCursor::nextBatchByteTarget( int requested ) {
+        if ( requested > 0 )
+            return requested;
+        if ( _nextBatchBytes == 0 )
+            _nextBatchBytes = MaxBytesToReturnToClientAtOnce;
+        else if ( _nextBatchBytes < MaxAdaptiveBatchBytes )
+            _nextBatchBytes *= 2;
+        return _nextBatchBytes;
+    }
+
     ClientCursor::~ClientCursor() {
         if( _pos == -2 ) {
             // defensive: destructor called twice
@@ -330,10 +540,17 @@ namespace mongo {
             return;
         }
 
+        clearStagedBatch();
+
         {
             recursive_scoped_lock lock(ccmutex);
             setLastLoc_inlock( DiskLoc() ); // removes us from bylocation multimap
-            clientCursorsById.erase(_cursorid);
+        }
+
+        {
+            IdBucket& b = _bucketFor(_cursorid);
+            recursive_scoped_lock lock(b.m);
+            b.byId.erase(_cursorid); // no-op if our deleter already claimed us
 
             // defensive:
             (CursorId&)_cursorid = -1;
@@ -431,6 +648,16 @@ namespace mongo {
     }
 
     int ClientCursor::suggestYieldMicros() {
+        if ( dbMutex.getState() < 0 && ! dbMutex.writerWaiting() ) {
+            // we have a read lock and no writer is queued, so a yield buys
+            // nothing -- and we can tell without scanning the client list.
+            // still honor kill requests, which used to surface through the
+            // recommendedYieldMicros call below.
+            if ( *killCurrentOp.checkForInterruptNoAssert() )
+                return 100;
+            return 0;
+        }
+
         int writers = 0;
         int readers = 0;
 
@@ -475,8 +702,21 @@ namespace mongo {
 
     bool ClientCursor::yieldSometimes( RecordNeeds need, bool *yielded ) {
         if ( yielded ) {
-            *yielded = false;   
+            *yielded = false;
+        }
+
+        // adaptive early out: if a writer is queued behind our read lock,
+        // don't make it sit out the full iteration/time interval below.  the
+        // probe is one load; the tracker just keeps a write-heavy load from
+        // turning this into a yield per document.
+        if ( dbMutex.getState() < 0 && dbMutex.writerWaiting() &&
+                _writerWaitingTracker.intervalHasElapsed() ) {
+            if ( yielded ) {
+                *yielded = true;
+            }
+            return yield( suggestYieldMicros() , _recordForYield( need ) );
         }
+
         if ( ! _yieldSometimesTracker.intervalHasElapsed() ) {
             Record* rec = _recordForYield( need );
             if ( rec ) {
@@ -557,13 +797,13 @@ namespace mongo {
                 inEmpty = true;
                 log() << "TEST: manipulate collection during cc:yield" << endl;
                 if( test == 1 )
-                    Helpers::emptyCollection(_ns.c_str());
+                    Helpers::emptyCollection(_ns->c_str());
                 else if( test == 2 ) {
                     BSONObjBuilder b; string m;
-                    dropCollection(_ns.c_str(), m, b);
+                    dropCollection(_ns->c_str(), m, b);
                 }
                 else {
-                    dropDatabase(_ns.c_str());
+                    dropDatabase(_ns->c_str());
                 }
             }
         }
@@ -590,25 +830,10 @@ namespace mongo {
 
         YieldData data;
         prepareToYield( data );
-        staticYield( micros , _ns , recordToLoad );
+        staticYield( micros , *_ns , recordToLoad );
         return ClientCursor::recoverFromYield( data );
     }
 
-    long long ctmLast = 0; // so we don't have to do find() which is a little slow very often.
-    long long ClientCursor::allocCursorId_inlock() {
-        long long ctm = curTimeMillis64();
-        dassert( ctm );
-        long long x;
-        while ( 1 ) {
-            x = (((long long)rand()) << 32);
-            x = x ^ ctm;
-            if ( ctm != ctmLast || ClientCursor::find_inlock(x, false) == 0 )
-                break;
-        }
-        ctmLast = ctm;
-        return x;
-    }
-
     void ClientCursor::storeOpForSlave( DiskLoc last ) {
         if ( ! ( _queryOptions & QueryOption_OplogReplay ))
             return;
@@ -624,25 +849,150 @@ namespace mongo {
     void ClientCursor::updateSlaveLocation( CurOp& curop ) {
         if ( _slaveReadTill.isNull() )
             return;
-        mongo::updateSlaveLocation( curop , _ns.c_str() , _slaveReadTill );
+        mongo::updateSlaveLocation( curop , _ns->c_str() , _slaveReadTill );
+    }
+
+    /* ----- getMore read-ahead ------------------------------------------------ */
+
+    namespace {
+        SimpleMutex stagedBytesMutex("stagedBytes");
+        long long totalStagedBytesVal = 0;
+        void adjustStagedBytes( int delta ) {
+            SimpleMutex::scoped_lock lk( stagedBytesMutex );
+            totalStagedBytesVal += delta;
+        }
     }
 
+    long long ClientCursor::totalStagedBytes() {
+        SimpleMutex::scoped_lock lk( stagedBytesMutex );
+        return totalStagedBytesVal;
+    }
+
+    void ClientCursor::setStagedBatch( BufBuilder &docs, int n, int startingFrom, DiskLoc last, bool finished ) {
+        clearStagedBatch();
+        if ( docs.len() ) {
+            _stagedLen = docs.len();
+            _stagedBuf = docs.buf();
+            docs.decouple();
+            adjustStagedBytes( _stagedLen );
+        }
+        _stagedN = n;
+        _stagedStart = startingFrom;
+        _stagedLast = last;
+        _stagedFinal = finished;
+    }
+
+    void ClientCursor::clearStagedBatch() {
+        if ( _stagedBuf ) {
+            adjustStagedBytes( -_stagedLen );
+            free( _stagedBuf );
+            _stagedBuf = 0;
+        }
+        _stagedLen = _stagedOffset = _stagedN = _stagedStart = 0;
+        _stagedFinal = false;
+    }
+
+    int ClientCursor::consumeStagedBatch( BufBuilder &b, int ntoreturn, int *startingFrom, DiskLoc *last, bool *finished ) {
+        *startingFrom = _stagedStart;
+        *last = _stagedLast;
+        int k = _stagedN;
+        if ( ntoreturn > 0 && ntoreturn < k )
+            k = ntoreturn;
+        int bytes = _stagedLen - _stagedOffset;
+        if ( k < _stagedN ) {
+            // the client asked for fewer docs than are staged; walk the object
+            // lengths to find the split point and keep the rest for next time
+            const char *p = _stagedBuf + _stagedOffset;
+            for( int i = 0; i < k; i++ ) {
+                BSONObj o( p );
+                p += o.objsize();
+            }
+            bytes = (int)( p - ( _stagedBuf + _stagedOffset ) );
+        }
+        if ( bytes )
+            b.appendBuf( _stagedBuf + _stagedOffset, bytes );
+        _stagedOffset += bytes;
+        _stagedN -= k;
+        _stagedStart += k;
+        *finished = false;
+        if ( _stagedN == 0 ) {
+            *finished = _stagedFinal;
+            clearStagedBatch();
+        }
+        return k;
+    }
+
+    void ClientCursor::markPrefetchWanted() {
+        IdBucket& b = _bucketFor(_cursorid);
+        recursive_scoped_lock lock(b.m);
+        _prefetchWanted = true;
+    }
+
+    ClientCursor* ClientCursor::pinForPrefetch( CursorId id ) {
+        IdBucket& b = _bucketFor(id);
+        recursive_scoped_lock lock(b.m);
+        ClientCursor *c = find_inlock(b, id, false);
+        if ( c == 0 || c->_pinValue >= 100 || !c->_prefetchWanted )
+            return 0;
+        c->_prefetchWanted = false;
+        c->_prefetchPinned = true;
+        c->_prefetchInterrupt = false;
+        c->_pinValue += 100;
+        return c;
+    }
+
+    bool ClientCursor::prefetchStillWanted( CursorId id ) {
+        IdBucket& b = _bucketFor(id);
+        recursive_scoped_lock lock(b.m);
+        ClientCursor *c = find_inlock(b, id, false);
+        return c && c->_prefetchWanted;
+    }
+
+    void ClientCursor::unpinPrefetch() {
+        IdBucket& b = _bucketFor(_cursorid);
+        recursive_scoped_lock lock(b.m);
+        assert( _pinValue >= 100 );
+        _pinValue -= 100;
+        _prefetchPinned = false;
+    }
+
+    void ClientCursor::interruptPrefetch( CursorId id ) {
+        while( 1 ) {
+            {
+                IdBucket& b = _bucketFor(id);
+                recursive_scoped_lock lock(b.m);
+                ClientCursor *c = find_inlock(b, id, false);
+                if ( c == 0 )
+                    return;
+                c->_prefetchWanted = false; // cancel if the stager hasn't picked it up yet
+                if ( !c->_prefetchPinned )
+                    return;
+                c->_prefetchInterrupt = true; // the stager checks this once per doc
+            }
+            sleepmicros( 200 );
+        }
+    }
 
     void ClientCursor::appendStats( BSONObjBuilder& result ) {
-        recursive_scoped_lock lock(ccmutex);
-        result.appendNumber("totalOpen", clientCursorsById.size() );
-        result.appendNumber("clientCursors_size", (int) numCursors());
-        result.appendNumber("timedOut" , numberTimedOut);
+        unsigned open = 0;
         unsigned pinned = 0;
         unsigned notimeout = 0;
-        for ( CCById::iterator i = clientCursorsById.begin(); i != clientCursorsById.end(); i++ ) {
-            unsigned p = i->second->_pinValue;
-            if( p >= 100 )
-                pinned++;
-            else if( p > 0 )
-                notimeout++;
-        }
-        if( pinned ) 
+        for( int bi = 0; bi < NumIdBuckets; bi++ ) {
+            IdBucket& b = _idBuckets[bi];
+            recursive_scoped_lock lock(b.m);
+            open += b.byId.size();
+            for ( CCById::iterator i = b.byId.begin(); i != b.byId.end(); i++ ) {
+                unsigned p = i->second->_pinValue;
+                if( p >= 100 )
+                    pinned++;
+                else if( p > 0 )
+                    notimeout++;
+            }
+        }
+        result.appendNumber("totalOpen", (size_t) open );
+        result.appendNumber("clientCursors_size", (int) open);
+        result.appendNumber("timedOut" , numberTimedOut);
+        if( pinned )
             result.append("pinned", pinned);
         if( notimeout )
             result.append("totalNoTimeout", notimeout);
@@ -720,11 +1070,13 @@ namespace mongo {
     }
 
     void ClientCursor::find( const string& ns , set<CursorId>& all ) {
-        recursive_scoped_lock lock(ccmutex);
-
-        for ( CCById::iterator i=clientCursorsById.begin(); i!=clientCursorsById.end(); ++i ) {
-            if ( i->second->_ns == ns )
-                all.insert( i->first );
+        for( int bi = 0; bi < NumIdBuckets; bi++ ) {
+            IdBucket& b = _idBuckets[bi];
+            recursive_scoped_lock lock(b.m);
+            for ( CCById::iterator i=b.byId.begin(); i!=b.byId.end(); ++i ) {
+                if ( *i->second->_ns == ns )
+                    all.insert( i->first );
+            }
         }
     }
 
@@ -102,8 +102,9 @@ namespace mongo {
             }
             ~Pointer() { release(); }
             Pointer(long long cursorid) {
-                recursive_scoped_lock lock(ccmutex);
-                _c = ClientCursor::find_inlock(cursorid, true);
+                IdBucket& b = _bucketFor(cursorid);
+                recursive_scoped_lock lock(b.m);
+                _c = ClientCursor::find_inlock(b, cursorid, true);
                 if( _c ) {
                     if( _c->_pinValue >= 100 ) {
                         _c = 0;
@@ -150,10 +151,16 @@ namespace mongo {
 
         ~ClientCursor();
 
+        /* cursors churn heavily and we can have a very large number open at
+           once; allocate them from a free list of exact size blocks rather than
+           the general heap */
+        void* operator new( size_t sz );
+        void operator delete( void* p , size_t sz );
+
         // ***************  basic accessors *******************
 
         CursorId cursorid() const { return _cursorid; }
-        string ns() const { return _ns; }
+        string ns() const { return *_ns; }
         Database * db() const { return _db; }
         const BSONObj& query() const { return _query; }
         int queryOptions() const { return _queryOptions; }
@@ -235,6 +242,16 @@ namespace mongo {
         void incPos( int n ) { _pos += n; } // TODO: this is bad
         void setPos( int n ) { _pos = n; } // TODO : this is bad too
 
+        /**
+         * byte target for the next getMore batch on this cursor.  starts at
+         * MaxBytesToReturnToClientAtOnce and doubles per batch up to
+         * MaxAdaptiveBatchBytes, so long small-document scans need fewer round
+         * trips.
+         * @param requested client requested per-batch target ($batchBytes);
+         *                  honored as-is when nonzero
+         */
+        int nextBatchByteTarget( int requested );
+
         BSONObj indexKeyPattern() { return _c->indexKeyPattern();  }
         bool modifiedKeys() const { return _c->modifiedKeys(); }
         bool isMultiKey() const { return _c->isMultiKey(); }
@@ -280,12 +297,68 @@ namespace mongo {
         void setChunkManager( ShardChunkManagerPtr manager ){ _chunkManager = manager; }
         ShardChunkManagerPtr getChunkManager(){ return _chunkManager; }
 
+        // ---- getMore read-ahead (--getMoreReadAhead) ----
+        // while the client processes a batch, a background worker advances the
+        // cursor and stages the next batch here; the following getMore is then
+        // a memory copy.  only the pin holder touches the staged state.
+
+        bool hasStagedBatch() const { return _stagedN > 0 || _stagedFinal; }
+        /** move up to ntoreturn staged docs (all of them when ntoreturn is 0 or
+            exceeds what is staged) into b.  any remainder stays staged.
+            @param finished set if the cursor was exhausted and all staged docs
+                            are now consumed - caller should erase the cursor
+            @return number of docs appended */
+        int consumeStagedBatch( BufBuilder &b, int ntoreturn, int *startingFrom, DiskLoc *last, bool *finished );
+        /** the stager hands over the batch it built (docs is decoupled) */
+        void setStagedBatch( BufBuilder &docs, int n, int startingFrom, DiskLoc last, bool finished );
+        void clearStagedBatch();
+        int lastBatchNtoreturn() const { return _lastBatchNtoreturn; }
+        void setLastBatchNtoreturn( int n ) { _lastBatchNtoreturn = n; }
+        /** true once a waiting request has asked the stager to wrap up */
+        bool prefetchInterrupted() const { return _prefetchInterrupt; }
+        /** flag that this cursor awaits the stager.  caller must hold the pin. */
+        void markPrefetchWanted();
+        /** pin for the background stager.
+            @return 0 if the cursor is gone, in use, or no longer wants staging */
+        static ClientCursor* pinForPrefetch( CursorId id );
+        /** still flagged by markPrefetchWanted()?  lets the stager retry when it
+            loses the pin race with the request that queued the cursor */
+        static bool prefetchStillWanted( CursorId id );
+        /** release pinForPrefetch()'s pin */
+        void unpinPrefetch();
+        /** a request is about to use cursorid: cancel its pending staging, or
+            wait for the stager to wrap up (it checks prefetchInterrupted() once
+            per document).  call WITHOUT the db lock - the stager may need it. */
+        static void interruptPrefetch( CursorId id );
+        /** total staged bytes across all cursors, for the global memory cap */
+        static long long totalStagedBytes();
+
     private:
         void setLastLoc_inlock(DiskLoc);
 
-        static ClientCursor* find_inlock(CursorId id, bool warn = true) {
-            CCById::iterator it = clientCursorsById.find(id);
-            if ( it == clientCursorsById.end() ) {
+        /* cursors are sharded by id across these buckets so getMore lookups and
+           cursor open/close stop serializing on one global mutex.  ccmutex still
+           guards the per-database byLoc maps; it may be held when taking a bucket
+           mutex, never the reverse.  to delete a cursor you must first "claim" it
+           by erasing its bucket entry under the bucket mutex (see _claim) so that
+           concurrent deleters - killCursors vs drop vs timeout - race safely.
+        */
+        enum { NumIdBuckets = 64 };
+        struct IdBucket {
+            boost::recursive_mutex m;
+            CCById byId;
+        };
+        static IdBucket _idBuckets[NumIdBuckets];
+        static IdBucket& _bucketFor(CursorId id) {
+            return _idBuckets[ ((unsigned long long)id) % (unsigned) NumIdBuckets ];
+        }
+
+        /** take ownership of deleting cc.  @return false if another thread got there first */
+        static bool _claim(ClientCursor *cc);
+
+        static ClientCursor* find_inlock(IdBucket& b, CursorId id, bool warn = true) {
+            CCById::iterator it = b.byId.find(id);
+            if ( it == b.byId.end() ) {
                 if ( warn )
                     OCCASIONALLY out() << "ClientCursor::find(): cursor not found in map " << id << " (ok after a drop)\n";
                 return 0;
@@ -294,24 +367,16 @@ namespace mongo {
         }
     public:
         static ClientCursor* find(CursorId id, bool warn = true) {
-            recursive_scoped_lock lock(ccmutex);
-            ClientCursor *c = find_inlock(id, warn);
+            IdBucket& b = _bucketFor(id);
+            recursive_scoped_lock lock(b.m);
+            ClientCursor *c = find_inlock(b, id, warn);
             // if this asserts, your code was not thread safe - you either need to set no timeout
             // for the cursor or keep a ClientCursor::Pointer in scope for it.
             massert( 12521, "internal error: use of an unlocked ClientCursor", c == 0 || c->_pinValue );
             return c;
         }
 
-        static bool erase(CursorId id) {
-            recursive_scoped_lock lock(ccmutex);
-            ClientCursor *cc = find_inlock(id);
-            if ( cc ) {
-                assert( cc->_pinValue < 100 ); // you can't still have an active ClientCursor::Pointer
-                delete cc;
-                return true;
-            }
-            return false;
-        }
+        static bool erase(CursorId id);
 
         /**
          * @return number of cursors found
@@ -351,7 +416,7 @@ namespace mongo {
         static void idleTimeReport(unsigned millis);
 
         static void appendStats( BSONObjBuilder& result );
-        static unsigned numCursors() { return clientCursorsById.size(); }
+        static unsigned numCursors();
         static void informAboutToDeleteBucket(const DiskLoc& b);
         static void aboutToDelete(const DiskLoc& dl);
         static void find( const string& ns , set<CursorId>& all );
@@ -371,14 +436,16 @@ namespace mongo {
 
         CursorId _cursorid;
 
-        const string _ns;
+        const shared_ptr<const string> _ns; // interned - all cursors on a collection share one string
         Database * _db;
 
         const shared_ptr<Cursor> _c;
         map<string,int> _indexedFields;  // map from indexed field to offset in key object
         int _pos;                        // # objects into the cursor so far
+        int _nextBatchBytes;             // adaptive getMore byte target, 0 until first getMore
 
-        const BSONObj _query;            // used for logging diags only; optional in constructor
+        const BSONObj _query;            // used for logging diags only; optional in constructor.
+                                         // interned - identical queries share one buffer
         int _queryOptions;        // see enum QueryOptions dbclient.h
 
         OpTime _slaveReadTill;
@@ -393,7 +460,22 @@ namespace mongo {
         unsigned _pinValue;
 
         bool _doingDeletes; // when true we are the delete and aboutToDelete shouldn't manipulate us
+
+        // getMore read-ahead state; see the public section above
+        char *_stagedBuf;            // concatenated result objects (malloced), 0 if none
+        int _stagedLen;              // total bytes in _stagedBuf
+        int _stagedOffset;           // bytes of _stagedBuf already returned to the client
+        int _stagedN;                // docs remaining in _stagedBuf
+        int _stagedStart;            // QueryResult::startingFrom for the next staged doc
+        DiskLoc _stagedLast;         // last staged doc, for storeOpForSlave
+        bool _stagedFinal;           // cursor exhausted while staging; erase after delivery
+        int _lastBatchNtoreturn;     // client's ntoreturn on the last getMore
+        bool _prefetchWanted;        // queued for the stager (guarded by the id bucket mutex)
+        bool _prefetchPinned;        // the stager holds the pin (guarded by the id bucket mutex)
+        volatile bool _prefetchInterrupt; // a request wants the cursor; stager should stop
+
         ElapsedTracker _yieldSometimesTracker;
+        ElapsedTracker _writerWaitingTracker; // rate limits the yield-early-for-a-queued-writer path
 
         ShardChunkManagerPtr _chunkManager;
 
@@ -406,10 +488,8 @@ namespace mongo {
 
     private: // static members
 
-        static CCById clientCursorsById;
-        static long long numberTimedOut;
-        static boost::recursive_mutex& ccmutex;   // must use this for all statics above!
-        static CursorId allocCursorId_inlock();
+        static long long numberTimedOut; // only the monitor thread writes this
+        static boost::recursive_mutex& ccmutex;   // guards the per-database byLoc maps
 
     };
 
@@ -69,6 +69,13 @@ namespace mongo {
         bool go(const char *masterHost, string& errmsg, const string& fromdb, bool logForRepl, bool slaveOk, bool useReplAuth, bool snapshot, bool mayYield, bool mayBeInterrupted, int *errCode = 0);
 
         bool copyCollection( const string& ns , const BSONObj& query , string& errmsg , bool mayYield, bool mayBeInterrupted, bool copyIndexes = true, bool logForRepl = true );
+
+        /** clone one collection -- create it, copy the data, and build its id
+            index if deferred.  collection is the source's system.namespaces
+            entry.  caller must hold the write lock. */
+        void cloneOneCollection( const BSONObj& collection, const string& todb, bool logForRepl,
+                                 bool masterSameProcess, bool slaveOk, bool snapshot,
+                                 bool mayYield, bool mayBeInterrupted );
     };
 
     /* for index info object:
@@ -292,6 +299,165 @@ namespace mongo {
     extern bool inDBRepair;
     void ensureIdIndexForNewNs(const char *ns);
 
+    namespace {
+        /* the deferred id index build after cloning a collection wants dropDups
+           (see the comment in cloneOneCollection).  dropDups rides on the
+           inDBRepair flag; with several clone workers building id indexes
+           concurrently the flag is reference counted here so the first worker
+           to finish doesn't clear it out from under the others. */
+        mongo::mutex cloneDropDupsMutex("clonerDropDups");
+        int cloneDropDupsCount = 0;
+        bool cloneDropDupsOld = false;
+        struct DropDupsOnIdIndexBuild {
+            DropDupsOnIdIndexBuild() {
+                scoped_lock lk(cloneDropDupsMutex);
+                if( cloneDropDupsCount++ == 0 ) {
+                    cloneDropDupsOld = inDBRepair;
+                    inDBRepair = true;
+                }
+            }
+            ~DropDupsOnIdIndexBuild() {
+                scoped_lock lk(cloneDropDupsMutex);
+                if( --cloneDropDupsCount == 0 )
+                    inDBRepair = cloneDropDupsOld;
+            }
+        };
+    }
+
+    void Cloner::cloneOneCollection( const BSONObj& collection, const string& todb, bool logForRepl,
+                                     bool masterSameProcess, bool slaveOk, bool snapshot,
+                                     bool mayYield, bool mayBeInterrupted ) {
+        log(2) << "  really will clone: " << collection << endl;
+        const char * from_name = collection["name"].valuestr();
+        BSONObj options = collection.getObjectField("options");
+
+        /* change name "<fromdb>.collection" -> <todb>.collection */
+        const char *p = strchr(from_name, '.');
+        assert(p);
+        string to_name = todb + p;
+
+        bool wantIdIndex = false;
+        {
+            string err;
+            const char *toname = to_name.c_str();
+            /* we defer building id index for performance - building it in batch is much faster */
+            userCreateNS(toname, options, err, logForRepl, &wantIdIndex);
+        }
+        log(1) << "\t\t cloning " << from_name << " -> " << to_name << endl;
+        Query q;
+        if( snapshot )
+            q.snapshot();
+        copy(from_name, to_name.c_str(), false, logForRepl, masterSameProcess, slaveOk, mayYield, mayBeInterrupted, q);
+
+        if( wantIdIndex ) {
+            /* we need dropDups to be true as we didn't do a true snapshot and this is before applying oplog operations
+               that occur during the initial sync.  inDBRepair makes dropDups be true.
+               */
+            DropDupsOnIdIndexBuild guard;
+            ensureIdIndexForNewNs(to_name.c_str());
+        }
+    }
+
+    /* runs the per-collection clones of Cloner::go on a few worker threads,
+       each with its own connection and Cloner so the workers' network reads
+       and source fetches overlap each other's insert windows (the inserts
+       themselves still serialize on the write lock).  tracks which collections
+       completed so progress and failures are reported per collection. */
+    class ParallelCloner : boost::noncopyable {
+    public:
+        ParallelCloner( const string& masterHost, const string& todb, const vector<BSONObj>& cols,
+                        bool logForRepl, bool slaveOk, bool snapshot )
+            : _mutex("ParallelCloner"), _masterHost(masterHost), _todb(todb), _cols(cols),
+              _next(0), _done(0), _logForRepl(logForRepl), _slaveOk(slaveOk), _snapshot(snapshot),
+              _failed(false) {
+        }
+
+        /** run the clones on nWorkers threads and block until all are finished.
+            the caller must not hold any db lock. */
+        void go( int nWorkers ) {
+            vector< shared_ptr<boost::thread> > threads;
+            for( int i = 0; i < nWorkers; i++ )
+                threads.push_back( shared_ptr<boost::thread>( new boost::thread( boost::bind( &ParallelCloner::run, this ) ) ) );
+            for( unsigned i = 0; i < threads.size(); i++ )
+                threads[i]->join();
+        }
+
+        bool ok( string& errmsg ) const {
+            if( _failed )
+                errmsg = _errmsg;
+            return !_failed;
+        }
+
+    private:
+        void run() {
+            Client::initThread("clone");
+            try {
+                Cloner c;
+                {
+                    string errmsg;
+                    ConnectionString cs = ConnectionString::parse( _masterHost, errmsg );
+                    auto_ptr<DBClientBase> con( cs.connect( errmsg ) );
+                    if( !con.get() || !replAuthenticate( con.get() ) ) {
+                        fail( str::stream() << "clone worker couldn't connect to " << _masterHost << " : " << errmsg );
+                        cc().shutdown();
+                        return;
+                    }
+                    c.setConnection( con.release() );
+                }
+                while( 1 ) {
+                    int i;
+                    {
+                        scoped_lock lk(_mutex);
+                        if( _failed || _next >= (int)_cols.size() )
+                            break;
+                        i = _next++;
+                    }
+                    const BSONObj& collection = _cols[i];
+                    try {
+                        writelock lk("");
+                        Client::Context ctx( _todb );
+                        c.cloneOneCollection( collection, _todb, _logForRepl, false, _slaveOk, _snapshot,
+                                              /*mayYield*/true, /*mayBeInterrupted*/false );
+                    }
+                    catch( DBException& e ) {
+                        fail( str::stream() << "clone of " << collection["name"].valuestr() << " failed : " << e.toString() );
+                        break;
+                    }
+                    {
+                        scoped_lock lk(_mutex);
+                        _done++;
+                        log() << "clone progress: " << _done << '/' << (int)_cols.size()
+                              << " collections (" << collection["name"].valuestr() << " done)" << endl;
+                    }
+                }
+            }
+            catch( std::exception& e ) {
+                fail( str::stream() << "clone worker exception : " << e.what() );
+            }
+            cc().shutdown();
+        }
+
+        void fail( const string& m ) {
+            scoped_lock lk(_mutex);
+            if( !_failed ) {
+                _failed = true;
+                _errmsg = m;
+            }
+        }
+
+        mutable mongo::mutex _mutex;
+        string _masterHost;
+        string _todb;
+        vector<BSONObj> _cols;
+        int _next; // next collection to hand to a worker
+        int _done; // collections completed
+        bool _logForRepl;
+        bool _slaveOk;
+        bool _snapshot;
+        bool _failed;
+        string _errmsg;
+    };
+
     bool Cloner::go(const char *masterHost, string& errmsg, const string& fromdb, bool logForRepl, bool slaveOk, bool useReplAuth, bool snapshot, bool mayYield, bool mayBeInterrupted, int *errCode) {
         if ( errCode ) {
             *errCode = 0;
@@ -394,48 +560,35 @@ namespace mongo {
             }
         }
 
-        for ( list<BSONObj>::iterator i=toClone.begin(); i != toClone.end(); i++ ) {
-            {
-                mayInterrupt( mayBeInterrupted );
-                dbtempreleaseif r( mayYield );
-            }
-            BSONObj collection = *i;
-            log(2) << "  really will clone: " << collection << endl;
-            const char * from_name = collection["name"].valuestr();
-            BSONObj options = collection.getObjectField("options");
-
-            /* change name "<fromdb>.collection" -> <todb>.collection */
-            const char *p = strchr(from_name, '.');
-            assert(p);
-            string to_name = todb + p;
+        /* clone collections on worker threads when we can.  each worker needs its
+           own connection, so not when a connection was preset on us (copydb with
+           auth) and not in-process.  !mayYield callers expect the lock held
+           throughout, which rules out parallelism too. */
+        int nWorkers = 1;
+        if ( mayYield && !masterSameProcess && !conn.get() && toClone.size() > 1 ) {
+            nWorkers = (int) toClone.size();
+            if ( nWorkers > 4 )
+                nWorkers = 4;
+        }
 
-            bool wantIdIndex = false;
-            {
-                string err;
-                const char *toname = to_name.c_str();
-                /* we defer building id index for performance - building it in batch is much faster */
-                userCreateNS(toname, options, err, logForRepl, &wantIdIndex);
-            }
-            log(1) << "\t\t cloning " << from_name << " -> " << to_name << endl;
-            Query q;
-            if( snapshot )
-                q.snapshot();
-            copy(from_name, to_name.c_str(), false, logForRepl, masterSameProcess, slaveOk, mayYield, mayBeInterrupted, q);
-
-            if( wantIdIndex ) {
-                /* we need dropDups to be true as we didn't do a true snapshot and this is before applying oplog operations
-                   that occur during the initial sync.  inDBRepair makes dropDups be true.
-                   */
-                bool old = inDBRepair;
-                try {
-                    inDBRepair = true;
-                    ensureIdIndexForNewNs(to_name.c_str());
-                    inDBRepair = old;
-                }
-                catch(...) {
-                    inDBRepair = old;
-                    throw;
+        if ( nWorkers > 1 ) {
+            // clone the collections in parallel on separate connections
+            vector<BSONObj> cols( toClone.begin(), toClone.end() );
+            ParallelCloner workers( masterHost, todb, cols, logForRepl, slaveOk, snapshot );
+            mayInterrupt( mayBeInterrupted );
+            dbtemprelease r; // give the workers the write lock while we wait
+            workers.go( nWorkers );
+            if ( !workers.ok( errmsg ) )
+                return false;
+        }
+        else {
+            for ( list<BSONObj>::iterator i=toClone.begin(); i != toClone.end(); i++ ) {
+                {
+                    mayInterrupt( mayBeInterrupted );
+                    dbtempreleaseif r( mayYield );
                 }
+                cloneOneCollection( *i, todb, logForRepl, masterSameProcess, slaveOk, snapshot,
+                                    mayYield, mayBeInterrupted );
             }
         }
 
@@ -59,7 +59,9 @@ namespace mongo {
         ("port", po::value<int>(&cmdLine.port), "specify port number")
         ("bind_ip", po::value<string>(&cmdLine.bind_ip), "comma separated list of ip addresses to listen on - all local ips by default")
         ("maxConns",po::value<int>(), "max number of simultaneous connections")
-        ("objcheck", "inspect client data for validity on receipt")
+        ("networkCompression", "snappy-compress wire traffic on connections this process initiates; servers receiving compressed traffic reciprocate automatically")
+        ("objcheck", "inspect client data for validity on receipt (default)")
+        ("noobjcheck", "do NOT inspect client data for validity on receipt")
         ("logpath", po::value<string>() , "log file to send write to instead of stdout - has to be a file, not directory" )
         ("logappend" , "append to logpath instead of over-writing" )
         ("pidfilepath", po::value<string>(), "full path to pidfile (if not set, no pidfile is created)")
@@ -252,6 +254,17 @@ namespace mongo {
         if (params.count("objcheck")) {
             cmdLine.objcheck = true;
         }
+        if (params.count("noobjcheck")) {
+            if (params.count("objcheck")) {
+                out() << "can't have both --objcheck and --noobjcheck" << endl;
+                dbexit( EXIT_BADOPTIONS );
+            }
+            cmdLine.objcheck = false;
+        }
+
+        if (params.count("networkCompression")) {
+            cmdLine.networkCompression = true;
+        }
 
         string logpath;
 
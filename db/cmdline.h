@@ -70,6 +70,9 @@ namespace mongo {
         bool preallocj;        // --nopreallocj no preallocation of journal files
         bool smallfiles;       // --smallfiles allocate smaller data files
 
+        string ephemeralDbs;   // --ephemeralDbs comma separated database names kept only in RAM -
+                               // no data files, no journaling; contents are lost on shutdown
+
         bool configsvr;        // --configsvr
 
         bool quota;            // --quota
@@ -78,6 +81,11 @@ namespace mongo {
 
         bool dur;                       // --dur durability (now --journal)
         unsigned journalCommitInterval; // group/batch commit interval ms
+        string journalPath;             // --journalPath.  directory for journal files,
+                                        // default <dbpath>/journal.  putting it on its
+                                        // own device relaxes flush pacing - see
+                                        // dur::journalOnSeparateDevice()
+        int journalCompressionWorkers;  // threads compressing the journal buffer; 0 = pick automatically
 
         /** --durOptions 7      dump journal and terminate without doing anything further
             --durOptions 4      recover and terminate without listening
@@ -93,20 +101,38 @@ namespace mongo {
         };
         int durOptions;          // --durOptions <n> for debugging
 
-        bool objcheck;         // --objcheck
+        bool objcheck;         // --objcheck / --noobjcheck.  on by default now that
+                               // validation is a cheap single structural pass
 
         long long oplogSize;   // --oplogSize
+        bool oplogCompress;    // --oplogCompress.  store large oplog entry payloads
+                               // snappy compressed; all set members must support it
         int defaultProfile;    // --profile
         int slowMS;            // --time in ms that is "slow"
+        int opSampleRate;      // --opSampleRate.  keep 1 of every N finished ops
+                               // in the in-memory sampler ring (0=off)
+        int opTimeBudgetMS;    // --opTimeBudgetMS.  kill queries/getmores/updates
+                               // still scanning after this long (0=off; a query's
+                               // own $maxTimeMS overrides)
+        int opScanBudget;      // --opScanBudget.  kill scans that visit more than
+                               // this many index entries/documents (0=off)
 
         int pretouch;          // --pretouch for replication application (experimental)
         bool moveParanoia;     // for move chunk paranoia
+        string storageProfile; // --storageProfile auto|ssd|hdd.  steers extent
+                               // sizing, extent freeing and flush pacing - see
+                               // storageIsSSD() in pdfile.cpp
         double syncdelay;      // seconds between fsyncs
+        int trickleFlushMB;    // --trickleFlushMB.  MB/sec of dirty data to msync
+                               // asynchronously between syncdelay syncs (0=off)
 
         bool noUnixSocket;     // --nounixsocket
         bool doFork;           // --fork
         string socket;         // UNIX domain socket directory
 
+        bool eventLoop;        // --eventLoop epoll message server (linux only, experimental)
+        bool networkCompression; // --networkCompression snappy-compress traffic on connections we initiate
+
         bool keyFile;
 
 #ifndef _WIN32
@@ -148,12 +174,13 @@ namespace mongo {
     inline CmdLine::CmdLine() :
         port(DefaultDBPort), rest(false), jsonp(false), quiet(false), noTableScan(false), prealloc(true), preallocj(true), smallfiles(sizeof(int*) == 4),
         configsvr(false),
-        quota(false), quotaFiles(8), cpu(false), durOptions(0), objcheck(false), oplogSize(0), defaultProfile(0), slowMS(100), pretouch(0), moveParanoia( true ),
-        syncdelay(60), noUnixSocket(false), doFork(0), socket("/tmp") 
+        quota(false), quotaFiles(8), cpu(false), durOptions(0), objcheck(true), oplogSize(0), oplogCompress(false), defaultProfile(0), slowMS(100), opSampleRate(256), opTimeBudgetMS(0), opScanBudget(0), pretouch(0), moveParanoia( true ),
+        storageProfile("auto"), syncdelay(60), trickleFlushMB(32), noUnixSocket(false), doFork(0), socket("/tmp"), eventLoop(false), networkCompression(false)
     {
         started = time(0);
 
         journalCommitInterval = 0; // 0 means use default
+        journalCompressionWorkers = 0; // 0 means pick automatically
         dur = false;
 #if defined(_DURABLEDEFAULTON)
         dur = true;
@@ -0,0 +1,541 @@
+// aggregate.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* native streaming aggregation:
+
+       { aggregate : <collection> , pipeline : [ <stage> , ... ] }
+
+   stages are composed into a pull pipeline and documents stream through them one
+   at a time, so memory use is bounded by the blocking stages actually present
+   ($group, $sort) rather than the collection size.  supported stages:
+
+       { $match   : <query> }          filter with the regular Matcher; when first
+                                       in the pipeline it is handed to the query
+                                       optimizer so an index can drive the scan
+       { $project : <spec> }           field selection as in a query projection
+       { $unwind  : "$field" }         one output document per element of the
+                                       (top level) array field
+       { $group   : { _id : <key> , <out> : { $op : <in> } , ... } }
+                                       hash aggregation; $op one of $sum, $avg,
+                                       $min, $max, $first, $last; <in> a "$path"
+                                       or, for $sum, a numeric constant
+       { $sort    : <pattern> }        in memory sort of the stage's input
+       { $limit   : <n> }  { $skip : <n> }
+
+   results are returned inline in the "result" array, so the final output must fit
+   in a single document; $group and $sort additionally cap the data they buffer.
+*/
+
+#include "pch.h"
+#include "../commands.h"
+#include "../instance.h"
+#include "../queryoptimizer.h"
+#include "../clientcursor.h"
+#include "../matcher.h"
+#include "../projection.h"
+#include "../hasher.h"
+
+namespace mongo {
+
+    namespace {
+
+        /** a pull stage of the pipeline.  next() produces the stage's next output
+            document, returning false at end of stream.  like Cursor the flow is one
+            document at a time, but stages are forward only and own their input. */
+        class PipelineStage : boost::noncopyable {
+        public:
+            virtual ~PipelineStage() {}
+            /** @param out set to an owned object when true is returned */
+            virtual bool next( BSONObj& out ) = 0;
+        };
+
+        typedef shared_ptr<PipelineStage> StagePtr;
+
+        /** source stage: a collection scan (or index scan when the pipeline led
+            with $match), yielding the lock periodically as group does. */
+        class CursorStage : public PipelineStage {
+        public:
+            CursorStage( const string& ns , const BSONObj& query ) {
+                _cursor = NamespaceDetailsTransient::getCursor( ns.c_str() , query );
+                _cc.reset( new ClientCursor( QueryOption_NoCursorTimeout , _cursor , ns ) );
+            }
+            virtual bool next( BSONObj& out ) {
+                while ( _cc.get() && _cursor->ok() ) {
+                    if ( !_cc->yieldSometimes( ClientCursor::MaybeCovered ) ||
+                         !_cursor->ok() )
+                        break;
+                    if ( ( _cursor->matcher() && !_cursor->matcher()->matchesCurrent( _cursor.get() ) ) ||
+                         _cursor->getsetdup( _cursor->currLoc() ) ) {
+                        _cursor->advance();
+                        continue;
+                    }
+                    if ( !_cc->yieldSometimes( ClientCursor::WillNeed ) ||
+                         !_cursor->ok() )
+                        break;
+                    // owned: downstream stages may buffer this across yields
+                    out = _cursor->current().getOwned();
+                    _cursor->advance();
+                    return true;
+                }
+                _cc.reset();
+                return false;
+            }
+        private:
+            shared_ptr<Cursor> _cursor;
+            ClientCursor::CleanupPointer _cc;
+        };
+
+        class MatchStage : public PipelineStage {
+        public:
+            MatchStage( const StagePtr& child , const BSONObj& query )
+                : _child( child ) , _matcher( query ) {}
+            virtual bool next( BSONObj& out ) {
+                while ( _child->next( out ) ) {
+                    if ( _matcher.matches( out ) )
+                        return true;
+                }
+                return false;
+            }
+        private:
+            StagePtr _child;
+            Matcher _matcher;
+        };
+
+        class ProjectStage : public PipelineStage {
+        public:
+            ProjectStage( const StagePtr& child , const BSONObj& spec ) : _child( child ) {
+                _projection.init( spec );
+            }
+            virtual bool next( BSONObj& out ) {
+                if ( !_child->next( out ) )
+                    return false;
+                out = _projection.transform( out );
+                return true;
+            }
+        private:
+            StagePtr _child;
+            Projection _projection;
+        };
+
+        class SkipStage : public PipelineStage {
+        public:
+            SkipStage( const StagePtr& child , long long n ) : _child( child ) , _toSkip( n ) {}
+            virtual bool next( BSONObj& out ) {
+                while ( _toSkip > 0 ) {
+                    if ( !_child->next( out ) )
+                        return false;
+                    _toSkip--;
+                }
+                return _child->next( out );
+            }
+        private:
+            StagePtr _child;
+            long long _toSkip;
+        };
+
+        class LimitStage : public PipelineStage {
+        public:
+            LimitStage( const StagePtr& child , long long n ) : _child( child ) , _left( n ) {}
+            virtual bool next( BSONObj& out ) {
+                if ( _left <= 0 )
+                    return false;
+                if ( !_child->next( out ) )
+                    return false;
+                _left--;
+                return true;
+            }
+        private:
+            StagePtr _child;
+            long long _left;
+        };
+
+        class UnwindStage : public PipelineStage {
+        public:
+            UnwindStage( const StagePtr& child , const BSONElement& spec ) : _child( child ) {
+                uassert( 16286 , "aggregate $unwind takes a \"$field\" path string" ,
+                         spec.type() == String && spec.valuestr()[0] == '$' );
+                _field = spec.valuestr() + 1;
+                uassert( 16287 , "aggregate $unwind of a dotted path is not supported" ,
+                         _field.find( '.' ) == string::npos );
+            }
+            virtual bool next( BSONObj& out ) {
+                while ( 1 ) {
+                    if ( _it.get() && _it->more() ) {
+                        BSONElement e = _it->next();
+                        BSONObjBuilder b( _doc.objsize() );
+                        BSONObjIterator di( _doc );
+                        while ( di.more() ) {
+                            BSONElement de = di.next();
+                            if ( str::equals( de.fieldName() , _field.c_str() ) )
+                                b.appendAs( e , _field );
+                            else
+                                b.append( de );
+                        }
+                        out = b.obj();
+                        return true;
+                    }
+                    if ( !_child->next( _doc ) )
+                        return false;
+                    BSONElement a = _doc[ _field ];
+                    if ( a.eoo() || ( a.type() == Array && a.embeddedObject().isEmpty() ) )
+                        continue; // missing or empty array: the document just disappears
+                    uassert( 16288 , "aggregate $unwind field must be an array" , a.type() == Array );
+                    _it.reset( new BSONObjIterator( a.embeddedObject() ) );
+                }
+            }
+        private:
+            StagePtr _child;
+            string _field;
+            BSONObj _doc; // current input document; _it walks its unwound array
+            scoped_ptr<BSONObjIterator> _it;
+        };
+
+        class SortStage : public PipelineStage {
+        public:
+            SortStage( const StagePtr& child , const BSONObj& pattern )
+                : _child( child ) , _pattern( pattern.getOwned() ) , _done( false ) , _pos( 0 ) {
+                uassert( 16284 , "aggregate $sort requires a nonempty pattern object" ,
+                         !_pattern.isEmpty() );
+            }
+            virtual bool next( BSONObj& out ) {
+                if ( !_done ) {
+                    long long bytes = 0;
+                    BSONObj d;
+                    while ( _child->next( d ) ) {
+                        bytes += d.objsize();
+                        uassert( 16295 , "aggregate $sort exceeds memory limit" ,
+                                 bytes < 64 * 1024 * 1024 );
+                        _docs.push_back( d );
+                    }
+                    std::stable_sort( _docs.begin() , _docs.end() , Cmp( _pattern ) );
+                    _done = true;
+                }
+                if ( _pos >= _docs.size() )
+                    return false;
+                out = _docs[ _pos++ ];
+                return true;
+            }
+        private:
+            struct Cmp {
+                Cmp( const BSONObj& p ) : pattern( p ) {}
+                bool operator()( const BSONObj& l , const BSONObj& r ) const {
+                    return l.woSortOrder( r , pattern , true ) < 0;
+                }
+                BSONObj pattern;
+            };
+            StagePtr _child;
+            BSONObj _pattern;
+            bool _done;
+            size_t _pos;
+            vector<BSONObj> _docs;
+        };
+
+        class GroupStage : public PipelineStage {
+        public:
+            GroupStage( const StagePtr& child , const BSONObj& spec )
+                : _child( child ) , _spec( spec.getOwned() ) , _done( false ) , _pos( 0 ) {
+                _idSpec = _spec["_id"];
+                uassert( 16290 , "aggregate $group requires an _id" , !_idSpec.eoo() );
+                BSONObjIterator i( _spec );
+                while ( i.more() ) {
+                    BSONElement e = i.next();
+                    if ( str::equals( e.fieldName() , "_id" ) )
+                        continue;
+                    uassert( 16291 , "aggregate $group accumulator must be an object with one $op" ,
+                             e.type() == Object && e.embeddedObject().nFields() == 1 );
+                    BSONElement op = e.embeddedObject().firstElement();
+                    Accum a;
+                    a.outField = e.fieldName();
+                    const char *opName = op.fieldName();
+                    if ( str::equals( opName , "$sum" ) ) a.op = SUM;
+                    else if ( str::equals( opName , "$avg" ) ) a.op = AVG;
+                    else if ( str::equals( opName , "$min" ) ) a.op = MIN;
+                    else if ( str::equals( opName , "$max" ) ) a.op = MAX;
+                    else if ( str::equals( opName , "$first" ) ) a.op = FIRST;
+                    else if ( str::equals( opName , "$last" ) ) a.op = LAST;
+                    else uasserted( 16292 , str::stream() << "aggregate $group unknown accumulator: " << opName );
+                    if ( op.type() == String && op.valuestr()[0] == '$' ) {
+                        a.inPath = op.valuestr() + 1;
+                        a.constVal = 0;
+                    }
+                    else {
+                        uassert( 16293 , "aggregate $group accumulator input must be a \"$path\", or a number for $sum" ,
+                                 a.op == SUM && op.isNumber() );
+                        a.constVal = op.number();
+                    }
+                    _accums.push_back( a );
+                }
+            }
+
+            virtual bool next( BSONObj& out ) {
+                if ( !_done )
+                    _aggregate();
+                if ( _pos >= _keys.size() )
+                    return false;
+                out = _emit( _pos++ );
+                return true;
+            }
+
+        private:
+            enum Op { SUM , AVG , MIN , MAX , FIRST , LAST };
+            struct Accum {
+                Op op;
+                string outField;
+                string inPath;   // empty means constant
+                double constVal;
+            };
+            struct State {
+                State() : sum( 0 ) , n( 0 ) , has( false ) {}
+                double sum;
+                long long n;
+                BSONObj val; // current min/max/first/last, wrapped for ownership
+                bool has;
+            };
+
+            void _aggregate() {
+                long long bytes = 0;
+                BSONObj doc;
+                while ( _child->next( doc ) ) {
+                    BSONObjBuilder kb( 64 );
+                    _appendKey( kb , doc );
+                    BSONObj key = kb.obj();
+                    int& n = _map[ key ];
+                    if ( n == 0 ) {
+                        bytes += key.objsize() + (long long)( _accums.size() * sizeof( State ) );
+                        uassert( 16294 , "aggregate $group exceeds memory limit" ,
+                                 bytes < 64 * 1024 * 1024 );
+                        _keys.push_back( key );
+                        _states.push_back( vector<State>( _accums.size() ) );
+                        n = (int) _keys.size();
+                    }
+                    vector<State>& st = _states[ n - 1 ];
+                    for ( unsigned i = 0; i < _accums.size(); i++ )
+                        _apply( _accums[i] , doc , st[i] );
+                }
+                _done = true;
+            }
+
+            /** evaluate the _id spec against doc, appending the group key as "_id" */
+            void _appendKey( BSONObjBuilder& b , const BSONObj& doc ) const {
+                if ( _idSpec.type() == String && _idSpec.valuestr()[0] == '$' ) {
+                    BSONElement v = doc.getFieldDotted( _idSpec.valuestr() + 1 );
+                    if ( v.eoo() )
+                        b.appendNull( "_id" );
+                    else
+                        b.appendAs( v , "_id" );
+                }
+                else if ( _idSpec.type() == Object ) {
+                    BSONObjBuilder sub( b.subobjStart( "_id" ) );
+                    BSONObjIterator i( _idSpec.embeddedObject() );
+                    while ( i.more() ) {
+                        BSONElement e = i.next();
+                        if ( e.type() == String && e.valuestr()[0] == '$' ) {
+                            BSONElement v = doc.getFieldDotted( e.valuestr() + 1 );
+                            if ( v.eoo() )
+                                sub.appendNull( e.fieldName() );
+                            else
+                                sub.appendAs( v , e.fieldName() );
+                        }
+                        else
+                            sub.append( e );
+                    }
+                    sub.done();
+                }
+                else {
+                    b.appendAs( _idSpec , "_id" );
+                }
+            }
+
+            void _apply( const Accum& a , const BSONObj& doc , State& s ) const {
+                if ( a.op == SUM && a.inPath.empty() ) {
+                    s.sum += a.constVal;
+                    return;
+                }
+                BSONElement e = doc.getFieldDotted( a.inPath.c_str() );
+                switch ( a.op ) {
+                case SUM:
+                    if ( e.isNumber() ) // non numeric values count as 0
+                        s.sum += e.number();
+                    break;
+                case AVG:
+                    if ( e.isNumber() ) { // averages only over numeric values
+                        s.sum += e.number();
+                        s.n++;
+                    }
+                    break;
+                case MIN:
+                    if ( !e.eoo() && ( !s.has || e.woCompare( s.val.firstElement() , false ) < 0 ) ) {
+                        s.val = e.wrap();
+                        s.has = true;
+                    }
+                    break;
+                case MAX:
+                    if ( !e.eoo() && ( !s.has || e.woCompare( s.val.firstElement() , false ) > 0 ) ) {
+                        s.val = e.wrap();
+                        s.has = true;
+                    }
+                    break;
+                case FIRST:
+                    if ( !s.has ) {
+                        s.val = e.eoo() ? BSONObj() : e.wrap();
+                        s.has = true;
+                    }
+                    break;
+                case LAST:
+                    s.val = e.eoo() ? BSONObj() : e.wrap();
+                    s.has = true;
+                    break;
+                }
+            }
+
+            BSONObj _emit( size_t i ) const {
+                BSONObjBuilder b;
+                b.appendElements( _keys[i] );
+                const vector<State>& st = _states[i];
+                for ( unsigned j = 0; j < _accums.size(); j++ ) {
+                    const Accum& a = _accums[j];
+                    const State& s = st[j];
+                    switch ( a.op ) {
+                    case SUM:
+                        if ( s.sum == (double)(long long) s.sum )
+                            b.appendIntOrLL( a.outField , (long long) s.sum );
+                        else
+                            b.append( a.outField , s.sum );
+                        break;
+                    case AVG:
+                        if ( s.n )
+                            b.append( a.outField , s.sum / s.n );
+                        else
+                            b.appendNull( a.outField );
+                        break;
+                    default: // MIN MAX FIRST LAST
+                        if ( s.has && !s.val.isEmpty() )
+                            b.appendAs( s.val.firstElement() , a.outField );
+                        else
+                            b.appendNull( a.outField );
+                        break;
+                    }
+                }
+                return b.obj();
+            }
+
+            StagePtr _child;
+            BSONObj _spec;
+            BSONElement _idSpec;
+            vector<Accum> _accums;
+            bool _done;
+            size_t _pos;
+            GroupKeyMap _map;
+            vector<BSONObj> _keys;               // group keys in group number order
+            vector< vector<State> > _states;     // accumulator states per group
+        };
+
+        long long stageNumber( const BSONElement& e , const char *stage ) {
+            uassert( 16285 , str::stream() << "aggregate " << stage << " requires a positive number" ,
+                     e.isNumber() && e.number() > 0 );
+            return e.numberLong();
+        }
+
+    } // namespace
+
+    class AggregateCommand : public Command {
+    public:
+        AggregateCommand() : Command( "aggregate" ) {}
+        virtual LockType locktype() const { return READ; }
+        virtual bool slaveOk() const { return false; }
+        virtual bool slaveOverrideOk() { return true; }
+        virtual void help( stringstream& help ) const {
+            help << "{ aggregate : <collection> , pipeline : [ { $match : ... } , { $group : ... } , ... ] }\n"
+                    "native streaming aggregation; stages: $match $project $unwind $group $sort $limit $skip";
+        }
+
+        virtual bool run(const string& dbname , BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool) {
+            string ns = dbname + "." + cmdObj.firstElement().valuestrsafe();
+
+            uassert( 16279 , "aggregate requires a pipeline array" , cmdObj["pipeline"].type() == Array );
+            vector<BSONElement> stages;
+            {
+                BSONObjIterator i( cmdObj["pipeline"].embeddedObject() );
+                while ( i.more() ) {
+                    BSONElement e = i.next();
+                    uassert( 16280 , "each pipeline stage must be an object with exactly one operator" ,
+                             e.type() == Object && e.embeddedObject().nFields() == 1 );
+                    stages.push_back( e );
+                }
+            }
+
+            // a leading $match is handed to the query optimizer with the cursor, so
+            // an index can drive the scan instead of filtering a full table scan
+            BSONObj query;
+            unsigned first = 0;
+            if ( !stages.empty() &&
+                 str::equals( stages[0].embeddedObject().firstElementFieldName() , "$match" ) ) {
+                BSONElement m = stages[0].embeddedObject().firstElement();
+                uassert( 16282 , "aggregate $match requires an object" , m.type() == Object );
+                query = m.embeddedObject();
+                first = 1;
+            }
+
+            StagePtr p( new CursorStage( ns , query ) );
+            for ( unsigned i = first; i < stages.size(); i++ ) {
+                BSONElement op = stages[i].embeddedObject().firstElement();
+                const char *name = op.fieldName();
+                if ( str::equals( name , "$match" ) ) {
+                    uassert( 16282 , "aggregate $match requires an object" , op.type() == Object );
+                    p.reset( new MatchStage( p , op.embeddedObject() ) );
+                }
+                else if ( str::equals( name , "$project" ) ) {
+                    uassert( 16283 , "aggregate $project requires an object" , op.type() == Object );
+                    p.reset( new ProjectStage( p , op.embeddedObject() ) );
+                }
+                else if ( str::equals( name , "$unwind" ) ) {
+                    p.reset( new UnwindStage( p , op ) );
+                }
+                else if ( str::equals( name , "$group" ) ) {
+                    uassert( 16289 , "aggregate $group requires an object" , op.type() == Object );
+                    p.reset( new GroupStage( p , op.embeddedObject() ) );
+                }
+                else if ( str::equals( name , "$sort" ) ) {
+                    uassert( 16284 , "aggregate $sort requires a nonempty pattern object" , op.type() == Object );
+                    p.reset( new SortStage( p , op.embeddedObject() ) );
+                }
+                else if ( str::equals( name , "$limit" ) ) {
+                    p.reset( new LimitStage( p , stageNumber( op , "$limit" ) ) );
+                }
+                else if ( str::equals( name , "$skip" ) ) {
+                    p.reset( new SkipStage( p , stageNumber( op , "$skip" ) ) );
+                }
+                else {
+                    uasserted( 16281 , str::stream() << "unknown aggregation stage: " << name );
+                }
+            }
+
+            BSONArrayBuilder arr( result.subarrayStart( "result" ) );
+            BSONObj doc;
+            while ( p->next( doc ) ) {
+                uassert( 16296 , "aggregation result exceeds maximum document size" ,
+                         arr.len() + doc.objsize() < BSONObjMaxUserSize );
+                arr.append( doc );
+            }
+            arr.done();
+            return true;
+        }
+
+    } aggregateCmd;
+
+} // namespace mongo
@@ -20,10 +20,67 @@
 #include "../instance.h"
 #include "../queryoptimizer.h"
 #include "../clientcursor.h"
+#include "../hasher.h"
 #include "../../util/timer.h"
 
 namespace mongo {
 
+    /* open addressing hash set over the elements already appended to the result
+       buffer.  membership is one cheap value hash plus, only on hash match, a full
+       compare - the BSONElementSet used before paid several deep woCompares per
+       probe, which dominated distinct over many unique values. */
+    class DistinctElementSet : boost::noncopyable {
+    public:
+        DistinctElementSet() : _slots( 1 << 10 ) , _used( 0 ) {}
+
+        bool count( const BSONElement& e , unsigned long long h ) const {
+            return ! _slots[ _find( e , h ) ].empty();
+        }
+
+        /** e must stay valid for the life of the set (it points into the result buffer) */
+        void insert( const BSONElement& e , unsigned long long h ) {
+            if ( ( _used + 1 ) * 3 > _slots.size() * 2 )
+                _grow();
+            Slot& s = _slots[ _find( e , h ) ];
+            if ( ! s.empty() )
+                return;
+            s.h = h;
+            s.e = e;
+            _used++;
+        }
+
+    private:
+        struct Slot {
+            Slot() : h( 0 ) {}
+            bool empty() const { return e.eoo(); }
+            unsigned long long h;
+            BSONElement e;
+        };
+
+        unsigned _find( const BSONElement& e , unsigned long long h ) const {
+            unsigned mask = _slots.size() - 1;
+            unsigned pos = (unsigned)( h & mask );
+            while ( ! _slots[pos].empty() &&
+                    ( _slots[pos].h != h || _slots[pos].e.woCompare( e , false ) != 0 ) )
+                pos = ( pos + 1 ) & mask;
+            return pos;
+        }
+
+        void _grow() {
+            vector<Slot> old;
+            old.swap( _slots );
+            _slots.resize( old.size() * 2 );
+            for ( unsigned i = 0; i < old.size(); i++ ) {
+                if ( old[i].empty() )
+                    continue;
+                _slots[ _find( old[i].e , old[i].h ) ] = old[i];
+            }
+        }
+
+        vector<Slot> _slots; // size is always a power of two
+        size_t _used;
+    };
+
     class DistinctCommand : public Command {
     public:
         DistinctCommand() : Command("distinct") {}
@@ -47,7 +104,7 @@ namespace mongo {
             char * start = bb.buf();
 
             BSONArrayBuilder arr( bb );
-            BSONElementSet values;
+            DistinctElementSet values;
 
             long long nscanned = 0; // locations looked at
             long long nscannedObjects = 0; // full objects looked at
@@ -109,7 +166,8 @@ namespace mongo {
 
                     for ( BSONElementSet::iterator i=temp.begin(); i!=temp.end(); ++i ) {
                         BSONElement e = *i;
-                        if ( values.count( e ) )
+                        unsigned long long h = bsonElementValueHash( e );
+                        if ( values.count( e , h ) )
                             continue;
 
                         int now = bb.len();
@@ -119,7 +177,7 @@ namespace mongo {
                         arr.append( e );
                         BSONElement x( start + now );
 
-                        values.insert( x );
+                        values.insert( x , h );
                     }
                 }
 
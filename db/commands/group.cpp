@@ -21,9 +21,87 @@
 #include "../queryoptimizer.h"
 #include "../../scripting/engine.h"
 #include "../clientcursor.h"
+#include "../hasher.h"
 
 namespace mongo {
 
+    static bool _readIdent( const string& s , size_t& i , string& out , bool allowDots ) {
+        size_t start = i;
+        while ( i < s.size() && ( isalnum( (unsigned char) s[i] ) || s[i] == '_' || s[i] == '$' ||
+                                  ( allowDots && s[i] == '.' ) ) )
+            i++;
+        out = s.substr( start , i - start );
+        return out.size() > 0;
+    }
+
+    /* Recognize reduce functions of the very common shapes
+           function(doc,out){ out.total += doc.price; }
+           function(doc,out){ out.count++; }               (also "out.count += 1")
+       (whitespace insensitive, any parameter names).  These cover the typical
+       "$sum-like" group reduces and let us accumulate natively instead of entering
+       the js engine once per matched document. */
+    static bool parseSimpleReduce( const string& code , string& accumField , string& sumField , bool& isCount ) {
+        string c;
+        for ( size_t j = 0; j < code.size(); j++ )
+            if ( ! isspace( (unsigned char) code[j] ) )
+                c += code[j];
+
+        if ( c.compare( 0 , 9 , "function(" ) != 0 )
+            return false;
+        size_t i = 9;
+
+        string p1, p2;
+        if ( ! _readIdent( c , i , p1 , false ) ) return false;
+        if ( i >= c.size() || c[i++] != ',' ) return false;
+        if ( ! _readIdent( c , i , p2 , false ) ) return false;
+        if ( c.compare( i , 2 , "){" ) != 0 ) return false;
+        i += 2;
+
+        if ( c.compare( i , p2.size() + 1 , p2 + "." ) != 0 ) return false;
+        i += p2.size() + 1;
+        if ( ! _readIdent( c , i , accumField , false ) ) return false;
+
+        if ( c.compare( i , 2 , "++" ) == 0 ) {
+            i += 2;
+            isCount = true;
+        }
+        else if ( c.compare( i , 2 , "+=" ) == 0 ) {
+            i += 2;
+            if ( i + 1 < c.size() && c[i] == '1' && ( c[i+1] == ';' || c[i+1] == '}' ) ) {
+                i += 1;
+                isCount = true;
+            }
+            else if ( c.compare( i , p1.size() + 1 , p1 + "." ) == 0 ) {
+                i += p1.size() + 1;
+                if ( ! _readIdent( c , i , sumField , true ) ) return false;
+                isCount = false;
+            }
+            else
+                return false;
+        }
+        else
+            return false;
+
+        if ( i < c.size() && c[i] == ';' )
+            i++;
+        return i + 1 == c.size() && c[i] == '}';
+    }
+
+    /* the value a native "out.x += doc.y" accumulates for one document, mirroring
+       js coercion for the values a numeric reduce will realistically see: numbers
+       are themselves, booleans 0/1, null 0, and anything else - including a
+       missing field, where js yields NaN - accumulates as NaN.  (js would
+       *concatenate* if the field held a string; we don't chase that.) */
+    static double reduceValue( const BSONElement& e ) {
+        if ( e.isNumber() )
+            return e.number();
+        if ( e.type() == Bool )
+            return e.boolean() ? 1 : 0;
+        if ( e.type() == jstNULL )
+            return 0;
+        return numeric_limits<double>::quiet_NaN();
+    }
+
     class GroupCommand : public Command {
     public:
         GroupCommand() : Command("group") {}
@@ -60,11 +138,23 @@ namespace mongo {
             if ( reduceScope )
                 s->init( reduceScope );
 
-            s->setObject( "$initial" , initial , true );
-
-            s->exec( "$reduce = " + reduceCode , "reduce setup" , false , true , true , 100 );
-            s->exec( "$arr = [];" , "reduce setup 2" , false , true , true , 100 );
-            ScriptingFunction f = s->createFunction(
+            // If the reduce is a simple numeric accumulation, run it natively - one
+            // js invocation per document is by far the dominant cost of group on big
+            // collections.  A custom scope, finalizer or non-numeric initial value
+            // takes the js path as before.
+            string accumField, sumField;
+            bool isCount = false;
+            bool nativeReduce = reduceScope == 0 && finalize.empty() &&
+                                parseSimpleReduce( reduceCode , accumField , sumField , isCount ) &&
+                                initial[ accumField ].isNumber();
+
+            ScriptingFunction f = 0;
+            if ( ! nativeReduce ) {
+                s->setObject( "$initial" , initial , true );
+
+                s->exec( "$reduce = " + reduceCode , "reduce setup" , false , true , true , 100 );
+                s->exec( "$arr = [];" , "reduce setup 2" , false , true , true , 100 );
+                f = s->createFunction(
                                       "function(){ "
                                       "  if ( $arr[n] == null ){ "
                                       "    next = {}; "
@@ -75,6 +165,7 @@ namespace mongo {
                                       "  } "
                                       "  $reduce( obj , $arr[n] ); "
                                       "}" );
+            }
 
             ScriptingFunction keyFunction = 0;
             if ( keyFunctionCode.size() ) {
@@ -85,8 +176,9 @@ namespace mongo {
             double keysize = keyPattern.objsize() * 3;
             double keynum = 1;
 
-            map<BSONObj,int,BSONObjCmp> map;
-            list<BSONObj> blah;
+            GroupKeyMap map;
+            vector<BSONObj> nativeKeys;   // group keys in group number order
+            vector<double> nativeAccums;  // accumulated value per group
 
             shared_ptr<Cursor> cursor = NamespaceDetailsTransient::getCursor(ns.c_str() , query);
             ClientCursor::CleanupPointer ccPointer;
@@ -120,11 +212,22 @@ namespace mongo {
                 int& n = map[key];
                 if ( n == 0 ) {
                     n = map.size();
-                    s->setObject( "$key" , key , true );
+                    if ( nativeReduce ) {
+                        nativeKeys.push_back( key );
+                        nativeAccums.push_back( initial[ accumField ].number() );
+                    }
+                    else {
+                        s->setObject( "$key" , key , true );
+                    }
 
                     uassert( 10043 ,  "group() can't handle more than 20000 unique keys" , n <= 20000 );
                 }
 
+                if ( nativeReduce ) {
+                    nativeAccums[ n - 1 ] += isCount ? 1 : reduceValue( obj.getFieldDotted( sumField.c_str() ) );
+                    continue;
+                }
+
                 s->setObject( "obj" , obj , true );
                 s->setNumber( "n" , n - 1 );
                 if ( s->invoke( f , 0, 0 , 0 , true ) ) {
@@ -133,6 +236,42 @@ namespace mongo {
             }
             ccPointer.reset();
 
+            if ( nativeReduce ) {
+                // Build the retval array directly, matching the field layout the js
+                // path produces: key fields first, then the initial object's fields,
+                // with the accumulated field carrying its final value wherever it
+                // first appears.
+                BSONArrayBuilder retval;
+                for ( unsigned i = 0; i < nativeKeys.size(); i++ ) {
+                    BSONObjBuilder b( retval.subobjStart() );
+                    BSONObjIterator ki( nativeKeys[i] );
+                    while ( ki.more() ) {
+                        BSONElement ke = ki.next();
+                        if ( strcmp( ke.fieldName() , accumField.c_str() ) == 0 )
+                            b.append( accumField , nativeAccums[i] );
+                        else if ( initial.hasField( ke.fieldName() ) )
+                            b.append( initial[ ke.fieldName() ] );
+                        else
+                            b.append( ke );
+                    }
+                    BSONObjIterator ii( initial );
+                    while ( ii.more() ) {
+                        BSONElement ie = ii.next();
+                        if ( nativeKeys[i].hasField( ie.fieldName() ) )
+                            continue; // already emitted in key position
+                        if ( strcmp( ie.fieldName() , accumField.c_str() ) == 0 )
+                            b.append( accumField , nativeAccums[i] );
+                        else
+                            b.append( ie );
+                    }
+                    b.done();
+                }
+                result.appendArray( "retval" , retval.arr() );
+                result.append( "count" , keynum - 1 );
+                result.append( "keys" , (int)(map.size()) );
+                return true;
+            }
+
             if (!finalize.empty()) {
                 s->exec( "$finalize = " + finalize , "finalize define" , false , true , true , 100 );
                 ScriptingFunction g = s->createFunction(
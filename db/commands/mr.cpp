@@ -25,6 +25,7 @@
 #include "../../client/parallel.h"
 #include "../queryoptimizer.h"
 #include "../matcher.h"
+#include "../../util/memaccount.h"
 #include "../clientcursor.h"
 #include "../replutil.h"
 #include "../../s/d_chunk_manager.h"
@@ -32,6 +33,8 @@
 
 #include "mr.h"
 
+#include <deque>
+
 namespace mongo {
 
     namespace mr {
@@ -47,7 +50,11 @@ namespace mongo {
         }
 
         void JSFunction::init( State * state ) {
-            _scope = state->scope();
+            init( state->scope() );
+        }
+
+        void JSFunction::init( Scope * scope ) {
+            _scope = scope;
             assert( _scope );
             _scope->init( &_wantedScope );
 
@@ -58,15 +65,81 @@ namespace mongo {
             _scope->setFunction(_type.c_str(), _code.c_str());
         }
 
+        static bool _readDottedIdent( const string& s , size_t& i , string& out ) {
+            size_t start = i;
+            while ( i < s.size() && ( isalnum( (unsigned char)s[i] ) || s[i] == '_' || s[i] == '$' || s[i] == '.' ) )
+                i++;
+            out = s.substr( start , i - start );
+            return ! out.empty() && out[0] != '.' && out[ out.size() - 1 ] != '.';
+        }
+
+        /**
+         * recognizes mappers of the form
+         *     function() { emit( this.<key> , this.<value> ); }
+         * so the common "regroup by a field" job can emit straight off the
+         * document's BSONElements instead of converting every document into a
+         * js object.  whitespace insensitive; anything else runs through js.
+         */
+        static bool parseSimpleMap( const string& raw , string& keyField , string& valueField ) {
+            string code;
+            code.reserve( raw.size() );
+            for ( size_t j = 0; j < raw.size(); j++ )
+                if ( ! isspace( (unsigned char)raw[j] ) )
+                    code.push_back( raw[j] );
+
+            if ( code.compare( 0 , 10 , "function()" ) != 0 )
+                return false;
+            size_t i = 10;
+            if ( code.compare( i , 11 , "{emit(this." ) != 0 )
+                return false;
+            i += 11;
+            if ( ! _readDottedIdent( code , i , keyField ) )
+                return false;
+            if ( code.compare( i , 6 , ",this." ) != 0 )
+                return false;
+            i += 6;
+            if ( ! _readDottedIdent( code , i , valueField ) )
+                return false;
+            if ( code.compare( i , 2 , ");" ) == 0 )
+                i += 2;
+            else if ( code.compare( i , 1 , ")" ) == 0 )
+                i += 1;
+            else
+                return false;
+            return code.compare( i , 1 , "}" ) == 0 && i + 1 == code.size();
+        }
+
         void JSMapper::init( State * state ) {
             _func.init( state );
             _params = state->config().mapParams;
+            _state = state;
+            // CodeWScope mappers may reference scope variables, and parameters
+            // don't fit the recognized form
+            _simple = ! _hasCodeScope && _params.isEmpty() &&
+                      parseSimpleMap( _func.code() , _keyField , _valueField );
         }
 
         /**
          * Applies the map function to an object, which should internally call emit()
          */
         void JSMapper::map( const BSONObj& o ) {
+            if ( _simple && ! _state->jsMode() ) {
+                BSONElement k = o.getFieldDotted( _keyField.c_str() );
+                BSONElement v = o.getFieldDotted( _valueField.c_str() );
+                // missing/undefined fields and oversized emits keep their exact
+                // js semantics by going through the real mapper below
+                if ( ! k.eoo() && k.type() != Undefined && ! v.eoo() && v.type() != Undefined ) {
+                    BSONObjBuilder b( k.size() + v.size() + 8 );
+                    b.appendAs( k , "0" );
+                    b.appendAs( v , "1" );
+                    BSONObj tuple = b.obj();
+                    if ( tuple.objsize() < BSONObjMaxUserSize / 2 ) {
+                        _state->emit( tuple );
+                        return;
+                    }
+                }
+            }
+
             Scope * s = _func.scope();
             assert( s );
             if ( s->invoke( _func.func() , &_params, &o , 0 , true, false, true ) )
@@ -291,8 +364,11 @@ namespace mongo {
 
                 mapper.reset( new JSMapper( cmdObj["map"] ) );
                 reducer.reset( new JSReducer( cmdObj["reduce"] ) );
-                if ( cmdObj["finalize"].type() && cmdObj["finalize"].trueValue() )
+                reduceSpec = cmdObj["reduce"].wrap();
+                if ( cmdObj["finalize"].type() && cmdObj["finalize"].trueValue() ) {
                     finalizer.reset( new JSFinalizer( cmdObj["finalize"] ) );
+                    finalizeSpec = cmdObj["finalize"].wrap();
+                }
 
                 if ( cmdObj["mapparams"].type() == Array ) {
                     mapParams = cmdObj["mapparams"].embeddedObjectUserCheck();
@@ -386,6 +462,10 @@ namespace mongo {
          * For inline mode, appends results to output object.
          * Makes sure (key, value) tuple is formatted as {_id: key, value: val}
          */
+        static bool _entryKeyCmp( const InMemory::iterator& l , const InMemory::iterator& r ) {
+            return TupleKeyCmp()( l->first , r->first );
+        }
+
         void State::appendResults( BSONObjBuilder& final ) {
             if ( _onDisk ) {
                 if (!_config.outDB.empty()) {
@@ -422,13 +502,23 @@ namespace mongo {
                 return;
             }
 
-            uassert( 13604 , "too much data for in memory map/reduce" , _size < BSONObjMaxUserSize );
+            long size = _temp->totalBytes();
+            uassert( 13604 , "too much data for in memory map/reduce" , size < BSONObjMaxUserSize );
 
-            BSONArrayBuilder b( (int)(_size * 1.2) ); // _size is data size, doesn't count overhead and keys
+            BSONArrayBuilder b( (int)(size * 1.2) ); // size is data size, doesn't count overhead and keys
 
-            for ( InMemory::iterator i=_temp->begin(); i!=_temp->end(); ++i ) {
-                BSONObj key = i->first;
-                BSONList& all = i->second;
+            // merge the sorted partitions so inline results stay in key order
+            vector<InMemory::iterator> entries;
+            for ( unsigned p = 0; p < PartitionedInMemory::NumPartitions; p++ ) {
+                InMemory& part = _temp->partition( p );
+                for ( InMemory::iterator i=part.begin(); i!=part.end(); ++i )
+                    entries.push_back( i );
+            }
+            sort( entries.begin() , entries.end() , _entryKeyCmp );
+
+            for ( vector<InMemory::iterator>::iterator e=entries.begin(); e!=entries.end(); ++e ) {
+                BSONObj key = (*e)->first;
+                BSONList& all = (*e)->second;
 
                 assert( all.size() == 1 );
 
@@ -451,7 +541,7 @@ namespace mongo {
          */
         long long State::postProcessCollection(CurOp* op, ProgressMeterHolder& pm) {
             if ( _onDisk == false || _config.outType == Config::INMEMORY )
-                return _temp->size();
+                return _temp->totalKeys();
 
             if (_config.outNonAtomic)
                 return postProcessCollectionNonAtomic(op, pm);
@@ -538,6 +628,24 @@ namespace mongo {
             theDataFileMgr.insertAndLog( ns.c_str() , o , false );
         }
 
+        /**
+         * Insert a batch of docs in one lock cycle, clearing 'batch'
+         */
+        void State::insertBatch( const string& ns , vector<BSONObj>& batch ) {
+            if ( batch.empty() )
+                return;
+            assert( _onDisk );
+
+            writelock l( ns );
+            Client::Context ctx( ns );
+
+            for ( unsigned i = 0; i < batch.size(); i++ ) {
+                theDataFileMgr.insertAndLog( ns.c_str() , batch[i] , false );
+                getDur().commitIfNeeded();
+            }
+            batch.clear();
+        }
+
         /**
          * Insert doc into the inc collection, taking proper lock
          */
@@ -556,8 +664,8 @@ namespace mongo {
             getDur().commitIfNeeded();
         }
 
-        State::State( const Config& c ) : _config( c ), _size(0), _dupCount(0), _numEmits(0) {
-            _temp.reset( new InMemory() );
+        State::State( const Config& c ) : _config( c ), _accountedBytes(0), _numEmits(0) {
+            _temp.reset( new PartitionedInMemory() );
             _onDisk = _config.outType != Config::INMEMORY;
         }
 
@@ -585,6 +693,8 @@ namespace mongo {
                 ScriptingFunction cleanup = _scope->createFunction("delete _emitCt; delete _keyCt; delete _mrMap;");
                 _scope->invoke(cleanup, 0, 0, 0, true);
             }
+
+            memaccount::noteBytes( memaccount::MapReduce , -_accountedBytes );
         }
 
         /**
@@ -676,6 +786,167 @@ namespace mongo {
 //            return BSONObj();
 //        }
 
+        /**
+         * Runs the final reduce/finalize/insert for key groups on a small pool of
+         * worker threads, each with its own js scope.  The producing scan - the
+         * (3/3) pass for a local m/r, or the sorted cross-shard merge for a
+         * sharded finish - stays on the calling thread and hands complete key
+         * groups over through a bounded queue, so memory stays capped and the
+         * scan gets backpressure when the reducers fall behind.  With v8 each
+         * scope has its own isolate so the reduces genuinely run in parallel;
+         * with spidermonkey all scopes share the global js lock and the win is
+         * limited to overlapping the scan and the inserts with js execution.
+         * Results are written many per writelock cycle via insertBatch() rather
+         * than one lock round trip per key.
+         */
+        class ReduceWorkers : boost::noncopyable {
+        public:
+            ReduceWorkers( State * state ) : _state( state ) , _mutex( "ReduceWorkers" ) , _done( false ) , _active( 0 ) , _reduces( 0 ) , _reducedBytes( 0 ) {
+                unsigned n = boost::thread::hardware_concurrency();
+                if ( n < 1 ) n = 1;
+                if ( n > MaxWorkers ) n = MaxWorkers;
+                for ( unsigned i = 0; i < n; i++ )
+                    _threads.push_back( shared_ptr<boost::thread>( new boost::thread( boost::bind( &ReduceWorkers::_run , this ) ) ) );
+            }
+
+            ~ReduceWorkers() {
+                // normally finish() has already joined; this is the exception path
+                _shutdown();
+                for ( unsigned i = 0; i < _threads.size(); i++ )
+                    _threads[i]->join();
+            }
+
+            /** hand over one key group.  call without the db lock held: this can
+                block until a worker frees up a queue slot. */
+            void push( BSONList& values ) {
+                scoped_lock lk( _mutex );
+                while ( _queue.size() >= MaxQueuedGroups && _err.empty() && ! _done )
+                    _space.wait( lk.boost() );
+                if ( ! _err.empty() )
+                    return; // finish() will report it
+                _queue.push_back( BSONList() );
+                _queue.back().swap( values );
+                _work.notify_one();
+            }
+
+            /** wait until every group pushed so far has been reduced.  inserts
+                may still be buffered in worker batches - only finish()
+                guarantees they have reached the collection.
+                @return total byte size of the reduced output so far */
+            long long waitIdle() {
+                scoped_lock lk( _mutex );
+                while ( ( ! _queue.empty() || _active > 0 ) && _err.empty() && ! _done )
+                    _idle.wait( lk.boost() );
+                return _reducedBytes;
+            }
+
+            /** drain the queue, join the workers and rethrow any worker error.
+                @return total number of reduces run by the workers */
+            long long finish() {
+                _shutdown();
+                for ( unsigned i = 0; i < _threads.size(); i++ )
+                    _threads[i]->join();
+                _threads.clear();
+                scoped_lock lk( _mutex );
+                uassert( 16250 , str::stream() << "map/reduce final reduce failed: " << _err , _err.empty() );
+                return _reduces;
+            }
+
+        private:
+            enum { MaxWorkers = 4 , MaxQueuedGroups = 16 ,
+                   InsertBatchDocs = 64 , InsertBatchBytes = 2 * 1024 * 1024 };
+
+            void _shutdown() {
+                scoped_lock lk( _mutex );
+                _done = true;
+                _work.notify_all();
+                _space.notify_all();
+                _idle.notify_all();
+            }
+
+            bool _pop( BSONList& out ) {
+                scoped_lock lk( _mutex );
+                while ( _queue.empty() && ! _done )
+                    _work.wait( lk.boost() );
+                if ( _queue.empty() )
+                    return false;
+                out.swap( _queue.front() );
+                _queue.pop_front();
+                _active++;
+                _space.notify_one();
+                return true;
+            }
+
+            void _groupDone( int bytes ) {
+                scoped_lock lk( _mutex );
+                _reducedBytes += bytes;
+                _active--;
+                if ( _queue.empty() && _active == 0 )
+                    _idle.notify_all();
+            }
+
+            void _run() {
+                Client::initThread( "mr_reduce" );
+                try {
+                    auto_ptr<Scope> scope( globalScriptEngine->getPooledScope( _state->config().dbname ).release() );
+                    scope->localConnect( _state->config().dbname.c_str() );
+                    if ( ! _state->config().scopeSetup.isEmpty() )
+                        scope->init( &_state->config().scopeSetup );
+
+                    JSReducer reducer( _state->config().reduceSpec.firstElement() );
+                    reducer.init( scope.get() );
+                    scoped_ptr<JSFinalizer> finalizer;
+                    if ( ! _state->config().finalizeSpec.isEmpty() ) {
+                        finalizer.reset( new JSFinalizer( _state->config().finalizeSpec.firstElement() ) );
+                        finalizer->init( scope.get() );
+                    }
+
+                    BSONList values;
+                    vector<BSONObj> batch;
+                    long long batchBytes = 0;
+                    while ( _pop( values ) ) {
+                        BSONObj res = reducer.finalReduce( values , finalizer.get() );
+                        values.clear();
+                        batch.push_back( res );
+                        batchBytes += res.objsize();
+                        if ( (int)batch.size() >= InsertBatchDocs || batchBytes >= InsertBatchBytes ) {
+                            _state->insertBatch( _state->config().tempLong , batch );
+                            batchBytes = 0;
+                        }
+                        _groupDone( res.objsize() );
+                    }
+                    _state->insertBatch( _state->config().tempLong , batch );
+
+                    scoped_lock lk( _mutex );
+                    _reduces += reducer.numReduces;
+                }
+                catch ( std::exception& e ) {
+                    scoped_lock lk( _mutex );
+                    if ( _err.empty() )
+                        _err = e.what();
+                    _done = true;
+                    _active = 0;
+                    _work.notify_all();
+                    _space.notify_all();
+                    _idle.notify_all();
+                }
+                cc().shutdown();
+            }
+
+            State * _state;
+            mongo::mutex _mutex;
+            boost::condition _work; // queue went non-empty (or shutdown)
+            boost::condition _space; // queue has room again
+            boost::condition _idle; // queue empty and no group in flight
+            deque<BSONList> _queue;
+            bool _done;
+            unsigned _active; // groups popped but not yet reduced
+            long long _reduces;
+            long long _reducedBytes; // total objsize of reduced output
+            string _err; // first worker error, rethrown by finish()
+            vector< shared_ptr<boost::thread> > _threads;
+        };
+
         /**
          * Applies last reduce and finalize.
          * After calling this method, the temp collection will be completed.
@@ -699,26 +970,28 @@ namespace mongo {
             if ( ! _onDisk ) {
                 // all data has already been reduced, just finalize
                 if ( _config.finalizer ) {
-                    long size = 0;
-                    for ( InMemory::iterator i=_temp->begin(); i!=_temp->end(); ++i ) {
-                        BSONObj key = i->first;
-                        BSONList& all = i->second;
+                    for ( unsigned p = 0; p < PartitionedInMemory::NumPartitions; p++ ) {
+                        InMemory& part = _temp->partition( p );
+                        long size = 0;
+                        for ( InMemory::iterator i=part.begin(); i!=part.end(); ++i ) {
+                            BSONList& all = i->second;
 
-                        assert( all.size() == 1 );
+                            assert( all.size() == 1 );
 
-                        BSONObj res = _config.finalizer->finalize( all[0] );
+                            BSONObj res = _config.finalizer->finalize( all[0] );
 
-                        all.clear();
-                        all.push_back( res );
-                        size += res.objsize();
+                            all.clear();
+                            all.push_back( res );
+                            size += res.objsize();
+                        }
+                        _temp->sizeOf( p ) = size;
                     }
-                    _size = size;
                 }
                 return;
             }
 
             // use index on "0" to pull sorted data
-            assert( _temp->size() == 0 );
+            assert( _temp->totalKeys() == 0 );
             BSONObj sortKey = BSON( "0" << 1 );
             {
                 bool foundIndex = false;
@@ -735,6 +1008,10 @@ namespace mongo {
                 assert( foundIndex );
             }
 
+            // constructed before the readlock so its destructor (which joins the
+            // workers) runs after the lock is released on the exception path
+            ReduceWorkers workers( this );
+
             readlock rl( _config.incLong.c_str() );
             Client::Context ctx( _config.incLong );
 
@@ -769,8 +1046,10 @@ namespace mongo {
                 ClientCursor::YieldLock yield (cursor.get());
 
                 try {
-                    // reduce a finalize array
-                    finalReduce( all );
+                    // hand the completed group to the reduce workers; this can
+                    // block for backpressure, so it happens with the lock yielded
+                    if ( all.size() )
+                        workers.push( all );
                 }
                 catch (...) {
                     yield.relock();
@@ -797,16 +1076,19 @@ namespace mongo {
                 dbtempreleasecond tl;
                 if ( ! tl.unlocked() )
                     log( LL_WARNING ) << "map/reduce can't temp release" << endl;
-                // reduce and finalize last array
-                finalReduce( all );
+                // hand over the last group and wait for the workers to drain
+                if ( all.size() )
+                    workers.push( all );
+                _config.reducer->numReduces += workers.finish();
             }
 
             pm.finished();
         }
 
         /**
-         * Attempts to reduce objects in the memory map.
-         * A new memory map will be created to hold the results.
+         * Attempts to reduce objects in the memory map, one partition at a time.
+         * Each partition is rebuilt independently, so peak extra memory is one
+         * partition's worth rather than a full copy of the map.
          * If applicable, objects with unique key may be dumped to inc collection.
          * Input and output objects are both {"0": key, "1": val}
          */
@@ -817,37 +1099,54 @@ namespace mongo {
                 return;
             }
 
-            auto_ptr<InMemory> n( new InMemory() ); // for new data
-            long nSize = 0;
-            _dupCount = 0;
-
-            for ( InMemory::iterator i=_temp->begin(); i!=_temp->end(); ++i ) {
-                BSONObj key = i->first;
-                BSONList& all = i->second;
-
-                if ( all.size() == 1 ) {
-                    // only 1 value for this key
-                    if ( _onDisk ) {
-                        // this key has low cardinality, so just write to collection
-                        writelock l(_config.incLong);
-                        Client::Context ctx(_config.incLong.c_str());
-                        _insertToInc( *(all.begin()) );
+            for ( unsigned p = 0; p < PartitionedInMemory::NumPartitions; p++ ) {
+                InMemory& part = _temp->partition( p );
+                InMemory n; // rebuilt partition
+                long nSize = 0;
+                long nDups = 0;
+
+                for ( InMemory::iterator i=part.begin(); i!=part.end(); ++i ) {
+                    BSONList& all = i->second;
+
+                    if ( all.size() == 1 ) {
+                        // only 1 value for this key
+                        if ( _onDisk ) {
+                            // this key has low cardinality, so just write to collection
+                            writelock l(_config.incLong);
+                            Client::Context ctx(_config.incLong.c_str());
+                            _insertToInc( *(all.begin()) );
+                        }
+                        else {
+                            // add to new map
+                            _add( n , all[0] , nSize , nDups );
+                        }
                     }
-                    else {
-                        // add to new map
-                        _add( n.get() , all[0] , nSize );
+                    else if ( all.size() > 1 ) {
+                        // several values, reduce and add to map
+                        BSONObj res = _config.reducer->reduce( all );
+                        _add( n , res , nSize , nDups );
                     }
                 }
-                else if ( all.size() > 1 ) {
-                    // several values, reduce and add to map
-                    BSONObj res = _config.reducer->reduce( all );
-                    _add( n.get() , res , nSize );
-                }
+
+                part.swap( n );
+                _temp->sizeOf( p ) = nSize;
+                _temp->dupsOf( p ) = nDups;
             }
+        }
+
+        void State::_spillPartition( unsigned p ) {
+            InMemory& part = _temp->partition( p );
+            for ( InMemory::iterator i=part.begin(); i!=part.end(); i++ ) {
+                BSONList& all = i->second;
+                if ( all.size() < 1 )
+                    continue;
 
-            // swap maps
-            _temp.reset( n.release() );
-            _size = nSize;
+                for ( BSONList::iterator j=all.begin(); j!=all.end(); j++ )
+                    _insertToInc( *j );
+            }
+            part.clear();
+            _temp->sizeOf( p ) = 0;
+            _temp->dupsOf( p ) = 0;
         }
 
         /**
@@ -860,17 +1159,27 @@ namespace mongo {
             writelock l(_config.incLong);
             Client::Context ctx(_config.incLong);
 
-            for ( InMemory::iterator i=_temp->begin(); i!=_temp->end(); i++ ) {
-                BSONList& all = i->second;
-                if ( all.size() < 1 )
-                    continue;
+            for ( unsigned p = 0; p < PartitionedInMemory::NumPartitions; p++ )
+                _spillPartition( p );
+        }
 
-                for ( BSONList::iterator j=all.begin(); j!=all.end(); j++ )
-                    _insertToInc( *j );
-            }
-            _temp->clear();
-            _size = 0;
+        void State::spillHeaviestPartitions( long targetBytes ) {
+            if ( ! _onDisk )
+                return;
 
+            writelock l(_config.incLong);
+            Client::Context ctx(_config.incLong);
+
+            while ( _temp->totalBytes() > targetBytes ) {
+                unsigned heaviest = 0;
+                for ( unsigned p = 1; p < PartitionedInMemory::NumPartitions; p++ ) {
+                    if ( _temp->sizeOf( p ) > _temp->sizeOf( heaviest ) )
+                        heaviest = p;
+                }
+                if ( _temp->sizeOf( heaviest ) == 0 )
+                    break;
+                _spillPartition( heaviest );
+            }
         }
 
         /**
@@ -878,15 +1187,16 @@ namespace mongo {
          */
         void State::emit( const BSONObj& a ) {
             _numEmits++;
-            _add( _temp.get() , a , _size );
+            unsigned p = PartitionedInMemory::partitionFor( a );
+            _add( _temp->partition( p ) , a , _temp->sizeOf( p ) , _temp->dupsOf( p ) );
         }
 
-        void State::_add( InMemory* im, const BSONObj& a , long& size ) {
-            BSONList& all = (*im)[a];
+        void State::_add( InMemory& im, const BSONObj& a , long& size , long& dupCount ) {
+            BSONList& all = im[a];
             all.push_back( a );
             size += a.objsize() + 16;
             if (all.size() > 1)
-                ++_dupCount;
+                ++dupCount;
         }
 
         /**
@@ -915,19 +1225,32 @@ namespace mongo {
             if (_jsMode)
                 return;
 
-            if (_size > _config.maxInMemSize || _dupCount > (_temp->size() * _config.reduceTriggerRatio)) {
+            long size = _temp->totalBytes();
+            if (size > _config.maxInMemSize || _temp->totalDups() > (_temp->totalKeys() * _config.reduceTriggerRatio)) {
                 // attempt to reduce in memory map, if memory is too high or we have many duplicates
-                long oldSize = _size;
+                long oldSize = size;
+                long oldDups = _temp->totalDups();
                 Timer t;
                 reduceInMemory();
-                log(1) << "  MR - did reduceInMemory: size=" << oldSize << " dups=" << _dupCount << " newSize=" << _size << " time=" << t.millis() << "ms" << endl;
-
-                // if size is still high, or values are not reducing well, dump
-                if ( _onDisk && (_size > _config.maxInMemSize || _size > oldSize / 2) ) {
-                    dumpToInc();
-                    log(1) << "  MR - dumping to db" << endl;
+                size = _temp->totalBytes();
+                log(1) << "  MR - did reduceInMemory: size=" << oldSize << " dups=" << oldDups << " newSize=" << size << " time=" << t.millis() << "ms" << endl;
+
+                // if size is still high, or values are not reducing well, or the server
+                // as a whole is over its transient-memory limit, spill whole partitions
+                // (heaviest first) until half the budget is free again - the surviving
+                // partitions keep their hot keys in memory
+                if ( _onDisk && (size > _config.maxInMemSize || size > oldSize / 2 ||
+                                 memaccount::underPressure()) ) {
+                    spillHeaviestPartitions( _config.maxInMemSize / 2 );
+                    log(1) << "  MR - spilled to db, inMemSize=" << _temp->totalBytes() << endl;
                 }
             }
+
+            // refresh the accounting to the map's current size; a delta per
+            // checkSize (i.e. per emit) rather than per mutation is plenty
+            long cur = _temp->totalBytes();
+            memaccount::noteBytes( memaccount::MapReduce , cur - _accountedBytes );
+            _accountedBytes = cur;
         }
 
         /**
@@ -1236,6 +1559,16 @@ namespace mongo {
                 unsigned int index = 0;
                 BSONObj query;
                 BSONArrayBuilder chunkSizes;
+
+                // when writing to disk, hand key groups to a worker pool so the
+                // js reduce/finalize and the inserts overlap with the sorted
+                // merge, which keeps streaming results in from the other shards
+                // instead of stalling behind each reduce
+                scoped_ptr<ReduceWorkers> workers;
+                if ( state.isOnDisk() )
+                    workers.reset( new ReduceWorkers( &state ) );
+                long long reducedBytesPrev = 0;
+
                 while (true) {
                     if (ranges.size() > 0) {
                         BSONElement min = ranges[index];
@@ -1270,23 +1603,38 @@ namespace mongo {
                             }
                         }
 
-                        BSONObj res = config.reducer->finalReduce( values , config.finalizer.get());
-                        chunkSize += res.objsize();
-                        if (state.isOnDisk())
-                            state.insertToInc(res);
-                        else
+                        if ( workers ) {
+                            // push swaps the group out, leaving values empty
+                            workers->push( values );
+                        }
+                        else {
+                            BSONObj res = config.reducer->finalReduce( values , config.finalizer.get());
+                            chunkSize += res.objsize();
                             state.emit(res);
-                        values.clear();
+                            values.clear();
+                        }
                         if (!t.isEmpty())
                             values.push_back( t );
                     }
 
+                    if ( workers ) {
+                        // let the pool catch up so this range's output size is
+                        // attributable; within the range the merge and reduces
+                        // ran overlapped
+                        long long total = workers->waitIdle();
+                        chunkSize = total - reducedBytesPrev;
+                        reducedBytesPrev = total;
+                    }
                     chunkSizes.append(chunkSize);
                     index += 2;
                     if (index >= ranges.size())
                         break;
                 }
 
+                // join the workers; all output is in the temp collection after this
+                if ( workers )
+                    config.reducer->numReduces += workers->finish();
+
                 result.append( "chunkSizes" , chunkSizes.arr() );
 
                 long long outputCount = state.postProcessCollection(op, pm);
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "pch.h"
+#include "../hasher.h"
 
 namespace mongo {
 
@@ -77,8 +78,12 @@ namespace mongo {
 
             virtual void init( State * state );
 
+            /** bind to an explicit scope - the parallel reduce workers each bring their own */
+            void init( Scope * scope );
+
             Scope * scope() const { return _scope; }
             ScriptingFunction func() const { return _func; }
+            const string& code() const { return _code; }
 
         private:
             string _type;
@@ -91,19 +96,28 @@ namespace mongo {
 
         class JSMapper : public Mapper {
         public:
-            JSMapper( const BSONElement & code ) : _func( "_map" , code ) {}
+            JSMapper( const BSONElement & code ) : _func( "_map" , code ) , _hasCodeScope( code.type() == CodeWScope ) , _simple( false ) , _state( 0 ) {}
             virtual void map( const BSONObj& o );
             virtual void init( State * state );
 
         private:
             JSFunction _func;
             BSONObj _params;
+
+            // native fast path for mappers of the form
+            // function() { emit( this.k , this.v ); } - see parseSimpleMap()
+            bool _hasCodeScope;
+            bool _simple;
+            string _keyField;
+            string _valueField;
+            State * _state;
         };
 
         class JSReducer : public Reducer {
         public:
             JSReducer( const BSONElement& code ) : _func( "_reduce" , code ) {}
             virtual void init( State * state );
+            void init( Scope * scope ) { _func.init( scope ); }
 
             virtual BSONObj reduce( const BSONList& tuples );
             virtual BSONObj finalReduce( const BSONList& tuples , Finalizer * finalizer );
@@ -125,6 +139,7 @@ namespace mongo {
             JSFinalizer( const BSONElement& code ) : _func( "_finalize" , code ) {}
             virtual BSONObj finalize( const BSONObj& o );
             virtual void init( State * state ) { _func.init( state ); }
+            void init( Scope * scope ) { _func.init( scope ); }
         private:
             JSFunction _func;
 
@@ -143,6 +158,58 @@ namespace mongo {
 
         typedef map< BSONObj,BSONList,TupleKeyCmp > InMemory; // from key to list of tuples
 
+        /**
+         * emitted tuples hash partitioned by key into independent sub-tables.
+         * each partition carries its own size and dup accounting, so an in memory
+         * reduce rebuilds one partition at a time and a spill can evict just the
+         * heaviest partitions while hot keys stay cached.  partitions are also the
+         * unit a concurrent producer would lock; today all emitters run on the
+         * mapping thread, so no locking is done here yet.
+         */
+        class PartitionedInMemory : boost::noncopyable {
+        public:
+            enum { NumPartitions = 16 }; // a power of two
+
+            PartitionedInMemory() {
+                for ( int i = 0; i < NumPartitions; i++ )
+                    _sizes[i] = _dups[i] = 0;
+            }
+
+            /** partitioning must agree with TupleKeyCmp equality, so it hashes the
+                key's value the way the comparison compares it */
+            static unsigned partitionFor( const BSONObj& tuple ) {
+                return (unsigned)( bsonElementValueHash( tuple.firstElement() ) & ( NumPartitions - 1 ) );
+            }
+
+            InMemory& partition( unsigned i ) { return _parts[i]; }
+            long& sizeOf( unsigned i ) { return _sizes[i]; }
+            long& dupsOf( unsigned i ) { return _dups[i]; }
+
+            long long totalKeys() const {
+                long long n = 0;
+                for ( int i = 0; i < NumPartitions; i++ )
+                    n += _parts[i].size();
+                return n;
+            }
+            long totalBytes() const {
+                long n = 0;
+                for ( int i = 0; i < NumPartitions; i++ )
+                    n += _sizes[i];
+                return n;
+            }
+            long totalDups() const {
+                long n = 0;
+                for ( int i = 0; i < NumPartitions; i++ )
+                    n += _dups[i];
+                return n;
+            }
+
+        private:
+            InMemory _parts[NumPartitions];
+            long _sizes[NumPartitions]; // bytes of tuples per partition
+            long _dups[NumPartitions];  // duplicate key entries per partition
+        };
+
         /**
          * holds map/reduce config information
          */
@@ -170,6 +237,11 @@ namespace mongo {
             scoped_ptr<Reducer> reducer;
             scoped_ptr<Finalizer> finalizer;
 
+            // owned copies of the reduce/finalize elements so the parallel
+            // final reduce can compile per-worker copies in their own scopes
+            BSONObj reduceSpec;
+            BSONObj finalizeSpec; // empty if no finalizer
+
             BSONObj mapParams;
             BSONObj scopeSetup;
 
@@ -239,6 +311,12 @@ namespace mongo {
              * transfers in memory storage to temp collection
              */
             void dumpToInc();
+
+            /**
+             * spills whole partitions, heaviest first, until at most targetBytes
+             * remain in memory - the surviving partitions keep their reduced values
+             */
+            void spillHeaviestPartitions( long targetBytes );
             void insertToInc( BSONObj& o );
             void _insertToInc( BSONObj& o );
 
@@ -271,6 +349,13 @@ namespace mongo {
              */
             void insert( const string& ns , const BSONObj& o );
 
+            /**
+             * inserts a batch of docs under a single lock acquisition,
+             * clearing 'batch'.  much cheaper than insert() per doc when
+             * results are produced faster than one lock cycle each.
+             */
+            void insertBatch( const string& ns , vector<BSONObj>& batch );
+
             // ------ simple accessors -----
 
             /** State maintains ownership, do no use past State lifetime */
@@ -292,14 +377,16 @@ namespace mongo {
 
         protected:
 
-            void _add( InMemory* im , const BSONObj& a , long& size );
+            void _add( InMemory& im , const BSONObj& a , long& size , long& dupCount );
+
+            /** spills one partition to the inc collection and empties it */
+            void _spillPartition( unsigned p );
 
             scoped_ptr<Scope> _scope;
             bool _onDisk; // if the end result of this map reduce is disk or not
 
-            scoped_ptr<InMemory> _temp;
-            long _size; // bytes in _temp
-            long _dupCount; // number of duplicate key entries
+            scoped_ptr<PartitionedInMemory> _temp;
+            long _accountedBytes; // _temp bytes last reported to memaccount::MapReduce
 
             long long _numEmits;
 
@@ -38,6 +38,7 @@ namespace mongo {
         static int n = 0;
         assert( ++n == 1 ); // below releasingWriteLock we assume MongoMutex is a singleton, and uses dbMutex ref above
         _remapPrivateViewRequested = false;
+        _holdStart = _holdWait = 0;
     }
 
     // OpTime::now() uses dbMutex, thus it is in this file not in the cpp files used by drivers and such
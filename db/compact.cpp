@@ -20,6 +20,7 @@
 
 #include "pch.h"
 #include "pdfile.h"
+#include "clientcursor.h"
 #include "concurrency.h"
 #include "commands.h"
 #include "curop-inl.h"
@@ -152,6 +153,7 @@ namespace mongo {
             newFirst.ext()->xprev.writing().Null();
             getDur().writing(e)->markEmpty();
             freeExtents(ext,ext);
+            NamespaceDetailsTransient::get( ns ).clearStorageStats();
             getDur().commitIfNeeded();
 
             { 
@@ -209,8 +211,8 @@ namespace mongo {
         }
 
         log() << "compact orphan deleted lists" << endl;
-        for( int i = 0; i < Buckets; i++ ) { 
-            d->deletedList[i].writing().Null();
+        for( int i = 0; i < AllocBuckets; i++ ) {
+            d->deletedListEntry(i).writing().Null();
         }
 
 
@@ -297,6 +299,161 @@ namespace mongo {
         return ok;
     }
 
+    /** one batch of the incremental compact: move up to maxToMove records out of the
+        collection's first extent into space later in the collection, maintaining every
+        index per record as we go, and free the extent once it is drained.  called with
+        the write lock; the driver below releases it between batches.
+        @return true once the extent has been fully drained and freed
+    */
+    static bool compactDrainStep(const char *ns, NamespaceDetails *d, const DiskLoc ext,
+                                 bool validate, double pf, int pb, int maxToMove, unsigned& skipped) {
+        Extent *e = ext.ext();
+        e->assertOk();
+        assert( e->validates() );
+
+        for( int moved = 0; moved < maxToMove; ) {
+            DiskLoc L = e->firstRecord;
+            if( L.isNull() )
+                break;
+            Record *recOld = L.rec();
+            DiskLoc Lnext = recOld->nextInExtent(L);
+            BSONObj objOld(recOld);
+
+            if( !validate || objOld.valid() ) {
+                // size the new record the same way compactExtent does
+                unsigned sz = objOld.objsize();
+                unsigned lenWHdr = sz + Record::HeaderSize;
+                unsigned lenWPadding = lenWHdr;
+                {
+                    lenWPadding = static_cast<unsigned>(pf*lenWPadding);
+                    lenWPadding += pb;
+                    lenWPadding = lenWPadding & quantizeMask(lenWPadding);
+                    if( lenWPadding < lenWHdr || lenWPadding > BSONObjMaxUserSize / 2 ) {
+                        lenWPadding = lenWHdr;
+                    }
+                }
+
+                DiskLoc loc;
+                while( 1 ) {
+                    loc = allocateSpaceForANewRecord(ns, d, lenWPadding, false);
+                    uassert(16255, "compact error out of space during compaction", !loc.isNull());
+                    if( loc.a() != ext.a() || loc.getOfs() < ext.getOfs() || loc.getOfs() >= ext.getOfs() + e->length )
+                        break;
+                    // the allocator handed back free space inside the very extent we are
+                    // draining.  abandon the chunk - the whole extent is freed once the
+                    // drain finishes - and ask again.
+                }
+
+                Record *recNew = loc.rec();
+                recNew = (Record *) getDur().writingPtr(recNew, lenWHdr);
+                addRecordToRecListInExtent(recNew, loc);
+                memcpy(recNew->data, objOld.objdata(), sz);
+
+                // move the index entries for this record, old location -> new.
+                // unlike the full compact we never drop the indexes, so readers see a
+                // consistent index at every commit point.
+                BSONObjFieldIndex docIndex( objOld ); // shared by every index's key extraction
+                for( int x = 0; x < d->nIndexes; x++ ) {
+                    IndexDetails& idx = d->idx(x);
+                    Ordering order = Ordering::make(idx.keyPattern());
+                    IndexInterface& ii = idx.idxInterface();
+                    BSONObjSet keys;
+                    idx.getKeysFromObject(objOld, keys, d->nIndexes > 1 ? &docIndex : 0);
+                    for( BSONObjSet::iterator k = keys.begin(); k != keys.end(); k++ ) {
+                        ii.unindex(idx.head, idx, *k, L);
+                        // dups allowed - the same keys existed a moment ago, just at the old location
+                        ii.bt_insert(idx.head, loc, *k, order, true, idx);
+                    }
+                }
+                moved++;
+            }
+            else {
+                if( ++skipped <= 10 )
+                    log() << "compact skipping invalid object" << endl;
+            }
+
+            /* check if any cursors point to the old record.  if so, advance them. */
+            ClientCursor::aboutToDelete(L);
+
+            // orphan the old record rather than freelisting it; its space comes back
+            // all at once when the drained extent is freed
+            e->firstRecord.writing() = Lnext;
+            if( !Lnext.isNull() )
+                getDur().writingInt(Lnext.rec()->prevOfs) = DiskLoc::NullOfs;
+        }
+
+        if( !e->firstRecord.isNull() )
+            return false;
+
+        // extent drained - unlink and free it
+        assert( d->firstExtent == ext );
+        assert( d->lastExtent != ext );
+        DiskLoc newFirst = e->xnext;
+        d->firstExtent.writing() = newFirst;
+        newFirst.ext()->xprev.writing().Null();
+        getDur().writing(e)->markEmpty();
+        freeExtents(ext,ext);
+        NamespaceDetailsTransient::get( ns ).clearStorageStats();
+        return true;
+    }
+
+    /** online, resumable compact.  drains extents from the front of the collection one
+        small batch of records per write lock window, so normal reads and writes
+        interleave and a replica set primary stays responsive.  killOp pauses it;
+        rerunning the command resumes, as the remaining extent chain is itself the
+        resume state.  we drain only the extents present at the start - space freed up
+        front is reused for the records migrating toward the back.
+    */
+    bool compactIncremental(const string& ns, string &errmsg, bool validate, BSONObjBuilder& result, double pf, int pb) {
+        massert( 16256, "bad ns", NamespaceString::normal(ns.c_str()) );
+        massert( 16257, "can't compact a system namespace", !str::contains(ns, ".system.") );
+
+        int nExtentsToDo;
+        {
+            writelock lk;
+            BackgroundOperation::assertNoBgOpInProgForNs(ns.c_str());
+            Client::Context ctx(ns);
+            NamespaceDetails *d = nsdetails(ns.c_str());
+            massert( 16258, str::stream() << "namespace " << ns << " does not exist", d );
+            massert( 16259, "cannot compact capped collection", !d->capped );
+            nExtentsToDo = 0;
+            for( DiskLoc L = d->firstExtent; !L.isNull(); L = L.ext()->xnext )
+                nExtentsToDo++;
+            nExtentsToDo--; // never drain the last extent - records must have somewhere to go
+            getDur().commitNow();
+        }
+        log() << "compact (incremental) " << ns << " begin, " << nExtentsToDo << " extents" << endl;
+
+        enum { BatchRecords = 100 };
+        int extentsDone = 0;
+        unsigned skipped = 0;
+        while( extentsDone < nExtentsToDo ) {
+            killCurrentOp.checkForInterrupt();
+
+            writelock lk;
+            BackgroundOperation::assertNoBgOpInProgForNs(ns.c_str());
+            Client::Context ctx(ns);
+            NamespaceDetails *d = nsdetails(ns.c_str());
+            if( ! d ) {
+                errmsg = "ns deleted during compact";
+                return false;
+            }
+            if( d->firstExtent == d->lastExtent )
+                break; // down to a single extent - nothing left to drain
+            if( compactDrainStep(ns.c_str(), d, d->firstExtent, validate, pf, pb, BatchRecords, skipped) ) {
+                extentsDone++;
+                log() << "compact extent freed, " << (nExtentsToDo - extentsDone) << " to go" << endl;
+            }
+            getDur().commitIfNeeded();
+        }
+
+        if( skipped )
+            result.append("invalidObjects", (long long) skipped);
+        result.append("extentsCompacted", extentsDone);
+        log() << "compact (incremental) " << ns << " end" << endl;
+        return true;
+    }
+
     bool isCurrentlyAReplSetPrimary();
 
     class CompactCmd : public Command {
@@ -309,8 +466,10 @@ namespace mongo {
         virtual void help( stringstream& help ) const {
             help << "compact collection\n"
                 "warning: this operation blocks the server and is slow. you can cancel with cancelOp()\n"
-                "{ compact : <collection_name>, [force:true], [validate:true] }\n"
+                "{ compact : <collection_name>, [force:true], [incremental:true], [validate:true] }\n"
                 "  force - allows to run on a replica set primary\n"
+                "  incremental - migrate one small batch of records per lock window instead of blocking;\n"
+                "                indexes are maintained throughout.  killOp pauses, rerunning resumes\n"
                 "  validate - check records are noncorrupt before adding to newly compacting extents. slower but safer (default is true in this version)\n";
         }
         virtual bool requiresAuth() { return true; }
@@ -323,11 +482,13 @@ namespace mongo {
                 return false;
             }
 
-            if( isCurrentlyAReplSetPrimary() && !cmdObj["force"].trueValue() ) { 
-                errmsg = "will not run compact on an active replica set primary as this is a slow blocking operation. use force:true to force";
+            bool incremental = cmdObj["incremental"].trueValue();
+
+            if( !incremental && isCurrentlyAReplSetPrimary() && !cmdObj["force"].trueValue() ) {
+                errmsg = "will not run compact on an active replica set primary as this is a slow blocking operation. use force:true to force (or use incremental:true)";
                 return false;
             }
-            
+
             string ns = db + '.' + coll;
             if ( ! NamespaceString::normal(ns.c_str()) ) {
                 errmsg = "bad namespace name";
@@ -367,7 +528,11 @@ namespace mongo {
             }
 
             bool validate = !cmdObj.hasElement("validate") || cmdObj["validate"].trueValue(); // default is true at the moment
-            bool ok = compact(ns, errmsg, validate, result, pf, pb);
+            bool ok;
+            if( incremental )
+                ok = compactIncremental(ns, errmsg, validate, result, pf, pb);
+            else
+                ok = compact(ns, errmsg, validate, result, pf, pb);
             return ok;
         }
     };
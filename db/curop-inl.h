@@ -24,7 +24,7 @@ namespace mongo {
 
     // todo : move more here
 
-    inline CurOp::CurOp( Client * client , CurOp * wrapped ) {
+    inline CurOp::CurOp( Client * client , CurOp * wrapped ) : _budgetTracker( 128 , 10 ) {
         _client = client;
         _wrapped = wrapped;
         if ( _wrapped )
@@ -25,6 +25,7 @@
 #include "../util/concurrency/spin_lock.h"
 #include "../util/time_support.h"
 #include "../util/net/hostandport.h"
+#include "../util/net/listen.h" // ElapsedTracker
 
 namespace mongo {
 
@@ -67,6 +68,12 @@ namespace mongo {
         bool upsert;         // true if the update actually did an insert
         int keyUpdates;
 
+        // resource usage, filled in by CurOp::recordResourceUsage()
+        // (linux only; zero on other platforms)
+        long long cpuMicros; // thread cpu time consumed by this op
+        int minorFaults;     // page faults satisfied without io
+        int majorFaults;     // page faults that had to go to disk
+
         // error handling
         ExceptionInfo exceptionInfo;
         
@@ -189,6 +196,7 @@ namespace mongo {
             _ns[0] = 0;
             _debug.reset();
             _query.reset();
+            markResourceStart();
             _active = true; // this should be last for ui clarity
         }
 
@@ -199,6 +207,7 @@ namespace mongo {
         }
 
         void markCommand() { _command = true; }
+        bool isCommand() const { return _command; }
 
         void waitingForLock( int type ) {
             _waitingForLock = true;
@@ -253,6 +262,40 @@ namespace mongo {
 
         int elapsedSeconds() { return elapsedMillis() / 1000; }
 
+        /* ---- per op resource accounting ----------------------------------
+           reset() snapshots the thread cpu clock and the thread's page fault
+           counters; recordResourceUsage() stores the deltas in debug().  two
+           cheap syscalls at each end of an op.  linux only - elsewhere the
+           debug() fields stay zero.
+        */
+        /** snapshot the thread's cpu clock and fault counters; called from reset() */
+        void markResourceStart();
+        /** store cpu time and page faults consumed since reset() in debug().
+            must run on the thread that executed the op. */
+        void recordResourceUsage();
+
+        /* ---- execution budgets -------------------------------------------
+           bounds on actively executing work - the cursor idle timeout does
+           nothing while an op is busy scanning.  0 = unlimited.  set per op
+           from $maxTimeMS / the server wide defaults (--opTimeBudgetMS,
+           --opScanBudget) and enforced from the scan loops via checkBudgets().
+        */
+        void setBudgets( int maxTimeMS , long long maxScanned ) {
+            _budgetEndMicros = maxTimeMS > 0 ? startTime() + 1000ULL * maxTimeMS : 0;
+            _budgetScan = maxScanned > 0 ? maxScanned : 0;
+        }
+        bool haveBudgets() const { return _budgetEndMicros != 0 || _budgetScan != 0; }
+        /** uasserts when this op has scanned past its ceiling or run past its
+            deadline.  cheap per call: the clock is only consulted at
+            ElapsedTracker intervals. */
+        void checkBudgets( long long nscanned ) {
+            if ( _budgetScan && nscanned > _budgetScan )
+                uasserted( 16311 , "operation exceeded nscanned budget" );
+            if ( _budgetEndMicros && _budgetTracker.intervalHasElapsed() &&
+                 curTimeMicros64() > _budgetEndMicros )
+                uasserted( 16312 , "operation exceeded time budget" );
+        }
+
         void setQuery(const BSONObj& query) { _query.set( query ); }
 
         Client * getClient() const { return _client; }
@@ -321,8 +364,18 @@ namespace mongo {
         ProgressMeter _progressMeter;
         volatile bool _killed;
         int _numYields;
+        unsigned long long _budgetEndMicros; // deadline, 0 = none
+        long long _budgetScan;               // nscanned ceiling, 0 = none
+        ElapsedTracker _budgetTracker;       // rate limits the deadline clock reads
+        unsigned long long _cpuStartNanos;   // thread cpu clock at reset(); 0 if unavailable
+        long _minfltStart;                   // fault counters at reset(); -1 if unavailable
+        long _majfltStart;
 
         void _reset() {
+            _cpuStartNanos = 0;
+            _minfltStart = _majfltStart = -1;
+            _budgetEndMicros = 0;
+            _budgetScan = 0;
             _command = false;
             _lockType = 0;
             _dbprofile = 0;
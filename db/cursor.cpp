@@ -17,9 +17,215 @@
 #include "pch.h"
 #include "pdfile.h"
 #include "curop-inl.h"
+#include "client.h"
+#include "mongommf.h"
+#include "../util/queue.h"
+#include "../util/mmap.h"
 
 namespace mongo {
 
+    namespace {
+
+        /** background prefetch pipeline for table scans.  upcoming extents are handed to a
+            worker thread which issues MADV_WILLNEED on their mapped ranges, so page-ins
+            overlap with the scan instead of stalling it one fault at a time.  addresses are
+            captured while we hold the lock; by the time they are advised the mapping could
+            in theory be gone, but the advice is only a hint so that is harmless.
+        */
+        class ExtentPrefetcher : boost::noncopyable {
+        public:
+            enum { NAhead = 2, MaxQueued = 64 };
+
+            ExtentPrefetcher() : _m("extentPrefetcher"), _started(false) { }
+
+            /** queue WILLNEED hints for the next NAhead extents after e.  caller must hold the lock. */
+            void queueNextExtents(Extent *e) {
+                start();
+                for( int n = 0; e && n < NAhead; n++ ) {
+                    if( e->xnext.isNull() )
+                        break;
+                    e = e->xnext.ext();
+                    if( _queue.size() >= MaxQueued )
+                        break;
+                    Range r;
+                    r.p = e;
+                    r.len = e->length;
+                    _queue.push(r);
+                }
+            }
+
+        private:
+            struct Range {
+                void *p;
+                unsigned len;
+            };
+
+            void start() {
+                if( _started )
+                    return;
+                scoped_lock lk(_m);
+                if( _started )
+                    return;
+                boost::thread t(boost::bind(&ExtentPrefetcher::run, this));
+                _started = true;
+            }
+
+            void run() {
+                Client::initThread("prefetch");
+                while( !inShutdown() ) {
+                    Range r;
+                    if( _queue.blockingPop(r, 2) )
+                        adviseWillNeed(r.p, r.len);
+                }
+                cc().shutdown();
+            }
+
+            BlockingQueue<Range> _queue;
+            mongo::mutex _m;
+            volatile bool _started;
+        } extentPrefetcher;
+
+        /** advisory paging layer enabled by --evictBehindScans, for datasets well
+            over RAM where the kernel's LRU evicts index pages under scan pressure.
+            two inputs:
+              - table scans queue each extent they move past; a worker thread
+                advises MADV_DONTNEED on its shared file-backed view, making
+                scanned-once data the cheapest thing for the kernel to evict.
+              - btree access paths note the buckets they touch; the worker
+                periodically re-advises those pages MADV_WILLNEED.  there is no
+                madvise "keep", so index protection mostly comes from making scan
+                garbage cheaper to evict - the WILLNEED pass just pulls any
+                casualty back promptly.
+            everything here is a hint; a stale address at worst advises a range
+            that has been remapped, which is harmless.
+        */
+        class PageAdvisor : boost::noncopyable {
+        public:
+            enum { MaxQueued = 128, IndexRing = 4096 };
+
+            PageAdvisor() : _m("pageAdvisor"), _started(false), _ringSeen(0) {
+                memset( (void*)_ring, 0, sizeof(_ring) );
+            }
+
+            /** queue the extent a scan just finished with.  caller must hold the lock. */
+            void queueEvictExtent(Extent *e) {
+                start();
+                if( _queue.size() >= MaxQueued )
+                    return;
+
+                void *p = e;
+                unsigned len = e->length;
+                size_t ofs;
+
+                // never advise away a view with no file behind it
+                if( ephemeralViews.find((void*)p, ofs) )
+                    return;
+
+                // with journalling we read through the private view; DONTNEED
+                // there would discard uncommitted writes.  advise the shared
+                // view instead - the kernel repopulates it from the file.
+                MongoMMF *mmf = privateViews.find(p, ofs);
+                if( mmf )
+                    p = (char*)mmf->view_write() + ofs;
+
+                Range r;
+                r.p = p;
+                r.len = len;
+                _queue.push(r);
+            }
+
+            /** lock-free: a single racy store.  losing a race just loses a hint. */
+            void noteIndexPage(const void *p) {
+                start();
+                _ring[_ringPos++ % IndexRing] = p;
+            }
+
+        private:
+            struct Range {
+                void *p;
+                unsigned len;
+            };
+
+            void start() {
+                if( _started )
+                    return;
+                scoped_lock lk(_m);
+                if( _started )
+                    return;
+                boost::thread t(boost::bind(&PageAdvisor::run, this));
+                _started = true;
+            }
+
+            void run() {
+                Client::initThread("pageadvisor");
+                while( !inShutdown() ) {
+                    Range r;
+                    if( _queue.blockingPop(r, 2) )
+                        adviseDontNeed(r.p, r.len);
+                    drainIndexRing();
+                }
+                cc().shutdown();
+            }
+
+            /** WILLNEED the distinct pages under buckets noted since the last pass */
+            void drainIndexRing() {
+                const size_t pageSize = 4096;
+                const size_t bucketSize = 8192; // BtreeBucket, both index versions
+
+                unsigned pos = _ringPos;
+                if( pos == _ringSeen )
+                    return;
+                unsigned n = pos - _ringSeen;
+                if( n > (unsigned)IndexRing )
+                    n = IndexRing;
+                _ringSeen = pos;
+
+                set<void*> pages;
+                for( unsigned i = 0; i < n; i++ ) {
+                    const void *p = _ring[(pos - 1 - i) % IndexRing];
+                    if( p )
+                        pages.insert( (void*)((size_t)p & ~(pageSize - 1)) );
+                }
+                for( set<void*>::const_iterator i = pages.begin(); i != pages.end(); ++i ) {
+                    // aligned down, so cover the whole (possibly straddling) bucket
+                    adviseWillNeed( *i, bucketSize + pageSize );
+                }
+            }
+
+            BlockingQueue<Range> _queue;
+            mongo::mutex _m;
+            volatile bool _started;
+            const void * volatile _ring[IndexRing]; // recently touched btree buckets
+            AtomicUInt _ringPos;
+            unsigned _ringSeen; // worker-only: _ringPos as of the last drain
+        } pageAdvisor;
+
+    }
+
+    void noteIndexPageAccess( const void * p ) {
+        if( !evictBehindScans )
+            return;
+        pageAdvisor.noteIndexPage(p);
+    }
+
+    /* queue prefetch of the extents after the one containing curr.  called as the cursor
+       enters each extent so a cold scan stays a couple extents ahead of the page cache.
+    */
+    void BasicCursor::prefetchUpcoming() {
+        if( s != forward() || curr.isNull() )
+            return;
+        DiskLoc eloc = curr.rec()->myExtentLoc(curr);
+        if( eloc == _curExtent )
+            return;
+        if( evictBehindScans && !_curExtent.isNull() ) {
+            // we just moved past _curExtent: its pages are the best candidates
+            // to give back under memory pressure
+            pageAdvisor.queueEvictExtent( _curExtent.ext() );
+        }
+        _curExtent = eloc;
+        extentPrefetcher.queueNextExtents(eloc.ext());
+    }
+
     bool BasicCursor::advance() {
         killCurrentOp.checkForInterrupt();
         if ( eof() ) {
@@ -35,6 +241,8 @@ namespace mongo {
             curr = s->next( curr );
         }
         incNscanned();
+        if ( ok() )
+            prefetchUpcoming();
         return ok();
     }
 
@@ -148,6 +148,11 @@ namespace mongo {
     const AdvanceStrategy *forward();
     const AdvanceStrategy *reverse();
 
+    /** note that a btree bucket at p was just accessed, so the background page
+        advisor can hint the kernel to keep it resident.  a single store when
+        --evictBehindScans is on, a single test when off.  see cursor.cpp. */
+    void noteIndexPageAccess( const void * p );
+
     /* table-scan style cursor */
     class BasicCursor : public Cursor {
     public:
@@ -195,7 +200,13 @@ namespace mongo {
         bool tailable_;
         shared_ptr< CoveredIndexMatcher > _matcher;
         long long _nscanned;
-        void init() { tailable_ = false; }
+        DiskLoc _curExtent; // last extent we queued prefetch hints from
+        void prefetchUpcoming(); // see cursor.cpp
+        void init() {
+            tailable_ = false;
+            if ( !curr.isNull() )
+                prefetchUpcoming();
+        }
     };
 
     /* used for order { $natural: -1 } */
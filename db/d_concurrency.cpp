@@ -1,180 +1,83 @@
-// @file d_concurrency.cpp 
+// @file d_concurrency.cpp
+
+/*
+ *    Copyright (C) 2011 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
 
 #include "pch.h"
-#include "database.h"
 #include "d_concurrency.h"
-#include "../util/concurrency/threadlocal.h"
-#include "../util/concurrency/rwlock.h"
-#include "../util/assert_util.h"
+#include "namespace_common.h"
 #include "client.h"
 
-#if defined(CLC)
-   
 namespace mongo {
 
-    SimpleRWLock writeExcluder;
+    DBLockManager dbLockManager;
 
-    HLock::readlock::readlock(HLock& _h) : h(_h) { 
-
-        already = cc().readLocked || cc().writeLocked;
-        if( !already ) { 
-            h.hlockShared();
-        }
-    }
-    HLock::readlock::~readlock() { 
-        if( !already ) {
-            cc().readLocked=false;
-            h.hunlockShared();
+    RWLockRecursive& DBLockManager::get( const string& ns ) {
+        string db = nsToDatabase( ns );
+        scoped_lock lk(_m);
+        RWLockRecursive*& l = _map[db];
+        if( l == 0 ) {
+            // freed at shutdown only; RWLockRecursive wants its name to outlive it,
+            // so hand it the map key's storage.
+            Map::iterator i = _map.find(db);
+            l = new RWLockRecursive( i->first.c_str() );
         }
+        return *l;
     }
 
-    HLock::readlocktry::readlocktry(int ms) {
-        already = cc().readLocked || cc().writeLocked;
-        if( !already ) { 
-            ok = h.hlockSharedTry();
-        }
-    }
+    // global lock is acquired first; the db lock is always ordered after it so we
+    // cannot deadlock against code still using writelock/readlock alone.
 
-    HLock::writelock::writelock(HLock& _h) : h(_h) { 
-        assert( !cc().readLocked );
-        already = cc().writeLocked;
-        if( !already ) {
-            h.lock();
-            cc().writeLocked=true;
-        }
-    }
-    HLock::writelock::~writelock() { 
-        if( !already ) {
-            cc().writeLocked=false;
-            h.hunlock();
-        }
+    LockDBExclusively::LockDBExclusively( const string& ns ) :
+        _globalLock( ns ),
+        _dbLock( dbLockManager.get( ns ) ) {
     }
 
-    void HLock::hlockShared() {
-        if( parent ) 
-            parent->hlockShared();
-        r.lock_shared();
-    }
-    void HLock::hunlockShared() {
-        r.unlock_shared();
-        if( parent )
-            parent->hunlockShared();
+    LockDBSharable::LockDBSharable( const string& ns ) :
+        _globalLock( ns ),
+        _dbLock( dbLockManager.get( ns ) ) {
     }
 
-    /*
-    bool HLock::hlockSharedTry(int ms) {
-        if( parent && !parent->hlockSharedTry(ms) ) {
-            return false;
-        }
-        bool ok = r.lock_shared_try(ms);
-        if( !ok ) {
-            parent->hunlockShared();
-        }
-        return ok;
-    }
-    */
+    DatabaseFreezer databaseFreezer;
 
-    void HLock::hlock() {
-        writeExcluder.lock_shared();
-        if( parent )
-            parent->hlockShared();
-        r.lock();
-    }
-    void HLock::hunlock() { 
-        r.unlock();
-        if( parent ) 
-            parent->hunlockShared();
-        writeExcluder.unlock_shared();
+    bool DatabaseFreezer::freeze( const string& db ) {
+        scoped_lock lk(_m);
+        return _frozen.insert( db ).second;
     }
 
-#if 0
-    LockDatabaseSharable::LockDatabaseSharable() {
-        Client& c = cc();
-        Client::LockStatus& s = c.lockStatus;
-        already = false;
-        if( dbMutex.isWriteLocked() ) {
-            already = true;
-            assert( s.dbLockCount == 0 );
-            return;
-        }
-        Database *db = c.database();
-        assert( db );
-        if( s.dbLockCount == 0 ) {
-            s.whichDB = db;
-            db->dbLock.lock_shared();
-        }
-        else {
-            // recursed
-            massert( 15919, "wrong database while locking", db == s.whichDB);
-        }
-        s.dbLockCount--; // < 0 means sharable
+    bool DatabaseFreezer::unfreeze( const string& db ) {
+        scoped_lock lk(_m);
+        if( _frozen.erase( db ) == 0 )
+            return false;
+        _cond.notify_all();
+        return true;
     }
 
-    LockDatabaseSharable::~LockDatabaseSharable() { 
-        if( already ) 
-            return;
-        Client& c = cc();
-        Client::LockStatus& s = c.lockStatus;
-        if( c.database() == 0 ) { 
-            wassert(false);
-            return;
-        }
-        if( c.database() != s.whichDB ) { 
-            DEV error() << "~LockDatabaseSharable wrong db context " << c.database() << ' ' << s.whichDB << endl;
-            wassert(false);
-        }
-        wassert( s.dbLockCount < 0 );
-        if( ++s.dbLockCount == 0 ) { 
-            c.database()->dbLock.unlock_shared();
-        }
+    void DatabaseFreezer::waitUntilWritable( const string& ns ) {
+        if( dbMutex.isWriteLocked() )
+            return; // internal write - see header
+        string db = nsToDatabase( ns );
+        scoped_lock lk(_m);
+        while( _frozen.count( db ) )
+            _cond.wait( lk.boost() );
     }
 
-    bool subcollectionOf(const string& parent, const char *child);
-
-    /** notes
-        note if we r and w lock arbitarily with nested rwlocks we can deadlock. so we avoid this.
-        also have to be careful about any throws in things like this
-    */
-    LockCollectionForReading::LockCollectionForReading(const char *ns)
-    {
-        Client& c = cc();
-        Client::LockStatus& s = c.lockStatus;
-        assert( c.ns() && ns && str::equals(c.ns(),ns) );
-        already = false;
-        if( dbMutex.isWriteLocked() || s.dbLockCount > 0 ) { 
-            // already locked exclusively at a higher level in the hierarchy
-            already = true;
-            assert( s.collLockCount == 0 );
-            return;
-        }
-
-        if( s.collLockCount == 0 ) {
-            s.whichCollection = ns;
-            s.collLock.lock_shared();
-        }
-        else {
-            // must be the same ns or a child ns
-            assert( subcollectionOf(s.whichCollection, ns) );
-            if( s.whichCollection != ns ) {
-                DEV log() << "info lock on nested ns: " << ns << endl;
-            }
-        }
-        s.collLockCount--; // < 0 means sharable state
+    void DatabaseFreezer::listFrozen( vector<string>& out ) {
+        scoped_lock lk(_m);
+        out.insert( out.end(), _frozen.begin(), _frozen.end() );
     }
 
-    LockCollectionForReading::~LockCollectionForReading() { 
-        if( already ) 
-            return;
-        Client& c = cc();
-        Client::LockStatus& s = c.lockStatus;
-        wassert( c.ns() && s.whichCollection == c.ns() );
-        wassert( s.collLockCount < 0 );
-        if( ++s.collLockCount == 0 ) { 
-            s.collLock.unlock_shared();
-        }
-    }
-#endif
 }
-
-#endif
-
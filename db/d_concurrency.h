@@ -1,40 +1,102 @@
 // @file d_concurrency.h
+// per-database locking.  see also mongomutex.h for the global lock.
+
+/*
+ *    Copyright (C) 2011 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
 
 #pragma once
 
+#include "concurrency.h"
 #include "../util/concurrency/rwlock.h"
+#include "../util/concurrency/mutex.h"
 
-#if defined(CLC)
+namespace mongo {
 
-#error asdf
+    /** Registry of one lock per database.  Locks are created lazily on first use and
+        are never deleted - like Database objects they live until shutdown, so callers
+        may cache the returned pointer.
 
-namespace mongo {
+        The plan is to stop write operations serializing on the global dbMutex.  We
+        get there in stages:
+          (1) every write path additionally takes its database's lock (this file);
+          (2) call sites that only touch one database then relax their use of the
+              global lock to a shared/"intent" acquisition;
+          (3) dbMutex write acquisition remains only for operations that really are
+              global (listDatabases, shutdown, repairDatabase, ...).
+        Stage (1) is cheap - the db lock is uncontended while the global lock is still
+        exclusive - and lets callers in query.cpp/update.cpp etc. migrate one by one.
+    */
+    class DBLockManager : boost::noncopyable {
+    public:
+        /** @param ns a database name, or a full collection namespace ("test.foo"). */
+        RWLockRecursive& get( const string& ns );
+    private:
+        typedef map<string,RWLockRecursive*> Map;
+        Map _map;
+        mongo::mutex _m;
+    public:
+        DBLockManager() : _m("dblockmgr") { }
+    };
+
+    extern DBLockManager dbLockManager;
 
-    class HLock { 
+    /** exclusive lock on one database's data, plus (for now - see above) the global
+        write lock.  recursion-safe.  usage:
+            LockDBExclusively lk(ns);
+    */
+    struct LockDBExclusively : boost::noncopyable {
+        LockDBExclusively( const string& ns );
+    private:
+        writelock _globalLock;
+        RWLockRecursive::Exclusive _dbLock;
+    };
+
+    /** shared lock on one database's data, plus the global read lock. */
+    struct LockDBSharable : boost::noncopyable {
+        LockDBSharable( const string& ns );
+    private:
+        readlock _globalLock;
+        RWLockRecursive::Shared _dbLock;
+    };
+
+    /** Per-database write freeze - the freezeDb/unfreezeDb commands use this to
+        quiesce one database for a filesystem snapshot while writes to the other
+        databases on the node proceed (contrast with fsync+lock, which stops
+        everything).  Write entry points consult waitUntilWritable() BEFORE taking
+        any lock: a writer parked here holds nothing, whereas blocking after the
+        global write lock is acquired would stall every database.
+    */
+    class DatabaseFreezer : boost::noncopyable {
     public:
-        HLock(HLock *parent, RWLock& r);
-        struct writelock { 
-            writelock(HLock&);
-            ~writelock();
-        private: 
-            HLock& h;
-            bool already;
-        };
-        struct readlock { 
-            readlock(HLock&);
-        private:
-            HLock& h;
-            bool already;
-        };
+        DatabaseFreezer() : _m("dbfreezer") { }
+        /** @return false if the database was already frozen */
+        bool freeze( const string& db );
+        /** @return false if the database was not frozen */
+        bool unfreeze( const string& db );
+        /** block until ns's database is not frozen.  no-op when this thread already
+            holds the write lock - an internal write (DBDirectClient et al.) must
+            finish, not stall the whole server behind a freeze. */
+        void waitUntilWritable( const string& ns );
+        void listFrozen( vector<string>& out );
     private:
-        void hlock();
-        void hunlock();
-        void hlockShared();
-        void hunlockShared();
-        HLock *parent;
-        RWLock& r;
+        set<string> _frozen;
+        mongo::mutex _m;
+        boost::condition _cond;
     };
 
-}
+    extern DatabaseFreezer databaseFreezer;
 
-#endif
+}
@@ -22,6 +22,8 @@
 #include "instance.h"
 #include "clientcursor.h"
 #include "databaseholder.h"
+#include "../util/file_allocator.h"
+#include "../util/timer.h"
 
 namespace mongo {
 
@@ -64,6 +66,8 @@ namespace mongo {
             }
             newDb = namespaceIndex.exists();
             profile = cmdLine.defaultProfile;
+            lastUse = time(0);
+            ccByLocCount = 0;
             checkDuplicateUncasedNames(true);
             // If already exists, open.  Otherwise behave as if empty until
             // there's a write, then open.
@@ -245,7 +249,7 @@ namespace mongo {
             string fullNameString = fullName.string();
             p = new MongoDataFile(n);
             int minSize = 0;
-            if ( n != 0 && _files[ n - 1 ] )
+            if ( n != 0 && n - 1 < (int) _files.size() && _files[ n - 1 ] )
                 minSize = _files[ n - 1 ]->getHeader()->fileLength;
             if ( sizeNeeded + DataFileHeader::HeaderSize > minSize )
                 minSize = sizeNeeded + DataFileHeader::HeaderSize;
@@ -268,8 +272,14 @@ namespace mongo {
         assertDbWriteLocked(this);
         int n = (int) _files.size();
         MongoDataFile *ret = getFile( n, sizeNeeded );
-        if ( preallocateNextFile )
+        if ( preallocateNextFile ) {
             preallocateAFile();
+            // if a writer recently had to block on an allocation, one file of
+            // headroom is not keeping up with the fill rate - stay two ahead
+            // until ingest calms down
+            if ( cmdLine.prealloc && FileAllocator::get()->recentlyOutpaced() )
+                getFile( n + 2 , 0 , true );
+        }
         return ret;
     }
 
@@ -329,9 +339,23 @@ namespace mongo {
         Extent *e = DataFileMgr::allocFromFreeList( ns, size, capped );
         if( e == 0 ) {
             fromFreeList = false;
-            e = suitableFile( ns, size, !capped, enforceQuota )->createExtent( ns, size, capped );
+            // prefer the file already holding the chain's tail: file space is
+            // handed out as a bump pointer, so follow-on extents placed there
+            // tend to be physically adjacent and sequential scans in xnext
+            // order avoid cross-file seeks.  suitableFile() alone would pick
+            // the newest file with room, scattering the chain.
+            NamespaceDetails *d = nsdetails( ns );
+            if ( !capped && d && !d->lastExtent.isNull() ) {
+                int fileNo = d->lastExtent.a();
+                MongoDataFile *f = getFile( fileNo );
+                if ( f->getHeader()->unusedLength >= size &&
+                     ! fileIndexExceedsQuota( ns, fileNo - 1, enforceQuota ) ) // NOTE i-1 as in suitableFile()
+                    e = f->createExtent( ns, size, capped );
+            }
+            if ( e == 0 )
+                e = suitableFile( ns, size, !capped, enforceQuota )->createExtent( ns, size, capped );
         }
-        LOG(1) << "allocExtent " << ns << " size " << size << ' ' << fromFreeList << endl; 
+        LOG(1) << "allocExtent " << ns << " size " << size << ' ' << fromFreeList << endl;
         return e;
     }
 
@@ -421,4 +445,98 @@ namespace mongo {
         return db;
     }
 
+    namespace {
+        boost::filesystem::path preopenListPath() {
+            boost::filesystem::path p( dbpath );
+            p /= "preopen.txt";
+            return p;
+        }
+
+        void notePreopen( Database *db , vector< pair<time_t,string> > *v ) {
+            v->push_back( make_pair( db->lastUse , db->name ) );
+        }
+    }
+
+    void Database::recordRecentlyUsed() {
+        try {
+            vector< pair<time_t,string> > dbs;
+            {
+                // we may already hold a read lock this deep into shutdown, so
+                // take a (recursion friendly) read lock rather than upgrading
+                readlocktry lk( "" , 10000 );
+                if ( !lk.got() ) {
+                    log() << "warning: timed out locking to record databases for preopen" << endl;
+                    return;
+                }
+                dbHolder().forEachReadLocked( boost::bind( notePreopen , _1 , &dbs ) );
+            }
+
+            boost::filesystem::path p = preopenListPath();
+            if ( dbs.empty() ) {
+                if ( boost::filesystem::exists( p ) )
+                    boost::filesystem::remove( p );
+                return;
+            }
+
+            // most recently used first - if the preopen walker is cut short by
+            // early client load, it warmed the most useful databases first
+            sort( dbs.rbegin() , dbs.rend() );
+
+            ofstream f( p.string().c_str() , ios_base::out | ios_base::trunc );
+            for ( vector< pair<time_t,string> >::const_iterator i = dbs.begin(); i != dbs.end(); ++i )
+                f << i->second << '\n';
+            if ( !f ) {
+                log() << "warning: couldn't write " << p.string() << endl;
+                return;
+            }
+            log() << "shutdown: recorded " << dbs.size() << " databases for preopen" << endl;
+        }
+        catch ( const std::exception &e ) {
+            log() << "warning: failed recording databases for preopen: " << e.what() << endl;
+        }
+    }
+
+    void Database::preopenRecentlyUsed() {
+        Client::initThread( "preopen" );
+        try {
+            boost::filesystem::path p = preopenListPath();
+            if ( boost::filesystem::exists( p ) ) {
+                vector<string> names;
+                {
+                    ifstream f( p.string().c_str() );
+                    string line;
+                    while ( getline( f , line ) ) {
+                        if ( line.size() )
+                            names.push_back( line );
+                    }
+                }
+
+                // only warm databases that still exist - Context would happily
+                // create one that was dropped since the list was written
+                vector<string> onDisk;
+                getDatabaseNames( onDisk );
+                set<string> existing( onDisk.begin() , onDisk.end() );
+
+                int n = 0;
+                Timer t;
+                for ( vector<string>::const_iterator i = names.begin(); i != names.end(); ++i ) {
+                    if ( inShutdown() )
+                        break;
+                    if ( !existing.count( *i ) )
+                        continue;
+                    // one lock acquisition per database: clients that arrive
+                    // mid-walk only wait for a single mapping, not the whole list
+                    dblock lk;
+                    Client::Context ctx( *i );
+                    n++;
+                }
+                log() << "preopened " << n << " database(s) in " << t.millis() / 1000.0 << " secs" << endl;
+            }
+        }
+        catch ( const std::exception &e ) {
+            log() << "warning: database preopen failed: " << e.what() << endl;
+        }
+        cc().shutdown();
+    }
+
 } // namespace mongo
@@ -48,6 +48,16 @@ namespace mongo {
         */
         static void closeDatabase( const char *db, const string& path );
 
+        /** write the names of the open databases, most recently used first, to a
+            file next to the datafiles so the next startup can warm them.  called
+            at shutdown. */
+        static void recordRecentlyUsed();
+
+        /** open the databases recorded by recordRecentlyUsed() before clients ask
+            for them.  thread body - run as its own thread ("preopen") so startup
+            isn't delayed; each open holds the write lock only for its own database. */
+        static void preopenRecentlyUsed();
+
         void openAllFiles();
 
         /**
@@ -138,7 +148,10 @@ namespace mongo {
         NamespaceIndex namespaceIndex;
         int profile; // 0=off.
         const string profileName; // "alleyinsider.system.profile"
+        time_t lastUse; // set per Client::Context; drives the preopen list written at shutdown
         CCByLoc ccByLoc;
+        int ccByLocCount; // copy of ccByLoc.size(); written under ClientCursor::ccmutex,
+                          // read without it by aboutToDelete for a fast empty check
         int magic; // used for making sure the object is still loaded in memory
         SimpleRWLock dbLock; // see d_concurrency.h.  using "Base" version as there are a few nuance hassles to RWLock use here albeit it would work
     };
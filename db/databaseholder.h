@@ -81,6 +81,19 @@ namespace mongo {
             }
         }
 
+        /** like forEach but only requires a read lock; f must not open or close
+            databases (i.e. reading fields off them is fine, mutating the holder
+            is not) */
+        void forEachReadLocked(boost::function<void(Database *)> f) const {
+            dbMutex.assertAtLeastReadLocked();
+            for ( Paths::const_iterator i=_paths.begin(); i!=_paths.end(); i++ ) {
+                const DBs& m = i->second;
+                for( DBs::const_iterator j=m.begin(); j!=m.end(); j++ ) {
+                    f(j->second);
+                }
+            }
+        }
+
         /**
          * gets all unique db names, ignoring paths
          */
@@ -23,6 +23,7 @@
 #include "../util/unittest.h"
 #include "../util/file_allocator.h"
 #include "../util/background.h"
+#include "../util/file.h"
 #include "../util/text.h"
 #include "dbmessage.h"
 #include "instance.h"
@@ -37,13 +38,16 @@
 #include "../util/concurrency/task.h"
 #include "../util/version.h"
 #include "../util/ramlog.h"
+#include "../util/memaccount.h"
 #include "../util/net/message_server.h"
 #include "client.h"
 #include "restapi.h"
 #include "dbwebserver.h"
 #include "dur.h"
+#include "dur_journal.h"
+#include "mongommf.h"
+#include "ttl.h"
 #include "concurrency.h"
-#include "../s/d_writeback.h"
 
 #if defined(_WIN32)
 # include "../util/ntservice.h"
@@ -51,6 +55,10 @@
 # include <sys/file.h>
 #endif
 
+#if defined(__linux__)
+# include <sys/syscall.h>
+#endif
+
 namespace mongo {
 
     namespace dur { 
@@ -63,6 +71,9 @@ namespace mongo {
     /* only off if --nohints */
     extern bool useHints;
 
+    /* only on if --getMoreReadAhead */
+    extern bool getMoreReadAhead;
+
     extern int diagLogging;
     extern unsigned lenForNewNsFiles;
     extern int lockFile;
@@ -211,6 +222,22 @@ namespace mongo {
             globalScriptEngine->threadDone();
         }
 
+        // --eventLoop support: a pooled worker hands a connection's Client back and
+        // forth as the connection goes idle / becomes readable again
+        virtual void* releaseConnectionState() {
+            return Client::detachThread();
+        }
+        virtual void restoreConnectionState( void* state ) {
+            Client::attachThread( (Client*)state );
+        }
+        virtual void destroyConnectionState() {
+            Client * c = currentClient.get();
+            if ( c ) {
+                currentClient.release();
+                delete c;
+            }
+        }
+
     };
 
     void listen(int port) {
@@ -218,6 +245,7 @@ namespace mongo {
         MessageServer::Options options;
         options.port = port;
         options.ipList = cmdLine.bind_ip;
+        options.eventLoop = cmdLine.eventLoop;
 
         MessageServer * server = createServer( options , new MyMessageHandler() );
         server->setAsTimeTracker();
@@ -261,6 +289,28 @@ namespace mongo {
         return repairDatabase( dbName.c_str(), errmsg );
     }
 
+    /** read just the first datafile's header with plain file i/o.  checking two
+        version ints does not justify opening the whole database (mapping the .ns
+        file and every datafile), which is what makes restarts with many
+        databases crawl.
+        @return false if the file is missing or unreadable */
+    static bool readDataFileZeroHeader( const string& dbName , DataFileHeader& h ) {
+        stringstream ss;
+        ss << dbName << ".0";
+        boost::filesystem::path p( dbpath );
+        if ( directoryperdb )
+            p /= dbName;
+        p /= ss.str();
+        if ( !boost::filesystem::exists( p ) )
+            return false;
+        File f;
+        f.open( p.string().c_str() , /*readOnly*/ true );
+        if ( !f.is_open() || f.bad() )
+            return false;
+        f.read( 0 , (char*)&h , sizeof( h ) );
+        return !f.bad();
+    }
+
     // ran at startup.
     static void repairDatabasesAndCheckVersion() {
         //        LastError * le = lastError.get( true );
@@ -276,6 +326,13 @@ namespace mongo {
         for ( vector< string >::iterator i = dbNames.begin(); i != dbNames.end(); ++i ) {
             string dbName = *i;
             log(1) << "\t" << dbName << endl;
+
+            {
+                DataFileHeader peek;
+                if ( !forceRepair && readDataFileZeroHeader( dbName , peek ) && peek.isCurrentVersion() )
+                    continue; // up to date; don't open (or map) the database at all
+            }
+
             Client::Context ctx( dbName );
             MongoDataFile *p = cc().database()->getFile( 0 );
             DataFileHeader *h = p->getHeader();
@@ -385,7 +442,20 @@ namespace mongo {
                     continue;
                 }
 
-                sleepmillis( (long long) std::max(0.0, (cmdLine.syncdelay * 1000) - time_flushing) );
+                if ( cmdLine.dur && cmdLine.trickleFlushMB > 0 ) {
+                    // tick once a second, async-msyncing the oldest dirty chunks at
+                    // the configured budget, so the full sync below finds most pages
+                    // already queued to disk instead of issuing one big burst
+                    double left = std::max(0.0, cmdLine.syncdelay - time_flushing / 1000.0);
+                    while ( left > 0 && ! inShutdown() ) {
+                        sleepmillis( (long long) (std::min( left , 1.0 ) * 1000) );
+                        left -= 1;
+                        MongoMMF::trickleFlush( cmdLine.trickleFlushMB );
+                    }
+                }
+                else {
+                    sleepmillis( (long long) std::max(0.0, (cmdLine.syncdelay * 1000) - time_flushing) );
+                }
 
                 if ( inShutdown() ) {
                     // occasional issue trying to flush during shutdown when sleep interrupted
@@ -393,7 +463,16 @@ namespace mongo {
                 }
 
                 Date_t start = jsTime();
-                int numFiles = MemoryMappedFile::flushAll( true );
+                // flash devices want several msyncs in flight to fill their
+                // queues; on spinning disks one sequential pass seeks less.
+                // if the journal shares the device, stay sequential too -
+                // a 4-way msync burst would queue ahead of journal fsyncs
+                // and stall commits
+                bool parallel = storageIsSSD() &&
+                                ( !cmdLine.dur || dur::journalOnSeparateDevice() );
+                int numFiles = parallel ?
+                               MemoryMappedFile::flushAllParallel( 4 ) :
+                               MemoryMappedFile::flushAll( true );
                 time_flushing = (int) (jsTime() - start);
 
                 globalFlushCounters.flushed(time_flushing);
@@ -495,12 +574,22 @@ namespace mongo {
         if ( shouldRepairDatabases )
             return;
 
+        // reload query plans recorded by the previous run so early queries
+        // don't all pay to re-race their plans
+        NamespaceDetailsTransient::loadPersistedQueryCaches();
+
+        // warm the databases that were in use before the last shutdown without
+        // holding up listening; first operations against them then find their
+        // files already mapped
+        boost::thread preopenThread( Database::preopenRecentlyUsed );
+
         /* this is for security on certain platforms (nonce generation) */
         srand((unsigned) (curTimeMicros() ^ startupSrandTimer.micros()));
 
         snapshotThread.go();
         clientCursorMonitor.go();
         PeriodicTask::theRunner->go();
+        startTTLBackgroundJob();
         
 #ifndef _WIN32
         CmdLine::launchOk();
@@ -589,9 +678,20 @@ int main(int argc, char* argv[]) {
     ("dbpath", po::value<string>() , "directory for datafiles")
     ("diaglog", po::value<int>(), "0=off 1=W 2=R 3=both 7=W+some reads")
     ("directoryperdb", "each database will be stored in a separate directory")
+#if defined(__linux__)
+    ("eventLoop", "use an epoll event loop and worker pool for client connections instead of a thread per connection (experimental)")
+    ("hugePages", "advise the kernel to back memory mappings with transparent huge pages")
+    ("numaInterleave", "interleave process memory across NUMA nodes (like numactl --interleave=all)")
+    ("evictBehindScans", "advise the kernel that table-scanned data behind a cursor may be evicted before index pages")
+#endif
     ("journal", "enable journaling")
     ("journalOptions", po::value<int>(), "journal diagnostic options")
+    ("transientMemoryLimitMB", po::value<int>(), "soft limit on transient memory (sorts, map/reduce maps, message buffers); sorts spill to disk earlier when over it")
     ("journalCommitInterval", po::value<unsigned>(), "how often to group/batch commit (ms)")
+    ("journalPath", po::value<string>(&cmdLine.journalPath), "directory for journal files - defaults to <dbpath>/journal; put it on a separate device to keep journal writes out of datafile flush queues")
+    ("journalCompressionWorkers", po::value<int>(), "number of threads compressing the journal buffer (0=auto)")
+    ("ephemeralDbs", po::value<string>(&cmdLine.ephemeralDbs), "comma separated database names kept only in memory - no data files, no journaling; contents are lost on shutdown")
+    ("getMoreReadAhead", "stage the next getMore batch in the background while the client processes the current one")
     ("ipv6", "enable IPv6 support (disabled by default)")
     ("jsonp","allow JSONP access via http (has security implications)")
     ("noauth", "run without security")
@@ -608,12 +708,17 @@ int main(int argc, char* argv[]) {
     ("repair", "run repair on all dbs")
     ("repairpath", po::value<string>() , "root directory for repair files - defaults to dbpath" )
     ("slowms",po::value<int>(&cmdLine.slowMS)->default_value(100), "value of slow for profile and console log" )
+    ("opSampleRate",po::value<int>(&cmdLine.opSampleRate)->default_value(256), "keep 1 of every N finished ops in memory for the sampledOps command (0=off)" )
+    ("opTimeBudgetMS",po::value<int>(&cmdLine.opTimeBudgetMS)->default_value(0), "kill queries/getmores/updates still scanning after this many ms (0=off; a query's $maxTimeMS overrides)" )
+    ("opScanBudget",po::value<int>(&cmdLine.opScanBudget)->default_value(0), "kill scans that visit more than this many index entries/documents (0=off)" )
     ("smallfiles", "use a smaller default file size")
+    ("storageProfile",po::value<string>(&cmdLine.storageProfile)->default_value("auto"), "tune storage for the dbpath device: auto|ssd|hdd (auto checks the device's rotational flag on linux)")
 #if defined(__linux__)
     ("shutdown", "kill a running server (for init scripts)")
 #endif
     ("syncdelay",po::value<double>(&cmdLine.syncdelay)->default_value(60), "seconds between disk syncs (0=never, but not recommended)")
     ("sysinfo", "print some diagnostic system information")
+    ("trickleFlushMB",po::value<int>(&cmdLine.trickleFlushMB)->default_value(32), "MB/sec of dirty data to flush asynchronously between syncdelay syncs, smoothing out flush IO (0=off, requires --journal)")
     ("upgrade", "upgrade db if needed")
     ;
 
@@ -623,6 +728,7 @@ int main(int argc, char* argv[]) {
 
     replication_options.add_options()
     ("oplogSize", po::value<int>(), "size limit (in MB) for op log")
+    ("oplogCompress", "store large oplog entry payloads snappy compressed - all members and oplog readers must support it")
     ;
 
     ms_options.add_options()
@@ -784,6 +890,13 @@ int main(int argc, char* argv[]) {
                 dbexit( EXIT_BADOPTIONS );
             }
         }
+        if( params.count("journalCompressionWorkers") ) {
+            cmdLine.journalCompressionWorkers = params["journalCompressionWorkers"].as<int>();
+            if( cmdLine.journalCompressionWorkers < 0 || cmdLine.journalCompressionWorkers > 16 ) {
+                out() << "--journalCompressionWorkers out of allowed range (0-16)" << endl;
+                dbexit( EXIT_BADOPTIONS );
+            }
+        }
         if (params.count("journalOptions")) {
             cmdLine.durOptions = params["journalOptions"].as<int>();
         }
@@ -800,12 +913,43 @@ int main(int argc, char* argv[]) {
         if (params.count("nohints")) {
             useHints = false;
         }
+        if (params.count("getMoreReadAhead")) {
+            getMoreReadAhead = true;
+        }
         if (params.count("nopreallocj")) {
             cmdLine.preallocj = false;
         }
         if (params.count("nohttpinterface")) {
             noHttpInterface = true;
         }
+        if (params.count("eventLoop")) {
+            cmdLine.eventLoop = true;
+        }
+        if (params.count("transientMemoryLimitMB")) {
+            int mb = params["transientMemoryLimitMB"].as<int>();
+            uassert( 16310 , "bad --transientMemoryLimitMB" , mb > 0 );
+            memaccount::setLimit( mb * 1024LL * 1024 );
+        }
+#if defined(__linux__)
+        if (params.count("hugePages")) {
+            mapHugePagesHint = true;
+        }
+        if (params.count("evictBehindScans")) {
+            evictBehindScans = true;
+        }
+        if (params.count("numaInterleave")) {
+            // MPOL_INTERLEAVE over all nodes, before anything sizable is allocated or mapped.
+            // same effect as starting under numactl --interleave=all.
+            const int MPOL_INTERLEAVE_ = 3;
+            unsigned long nodemask = ~0ul;
+            if ( syscall( SYS_set_mempolicy, MPOL_INTERLEAVE_, &nodemask, sizeof(nodemask) * 8 + 1 ) ) {
+                log() << "warning: numaInterleave: set_mempolicy failed " << errnoWithDescription() << endl;
+            }
+            else {
+                numaInterleaved = true;
+            }
+        }
+#endif
         if (params.count("rest")) {
             cmdLine.rest = true;
         }
@@ -913,6 +1057,9 @@ int main(int argc, char* argv[]) {
             cmdLine.oplogSize = x * 1024 * 1024;
             assert(cmdLine.oplogSize > 0);
         }
+        if (params.count("oplogCompress")) {
+            cmdLine.oplogCompress = true;
+        }
         if (params.count("cacheSize")) {
             long x = params["cacheSize"].as<long>();
             if (x <= 0) {
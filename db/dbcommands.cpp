@@ -32,22 +32,31 @@
 #include "../util/md5.hpp"
 #include "../util/processinfo.h"
 #include "../util/ramlog.h"
+#include "../util/memaccount.h"
 #include "json.h"
 #include "repl.h"
 #include "repl_block.h"
 #include "replutil.h"
 #include "commands.h"
 #include "db.h"
+#include "admission.h"
 #include "instance.h"
 #include "lasterror.h"
 #include "security.h"
 #include "queryoptimizer.h"
+#include "parallelscan.h"
+#include "hasher.h"
+#include "../util/hex.h"
 #include "../scripting/engine.h"
 #include "stats/counters.h"
+#include "stats/top.h"
+#include "stats/lockstat.h"
+#include "stats/snapshots.h"
 #include "background.h"
 #include "../util/version.h"
-#include "../s/d_writeback.h"
+#include "../s/d_logic.h"
 #include "dur_stats.h"
+#include "dur_journal.h"
 
 namespace mongo {
 
@@ -130,6 +139,14 @@ namespace mongo {
 
             result.appendNumber( "connectionId" , c.getConnectionId() ); // for sharding; also useful in general for debugging
 
+            if ( shardingState.enabled() ) {
+                // hand any writes this connection had rejected for a stale
+                // shard version back to mongos, which retries them itself
+                ShardedConnectionInfo* info = ShardedConnectionInfo::get( false );
+                if ( info )
+                    info->appendRejectedWrites( result );
+            }
+
             BSONObj cmdObj = _cmdObj;
             {
                 BSONObj::iterator i(_cmdObj);
@@ -220,7 +237,13 @@ namespace mongo {
 
                     assert( sprintf( buf , "w block pass: %lld" , ++passes ) < 30 );
                     c.curop()->setMessage( buf );
-                    sleepmillis(1);
+                    // park on the replication wait queue rather than polling; a
+                    // slave progress update that satisfies us wakes us directly.
+                    // the wait is capped so wtimeout and killOp stay responsive.
+                    int maxWait = 100;
+                    if ( timeout > 0 && timeout - t.millis() < maxWait )
+                        maxWait = timeout - t.millis() + 1;
+                    awaitOpReplicated( op, e, maxWait );
                     killCurrentOp.checkForInterrupt();
                 }
                 result.appendNumber( "wtime" , t.millis() );
@@ -409,6 +432,47 @@ namespace mongo {
         }
     } cmdProfile;
 
+    /* fetch the in-memory op sampler ring - see OpSampler in introspect.h */
+    class CmdSampledOps : public Command {
+    public:
+        CmdSampledOps() : Command( "sampledOps" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual bool adminOnly() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help( stringstream& help ) const {
+            help << "{ sampledOps : 1 }\n";
+            help << "returns recently sampled operations, oldest first (see --opSampleRate)";
+        }
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool) {
+            opSampler.append( result );
+            return true;
+        }
+    } cmdSampledOps;
+
+    /* top query patterns by resource consumption - see OpResourceProfile in introspect.h */
+    class CmdOpResources : public Command {
+    public:
+        CmdOpResources() : Command( "opResources" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual bool adminOnly() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help( stringstream& help ) const {
+            help << "{ opResources : 1 , n : <patterns> , by : \"cpu\"|\"faults\" }\n";
+            help << "returns the query patterns that consumed the most thread cpu time\n";
+            help << "(the default) or the most major page faults";
+        }
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool) {
+            int n = 10;
+            if ( cmdObj["n"].isNumber() )
+                n = cmdObj["n"].numberInt();
+            uassert( 16319 , "n must be positive" , n > 0 );
+            string by = cmdObj["by"].valuestrsafe();
+            uassert( 16320 , "by must be \"cpu\" or \"faults\"" , by.empty() || by == "cpu" || by == "faults" );
+            opResourceProfile.append( result , n , by == "faults" );
+            return true;
+        }
+    } cmdOpResources;
+
     class CmdServerStatus : public Command {
     public:
         virtual bool slaveOk() const {
@@ -447,6 +511,7 @@ namespace mongo {
                 t.append("totalTime", tt);
                 t.append("lockTime", tl);
                 t.append("ratio", (tt ? tl/tt : 0));
+                t.append("acquireTime", (double) dbMutex.info().getTimeAcquiring());
 
                 {
                     BSONObjBuilder ttt( t.subobjStart( "currentQueue" ) );
@@ -505,11 +570,14 @@ namespace mongo {
                 
                 int overhead = v - m - connTicketHolder.used();
 
-                if( overhead > 4000 ) { 
+                if( overhead > 4000 ) {
                     t.append("note", "virtual minus mapped is large. could indicate a memory leak");
                     log() << "warning: virtual size (" << v << "MB) - mapped size (" << m << "MB) is large (" << overhead << "MB). could indicate a memory leak" << endl;
                 }
 
+                // per-subsystem breakdown of transient heap consumers (bytes)
+                memaccount::append( t );
+
                 t.done();
 
             }
@@ -542,6 +610,8 @@ namespace mongo {
             {
                 BSONObjBuilder bb( result.subobjStart( "backgroundFlushing" ) );
                 globalFlushCounters.append( bb );
+                if ( cmdLine.dur )
+                    bb.append( "journalOnSeparateDevice" , dur::journalOnSeparateDevice() );
                 bb.done();
             }
 
@@ -557,6 +627,11 @@ namespace mongo {
                 bb.done();
             }
 
+            {
+                BSONObjBuilder bb( result.subobjStart( "admission" ) );
+                admissionController.append( bb );
+                bb.done();
+            }
 
             timeBuilder.appendNumber( "after counters" , Listener::getElapsedTimeMillis() - start );
 
@@ -575,6 +650,19 @@ namespace mongo {
 
             result.append( "opcounters" , globalOpCounters.getObj() );
 
+            {
+                BSONObjBuilder bb( result.subobjStart( "opLatencies" ) );
+                bb.append( "note" , "all times in microseconds" );
+                Top::global.appendLatencyStats( bb );
+                bb.done();
+            }
+
+            {
+                BSONObjBuilder bb( result.subobjStart( "writeLockProfile" ) );
+                lockHoldProfile.append( bb );
+                bb.done();
+            }
+
             {
                 BSONObjBuilder asserts( result.subobjStart( "asserts" ) );
                 asserts.append( "regular" , assertionCount.regular );
@@ -587,8 +675,6 @@ namespace mongo {
 
             timeBuilder.appendNumber( "after asserts" , Listener::getElapsedTimeMillis() - start );
 
-            result.append( "writeBacksQueued" , ! writeBackManager.queuesEmpty() );
-
             if( cmdLine.dur ) {
                 result.append("dur", dur::stats.asObj());
             }
@@ -624,6 +710,98 @@ namespace mongo {
         }
     } cmdServerStatus;
 
+    /* the subset of serverStatus cheap enough to poll every second from many
+       monitors at once: everything here comes from in-memory counters or the
+       snapshot thread - no ProcessInfo syscalls, no replication inspection,
+       no db lock.  field names match serverStatus so consumers can share
+       parsing code (see tools/stat_util.cpp).
+    */
+    class CmdServerStatusLite : public Command {
+    public:
+        CmdServerStatusLite() : Command( "serverStatusLite" , true ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help( stringstream& help ) const {
+            help << "returns the cheap subset of serverStatus, plus rates pre-diffed by the snapshot thread";
+        }
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            result.append( "host" , prettyHostName() );
+            result.append( "version" , versionString );
+            result.append( "process" , "mongod" );
+            result.append( "uptime" , (double) (time(0)-cmdLine.started) );
+            result.appendDate( "localTime" , jsTime() );
+
+            {
+                BSONObjBuilder t( result.subobjStart( "globalLock" ) );
+
+                unsigned long long start, timeLocked;
+                dbMutex.info().getTimingInfo(start, timeLocked);
+                t.append( "totalTime" , (double) ( curTimeMicros64() - start ) );
+                t.append( "lockTime" , (double) timeLocked );
+
+                {
+                    BSONObjBuilder ttt( t.subobjStart( "currentQueue" ) );
+                    int w=0, r=0;
+                    Client::recommendedYieldMicros( &w , &r );
+                    ttt.append( "total" , w + r );
+                    ttt.append( "readers" , r );
+                    ttt.append( "writers" , w );
+                    ttt.done();
+                }
+
+                {
+                    BSONObjBuilder ttt( t.subobjStart( "activeClients" ) );
+                    int w=0, r=0;
+                    Client::getActiveClientCount( w , r );
+                    ttt.append( "total" , w + r );
+                    ttt.append( "readers" , r );
+                    ttt.append( "writers" , w );
+                    ttt.done();
+                }
+
+                t.done();
+            }
+
+            {
+                BSONObjBuilder bb( result.subobjStart( "connections" ) );
+                bb.append( "current" , connTicketHolder.used() );
+                bb.append( "available" , connTicketHolder.available() );
+                bb.done();
+            }
+
+            {
+                BSONObjBuilder bb( result.subobjStart( "indexCounters" ) );
+                globalIndexCounters.append( bb );
+                bb.done();
+            }
+
+            {
+                BSONObjBuilder bb( result.subobjStart( "network" ) );
+                networkCounter.append( bb );
+                bb.done();
+            }
+
+            result.append( "opcounters" , globalOpCounters.getObj() );
+
+            if ( anyReplEnabled() && ! _isMaster() )
+                result.append( "opcountersRepl" , replOpCounters.getObj() );
+
+            // pre-diffed by the snapshot thread over its last ~4 second window,
+            // so pollers don't each have to keep a previous sample around
+            {
+                auto_ptr<SnapshotDelta> delta = statsSnapshots.computeDelta();
+                if ( delta.get() ) {
+                    BSONObjBuilder bb( result.subobjStart( "snapshot" ) );
+                    bb.appendNumber( "intervalMs" , (long long) ( delta->elapsed() / 1000 ) );
+                    bb.append( "writeLockedPercent" , 100 * delta->percentWriteLocked() );
+                    bb.done();
+                }
+            }
+
+            return true;
+        }
+    } cmdServerStatusLite;
+
     class CmdGetOpTime : public Command {
     public:
         virtual bool slaveOk() const {
@@ -1336,7 +1514,12 @@ namespace mongo {
             int numExtents;
             BSONArrayBuilder extents;
 
-            result.appendNumber( "storageSize" , nsd->storageSize( &numExtents , verbose ? &extents : 0  ) / scale );
+            // the cached walk serves the common monitoring poll; verbose wants
+            // per-extent detail so it still walks the chain
+            long long storageSize = verbose ?
+                nsd->storageSize( &numExtents , &extents ) :
+                NamespaceDetailsTransient::get( ns.c_str() ).cachedStorageSize( nsd , &numExtents );
+            result.appendNumber( "storageSize" , storageSize / scale );
             result.append( "numExtents" , numExtents );
             result.append( "nindexes" , nsd->nIndexes );
             result.append( "lastExtentSize" , nsd->lastExtentSize / scale );
@@ -1352,9 +1535,36 @@ namespace mongo {
                 result.append( "max" , nsd->max );
             }
 
-            if ( verbose )
+            if ( verbose ) {
                 result.appendArray( "extents" , extents.arr() );
 
+                // physical layout of the extent chain, for judging how close a
+                // sequential (xnext order) scan gets to sequential disk reads
+                int fileSwitches = 0, backwardJumps = 0, contiguous = 0, nChain = 0;
+                DiskLoc prev;
+                Extent *prevExt = 0;
+                for ( DiskLoc L = nsd->firstExtent; !L.isNull(); L = L.ext()->xnext ) {
+                    Extent *ext = L.ext();
+                    if ( prevExt ) {
+                        if ( L.a() != prev.a() )
+                            fileSwitches++;
+                        else if ( L.getOfs() == prev.getOfs() + prevExt->length )
+                            contiguous++;
+                        else if ( L.getOfs() < prev.getOfs() )
+                            backwardJumps++;
+                    }
+                    prev = L;
+                    prevExt = ext;
+                    nChain++;
+                }
+                BSONObjBuilder frag( result.subobjStart( "extentLayout" ) );
+                frag.append( "extents" , nChain );
+                frag.append( "contiguous" , contiguous );       // xnext physically adjacent to this extent
+                frag.append( "fileSwitches" , fileSwitches );   // xnext lives in a different datafile
+                frag.append( "backwardJumps" , backwardJumps ); // xnext is earlier in the same datafile
+                frag.done();
+            }
+
             return true;
         }
     } cmdCollectionStats;
@@ -1411,7 +1621,7 @@ namespace mongo {
                 size += nsd->stats.datasize;
 
                 int temp;
-                storageSize += nsd->storageSize( &temp );
+                storageSize += NamespaceDetailsTransient::get( ns.c_str() ).cachedStorageSize( nsd , &temp );
                 numExtents += temp;
 
                 indexes += nsd->nIndexes;
@@ -1606,6 +1816,12 @@ namespace mongo {
         virtual bool slaveOk() const { return true; }
         virtual LockType locktype() const { return READ; }
         virtual bool run(const string& dbname , BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool) {
+            /* with { parallel : true } collections are hashed with an order independent
+               per document hash (fanned out across threads for big collections) instead
+               of the serial md5 walk.  much faster on large dbs, but the values are only
+               comparable with other parallel dbHash runs. */
+            bool parallel = cmdObj["parallel"].trueValue();
+
             list<string> colls;
             Database* db = cc().database();
             if ( db )
@@ -1655,19 +1871,41 @@ namespace mongo {
                     continue;
                 }
 
-                md5_state_t st;
-                md5_init(&st);
-
-                long long n = 0;
-                while ( cursor->ok() ) {
-                    BSONObj c = cursor->current();
-                    md5_append( &st , (const md5_byte_t*)c.objdata() , c.objsize() );
-                    n++;
-                    cursor->advance();
+                string hash;
+                if ( parallel ) {
+                    /* per document FNV-1a hashes summed - commutative, so the extent
+                       partitioned walk and the _id order walk here agree, and replicas
+                       with different record layouts still compare equal */
+                    unsigned long long h = 0;
+                    long long n = 0;
+                    if ( parallelScanEligible( nsd, BSONObj() ) ) {
+                        h = parallelCollectionHash( c.c_str() , nsd , n );
+                    }
+                    else {
+                        while ( cursor->ok() ) {
+                            BSONObj cur = cursor->current();
+                            h += bsonHashAppend( cur.objdata() , cur.objsize() , bsonHashSeed );
+                            n++;
+                            cursor->advance();
+                        }
+                    }
+                    hash = toHex( &h , sizeof( h ) );
+                }
+                else {
+                    md5_state_t st;
+                    md5_init(&st);
+
+                    long long n = 0;
+                    while ( cursor->ok() ) {
+                        BSONObj cur = cursor->current();
+                        md5_append( &st , (const md5_byte_t*)cur.objdata() , cur.objsize() );
+                        n++;
+                        cursor->advance();
+                    }
+                    md5digest d;
+                    md5_finish(&st, d);
+                    hash = digestToString( d );
                 }
-                md5digest d;
-                md5_finish(&st, d);
-                string hash = digestToString( d );
 
                 bb.append( c.c_str() + ( dbname.size() + 1 ) , hash );
 
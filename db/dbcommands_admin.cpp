@@ -24,18 +24,23 @@
 
 #include "pch.h"
 #include "jsobj.h"
+#include "db.h"
 #include "pdfile.h"
 #include "namespace-inl.h"
 #include "commands.h"
 #include "cmdline.h"
 #include "btree.h"
+#include "parallelscan.h"
 #include "curop-inl.h"
+#include "d_concurrency.h"
 #include "../util/background.h"
 #include "../util/logfile.h"
 #include "../util/alignedbuilder.h"
 #include "../util/paths.h"
+#include "../util/processinfo.h"
 #include "../scripting/engine.h"
 #include "../util/timer.h"
+#include "stats/top.h"
 
 namespace mongo {
 
@@ -61,8 +66,8 @@ namespace mongo {
                 return 0;
             }
 
-            for ( int i = 0; i < Buckets; i++ )
-                d->deletedList[i].Null();
+            for ( int i = 0; i < AllocBuckets; i++ )
+                d->deletedListEntry(i).Null();
 
             result.append("ns", dropns.c_str());
             return 1;
@@ -238,7 +243,24 @@ namespace mongo {
                 }
 
                 set<DiskLoc> recs;
-                if( scanData ) {
+                if( scanData && !d->capped && parallelScanEligible( d, BSONObj() ) ) {
+                    /* big collection: fan the record walk out per extent group.  capped
+                       collections stay serial below as they also check record order. */
+                    ParallelValidateResult pv;
+                    parallelScanValidate( ns, d, full, pv );
+                    recs.swap( pv.recs );
+                    result.append("objectsFound", (int) pv.n);
+                    if (full) {
+                        if ( pv.nInvalid ) {
+                            valid = false;
+                            errors << "invalid bson object detected (see logs for more info)";
+                        }
+                        result.append("invalidObjects", pv.nInvalid);
+                    }
+                    result.appendNumber("bytesWithHeaders", pv.len);
+                    result.appendNumber("bytesWithoutHeaders", pv.nlen);
+                }
+                else if( scanData ) {
                     shared_ptr<Cursor> c = theDataFileMgr.findAll(ns);
                     int n = 0;
                     int nInvalid = 0;
@@ -305,15 +327,15 @@ namespace mongo {
                 }
 
                 BSONArrayBuilder deletedListArray;
-                for ( int i = 0; i < Buckets; i++ ) {
-                    deletedListArray << d->deletedList[i].isNull();
+                for ( int i = 0; i < AllocBuckets; i++ ) {
+                    deletedListArray << d->deletedListEntry(i).isNull();
                 }
 
                 int ndel = 0;
                 long long delSize = 0;
                 int incorrect = 0;
-                for ( int i = 0; i < Buckets; i++ ) {
-                    DiskLoc loc = d->deletedList[i];
+                for ( int i = 0; i < AllocBuckets; i++ ) {
+                    DiskLoc loc = d->deletedListEntry(i);
                     try {
                         int k = 0;
                         while ( !loc.isNull() ) {
@@ -322,7 +344,7 @@ namespace mongo {
                             ndel++;
 
                             if ( loc.questionable() ) {
-                                if( d->capped && !loc.isValid() && i == 1 ) {
+                                if( d->capped && !loc.isValid() && bucketSlots[i] == 1 ) {
                                     /* the constructor for NamespaceDetails intentionally sets deletedList[1] to invalid
                                        see comments in namespace.h
                                     */
@@ -395,6 +417,233 @@ namespace mongo {
         }
     } validateCmd;
 
+    /** pre-touches a collection's pages (indexes first, then data) so they are
+        resident before the traffic arrives - run on a secondary ahead of a
+        planned promotion and failover starts warm instead of paying 20 minutes
+        of cold faults.  {warmup:1} warms the namespaces Top has recorded the
+        most time in, which is the working set the old primary was serving.
+    */
+    class WarmupCmd : public Command {
+    public:
+        WarmupCmd() : Command( "warmup" ) {}
+
+        virtual bool slaveOk() const { return true; }
+        virtual LockType locktype() const { return READ; }
+        virtual void help(stringstream& h) const {
+            h << "pre-touch index and data pages of a collection so they are resident\n"
+                 "{ warmup : <collection> } or { warmup : 1 } to warm the busiest namespaces per top";
+        }
+
+        bool run(const string& dbname , BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
+            vector<string> nsList;
+            if ( cmdObj.firstElement().type() == String ) {
+                nsList.push_back( dbname + "." + cmdObj.firstElement().valuestr() );
+            }
+            else {
+                hotNamespaces( nsList );
+            }
+
+            BSONArrayBuilder warmed( result.subarrayStart( "warmed" ) );
+            for ( unsigned i = 0; i < nsList.size(); i++ ) {
+                const string& ns = nsList[i];
+                try {
+                    Client::Context ctx( ns );
+                    NamespaceDetails * d = nsdetails( ns.c_str() );
+                    if ( ! d )
+                        continue;
+
+                    if ( !cmdLine.quiet )
+                        tlog() << "CMD: warmup " << ns << endl;
+
+                    long long touched = 0;
+                    long long alreadyIn = 0;
+
+                    // indexes first: a warm btree serves point reads even
+                    // while data pages are still faulting in
+                    NamespaceDetails::IndexIterator ii = d->ii();
+                    while ( ii.more() )
+                        touchNs( ii.next().indexNamespace().c_str() , touched , alreadyIn );
+
+                    touchNs( ns.c_str() , touched , alreadyIn );
+
+                    BSONObjBuilder b( warmed.subobjStart() );
+                    b.append( "ns" , ns );
+                    b.appendNumber( "pagesTouched" , touched );
+                    b.appendNumber( "pagesAlreadyResident" , alreadyIn );
+                    b.done();
+                }
+                catch ( DBException& e ) {
+                    log() << "warmup of " << ns << " failed: " << e.what() << endl;
+                }
+            }
+            warmed.done();
+            return true;
+        }
+
+    private:
+        /** namespaces with the most usage time recorded by Top, busiest first */
+        void hotNamespaces( vector<string>& out ) {
+            Top::UsageMap usage;
+            Top::global.cloneMap( usage );
+
+            vector< pair<long long,string> > byTime;
+            for ( Top::UsageMap::const_iterator i = usage.begin(); i != usage.end(); ++i ) {
+                const string& ns = i->first;
+                // skip db-level rollups and special collections
+                if ( ns.find( '.' ) == string::npos || ns.find( '$' ) != string::npos )
+                    continue;
+                byTime.push_back( make_pair( i->second.total.time , ns ) );
+            }
+            sort( byTime.rbegin() , byTime.rend() );
+
+            for ( unsigned i = 0; i < byTime.size() && i < 10; i++ )
+                out.push_back( byTime[i].second );
+        }
+
+        /** touch every page of every extent of ns.  when ns is an index
+            namespace this covers the btree buckets, in disk order - sequential
+            io, which beats faulting them in logical btree order. */
+        void touchNs( const char * ns , long long& touched , long long& alreadyIn ) {
+            NamespaceDetails * d = nsdetails( ns );
+            if ( ! d )
+                return;
+
+            for ( DiskLoc el = d->firstExtent; !el.isNull(); ) {
+                Extent * e = el.ext();
+                el = e->xnext;
+
+                char * start = (char*)e;
+                int len = e->length;
+
+                int resident = ProcessInfo::pagesInMemory( start , len );
+                if ( resident > 0 )
+                    alreadyIn += resident;
+
+                volatile char sum = 0; // volatile so the touches aren't optimized away
+                for ( int ofs = 0; ofs < len; ofs += 4096 )
+                    sum += start[ofs];
+
+                touched += ( len + 4095 ) / 4096;
+
+                killCurrentOp.checkForInterrupt();
+
+                if ( !el.isNull() ) {
+                    // faulting a cold collection in can take a while; let
+                    // (replication) writes through between extents
+                    dbtemprelease t;
+                }
+                if ( nsdetails( ns ) == 0 )
+                    break; // dropped while we were unlocked
+            }
+        }
+    } warmupCmd;
+
+    /** online btree defragmentation: balances or merges underfilled buckets using the
+        same machinery the delete path uses (mayBalanceWithNeighbors).  mixed workloads
+        (mostly ascending inserts with occasional backfill) can leave interior regions
+        of an index half empty; this recovers that space in place, without the downtime
+        of a reindex.  one bucket is processed per write lock acquisition, so it can
+        run against a live server - preferably during quiet hours.
+    */
+    class RebalanceIndexesCmd : public Command {
+    public:
+        RebalanceIndexesCmd() : Command( "rebalanceIndexes" ) {}
+
+        virtual bool slaveOk() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help(stringstream& h) const {
+            h << "rebalance underfilled btree buckets in place, merging where possible\n"
+                 "{ rebalanceIndexes : <collection> [, index : <indexname>] }\n"
+                 "takes the write lock one bucket at a time; run during quiet hours";
+        }
+
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
+            string coll = cmdObj.firstElement().valuestrsafe();
+            if ( coll.empty() ) {
+                errmsg = "missing collection name";
+                return false;
+            }
+            string ns = dbname + "." + coll;
+            string indexName = cmdObj["index"].valuestrsafe();
+
+            if ( !cmdLine.quiet )
+                tlog() << "CMD: rebalanceIndexes " << ns << endl;
+
+            // collect index names up front; the write lock is released between steps,
+            // so each step below re-resolves its index by name
+            vector<string> names;
+            {
+                readlock lk(ns);
+                Client::Context ctx(ns);
+                NamespaceDetails *d = nsdetails(ns.c_str());
+                if ( ! d ) {
+                    errmsg = "ns not found";
+                    return false;
+                }
+                NamespaceDetails::IndexIterator ii = d->ii();
+                while( ii.more() ) {
+                    IndexDetails& idx = ii.next();
+                    if ( indexName.empty() || indexName == idx.indexName() )
+                        names.push_back( idx.indexName() );
+                }
+            }
+            if ( names.empty() ) {
+                errmsg = "index not found";
+                return false;
+            }
+
+            long long total = 0;
+            BSONObjBuilder perIndex;
+            for ( unsigned i = 0; i < names.size(); i++ ) {
+                long long actions = 0;
+                vector<DiskLoc> candidates;
+                DiskLoc infoLoc;
+
+                {
+                    writelock lk(ns);
+                    Client::Context ctx(ns);
+                    NamespaceDetails *d = nsdetails(ns.c_str());
+                    if ( ! d )
+                        continue;
+                    int no = d->findIndexByName( names[i].c_str() );
+                    if ( no < 0 )
+                        continue;
+                    IndexDetails& idx = d->idx(no);
+                    infoLoc = idx.info;
+                    idx.idxInterface().findUnderfullBuckets( idx.head, candidates );
+                }
+
+                // one bucket per write lock acquisition.  rebalanceBucket ignores
+                // candidates invalidated by intervening merges or writes.
+                for ( unsigned j = 0; j < candidates.size(); j++ ) {
+                    killCurrentOp.checkForInterrupt();
+
+                    writelock lk(ns);
+                    Client::Context ctx(ns);
+                    NamespaceDetails *d = nsdetails(ns.c_str());
+                    if ( ! d )
+                        break; // collection dropped out from under us
+                    int no = d->findIndexByName( names[i].c_str() );
+                    if ( no < 0 )
+                        break; // index dropped
+                    IndexDetails& idx = d->idx(no);
+                    if ( idx.info != infoLoc )
+                        break; // index dropped and recreated - our candidates are meaningless
+                    Ordering order = Ordering::make( idx.keyPattern() );
+                    if ( idx.idxInterface().rebalanceBucket( candidates[j], idx, order ) )
+                        actions++;
+                    getDur().commitIfNeeded();
+                }
+
+                perIndex.appendNumber( names[i], actions );
+                total += actions;
+            }
+            result.append( "indexes", perIndex.obj() );
+            result.appendNumber( "bucketsChanged", total );
+            return true;
+        }
+    } rebalanceIndexesCmd;
+
     bool lockedForWriting = false; // read from db/instance.cpp
     static bool unlockRequested = false;
     static mongo::mutex fsyncLockMutex("fsyncLock");
@@ -530,6 +779,64 @@ namespace mongo {
 
     } fsyncCmd;
 
+    /* fsync+lock stops the whole mongod; on a node hosting many databases that is
+       too big a hammer for snapshotting just one.  freezeDb quiesces a single
+       database - its writers park in DatabaseFreezer::waitUntilWritable() before
+       taking any lock, so the other databases keep writing.  reads are unaffected.
+    */
+    class FreezeDBCommand : public Command {
+    public:
+        FreezeDBCommand() : Command( "freezeDb" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual bool adminOnly() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help(stringstream& h) const {
+            h << "block writes to one database so it can be snapshotted, without locking the others.\n"
+                 "{ freezeDb : <dbname> }\n"
+                 "datafiles are flushed before returning.  { unfreezeDb : <dbname> } resumes writes.";
+        }
+        virtual bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            string db = cmdObj.firstElement().valuestrsafe();
+            uassert( 16269, "freezeDb: database name required", !db.empty() && db.find( '.' ) == string::npos );
+            if( !databaseFreezer.freeze( db ) ) {
+                errmsg = "database already frozen";
+                return false;
+            }
+            /* new writers now park before locking anything.  a writer already past
+               that gate holds (or is queued for) the global write lock, so taking it
+               once drains them; then push everything to disk for the snapshot. */
+            {
+                writelock w;
+                getDur().commitNow();
+            }
+            MemoryMappedFile::flushAll( true );
+            log() << "freezeDb: " << db << " is now locked against writes, { unfreezeDb : \"" << db << "\" } to unlock" << endl;
+            result.append( "info", "database locked against writes and flushed to disk" );
+            return true;
+        }
+    } freezeDBCommand;
+
+    class UnfreezeDBCommand : public Command {
+    public:
+        UnfreezeDBCommand() : Command( "unfreezeDb" ) {}
+        virtual bool slaveOk() const { return true; }
+        virtual bool adminOnly() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual void help(stringstream& h) const {
+            h << "resume writes to a database frozen with freezeDb\n{ unfreezeDb : <dbname> }";
+        }
+        virtual bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            string db = cmdObj.firstElement().valuestrsafe();
+            uassert( 16270, "unfreezeDb: database name required", !db.empty() && db.find( '.' ) == string::npos );
+            if( !databaseFreezer.unfreeze( db ) ) {
+                errmsg = "database is not frozen";
+                return false;
+            }
+            log() << "unfreezeDb: writes to " << db << " resumed" << endl;
+            return true;
+        }
+    } unfreezeDBCommand;
+
     // Note that this will only unlock the current lock.  If another thread
     // relocks before we return we still consider the unlocking successful.
     // This is imporant because if two scripts are trying to fsync-lock, each
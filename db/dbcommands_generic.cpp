@@ -40,6 +40,7 @@
 #include "background.h"
 #include "../util/version.h"
 #include "../util/ramlog.h"
+#include "../util/optrace.h"
 #include "repl/multicmd.h"
 #include "server.h"
 
@@ -160,6 +161,9 @@ namespace mongo {
             if( all || cmdObj.hasElement("replApplyBatchSize") ) {
                 result.append("replApplyBatchSize", replApplyBatchSize);
             }
+            if( all || cmdObj.hasElement("indexBuildThrottleMBPerSec") ) {
+                result.append("indexBuildThrottleMBPerSec", indexBuildThrottleMBPerSec);
+            }
 
             if ( before == result.len() ) {
                 errmsg = "no option found to get";
@@ -182,7 +186,9 @@ namespace mongo {
             help << "set administrative option(s)\n";
             help << "{ setParameter:1, <param>:<value> }\n";
             help << "supported so far:\n";
+            help << "  indexBuildThrottleMBPerSec\n";
             help << "  journalCommitInterval\n";
+            help << "  journalCompressionWorkers\n";
             help << "  logLevel\n";
             help << "  notablescan\n";
             help << "  quiet\n";
@@ -202,6 +208,17 @@ namespace mongo {
                 log() << "setParameter journalCommitInterval=" << x << endl;
                 s++;
             }
+            if( cmdObj.hasElement("journalCompressionWorkers") ) {
+                if( !cmdLine.dur ) {
+                    errmsg = "journaling is off";
+                    return false;
+                }
+                int x = (int) cmdObj["journalCompressionWorkers"].Number();
+                assert( x >= 0 && x <= 16 );
+                cmdLine.journalCompressionWorkers = x; // picked up by the durability thread on its next group commit
+                log() << "setParameter journalCompressionWorkers=" << x << endl;
+                s++;
+            }
             if( cmdObj.hasElement("notablescan") ) {
                 assert( !cmdLine.isMongos() );
                 if( s == 0 )
@@ -228,6 +245,18 @@ namespace mongo {
                 logLevel = cmdObj["logLevel"].numberInt();
                 s++;
             }
+            if( cmdObj.hasElement( "indexBuildThrottleMBPerSec" ) ) {
+                int x = cmdObj["indexBuildThrottleMBPerSec"].numberInt();
+                if( x < 0 ) {
+                    errmsg = "indexBuildThrottleMBPerSec must be >= 0 (0 means unthrottled)";
+                    return false;
+                }
+                if( s == 0 )
+                    result.append("was", indexBuildThrottleMBPerSec );
+                indexBuildThrottleMBPerSec = x; // picked up by in-progress builds on their next pacing check
+                log() << "setParameter indexBuildThrottleMBPerSec=" << x << endl;
+                s++;
+            }
             if( cmdObj.hasElement( "replApplyBatchSize" ) ) {
                 if( s == 0 )
                     result.append("was", replApplyBatchSize );
@@ -424,4 +453,32 @@ namespace mongo {
 
     } getLogCmd;
 
+    class GetTraceCmd : public Command {
+    public:
+        GetTraceCmd() : Command( "getTrace" ) {}
+
+        virtual bool slaveOk() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+        virtual bool adminOnly() const { return true; }
+
+        virtual void help( stringstream& help ) const {
+            help << "{ getTrace : <traceId> } returns this node's recorded spans for a sampled trace id; "
+                 << "run against mongos and each shard to see an operation end to end";
+        }
+
+        virtual bool run(const string& dbname , BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool) {
+            unsigned traceId = (unsigned) cmdObj.firstElement().numberLong();
+            if ( traceId == 0 ) {
+                errmsg = "need a nonzero trace id";
+                return false;
+            }
+
+            BSONArrayBuilder arr( result.subarrayStart( "spans" ) );
+            opTraceRing.appendTrace( traceId , arr );
+            arr.done();
+            return true;
+        }
+
+    } getTraceCmd;
+
 }
@@ -85,12 +85,13 @@ namespace mongo {
     }
 
     void replyToQuery(int queryResultFlags, Message &m, DbResponse &dbresponse, BSONObj obj) {
-        BufBuilder b;
+        // build the reply in the per-connection op arena where available: the
+        // memory stays valid until the next request begins (after the response
+        // is sent) and the arena keeps its capacity across requests
+        BufBuilder b( BufBuilder::UseOpScratch() , 512 );
         b.skip(sizeof(QueryResult));
         b.appendBuf((void*) obj.objdata(), obj.objsize());
-        QueryResult* msgdata = (QueryResult *) b.buf();
-        b.decouple();
-        QueryResult *qr = msgdata;
+        QueryResult *qr = (QueryResult *) b.buf();
         qr->_resultFlags() = queryResultFlags;
         qr->len = b.len();
         qr->setOperation(opReply);
@@ -98,7 +99,13 @@ namespace mongo {
         qr->startingFrom = 0;
         qr->nReturned = 1;
         Message *resp = new Message();
-        resp->setData(msgdata, true); // transport will free
+        if ( b.opScratch() ) {
+            resp->setData(qr, false); // arena memory; freed by the arena, not the transport
+        }
+        else {
+            b.decouple();
+            resp->setData(qr, true); // transport will free
+        }
         dbresponse.response = resp;
         dbresponse.responseTo = m.header()->id;
     }
@@ -120,10 +120,11 @@ namespace mongo {
             nextjsobj = data;
         }
 
-        /** the 32 bit field before the ns 
+        /** the 32 bit field before the ns
          * track all bit usage here as its cross op
          * 0: InsertOption_ContinueOnError
          * 1: fromWriteback
+         * 16-31: sampled trace id set by mongos (see util/optrace.h)
          */
         int& reservedField() { return *reserved; }
 
@@ -233,8 +234,9 @@ namespace mongo {
 
     public:
         enum ReservedOptions {
-            Reserved_InsertOption_ContinueOnError = 1 << 0 , 
-            Reserved_FromWriteback = 1 << 1 
+            Reserved_InsertOption_ContinueOnError = 1 << 0 ,
+            Reserved_FromWriteback = 1 << 1 ,
+            Reserved_TraceIdShift = 16 // high 16 bits carry a sampled trace id
         };
     };
 
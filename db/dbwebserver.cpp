@@ -61,13 +61,49 @@ namespace mongo {
     class DbWebServer : public MiniWebServer {
     public:
         DbWebServer(const string& ip, int port, const AdminAccess* webUsers)
-            : MiniWebServer("admin web console", ip, port), _webUsers(webUsers) {
+            : MiniWebServer("admin web console", ip, port), _webUsers(webUsers),
+              _requestTickets( 16 ),
+              _homeCacheMutex( "DbWebServer::homeCache" ), _homeCacheAt( 0 ) {
             WebStatusPlugin::initAll();
         }
 
     private:
         const AdminAccess* _webUsers; // not owned here
 
+        TicketHolder _requestTickets;
+
+        mongo::mutex _homeCacheMutex;
+        string _homeCache;
+        time_t _homeCacheAt;
+
+        /** a stalled client (socket timeout is 8 seconds) used to hold the
+            listener thread and with it every other status probe.  give each
+            request its own short lived thread; beyond the cap we serve inline
+            on the listener as before. */
+        virtual void accepted( Socket socket ) {
+            if ( _requestTickets.tryAcquire() ) {
+                boost::thread t( boost::bind( &DbWebServer::_serveRequest , this , socket ) );
+            }
+            else {
+                MiniWebServer::accepted( socket );
+            }
+        }
+
+        void _serveRequest( Socket socket ) {
+            Client::initThread( "websvr" );
+            try {
+                MiniWebServer::accepted( socket );
+            }
+            catch ( std::exception& e ) {
+                log() << "web request error: " << e.what() << endl;
+            }
+            catch ( ... ) {
+                log() << "web request error: unknown exception" << endl;
+            }
+            _requestTickets.release();
+            cc().shutdown();
+        }
+
         void doUnlockedStuff(stringstream& ss) {
             /* this is in the header already ss << "port:      " << port << '\n'; */
             ss << "<pre>";
@@ -76,6 +112,7 @@ namespace mongo {
             ss << "sys info: " << sysInfo() << '\n';
             ss << "uptime: " << time(0)-started << " seconds\n";
             ss << "</pre>";
+            Top::global.latencyHTML( ss );
         }
 
         bool allowed( const char * rq , vector<string>& headers, const SockAddr &from ) {
@@ -145,6 +182,16 @@ namespace mongo {
             vector<string>& headers, // if completely empty, content-type: text/html will be added
             const SockAddr &from
         ) {
+            if ( url == "/ping" ) {
+                // health check endpoint for load balancers.  probes hit this
+                // once a second per node, so it is answered entirely from
+                // memory: no auth, no commands, no lock acquisitions.
+                responseCode = 200;
+                headers.push_back( "Content-Type: application/json;charset=utf-8" );
+                responseMsg = "{ \"ok\" : 1 }\n";
+                return;
+            }
+
             if ( url.size() > 1 ) {
 
                 if ( ! allowed( rq , headers, from ) ) {
@@ -203,6 +250,25 @@ namespace mongo {
             }
 
             responseCode = 200;
+            headers.push_back( "Content-Type: text/html;charset=utf-8" );
+
+            // probes polling "/" used to render the page -- and run every
+            // status plugin, some of which take locks -- on each hit.  the
+            // plugins draw on the 4 second stats snapshots, so a fresher
+            // render has nothing new to say: cache the page for one snapshot
+            // interval and serve the copy.
+            {
+                time_t now = time(0);
+                scoped_lock lk( _homeCacheMutex );
+                if ( _homeCache.empty() || now - _homeCacheAt >= 4 ) {
+                    _homeCache = _renderHome();
+                    _homeCacheAt = now;
+                }
+                responseMsg = _homeCache;
+            }
+        }
+
+        string _renderHome() {
             stringstream ss;
             string dbname;
             {
@@ -249,8 +315,7 @@ namespace mongo {
             WebStatusPlugin::runAll( ss );
 
             ss << "</body></html>\n";
-            responseMsg = ss.str();
-            headers.push_back( "Content-Type: text/html;charset=utf-8" );
+            return ss.str();
         }
 
         void _rejectREST( string& responseMsg , int& responseCode, vector<string>& headers ) {
@@ -91,6 +91,17 @@ namespace mongo {
             memset(this, 0, sizeof(*this));
         }
 
+        void Stats::S::noteCommitLatencyMicros(unsigned long long micros) {
+            _commitLatencyMicros += micros;
+            unsigned long long ms = micros / 1000;
+            int bucket = 0;
+            while( bucket < NLatencyBuckets-1 && ms >= 1 ) {
+                ms /= 10;
+                bucket++;
+            }
+            _commitLatencyBuckets[bucket]++;
+        }
+
         Stats::Stats() {
             _a.reset();
             _b.reset();
@@ -103,16 +114,18 @@ namespace mongo {
         }
                         string _CSVHeader();
 
-        string Stats::S::_CSVHeader() { 
-            return "cmts  jrnMB\twrDFMB\tcIWLk\tearly\tprpLgB  wrToJ\twrToDF\trmpPrVw";
+        string Stats::S::_CSVHeader() {
+            return "cmts  intents dclMB\tjrnMB\twrDFMB\tcIWLk\tearly\tprpLgB  wrToJ\twrToDF\trmpPrVw";
         }
 
-        string Stats::S::_asCSV() { 
+        string Stats::S::_asCSV() {
             stringstream ss;
-            ss << 
-                setprecision(2) << 
-                _commits << '\t' << fixed << 
-                _journaledBytes / 1000000.0 << '\t' << 
+            ss <<
+                setprecision(2) <<
+                _commits << '\t' << fixed <<
+                _writeIntents << '\t' <<
+                _declaredWriteBytes / 1000000.0 << '\t' <<
+                _journaledBytes / 1000000.0 << '\t' <<
                 _writeToDataFilesBytes / 1000000.0 << '\t' << 
                 _commitsInWriteLock << '\t' << 
                 _earlyCommits <<  '\t' << 
@@ -128,17 +141,38 @@ namespace mongo {
             BSONObjBuilder b;
             b << 
                        "commits" << _commits <<
+                       "writeIntents" << (long long) _writeIntents <<
+                       "declaredMB" << _declaredWriteBytes / 1000000.0 <<
                        "journaledMB" << _journaledBytes / 1000000.0 <<
                        "writeToDataFilesMB" << _writeToDataFilesBytes / 1000000.0 <<
                        "compression" << _journaledBytes / (_uncompressedBytes+1.0) <<
                        "commitsInWriteLock" << _commitsInWriteLock <<
                        "earlyCommits" << _earlyCommits << 
+                       "commitLatencyDistribution" <<
+                       BSON( "lt1ms" << _commitLatencyBuckets[0] <<
+                             "lt10ms" << _commitLatencyBuckets[1] <<
+                             "lt100ms" << _commitLatencyBuckets[2] <<
+                             "lt1000ms" << _commitLatencyBuckets[3] <<
+                             "gte1000ms" << _commitLatencyBuckets[4] <<
+                             "totalMs" << (unsigned) (_commitLatencyMicros/1000)
+                           ) <<
                        "timeMs" <<
                        BSON( "dt" << _dtMillis <<
                              "prepLogBuffer" << (unsigned) (_prepLogBufferMicros/1000) <<
                              "writeToJournal" << (unsigned) (_writeToJournalMicros/1000) <<
                              "writeToDataFiles" << (unsigned) (_writeToDataFilesMicros/1000) <<
                              "remapPrivateView" << (unsigned) (_remapPrivateViewMicros/1000)
+                           ) <<
+                       "journalDevice" <<
+                       BSON( "separate" << journalOnSeparateDevice() <<
+                             "writes" << _journalWrites <<
+                             "totalMs" << (unsigned) (_writeToJournalMicros/1000) <<
+                             "maxWriteMs" << (unsigned) (_journalMaxWriteMicros/1000)
+                           ) <<
+                       "dataFileDevice" <<
+                       BSON( "writes" << _dataFilesWrites <<
+                             "totalMs" << (unsigned) (_writeToDataFilesMicros/1000) <<
+                             "maxWriteMs" << (unsigned) (_dataFilesMaxWriteMicros/1000)
                            );
             /*int r = getAgeOutJournalFiles();
             if( r == -1 )
@@ -189,6 +223,11 @@ namespace mongo {
 
             size_t ofs;
             MongoMMF *f = privateViews.find_inlock(dst, ofs);
+            if( f == 0 && ephemeralViews.find(dst, ofs) ) {
+                // ephemeral arena - there is only one view, just write it
+                memcpy(dst, src, len);
+                return;
+            }
             assert(f);
             void *w = (((char *)f->view_write())+ofs);
             // first write it to the writable (file) view
@@ -237,6 +276,8 @@ namespace mongo {
             happen because of crashing.
         */
         void DurableImpl::createdFile(string filename, unsigned long long len) {
+            if( MongoMMF::isEphemeralPath(filename) )
+                return; // no file exists; the journal must not recreate one on recovery
             shared_ptr<DurOp> op( new FileCreatedOp(filename, len) );
             commitJob.noteOp(op);
         }
@@ -464,9 +505,21 @@ namespace mongo {
             unsigned startedAt = startAt;
             startAt = (startAt + ntodo) % sz; // mark where to start next time
 
+            // bound the stall we cause: everyone is waiting on the write lock while
+            // we are in here.  if we run over budget, stop; the next commit's remap
+            // pass resumes where we left off.  (we cannot defer to an arbitrary
+            // later write lock -- by then there may be uncommitted writes in the
+            // private views and remapping would lose them.)
+            const unsigned budgetMicros = 2000;
+
             Timer t;
             for( unsigned x = 0; x < ntodo; x++ ) {
                 dassert( i != e );
+                if( x && t.micros() > budgetMicros ) {
+                    startAt = (startedAt + x) % sz; // resume here next pass
+                    LOG(2) << "journal REMAPPRIVATEVIEW over budget, deferring " << (ntodo-x) << " files" << endl;
+                    break;
+                }
                 if( (*i)->isMongoMMF() ) {
                     MongoMMF *mmf = (MongoMMF*) *i;
                     assert(mmf);
@@ -737,11 +790,24 @@ namespace mongo {
                 RACECHECK
 
                 unsigned ms = cmdLine.journalCommitInterval;
-                if( ms == 0 ) { 
+                if( ms == 0 ) {
                     // use default
                     ms = samePartition ? 100 : 30;
                 }
 
+                // scale the interval down when write intents are piling up so we don't
+                // approach UncommittedBytesLimit and force a (possibly write locked)
+                // early commit.  commitJob.bytes() is approximate; that's fine here.
+                {
+                    size_t bytes = commitJob.bytes();
+                    if( bytes > UncommittedBytesLimit / 2 )
+                        ms = 1;
+                    else if( bytes > UncommittedBytesLimit / 4 )
+                        ms = ms / 4 + 1;
+                    else if( bytes > UncommittedBytesLimit / 16 )
+                        ms = ms / 2 + 1;
+                }
+
                 unsigned oneThird = (ms / 3) + 1; // +1 so never zero
 
                 try {
@@ -750,16 +816,20 @@ namespace mongo {
                     // we do this in a couple blocks (the invoke()), which makes it a tiny bit faster (only a little) on throughput,
                     // but is likely also less spiky on our cpu usage, which is good.
 
-                    // commit sooner if one or more getLastError j:true is pending
-                    sleepmillis(oneThird);
+                    // commit sooner if one or more getLastError j:true is pending --
+                    // waitForWaiter returns as soon as one arrives rather than
+                    // finishing the sleep slice
+                    commitJob._notify.waitForWaiter(oneThird);
                     for( unsigned i = 1; i <= 2; i++ ) {
                         if( commitJob._notify.nWaiting() )
                             break;
                         commitJob.wi()._deferred.invoke();
-                        sleepmillis(oneThird);
+                        commitJob._notify.waitForWaiter(oneThird);
                     }
 
+                    Timer t;
                     go();
+                    stats.curr->noteCommitLatencyMicros( t.micros() );
                 }
                 catch(std::exception& e) {
                     log() << "exception in durThread causing immediate shutdown: " << e.what() << endl;
@@ -27,6 +27,9 @@
 #include "../util/alignedbuilder.h"
 #include "../util/net/listen.h" // getelapsedtimemillis
 #include <boost/static_assert.hpp>
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
 #undef assert
 #define assert MONGO_assert
 #include "../util/mongoutils/str.h"
@@ -34,6 +37,7 @@
 #include "../util/file.h"
 #include "../util/checksum.h"
 #include "../util/concurrency/race.h"
+#include "../util/concurrency/thread_pool.h"
 #include "../util/compress.h"
 #include "../server.h"
 
@@ -73,11 +77,39 @@ namespace mongo {
         void removeOldJournalFile(path p);
 
         filesystem::path getJournalDir() {
+            if( !cmdLine.journalPath.empty() )
+                return filesystem::path(cmdLine.journalPath);
             filesystem::path p(dbpath);
             p /= "journal";
             return p;
         }
 
+        static int _journalSeparateDevice = -1; // -1 until checkJournalDevice()
+
+        bool journalOnSeparateDevice() {
+            return _journalSeparateDevice == 1;
+        }
+
+        /** note whether the journal dir lives on a different device than the
+            datafiles.  when it does, journal fsyncs and datafile msyncs don't
+            queue behind each other, so background flushing can be more
+            aggressive (see DataFileSync) and a slow commit can be pinned on
+            the right device from the per device stats in serverStatus.
+        */
+        static void checkJournalDevice() {
+#if !defined(_WIN32)
+            struct stat dataStat, journalStat;
+            if( stat(dbpath.c_str(), &dataStat) == 0 &&
+                stat(getJournalDir().string().c_str(), &journalStat) == 0 ) {
+                _journalSeparateDevice = ( dataStat.st_dev != journalStat.st_dev ) ? 1 : 0;
+                log() << "journal device " << ( journalOnSeparateDevice() ? "separate from" : "shared with" )
+                      << " datafile device" << endl;
+                return;
+            }
+#endif
+            _journalSeparateDevice = 0;
+        }
+
         path lsnPath() {
             return getJournalDir()/"lsn";
         }
@@ -370,7 +402,13 @@ namespace mongo {
             j.open();
         }
 
-        void removeOldJournalFile(path p) { 
+        // serializes create/recycle of the prealloc.<n> slots across the
+        // background threads below, rotation taking a slot in Journal::_open,
+        // and shutdown cleanup
+        static SimpleMutex _preallocMutex("journalPrealloc");
+
+        void removeOldJournalFile(path p) {
+            SimpleMutex::scoped_lock lk(_preallocMutex);
             if( usingPreallocate ) {
                 try {
                     for( int i = 0; i < NUM_PREALLOC_FILES; i++ ) {
@@ -422,6 +460,60 @@ namespace mongo {
             return path();
         }
 
+        /** recycling an aged-out journal file zeroes its header and fsyncs a
+            DataLimitPerJournalFile-sized truncate - much too slow for the commit
+            path, which used to do it inline during rotation.  run it on a
+            throwaway thread instead; files age out at most once per journal file
+            written so the thread churn is trivial.
+        */
+        static void removeOldJournalFileInBackground(path p) {
+            try {
+                removeOldJournalFile(p);
+            }
+            catch(...) {
+                log() << "warning exception recycling journal file " << p.string() << endl;
+            }
+        }
+
+        /** rotation consumes a prealloc file and the old journal file that ages
+            out a little later is normally recycled straight into the empty slot,
+            so the ring sustains itself without new allocations.  if it ever runs
+            completely dry (age-out lagging, or files removed externally), build
+            one replacement here in the background rather than letting the next
+            rotation create a file synchronously in the commit path.
+        */
+        // serializes concurrent replenishers only; _preallocMutex must not be
+        // held across the zero-fill below or rotation would block behind it
+        static SimpleMutex _replenishMutex("journalReplenish");
+
+        static void replenishPreallocFiles() {
+            try {
+                SimpleMutex::scoped_lock rlk(_replenishMutex);
+                {
+                    SimpleMutex::scoped_lock lk(_preallocMutex);
+                    if( !findPrealloced().empty() )
+                        return;
+                }
+
+                // build under a temp name: rotation takes any existing prealloc.<n>
+                // by rename, so the file must not appear at its final name until it
+                // is fully zeroed and fsynced (see preallocateFile)
+                filesystem::path temppath = preallocPath(0).string() + ".temp";
+                if( filesystem::exists(temppath) )
+                    boost::filesystem::remove(temppath); // leftover from an interrupted attempt
+                preallocateFile(temppath, DataLimitPerJournalFile);
+
+                SimpleMutex::scoped_lock lk(_preallocMutex);
+                if( !filesystem::exists(preallocPath(0)) )
+                    boost::filesystem::rename(temppath, preallocPath(0));
+                else
+                    boost::filesystem::remove(temppath); // a recycle refilled the slot while we built
+            }
+            catch(...) {
+                log() << "warning caught exception in replenishPreallocFiles, continuing" << endl;
+            }
+        }
+
         /** assure journal/ dir exists. throws. call during startup. */
         void journalMakeDir() {
             j.init();
@@ -438,6 +530,8 @@ namespace mongo {
                     throw;
                 }
             }
+
+            checkJournalDevice();
         }
 
         void Journal::_open() {
@@ -445,11 +539,14 @@ namespace mongo {
             assert( _curLogFile == 0 );
             path fname = getFilePathFor(_nextFileNumber);
 
-            // if we have a prealloced file, use it 
+            // if we have a prealloced file, use it
             {
+                // the lock keeps the find+rename atomic with respect to the
+                // background threads renaming files into/out of the slots
+                SimpleMutex::scoped_lock lk(_preallocMutex);
                 path p = findPrealloced();
-                if( !p.empty() ) { 
-                    try { 
+                if( !p.empty() ) {
+                    try {
                         {
                             // JHeader::fileId must be updated before renaming to be race-safe
                             LogFile f(p.string());
@@ -460,10 +557,17 @@ namespace mongo {
                         }
                         boost::filesystem::rename(p, fname);
                     }
-                    catch(...) { 
+                    catch(...) {
                         log() << "warning couldn't write to / rename file " << p.string() << endl;
                     }
                 }
+                else if( usingPreallocate ) {
+                    log() << "warning: journal prealloc ring is empty, creating " << fname.string() << " in the commit path" << endl;
+                }
+            }
+            if( usingPreallocate ) {
+                // keep the ring topped up without doing allocation work here
+                boost::thread t(replenishPreallocFiles);
             }
 
             _curLogFile = new LogFile(fname.string());
@@ -601,6 +705,10 @@ namespace mongo {
             be in _curLogFileMutex but not dbMutex when calling
         */
         void Journal::removeUnneededJournalFiles() {
+            if( !_ageOut ) {
+                // old files are being preserved - e.g. a hot backup is copying them
+                return;
+            }
             while( !_oldJournalFiles.empty() ) {
                 JFile f = _oldJournalFiles.front();
 
@@ -608,7 +716,7 @@ namespace mongo {
                     // eligible for deletion
                     path p( f.filename );
                     log() << "old journal file will be removed: " << f.filename << endl;
-                    removeOldJournalFile(p);
+                    boost::thread t(boost::bind(removeOldJournalFileInBackground, p));
                 }
                 else {
                     break;
@@ -674,18 +782,73 @@ namespace mongo {
         void WRITETOJOURNAL(JSectHeader h, AlignedBuilder& uncompressed) {
             Timer t;
             j.journal(h, uncompressed);
-            stats.curr->_writeToJournalMicros += t.micros();
+            unsigned long long m = t.micros();
+            stats.curr->_writeToJournalMicros += m;
+            stats.curr->_journalWrites++;
+            if( m > stats.curr->_journalMaxWriteMicros )
+                stats.curr->_journalMaxWriteMicros = m;
         }
+
+        /** chunks of the commit buffer this size (or smaller, for the tail) are compressed
+            independently so that large commits can be compressed on several cores at once.
+            each chunk is framed in the journal section as { compressedLen, rawLen, <snappy bytes> }.
+        */
+        enum { JournalCompressionChunkSz = 4 * 1024 * 1024 };
+
+        static unsigned effectiveCompressionWorkers() {
+            int n = cmdLine.journalCompressionWorkers;
+            if( n <= 0 ) {
+                unsigned cores = boost::thread::hardware_concurrency();
+                n = cores >= 8 ? 4 : ( cores >= 4 ? 2 : 1 );
+            }
+            return (unsigned) min(n, 16);
+        }
+
+        /** state for one chunk compression task - see Journal::journal() */
+        struct CompressChunkTask {
+            const char *src;
+            unsigned srcLen;
+            vector<char> out;
+            size_t outLen;
+        };
+
+        static void compressChunk(CompressChunkTask *t) {
+            t->outLen = 0;
+            rawCompress(t->src, t->srcLen, &t->out[0], &t->outLen);
+        }
+
+        /** only called from the durability thread.  journal() join()s before returning so the
+            pool is idle here; if the tunable changed (setParameter journalCompressionWorkers)
+            we can safely recreate it at the new size.
+        */
+        static ThreadPool& compressionPool() {
+            static ThreadPool *tp = 0;
+            static unsigned tpSize = 0;
+            unsigned n = effectiveCompressionWorkers();
+            if( tp && tpSize != n ) {
+                delete tp; // joins
+                tp = 0;
+            }
+            if( tp == 0 ) {
+                tp = new ThreadPool(n);
+                tpSize = n;
+            }
+            return *tp;
+        }
+
         void Journal::journal(const JSectHeader& h, const AlignedBuilder& uncompressed) {
             RACECHECK
             static AlignedBuilder b(32*1024*1024);
             /* buffer to journal will be
                JSectHeader
-               compressed operations
+               compressed operations - framed chunks, see JournalCompressionChunkSz comments
                JSectFooter
             */
+            const unsigned chunkSz = JournalCompressionChunkSz;
+            const unsigned nChunks = uncompressed.len() ? (uncompressed.len() + chunkSz - 1) / chunkSz : 1;
+            const unsigned frameHeaderSize = 2 * sizeof(unsigned);
             const unsigned headTailSize = sizeof(JSectHeader) + sizeof(JSectFooter);
-            const unsigned max = maxCompressedLength(uncompressed.len()) + headTailSize;
+            const unsigned max = maxCompressedLength(uncompressed.len()) + nChunks * frameHeaderSize + headTailSize;
             b.reset(max);
 
             {
@@ -693,11 +856,36 @@ namespace mongo {
                 b.appendStruct(h);
             }
 
-            size_t compressedLength = 0;
-            rawCompress(uncompressed.buf(), uncompressed.len(), b.cur(), &compressedLength);
-            assert( compressedLength < 0xffffffff );
-            assert( compressedLength < max );
-            b.skip(compressedLength);
+            {
+                static vector<CompressChunkTask> tasks; // static to reuse the scratch buffers; we are single threaded
+                tasks.resize(nChunks);
+                for( unsigned i = 0; i < nChunks; i++ ) {
+                    CompressChunkTask& t = tasks[i];
+                    t.src = uncompressed.buf() + (size_t) i * chunkSz;
+                    t.srcLen = min(chunkSz, uncompressed.len() - i * chunkSz);
+                    if( t.out.size() < maxCompressedLength(t.srcLen) )
+                        t.out.resize( maxCompressedLength(t.srcLen) );
+                    t.outLen = 0;
+                }
+                if( nChunks > 1 && effectiveCompressionWorkers() > 1 ) {
+                    ThreadPool& tp = compressionPool();
+                    for( unsigned i = 0; i < nChunks; i++ )
+                        tp.schedule(compressChunk, &tasks[i]);
+                    tp.join();
+                }
+                else {
+                    for( unsigned i = 0; i < nChunks; i++ )
+                        compressChunk(&tasks[i]);
+                }
+                for( unsigned i = 0; i < nChunks; i++ ) {
+                    CompressChunkTask& t = tasks[i];
+                    assert( t.outLen > 0 && t.outLen <= t.out.size() );
+                    b.appendNum((unsigned) t.outLen);
+                    b.appendNum((unsigned) t.srcLen);
+                    b.appendBuf(&t.out[0], t.outLen);
+                }
+                assert( b.len() < max );
+            }
 
             // footer
             unsigned L = 0xffffffff;
@@ -37,6 +37,10 @@ namespace mongo {
         /** assure journal/ dir exists. throws */
         void journalMakeDir();
 
+        /** true if the journal dir (see --journalPath) is on a different
+            device than the datafiles.  checked once in journalMakeDir(). */
+        bool journalOnSeparateDevice();
+
         /** check if time to rotate files; assure a file is open.
              done separately from the journal() call as we can do this part
              outside of lock.
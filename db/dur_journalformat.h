@@ -39,8 +39,12 @@ namespace mongo {
 #if defined(_NOCOMPRESS)
             enum { CurrentVersion = 0x4148 };
 #else
-            enum { CurrentVersion = 0x4149 };
+            enum { CurrentVersion = 0x414a };
 #endif
+            // 0x4149 sections are a single snappy blob; 0x414a sections are a sequence of
+            // independently compressed chunks (so the writer can compress them in parallel).
+            // we can still recover 0x4149 journals.
+            enum { VersionSingleCompressedBlob = 0x4149 };
             unsigned short _version;
 
             // these are just for diagnostic ease (make header more useful as plain text)
@@ -55,7 +59,13 @@ namespace mongo {
             char reserved3[8026]; // 8KB total for the file header
             char txt2[2];         // "\n\n" at the end
 
-            bool versionOk() const { return _version == CurrentVersion; }
+            bool versionOk() const {
+#if !defined(_NOCOMPRESS)
+                if( _version == VersionSingleCompressedBlob )
+                    return true;
+#endif
+                return _version == CurrentVersion;
+            }
             bool valid() const { return magic[0] == 'j' && txt2[1] == '\n' && fileId; }
         };
 
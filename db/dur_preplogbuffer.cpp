@@ -46,9 +46,13 @@ namespace mongo {
 
         RelativePath local = RelativePath::fromRelativePath("local");
 
+        /** @return the MongoMMF the write intent is into, or null if it is into an
+            ephemeral arena (--ephemeralDbs) and must not be journaled. */
         static MongoMMF* findMMF_inlock(void *ptr, size_t &ofs) {
             MongoMMF *f = privateViews.find_inlock(ptr, ofs);
             if( f == 0 ) {
+                if( ephemeralViews.find(ptr, ofs) )
+                    return 0;
                 error() << "findMMF_inlock failed " << privateViews.numberOfViews_inlock() << endl;
                 printStackTrace(); // we want a stack trace and the assert below didn't print a trace once in the real world - not sure why
                 stringstream ss;
@@ -62,6 +66,10 @@ namespace mongo {
         static void prepBasicWrite_inlock(AlignedBuilder&bb, const WriteIntent *i, RelativePath& lastDbPath) {
             size_t ofs = 1;
             MongoMMF *mmf = findMMF_inlock(i->start(), /*out*/ofs);
+            if( unlikely(mmf == 0) ) {
+                // ephemeral db write - the arena is the only view, nothing to journal or apply
+                return;
+            }
 
             if( unlikely(!mmf->willNeedRemap()) ) {
                 // tag this mmf as needed a remap of its private view later.
@@ -82,6 +90,7 @@ namespace mongo {
 
             JEntry e;
             e.len = min(i->length(), (unsigned)(mmf->length() - ofs)); //dont write past end of file
+            mmf->noteWritten(ofs, e.len); // so REMAPPRIVATEVIEW remaps only written chunks
             assert( ofs <= 0x80000000 );
             e.ofs = (unsigned) ofs;
             e.setFileNo( mmf->fileSuffixNo() );
@@ -152,6 +161,12 @@ namespace mongo {
                 writes._drained = true;
             }
 
+            // intents are fully drained at this point; track how much was declared so
+            // the declared/journaled ratio in serverStatus shows what dedup and tight
+            // intent ranges are saving
+            stats.curr->_writeIntents += commitJob.writes().size();
+            stats.curr->_declaredWriteBytes += commitJob.bytes();
+
             AlignedBuilder& bb = commitJob._ab;
             resetLogBuffer(h, bb); // adds JSectHeader
 
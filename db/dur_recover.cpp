@@ -28,6 +28,7 @@
 #include "../util/mongoutils/str.h"
 #include "../util/bufreader.h"
 #include "../util/concurrency/race.h"
+#include "../util/concurrency/thread_pool.h"
 #include "pdfile.h"
 #include "database.h"
 #include "db.h"
@@ -100,21 +101,40 @@ namespace mongo {
             const bool _doDurOps;
             string _uncompressed;
         public:
-            JournalSectionIterator(const JSectHeader& h, const void *compressed, unsigned compressedLen, bool doDurOpsRecovering) :
+            JournalSectionIterator(const JSectHeader& h, const void *compressed, unsigned compressedLen, bool doDurOpsRecovering, unsigned short fileVersion) :
                 _h(h),
                 _lastDbName(0)
                 , _doDurOps(doDurOpsRecovering)
             {
                 assert( doDurOpsRecovering );
-                bool ok = uncompress((const char *)compressed, compressedLen, &_uncompressed);
-                if( !ok ) { 
-                    // it should always be ok (i think?) as there is a previous check to see that the JSectFooter is ok
-                    log() << "couldn't uncompress journal section" << endl;
-                    msgasserted(15874, "couldn't uncompress journal section");
-                }
-                const char *p = _uncompressed.c_str();
                 assert( compressedLen == _h.sectionLen() - sizeof(JSectFooter) - sizeof(JSectHeader) );
-                _entries = auto_ptr<BufReader>( new BufReader(p, _uncompressed.size()) );
+                if( fileVersion == JHeader::VersionSingleCompressedBlob ) {
+                    // old format : the whole section is one snappy blob
+                    bool ok = uncompress((const char *)compressed, compressedLen, &_uncompressed);
+                    if( !ok ) {
+                        // it should always be ok (i think?) as there is a previous check to see that the JSectFooter is ok
+                        log() << "couldn't uncompress journal section" << endl;
+                        msgasserted(15874, "couldn't uncompress journal section");
+                    }
+                }
+                else {
+                    // current format : a sequence of independently compressed chunks, framed
+                    // { compressedLen, rawLen, <snappy bytes> }.  see Journal::journal().
+                    BufReader br(compressed, compressedLen);
+                    while( br.remaining() ) {
+                        unsigned clen, rlen;
+                        br.read(clen);
+                        br.read(rlen);
+                        const char *chunk = (const char *) br.skip(clen);
+                        string tmp;
+                        if( !uncompress(chunk, clen, &tmp) || tmp.size() != rlen ) {
+                            log() << "couldn't uncompress journal section chunk" << endl;
+                            msgasserted(16222, "couldn't uncompress journal section chunk");
+                        }
+                        _uncompressed += tmp;
+                    }
+                }
+                _entries = auto_ptr<BufReader>( new BufReader(_uncompressed.c_str(), _uncompressed.size()) );
             }
 
             // we work with the uncompressed buffer when doing a WRITETODATAFILES (for speed)
@@ -213,50 +233,65 @@ namespace mongo {
             _mmfs.clear();
         }
 
-        void RecoveryJob::write(const ParsedJournalEntry& entry) {
+        void RecoveryJob::write(const ParsedJournalEntry& entry, Last& last) {
             //TODO(mathias): look into making some of these dasserts
             assert(entry.e);
             assert(entry.dbName);
             assert(strnlen(entry.dbName, MaxDatabaseNameLen) < MaxDatabaseNameLen);
 
-            const string fn = fileName(entry.dbName, entry.e->getFileNo());
-            MongoFile* file;
-            {
-                MongoFileFinder finder; // must release lock before creating new MongoMMF
-                file = finder.findByPath(fn);
-            }
-
             MongoMMF* mmf;
-            if (file) {
-                assert(file->isMongoMMF());
-                mmf = (MongoMMF*)file;
+            if( entry.dbName == last.dbName && entry.e->getFileNo() == last.fileNo ) {
+                // common case: same file as the previous entry (entries are sorted)
+                mmf = last.mmf;
             }
             else {
-                if( !_recovering ) {
-                    log() << "journal error applying writes, file " << fn << " is not open" << endl;
-                    assert(false);
+                const string fn = fileName(entry.dbName, entry.e->getFileNo());
+                MongoFile* file;
+                {
+                    MongoFileFinder finder; // must release lock before creating new MongoMMF
+                    file = finder.findByPath(fn);
+                }
+
+                if (file) {
+                    assert(file->isMongoMMF());
+                    mmf = (MongoMMF*)file;
                 }
-                boost::shared_ptr<MongoMMF> sp (new MongoMMF);
-                assert(sp->open(fn, false));
-                _mmfs.push_back(sp);
-                mmf = sp.get();
+                else {
+                    if( !_recovering ) {
+                        log() << "journal error applying writes, file " << fn << " is not open" << endl;
+                        assert(false);
+                    }
+                    // applyBucket workers only race on the shared _mmfs list here : entries are
+                    // partitioned by file, so a given file is only ever opened by one worker
+                    static SimpleMutex m("recoverOpenMmf");
+                    SimpleMutex::scoped_lock lk(m);
+                    boost::shared_ptr<MongoMMF> sp (new MongoMMF);
+                    assert(sp->open(fn, false));
+                    _mmfs.push_back(sp);
+                    mmf = sp.get();
+                }
+
+                last.dbName = entry.dbName;
+                last.fileNo = entry.e->getFileNo();
+                last.mmf = mmf;
             }
 
             if ((entry.e->ofs + entry.e->len) <= mmf->length()) {
-                log() << "mmf=" << (void*) mmf << endl;
                 assert(mmf->view_write());
                 assert(entry.e->srcData());
 
                 void* dest = (char*)mmf->view_write() + entry.e->ofs;
                 memcpy(dest, entry.e->srcData(), entry.e->len);
                 stats.curr->_writeToDataFilesBytes += entry.e->len;
+                if( !_recovering )
+                    mmf->noteWrittenToShared(entry.e->ofs, entry.e->len); // for the trickle flusher
             }
             else {
                 massert(13622, "Trying to write past end of file in WRITETODATAFILES", _recovering);
             }
         }
 
-        void RecoveryJob::applyEntry(const ParsedJournalEntry& entry, bool apply, bool dump) {
+        void RecoveryJob::applyEntry(const ParsedJournalEntry& entry, bool apply, bool dump, Last& last) {
             if( entry.e ) {
                 if( dump ) {
                     stringstream ss;
@@ -270,11 +305,12 @@ namespace mongo {
                     log() << ss.str() << endl;
                 }
                 if( apply ) {
-                    write(entry);
+                    write(entry, last);
                 }
             }
             else if(entry.op) {
                 // a DurOp subclass operation
+                last.reset(); // ops can change the file set; don't trust the memoized mmf
                 if( dump ) {
                     log() << "  OP " << entry.op->toString() << endl;
                 }
@@ -287,14 +323,76 @@ namespace mongo {
             }
         }
 
+        static unsigned recoveryThreads() {
+            unsigned n = boost::thread::hardware_concurrency();
+            if( n == 0 )
+                n = 1;
+            return min(n, 8u);
+        }
+
+        /** all entries for a given data file must land in the same bucket so that their
+            relative order is preserved when buckets are applied concurrently. */
+        static unsigned recoveryPartition(const ParsedJournalEntry& e) {
+            unsigned h = 0;
+            for( const char *p = e.dbName; *p; p++ )
+                h = h * 131 + (unsigned char) *p;
+            return h * 131 + (unsigned) e.e->getFileNo();
+        }
+
+        void RecoveryJob::applyBucket(const vector<ParsedJournalEntry> *bucket, bool *failed) {
+            try {
+                Last last;
+                for( vector<ParsedJournalEntry>::const_iterator i = bucket->begin(); i != bucket->end(); ++i )
+                    write(*i, last);
+            }
+            catch( std::exception& e ) {
+                log() << "recover exception applying journal entries " << e.what() << endl;
+                *failed = true;
+            }
+        }
+
+        void RecoveryJob::flushBuckets(ThreadPool& tp, vector< vector<ParsedJournalEntry> >& buckets, bool& failed) {
+            for( unsigned i = 0; i < buckets.size(); i++ ) {
+                if( !buckets[i].empty() )
+                    tp.schedule(&RecoveryJob::applyBucket, this, (const vector<ParsedJournalEntry>*) &buckets[i], &failed);
+            }
+            tp.join(); // barrier - all writes for this run are on the private views before we continue
+            for( unsigned i = 0; i < buckets.size(); i++ )
+                buckets[i].clear();
+        }
+
         void RecoveryJob::applyEntries(const vector<ParsedJournalEntry> &entries) {
             bool apply = (cmdLine.durOptions & CmdLine::DurScanOnly) == 0;
             bool dump = cmdLine.durOptions & CmdLine::DurDumpJournal;
             if( dump )
                 log() << "BEGIN section" << endl;
 
-            for( vector<ParsedJournalEntry>::const_iterator i = entries.begin(); i != entries.end(); ++i ) {
-                applyEntry(*i, apply, dump);
+            const unsigned nThreads = recoveryThreads();
+            if( apply && !dump && _recovering && nThreads > 1 && entries.size() >= 128 ) {
+                // during recovery of a large journal, partition the basic writes by target
+                // data file and apply them on a worker pool.  DurOp entries (file creation,
+                // dropDatabase, ...) change the file set itself, so we drain the pool and
+                // replay them serially as barriers.
+                static ThreadPool tp((int) nThreads);
+                vector< vector<ParsedJournalEntry> > buckets(nThreads);
+                bool failed = false;
+                Last last;
+                for( vector<ParsedJournalEntry>::const_iterator i = entries.begin(); i != entries.end(); ++i ) {
+                    if( i->e )
+                        buckets[recoveryPartition(*i) % nThreads].push_back(*i);
+                    else {
+                        flushBuckets(tp, buckets, failed);
+                        applyEntry(*i, apply, dump, last);
+                    }
+                }
+                flushBuckets(tp, buckets, failed);
+                massert(16223, "exception applying journal entries during recovery", !failed);
+            }
+            else {
+                Last last;
+                for( vector<ParsedJournalEntry>::const_iterator i = entries.begin(); i != entries.end(); ++i ) {
+                    applyEntry(*i, apply, dump, last);
+                }
             }
 
             if( dump )
@@ -325,7 +423,7 @@ namespace mongo {
 
             auto_ptr<JournalSectionIterator> i;
             if( _recovering ) {
-                i = auto_ptr<JournalSectionIterator>(new JournalSectionIterator(*h, p, len, _recovering));
+                i = auto_ptr<JournalSectionIterator>(new JournalSectionIterator(*h, p, len, _recovering, _fileVersion));
             }
             else { 
                 i = auto_ptr<JournalSectionIterator>(new JournalSectionIterator(*h, /*after header*/p, /*w/out header*/len));
@@ -394,7 +492,8 @@ namespace mongo {
                         uasserted(13536, str::stream() << "journal version number mismatch " << h._version);
                     }
                     fileId = h.fileId;
-                    if(cmdLine.durOptions & CmdLine::DurDumpJournal) { 
+                    _fileVersion = h._version; // section format varies by file version - see JournalSectionIterator
+                    if(cmdLine.durOptions & CmdLine::DurDumpJournal) {
                         log() << "JHeader::fileId=" << fileId << endl;
                     }
                 }
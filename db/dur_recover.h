@@ -8,6 +8,7 @@
 
 namespace mongo {
     class MongoMMF;
+    namespace threadpool { class ThreadPool; }
 
     namespace dur {
         struct ParsedJournalEntry;
@@ -16,8 +17,8 @@ namespace mongo {
          */
         class RecoveryJob : boost::noncopyable {
         public:
-            RecoveryJob() : _lastDataSyncedFromLastRun(0), 
-                _mx("recovery"), _recovering(false) { _lastSeqMentionedInConsoleLog = 1; }
+            RecoveryJob() : _lastDataSyncedFromLastRun(0),
+                _mx("recovery"), _recovering(false), _fileVersion(JHeader::CurrentVersion) { _lastSeqMentionedInConsoleLog = 1; }
             void go(vector<path>& files);
             ~RecoveryJob();
 
@@ -28,8 +29,24 @@ namespace mongo {
 
             static RecoveryJob & get() { return _instance; }
         private:
-            void write(const ParsedJournalEntry& entry); // actually writes to the file
-            void applyEntry(const ParsedJournalEntry& entry, bool apply, bool dump);
+            /** memoizes the last dbName/fileNo -> MongoMMF resolution.  entries within a
+                section are sorted, so consecutive entries usually target the same data file
+                and we can skip the path build and file-map lookup.  dbName is compared by
+                pointer -- it points into the journal section, stable for its lifetime.
+                reset whenever the file set may have changed (DurOp entries).
+            */
+            class Last {
+            public:
+                Last() { reset(); }
+                void reset() { mmf = 0; dbName = 0; fileNo = -2; }
+                MongoMMF *mmf;
+                const char *dbName;
+                int fileNo;
+            };
+            void write(const ParsedJournalEntry& entry, Last& last); // actually writes to the file
+            void applyEntry(const ParsedJournalEntry& entry, bool apply, bool dump, Last& last);
+            void applyBucket(const vector<ParsedJournalEntry> *bucket, bool *failed);
+            void flushBuckets(threadpool::ThreadPool& tp, vector< vector<ParsedJournalEntry> >& buckets, bool& failed);
             void applyEntries(const vector<ParsedJournalEntry> &entries);
             bool processFileBuffer(const void *, unsigned len);
             bool processFile(path journalfile);
@@ -43,6 +60,7 @@ namespace mongo {
             mongo::mutex _mx; // protects _mmfs; see setNoJournal() too
         private:
             bool _recovering; // are we in recovery or WRITETODATAFILES
+            unsigned short _fileVersion; // JHeader._version of the journal file being recovered
 
             static RecoveryJob &_instance;
         };
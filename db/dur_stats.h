@@ -19,6 +19,8 @@ namespace mongo {
 
                 unsigned _commits;
                 unsigned _earlyCommits; // count of early commits from commitIfNeeded() or from getDur().commitNow()
+                unsigned long long _writeIntents;        // intents reaching PREPLOGBUFFER after dedup
+                unsigned long long _declaredWriteBytes;  // sum of intent lengths as declared
                 unsigned long long _journaledBytes;
                 unsigned long long _uncompressedBytes;
                 unsigned long long _writeToDataFilesBytes;
@@ -28,6 +30,15 @@ namespace mongo {
                 unsigned long long _writeToDataFilesMicros;
                 unsigned long long _remapPrivateViewMicros;
 
+                // per device breakdown: the journal device services
+                // WRITETOJOURNAL, the datafile device WRITETODATAFILES.  the
+                // max single write per interval shows which device is
+                // bounding commit latency when they are separate.
+                unsigned _journalWrites;
+                unsigned long long _journalMaxWriteMicros;
+                unsigned _dataFilesWrites;
+                unsigned long long _dataFilesMaxWriteMicros;
+
                 // undesirable to be in write lock for the group commit (it can be done in a read lock), so good if we
                 // have visibility when this happens.  can happen for a couple reasons
                 // - read lock starvation
@@ -35,6 +46,13 @@ namespace mongo {
                 // - data being written faster than the normal group commit interval
                 unsigned _commitsInWriteLock;
 
+                // group commit latency distribution.  buckets are
+                // <1ms, <10ms, <100ms, <1000ms, and the rest.
+                enum { NLatencyBuckets = 5 };
+                unsigned _commitLatencyBuckets[NLatencyBuckets];
+                unsigned long long _commitLatencyMicros;
+                void noteCommitLatencyMicros(unsigned long long micros);
+
                 unsigned _dtMillis;
             };
             S *curr;
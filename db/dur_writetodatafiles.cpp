@@ -87,6 +87,9 @@ namespace mongo {
             WRITETODATAFILES_Impl1(h, uncompressed);
             unsigned long long m = t.micros();
             stats.curr->_writeToDataFilesMicros += m;
+            stats.curr->_dataFilesWrites++;
+            if( m > stats.curr->_dataFilesMaxWriteMicros )
+                stats.curr->_dataFilesMaxWriteMicros = m;
             LOG(2) << "journal WRITETODATAFILES " << m / 1000.0 << "ms" << endl;
         }
 
@@ -21,19 +21,52 @@
 #include "extsort.h"
 #include "namespace-inl.h"
 #include "../util/file.h"
+#include "../util/memaccount.h"
+#include "../util/concurrency/thread_pool.h"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
 namespace mongo {
 
+    namespace {
+
+        int sortPoolSize() {
+            int n = boost::thread::hardware_concurrency();
+            if ( n < 1 )
+                n = 1;
+            if ( n > 4 )
+                n = 4;
+            return n;
+        }
+
+        /* comparator used for run sorts on pool threads.  MyCmp checks for interrupt,
+           which needs a Client, and pool threads have none - this one just compares.
+        */
+        class RunCmp {
+        public:
+            RunCmp( IndexInterface &i, const BSONObj &order ) : _i(i), _order( Ordering::make(order) ) {}
+            bool operator()( const BSONObjExternalSorter::Data &l, const BSONObjExternalSorter::Data &r ) const {
+                int x = _i.keyCompare( l.first, r.first, _order );
+                if ( x )
+                    return x < 0;
+                return l.second.compare( r.second ) < 0;
+            }
+        private:
+            IndexInterface& _i;
+            const Ordering _order;
+        };
+
+    }
+
     IndexInterface *BSONObjExternalSorter::extSortIdxInterface;
     Ordering BSONObjExternalSorter::extSortOrder( Ordering::make(BSONObj()) );
+    SimpleMutex BSONObjExternalSorter::_extSortMutex("extsort");
     unsigned long long BSONObjExternalSorter::_compares = 0;
 
     BSONObjExternalSorter::BSONObjExternalSorter( IndexInterface &i, const BSONObj & order , long maxFileSize )
         : _idxi(i), _order( order.getOwned() ) , _maxFilesize( maxFileSize ) ,
-          _arraySize(1000000), _cur(0), _curSizeSoFar(0), _sorted(0) {
+          _arraySize(1000000), _cur(0), _curSizeSoFar(0), _sorted(0), _errMutex("extsort error") {
 
         stringstream rootpath;
         rootpath << dbpath;
@@ -49,9 +82,15 @@ namespace mongo {
     }
 
     BSONObjExternalSorter::~BSONObjExternalSorter() {
+        if ( _pool ) {
+            // make sure no pool thread is still writing under _root before we delete it
+            _pool->join();
+        }
         if ( _cur ) {
             delete _cur;
             _cur = 0;
+            memaccount::noteBytes( memaccount::ExtSort , -_curSizeSoFar );
+            _curSizeSoFar = 0;
         }
         unsigned long removed = remove_all( _root );
         wassert( removed == 1 + _files.size() );
@@ -60,7 +99,9 @@ namespace mongo {
     void BSONObjExternalSorter::_sortInMem() {
         // extSortComp needs to use glbals
         // qsort_r only seems available on bsd, which is what i really want to use
-        dblock l;
+        // we can't take the db write lock here as some callers (scanandorder spills) hold
+        // a read lock, so a dedicated mutex guards the globals instead
+        SimpleMutex::scoped_lock lk(_extSortMutex);
         extSortIdxInterface = &_idxi;
         extSortOrder = Ordering::make(_order);
         _cur->sort( BSONObjExternalSorter::extSortComp );
@@ -86,6 +127,13 @@ namespace mongo {
             _cur = 0;
         }
 
+        if ( _pool ) {
+            // wait for the background run sorts before anyone opens an iterator
+            _pool->join();
+            SimpleMutex::scoped_lock lk(_errMutex);
+            uassert( 16229 , (string)"external sort failed: " + _sortError , _sortError.empty() );
+        }
+
         if ( _files.size() == 0 )
             return;
 
@@ -102,10 +150,15 @@ namespace mongo {
         d.first = o.getOwned();
         d.second = loc;
 
-        long size = o.objsize();
-        _curSizeSoFar += size + sizeof( DiskLoc ) + sizeof( BSONObj );
+        long size = o.objsize() + sizeof( DiskLoc ) + sizeof( BSONObj );
+        _curSizeSoFar += size;
+        memaccount::noteBytes( memaccount::ExtSort , size );
 
-        if (  _cur->hasSpace() == false ||  _curSizeSoFar > _maxFilesize ) {
+        // under global transient-memory pressure spill well before the
+        // per-sorter threshold; smaller runs mean more merge files but
+        // bounded resident size
+        if (  _cur->hasSpace() == false ||  _curSizeSoFar > _maxFilesize ||
+              ( _curSizeSoFar > _maxFilesize / 4 && memaccount::underPressure() ) ) {
             finishMap();
             log(1) << "finishing map" << endl;
         }
@@ -115,39 +168,68 @@ namespace mongo {
     void BSONObjExternalSorter::finishMap() {
         uassert( 10050 ,  "bad" , _cur );
 
+        long bytes = _curSizeSoFar;
         _curSizeSoFar = 0;
         if ( _cur->size() == 0 )
             return;
 
-        _sortInMem();
-
         stringstream ss;
         ss << _root.string() << "/file." << _files.size();
         string file = ss.str();
+        _files.push_back( file );
 
-        // todo: it may make sense to fadvise that this not be cached so that building the index doesn't 
-        //       eject other things the db is using from the file system cache.  while we will soon be reading 
-        //       this back, if it fit in ram, there wouldn't have been a need for an external sort in the first 
-        //       place.
-
-        ofstream out;
-        out.open( file.c_str() , ios_base::out | ios_base::binary );
-        assertStreamGood( 10051 ,  (string)"couldn't open file: " + file , out );
+        if ( !_pool ) {
+            _pool.reset( new threadpool::ThreadPool( sortPoolSize() ) );
+        }
 
-        int num = 0;
-        for ( InMemory::iterator i=_cur->begin(); i != _cur->end(); ++i ) {
-            Data p = *i;
-            out.write( p.first.objdata() , p.first.objsize() );
-            out.write( (char*)(&p.second) , sizeof( DiskLoc ) );
-            num++;
+        // hand the full run to a pool thread to sort and write while we keep producing
+        // keys.  bound the queue so a producer that outruns the sorts can't end up
+        // holding every run in memory at once.
+        while ( _pool->tasks_remaining() > sortPoolSize() + 1 ) {
+            sleepmillis( 2 );
         }
 
-        _cur->clear();
+        InMemory * run = _cur;
+        _cur = 0;
 
-        _files.push_back( file );
-        out.close();
+        log(2) << "queued run " << file << " with " << run->size() << " objects for external sort" << endl;
+
+        _pool->schedule( &BSONObjExternalSorter::_sortAndWriteRun , this , run , file , bytes );
+    }
 
-        log(2) << "Added file: " << file << " with " << num << "objects for external sort" << endl;
+    void BSONObjExternalSorter::_sortAndWriteRun( InMemory * run, string file, long bytes ) {
+        scoped_ptr<InMemory> cleanup( run );
+        try {
+            Data * data = &(*run)[0];
+            std::sort( data , data + run->size() , RunCmp( _idxi, _order ) );
+
+            // todo: it may make sense to fadvise that this not be cached so that building the index doesn't
+            //       eject other things the db is using from the file system cache.  while we will soon be reading
+            //       this back, if it fit in ram, there wouldn't have been a need for an external sort in the first
+            //       place.
+
+            ofstream out;
+            out.open( file.c_str() , ios_base::out | ios_base::binary );
+            assertStreamGood( 10051 ,  (string)"couldn't open file: " + file , out );
+
+            for ( InMemory::iterator i=run->begin(); i != run->end(); ++i ) {
+                Data p = *i;
+                out.write( p.first.objdata() , p.first.objsize() );
+                out.write( (char*)(&p.second) , sizeof( DiskLoc ) );
+            }
+
+            out.close();
+
+            log(2) << "wrote run " << file << endl;
+        }
+        catch ( const std::exception& e ) {
+            // the pool logs and swallows exceptions - record the first failure so
+            // sort() can rethrow it on the producing thread
+            SimpleMutex::scoped_lock lk(_errMutex);
+            if ( _sortError.empty() )
+                _sortError = e.what();
+        }
+        memaccount::noteBytes( memaccount::ExtSort , -bytes ); // cleanup frees the run either way
     }
 
     // ---------------------------------
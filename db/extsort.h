@@ -26,6 +26,10 @@
 
 namespace mongo {
 
+    namespace threadpool {
+        class ThreadPool;
+    }
+
     /**
        for external (disk) sorting by BSONObj and attaching a value
      */
@@ -60,9 +64,10 @@ namespace mongo {
 
         static IndexInterface *extSortIdxInterface;
         static Ordering extSortOrder;
+        static SimpleMutex _extSortMutex; // protects the above globals while qsorting
         static int extSortComp( const void *lv, const void *rv ) {
-            DEV RARELY {                 
-                dbMutex.assertWriteLocked(); // must be as we use a global var
+            DEV RARELY {
+                _extSortMutex.dassertLocked(); // must be as we use a global var
             }
             Data * l = (Data*)lv;
             Data * r = (Data*)rv;
@@ -134,6 +139,11 @@ namespace mongo {
         void sort( string file );
         void finishMap();
 
+        /** sorts one full run and writes it out.  runs on a pool thread so the caller
+            can keep producing keys; failures are recorded and rethrown from sort().
+            bytes is the accounted size of the run, released when it is freed. */
+        void _sortAndWriteRun( InMemory * run, string file, long bytes );
+
         BSONObj _order;
         long _maxFilesize;
         path _root;
@@ -145,6 +155,10 @@ namespace mongo {
         list<string> _files;
         bool _sorted;
 
+        scoped_ptr<threadpool::ThreadPool> _pool; // sorts and writes runs; created on first spill
+        SimpleMutex _errMutex;                    // guards _sortError
+        string _sortError;                        // first failure from a pool thread, if any
+
         static unsigned long long _compares;
     };
 }
@@ -827,8 +827,11 @@ namespace mongo {
 
         //// Immediate initialization of distance ////
 
+        // The document itself is loaded lazily by obj() - most candidates produced by a
+        // $near search are trimmed from the best-K set on approximate distance alone, and
+        // never need to fault in their record.
         GeoPoint( const GeoKeyNode& node, double distance, bool exact )
-            : _key( node._key ) , _loc( node.recordLoc ) , _o( node.recordLoc.obj() ), _distance( distance ), _exact( exact ), _dirty( false ) {
+            : _key( node._key ) , _loc( node.recordLoc ) , _distance( distance ), _exact( exact ), _dirty( false ) {
         }
 
         GeoPoint( const GeoPoint& pt, double distance, bool exact )
@@ -863,6 +866,8 @@ namespace mongo {
         }
 
         BSONObj obj() const {
+            if( _o.isEmpty() && ! _dirty && ! _loc.isNull() )
+                _o = _loc.obj();
             return _o;
         }
 
@@ -972,7 +977,7 @@ namespace mongo {
 
         BSONObj _key;
         DiskLoc _loc;
-        BSONObj _o;
+        mutable BSONObj _o; // may be filled in lazily by obj()
         BSONObj _pt;
 
         double _distance;
@@ -2019,7 +2024,15 @@ namespace mongo {
             lastPtIt--;
             _farthest = lastPtIt->distance() + 2 * _distError;
 
-            return _points.size() - prevSize;
+            int diff = _points.size() - prevSize;
+
+            // Keep the candidate set bounded no matter how the caller batches its
+            // expansion - without this, a dense region can accumulate a large number of
+            // points between trims.  processExtraPoints adjusts _found for what it drops.
+            if( _points.size() >= _max + GeoBrowse::maxPointsHeuristic )
+                processExtraPoints();
+
+            return diff;
 
         }
 
@@ -2142,6 +2155,11 @@ namespace mongo {
            // Part 1
            {
                do {
+                   // We can't yield the read lock mid-search (our candidate points and
+                   // btree positions aren't yield-safe), but we can at least notice a
+                   // killOp between rings rather than scanning to completion.
+                   killCurrentOp.checkForInterrupt();
+
                    long long f = found();
                    assert( f <= 0x7fffffff );
                    fillStack( maxPointsHeuristic, _numWanted - static_cast<int>(f) , true );
@@ -2208,6 +2226,7 @@ namespace mongo {
 
                 // Do regular search in the full region
                 do {
+                   killCurrentOp.checkForInterrupt();
                    fillStack( maxPointsHeuristic );
                    processExtraPoints();
                 }
@@ -2441,7 +2460,7 @@ namespace mongo {
         }
 
         virtual Record* _current() { assert(ok()); return _cur->_loc.rec(); }
-        virtual BSONObj current() { assert(ok()); return _cur->_o; }
+        virtual BSONObj current() { assert(ok()); return _cur->obj(); }
         virtual DiskLoc currLoc() { assert(ok()); return _cur->_loc; }
         virtual bool advance() {
             if( ok() ){
@@ -2957,7 +2976,7 @@ namespace mongo {
                     if( p._pt.couldBeArray() ) bb.append( "loc", BSONArray( p._pt ) );
                     else bb.append( "loc" , p._pt );
                 }
-                bb.append( "obj" , p._o );
+                bb.append( "obj" , p.obj() );
                 bb.done();
 
                 if ( arr.len() > BSONObjMaxUserSize ) {
@@ -0,0 +1,58 @@
+// hasher.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "hasher.h"
+#include "../util/md5.hpp"
+
+namespace mongo {
+
+    long long BSONElementHasher::hash64( const BSONElement &e, long long seed ) {
+        md5_state_t st;
+        md5_init( &st );
+        md5_append( &st, (const md5_byte_t*)&seed, sizeof(seed) );
+
+        int t = e.canonicalType();
+        md5_append( &st, (const md5_byte_t*)&t, sizeof(t) );
+
+        if ( e.isNumber() ) {
+            // 3, NumberLong(3) and 3.0 compare equal so they must hash equal.
+            // integral values hash their 64 bit form; everything else (fractional,
+            // out of long long range, nan) hashes the double's bits.
+            long long l = e.numberLong();
+            double d = e.numberDouble();
+            if ( (double)l == d ) {
+                md5_append( &st, (const md5_byte_t*)&l, sizeof(l) );
+            }
+            else {
+                md5_append( &st, (const md5_byte_t*)&d, sizeof(d) );
+            }
+        }
+        else {
+            md5_append( &st, (const md5_byte_t*)e.value(), e.valuesize() );
+        }
+
+        md5digest d;
+        md5_finish( &st, d );
+
+        long long out;
+        memcpy( &out, d, sizeof(out) );
+        return out;
+    }
+
+}
@@ -0,0 +1,152 @@
+// hasher.h
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "jsobj.h"
+
+namespace mongo {
+
+    /** hashing of BSONElement values, used by the "hashed" index type and intended
+        for hashed shard keys.  the hash is stored in indexes and will partition
+        chunks, so it must be stable across platforms and releases.
+    */
+    class BSONElementHasher : boost::noncopyable {
+    public:
+
+        /** @return a 64 bit hash of e's value - the field name is not included.
+            values that compare equal hash equally; in particular the numeric types
+            bridge, so 3, NumberLong(3) and 3.0 produce the same hash.
+        */
+        static long long hash64( const BSONElement &e, long long seed = 0 );
+
+    private:
+        BSONElementHasher(); // not instantiable
+    };
+
+    /* Cheap in-memory value hashes (FNV-1a), used by the hashed aggregation paths
+       (group, distinct).  Unlike BSONElementHasher these are never stored, so there
+       is no stability guarantee across releases - but they must agree with
+       woCompare equality: numeric types are normalized through double, and
+       embedded objects/arrays are hashed element by element rather than by raw
+       bytes, so { a : 1 } and { a : 1.0 } hash equally as they compare equally.
+       Collisions between unequal values are fine - callers fall back to a full
+       comparison on hash match.
+    */
+
+    inline unsigned long long bsonHashAppend( const void * data , int len , unsigned long long h ) {
+        const unsigned char * p = (const unsigned char *) data;
+        for ( int i = 0; i < len; i++ ) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    const unsigned long long bsonHashSeed = 14695981039346656037ULL;
+
+    /** hash of an element's value, ignoring its field name */
+    inline unsigned long long bsonElementValueHash( const BSONElement& e , unsigned long long h = bsonHashSeed ) {
+        int ct = e.canonicalType();
+        h = bsonHashAppend( &ct , sizeof( ct ) , h );
+        if ( e.isNumber() ) {
+            double d = e.number();
+            return bsonHashAppend( &d , sizeof( d ) , h );
+        }
+        if ( e.type() == Object || e.type() == Array ) {
+            BSONObjIterator i( e.embeddedObject() );
+            while ( i.more() ) {
+                BSONElement sub = i.next();
+                h = bsonHashAppend( sub.fieldName() , (int) strlen( sub.fieldName() ) + 1 , h );
+                h = bsonElementValueHash( sub , h );
+            }
+            return h;
+        }
+        return bsonHashAppend( e.value() , e.valuesize() , h );
+    }
+
+    /** hash of a whole object, field names included - matches woCompare equality */
+    inline unsigned long long bsonObjHash( const BSONObj& o , unsigned long long h = bsonHashSeed ) {
+        BSONObjIterator i( o );
+        while ( i.more() ) {
+            BSONElement e = i.next();
+            h = bsonHashAppend( e.fieldName() , (int) strlen( e.fieldName() ) + 1 , h );
+            h = bsonElementValueHash( e , h );
+        }
+        return h;
+    }
+
+    /* open addressing key -> group number table used by the hashed aggregation
+       paths (group, aggregate), replacing a std::map which paid a deep woCompare
+       per tree level for every document.  lookups hash the key once and only fall
+       back to woCompare on a hash match. */
+    class GroupKeyMap : boost::noncopyable {
+    public:
+        GroupKeyMap() : _slots( 1 << 8 ) , _used( 0 ) {}
+
+        /** group number for key, inserting a zero entry if absent - mirrors the
+            std::map::operator[] usage this replaces.  the reference is valid until
+            the next lookup. */
+        int& operator[]( const BSONObj& key ) {
+            unsigned long long h = bsonObjHash( key );
+            if ( ( _used + 1 ) * 3 > _slots.size() * 2 )
+                _grow();
+            Slot& s = _slots[ _find( key , h ) ];
+            if ( s.key.isEmpty() ) {
+                s.h = h;
+                s.key = key;
+                _used++;
+            }
+            return s.n;
+        }
+
+        size_t size() const { return _used; }
+
+    private:
+        struct Slot {
+            Slot() : h( 0 ) , n( 0 ) {}
+            unsigned long long h;
+            BSONObj key;
+            int n;
+        };
+
+        unsigned _find( const BSONObj& key , unsigned long long h ) const {
+            unsigned mask = _slots.size() - 1;
+            unsigned pos = (unsigned)( h & mask );
+            while ( ! _slots[pos].key.isEmpty() &&
+                    ( _slots[pos].h != h || _slots[pos].key.woCompare( key ) != 0 ) )
+                pos = ( pos + 1 ) & mask;
+            return pos;
+        }
+
+        void _grow() {
+            vector<Slot> old;
+            old.swap( _slots );
+            _slots.resize( old.size() * 2 );
+            for ( unsigned i = 0; i < old.size(); i++ ) {
+                if ( old[i].key.isEmpty() )
+                    continue;
+                _slots[ _find( old[i].key , old[i].h ) ] = old[i];
+            }
+        }
+
+        vector<Slot> _slots; // size is always a power of two
+        size_t _used;
+    };
+
+}
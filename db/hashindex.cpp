@@ -0,0 +1,148 @@
+// hashindex.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "namespace-inl.h"
+#include "jsobj.h"
+#include "index.h"
+#include "btree.h"
+#include "hasher.h"
+#include "pdfile.h"
+#include "curop-inl.h"
+
+/**
+ * "hashed" index plugin.  stores a 64 bit hash of a single field as the key, so
+ * monotonically increasing fields (ObjectIds, timestamps) spread over the whole
+ * tree instead of hammering the right edge.  usable for equality lookups only;
+ * the document matcher weeds out hash collisions.
+ */
+namespace mongo {
+
+    static const string HASHEDNAME = "hashed";
+
+    /* forwards to a btree cursor positioned on the hashed value.  reports an empty
+       indexKeyPattern and modifiedKeys so nothing upstream (covered projections,
+       key matchers) tries to interpret the stored hashes as field values.
+    */
+    class HashedCursor : public Cursor {
+    public:
+        HashedCursor( shared_ptr<Cursor> c ) : _c( c ) {}
+        virtual bool ok() { return _c->ok(); }
+        virtual Record* _current() { return _c->_current(); }
+        virtual BSONObj current() { return _c->current(); }
+        virtual DiskLoc currLoc() { return _c->currLoc(); }
+        virtual bool advance() { return _c->advance(); }
+        virtual BSONObj currKey() const { return _c->currKey(); }
+        virtual DiskLoc refLoc() { return _c->refLoc(); }
+        virtual void aboutToDeleteBucket( const DiskLoc &b ) { _c->aboutToDeleteBucket( b ); }
+        virtual BSONObj indexKeyPattern() { return BSONObj(); }
+        virtual bool supportGetMore() { return _c->supportGetMore(); }
+        virtual void noteLocation() { _c->noteLocation(); }
+        virtual void checkLocation() { _c->checkLocation(); }
+        virtual bool supportYields() { return _c->supportYields(); }
+        virtual bool prepareToYield() { return _c->prepareToYield(); }
+        virtual void recoverFromYield() { _c->recoverFromYield(); }
+        virtual string toString() { return "HashedCursor"; }
+        virtual bool getsetdup( DiskLoc loc ) { return _c->getsetdup( loc ); }
+        virtual bool isMultiKey() const { return _c->isMultiKey(); }
+        virtual bool modifiedKeys() const { return true; }
+        virtual BSONObj prettyIndexBounds() const { return _c->prettyIndexBounds(); }
+        virtual long long nscanned() { return _c->nscanned(); }
+        virtual CoveredIndexMatcher* matcher() const { return _matcher.get(); }
+        virtual shared_ptr<CoveredIndexMatcher> matcherPtr() const { return _matcher; }
+        virtual void setMatcher( shared_ptr<CoveredIndexMatcher> matcher ) { _matcher = matcher; }
+    private:
+        shared_ptr<Cursor> _c;
+        shared_ptr<CoveredIndexMatcher> _matcher;
+    };
+
+    class HashedIndexType : public IndexType {
+    public:
+
+        HashedIndexType( const IndexPlugin *plugin, const IndexSpec *spec )
+            : IndexType( plugin, spec ) {
+
+            BSONObjIterator i( spec->keyPattern );
+            BSONElement e = i.next();
+            uassert( 16225, "hashed index currently supports exactly one field", !e.eoo() && !i.more() );
+            _field = e.fieldName();
+
+            // optionally tweakable so tests can exercise collision handling
+            _seed = spec->info["seed"].numberLong();
+
+            uassert( 16226, "hashed indexes cannot guarantee uniqueness, do not use the unique flag",
+                     !spec->info["unique"].trueValue() );
+        }
+
+        void getKeys( const BSONObj &obj, BSONObjSet &keys ) const {
+            BSONElement e = obj.getFieldDotted( _field );
+            uassert( 16227, "hashed indexes do not support array values", e.type() != Array );
+            if ( e.eoo() )
+                e = _spec->missingField();
+            BSONObjBuilder b;
+            b.append( "", BSONElementHasher::hash64( e, _seed ) );
+            keys.insert( b.obj() );
+        }
+
+        shared_ptr<Cursor> newCursor( const BSONObj &query, const BSONObj &order, int numWanted ) const {
+            BSONElement e = query[_field];
+            massert( 16228, "hashed index can only be used for equality queries",
+                     equalityQueryElement( e ) );
+
+            BSONObjBuilder b;
+            b.append( "", BSONElementHasher::hash64( e, _seed ) );
+            BSONObj key = b.obj();
+
+            NamespaceDetails *d = nsdetails( _spec->getDetails()->parentNS().c_str() );
+            shared_ptr<Cursor> bc( BtreeCursor::make( d, *_spec->getDetails(), key, key, true, 1 ) );
+            return shared_ptr<Cursor>( new HashedCursor( bc ) );
+        }
+
+        virtual IndexSuitability suitability( const BSONObj &query, const BSONObj &order ) const {
+            if ( !order.isEmpty() )
+                return USELESS; // hash order means nothing to callers
+            if ( !equalityQueryElement( query[_field] ) )
+                return USELESS; // ranges and other operators cannot use a hash
+            return HELPFUL;
+        }
+
+    private:
+
+        static bool equalityQueryElement( const BSONElement &e ) {
+            if ( e.eoo() || e.type() == Array || e.type() == RegEx )
+                return false;
+            if ( e.type() == Object && e.embeddedObject().firstElementFieldName()[0] == '$' )
+                return false;
+            return true;
+        }
+
+        string _field;
+        long long _seed;
+    };
+
+    class HashedIndexPlugin : public IndexPlugin {
+    public:
+        HashedIndexPlugin() : IndexPlugin( HASHEDNAME ) {}
+
+        virtual IndexType* generate( const IndexSpec *spec ) const {
+            return new HashedIndexType( this, spec );
+        }
+
+    } hashedIndexPlugin;
+
+}
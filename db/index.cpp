@@ -73,15 +73,35 @@ namespace mongo {
             return thisLoc.btree<V>()->locate(idx, thisLoc, key, order, pos, found, recordLoc, direction);
         }
         */
-        virtual long long fullValidate(const DiskLoc& thisLoc, const BSONObj &order) { 
+        virtual long long fullValidate(const DiskLoc& thisLoc, const BSONObj &order) {
             return thisLoc.btree<V>()->fullValidate(thisLoc, order);
         }
+        virtual long long rangeCount(const DiskLoc& thisLoc, const Ordering& order,
+                                     const BSONObj& lo, bool loInclusive,
+                                     const BSONObj& hi, bool hiInclusive) {
+            KeyOwned l(lo);
+            KeyOwned h(hi);
+            return thisLoc.btree<V>()->rangeCount(thisLoc, order, l, loInclusive, h, hiInclusive);
+        }
+        virtual bool keyAtApproxQuantile(const DiskLoc& thisLoc, const Ordering& order,
+                                         const BSONObj& lo, const BSONObj& hi,
+                                         double f, BSONObj& result) {
+            KeyOwned l(lo);
+            KeyOwned h(hi);
+            return thisLoc.btree<V>()->keyAtApproxQuantile(thisLoc, order, l, h, f, result);
+        }
         virtual DiskLoc findSingle(const IndexDetails &indexdetails , const DiskLoc& thisLoc, const BSONObj& key) const { 
             return thisLoc.btree<V>()->findSingle(indexdetails,thisLoc,key);
         } 
         virtual bool unindex(const DiskLoc thisLoc, IndexDetails& id, const BSONObj& key, const DiskLoc recordLoc) const {
             return thisLoc.btree<V>()->unindex(thisLoc, id, key, recordLoc);
         }
+        virtual void findUnderfullBuckets(const DiskLoc& head, vector<DiskLoc>& candidates) const {
+            BtreeBucket<V>::findUnderfullBuckets(head, candidates);
+        }
+        virtual bool rebalanceBucket(const DiskLoc& loc, IndexDetails& id, const Ordering& order) const {
+            return BtreeBucket<V>::rebalanceBucket(loc, id, order);
+        }
         virtual int bt_insert(const DiskLoc thisLoc, const DiskLoc recordLoc,
                       const BSONObj& key, const Ordering &order, bool dupsAllowed,
                       IndexDetails& idx, bool toplevel = true) const {
@@ -231,8 +251,8 @@ namespace mongo {
         }
     }
 
-    void IndexDetails::getKeysFromObject( const BSONObj& obj, BSONObjSet& keys) const {
-        getSpec().getKeys( obj, keys );
+    void IndexDetails::getKeysFromObject( const BSONObj& obj, BSONObjSet& keys, BSONObjFieldIndex *docIndex ) const {
+        getSpec().getKeys( obj, keys, docIndex );
     }
 
     void setDifference(BSONObjSet &l, BSONObjSet &r, vector<BSONObj*> &diff) {
@@ -256,12 +276,16 @@ namespace mongo {
     void getIndexChanges(vector<IndexChanges>& v, NamespaceDetails& d, BSONObj newObj, BSONObj oldObj, bool &changedId) {
         int z = d.nIndexesBeingBuilt();
         v.resize(z);
+        // the same two documents feed every index; share one field table per document
+        // so their top levels are only walked and sorted once (tables build lazily)
+        BSONObjFieldIndex oldIndex( oldObj );
+        BSONObjFieldIndex newIndex( newObj );
         for( int i = 0; i < z; i++ ) {
             IndexDetails& idx = d.idx(i);
             BSONObj idxKey = idx.info.obj().getObjectField("key"); // eg { ts : 1 }
             IndexChanges& ch = v[i];
-            idx.getKeysFromObject(oldObj, ch.oldkeys);
-            idx.getKeysFromObject(newObj, ch.newkeys);
+            idx.getKeysFromObject(oldObj, ch.oldkeys, z > 1 ? &oldIndex : 0);
+            idx.getKeysFromObject(newObj, ch.newkeys, z > 1 ? &newIndex : 0);
             if( ch.newkeys.size() > 1 )
                 d.setIndexIsMultikey(i);
             setDifference(ch.oldkeys, ch.newkeys, ch.removed);
@@ -39,8 +39,21 @@ namespace mongo {
 
         virtual int keyCompare(const BSONObj& l,const BSONObj& r, const Ordering &ordering) = 0;
         virtual long long fullValidate(const DiskLoc& thisLoc, const BSONObj &order) = 0;
+        /** count the used keys between lo and hi without materializing a cursor.
+            bounds are whole index keys (field names ignored); lo must not sort
+            after hi in 'order'.  see BtreeBucket::rangeCount(). */
+        virtual long long rangeCount(const DiskLoc& thisLoc, const Ordering& order,
+                                     const BSONObj& lo, bool loInclusive,
+                                     const BSONObj& hi, bool hiInclusive) = 0;
+        /** approximate the key at fraction f of the keys in [lo, hi) by
+            descending on bucket key counts.  see BtreeBucket::keyAtApproxQuantile(). */
+        virtual bool keyAtApproxQuantile(const DiskLoc& thisLoc, const Ordering& order,
+                                         const BSONObj& lo, const BSONObj& hi,
+                                         double f, BSONObj& result) = 0;
         virtual DiskLoc findSingle(const IndexDetails &indexdetails , const DiskLoc& thisLoc, const BSONObj& key) const = 0;
         virtual bool unindex(const DiskLoc thisLoc, IndexDetails& id, const BSONObj& key, const DiskLoc recordLoc) const = 0;
+        virtual void findUnderfullBuckets(const DiskLoc& head, vector<DiskLoc>& candidates) const = 0;
+        virtual bool rebalanceBucket(const DiskLoc& loc, IndexDetails& id, const Ordering& order) const = 0;
         virtual int bt_insert(const DiskLoc thisLoc, const DiskLoc recordLoc,
             const BSONObj& key, const Ordering &order, bool dupsAllowed,
             IndexDetails& idx, bool toplevel = true) const = 0;
@@ -99,8 +112,10 @@ namespace mongo {
            can index them.  Note that the set is multiple elements
            only when it's a "multikey" array.
            keys will be left empty if key not found in the object.
+           docIndex, when supplied, is a field table for obj the caller built
+           once and is sharing across all the collection's indexes.
         */
-        void getKeysFromObject( const BSONObj& obj, BSONObjSet& keys) const;
+        void getKeysFromObject( const BSONObj& obj, BSONObjSet& keys, BSONObjFieldIndex *docIndex = 0 ) const;
 
         /* get the key pattern for this object.
            e.g., { lastname:1, firstname:1 }
@@ -179,6 +194,21 @@ namespace mongo {
                    isIdIndex();
         }
 
+        /** percent of a splitting bucket kept on the left when the insert is at the right
+            edge (mostly ascending keys).  set with { fillFactor : <50..99> } in the index
+            info; defaults to the traditional 90.  lower it when ascending inserts get
+            backfilled later, so right edge splits leave room and interior buckets don't
+            end up half empty. */
+        int splitFillFactor() const {
+            BSONElement e = info.obj()["fillFactor"];
+            if ( e.isNumber() ) {
+                int f = e.numberInt();
+                if ( f >= 50 && f <= 99 )
+                    return f;
+            }
+            return 90;
+        }
+
         /** return true if dropDups was set when building index (if any duplicates, dropdups drops the duplicating objects) */
         bool dropDups() const {
             return info.obj().getBoolField( "dropDups" );
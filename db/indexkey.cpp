@@ -20,6 +20,7 @@
 #include "namespace-inl.h"
 #include "index.h"
 #include "btree.h"
+#include "matcher.h"
 #include "ops/query.h"
 #include "background.h"
 #include "../util/text.h"
@@ -81,6 +82,21 @@ namespace mongo {
         _sparse = info["sparse"].trueValue();
         uassert( 13529 , "sparse only works for single field keys" , ! _sparse || _nFields );
 
+        {
+            // partial index?
+            BSONElement f = info["filter"];
+            if ( f.eoo() ) {
+                _filter = BSONObj();
+                _filterMatcher.reset();
+            }
+            else {
+                uassert( 16251 , "index filter must be an object" , f.type() == Object );
+                _filter = f.embeddedObject().getOwned();
+                uassert( 16252 , "index filter cannot be empty" , ! _filter.isEmpty() );
+                _filterMatcher.reset( new Matcher( _filter ) );
+            }
+        }
+
 
         {
             // build _nullKey
@@ -127,6 +143,8 @@ namespace mongo {
             }
         }
 
+        uassert( 16253 , "index filter cannot be used with a special index type" , _filter.isEmpty() || ! _indexType.get() );
+
         _finishedInit = true;
     }
 
@@ -135,34 +153,85 @@ namespace mongo {
         ss << "cannot index parallel arrays [" << first << "] [" << second << "]";
         uasserted( ParallelArraysCode ,  ss.str() );
     }
-    
+
+    /** per-array dedup pre-filter for multikey expansion.  a byte-identical
+        array element (same type and value bytes; the field name is just the
+        array position) necessarily expands to identical keys, so it can be
+        skipped before any key objects are built and set-compared.  a cheap
+        hash over the value prefilters; only hash collisions pay a byte
+        compare.  values that are equal without being byte-identical (1 vs
+        1.0) fall through and are still deduped by the BSONObjSet as before.
+        tracking is capped so a huge array of distinct values spills back to
+        plain set dedup instead of growing this table without bound. */
+    class ArrayElementDedup : boost::noncopyable {
+    public:
+        enum { MaxTracked = 1024 };
+
+        /** @return true if a byte-identical element was already seen.
+            elements arriving after the cap is reached always return false. */
+        bool seen( const BSONElement &e ) {
+            unsigned h = (unsigned)e.type();
+            const char *p = e.value();
+            for( int n = e.valuesize(); n > 0; n--, p++ )
+                h = h * 131 + (unsigned char)*p;
+
+            for( multimap<unsigned,BSONElement>::const_iterator i = _seen.lower_bound( h );
+                 i != _seen.end() && i->first == h; ++i ) {
+                const BSONElement &o = i->second;
+                if ( o.type() == e.type() && o.valuesize() == e.valuesize() &&
+                     memcmp( o.value(), e.value(), e.valuesize() ) == 0 )
+                    return true;
+            }
+            if ( _seen.size() < MaxTracked )
+                _seen.insert( make_pair( h, e ) );
+            return false;
+        }
+
+    private:
+        multimap<unsigned,BSONElement> _seen; // value hash -> elements (in the caller's buffer)
+    };
+
+
     class KeyGeneratorV0 {
     public:
         KeyGeneratorV0( const IndexSpec &spec ) : _spec( spec ) {}
         
-        void getKeys( const BSONObj &obj, BSONObjSet &keys ) const {
+        void getKeys( const BSONObj &obj, BSONObjSet &keys, BSONObjFieldIndex *docIndex = 0 ) const {
             if ( _spec._indexType.get() ) { //plugin (eg geo)
                 _spec._indexType->getKeys( obj , keys );
                 return;
             }
             vector<const char*> fieldNames( _spec._fieldNames );
             vector<BSONElement> fixed( _spec._fixed );
-            _getKeys( fieldNames , fixed , obj, keys );
+            _getKeys( fieldNames , fixed , obj, keys, docIndex );
             if ( keys.empty() && ! _spec._sparse )
                 keys.insert( _spec._nullKey );
         }
-        
+
     private:
-        void _getKeys( vector<const char*> fieldNames , vector<BSONElement> fixed , const BSONObj &obj, BSONObjSet &keys ) const {
+        void _getKeys( vector<const char*> fieldNames , vector<BSONElement> fixed , const BSONObj &obj, BSONObjSet &keys, BSONObjFieldIndex *docIndex = 0 ) const {
             BSONElement arrElt;
             unsigned arrIdx = ~0;
             int numNotFound = 0;
-            
+
+            // a compound key resolves several field names against the same
+            // document; index it once instead of rescanning per field.  the
+            // caller may hand in a table it already built for this document and
+            // is sharing across all the collection's indexes - use that
+            // unconditionally, the build cost is already sunk.
+            BSONObjFieldIndex localIndex( obj );
+            BSONObjFieldIndex *objIndex = docIndex ? docIndex : &localIndex;
+            bool useIndex = docIndex || fieldNames.size() > 1;
+
             for( unsigned i = 0; i < fieldNames.size(); ++i ) {
                 if ( *fieldNames[ i ] == '\0' )
                     continue;
-                
-                BSONElement e = obj.getFieldDottedOrArray( fieldNames[ i ] );
+
+                BSONElement e;
+                if ( useIndex )
+                    e = objIndex->getFieldDottedOrArray( fieldNames[ i ] );
+                else
+                    e = obj.getFieldDottedOrArray( fieldNames[ i ] );
                 
                 if ( e.eoo() ) {
                     e = _spec._nullElt; // no matching field
@@ -214,11 +283,15 @@ namespace mongo {
                     // terminal array element to expand, so generate all keys
                     BSONObjIterator i( arrElt.embeddedObject() );
                     if ( i.more() ) {
+                        ArrayElementDedup dedup;
                         while( i.more() ) {
+                            BSONElement arrEl = i.next();
+                            if ( dedup.seen( arrEl ) )
+                                continue;
                             BSONObjBuilder b(_spec._sizeTracker);
                             for( unsigned j = 0; j < fixed.size(); ++j ) {
                                 if ( j == arrIdx )
-                                    b.appendAs( i.next(), "" );
+                                    b.appendAs( arrEl, "" );
                                 else
                                     b.appendAs( fixed[ j ], "" );
                             }
@@ -235,9 +308,10 @@ namespace mongo {
                 assert( !arrElt.eoo() );
                 BSONObjIterator i( arrElt.embeddedObject() );
                 if ( i.more() ) {
+                    ArrayElementDedup dedup;
                     while( i.more() ) {
                         BSONElement e = i.next();
-                        if ( e.type() == Object ) {
+                        if ( e.type() == Object && !dedup.seen( e ) ) {
                             _getKeys( fieldNames, fixed, e.embeddedObject(), keys );
                         }
                     }
@@ -273,26 +347,27 @@ namespace mongo {
     public:
         KeyGeneratorV1( const IndexSpec &spec ) : _spec( spec ) {}
         
-        void getKeys( const BSONObj &obj, BSONObjSet &keys ) const {
+        void getKeys( const BSONObj &obj, BSONObjSet &keys, BSONObjFieldIndex *docIndex = 0 ) const {
             if ( _spec._indexType.get() ) { //plugin (eg geo)
                 _spec._indexType->getKeys( obj , keys );
                 return;
             }
             vector<const char*> fieldNames( _spec._fieldNames );
             vector<BSONElement> fixed( _spec._fixed );
-            _getKeys( fieldNames , fixed , obj, keys );
+            _getKeys( fieldNames , fixed , obj, keys, 0, BSONObj(), docIndex );
             if ( keys.empty() && ! _spec._sparse )
                 keys.insert( _spec._nullKey );
-        }     
+        }
         
     private:
         /**
          * @param arrayNestedArray - set if the returned element is an array nested directly within arr.
          */
-        BSONElement extractNextElement( const BSONObj &obj, const BSONObj &arr, const char *&field, bool &arrayNestedArray ) const {
-            string firstField = mongoutils::str::before( field, '.' );
-            bool haveObjField = !obj.getField( firstField ).eoo();
-            BSONElement arrField = arr.getField( firstField );
+        BSONElement extractNextElement( BSONObjFieldIndex &objIndex, const BSONObj &arr, BSONObjFieldIndex &arrIndex, const char *&field, bool &arrayNestedArray ) const {
+            const char *dot = strchr( field, '.' );
+            StringData firstField( field, dot ? (unsigned)( dot - field ) : (unsigned)strlen( field ) );
+            bool haveObjField = !objIndex.getField( firstField ).eoo();
+            BSONElement arrField = arrIndex.getField( firstField );
             bool haveArrField = !arrField.eoo();
 
             // An index component field name cannot exist in both a document array and one of that array's children.
@@ -300,13 +375,13 @@ namespace mongo {
 
             arrayNestedArray = false;
 			if ( haveObjField ) {
-                return obj.getFieldDottedOrArray( field );
+                return objIndex.getFieldDottedOrArray( field );
             }
             else if ( haveArrField ) {
                 if ( arrField.type() == Array ) {
                     arrayNestedArray = true;
                 }
-                return arr.getFieldDottedOrArray( field );
+                return arrIndex.getFieldDottedOrArray( field );
             }
             return BSONElement();
         }
@@ -330,19 +405,29 @@ namespace mongo {
          * @param numNotFound - number of index fields that have already been identified as missing
          * @param array - array from which keys should be extracted, based on names in fieldNames
          *        If obj and array are both nonempty, obj will be one of the elements of array.
-         */        
-        void _getKeys( vector<const char*> fieldNames , vector<BSONElement> fixed , const BSONObj &obj, BSONObjSet &keys, int numNotFound = 0, const BSONObj &array = BSONObj() ) const {
+         * @param docIndex - at the top level only, a field table for obj that the caller may
+         *        be sharing across all the collection's indexes; recursive calls always build
+         *        their own since they descend into different subobjects.
+         */
+        void _getKeys( vector<const char*> fieldNames , vector<BSONElement> fixed , const BSONObj &obj, BSONObjSet &keys, int numNotFound = 0, const BSONObj &array = BSONObj(), BSONObjFieldIndex *docIndex = 0 ) const {
             BSONElement arrElt;
             set<unsigned> arrIdxs;
             bool mayExpandArrayUnembedded = true;
+
+            // every field name is resolved against the same obj/array pair;
+            // index each once (lazily) instead of rescanning per lookup
+            BSONObjFieldIndex localObjIndex( obj );
+            BSONObjFieldIndex &objIndex = docIndex ? *docIndex : localObjIndex;
+            BSONObjFieldIndex arrIndex( array );
+
             for( unsigned i = 0; i < fieldNames.size(); ++i ) {
                 if ( *fieldNames[ i ] == '\0' ) {
                     continue;
                 }
-                
+
                 bool arrayNestedArray;
                 // Extract element matching fieldName[ i ] from object xor array.
-                BSONElement e = extractNextElement( obj, array, fieldNames[ i ], arrayNestedArray );
+                BSONElement e = extractNextElement( objIndex, array, arrIndex, fieldNames[ i ], arrayNestedArray );
                 
                 if ( e.eoo() ) {
                     // if field not present, set to null
@@ -390,8 +475,12 @@ namespace mongo {
                 // Non empty array that can be expanded, so generate a key for each member.
                 BSONObj arrObj = arrElt.embeddedObject();
                 BSONObjIterator i( arrObj );
+                ArrayElementDedup dedup;
                 while( i.more() ) {
-                    _getKeysArrEltFixed( fieldNames, fixed, i.next(), keys, numNotFound, arrElt, arrIdxs, mayExpandArrayUnembedded );
+                    BSONElement arrEntry = i.next();
+                    if ( dedup.seen( arrEntry ) )
+                        continue;
+                    _getKeysArrEltFixed( fieldNames, fixed, arrEntry, keys, numNotFound, arrElt, arrIdxs, mayExpandArrayUnembedded );
                 }
             }
         }
@@ -399,16 +488,22 @@ namespace mongo {
         const IndexSpec &_spec;
     };
     
-    void IndexSpec::getKeys( const BSONObj &obj, BSONObjSet &keys ) const {
+    void IndexSpec::getKeys( const BSONObj &obj, BSONObjSet &keys, BSONObjFieldIndex *docIndex ) const {
+        if ( _filterMatcher && ! _filterMatcher->matches( obj ) ) {
+            // partial index and the document fails the filter, so it gets no keys at all.
+            // initial build, insert, delete and the update key diff all funnel through here,
+            // which keeps them consistent with each other.
+            return;
+        }
         switch( indexVersion() ) {
             case 0: {
                 KeyGeneratorV0 g( *this );
-                g.getKeys( obj, keys );
+                g.getKeys( obj, keys, docIndex );
                 break;
             }
             case 1: {
                 KeyGeneratorV1 g( *this );
-                g.getKeys( obj, keys );
+                g.getKeys( obj, keys, docIndex );
                 break;
             }
             default:
@@ -438,6 +533,19 @@ namespace mongo {
     }
 
     IndexSuitability IndexSpec::_suitability( const BSONObj& query , const BSONObj& order ) const {
+        if ( ! _filter.isEmpty() ) {
+            // partial index - only usable when the query provably implies the filter;
+            // otherwise the index is missing documents the query may need.  we are
+            // conservative: every top level filter element must appear verbatim in the
+            // query (e.g. filter {closed:false} and query {closed:false,user:u}).
+            BSONObjIterator i( _filter );
+            while( i.more() ) {
+                BSONElement e = i.next();
+                BSONElement q = query.getField( e.fieldName() );
+                if ( q.eoo() || q.woCompare( e , false ) != 0 )
+                    return USELESS;
+            }
+        }
         // TODO: optimize
         if ( anyElementNamesMatch( keyPattern , query ) == 0 && anyElementNamesMatch( keyPattern , order ) == 0 )
             return USELESS;
@@ -30,6 +30,7 @@ namespace mongo {
     const int ParallelArraysCode = 10088;
     
     class Cursor;
+    class Matcher;
     class IndexSpec;
     class IndexType; // TODO: this name sucks
     class IndexPlugin;
@@ -143,7 +144,11 @@ namespace mongo {
         void reset( const DiskLoc& infoLoc ) { reset(infoLoc.obj()); }
         void reset( const IndexDetails * details );
 
-        void getKeys( const BSONObj &obj, BSONObjSet &keys ) const;
+        /** generate the index keys for obj.  docIndex, when supplied, is a field
+            table for obj that the caller built once and is sharing across all the
+            collection's indexes, so the document's top level is only walked and
+            sorted a single time per operation (see BSONObjFieldIndex). */
+        void getKeys( const BSONObj &obj, BSONObjSet &keys, BSONObjFieldIndex *docIndex = 0 ) const;
 
         BSONElement missingField() const { return _nullElt; }
 
@@ -182,6 +187,8 @@ namespace mongo {
 
         int _nFields; // number of fields in the index
         bool _sparse; // if the index is sparse
+        BSONObj _filter; // nonempty -> partial index : only documents matching this are indexed
+        shared_ptr<Matcher> _filterMatcher; // matcher for _filter, set iff _filter is nonempty
         shared_ptr<IndexType> _indexType;
         const IndexDetails * _details;
 
@@ -24,12 +24,14 @@
 #include "dbmessage.h"
 #include "instance.h"
 #include "lasterror.h"
+#include "admission.h"
 #include "security.h"
 #include "json.h"
 #include "replutil.h"
 #include "../s/d_logic.h"
 #include "../util/file_allocator.h"
 #include "../util/goodies.h"
+#include "../util/optrace.h"
 #include "cmdline.h"
 #if !defined(_WIN32)
 #include <sys/file.h>
@@ -41,6 +43,7 @@
 #include "ops/update.h"
 #include "ops/delete.h"
 #include "ops/query.h"
+#include "tailnotify.h"
 #include "d_concurrency.h"
 
 namespace mongo {
@@ -63,6 +66,7 @@ namespace mongo {
 
     bool useCursors = true;
     bool useHints = true;
+    bool getMoreReadAhead = false; // --getMoreReadAhead
 
     KillCurrentOp killCurrentOp;
 
@@ -111,6 +115,10 @@ namespace mongo {
                 b.append("fsyncLock", x);
                 b.append("info", "use db.fsyncUnlock() to terminate the fsync write/snapshot lock");
             }
+            vector<string> frozen;
+            databaseFreezer.listFrozen( frozen );
+            if( !frozen.empty() )
+                b.append("frozenDatabases", frozen);
         }
 
         replyToQuery(0, m, dbresponse, b.obj());
@@ -247,6 +255,10 @@ namespace mongo {
     // Returns false when request includes 'end'
     void assembleResponse( Message &m, DbResponse &dbresponse, const HostAndPort& remote ) {
 
+        // the outermost scope recycles the op scratch arena; nested calls
+        // (DBDirectClient) keep their caller's scratch alive
+        OpArena::Scope arenaScope( cc().opArena() );
+
         // before we lock...
         int op = m.operation();
         bool isCommand = false;
@@ -300,6 +312,32 @@ namespace mongo {
         int logThreshold = cmdLine.slowMS;
         bool log = logLevel >= 1;
 
+        // admission control: take a per-class concurrency slot before any lock
+        // acquisition so an overload of batch scans queues (and then sheds)
+        // without starving interactive point reads.  nested (DBDirectClient)
+        // ops ride on their caller's slot; commands and killcursors are exempt
+        // so diagnosis still works on an overloaded node.
+        AdmissionController::Ticket admissionTicket;
+        if ( ! nestedOp.get() && ! isCommand &&
+             ( op == dbQuery || op == dbGetMore || op == dbInsert || op == dbUpdate || op == dbDelete ) ) {
+            AdmissionClass cls = c.admissionClass();
+            if ( strncmp( ns , "local." , 6 ) == 0 )
+                cls = Admission_System;  // oplog reads from secondaries; shedding them just breaks replication
+            if ( ! admissionTicket.admit( cls ) ) {
+                const char * msg = "op shed by admission control, server overloaded for this class";
+                if ( op == dbQuery || op == dbGetMore ) {
+                    replyToQuery( ResultFlag_ErrSet , m , dbresponse ,
+                                  BSON( "$err" << msg << "code" << 16300 ) );
+                }
+                else {
+                    raiseError( 16300 , msg );
+                }
+                currentOp.ensureStarted();
+                currentOp.done();
+                return;
+            }
+        }
+
         if ( op == dbQuery ) {
             if ( handlePossibleShardedMessage( m , &dbresponse ) )
                 return;
@@ -369,6 +407,16 @@ namespace mongo {
         currentOp.ensureStarted();
         currentOp.done();
         debug.executionTime = currentOp.totalTimeMillis();
+        currentOp.recordResourceUsage();
+
+        if ( op == dbGetMore || op == dbInsert || op == dbUpdate || op == dbDelete ) {
+            // if mongos tagged this operation with a sampled trace id (high bits of the
+            // reserved field), record our span for it so the trace can be stitched
+            // together across the cluster
+            unsigned traceId = ( (unsigned)( *(int*)m.singleData()->_data ) ) >> DbMessage::Reserved_TraceIdShift;
+            if ( traceId )
+                opTraceRing.record( traceId , opToString( op ) , currentOp.totalTimeMicros() , ns );
+        }
 
         //DEV log = true;
         if ( log || debug.executionTime > logThreshold ) {
@@ -380,7 +428,11 @@ namespace mongo {
             }
         }
 
-        if ( currentOp.shouldDBProfile( debug.executionTime ) ) {
+        bool sampled = opSampler.maybeSample( c , currentOp );
+        opResourceProfile.record( currentOp );
+
+        if ( currentOp.shouldDBProfile( debug.executionTime )
+             || ( sampled && currentOp.profileLevel() == 1 && opSampler.shouldSpill() ) ) {
             // performance profiling is on
             if ( dbMutex.getState() < 0 ) {
                 mongo::log(1) << "note: not profiling because recursive read lock" << endl;
@@ -414,6 +466,13 @@ namespace mongo {
             assert( n < 30000 );
         }
 
+        if ( getMoreReadAhead ) {
+            // the read-ahead stager may hold a cursor's pin; erase asserts on
+            // pinned cursors, so make it let go first
+            for( int i = 0; i < n; i++ )
+                ClientCursor::interruptPrefetch( ((long long *) x)[i] );
+        }
+
         int found = ClientCursor::erase(n, (long long *) x);
 
         if ( logLevel > 0 || found != n ) {
@@ -452,6 +511,42 @@ namespace mongo {
         delete database; // closes files
     }
 
+    /** Fault in the pages an update/delete will touch before we take the write
+        lock, so the locked section below doesn't block the whole server on a
+        disk read.  We walk the same plan the write will use -- which pulls the
+        btree pages through -- and touch() record pages that look cold, all
+        under a read lock only.  Strictly best effort: bounded work, and any
+        exception (missing db, plan trouble) simply means no prefetch.
+    */
+    void prefetchPagesForWrite( const char *ns , const BSONObj &query , bool justOne ) {
+        try {
+            readlock lk(ns);
+            Client::Context ctx( ns );
+
+            shared_ptr<Cursor> c = NamespaceDetailsTransient::getCursor( ns , query );
+            if ( ! c )
+                return;
+            int scanned = 0;
+            int touched = 0;
+            while ( c->ok() && scanned < 200 && touched < 20 ) {
+                scanned++;
+                if ( !c->matcher() || c->matcher()->matchesCurrent( c.get() ) ) {
+                    Record *r = c->currLoc().rec();
+                    if ( ! r->likelyInPhysicalMemory() ) {
+                        r->touch();
+                        touched++;
+                    }
+                    if ( justOne )
+                        break;
+                }
+                c->advance();
+            }
+        }
+        catch ( const DBException& e ) {
+            LOG(1) << "prefetchPagesForWrite for " << ns << ": " << e.what() << endl;
+        }
+    }
+
     void receivedUpdate(Message& m, CurOp& op) {
         DbMessage d(m);
         const char *ns = d.getns();
@@ -472,6 +567,14 @@ namespace mongo {
         op.debug().query = query;
         op.setQuery(query);
 
+        // budgets apply to driver-originated updates only; replication applies
+        // its ops through updateObjects directly and must never be killed
+        op.setBudgets( cmdLine.opTimeBudgetMS , cmdLine.opScanBudget );
+
+        databaseFreezer.waitUntilWritable( ns );
+
+        prefetchPagesForWrite( ns , query , !multi );
+
         writelock lk;
 
         // void ReplSetImpl::relinquish() uses big write lock so 
@@ -501,6 +604,10 @@ namespace mongo {
         op.debug().query = pattern;
         op.setQuery(pattern);
 
+        databaseFreezer.waitUntilWritable( ns );
+
+        prefetchPagesForWrite( ns , pattern , justOne );
+
         writelock lk(ns);
 
         // writelock is used to synchronize stepdowns w/ writes
@@ -553,16 +660,29 @@ namespace mongo {
         curop.debug().ntoreturn = ntoreturn;
         curop.debug().cursorid = cursorid;
 
+        if ( getMoreReadAhead ) {
+            // if the read-ahead stager is mid-batch on this cursor, ask it to
+            // wrap up and wait here, before we take the read lock - the stager
+            // may need the lock to finish
+            ClientCursor::interruptPrefetch( cursorid );
+        }
+
         time_t start = 0;
         int pass = 0;
         bool exhaust = false;
         QueryResult* msgdata;
         OpTime last;
+        bool oplogNs = str::startsWith(ns, "local.oplog.");
+        unsigned long long tailTicket = 0;
+        Message *resp = new Message();
+        // the reply chunks live in the per-op scratch arena; rewind to here on every
+        // awaitData retry so thousands of passes don't accumulate arena chunks
+        OpArena::Mark arenaMark = cc().opArena().mark();
         while( 1 ) {
             try {
                 readlock lk;
 
-                if (str::startsWith(ns, "local.oplog.")){
+                if (oplogNs){
                     if (pass == 0)
                         last = OpTime::last_inlock();
                     else
@@ -570,15 +690,23 @@ namespace mongo {
                 }
 
                 Client::Context ctx(ns);
-                msgdata = processGetMore(ns, ntoreturn, cursorid, curop, pass, exhaust);
+                // builds the reply in chunks directly into resp.  when awaiting data,
+                // tailTicket is snapshotted inside (while still read locked) so the
+                // wait below can't miss an insert.
+                msgdata = processGetMore(ns, ntoreturn, cursorid, curop, pass, exhaust, *resp,
+                                         oplogNs ? 0 : &tailTicket);
             }
             catch ( AssertionException& e ) {
                 exhaust = false;
                 curop.debug().exceptionInfo = e.getInfo();
+                resp->reset();
                 msgdata = emptyMoreResult(cursorid);
+                resp->setData(msgdata, true);
                 ok = false;
             }
             if (msgdata == 0) {
+                resp->reset(); // awaiting data; try again
+                cc().opArena().rewind( arenaMark );
                 exhaust = false;
                 massert(13073, "shutting down", !inShutdown() );
                 if( pass == 0 ) {
@@ -594,15 +722,18 @@ namespace mongo {
                 pass++;
                 if (debug)
                     sleepmillis(20);
-                else
-                    sleepmillis(2);
+                else if (oplogNs)
+                    sleepmillis(2); // oplog waits on the OpTime notifier above
+                else {
+                    // block until an insert notification (or timeout, so the outer
+                    // 4 second cap still applies) instead of polling every 2ms
+                    tailTicket = waitForCappedInsert(ns, tailTicket, 1000);
+                }
                 continue;
             }
             break;
         };
 
-        Message *resp = new Message();
-        resp->setData(msgdata, true);
         curop.debug().responseLength = resp->header()->dataLen();
         curop.debug().nreturned = msgdata->nReturned;
 
@@ -632,6 +763,54 @@ namespace mongo {
     }
 
     NOINLINE_DECL void insertMulti(bool keepGoing, const char *ns, vector<BSONObj>& objs) {
+        {
+            // bulk fast path.  loaders typically hit this: an existing ordinary
+            // collection and documents that already carry an _id and pass the
+            // checkAndInsert screens.  anything else falls through to the simple
+            // per-document loop below.
+            NamespaceDetails *d = nsdetails(ns);
+            // special() also excludes .system. collections, which must go through
+            // the single document path for its insert_checkSys validation
+            bool batchable = d && !d->capped && !NamespaceString::special( ns );
+            for( size_t i = 0; batchable && i < objs.size(); i++ ) {
+                const BSONObj& o = objs[i];
+                if ( o.objsize() > BSONObjMaxUserSize ) {
+                    batchable = false;
+                    break;
+                }
+                BSONElement id = o.getField( "_id" );
+                if ( id.eoo() || id.type() == Array ) {
+                    batchable = false;
+                    break;
+                }
+                BSONObjIterator it( o );
+                while ( it.more() ) {
+                    if ( it.next().fieldName()[0] == '$' ) {
+                        batchable = false;
+                        break;
+                    }
+                }
+            }
+            if ( batchable ) {
+                int n = 0;
+                try {
+                    int retry = theDataFileMgr.insertBatch( ns, objs, keepGoing, n );
+                    if ( retry >= 0 ) {
+                        // the batch screened this one out; the single document path
+                        // raises the authentic error for it
+                        checkAndInsert( ns, objs[retry] );
+                        n++;
+                    }
+                }
+                catch ( const UserException& ) {
+                    globalOpCounters.incInsertInWriteLock(n);
+                    throw;
+                }
+                globalOpCounters.incInsertInWriteLock(n);
+                return;
+            }
+        }
+
         size_t i;
         for (i=0; i<objs.size(); i++){
             try {
@@ -667,8 +846,11 @@ namespace mongo {
             multi.push_back( d.nextJsObj() );
         }
 
-        writelock lk(ns);
-        //LockCollectionExclusively lk(ns);
+        databaseFreezer.waitUntilWritable( ns );
+
+        // takes the global write lock plus ns's database lock - see d_concurrency.h
+        // for the migration plan away from pure dbMutex here
+        LockDBExclusively lk(ns);
 
         // CONCURRENCY TODO: is being read locked in big log sufficient here?
         // writelock is used to synchronize stepdowns w/ writes
@@ -822,6 +1004,12 @@ namespace mongo {
         log() << "shutdown: waiting for fs preallocator..." << endl;
         FileAllocator::get()->waitUntilFinished();
 
+        // save the recorded query plans for the next startup
+        NamespaceDetailsTransient::persistQueryCaches();
+
+        // and which databases were in use, so the next startup can warm them
+        Database::recordRecentlyUsed();
+
         if( cmdLine.dur ) {
             log() << "shutdown: lock for final commit..." << endl;
             {
@@ -842,16 +1030,26 @@ namespace mongo {
                     log() << "shutdown: waiting for write lock..." << endl;
                 }
             }
-            MemoryMappedFile::flushAll(true);
+            // msync the whole set concurrently - with many databases the serial
+            // flush dominated shutdown time.  4 is an IO ceiling, not a target;
+            // workers pull files off a shared list so a big file doesn't idle
+            // the other spindles.
+            MemoryMappedFile::flushAllParallel( 4 );
         }
 
+        // everything is durable on disk now, so the journal is no longer needed;
+        // finalize it while we unmap, which itself can take a while on big sets
+        scoped_ptr<boost::thread> journalCleanupThread;
+        if( cmdLine.dur )
+            journalCleanupThread.reset( new boost::thread( boost::bind( dur::journalCleanup , true ) ) );
+
         log() << "shutdown: closing all files..." << endl;
         stringstream ss3;
         MemoryMappedFile::closeAllFiles( ss3 );
         log() << ss3.str() << endl;
 
         if( cmdLine.dur ) {
-            dur::journalCleanup(true);
+            journalCleanupThread->join();
         }
 
 #if !defined(__sunos__)
@@ -24,6 +24,7 @@
 #include "jsobj.h"
 #include "pdfile.h"
 #include "curop.h"
+#include "cmdline.h"
 
 namespace mongo {
 
@@ -85,4 +86,147 @@ namespace mongo {
         }
     }
 
+    bool OpSampler::maybeSample( const Client& c , CurOp& op ) {
+        int rate = cmdLine.opSampleRate;
+        if ( rate <= 0 )
+            return false;
+        if ( ( _seen++ % rate ) != 0 )
+            return false;
+
+        BSONObjBuilder b;
+        b.appendDate( "ts" , jsTime() );
+        op.debug().append( op , b );
+        b.append( "client" , c.clientAddress() );
+        BSONObj s = b.obj();
+
+        scoped_spinlock lk( _lock );
+        _samples[ _pos++ % NumSamples ] = s;
+        return true;
+    }
+
+    bool OpSampler::shouldSpill() {
+        time_t now = time(0);
+        if ( now == _lastSpill )
+            return false;
+        _lastSpill = now;
+        return true;
+    }
+
+    void OpSampler::append( BSONObjBuilder& b ) const {
+        b.append( "rate" , cmdLine.opSampleRate );
+        BSONArrayBuilder arr( b.subarrayStart( "samples" ) );
+        scoped_spinlock lk( _lock );
+        for ( unsigned i = 0; i < NumSamples; i++ ) {
+            const BSONObj& o = _samples[ ( _pos + i ) % NumSamples ]; // oldest first
+            if ( o.isEmpty() )
+                continue;
+            arr.append( o );
+        }
+        arr.done();
+    }
+
+    OpSampler opSampler;
+
+    namespace {
+        /* append the shape of a query object: field names and operators with the
+           values stripped.  recurses into subobjects so operators like $gt show
+           up, but treats arrays as leaves so an $in of 1000 values has the same
+           shape as an $in of 2. */
+        void appendQueryShape( const BSONObj& o , StringBuilder& ss ) {
+            ss << "{";
+            BSONObjIterator i( o );
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                ss << " " << e.fieldName();
+                if ( e.type() == Object )
+                    appendQueryShape( e.embeddedObject() , ss );
+            }
+            ss << " }";
+        }
+
+        bool moreCpu( const pair<string,long long>& l , const pair<string,long long>& r ) {
+            return l.second > r.second;
+        }
+    }
+
+    void OpResourceProfile::record( CurOp& op ) {
+        OpDebug& d = op.debug();
+
+        StringBuilder ss( 128 );
+        ss << d.ns.toString() << " ";
+        if ( d.iscommand ) {
+            ss << "command";
+            if ( ! d.query.isEmpty() )
+                ss << " " << d.query.firstElement().fieldName();
+        }
+        else {
+            ss << opToString( d.op );
+            if ( ! d.query.isEmpty() ) {
+                ss << " ";
+                appendQueryShape( d.query , ss );
+            }
+        }
+        string pattern = ss.str();
+
+        scoped_spinlock lk( _lock );
+        PatternMap::iterator it = _patterns.find( pattern );
+        Entry* e;
+        if ( it != _patterns.end() )
+            e = &it->second;
+        else if ( _patterns.size() < MaxPatterns )
+            e = &_patterns[ pattern ];
+        else
+            e = &_overflow;
+        e->count++;
+        e->cpuMicros += d.cpuMicros;
+        e->minorFaults += d.minorFaults;
+        e->majorFaults += d.majorFaults;
+        e->millis += d.executionTime;
+    }
+
+    void OpResourceProfile::append( BSONObjBuilder& b , int n , bool byFaults ) const {
+        // copy out under the lock, then rank and build the reply unlocked
+        PatternMap patterns;
+        Entry overflow;
+        {
+            scoped_spinlock lk( _lock );
+            patterns = _patterns;
+            overflow = _overflow;
+        }
+
+        vector< pair<string,long long> > ranked;
+        ranked.reserve( patterns.size() );
+        for ( PatternMap::const_iterator i = patterns.begin(); i != patterns.end(); ++i )
+            ranked.push_back( make_pair( i->first ,
+                                         byFaults ? i->second.majorFaults : i->second.cpuMicros ) );
+        sort( ranked.begin() , ranked.end() , moreCpu );
+
+        b.append( "patternsTracked" , (int)patterns.size() );
+        BSONArrayBuilder arr( b.subarrayStart( "patterns" ) );
+        for ( int i = 0; i < n && i < (int)ranked.size(); i++ ) {
+            const Entry& e = patterns[ ranked[i].first ];
+            BSONObjBuilder eb;
+            eb.append( "pattern" , ranked[i].first );
+            eb.appendNumber( "count" , e.count );
+            eb.appendNumber( "cpuMicros" , e.cpuMicros );
+            eb.appendNumber( "minorFaults" , e.minorFaults );
+            eb.appendNumber( "majorFaults" , e.majorFaults );
+            eb.appendNumber( "millis" , e.millis );
+            arr.append( eb.obj() );
+        }
+        arr.done();
+
+        if ( overflow.count ) {
+            BSONObjBuilder ob( b.subobjStart( "overflow" ) );
+            ob.appendNumber( "count" , overflow.count );
+            ob.appendNumber( "cpuMicros" , overflow.cpuMicros );
+            ob.appendNumber( "minorFaults" , overflow.minorFaults );
+            ob.appendNumber( "majorFaults" , overflow.majorFaults );
+            ob.appendNumber( "millis" , overflow.millis );
+            ob.done();
+        }
+    }
+
+    OpResourceProfile opResourceProfile;
+
 } // namespace mongo
@@ -22,6 +22,8 @@
 #include "../pch.h"
 #include "jsobj.h"
 #include "pdfile.h"
+#include "../bson/util/atomic_int.h"
+#include "../util/concurrency/spin_lock.h"
 
 namespace mongo {
 
@@ -31,4 +33,89 @@ namespace mongo {
 
     void profile( const Client& c , CurOp& currentOp );
 
+    /** always-on sampling of finished operations.
+
+        keeps every Nth completed op (N = cmdLine.opSampleRate) as a bson
+        snapshot in a small in-memory ring.  runs after the db lock has been
+        released, so the cost is a counter increment for unsampled ops and
+        one small bson build plus a spinlocked copy for sampled ones -
+        cheap enough to leave on in production, unlike profiling level 2.
+
+        retrieve the ring with the sampledOps command.
+    */
+    class OpSampler : boost::noncopyable {
+    public:
+        enum { NumSamples = 128 };
+
+        OpSampler() : _pos(0), _lastSpill(0) {}
+
+        /** consider sampling a finished op.  call outside the db lock.
+            @return true if this op was sampled */
+        bool maybeSample( const Client& c , CurOp& op );
+
+        /** limiter for spilling sampled ops into system.profile: allows at
+            most one spill per second, so profiling level 1 also captures
+            representative fast ops without level 2's write volume. */
+        bool shouldSpill();
+
+        /** append { rate : N , samples : [ ... ] }, oldest first */
+        void append( BSONObjBuilder& b ) const;
+
+    private:
+        AtomicUInt _seen;
+        mutable SpinLock _lock;
+        BSONObj _samples[NumSamples];
+        unsigned _pos;     // next slot; protected by _lock
+        time_t _lastSpill; // races are benign, as with other once-a-second throttles
+    };
+
+    extern OpSampler opSampler;
+
+    /** always-on per-query-pattern resource accounting.
+
+        every finished op is folded into a fixed-size table keyed by its
+        pattern - namespace, op type and the shape of the query (field names
+        and operators with the values stripped) - so "find user by email" is
+        one row no matter which email was asked for.  each row totals count,
+        thread cpu time, page faults and wall millis, answering "which query
+        shape burns the cpu" without turning on full profiling.
+
+        per op cost is one small string build and a spinlocked map touch,
+        comparable to what Top already pays on every op.  once MaxPatterns
+        distinct patterns exist, new ones pool into a single overflow row
+        rather than growing the table.
+
+        retrieve the table with the opResources command.
+    */
+    class OpResourceProfile : boost::noncopyable {
+    public:
+        enum { MaxPatterns = 256 };
+
+        /** fold a finished op into the table.  call outside the db lock,
+            after CurOp::recordResourceUsage(). */
+        void record( CurOp& op );
+
+        /** append { patternsTracked : N , patterns : [ ... ] } with the n
+            entries that consumed the most cpu - or the most major faults,
+            if byFaults - first */
+        void append( BSONObjBuilder& b , int n , bool byFaults ) const;
+
+    private:
+        struct Entry {
+            Entry() : count(0), cpuMicros(0), minorFaults(0), majorFaults(0), millis(0) {}
+            long long count;
+            long long cpuMicros;
+            long long minorFaults;
+            long long majorFaults;
+            long long millis;
+        };
+        typedef map<string,Entry> PatternMap;
+
+        mutable SpinLock _lock;
+        PatternMap _patterns; // protected by _lock
+        Entry _overflow;      // ops whose pattern arrived after the table filled
+    };
+
+    extern OpResourceProfile opResourceProfile;
+
 } // namespace mongo
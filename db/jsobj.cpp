@@ -274,8 +274,12 @@ namespace mongo {
                 if ( fn[2] == 'a' && fn[3] == 'x' && fn[4] == 'D' && fn[5] == 'i' && fn[6] == 's' && fn[7] == 't' && fn[8] == 'a' && fn[9] == 'n' && fn[10] == 'c' && fn[11] == 'e' && fn[12] == 0 )
                     return BSONObj::opMAX_DISTANCE;
             }
-            else if ( fn[1] == 't' && fn[2] == 'y' && fn[3] == 'p' && fn[4] == 'e' && fn[5] == 0 )
-                return BSONObj::opTYPE;
+            else if ( fn[1] == 't' ) {
+                if ( fn[2] == 'y' && fn[3] == 'p' && fn[4] == 'e' && fn[5] == 0 )
+                    return BSONObj::opTYPE;
+                if ( fn[2] == 'e' && fn[3] == 'x' && fn[4] == 't' && fn[5] == 0 )
+                    return BSONObj::opTEXT;
+            }
             else if ( fn[1] == 'i' && fn[2] == 'n' && fn[3] == 0 )
                 return BSONObj::opIN;
             else if ( fn[1] == 'n' && fn[2] == 'i' && fn[3] == 'n' && fn[4] == 0 )
@@ -408,32 +412,155 @@ namespace mongo {
         return s.str();
     }
 
-    bool BSONObj::valid() const {
-        try {
-            BSONObjIterator it(*this);
-            while( it.moreWithEOO() ) {
-                // both throw exception on failure
-                BSONElement e = it.next(true);
-                e.validate();
-
-                if (e.eoo()) {
-                    if (it.moreWithEOO())
+    namespace {
+        /** 4 byte little endian int at p.  memcpy rather than a cast so unaligned
+            reads are fine everywhere; compiles to a single load. */
+        inline int leInt( const char * p ) {
+            int x;
+            memcpy( &x , p , 4 );
+            return x;
+        }
+
+        /** single pass structural bson validator - the guts of BSONObj::valid().
+            iterative (nesting is an explicit stack of object end offsets, so a
+            deeply nested document can't blow the c++ stack) and every read is
+            bounds checked before it happens.  the terminator scans that dominate
+            the work go through memchr, which the c library vectorizes, instead of
+            a byte-at-a-time element walk - cheap enough that objcheck can stay on.
+            stricter than the old recursive walk in one way: an embedded object
+            whose stated size runs past its parent is rejected rather than read.
+        */
+        bool validBSON( const char * data , int len ) {
+            if ( len < 5 || leInt( data ) != len )
+                return false;
+
+            vector<int> parents; // end offsets of enclosing objects
+            int end = len;       // end offset (exclusive) of the object being scanned
+            int pos = 4;         // offset of the next element's type byte
+
+            while ( 1 ) {
+                if ( pos >= end )
+                    return false;
+                int t = (signed char) data[pos];
+
+                if ( t == EOO ) {
+                    if ( pos + 1 != end ) // EOO before end of object
+                        return false;
+                    pos++;
+                    if ( parents.empty() )
+                        return true;
+                    end = parents.back();
+                    parents.pop_back();
+                    continue;
+                }
+
+                // field name
+                const char * z = (const char *) memchr( data + pos + 1 , 0 , end - pos - 1 );
+                if ( z == 0 )
+                    return false;
+                pos = (int)( z - data ) + 1; // first byte of the value
+
+                switch ( t ) {
+                case Undefined:
+                case jstNULL:
+                case MaxKey:
+                case MinKey:
+                    break;
+                case mongo::Bool:
+                    pos += 1;
+                    break;
+                case NumberInt:
+                    pos += 4;
+                    break;
+                case NumberDouble:
+                case NumberLong:
+                case mongo::Date:
+                case Timestamp:
+                    pos += 8;
+                    break;
+                case jstOID:
+                    pos += 12;
+                    break;
+                case mongo::String:
+                case Code:
+                case Symbol:
+                case DBRef: {
+                    if ( pos + 4 > end )
+                        return false;
+                    int sz = leInt( data + pos );
+                    if ( sz <= 0 || sz >= BSONObjMaxInternalSize || sz > end - pos - 4 )
+                        return false;
+                    if ( data[ pos + 4 + sz - 1 ] != 0 )
+                        return false;
+                    pos += 4 + sz;
+                    if ( t == DBRef )
+                        pos += 12;
+                    break;
+                }
+                case BinData: {
+                    if ( pos + 4 > end )
+                        return false;
+                    int sz = leInt( data + pos );
+                    if ( sz < 0 || sz >= BSONObjMaxInternalSize || sz > end - pos - 5 )
                         return false;
-                    return true;
+                    pos += 5 + sz;
+                    break;
                 }
-                else if (e.isABSONObj()) {
-                    if(!e.embeddedObject().valid())
+                case RegEx: {
+                    for( int i = 0; i < 2; i++ ) {
+                        const char * q = (const char *) memchr( data + pos , 0 , end - pos );
+                        if ( q == 0 )
+                            return false;
+                        pos = (int)( q - data ) + 1;
+                    }
+                    break;
+                }
+                case Object:
+                case mongo::Array: {
+                    if ( pos + 4 > end )
                         return false;
+                    int sz = leInt( data + pos );
+                    if ( sz < 5 || sz > end - pos )
+                        return false;
+                    parents.push_back( end );
+                    end = pos + sz;
+                    pos += 4;
+                    continue; // descend
                 }
-                else if (e.type() == CodeWScope) {
-                    if(!e.codeWScopeObject().valid())
+                case CodeWScope: {
+                    if ( pos + 8 > end )
+                        return false;
+                    int total = leInt( data + pos );
+                    if ( total < 4 + 4 + 1 + 5 || total > end - pos )
+                        return false;
+                    int strSz = leInt( data + pos + 4 );
+                    if ( strSz <= 0 || strSz > total - 4 - 4 - 5 )
                         return false;
+                    if ( data[ pos + 8 + strSz - 1 ] != 0 ||
+                         memchr( data + pos + 8 , 0 , strSz - 1 ) != 0 )
+                        return false;
+                    int objSz = leInt( data + pos + 8 + strSz );
+                    if ( objSz != total - 4 - 4 - strSz )
+                        return false;
+                    // descend into the scope object; it must end exactly where
+                    // the codewscope does
+                    parents.push_back( end );
+                    end = pos + total;
+                    pos += 8 + strSz + 4;
+                    continue;
+                }
+                default: // unknown type byte
+                    return false;
                 }
+
+                if ( pos > end )
+                    return false;
             }
         }
-        catch (...) {
-        }
-        return false;
+    }
+
+    bool BSONObj::valid() const {
+        return validBSON( objdata() , objsize() );
     }
 
     int BSONObj::woCompare(const BSONObj& r, const Ordering &o, bool considerFieldName) const {
@@ -455,14 +582,12 @@ namespace mongo {
             if ( r.eoo() )
                 return 1;
 
-            int x;
-            {
-                x = l.woCompare( r, considerFieldName );
-                if( o.descending(mask) )
-                    x = -x;
+            int x = l.woCompare( r, considerFieldName );
+            if ( x != 0 ) {
+                // fold the direction in without branching: s is 0 or ~0
+                int s = -(int)( o.descending(mask) != 0 );
+                return (x ^ s) - s;
             }
-            if ( x != 0 )
-                return x;
             mask <<= 1;
         }
         return -1;
@@ -552,15 +677,17 @@ namespace mongo {
     }
 
     template <typename BSONElementColl>
-    void _getFieldsDotted( const BSONObj* obj, const StringData& name, BSONElementColl &ret, bool expandLastArray ) {
-        BSONElement e = obj->getField( name );
+    void _getFieldsDotted( const BSONObj* obj, const StringData& name, BSONElementColl &ret, bool expandLastArray, BSONObjFieldIndex *topIndex ) {
+        // topIndex covers only this level; recursion into subobjects rescans them
+        BSONElement e = topIndex ? topIndex->getField( name ) : obj->getField( name );
 
         if ( e.eoo() ) {
             const char *p = strchr(name.data(), '.');
             if ( p ) {
-                string left(name.data(), p-name.data());
                 const char* next = p+1;
-                BSONElement e = obj->getField( left.c_str() );
+                // unterminated slice; getField only examines size() bytes
+                StringData left( name.data(), p - name.data() );
+                BSONElement e = topIndex ? topIndex->getField( left ) : obj->getField( left );
 
                 if (e.type() == Object) {
                     e.embeddedObject().getFieldsDotted(next, ret, expandLastArray );
@@ -602,11 +729,11 @@ namespace mongo {
         }
     }
 
-    void BSONObj::getFieldsDotted(const StringData& name, BSONElementSet &ret, bool expandLastArray ) const {
-        _getFieldsDotted( this, name, ret, expandLastArray );
+    void BSONObj::getFieldsDotted(const StringData& name, BSONElementSet &ret, bool expandLastArray , BSONObjFieldIndex *topIndex ) const {
+        _getFieldsDotted( this, name, ret, expandLastArray, topIndex );
     }
-    void BSONObj::getFieldsDotted(const StringData& name, BSONElementMSet &ret, bool expandLastArray ) const {
-        _getFieldsDotted( this, name, ret, expandLastArray );
+    void BSONObj::getFieldsDotted(const StringData& name, BSONElementMSet &ret, bool expandLastArray , BSONObjFieldIndex *topIndex ) const {
+        _getFieldsDotted( this, name, ret, expandLastArray, topIndex );
     }
 
     BSONElement BSONObj::getFieldDottedOrArray(const char *&name) const {
@@ -615,7 +742,7 @@ namespace mongo {
         BSONElement sub;
 
         if ( p ) {
-            sub = getField( string(name, p-name) );
+            sub = getField( StringData( name, p - name ) ); // unterminated slice is fine here
             name = p + 1;
         }
         else {
@@ -584,7 +584,64 @@ namespace mongo {
         return sz;
     }
 
-    int KeyV1::dataSize() const { 
+    int KeyV1::woCompareSkipMatched(const KeyV1& right, const Ordering &order, int skipFields, int *nMatched) const {
+        dassert( isCompactFormat() && right.isCompactFormat() );
+
+        const unsigned char *l = _keyData;
+        const unsigned char *r = right._keyData;
+
+        unsigned mask = 1;
+        int matched = 0;
+        while( matched < skipFields ) {
+            // the caller has established these leading fields are equal - step over them
+            char lval = *l;
+            char rval = *r;
+            l += sizeOfElement(l);
+            r += sizeOfElement(r);
+            matched++;
+            if( (lval & rval & cHASMORE) == 0 ) {
+                // a key ends within the matched prefix.  keys in one btree all have the
+                // same number of fields so this only happens when both end together,
+                // but stay defensive: the longer key sorts after the shorter.
+                *nMatched = matched;
+                return ((int)(lval & cHASMORE)) - ((int)(rval & cHASMORE));
+            }
+            mask <<= 1;
+        }
+
+        while( 1 ) {
+            char lval = *l;
+            char rval = *r;
+            {
+                int x = compare(l, r); // updates l and r pointers
+                if( x ) {
+                    if( order.descending(mask) )
+                        x = -x;
+                    *nMatched = matched;
+                    return x;
+                }
+            }
+
+            matched++;
+
+            {
+                int x = ((int)(lval & cHASMORE)) - ((int)(rval & cHASMORE));
+                if( x ) {
+                    *nMatched = matched;
+                    return x;
+                }
+                if( (lval & cHASMORE) == 0 )
+                    break;
+            }
+
+            mask <<= 1;
+        }
+
+        *nMatched = matched;
+        return 0;
+    }
+
+    int KeyV1::dataSize() const {
         const unsigned char *p = _keyData;
         if( !isCompactFormat() ) {
             return bson().objsize() + 1;
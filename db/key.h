@@ -34,6 +34,10 @@ namespace mongo {
         explicit KeyBson(const char *keyData) : _o(keyData) { }
         explicit KeyBson(const BSONObj& obj) : _o(obj) { }
         int woCompare(const KeyBson& r, const Ordering &o) const;
+        int woCompareSkipMatched(const KeyBson& r, const Ordering &o, int skipFields, int *nMatched) const {
+            *nMatched = 0;
+            return woCompare(r, o);
+        }
         BSONObj toBson() const { return _o; }
         string toString() const { return _o.toString(); }
         int dataSize() const { return _o.objsize(); }
@@ -71,6 +75,16 @@ namespace mongo {
         explicit KeyV1(const char *keyData) : _keyData((unsigned char *) keyData) { }
 
         int woCompare(const KeyV1& r, const Ordering &o) const;
+
+        /** woCompare() that exploits prior knowledge that the first skipFields fields of
+            the two keys are equal - they are stepped over, not compared.  used by the
+            btree binary search where the bracketing keys bound how much of the prefix
+            the candidate key must share with the sought key.
+            both keys must be isCompactFormat().
+            @param nMatched - set to the number of leading fields that compared equal
+        */
+        int woCompareSkipMatched(const KeyV1& r, const Ordering &o, int skipFields, int *nMatched) const;
+
         bool woEqual(const KeyV1& r) const;
         BSONObj toBson() const;
         string toString() const { return toBson().toString(); }
@@ -28,6 +28,7 @@ namespace mongo {
 
     LastError LastError::noError;
     LastErrorHolder lastError;
+    TSP_DEFINE(LastError, tlLastError)
 
     bool isShell = false;
     void raiseError(int code , const char *msg) {
@@ -70,10 +71,6 @@ namespace mongo {
             b.appendBool( "updatedExisting", updatedExisting == True );
         if ( upsertedId.isSet() )
             b.append( "upserted" , upsertedId );
-        if ( writebackId.isSet() ) {
-            b.append( "writeback" , writebackId );
-            b.append( "instanceIdent" , prettyHostName() ); // this can be any unique string
-        }
         b.appendNumber( "n", nObjects );
 
         return ! msg.empty();
@@ -99,26 +96,26 @@ namespace mongo {
     }
 
     LastError * LastErrorHolder::_get( bool create ) {
-        LastError * le = _tl.get();
+        LastError * le = tlLastError.get();
         if ( ! le && create ) {
             le = new LastError();
-            _tl.reset( le );
+            tlLastError.reset( le );
         }
         return le;
     }
 
     void LastErrorHolder::release() {
-        _tl.release();
+        tlLastError.release();
     }
 
     /** ok to call more than once. */
     void LastErrorHolder::initThread() {
-        if( ! _tl.get() ) 
-            _tl.reset( new LastError() );
+        if( ! tlLastError.get() )
+            tlLastError.reset( new LastError() );
     }
 
     void LastErrorHolder::reset( LastError * le ) {
-        _tl.reset( le );
+        tlLastError.reset( le );
     }
 
     void prepareErrForNewRequest( Message &m, LastError * err ) {
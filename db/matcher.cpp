@@ -24,9 +24,11 @@
 #include "../util/unittest.h"
 #include "diskloc.h"
 #include "../scripting/engine.h"
+#include "../scripting/native_expr.h"
 #include "db.h"
 #include "queryutil.h"
 #include "client.h"
+#include "text.h"
 
 #include "pdfile.h"
 
@@ -47,6 +49,83 @@ namespace {
         }
         return options;
     }
+
+    /** detect a pattern that is just an alternation of plain literals -
+        optionally ^(?:...)$ anchored - e.g. ^(?:GET|PUT|POST)$ or
+        "timeout|refused".  pcre backtracks across the alternatives for every
+        document; comparing against the literal set directly is much cheaper.
+        anchors are only honored in the grouped form because in a bare
+        alternation they would bind to a single alternative.
+    */
+    bool parseLiteralAlternation( const char *regex, const char *flags,
+                                  std::vector<std::string> &lits, bool &start, bool &end ) {
+        if ( *flags )
+            return false; // i/m/x/s all change the semantics assumed below
+        start = false;
+        end = false;
+        const char *p = regex;
+        if ( *p == '^' ) {
+            start = true;
+            p++;
+        }
+        bool grouped = false;
+        if ( p[0] == '(' && p[1] == '?' && p[2] == ':' ) {
+            grouped = true;
+            p += 3;
+        }
+        bool closed = false;
+        lits.clear();
+        lits.push_back( std::string() );
+        while( *p ) {
+            char c = *(p++);
+            if ( c == '|' ) {
+                lits.push_back( std::string() );
+            }
+            else if ( c == '\\' ) {
+                c = *(p++);
+                if ( c == 0 || isalnum( (unsigned char)c ) )
+                    return false; // escape sequence or backreference
+                lits.back() += c;
+            }
+            else if ( grouped && c == ')' ) {
+                if ( *p == '$' ) {
+                    end = true;
+                    p++;
+                }
+                if ( *p )
+                    return false; // more pattern after the group
+                closed = true;
+                break;
+            }
+            else if ( strchr( "^$.[](){}*+?", c ) ) {
+                return false;
+            }
+            else {
+                lits.back() += c;
+            }
+        }
+        if ( grouped && !closed )
+            return false; // never saw the closing paren
+        if ( !grouped && start && lits.size() > 1 )
+            return false; // in ^a|b the anchor binds to 'a' alone
+        for( unsigned i = 0; i < lits.size(); i++ ) {
+            if ( lits[ i ].empty() )
+                return false;
+        }
+        return true;
+    }
+
+    /** fill in RegexMatcher::_literals when the pattern qualifies */
+    void compileLiteralAlternation( mongo::RegexMatcher &rm ) {
+        std::vector<std::string> lits;
+        bool start, end;
+        if ( parseLiteralAlternation( rm._regex, rm._flags, lits, start, end ) ) {
+            rm._literals.reset( new std::vector<std::string>() );
+            rm._literals->swap( lits );
+            rm._litStart = start;
+            rm._litEnd = end;
+        }
+    }
 }
 
 //#define DEBUGMATCHER(x) cout << x << endl;
@@ -84,6 +163,11 @@ namespace mongo {
         ScriptingFunction func;
         BSONObj *jsScope;
 
+        // compiled native fast path; NULL when the code is outside the
+        // supported subset (or has a CodeWScope scope, which could shadow
+        // anything the expression references)
+        scoped_ptr<NativeExpr> native;
+
         void setFunc(const char *code) {
             massert( 10341 ,  "scope has to be created first!" , scope.get() );
             func = scope->createFunction( code );
@@ -108,6 +192,11 @@ namespace mongo {
         else if ( op == BSONObj::opTYPE ) {
             _type = (BSONType)(e.numberInt());
         }
+        else if ( op == BSONObj::opTEXT ) {
+            uassert( 16318 , "$text needs a string" , e.type() == String );
+            _textTerms.reset( new set<string>() );
+            text::tokenize( e.valuestr() , *_textTerms );
+        }
         else if ( op == BSONObj::opELEM_MATCH ) {
             BSONElement m = e;
             uassert( 12517 , "$elemMatch needs an Object" , m.type() == Object );
@@ -152,6 +241,7 @@ namespace mongo {
                 string prefix = simpleRegex(rm._regex, rm._flags, &purePrefix);
                 if (purePrefix)
                     rm._prefix = prefix;
+                compileLiteralAlternation( rm );
             }
             else {
                 uassert( 15882, "$elemMatch not allowed within $in",
@@ -186,14 +276,18 @@ namespace mongo {
         rm._regex = regex;
         rm._flags = flags;
         rm._isNot = isNot;
-        _regexs.push_back(rm);
 
         if (!isNot) { //TODO something smarter
             bool purePrefix;
             string prefix = simpleRegex(regex, flags, &purePrefix);
             if (purePrefix)
                 rm._prefix = prefix;
+            compileLiteralAlternation( rm );
         }
+
+        // n.b. push after the fast path fields are set - an older version of
+        // this code pushed first and set _prefix on a dead copy
+        _regexs.push_back(rm);
     }
 
     bool Matcher::addOp( const BSONElement &e, const BSONElement &fe, bool isNot, const char *& regex, const char *&flags ) {
@@ -245,6 +339,7 @@ namespace mongo {
             break;
         case BSONObj::opMOD:
         case BSONObj::opTYPE:
+        case BSONObj::opTEXT:
         case BSONObj::opELEM_MATCH: {
             shared_ptr< BSONObjBuilder > b( new BSONObjBuilder() );
             _builders.push_back( b );
@@ -353,6 +448,7 @@ namespace mongo {
         else {
             const char *code = e.valuestr();
             _where->setFunc(code);
+            _where->native.reset( NativeExpr::parseWhere( code ) );
         }
             
         _where->scope->execSetup( "_mongo.readOnly = true;" , "make read only" );
@@ -451,16 +547,17 @@ namespace mongo {
     /* _jsobj          - the query pattern
     */
     Matcher::Matcher(const BSONObj &jsobj, bool nested) :
-        _where(0), _jsobj(jsobj), _haveSize(), _all(), _hasArray(0), _haveNeg(), _atomic(false) {
+        _where(0), _jsobj(jsobj), _quickOk(false), _haveSize(), _all(), _hasArray(0), _haveNeg(), _atomic(false) {
 
         BSONObjIterator i(_jsobj);
         while ( i.more() ) {
             parseMatchExpressionElement( i.next(), nested );
         }
+        _compileQuick();
     }
 
     Matcher::Matcher( const Matcher &docMatcher, const BSONObj &key ) :
-        _where(0), _constrainIndexKey( key ), _haveSize(), _all(), _hasArray(0), _haveNeg(), _atomic(false) {
+        _where(0), _constrainIndexKey( key ), _quickOk(false), _haveSize(), _all(), _hasArray(0), _haveNeg(), _atomic(false) {
         // Filter out match components that will provide an incorrect result
         // given a key from a single key index.
         for( vector< ElementMatcher >::const_iterator i = docMatcher._basics.begin(); i != docMatcher._basics.end(); ++i ) {
@@ -472,6 +569,7 @@ namespace mongo {
                 case BSONObj::NIN:
                 case BSONObj::opEXISTS: // We can't match on index in this case.
                 case BSONObj::opTYPE: // For $type:10 (null), a null key could be a missing field or a null value field.
+                case BSONObj::opTEXT: // A text index key is a single term, not the whole string.
                     break;
                 case BSONObj::opIN: {
                     bool inContainsArray = false;
@@ -512,14 +610,40 @@ namespace mongo {
         }
     }
 
+    /** match a string against a compiled literal alternation - no pcre */
+    inline bool literalAlternationMatches(const RegexMatcher& rm, const char *s) {
+        size_t len = strlen( s );
+        const vector<string> &lits = *rm._literals;
+        for( unsigned i = 0; i < lits.size(); i++ ) {
+            const string &lit = lits[ i ];
+            if ( lit.size() > len )
+                continue;
+            if ( rm._litStart ) {
+                if ( rm._litEnd ?
+                     lit.size() == len && !memcmp( s, lit.data(), len ) :
+                     !memcmp( s, lit.data(), lit.size() ) )
+                    return true;
+            }
+            else if ( rm._litEnd ) {
+                if ( !memcmp( s + len - lit.size(), lit.data(), lit.size() ) )
+                    return true;
+            }
+            else if ( strstr( s, lit.c_str() ) ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     inline bool regexMatches(const RegexMatcher& rm, const BSONElement& e) {
         switch (e.type()) {
         case String:
         case Symbol:
-            if (rm._prefix.empty())
-                return rm._re->PartialMatch(e.valuestr());
-            else
+            if (!rm._prefix.empty())
                 return !strncmp(e.valuestr(), rm._prefix.c_str(), rm._prefix.size());
+            if (rm._literals.get())
+                return literalAlternationMatches(rm, e.valuestr());
+            return rm._re->PartialMatch(e.valuestr());
         case RegEx:
             return !strcmp(rm._regex, e.regex()) && !strcmp(rm._flags, e.regexFlags());
         default:
@@ -573,6 +697,19 @@ namespace mongo {
             return bm._type == l.type();
         }
 
+        if ( op == BSONObj::opTEXT ) {
+            // every query term must appear in the document string
+            if ( l.type() != String || bm._textTerms->empty() )
+                return false;
+            set<string> docTerms;
+            text::tokenize( l.valuestr() , docTerms );
+            for ( set<string>::const_iterator i = bm._textTerms->begin(); i != bm._textTerms->end(); ++i ) {
+                if ( ! docTerms.count( *i ) )
+                    return false;
+            }
+            return true;
+        }
+
         /* check LT, GTE, ... */
         if ( l.canonicalType() != r.canonicalType() )
             return false;
@@ -583,8 +720,8 @@ namespace mongo {
         return (op & z);
     }
 
-    int Matcher::inverseMatch(const char *fieldName, const BSONElement &toMatch, const BSONObj &obj, const ElementMatcher& bm , MatchDetails * details ) {
-        int inverseRet = matchesDotted( fieldName, toMatch, obj, bm.inverseOfNegativeCompareOp(), bm , false , details );
+    int Matcher::inverseMatch(const char *fieldName, const BSONElement &toMatch, const BSONObj &obj, const ElementMatcher& bm , MatchDetails * details , BSONObjFieldIndex *topIndex ) {
+        int inverseRet = matchesDotted( fieldName, toMatch, obj, bm.inverseOfNegativeCompareOp(), bm , false , details , topIndex );
         if ( bm.negativeCompareOpContainsNull() ) {
             return ( inverseRet <= 0 ) ? 1 : 0;
         }
@@ -614,7 +751,7 @@ namespace mongo {
         0 missing element
         1 match
     */
-    int Matcher::matchesDotted(const char *fieldName, const BSONElement& toMatch, const BSONObj& obj, int compareOp, const ElementMatcher& em , bool isArr, MatchDetails * details ) {
+    int Matcher::matchesDotted(const char *fieldName, const BSONElement& toMatch, const BSONObj& obj, int compareOp, const ElementMatcher& em , bool isArr, MatchDetails * details , BSONObjFieldIndex *topIndex ) {
         DEBUGMATCHER( "\t matchesDotted : " << fieldName << " hasDetails: " << ( details ? "yes" : "no" ) );
         if ( compareOp == BSONObj::opALL ) {
 
@@ -647,7 +784,7 @@ namespace mongo {
                 return -1; // is this desired?
 
             BSONElementSet myValues;
-            obj.getFieldsDotted( fieldName , myValues );
+            obj.getFieldsDotted( fieldName , myValues , true , topIndex );
 
             for( set< BSONElement, element_lt >::const_iterator i = em._myset->begin(); i != em._myset->end(); ++i ) {
                 // ignore nulls
@@ -677,7 +814,7 @@ namespace mongo {
         } // end opALL
 
         if ( compareOp == BSONObj::NE || compareOp == BSONObj::NIN ) {
-            return inverseMatch( fieldName, toMatch, obj, em , details );
+            return inverseMatch( fieldName, toMatch, obj, em , details , topIndex );
         }
 
         BSONElement e;
@@ -695,9 +832,9 @@ namespace mongo {
 
             const char *p = strchr(fieldName, '.');
             if ( p ) {
-                string left(fieldName, p-fieldName);
+                StringData left(fieldName, p-fieldName); // unterminated slice; getField only examines size() bytes
 
-                BSONElement se = obj.getField(left.c_str());
+                BSONElement se = topIndex ? topIndex->getField(left) : obj.getField(left);
                 if ( se.eoo() )
                     ;
                 else if ( se.type() != Object && se.type() != Array )
@@ -749,7 +886,7 @@ namespace mongo {
                 return 0;
             }
             else {
-                e = obj.getField(fieldName);
+                e = topIndex ? topIndex->getField(fieldName) : obj.getField(fieldName);
             }
         }
 
@@ -814,19 +951,142 @@ namespace mongo {
 
     /* See if an object matches the query.
     */
-    bool Matcher::matches(const BSONObj& jsobj , MatchDetails * details ) {
+    /* compile a fast path for the common OLTP query shape: every basic predicate is a
+       plain comparison against a scalar on a top level field.  field lookups then happen
+       in one pass over the document instead of one getFieldDottedOrArray scan per
+       predicate, and comparisons dispatch on the precomputed right hand side type.
+    */
+    void Matcher::_compileQuick() {
+        _quick.clear();
+        _quickOk = false;
+        if ( !_constrainIndexKey.isEmpty() )
+            return; // key matchers resolve fields by index name; general path only
+        if ( _basics.size() == 0 || _basics.size() > 64 ) // _quickMatches uses a 64 bit seen mask
+            return;
+        for ( int pass = 0; pass < 2; pass++ ) {
+            // equality predicates first; they are the cheapest and usually the most selective
+            for ( unsigned i = 0; i < _basics.size(); i++ ) {
+                const ElementMatcher& bm = _basics[i];
+                if ( ( bm._compareOp == BSONObj::Equality ) != ( pass == 0 ) )
+                    continue;
+                if ( bm._isNot )
+                    return;
+                switch( bm._compareOp ) {
+                case BSONObj::Equality:
+                case BSONObj::LT:
+                case BSONObj::LTE:
+                case BSONObj::GT:
+                case BSONObj::GTE:
+                    break;
+                default:
+                    return;
+                }
+                const BSONElement& m = bm._toMatch;
+                if ( strchr( m.fieldName(), '.' ) )
+                    return; // dotted paths have traversal semantics
+                switch( m.type() ) {
+                case NumberDouble:
+                case NumberInt:
+                case NumberLong:
+                case String:
+                case Bool:
+                case Date:
+                case jstOID:
+                case Timestamp:
+                    break;
+                default:
+                    // null/undefined (missing matches), arrays, objects, regex: general path
+                    return;
+                }
+                QuickMatch q;
+                q.fieldName = m.fieldName();
+                q.rhs = m;
+                q.op = bm._compareOp;
+                q.rhsType = m.type();
+                q.rhsCanonical = m.canonicalType();
+                _quick.push_back( q );
+            }
+        }
+        _quickOk = true;
+    }
 
-        LOG(5) << "Matcher::matches() " << jsobj.toString() << endl;
+    int Matcher::_quickMatches( const BSONObj &jsobj ) const {
+        unsigned remaining = _quick.size();
+        unsigned long long seen = 0;
+        BSONObjIterator it( jsobj );
+        while( remaining > 0 && it.more() ) {
+            BSONElement e = it.next();
+            const char *name = e.fieldName();
+            for ( unsigned j = 0; j < _quick.size(); j++ ) {
+                const QuickMatch& q = _quick[j];
+                if ( ( seen & ( 1ULL << j ) ) || name[0] != q.fieldName[0] || strcmp( name, q.fieldName ) != 0 )
+                    continue;
+                // only the first occurrence of a field name counts, as with getField()
+                seen |= 1ULL << j;
+                remaining--;
+                if ( e.type() == Array )
+                    return -1; // array values match per element; use the general path
+                if ( q.op == BSONObj::Equality ) {
+                    if ( e.type() == q.rhsType ) {
+                        // type specialized equality for the hot types
+                        switch( q.rhsType ) {
+                        case NumberInt:
+                            if ( e.numberInt() != q.rhs.numberInt() )
+                                return 0;
+                            break;
+                        case NumberLong:
+                            if ( e.numberLong() != q.rhs.numberLong() )
+                                return 0;
+                            break;
+                        case NumberDouble:
+                            if ( e.numberDouble() != q.rhs.numberDouble() )
+                                return 0;
+                            break;
+                        case String:
+                            if ( e.valuestrsize() != q.rhs.valuestrsize() ||
+                                 memcmp( e.valuestr(), q.rhs.valuestr(), e.valuestrsize() ) != 0 )
+                                return 0;
+                            break;
+                        default:
+                            if ( !e.valuesEqual( q.rhs ) )
+                                return 0;
+                        }
+                    }
+                    else if ( !e.valuesEqual( q.rhs ) ) { // mixed numeric types etc.
+                        return 0;
+                    }
+                }
+                else {
+                    if ( e.canonicalType() != q.rhsCanonical )
+                        return 0;
+                    int c = compareElementValues( e, q.rhs );
+                    if ( c < -1 ) c = -1;
+                    if ( c > 1 ) c = 1;
+                    if ( !( q.op & ( 1 << ( c + 1 ) ) ) )
+                        return 0;
+                }
+                // no break: several predicates may target this same field,
+                // e.g. {a:{$gt:1,$lt:5}} compiles to two entries on "a"
+            }
+        }
+        // we only compile comparisons that a missing field cannot satisfy
+        return remaining > 0 ? 0 : 1;
+    }
 
+    bool Matcher::_matchBasics( const BSONObj &jsobj, MatchDetails *details ) {
         /* assuming there is usually only one thing to match.  if more this
            could be slow sometimes. */
 
-        // check normal non-regex cases:
+        // one lazily built field table for the document, shared across the
+        // predicates, so each one resolves its top level field without a fresh
+        // scan of the whole document
+        BSONObjFieldIndex topIndex( jsobj );
+
         for ( unsigned i = 0; i < _basics.size(); i++ ) {
             ElementMatcher& bm = _basics[i];
             BSONElement& m = bm._toMatch;
             // -1=mismatch. 0=missing element. 1=match
-            int cmp = matchesDotted(m.fieldName(), m, jsobj, bm._compareOp, bm , false , details );
+            int cmp = matchesDotted(m.fieldName(), m, jsobj, bm._compareOp, bm , false , details , &topIndex );
             if ( cmp == 0 && bm._compareOp == BSONObj::opEXISTS ) {
                 // If missing, match cmp is opposite of $exists spec.
                 cmp = -retExistsFound(bm);
@@ -850,6 +1110,23 @@ namespace mongo {
                 }
             }
         }
+        return true;
+    }
+
+    bool Matcher::matches(const BSONObj& jsobj , MatchDetails * details ) {
+
+        LOG(5) << "Matcher::matches() " << jsobj.toString() << endl;
+
+        // check normal non-regex cases:
+        int quick = ( _quickOk && details == 0 ) ? _quickMatches( jsobj ) : -1;
+        if ( quick == 0 )
+            return false;
+        if ( quick < 0 && !_matchBasics( jsobj, details ) )
+            return false;
+
+        // shared across the regex predicates' field resolution (lazy, so free
+        // when there are no regexes or the index-key path is taken)
+        BSONObjFieldIndex regexTopIndex( jsobj );
 
         for (vector<RegexMatcher>::const_iterator it = _regexs.begin();
 	     it != _regexs.end();
@@ -871,7 +1148,7 @@ namespace mongo {
 
             }
             else {
-                jsobj.getFieldsDotted( it->_fieldName, s );
+                jsobj.getFieldsDotted( it->_fieldName, s, true, &regexTopIndex );
             }
             bool match = false;
             for( BSONElementSet::const_iterator i = s.begin(); i != s.end(); ++i )
@@ -934,13 +1211,25 @@ namespace mongo {
                 return false; // didn't compile
             }
 
+            if ( _where->native ) {
+                bool ok;
+                bool res = _where->native->evalBool( jsobj , ok );
+                if ( ok )
+                    return res;
+                // this document uses values the native subset doesn't cover -
+                // evaluate it with the js engine below
+            }
+
             if ( _where->jsScope ) {
                 _where->scope->init( _where->jsScope );
             }
             _where->scope->setObject( "obj", const_cast< BSONObj & >( jsobj ) );
             _where->scope->setBoolean( "fullObject" , true ); // this is a hack b/c fullObject used to be relevant
 
-            int err = _where->scope->invoke( _where->func , 0, &jsobj , 1000 * 60 , false );
+            // readOnlyRecv: a predicate has no business mutating its document, and
+            // the read-only lazy wrapper skips the per-field property pass the
+            // writable one needs, so wide documents only pay for fields touched
+            int err = _where->scope->invoke( _where->func , 0, &jsobj , 1000 * 60 , false , false , true );
             if ( err == -3 ) { // INVOKE_ERROR
                 stringstream ss;
                 ss << "error on invocation of $where function:\n"
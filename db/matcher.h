@@ -37,8 +37,13 @@ namespace mongo {
         const char *_flags;
         string _prefix;
         shared_ptr< pcrecpp::RE > _re;
+        // set when the pattern is just an alternation of plain literals, e.g.
+        // ^(?:GET|PUT)$ or "error|warning" - matched directly, bypassing pcre
+        shared_ptr< vector<string> > _literals;
+        bool _litStart; // literals are anchored at the start of the string
+        bool _litEnd;   // literals must match through the end of the string
         bool _isNot;
-        RegexMatcher() : _isNot() {}
+        RegexMatcher() : _litStart(), _litEnd(), _isNot() {}
     };
 
     struct element_lt {
@@ -77,6 +82,7 @@ namespace mongo {
         int _mod;
         int _modm;
         BSONType _type;
+        shared_ptr< set<string> > _textTerms; // $text query terms, pre-tokenized
 
         shared_ptr<Matcher> _subMatcher;
         bool _subMatcherOnPrimitives ;
@@ -123,10 +129,15 @@ namespace mongo {
        TODO: we should rewrite the matcher to be more an AST style.
     */
     class Matcher : boost::noncopyable {
+        /** topIndex, when supplied, is a field table for obj that the caller built
+            once and is sharing across all this document's predicates, so each one
+            resolves its top level field without a fresh scan of the document.
+            recursive calls descend into subobjects and pass 0. */
         int matchesDotted(
             const char *fieldName,
             const BSONElement& toMatch, const BSONObj& obj,
-            int compareOp, const ElementMatcher& bm, bool isArr , MatchDetails * details );
+            int compareOp, const ElementMatcher& bm, bool isArr , MatchDetails * details ,
+            BSONObjFieldIndex *topIndex = 0 );
 
         /**
          * Perform a NE or NIN match by returning the inverse of the opposite matching operation.
@@ -135,7 +146,8 @@ namespace mongo {
         int inverseMatch(
             const char *fieldName,
             const BSONElement &toMatch, const BSONObj &obj,
-            const ElementMatcher&bm, MatchDetails * details );
+            const ElementMatcher&bm, MatchDetails * details ,
+            BSONObjFieldIndex *topIndex = 0 );
 
     public:
         static int opDirection(int op) {
@@ -187,6 +199,20 @@ namespace mongo {
 
         int valuesMatch(const BSONElement& l, const BSONElement& r, int op, const ElementMatcher& bm);
 
+        /** one entry of the compiled fast path for simple top level predicates.
+            see _compileQuick() / _quickMatches() in matcher.cpp.
+        */
+        struct QuickMatch {
+            const char *fieldName; // points into _jsobj, which we hold
+            BSONElement rhs;
+            int op;                // Equality, LT, LTE, GT, GTE only
+            int rhsType;
+            int rhsCanonical;
+        };
+        void _compileQuick();
+        int _quickMatches( const BSONObj &jsobj ) const; // 1 match, 0 mismatch, -1 use general path
+        bool _matchBasics( const BSONObj &jsobj, MatchDetails *details ); // general path
+
         bool parseClause( const BSONElement &e );
         void parseExtractedClause( const BSONElement &e, list< shared_ptr< Matcher > > &matchers );
 
@@ -197,6 +223,8 @@ namespace mongo {
         BSONObj _jsobj;                  // the query pattern.  e.g., { name: "joe" }
         BSONObj _constrainIndexKey;
         vector<ElementMatcher> _basics;
+        bool _quickOk;             // every basic predicate is in the compiled table
+        vector<QuickMatch> _quick; // compiled form of _basics, equality predicates first
         bool _haveSize;
         bool _all;
         bool _hasArray;
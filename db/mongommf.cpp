@@ -26,6 +26,7 @@
 #include "dur.h"
 #include "dur_journalformat.h"
 #include "../util/mongoutils/str.h"
+#include "../util/text.h"
 
 using namespace mongoutils;
 
@@ -132,16 +133,103 @@ namespace mongo {
         return p;
 #endif
     }
+
+    void MemoryMappedFile::remapPrivateViewRange(void *oldPrivateAddr, size_t ofs, size_t sz) {
+        dbMutex.assertWriteLocked();
+        scoped_lock lk(mapViewMutex);
+
+        size_t start = ((size_t)oldPrivateAddr) + ofs;
+
+        // clear the writable bits for the covered chunks; the next write there
+        // re-protects lazily via makeChunkWritable
+        for( unsigned i = (unsigned)(start/ChunkSize); i <= (unsigned)((start+sz-1)/ChunkSize); i++ )
+            writable.clear(i);
+
+        DWORD old;
+        bool ok = VirtualProtect((void*)start, (SIZE_T) sz, PAGE_READONLY, &old);
+        if( !ok ) {
+            DWORD e = GetLastError();
+            log() << "VirtualProtect failed in remapPrivateViewRange " << filename() << hex << start << ' ' << sz << ' ' << errnoWithDescription(e) << endl;
+            assert(false);
+        }
+    }
 #endif
 
+    void MongoMMF::noteWritten(size_t ofs, unsigned len) {
+        unsigned a = (unsigned) (ofs / RemapChunkSize);
+        unsigned b = (unsigned) ((ofs + len - 1) / RemapChunkSize);
+        for( unsigned c = a; c <= b && c < _chunkWritten.size(); c++ ) {
+            if( !_chunkWritten[c] ) // usually already set; don't dirty the cache line again
+                _chunkWritten[c] = 1;
+        }
+    }
+
+    void MongoMMF::noteWrittenToShared(size_t ofs, unsigned len) {
+        unsigned a = (unsigned) (ofs / FlushChunkSize);
+        unsigned b = (unsigned) ((ofs + len - 1) / FlushChunkSize);
+        for( unsigned c = a; c <= b && c < _chunkDirtiedAt.size(); c++ ) {
+            if( !_chunkDirtiedAt[c] )
+                _chunkDirtiedAt[c] = curTimeMicros64();
+        }
+    }
+
+    /** flush (async) dirty chunks first written before olderThan.  the stamp is
+        cleared before the msync so a write racing in behind us re-marks the
+        chunk; a stale flush of a page that gets redirtied is harmless as the
+        periodic full sync remains the durability deadline.
+        @return number of chunks flushed
+    */
+    int MongoMMF::flushDirtyChunks(unsigned long long olderThan, int maxChunks) {
+        int n = 0;
+        unsigned long long totalLen = length();
+        for( unsigned c = 0; c < _chunkDirtiedAt.size() && n < maxChunks; c++ ) {
+            unsigned long long when = _chunkDirtiedAt[c];
+            if( when == 0 || when > olderThan )
+                continue;
+            _chunkDirtiedAt[c] = 0;
+            size_t ofs = (size_t) c * FlushChunkSize;
+            size_t sz = (size_t) min((unsigned long long)FlushChunkSize, totalLen - ofs);
+            flushRange(ofs, (unsigned) sz, false);
+            n++;
+        }
+        return n;
+    }
+
+    int MongoMMF::trickleFlush(int maxMB) {
+        int maxChunks = (int) (((unsigned long long)maxMB * 1024 * 1024) / FlushChunkSize);
+        if( maxChunks <= 0 )
+            return 0;
+
+        // let very recent writes sit a moment - they are often about to be
+        // written again and the journal already made them durable
+        unsigned long long olderThan = curTimeMicros64() - 2 * 1000 * 1000;
+
+        int n = 0;
+        RWLockRecursive::Shared lk(mmmutex);
+        for( set<MongoFile*>::iterator i = mmfiles.begin(); i != mmfiles.end() && n < maxChunks; i++ ) {
+            if( !(*i)->isMongoMMF() )
+                continue;
+            n += ((MongoMMF*)*i)->flushDirtyChunks(olderThan, maxChunks - n);
+        }
+        return (int) (((unsigned long long)n * FlushChunkSize) / (1024 * 1024));
+    }
+
     void MongoMMF::remapThePrivateView() {
         assert( cmdLine.dur );
 
-        // todo 1.9 : it turns out we require that we always remap to the same address.
-        // so the remove / add isn't necessary and can be removed
-        privateViews.remove(_view_private);
-        _view_private = remapPrivateView(_view_private);
-        privateViews.add(_view_private, this);
+        // remap only the chunks written to since the last remap -- the others have
+        // no copy-on-write pages so remapping them would be wasted syscalls.  the
+        // view address never changes (MAP_FIXED / VirtualProtect in place), so the
+        // privateViews registration stays valid.
+        unsigned long long totalLen = length();
+        for( unsigned c = 0; c < _chunkWritten.size(); c++ ) {
+            if( !_chunkWritten[c] )
+                continue;
+            _chunkWritten[c] = 0;
+            size_t ofs = (size_t) c * RemapChunkSize;
+            size_t sz = (size_t) min((unsigned long long)RemapChunkSize, totalLen - ofs);
+            remapPrivateViewRange(_view_private, ofs, sz);
+        }
     }
 
     /** register view. threadsafe */
@@ -209,6 +297,44 @@ namespace mongo {
 
     PointerToMMF privateViews;
 
+    PointerToMMF ephemeralViews;
+
+    /** the database name component of a datafile path: "foo" for "/data/db/foo.3" or "a/foo.ns" */
+    static string dbNameOfPath(const string& fname) {
+        size_t slash = fname.find_last_of("/\\");
+        string leaf = slash == string::npos ? fname : fname.substr(slash + 1);
+        size_t dot = leaf.find_last_of('.');
+        return dot == string::npos ? leaf : leaf.substr(0, dot);
+    }
+
+    bool MongoMMF::isEphemeralPath(const string& fname) {
+        if( cmdLine.ephemeralDbs.empty() )
+            return false;
+        string db = dbNameOfPath(fname);
+        StringSplitter ss( cmdLine.ephemeralDbs.c_str() , "," );
+        while( ss.more() ) {
+            if( ss.next() == db )
+                return true;
+        }
+        return false;
+    }
+
+    /** back this MongoMMF with an anonymous zeroed arena rather than a file.  there is a
+        single view, so reads and writes are immediately coherent with no journaling, no
+        private view remapping and no write-back - the contents simply vanish on close.
+    */
+    bool MongoMMF::createEphemeralArena(string fname, unsigned long long len) {
+        void *p = calloc( 1, (size_t) len ); // calloc: a new datafile must read as zero filled
+        massert( 16302, str::stream() << "couldn't allocate " << len << " bytes in memory for ephemeral db file " << fname, p != 0 );
+        setFilename(fname);
+        setLength(len);
+        _view_write = _view_private = p;
+        _ephemeral = true;
+        ephemeralViews.add(p, this);
+        log() << "allocated " << (len / 1024 / 1024) << "MB in-memory arena for ephemeral db file " << fname << endl;
+        return true;
+    }
+
     /* void* MongoMMF::switchToPrivateView(void *readonly_ptr) {
         assert( cmdLine.dur );
         assert( testIntent );
@@ -268,6 +394,8 @@ namespace mongo {
 
     bool MongoMMF::open(string fname, bool sequentialHint) {
         LOG(3) << "mmf open " << fname << endl;
+        uassert( 16301, str::stream() << fname << " exists on disk but its database is listed in --ephemeralDbs - remove the old files to run it ephemerally",
+                 !isEphemeralPath(fname) );
         setPath(fname);
         _view_write = mapWithOptions(fname.c_str(), sequentialHint ? SEQUENTIAL : 0);
         return finishOpening();
@@ -276,6 +404,8 @@ namespace mongo {
     bool MongoMMF::create(string fname, unsigned long long& len, bool sequentialHint) {
         LOG(3) << "mmf create " << fname << endl;
         setPath(fname);
+        if( isEphemeralPath(fname) )
+            return createEphemeralArena(fname, len);
         _view_write = map(fname.c_str(), len, sequentialHint ? SEQUENTIAL : 0);
         return finishOpening();
     }
@@ -289,6 +419,10 @@ namespace mongo {
                     msgasserted(13636, str::stream() << "file " << filename() << " open/create failed in createPrivateMap (look in log for more information)");
                 }
                 privateViews.add(_view_private, this); // note that testIntent builds use this, even though it points to view_write then...
+                _chunkWritten.clear();
+                _chunkWritten.resize( (size_t) ((length() + RemapChunkSize - 1) / RemapChunkSize), 0 );
+                _chunkDirtiedAt.clear();
+                _chunkDirtiedAt.resize( (size_t) ((length() + FlushChunkSize - 1) / FlushChunkSize), 0 );
             }
             else {
                 _view_private = _view_write;
@@ -298,7 +432,7 @@ namespace mongo {
         return false;
     }
 
-    MongoMMF::MongoMMF() : _willNeedRemap(false) {
+    MongoMMF::MongoMMF() : _ephemeral(false), _willNeedRemap(false) {
         _view_write = _view_private = 0;
     }
 
@@ -317,7 +451,7 @@ namespace mongo {
         LOG(3) << "mmf close " << filename() << endl;
 
         if( view_write() /*actually was opened*/ ) {
-            if( cmdLine.dur ) {
+            if( cmdLine.dur && !_ephemeral ) {
                 dur::closingFileNotification();
             }
             if( !dbMutex.isWriteLocked() ) { 
@@ -329,7 +463,14 @@ namespace mongo {
         }
 
         RWLockRecursive::Exclusive lk(mmmutex);
-        privateViews.remove(_view_private);
+        if( _ephemeral ) {
+            ephemeralViews.remove(_view_write);
+            free(_view_write);
+            _ephemeral = false;
+        }
+        else {
+            privateViews.remove(_view_private);
+        }
         _view_write = _view_private = 0;
         MemoryMappedFile::close();
     }
@@ -43,7 +43,7 @@ namespace mongo {
 
         string filename() const { return MemoryMappedFile::filename(); }
 
-        void flush(bool sync)   { MemoryMappedFile::flush(sync); }
+        void flush(bool sync)   { if( !_ephemeral ) MemoryMappedFile::flush(sync); }
 
         /* Creates with length if DNE, otherwise uses existing file length,
            passed length.
@@ -52,6 +52,14 @@ namespace mongo {
         */
         bool create(string fname, unsigned long long& len, bool sequentialHint);
 
+        /** true if this "file" is really an anonymous in-memory arena for an
+            ephemeral database (--ephemeralDbs).  there is a single view, nothing
+            on disk, and writes to it are never journaled or flushed. */
+        bool isEphemeral() const { return _ephemeral; }
+
+        /** @return true if fname belongs to a database listed in --ephemeralDbs */
+        static bool isEphemeralPath(const string& fname);
+
         /* Get the "standard" view (which is the private one).
            @return the private view.
         */
@@ -88,15 +96,52 @@ namespace mongo {
         */
         bool& willNeedRemap() { return _willNeedRemap; }
 
+        /** we remap the private view in chunks so that REMAPPRIVATEVIEW only
+            touches the regions that actually have copy-on-write pages.
+        */
+        static const unsigned RemapChunkSize = 64 * 1024 * 1024;
+
+        /** note a journaled write into [ofs,ofs+len) of the private view.  set in
+            PREPLOGBUFFER alongside willNeedRemap(); the marked chunks are the only
+            ones remapThePrivateView() touches.
+        */
+        void noteWritten(size_t ofs, unsigned len);
+
+        /** granularity of the dirty tracking used by the trickle flusher.
+            smaller than RemapChunkSize so a syncdelay's worth of writes can be
+            spread over many small msyncs.
+        */
+        static const unsigned FlushChunkSize = 8 * 1024 * 1024;
+
+        /** note a write into [ofs,ofs+len) of the shared view.  called from
+            WRITETODATAFILES; stamps the covered chunks with the time they first
+            became dirty so trickleFlush can sync oldest-first.
+        */
+        void noteWrittenToShared(size_t ofs, unsigned len);
+
+        /** async-flush up to maxMB of the oldest dirty chunks across all mapped
+            files.  called about once a second by the dataFileSync thread so the
+            periodic full sync finds most pages already on their way to disk.
+            @return MB queued for flushing
+        */
+        static int trickleFlush(int maxMB);
+
         void remapThePrivateView();
 
         virtual bool isMongoMMF() { return true; }
 
     private:
 
+        bool createEphemeralArena(string fname, unsigned long long len);
+
         void *_view_write;
         void *_view_private;
+        bool _ephemeral;
         bool _willNeedRemap;
+        vector<unsigned char> _chunkWritten; // 1 per RemapChunkSize chunk written since last remap
+        vector<unsigned long long> _chunkDirtiedAt; // per FlushChunkSize chunk: micros when first dirtied, 0=clean
+
+        int flushDirtyChunks(unsigned long long olderThan, int maxChunks);
         RelativePath _p;   // e.g. "somepath/dbname"
         int _fileSuffixNo;  // e.g. 3.  -1="ns"
 
@@ -142,4 +187,8 @@ namespace mongo {
 
     // allows a pointer into any private view of a MongoMMF to be resolved to the MongoMMF object
     extern PointerToMMF privateViews;
+
+    // resolves pointers into the in-memory arenas of ephemeral databases (--ephemeralDbs).
+    // consulted on the cold path only - when a write intent fails to resolve in privateViews.
+    extern PointerToMMF ephemeralViews;
 }
@@ -28,6 +28,7 @@
 #pragma once
 
 #include "../util/concurrency/rwlock.h"
+#include "../util/concurrency/batch_rwlock.h"
 #include "../util/mmap.h"
 #include "../util/time_support.h"
 
@@ -36,14 +37,18 @@ namespace mongo {
     class Client;
     Client* curopWaitingForLock( int type );
     void curopGotLock(Client*);
+    /** record a finished write lock hold into the lock profiler, attributed to
+        the current op.  defined in client.cpp; called with the lock still held. */
+    void lockProfilerRecordWriteLock( unsigned long long holdMicros , unsigned long long waitMicros );
 
     /* mongomutex time stats */
     class MutexInfo {
         unsigned long long enter, timeLocked; // microseconds
+        unsigned long long timeAcquiring;     // micros write lockers spent waiting
         int locked;
         unsigned long long start; // last as we touch this least often
     public:
-        MutexInfo() : timeLocked(0) , locked(0) {
+        MutexInfo() : timeLocked(0) , timeAcquiring(0) , locked(0) {
             start = curTimeMicros64();
         }
         void entered() {
@@ -59,11 +64,13 @@ namespace mongo {
                 timeLocked += curTimeMicros64() - enter;
         }
         int isLocked() const { return locked; }
+        void acquired( unsigned long long micros ) { timeAcquiring += micros; }
         void getTimingInfo(unsigned long long &s, unsigned long long &tl) const {
             s = start;
             tl = timeLocked;
         }
         unsigned long long getTimeLocked() const { return timeLocked; }
+        unsigned long long getTimeAcquiring() const { return timeAcquiring; }
     };
 
     /** the 'big lock'. a read/write lock.
@@ -86,6 +93,13 @@ namespace mongo {
         int getState() const { return _state.get(); }
 
         bool atLeastReadLocked() const { return _state.get() != 0; }
+
+        /** true if a writer holds or is queued for the lock.  if our thread is
+            read locked, that writer is waiting on us.  cheap (one load). */
+        bool writerWaiting() const { return _m.writerWanted(); }
+
+        /** readers currently in the lock.  advisory; see BatchRWLock::readerCount. */
+        unsigned readerCount() const { return _m.readerCount(); }
         void assertAtLeastReadLocked() const { assert(atLeastReadLocked()); }
         bool isWriteLocked/*by our thread*/() const { return getState() > 0; }
         void assertWriteLocked() const {
@@ -101,7 +115,11 @@ namespace mongo {
             _state.set(1);
 
             Client *c = curopWaitingForLock( 1 ); // stats
+            unsigned long long t = curTimeMicros64();
             _m.lock();
+            _holdStart = curTimeMicros64();
+            _holdWait = _holdStart - t;
+            _minfo.acquired( _holdWait );
             curopGotLock(c);
 
             _minfo.entered();
@@ -117,9 +135,13 @@ namespace mongo {
                 return true;
 
             Client *c = curopWaitingForLock( 1 );
+            unsigned long long t = curTimeMicros64();
             bool got = _m.lock_try( millis );
 
             if ( got ) {
+                _holdStart = curTimeMicros64();
+                _holdWait = _holdStart - t;
+                _minfo.acquired( _holdWait );
                 curopGotLock(c);
                 _minfo.entered();
                 _state.set(1);
@@ -148,6 +170,9 @@ namespace mongo {
             MongoFile::unmarkAllWritable(); // _DEBUG validation
             _state.set(0);
             _minfo.leaving();
+            // profile while still exclusive - holders are serialized, so the
+            // profiler's ring buffer needs no locking of its own
+            lockProfilerRecordWriteLock( curTimeMicros64() - _holdStart , _holdWait );
             _m.unlock();
         }
 
@@ -226,7 +251,7 @@ namespace mongo {
         /* @return true if was already write locked.  increments recursive lock count. */
         bool _writeLockedAlready();
 
-        RWLock _m;
+        BatchRWLock _m;
 
         /* > 0 write lock with recurse count
            < 0 read lock
@@ -235,6 +260,11 @@ namespace mongo {
 
         MutexInfo _minfo;
 
+        // for the lock profiler.  written after acquiring the write lock and
+        // read just before releasing it, so access is always exclusive
+        unsigned long long _holdStart;
+        unsigned long long _holdWait;
+
     public:
         // indicates we need to call dur::REMAPPRIVATEVIEW on the next write lock
         bool _remapPrivateViewRequested;
@@ -29,6 +29,7 @@
 #include "json.h"
 #include "ops/delete.h"
 #include "ops/query.h"
+#include "instance.h"
 
 
 namespace mongo {
@@ -39,13 +40,31 @@ namespace mongo {
 
     /* deleted lists -- linked lists of deleted records -- are placed in 'buckets' of various sizes
        so you can look for a deleterecord about the right size.
+
+       sorted logical size classes.  the in-between (non power of two) classes are finer grained
+       buckets for the record sizes that dominate most workloads; with an exact-ish class per
+       size the allocator rarely has to walk a chain looking for a fit.
     */
     int bucketSizes[] = {
-        32, 64, 128, 256, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000,
-        0x8000, 0x10000, 0x20000, 0x40000, 0x80000, 0x100000, 0x200000,
-        0x400000, 0x800000
+        32, 48, 64, 96, 128, 192, 256, 384, 0x200, 0x300, 0x400, 0x600, 0x800, 0xc00,
+        0x1000, 0x2000, 0x4000, 0x8000, 0x10000, 0x20000, 0x40000, 0x80000, 0x100000,
+        0x200000, 0x400000, 0x800000
+    };
+
+    /* logical bucket index -> slot in NamespaceDetails.  the legacy power of two classes keep
+       their original deletedList[] slots (so old data files stay readable); the finer classes
+       were added later and live in deletedListFine[] where reserved bytes used to be.  note a
+       record's bucket is only a sizing hint -- the allocator always checks lengthWithHeaders --
+       so records bucketed by an older mongod are simply found a bucket or two later.
+    */
+    int bucketSlots[] = {
+        0, 19, 1, 20, 2, 21, 3, 22, 4, 23, 5, 24, 6, 25, 7, 8,
+        9, 10, 11, 12, 13, 14, 15, 16, 17, 18
     };
 
+    BOOST_STATIC_ASSERT( sizeof(bucketSizes) / sizeof(bucketSizes[0]) == AllocBuckets );
+    BOOST_STATIC_ASSERT( sizeof(bucketSlots) / sizeof(bucketSlots[0]) == AllocBuckets );
+
     NamespaceDetails::NamespaceDetails( const DiskLoc &loc, bool _capped ) {
         /* be sure to initialize new fields here -- doesn't default to zeroes the way we use it */
         firstExtent = lastExtent = capExtent = loc;
@@ -201,6 +220,44 @@ namespace mongo {
         ht = new HashTable<Namespace,NamespaceDetails>(p, (int) len, "namespace index");
         if( checkNsFilesOnLoad )
             ht->iterAll(namespaceOnLoadCallback);
+
+        _nsCache.clear();
+        ht->iterAll( _cachePopulateCallback , this );
+    }
+
+    NamespaceDetails* NamespaceIndex::_cachedDetails(const Namespace& n) {
+        map<int,HT::Node*>::const_iterator it = _nsCache.find( n.hash() );
+        if( it == _nsCache.end() )
+            return 0; // the cache is exhaustive - no entry for the hash means not present
+        HT::Node *node = it->second;
+        if( node && node->k == n )
+            return &node->value;
+        // hash collision between namespaces (or defensive miss) - probe the real table
+        return ht->get(n);
+    }
+
+    void NamespaceIndex::_cacheAdd(const Namespace& n) {
+        HT::Node *node = ht->getNode(n);
+        if( !node )
+            return;
+        pair<map<int,HT::Node*>::iterator,bool> r = _nsCache.insert( make_pair( n.hash() , node ) );
+        if( !r.second && r.first->second != node ) {
+            // two live namespaces share a hash; mark the slot ambiguous so
+            // lookups for either fall back to the table
+            r.first->second = 0;
+        }
+    }
+
+    void NamespaceIndex::_cacheKill(const Namespace& n) {
+        map<int,HT::Node*>::iterator it = _nsCache.find( n.hash() );
+        if( it != _nsCache.end() && it->second && it->second->k == n )
+            _nsCache.erase(it);
+        // an ambiguous (null) entry stays - the surviving namespace with this
+        // hash still needs lookups to consult the table
+    }
+
+    void NamespaceIndex::_cachePopulateCallback( const Namespace& k , NamespaceDetails& v , void * extra ) {
+        ((NamespaceIndex*)extra)->_cacheAdd( k );
     }
 
     static void namespaceGetNamespacesCallback( const Namespace& k , NamespaceDetails& v , void * extra ) {
@@ -247,7 +304,7 @@ namespace mongo {
         }
         else {
             int b = bucket(d->lengthWithHeaders);
-            DiskLoc& list = deletedList[b];
+            DiskLoc& list = deletedListEntry(b);
             DiskLoc oldHead = list;
             getDur().writingDiskLoc(list) = dloc;
             d->nextDeleted = oldHead;
@@ -302,6 +359,13 @@ namespace mongo {
                 return loc;
             }
         }
+        else if ( left < 24 ) {
+            // exact-ish fit from the capped slot reuse fast path (see cappedAlloc).
+            // that path guarantees the extent keeps a deleted record, so we need
+            // not carve off a sliver here -- and must not: it would be too small
+            // to be a valid DeletedRecord.
+            return loc;
+        }
 
         /* split off some for further use. */
         getDur().writingInt(r->lengthWithHeaders) = lenToAlloc;
@@ -328,8 +392,8 @@ namespace mongo {
         DiskLoc bestmatch;
         int bestmatchlen = 0x7fffffff;
         int b = bucket(len);
-        DiskLoc cur = deletedList[b];
-        prev = &deletedList[b];
+        DiskLoc cur = deletedListEntry(b);
+        prev = &deletedListEntry(b);
         int extra = 5; // look for a better fit, a little.
         int chain = 0;
         while ( 1 ) {
@@ -353,8 +417,8 @@ namespace mongo {
                     // out of space. alloc a new extent.
                     return DiskLoc();
                 }
-                cur = deletedList[b];
-                prev = &deletedList[b];
+                cur = deletedListEntry(b);
+                prev = &deletedListEntry(b);
                 continue;
             }
             DeletedRecord *r = cur.drec();
@@ -396,8 +460,8 @@ namespace mongo {
     }
 
     void NamespaceDetails::dumpDeleted(set<DiskLoc> *extents) {
-        for ( int i = 0; i < Buckets; i++ ) {
-            DiskLoc dl = deletedList[i];
+        for ( int i = 0; i < AllocBuckets; i++ ) {
+            DiskLoc dl = deletedListEntry(i);
             while ( !dl.isNull() ) {
                 DeletedRecord *r = dl.drec();
                 DiskLoc extLoc(dl.a(), r->extentOfs);
@@ -461,11 +525,13 @@ namespace mongo {
         if ( !ht )
             return;
         Namespace n(ns);
+        _cacheKill(n); // before kill() wipes the node's key
         ht->kill(n);
 
         for( int i = 0; i<=1; i++ ) {
             try {
                 Namespace extra(n.extraName(i).c_str());
+                _cacheKill(extra);
                 ht->kill(extra);
             }
             catch(DBException&) { }
@@ -484,6 +550,7 @@ namespace mongo {
         NamespaceDetails::Extra temp;
         temp.init();
         uassert( 10082 ,  "allocExtra: too many namespaces/collections", ht->put(extra, (NamespaceDetails&) temp));
+        _cacheAdd(extra);
         NamespaceDetails::Extra *e = (NamespaceDetails::Extra *) ht->get(extra);
         return e;
     }
@@ -601,6 +668,7 @@ namespace mongo {
         clearQueryCache();
         _keysComputed = false;
         _indexSpecs.clear();
+        _storageStatsValid = false;
     }
 
     void NamespaceDetailsTransient::clearForPrefix(const char *prefix) {
@@ -636,6 +704,128 @@ namespace mongo {
             i.next().keyPattern().getFieldNames(_indexKeys);
     }
 
+    namespace {
+        boost::filesystem::path queryCachePath() {
+            boost::filesystem::path p( dbpath );
+            p /= "querycache.bson";
+            return p;
+        }
+    }
+
+    void NamespaceDetailsTransient::persistQueryCaches() {
+        try {
+            BufBuilder b;
+            int n = 0;
+            {
+                SimpleMutex::scoped_lock lk( _qcMutex );
+                for( ouriter i = _nsdMap.begin(); i != _nsdMap.end(); ++i ) {
+                    NamespaceDetailsTransient *t = i->second.get();
+                    if ( t == 0 )
+                        continue;
+                    for( map< QueryPattern, CachedQueryPlan >::const_iterator j = t->_qcCache.begin(); j != t->_qcCache.end(); ++j ) {
+                        if ( t->_qcWriteCount - j->second.registeredAtWrite >= WritesBetweenReplan )
+                            continue; // due for a re-race anyway; don't resurrect it
+                        BSONObjBuilder e;
+                        e.append( "ns", i->first );
+                        e.append( "pattern", j->first.toBson() );
+                        e.append( "index", j->second.indexKey );
+                        e.appendNumber( "nScanned", j->second.nScanned );
+                        BSONObj o = e.obj();
+                        b.appendBuf( o.objdata(), o.objsize() );
+                        ++n;
+                    }
+                }
+            }
+            boost::filesystem::path p = queryCachePath();
+            if ( n == 0 ) {
+                // don't leave a stale file around to reload next time
+                if ( boost::filesystem::exists( p ) )
+                    boost::filesystem::remove( p );
+                return;
+            }
+            ofstream f( p.string().c_str(), ios_base::out | ios_base::binary | ios_base::trunc );
+            f.write( b.buf(), b.len() );
+            if ( !f ) {
+                log() << "warning: couldn't write " << p.string() << endl;
+                return;
+            }
+            log() << "shutdown: persisted " << n << " recorded query plans" << endl;
+        }
+        catch ( const std::exception &e ) {
+            log() << "warning: failed persisting query plan cache: " << e.what() << endl;
+        }
+    }
+
+    void NamespaceDetailsTransient::loadPersistedQueryCaches() {
+        boost::filesystem::path p = queryCachePath();
+        if ( !boost::filesystem::exists( p ) )
+            return;
+        try {
+            unsigned long long len = boost::filesystem::file_size( p );
+            boost::scoped_array<char> data( new char[ len ] );
+            ifstream f( p.string().c_str(), ios_base::in | ios_base::binary );
+            f.read( data.get(), len );
+            if ( !f ) {
+                log() << "warning: couldn't read " << p.string() << endl;
+                return;
+            }
+
+            vector< string > dbNames;
+            getDatabaseNames( dbNames );
+            set< string > existingDbs( dbNames.begin(), dbNames.end() );
+
+            int loaded = 0, skipped = 0;
+            dblock lk;
+            const char *q = data.get();
+            const char *end = q + len;
+            while ( end - q >= 5 ) {
+                BSONObj o( q );
+                if ( o.objsize() < 5 || o.objsize() > end - q )
+                    break; // truncated or corrupt; keep what we have
+                q += o.objsize();
+
+                string ns = o.getStringField( "ns" );
+                BSONObj index = o.getObjectField( "index" ).getOwned();
+                if ( ns.empty() || index.isEmpty() || existingDbs.count( nsToDatabase( ns ) ) == 0 ) {
+                    ++skipped;
+                    continue;
+                }
+                Client::Context ctx( ns );
+                NamespaceDetails *d = nsdetails( ns.c_str() );
+                if ( d == 0 ) {
+                    ++skipped;
+                    continue;
+                }
+                // only reload plans whose index still exists - the optimizer
+                // masserts if a recorded index can't be found (10368)
+                bool indexOk = strcmp( index.firstElementFieldName(), "$natural" ) == 0;
+                if ( !indexOk ) {
+                    NamespaceDetails::IndexIterator i = d->ii();
+                    while( i.more() ) {
+                        if ( i.next().keyPattern().woCompare( index ) == 0 ) {
+                            indexOk = true;
+                            break;
+                        }
+                    }
+                }
+                if ( !indexOk ) {
+                    ++skipped;
+                    continue;
+                }
+                SimpleMutex::scoped_lock qlk( _qcMutex );
+                get_inlock( ns.c_str() ).registerIndexForPattern( QueryPattern::fromBson( o.getObjectField( "pattern" ) ), index, o["nScanned"].numberLong() );
+                ++loaded;
+            }
+            if ( skipped )
+                log() << "loaded " << loaded << " persisted query plans (" << skipped << " stale, dropped)" << endl;
+            else
+                log() << "loaded " << loaded << " persisted query plans" << endl;
+        }
+        catch ( const std::exception &e ) {
+            log() << "warning: failed loading persisted query plan cache: " << e.what() << endl;
+        }
+    }
+
 
     /* ------------------------------------------------------------------------- */
 
@@ -80,11 +80,20 @@ namespace mongo {
 
     /* deleted lists -- linked lists of deleted records -- are placed in 'buckets' of various sizes
        so you can look for a deleterecord about the right size.
+
+       Buckets is the number of legacy (power of two) size classes; they keep their original
+       slots in NamespaceDetails so old data files stay readable.  FineBuckets are in-between
+       size classes added later (they live where reserved bytes used to be - zeroed, thus empty,
+       on old files).  AllocBuckets is the total; bucket indices used by the allocation code are
+       logical, sorted by size, and mapped to their on-disk slot via bucketSlots[].
     */
     const int Buckets = 19;
-    const int MaxBucket = 18;
+    const int FineBuckets = 7;
+    const int AllocBuckets = Buckets + FineBuckets;
+    const int MaxBucket = AllocBuckets - 1;
 
     extern int bucketSizes[];
+    extern int bucketSlots[];
 
 #pragma pack(1)
     /* NamespaceDetails : this is the "header" for a collection that has all its details.
@@ -140,7 +149,8 @@ namespace mongo {
             unsigned long long cc2_ptr;       // see capped.cpp
             unsigned fileNumber;
         } capped2;
-        char reserved[60];
+        DiskLoc deletedListFine[FineBuckets]; // finer deleted record size classes; see bucketSizes[]
+        char reserved[4];
         /*-------- end data 496 bytes */
 
         explicit NamespaceDetails( const DiskLoc &loc, bool _capped );
@@ -345,12 +355,29 @@ namespace mongo {
             return (flags & NamespaceDetails::Flag_HaveIdIndex) || findIdIndex() >= 0;
         }
 
-        /* return which "deleted bucket" for this size object */
+        /* return which "deleted bucket" (logical index, sorted by size) for this size object */
         static int bucket(int n) {
-            for ( int i = 0; i < Buckets; i++ )
+            for ( int i = 0; i < AllocBuckets; i++ )
                 if ( bucketSizes[i] > n )
                     return i;
-            return Buckets-1;
+            return AllocBuckets-1;
+        }
+
+        /* head of the deleted record chain for a logical bucket index */
+        DiskLoc& deletedListEntry(int bucket) {
+            dassert( bucket >= 0 && bucket < AllocBuckets );
+            int slot = bucketSlots[bucket];
+            if ( slot < Buckets )
+                return deletedList[slot];
+            DiskLoc& fine = deletedListFine[slot - Buckets];
+            // a .ns file written before the fine buckets existed has zeroed
+            // bytes here.  0:0 is not the null DiskLoc (null is a==-1), and
+            // following it would read a datafile header as a deleted record,
+            // so null such heads out the first time they are seen.  0:0 can
+            // never be a real head - offset 0 of a file is its header.
+            if ( fine.a() == 0 && fine.getOfs() == 0 )
+                getDur().writingDiskLoc( fine ).Null();
+            return fine;
         }
 
         /* predetermine location of the next alloc without actually doing it. 
@@ -425,7 +452,7 @@ namespace mongo {
         void reset();
         static std::map< string, shared_ptr< NamespaceDetailsTransient > > _nsdMap;
     public:
-        NamespaceDetailsTransient(const char *ns) : _ns(ns), _keysComputed(false), _qcWriteCount() { }
+        NamespaceDetailsTransient(const char *ns) : _ns(ns), _keysComputed(false), _qcWriteCount(), _storageStatsValid(false) { }
     public:
         void addedIndex() { assertInWriteLock(); reset(); }
         void deletedIndex() { assertInWriteLock(); reset(); }
@@ -473,6 +500,35 @@ namespace mongo {
             return _indexKeys;
         }
 
+        /* storage stats cache (collStats / dbStats) ---------------------------- */
+        /* stats.datasize and stats.nrecords are maintained incrementally already;
+           the expensive part of the stats commands is storageSize(), which walks
+           the whole extent chain and faults in cold extent headers.  the chain
+           only changes when an extent is added or released, so we cache the walk
+           here and invalidate at those (rare) points.  monitoring that polls
+           stats across thousands of namespaces then never touches an extent. */
+    private:
+        bool _storageStatsValid;
+        long long _storageSize;
+        int _numExtents;
+    public:
+        /** storageSize()/numExtents for d, served from the cache when valid.
+            caller must hold at least a read lock (as for storageSize itself).
+            concurrent readers may both fill the cache, but the chain can't
+            change under the read lock so they store identical values. */
+        long long cachedStorageSize( const NamespaceDetails * d , int * numExtents = 0 ) {
+            if ( ! _storageStatsValid ) {
+                _numExtents = 0;
+                _storageSize = d->storageSize( &_numExtents );
+                _storageStatsValid = true;
+            }
+            if ( numExtents )
+                *numExtents = _numExtents;
+            return _storageSize;
+        }
+        /** call (in write lock) whenever this namespace's extent chain changes */
+        void clearStorageStats() { _storageStatsValid = false; }
+
         /* IndexSpec caching */
     private:
         map<const IndexDetails*,IndexSpec> _indexSpecs;
@@ -492,8 +548,30 @@ namespace mongo {
 
         /* query cache (for query optimizer) ------------------------------------- */
     private:
-        int _qcWriteCount;
-        map< QueryPattern, pair< BSONObj, long long > > _qcCache;
+        /** the winning plan recorded for a query shape, with the bookkeeping for a
+            works-based staleness policy.  rather than dropping the whole cache every
+            N writes, an entry stays usable until the collection has seen enough
+            writes since it was recorded that its cost estimate (nScanned) is suspect,
+            and then just that pattern is re-raced.
+        */
+        struct CachedQueryPlan {
+            CachedQueryPlan() : nScanned(), registeredAtWrite() { }
+            BSONObj indexKey;            // winning index key pattern; empty = $natural / none
+            long long nScanned;          // works measured when this plan won its race
+            long long registeredAtWrite; // _qcWriteCount value at registration
+        };
+        enum { MaxCachedPatterns = 500, WritesBetweenReplan = 10000 };
+        long long _qcWriteCount; // monotonic; never reset except with the cache itself
+        map< QueryPattern, CachedQueryPlan > _qcCache;
+        void evictOldestPattern() {
+            map< QueryPattern, CachedQueryPlan >::iterator oldest = _qcCache.begin();
+            for( map< QueryPattern, CachedQueryPlan >::iterator i = _qcCache.begin(); i != _qcCache.end(); ++i ) {
+                if ( i->second.registeredAtWrite < oldest->second.registeredAtWrite )
+                    oldest = i;
+            }
+            if ( oldest != _qcCache.end() )
+                _qcCache.erase( oldest );
+        }
     public:
         static SimpleMutex _qcMutex;
 
@@ -516,21 +594,44 @@ namespace mongo {
         }
         /* you must notify the cache if you are doing writes, as query plan optimality will change */
         void notifyOfWriteOp() {
-            if ( _qcCache.empty() )
-                return;
-            if ( ++_qcWriteCount >= 100 )
-                clearQueryCache();
+            ++_qcWriteCount;
         }
         BSONObj indexForPattern( const QueryPattern &pattern ) {
-            return _qcCache[ pattern ].first;
+            map< QueryPattern, CachedQueryPlan >::iterator i = _qcCache.find( pattern );
+            if ( i == _qcCache.end() )
+                return BSONObj();
+            if ( _qcWriteCount - i->second.registeredAtWrite >= WritesBetweenReplan ) {
+                // enough writes since this plan won that its cost estimate is suspect;
+                // evict so the optimizer re-races this pattern (others are untouched)
+                _qcCache.erase( i );
+                return BSONObj();
+            }
+            return i->second.indexKey;
         }
         long long nScannedForPattern( const QueryPattern &pattern ) {
-            return _qcCache[ pattern ].second;
+            map< QueryPattern, CachedQueryPlan >::const_iterator i = _qcCache.find( pattern );
+            return i == _qcCache.end() ? 0 : i->second.nScanned;
         }
         void registerIndexForPattern( const QueryPattern &pattern, const BSONObj &indexKey, long long nScanned ) {
-            _qcCache[ pattern ] = make_pair( indexKey, nScanned );
+            if ( (int) _qcCache.size() >= MaxCachedPatterns && _qcCache.count( pattern ) == 0 )
+                evictOldestPattern();
+            CachedQueryPlan &c = _qcCache[ pattern ];
+            c.indexKey = indexKey;
+            c.nScanned = nScanned;
+            c.registeredAtWrite = _qcWriteCount;
         }
 
+        /** write the still-live recorded plans of every namespace to
+            <dbpath>/querycache.bson so the next startup doesn't have to re-race
+            every query shape from scratch.  called once at clean shutdown;
+            takes only _qcMutex.  best effort - failure is logged, not fatal. */
+        static void persistQueryCaches();
+        /** reload the plans written by persistQueryCaches(), dropping any whose
+            namespace or index no longer exists (possible if the previous run
+            changed the schema and then crashed before rewriting the file).
+            call at startup before accepting connections; takes the db lock. */
+        static void loadPersistedQueryCaches();
+
     }; /* NamespaceDetailsTransient */
 
     inline NamespaceDetailsTransient& NamespaceDetailsTransient::get_inlock(const char *ns) {
@@ -567,6 +668,7 @@ namespace mongo {
             init();
             Namespace n(ns);
             uassert( 10081 , "too many namespaces/collections", ht->put(n, details));
+            _cacheAdd(n);
         }
 
         /* just for diagnostics */
@@ -580,7 +682,7 @@ namespace mongo {
             if ( !ht )
                 return 0;
             Namespace n(ns);
-            NamespaceDetails *d = ht->get(n);
+            NamespaceDetails *d = _cachedDetails(n);
             if ( d && d->capped )
                 d->cappedCheckMigrate();
             return d;
@@ -612,8 +714,25 @@ namespace mongo {
     private:
         void maybeMkdir() const;
 
+        typedef HashTable<Namespace,NamespaceDetails> HT;
+
+        /* the mmapped table does linear probing with full Namespace compares over
+           628 byte nodes - a measurable cost with tens of thousands of collections.
+           _nsCache is a transient exact index over it, keyed by the precomputed
+           Namespace::hash().  node addresses are stable (open addressing) so the
+           cached pointers stay valid until kill_ns.  a null value marks a hash
+           collision between two live namespaces; those consult ht directly.
+           maintained by add/kill under the write lock, so lookups under the read
+           lock never mutate it.  exhaustive: every namespace in ht has an entry.
+        */
+        NamespaceDetails* _cachedDetails(const Namespace& n);
+        void _cacheAdd(const Namespace& n);
+        void _cacheKill(const Namespace& n);
+        static void _cachePopulateCallback( const Namespace& k , NamespaceDetails& v , void * extra );
+
         MongoMMF f;
-        HashTable<Namespace,NamespaceDetails> *ht;
+        HT *ht;
+        map<int,HT::Node*> _nsCache;
         string dir_;
         string database_;
     };
@@ -0,0 +1,167 @@
+// oparena.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "oparena.h"
+#include "client.h"
+
+namespace mongo {
+
+    OpArena::~OpArena() {
+        Chunk *c = _chunks;
+        _chunks = 0;
+        while( c ) {
+            Chunk *n = c->next;
+            free(c);
+            c = n;
+        }
+        c = _spare;
+        _spare = 0;
+        while( c ) {
+            Chunk *n = c->next;
+            free(c);
+            c = n;
+        }
+    }
+
+    OpArena::Chunk* OpArena::_newChunk(size_t sz) {
+        // reuse a retained chunk when one is big enough
+        Chunk **prev = &_spare;
+        for( Chunk *s = _spare; s; prev = &s->next, s = s->next ) {
+            if( s->cap >= sz ) {
+                *prev = s->next;
+                _spareCap -= s->cap;
+                s->used = 0;
+                s->next = _chunks;
+                _chunks = s;
+                return s;
+            }
+        }
+
+        size_t cap = ChunkSize - sizeof(Chunk);
+        if( sz > cap )
+            cap = sz; // oversized allocations get a dedicated chunk
+        Chunk *c = (Chunk*)malloc(sizeof(Chunk) + cap);
+        if( c == 0 )
+            msgasserted(16231, "out of memory OpArena");
+        c->next = _chunks;
+        c->used = 0;
+        c->cap = cap;
+        _chunks = c;
+        return c;
+    }
+
+    void* OpArena::alloc(size_t sz) {
+        sz = (sz + 7) & ~((size_t)7);
+        Chunk *c = _chunks;
+        if( c == 0 || c->used + sz > c->cap )
+            c = _newChunk(sz);
+        void *p = c->data() + c->used;
+        c->used += sz;
+        return p;
+    }
+
+    void OpArena::reset() {
+        size_t used = 0;
+        for( Chunk *c = _chunks; c; c = c->next )
+            used += c->used;
+
+        // high watermark of recent per-op demand.  it decays: after DecayOps
+        // operations that needed less, capacity retained for a burst is released
+        if( used > _highWater || ++_opsSinceHigh >= DecayOps ) {
+            _highWater = used;
+            _opsSinceHigh = 0;
+        }
+
+        size_t target = _highWater;
+        if( target < ChunkSize - sizeof(Chunk) )
+            target = ChunkSize - sizeof(Chunk);
+        if( target > MaxRetainedBytes )
+            target = MaxRetainedBytes;
+
+        // merge this op's chunks into the spare list, then trim it to target
+        Chunk *c = _chunks;
+        _chunks = 0;
+        while( c ) {
+            Chunk *n = c->next;
+            c->used = 0;
+            c->next = _spare;
+            _spare = c;
+            _spareCap += c->cap;
+            c = n;
+        }
+        while( _spare && _spareCap > target ) {
+            Chunk *n = _spare->next;
+            _spareCap -= _spare->cap;
+            free(_spare);
+            _spare = n;
+        }
+    }
+
+    OpArena::Mark OpArena::mark() const {
+        Mark m;
+        m._c = _chunks;
+        m._used = _chunks ? _chunks->used : 0;
+        return m;
+    }
+
+    void OpArena::rewind( const Mark& m ) {
+        Chunk *c = _chunks;
+        while( c != m._c ) {
+            assert( c ); // rewinding to a mark from a different arena or after reset
+            Chunk *n = c->next;
+            free(c);
+            c = n;
+        }
+        _chunks = c;
+        if( c )
+            c->used = m._used;
+    }
+
+    namespace {
+
+        /* builder.h op-scratch hooks.  each allocation is prefixed with its size so
+           the realloc hook knows how much to copy. */
+
+        void* opScratchMalloc(size_t sz) {
+            char *p = (char*)cc().opArena().alloc(sz + sizeof(size_t));
+            *(size_t*)p = sz;
+            return p + sizeof(size_t);
+        }
+
+        void* opScratchRealloc(void *p, size_t sz) {
+            if( p == 0 )
+                return opScratchMalloc(sz);
+            size_t old = *((size_t*)p - 1);
+            if( sz <= old )
+                return p;
+            void *d = opScratchMalloc(sz);
+            memcpy(d, p, old);
+            return d;
+        }
+
+        struct InstallOpScratchHooks {
+            InstallOpScratchHooks() {
+                opScratchHooks().malloc_ = opScratchMalloc;
+                opScratchHooks().realloc_ = opScratchRealloc;
+            }
+        } installOpScratchHooks;
+
+    }
+
+}
@@ -0,0 +1,102 @@
+// oparena.h
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "../pch.h"
+
+namespace mongo {
+
+    /** bump allocator for per-operation scratch memory.  each Client owns one; it is
+        reset at the start of the outermost assembleResponse() on the thread, so memory
+        handed out during an operation stays valid while the response is being sent and
+        through any nested (DBDirectClient) operations.
+
+        oparena.cpp installs the op-scratch hooks in bson/util/builder.h pointing here,
+        so a BufBuilder constructed with BufBuilder::UseOpScratch() draws from the
+        current thread's arena (which requires a Client on the thread).
+
+        memory from here is NOT malloc compatible: it must never be decoupled into a
+        Message with ownership or into a BSONObj holder, both of which free() their
+        buffers.  read-only escapes (Message::appendData with ownIt false, BSONObj
+        views) are fine as long as they are consumed before the next operation starts.
+    */
+    class OpArena : boost::noncopyable {
+        struct Chunk;
+    public:
+        enum { ChunkSize = 64 * 1024 };
+        enum { MaxRetainedBytes = 64 * ChunkSize };
+        enum { DecayOps = 64 };
+
+        OpArena() : _chunks(0), _spare(0), _spareCap(0), _highWater(0), _opsSinceHigh(0), _depth(0) { }
+        ~OpArena();
+
+        /** 8 byte aligned; valid until the next reset() */
+        void* alloc(size_t sz);
+
+        /** drop everything allocated.  empty chunks are kept for reuse up to a high
+            watermark of recent per-op demand; the watermark decays after DecayOps
+            quieter operations, so capacity grabbed for a burst is given back once
+            the connection goes back to small requests. */
+        void reset();
+
+        /** a point to rewind to, for loops that repeatedly build and discard scratch
+            within one operation (e.g. the awaitData getMore retry loop).  only rewind
+            once nothing references the memory allocated after the mark. */
+        class Mark {
+            friend class OpArena;
+            Chunk *_c;
+            size_t _used;
+        };
+        Mark mark() const;
+        void rewind( const Mark& m );
+
+        /** marks an operation in progress on the arena's thread.  only the outermost
+            scope resets, so re-entrant operations keep their caller's memory alive. */
+        class Scope : boost::noncopyable {
+        public:
+            Scope( OpArena& a ) : _a( a ) {
+                if( _a._depth++ == 0 )
+                    _a.reset();
+            }
+            ~Scope() { --_a._depth; }
+        private:
+            OpArena& _a;
+        };
+
+    private:
+        friend class Scope;
+
+        struct Chunk /* see forward decl above */ {
+            Chunk *next;
+            size_t used;
+            size_t cap;
+            char* data() { return (char*)(this + 1); }
+        };
+
+        Chunk* _newChunk(size_t sz);
+
+        Chunk *_chunks;      // in use this op, newest first
+        Chunk *_spare;       // empty chunks retained across ops
+        size_t _spareCap;    // total capacity of the spare list
+        size_t _highWater;   // recent per-op demand; see reset()
+        int _opsSinceHigh;
+        int _depth;
+    };
+
+}
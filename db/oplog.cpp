@@ -23,6 +23,7 @@
 #include "commands.h"
 #include "repl/rs.h"
 #include "stats/counters.h"
+#include "../util/compress.h"
 #include "../util/file.h"
 #include "../util/unittest.h"
 #include "queryoptimizer.h"
@@ -34,6 +35,8 @@ namespace mongo {
 
     void logOpForSharding( const char * opstr , const char * ns , const BSONObj& obj , BSONObj * patt );
 
+    static BSONObj maybeCompressOplogEntry(const BSONObj& op);
+
     int __findingStartInitialTimeout = 5; // configurable for testing
 
     // cached copies of these...so don't rename them, drop them, etc.!!!
@@ -60,6 +63,9 @@ namespace mongo {
         const OpTime ts = op["ts"]._opTime();
         long long h = op["h"].numberLong();
 
+        // the source sends entries uncompressed; recompress for our own oplog
+        const BSONObj logObj = maybeCompressOplogEntry(op);
+
         {
             const char *logns = rsoplog;
             if ( rsOplogDetails == 0 ) {
@@ -71,9 +77,9 @@ namespace mongo {
             }
             Client::Context ctx( logns , localDB, false );
             {
-                int len = op.objsize();
+                int len = logObj.objsize();
                 Record *r = theDataFileMgr.fast_oplog_insert(rsOplogDetails, logns, len);
-                memcpy(getDur().writingPtr(r->data, len), op.objdata(), len);
+                memcpy(getDur().writingPtr(r->data, len), logObj.objdata(), len);
             }
             /* todo: now() has code to handle clock skew.  but if the skew server to server is large it will get unhappy.
                      this code (or code in now() maybe) should be improved.
@@ -119,10 +125,69 @@ namespace mongo {
         *b = EOO;
     }
 
-    // global is safe as we are in write lock. we put the static outside the function to avoid the implicit mutex 
+    // global is safe as we are in write lock. we put the static outside the function to avoid the implicit mutex
     // the compiler would use if inside the function.  the reason this is static is to avoid a malloc/free for this
     // on every logop call.
     static BufBuilder logopbufbuilder(8*1024);
+
+    /* --oplogCompress support.  entries whose o payload is large are stored with o
+       as snappy compressed bindata when that actually shrinks it; readers restore
+       them with decompressOplogEntry().  static scratch is safe: always in write lock. */
+    enum { oplogCompressMinBytes = 1024 };
+    static std::string oplogCompressScratch;
+    static bool appendCompressedO(BSONObjBuilder& b, const BSONObj& o) {
+        if( !cmdLine.oplogCompress || o.objsize() < oplogCompressMinBytes )
+            return false;
+        compress(o.objdata(), o.objsize(), &oplogCompressScratch);
+        if( oplogCompressScratch.size() >= (size_t) o.objsize() )
+            return false;
+        b.appendBinData("o", oplogCompressScratch.size(), BinDataGeneral, oplogCompressScratch.data());
+        return true;
+    }
+
+    /** rebuild an already built entry with its o payload compressed - used when
+        re-logging ops that arrived uncompressed from our sync source.
+        @return op itself when compression is off or not worthwhile. */
+    static BSONObj maybeCompressOplogEntry(const BSONObj& op) {
+        BSONElement o = op["o"];
+        if( !cmdLine.oplogCompress || o.type() != Object || o.Obj().objsize() < oplogCompressMinBytes )
+            return op;
+        BSONObjBuilder b( op.objsize() );
+        BSONObjIterator i( op );
+        while( i.more() ) {
+            BSONElement e = i.next();
+            if( str::equals( e.fieldName(), "o" ) ) {
+                if( !appendCompressedO(b, e.Obj()) )
+                    return op; // incompressible
+            }
+            else {
+                b.append( e );
+            }
+        }
+        return b.obj();
+    }
+
+    BSONObj decompressOplogEntry(const BSONObj& op) {
+        BSONElement o = op["o"];
+        if( o.type() != BinData )
+            return op;
+        int len = 0;
+        const char *data = o.binData(len);
+        std::string raw;
+        massert(16275, "error uncompressing oplog entry", uncompress(data, len, &raw));
+        massert(16276, "corrupt compressed oplog entry",
+                raw.size() >= 5 && BSONObj(raw.data()).objsize() == (int) raw.size());
+        BSONObjBuilder b( op.objsize() + (int) raw.size() );
+        BSONObjIterator i( op );
+        while( i.more() ) {
+            BSONElement e = i.next();
+            if( str::equals( e.fieldName(), "o" ) )
+                b.appendObject( "o", raw.data(), (int) raw.size() );
+            else
+                b.append( e );
+        }
+        return b.obj();
+    }
     static void _logOpRS(const char *opstr, const char *ns, const char *logNS, const BSONObj& obj, BSONObj *o2, bool *bb ) {
         DEV assertInWriteLock();
 
@@ -158,9 +223,10 @@ namespace mongo {
             b.appendBool("b", *bb);
         if ( o2 )
             b.append("o2", *o2);
+        bool oz = appendCompressedO(b, obj);
         BSONObj partial = b.done();
         int posz = partial.objsize();
-        int len = posz + obj.objsize() + 1 + 2 /*o:*/;
+        int len = oz ? posz : posz + obj.objsize() + 1 + 2 /*o:*/;
 
         Record *r;
         DEV assert( logNS == 0 );
@@ -189,7 +255,10 @@ namespace mongo {
             }
         }
 
-        append_O_Obj(r->data, partial, obj);
+        if ( oz )
+            memcpy(getDur().writingPtr(r->data, len), partial.objdata(), len);
+        else
+            append_O_Obj(r->data, partial, obj);
 
         if ( logLevel >= 6 ) {
             BSONObj temp(r);
@@ -197,6 +266,83 @@ namespace mongo {
         }
     }
 
+    /** batched _logOpRS for multi-document writes.  builds every op of a chunk into
+        one buffer and carves a single capped allocation into the records, instead of
+        paying the builder reset, context and allocation per op.  readers never see a
+        partial batch: we hold the write lock throughout, and lastOpTimeWritten only
+        advances once every record body of the chunk is in place.
+    */
+    static void _logOpsRS(const char *opstr, const char *ns, const vector<BSONObj>& objs, bool *bb) {
+        DEV assertInWriteLock();
+
+        if ( strncmp(ns, "local.", 6) == 0 ) {
+            if ( strncmp(ns, "local.slaves", 12) == 0 )
+                resetSlaveCache();
+            return;
+        }
+
+        massert(16271, "replSet error : logOps() but not primary?", theReplSet && theReplSet->box.getState().primary());
+
+        const char *logns = rsoplog;
+        if ( rsOplogDetails == 0 ) {
+            Client::Context ctx( logns , dbpath, false);
+            localDB = ctx.db();
+            assert( localDB );
+            rsOplogDetails = nsdetails(logns);
+            massert(16272, "local.oplog.rs missing. did you drop it? if so restart server", rsOplogDetails);
+        }
+        Client::Context ctx( logns , localDB, false );
+
+        // chunk so a single capped allocation stays modest even for huge batches.
+        // an op bigger than this still goes through alone, as it would have anyway.
+        enum { MaxBatchBytes = 256 * 1024 };
+
+        unsigned i = 0;
+        while( i < objs.size() ) {
+            logopbufbuilder.reset();
+            vector<int> lens;
+            OpTime lastts;
+            long long h = theReplSet->lastH;
+            unsigned j = i;
+            while( j < objs.size() && ( lens.empty() || logopbufbuilder.len() + objs[j].objsize() < MaxBatchBytes ) ) {
+                const OpTime ts = OpTime::now();
+                h = (h * 131 + ts.asLL()) * 17 + theReplSet->selfId();
+                int start = logopbufbuilder.len();
+                BSONObjBuilder b(logopbufbuilder);
+                b.appendTimestamp("ts", ts.asDate());
+                b.append("h", h);
+                b.append("op", opstr);
+                b.append("ns", ns);
+                if ( bb )
+                    b.appendBool("b", *bb);
+                if ( !appendCompressedO(b, objs[j]) )
+                    b.append("o", objs[j]);
+                b.done();
+                lens.push_back( logopbufbuilder.len() - start );
+                lastts = ts;
+                j++;
+            }
+
+            vector<Record*> recs;
+            theDataFileMgr.fast_oplog_insert_batch(rsOplogDetails, logns, lens, recs);
+            const char *p = logopbufbuilder.buf();
+            for( unsigned k = 0; k < lens.size(); k++ ) {
+                memcpy(getDur().writingPtr(recs[k]->data, lens[k]), p, lens[k]);
+                p += lens[k];
+            }
+
+            if( !(theReplSet->lastOpTimeWritten < lastts) ) {
+                log() << "replSet ERROR possible failover clock skew issue? " << theReplSet->lastOpTimeWritten << ' ' << lastts << rsLog;
+                log() << "replSet " << theReplSet->isPrimary() << rsLog;
+            }
+            theReplSet->lastOpTimeWritten = lastts;
+            theReplSet->lastH = h;
+            ctx.getClient()->setLastOp( lastts );
+
+            i = j;
+        }
+    }
+
     /* we write to local.opload.$main:
          { ts : ..., op: ..., ns: ..., o: ... }
        ts: an OpTime timestamp
@@ -316,6 +462,21 @@ namespace mongo {
         logOpForSharding( opstr , ns , obj , patt );
     }
 
+    void logOps(const char *opstr, const char *ns, const vector<BSONObj>& objs, bool *b) {
+        if ( replSettings.master ) {
+            if ( _logOp == _logOpRS && objs.size() > 1 )
+                _logOpsRS(opstr, ns, objs, b);
+            else {
+                // master/slave (and single ops) take the existing path
+                for( unsigned i = 0; i < objs.size(); i++ )
+                    _logOp(opstr, ns, 0, objs[i], 0, b);
+            }
+        }
+
+        for( unsigned i = 0; i < objs.size(); i++ )
+            logOpForSharding( opstr , ns , objs[i] , 0 );
+    }
+
     void createOplog() {
         dblock lk;
 
@@ -563,13 +724,12 @@ namespace mongo {
             const BSONObj& op = v[i];
             const char *which = "o";
             const char *opType = op.getStringField("op");
-            if ( *opType == 'i' )
+            if ( *opType == 'i' || *opType == 'd' )
                 ;
             else if( *opType == 'u' )
                 which = "o2";
             else
                 continue;
-            /* todo : other operations */
 
             try {
                 BSONObj o = op.getObjectField(which);
@@ -597,13 +757,12 @@ namespace mongo {
 
         const char *which = "o";
         const char *opType = op.getStringField("op");
-        if ( *opType == 'i' )
+        if ( *opType == 'i' || *opType == 'd' )
             ;
         else if( *opType == 'u' )
             which = "o2";
         else
             return;
-        /* todo : other operations */
 
         try {
             BSONObj o = op.getObjectField(which);
@@ -669,8 +828,10 @@ namespace mongo {
     /** @param fromRepl false if from ApplyOpsCmd
         @return true if was and update should have happened and the document DNE.  see replset initial sync code.
      */
-    bool applyOperation_inlock(const BSONObj& op , bool fromRepl ) {
+    bool applyOperation_inlock(const BSONObj& op_ , bool fromRepl , bool firstApply ) {
         assertInWriteLock();
+        // restore the o payload if this entry came out of an --oplogCompress oplog
+        const BSONObj op = decompressOplogEntry(op_);
         LOG(6) << "applying op: " << op << endl;
         bool failedUpdate = false;
 
@@ -714,12 +875,30 @@ namespace mongo {
                     /* erh 10/16/2009 - this is probably not relevant any more since its auto-created, but not worth removing */
                     RARELY ensureHaveIdIndex(ns); // otherwise updates will be slow
 
-                    /* todo : it may be better to do an insert here, and then catch the dup key exception and do update
-                              then.  very few upserts will not be inserts...
-                              */
-                    BSONObjBuilder b;
-                    b.append(_id);
-                    updateObjects(ns, o, b.done(), true, false, false , debug );
+                    bool applied = false;
+                    if( firstApply ) {
+                        /* no other op in this batch shares our _id, so on first
+                           apply this can only be a fresh insert: write it
+                           directly and skip the _id lookup the upsert below
+                           pays before writing.  a replayed entry (or a unique
+                           index conflict an upsert would also hit) dup-keys
+                           and falls through to the upsert, so the operation
+                           stays idempotent. */
+                        try {
+                            BSONObj tmp = o;
+                            theDataFileMgr.insertWithObjMod(ns, tmp);
+                            applied = true;
+                        }
+                        catch( DBException& e ) {
+                            if( e.getCode() != ASSERT_ID_DUPKEY )
+                                throw;
+                        }
+                    }
+                    if( !applied ) {
+                        BSONObjBuilder b;
+                        b.append(_id);
+                        updateObjects(ns, o, b.done(), true, false, false , debug );
+                    }
                 }
             }
         }
@@ -51,6 +51,15 @@ namespace mongo {
     */
     void logOp(const char *opstr, const char *ns, const BSONObj& obj, BSONObj *patt = 0, bool *b = 0);
 
+    /** batched logOp for multi-document writes: equivalent to calling logOp() once
+        per obj, but the ops of a chunk share one oplog allocation.  see
+        _logOpsRS() in oplog.cpp. */
+    void logOps(const char *opstr, const char *ns, const vector<BSONObj>& objs, bool *b = 0);
+
+    /** with --oplogCompress, large o payloads are stored snappy compressed as
+        bindata.  @return the entry with o restored; op itself if not compressed. */
+    BSONObj decompressOplogEntry(const BSONObj& op);
+
     void logKeepalive();
 
     /** puts obj in the oplog as a comment (a no-op).  Just for diags.
@@ -143,7 +152,12 @@ namespace mongo {
      * take an op and apply locally
      * used for applying from an oplog
      * @param fromRepl really from replication or for testing/internal/command/etc...
+     * @param firstApply the caller verified that no other op in the batch being
+     *        applied shares this op's _id, so an insert is almost certainly a
+     *        first apply: it is written directly, skipping the _id pre-image
+     *        lookup an upsert does, and falls back to the upsert on a duplicate
+     *        key (i.e. on replay).
      * Returns if the op was an update that could not be applied (true on failure)
      */
-    bool applyOperation_inlock(const BSONObj& op , bool fromRepl = true );
+    bool applyOperation_inlock(const BSONObj& op , bool fromRepl = true , bool firstApply = false );
 }
@@ -5,6 +5,7 @@
 #include "../client/dbclient.h"
 #include "../client/constants.h"
 #include "dbhelpers.h"
+#include "oplog.h"
 
 namespace mongo {
 
@@ -14,9 +15,11 @@ namespace mongo {
     class OplogReader {
         shared_ptr<DBClientConnection> _conn;
         shared_ptr<DBClientCursor> cursor;
+        OpTime _lastAppliedReport;
+        bool _reportableSource;
     public:
 
-        OplogReader() {
+        OplogReader() : _reportableSource(true) {
         }
         ~OplogReader() {
         }
@@ -27,6 +30,8 @@ namespace mongo {
         void resetConnection() {
             cursor.reset();
             _conn.reset();
+            _lastAppliedReport = OpTime();
+            _reportableSource = true;
         }
         DBClientConnection* conn() { return _conn.get(); }
         BSONObj findOne(const char *ns, const Query& q) {
@@ -114,13 +119,40 @@ namespace mongo {
         }
 
         void peek(vector<BSONObj>& v, int n) {
-            if( cursor.get() )
+            if( cursor.get() ) {
                 cursor->peek(v,n);
+                for( vector<BSONObj>::iterator i = v.begin(); i != v.end(); i++ )
+                    *i = decompressOplogEntry(*i);
+            }
+        }
+
+        /** tell the sync source how far we have applied, so its getLastError
+            w: waits see our apply progress immediately instead of on our next
+            getMore.  best effort: a source too old to know the command is only
+            asked once, and connection trouble is left for the next oplog read
+            to notice.  do not call while holding the db lock. */
+        void reportApplied(const char *ns, const OpTime& applied) {
+            if ( !_conn || !_reportableSource || applied == _lastAppliedReport )
+                return;
+            try {
+                BSONObjBuilder cmd;
+                cmd.append( "syncApplied" , ns );
+                cmd.appendTimestamp( "optime" , applied.asDate() );
+                BSONObj res;
+                if ( _conn->runCommand( "admin" , cmd.obj() , res ) )
+                    _lastAppliedReport = applied;
+                else
+                    _reportableSource = false; // presumably an older mongod
+            }
+            catch ( DBException& ) {
+                // ignore; a dead connection surfaces on the next oplog read
+            }
         }
 
-        BSONObj nextSafe() { return cursor->nextSafe(); }
+        // next/nextSafe restore entries from an --oplogCompress source transparently
+        BSONObj nextSafe() { return decompressOplogEntry(cursor->nextSafe()); }
 
-        BSONObj next() { return cursor->next(); }
+        BSONObj next() { return decompressOplogEntry(cursor->next()); }
 
         void putBack(BSONObj op) { cursor->putBack(op); }
 
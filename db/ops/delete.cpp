@@ -146,22 +146,26 @@ namespace mongo {
 
         CursorId id = cc->cursorid();
 
-        bool justOne = justOneOrig;
         bool canYield = !god && !creal->matcher()->docMatcher().atomic();
 
+        enum { BlockDocs = 64, BlockScan = 256 };
+        vector<DiskLoc> block;
+        bool stop = false;
+        bool warnedGodDeletes = false;
+
         do {
             // TODO: we can generalize this I believe
-            //       
+            //
             bool willNeedRecord = creal->matcher()->needRecord() || pattern.isEmpty() || isSimpleIdQuery( pattern );
             if ( ! willNeedRecord ) {
                 // TODO: this is a total hack right now
                 // check if the index full encompasses query
-                
-                if ( pattern.nFields() == 1 && 
+
+                if ( pattern.nFields() == 1 &&
                      str::equals( pattern.firstElement().fieldName() , creal->indexKeyPattern().firstElement().fieldName() ) )
                     willNeedRecord = true;
             }
-            
+
             if ( canYield && ! cc->yieldSometimes( willNeedRecord ? ClientCursor::WillNeed : ClientCursor::MaybeCovered ) ) {
                 cc.release(); // has already been deleted elsewhere
                 // TODO should we assert or something?
@@ -175,56 +179,85 @@ namespace mongo {
             // as well as some other nuances handled
             cc->setDoingDeletes( true );
 
-            DiskLoc rloc = cc->currLoc();
-            BSONObj key = cc->currKey();
+            // collect a block of matching locations before deleting anything, so
+            // the scan isn't interleaved with btree maintenance.  we do not yield
+            // while the block is pending; the locations stay valid until the
+            // deletes below.
+            block.clear();
+            int scannedHere = 0;
+            while ( cc->ok() && (int)block.size() < BlockDocs && scannedHere < BlockScan ) {
+                scannedHere++;
+                DiskLoc rloc = cc->currLoc();
 
-            // NOTE Calling advance() may change the matcher, so it's important
-            // to try to match first.
-            bool match = creal->matcher()->matchesCurrent(creal.get());
+                // NOTE Calling advance() may change the matcher, so it's important
+                // to try to match first.
+                bool match = creal->matcher()->matchesCurrent(creal.get());
 
-            if ( ! cc->advance() )
-                justOne = true;
+                if ( ! cc->advance() )
+                    stop = true;
 
-            if ( ! match )
-                continue;
-
-            assert( !cc->c()->getsetdup(rloc) ); // can't be a dup, we deleted it!
+                // dups are possible here (e.g. multikey indexes) now that the
+                // delete is deferred to the end of the block
+                if ( match && !cc->c()->getsetdup(rloc) ) {
+                    block.push_back( rloc );
+                    if ( justOneOrig )
+                        stop = true;
+                }
 
-            if ( !justOne ) {
-                /* NOTE: this is SLOW.  this is not good, noteLocation() was designed to be called across getMore
-                    blocks.  here we might call millions of times which would be bad.
-                    */
-                cc->c()->noteLocation();
+                if ( stop )
+                    break;
             }
 
-            if ( logop ) {
-                BSONElement e;
-                if( BSONObj( rloc.rec() ).getObjectID( e ) ) {
-                    BSONObjBuilder b;
-                    b.append( e );
-                    bool replJustOne = true;
-                    logOp( "d", ns, b.done(), 0, &replJustOne );
+            if ( !block.empty() ) {
+                bool noted = false;
+                if ( !justOneOrig && cc->ok() ) {
+                    /* NOTE noteLocation() was designed to be called across getMore
+                        blocks and is slow, which is why we note once per block here
+                        rather than once per deleted document.
+                        */
+                    cc->c()->noteLocation();
+                    noted = true;
                 }
-                else {
-                    problem() << "deleted object without id, not logging" << endl;
+
+                // records must still be alive for the oplog and the remove saver
+                for( vector<DiskLoc>::iterator i = block.begin(); i != block.end(); ++i ) {
+                    DiskLoc rloc = *i;
+
+                    if ( logop ) {
+                        BSONElement e;
+                        if( BSONObj( rloc.rec() ).getObjectID( e ) ) {
+                            BSONObjBuilder b;
+                            b.append( e );
+                            bool replJustOne = true;
+                            logOp( "d", ns, b.done(), 0, &replJustOne );
+                        }
+                        else {
+                            problem() << "deleted object without id, not logging" << endl;
+                        }
+                    }
+
+                    if ( rs )
+                        rs->goingToDelete( rloc.obj() /*cc->c->current()*/ );
                 }
-            }
 
-            if ( rs )
-                rs->goingToDelete( rloc.obj() /*cc->c->current()*/ );
+                // unindexes each index in key-sorted runs, then frees the records
+                theDataFileMgr.bulkDeleteRecords( ns, block );
+                nDeleted += block.size();
 
-            theDataFileMgr.deleteRecord(ns, rloc.rec(), rloc);
-            nDeleted++;
-            if ( justOne ) {
-                break;
+                if ( noted )
+                    cc->c()->checkLocation();
             }
-            cc->c()->checkLocation();
-         
-            if( !god ) 
+
+            if ( stop )
+                break;
+
+            if( !god )
                 getDur().commitIfNeeded();
 
-            if( debug && god && nDeleted == 100 ) 
+            if( debug && god && nDeleted >= 100 && !warnedGodDeletes ) {
+                warnedGodDeletes = true;
                 log() << "warning high number of deletes with god=true which could use significant memory" << endl;
+            }
         }
         while ( cc->ok() );
 
@@ -29,9 +29,11 @@
 #include "../repl.h"
 #include "../replutil.h"
 #include "../scanandorder.h"
+#include "../parallelscan.h"
 #include "../security.h"
 #include "../curop-inl.h"
 #include "../commands.h"
+#include "../tailnotify.h"
 #include "../queryoptimizer.h"
 #include "../lasterror.h"
 #include "../../s/d_logic.h"
@@ -46,11 +48,18 @@ namespace mongo {
     */
     const int MaxBytesToReturnToClientAtOnce = 4 * 1024 * 1024;
 
+    /* long scans that never hit their count limit double their byte target each
+       getMore, from MaxBytesToReturnToClientAtOnce up to this - for small
+       documents that divides the number of round trips by the same factor.
+       kept well under the max message size so a reply can always be framed. */
+    const int MaxAdaptiveBatchBytes = 16 * 1024 * 1024;
+
     //ns->query->DiskLoc
 //    LRUishMap<BSONObj,DiskLoc,5> lrutest(123);
 
     extern bool useCursors;
     extern bool useHints;
+    extern bool getMoreReadAhead;
 
     bool runCommands(const char *ns, BSONObj& jsobj, CurOp& curop, BufBuilder &b, BSONObjBuilder& anObjBuilder, bool fromRepl, int queryOptions) {
         try {
@@ -94,15 +103,190 @@ namespace mongo {
         return qr;
     }
 
-    QueryResult* processGetMore(const char *ns, int ntoreturn, long long cursorid , CurOp& curop, int pass, bool& exhaust ) {
+    /**
+     * accumulates a reply in bounded chunks handed straight to the outgoing Message as
+     * they fill, so a large batch is sent with scatter-gather writev() rather than
+     * assembled in (and copied through) one flat multi-megabyte buffer.  the
+     * QueryResult header lives at the front of the first chunk; fix it up through the
+     * pointer done() returns.
+     */
+    class ChunkedReplyBuilder : boost::noncopyable {
+    public:
+        ChunkedReplyBuilder( Message& msg ) : _msg( msg ), _flushed( 0 ) {
+            _b.reset( new BufBuilder( BufBuilder::UseOpScratch(), 4096 ) );
+            _b->skip( sizeof( QueryResult ) );
+        }
+        BufBuilder& buf() { return *_b; }
+        /** total reply length so far, header included */
+        int len() const { return _flushed + _b->len(); }
+        /** call between documents - seals the current chunk once it is big enough */
+        void chunkIfNeeded() {
+            if ( _b->len() >= ChunkSize )
+                _seal();
+        }
+        /** hand any remainder to the message.  Message::appendData maintains the
+            MsgData len, so don't set qr->len afterwards. */
+        QueryResult* done() {
+            if ( _b->len() || _msg.empty() )
+                _seal();
+            return (QueryResult *) _msg.header();
+        }
+    private:
+        void _seal() {
+            // chunks normally live in the op arena, in which case the message only
+            // gets a view; the arena keeps them alive until well after the reply is
+            // sent.  without the arena hooks the message owns the chunk as before.
+            bool own = !_b->opScratch();
+            _msg.appendData( _b->buf() , _b->len() , own );
+            if ( own )
+                _b->decouple();
+            _flushed += _b->len();
+            _b.reset( new BufBuilder( BufBuilder::UseOpScratch(), ChunkSize ) );
+        }
+        enum { ChunkSize = 64 * 1024 };
+        Message& _msg;
+        scoped_ptr<BufBuilder> _b;
+        int _flushed;
+    };
+
+    /* getMore read-ahead (--getMoreReadAhead).  between a reply and the next
+       getMore the server would otherwise sit idle while the client processes
+       the batch; a background worker instead keeps advancing the cursor and
+       stages the next batch on the ClientCursor, so the following getMore is a
+       memory copy.  staged memory is capped globally; cursors past the cap
+       just take the normal path. */
+    namespace {
+        mongo::mutex readAheadMutex("getMoreReadAhead");
+        boost::condition readAheadUpdated;
+        list< pair<CursorId,string> > readAheadQueue; // cursorid, ns
+        bool readAheadWorkerRunning = false;
+        const long long MaxTotalStagedBytes = 64 * 1024 * 1024;
+    }
+
+    /** advance cursorid and stage its next batch.  runs in the read-ahead
+        worker; behaves like a getMore (pins the cursor, read locked, yields)
+        except the result bytes go to the cursor instead of a reply.
+        @return false if the pin race with the queueing request was lost and
+                the caller should retry shortly */
+    static bool stageNextBatch( const char *ns, CursorId cursorid ) {
+        readlock lk;
+        Client::Context ctx( ns, dbpath, false );
+        ClientCursor *cc = ClientCursor::pinForPrefetch( cursorid );
+        if ( cc == 0 ) {
+            // the request that queued us may still hold the pin for a moment
+            return !ClientCursor::prefetchStillWanted( cursorid );
+        }
+
+        Cursor *c = cc->c();
+        c->checkLocation();
+
+        scoped_ptr<Projection::KeyOnly> keyFieldsOnly;
+        if ( cc->modifiedKeys() == false && cc->isMultiKey() == false && cc->fields )
+            keyFieldsOnly.reset( cc->fields->checkKey( cc->indexKeyPattern() ) );
+
+        ShardChunkManagerPtr manager = cc->getChunkManager();
+        int ntoreturn = cc->lastBatchNtoreturn();
+        int maxBytes = cc->nextBatchByteTarget( cc->pq.get() ? cc->pq->getBatchBytes() : 0 );
+        int start = cc->pos();
+        BufBuilder b( 32768 );
+        int n = 0;
+        DiskLoc last;
+        bool finished = false;
+
+        while ( 1 ) {
+            if ( cc->prefetchInterrupted() ) {
+                // a request wants the cursor; hand over whatever is staged so far
+                break;
+            }
+            if ( !c->ok() ) {
+                // exhausted; the next getMore delivers the batch and erases
+                finished = true;
+                break;
+            }
+            if ( c->matcher() && !c->matcher()->matchesCurrent( c ) ) {
+            }
+            else if ( manager && ! manager->belongsToMe( cc ) ) {
+                LOG(2) << "cursor skipping document in un-owned chunk: " << c->current() << endl;
+            }
+            else if ( !c->getsetdup( c->currLoc() ) ) {
+                last = c->currLoc();
+                n++;
+
+                if ( keyFieldsOnly ) {
+                    fillQueryResultFromObj( b, 0, keyFieldsOnly->hydrate( c->currKey() ) );
+                }
+                else {
+                    BSONObj js = c->current();
+                    fillQueryResultFromObj( b, cc->fields.get(), js, ( cc->pq.get() && cc->pq->showDiskLoc() ? &last : 0 ) );
+                }
+
+                if ( ( ntoreturn && n >= ntoreturn ) || b.len() > maxBytes ) {
+                    c->advance();
+                    break;
+                }
+            }
+            c->advance();
+
+            if ( ! cc->yieldSometimes( ClientCursor::MaybeCovered ) ) {
+                // cursor was deleted during the yield; nothing to unpin
+                return true;
+            }
+        }
+
+        cc->incPos( n );
+        cc->setStagedBatch( b, n, start, last, finished );
+        cc->updateLocation();
+        cc->unpinPrefetch();
+        return true;
+    }
+
+    static void getMoreReadAheadThread() {
+        Client::initThread( "getmorereadahead" );
+        while ( 1 ) {
+            CursorId cursorid;
+            string ns;
+            {
+                scoped_lock lk( readAheadMutex );
+                while ( readAheadQueue.empty() )
+                    readAheadUpdated.wait( lk.boost() );
+                cursorid = readAheadQueue.front().first;
+                ns = readAheadQueue.front().second;
+                readAheadQueue.pop_front();
+            }
+            try {
+                for( int retries = 0; !stageNextBatch( ns.c_str(), cursorid ) && retries < 100; retries++ )
+                    sleepmillis( 1 );
+            }
+            catch ( DBException& e ) {
+                LOG(1) << "getMore read-ahead failed for cursor " << cursorid << ": " << e.toString() << endl;
+            }
+            catch ( std::exception& e ) {
+                log() << "getMore read-ahead error: " << e.what() << endl;
+            }
+        }
+    }
+
+    /** caller holds cc's pin.  the worker is started lazily so servers that
+        never enable the option never pay for the thread. */
+    static void queueGetMoreReadAhead( ClientCursor *cc, const char *ns ) {
+        if ( ClientCursor::totalStagedBytes() >= MaxTotalStagedBytes )
+            return;
+        cc->markPrefetchWanted();
+        scoped_lock lk( readAheadMutex );
+        readAheadQueue.push_back( make_pair( cc->cursorid(), string( ns ) ) );
+        if ( !readAheadWorkerRunning ) {
+            readAheadWorkerRunning = true;
+            boost::thread t( getMoreReadAheadThread );
+        }
+        readAheadUpdated.notify_one();
+    }
+
+    QueryResult* processGetMore(const char *ns, int ntoreturn, long long cursorid , CurOp& curop, int pass, bool& exhaust, Message& result, unsigned long long *awaitTicket ) {
         exhaust = false;
         ClientCursor::Pointer p(cursorid);
         ClientCursor *cc = p.c();
 
-        int bufSize = 512 + sizeof( QueryResult ) + MaxBytesToReturnToClientAtOnce;
-
-        BufBuilder b( bufSize );
-        b.skip(sizeof(QueryResult));
+        ChunkedReplyBuilder b( result );
         int resultFlags = ResultFlag_AwaitCapable;
         int start = 0;
         int n = 0;
@@ -116,6 +300,39 @@ namespace mongo {
             // check for spoofing of the ns such that it does not match the one originally there for the cursor
             uassert(14833, "auth error", str::equals(ns, cc->ns().c_str()));
 
+            if ( getMoreReadAhead && cc->hasStagedBatch() ) {
+                // read-ahead hit: the batch was staged while the client chewed on
+                // the previous one; copy it out and skip the scan entirely
+                if ( pass == 0 )
+                    cc->updateSlaveLocation( curop );
+                curop.debug().query = cc->query();
+                DiskLoc last;
+                bool finished = false;
+                n = cc->consumeStagedBatch( b.buf(), ntoreturn, &start, &last, &finished );
+                if ( finished ) {
+                    p.release();
+                    bool ok = ClientCursor::erase(cursorid);
+                    assert(ok);
+                    cursorid = 0;
+                    cc = 0;
+                }
+                else {
+                    cc->storeOpForSlave( last );
+                    if ( !cc->hasStagedBatch() ) {
+                        cc->setLastBatchNtoreturn( ntoreturn );
+                        queueGetMoreReadAhead( cc, ns );
+                    }
+                }
+
+                QueryResult *qr = b.done();
+                qr->setOperation(opReply);
+                qr->_resultFlags() = resultFlags;
+                qr->cursorId = cursorid;
+                qr->startingFrom = start;
+                qr->nReturned = n;
+                return qr;
+            }
+
             if ( pass == 0 )
                 cc->updateSlaveLocation( curop );
 
@@ -128,6 +345,11 @@ namespace mongo {
             c->checkLocation();
             DiskLoc last;
 
+            // budget this batch's work; nscanned accumulates over the cursor's
+            // whole life so the ceiling applies to the delta
+            curop.setBudgets( cmdLine.opTimeBudgetMS , cmdLine.opScanBudget );
+            long long alreadyScanned = c->nscanned();
+
             scoped_ptr<Projection::KeyOnly> keyFieldsOnly;
             if ( cc->modifiedKeys() == false && cc->isMultiKey() == false && cc->fields )
                 keyFieldsOnly.reset( cc->fields->checkKey( cc->indexKeyPattern() ) );
@@ -135,6 +357,11 @@ namespace mongo {
             // This manager may be stale, but it's the state of chunking when the cursor was created.
             ShardChunkManagerPtr manager = cc->getChunkManager();
 
+            // when the client doesn't bound the batch by count, size it by
+            // bytes: explicit $batchBytes if the query gave one, otherwise an
+            // adaptively growing target so long scans take fewer round trips
+            int maxBytes = cc->nextBatchByteTarget( cc->pq.get() ? cc->pq->getBatchBytes() : 0 );
+
             while ( 1 ) {
                 if ( !c->ok() ) {
                     if ( c->tailable() ) {
@@ -146,6 +373,8 @@ namespace mongo {
                             continue;
 
                         if( n == 0 && (queryOptions & QueryOption_AwaitData) && pass < 1000 ) {
+                            if( awaitTicket )
+                                *awaitTicket = cappedInsertTicket( ns );
                             return 0;
                         }
 
@@ -174,15 +403,16 @@ namespace mongo {
                         n++;
 
                         if ( keyFieldsOnly ) {
-                            fillQueryResultFromObj(b, 0, keyFieldsOnly->hydrate( c->currKey() ) );
+                            fillQueryResultFromObj(b.buf(), 0, keyFieldsOnly->hydrate( c->currKey() ) );
                         }
                         else {
                             BSONObj js = c->current();
                             // show disk loc should be part of the main query, not in an $or clause, so this should be ok
-                            fillQueryResultFromObj(b, cc->fields.get(), js, ( cc->pq.get() && cc->pq->showDiskLoc() ? &last : 0));
+                            fillQueryResultFromObj(b.buf(), cc->fields.get(), js, ( cc->pq.get() && cc->pq->showDiskLoc() ? &last : 0));
                         }
+                        b.chunkIfNeeded();
 
-                        if ( ( ntoreturn && n >= ntoreturn ) || b.len() > MaxBytesToReturnToClientAtOnce ) {
+                        if ( ( ntoreturn && n >= ntoreturn ) || b.len() > maxBytes ) {
                             c->advance();
                             cc->incPos( n );
                             break;
@@ -190,6 +420,7 @@ namespace mongo {
                     }
                 }
                 c->advance();
+                curop.checkBudgets( c->nscanned() - alreadyScanned );
 
                 if ( ! cc->yieldSometimes( ClientCursor::MaybeCovered ) ) {
                     ClientCursor::erase(cursorid);
@@ -205,17 +436,20 @@ namespace mongo {
                 cc->mayUpgradeStorage();
                 cc->storeOpForSlave( last );
                 exhaust = cc->queryOptions() & QueryOption_Exhaust;
+                if ( getMoreReadAhead && !exhaust &&
+                     !( cc->queryOptions() & ( QueryOption_CursorTailable | QueryOption_AwaitData ) ) ) {
+                    cc->setLastBatchNtoreturn( ntoreturn );
+                    queueGetMoreReadAhead( cc, ns );
+                }
             }
         }
 
-        QueryResult *qr = (QueryResult *) b.buf();
-        qr->len = b.len();
+        QueryResult *qr = b.done();
         qr->setOperation(opReply);
         qr->_resultFlags() = resultFlags;
         qr->cursorId = cursorid;
         qr->startingFrom = start;
         qr->nReturned = n;
-        b.decouple();
 
         return qr;
     }
@@ -354,6 +588,186 @@ namespace mongo {
         bool _yieldRecoveryFailed;
     };
 
+    /* fetch the document at the first used entry of idx in traversal direction
+       dir (1 = forward).  one descent down the btree, no cursor.
+       @return false if the index has no used entries. */
+    static bool indexEdgeEntry( IndexDetails &idx, int dir, BSONObj &obj ) {
+        IndexInterface &ii = idx.idxInterface();
+        Ordering order = Ordering::make( idx.keyPattern() );
+        BSONObj start = extremeKeyForIndex( idx.keyPattern(), -dir );
+        int pos = 0;
+        bool found = false;
+        DiskLoc bucket = ii.locate( idx, idx.head, start, order, pos, found,
+                                    dir > 0 ? minDiskLoc : maxDiskLoc, dir );
+        while ( !bucket.isNull() && !ii.isUsed( bucket, pos ) )
+            bucket = ii.advance( bucket, pos, dir, "indexEdgeEntry" );
+        if ( bucket.isNull() )
+            return false;
+        BSONObj key;
+        DiskLoc recordLoc;
+        ii.keyAt( bucket, pos, key, recordLoc );
+        if ( recordLoc.isNull() )
+            return false;
+        obj = recordLoc.obj();
+        return true;
+    }
+
+    /* can a btree range count trust this value exactly?  only types whose key
+       ordering agrees with the matcher's comparisons everywhere.  NaN is
+       excluded because it compares equal to every number, which breaks the
+       binary searches in the bucket walk. */
+    static bool btreeCountableValue( const BSONElement &e ) {
+        switch( e.type() ) {
+        case NumberDouble:
+            return !isNaN( e.numberDouble() );
+        case NumberInt:
+        case NumberLong:
+        case String:
+        case Bool:
+        case Date:
+        case Timestamp:
+        case jstOID:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /* find a plain (no plugin type, not sparse or partial, not multikey) index
+       whose first field is 'field'.  callers rely on the index holding exactly
+       one key for every document.  singleField restricts the match to single
+       field indexes. */
+    static IndexDetails* findPlainIndexOn( NamespaceDetails *d, const char *field, bool singleField ) {
+        NamespaceDetails::IndexIterator it = d->ii();
+        while ( it.more() ) {
+            int idxNo = it.pos();
+            IndexDetails& ix = it.next();
+            BSONObj kp = ix.keyPattern();
+            if ( !str::equals( kp.firstElementFieldName(), field ) )
+                continue;
+            if ( singleField && kp.nFields() != 1 )
+                continue;
+            if ( ix.getSpec().getType() )
+                continue;
+            if ( d->isMultikey( idxNo ) )
+                continue;
+            BSONObj info = ix.info.obj();
+            if ( info["sparse"].trueValue() || !info["filter"].eoo() )
+                continue;
+            return &ix;
+        }
+        return 0;
+    }
+
+    /* for a query with no filter and no order but a field projection, find a
+       plain index whose keys contain every projected field.  the result can
+       then be built from index keys alone (Projection::KeyOnly) and the scan
+       reads only that index's btree buckets - never the documents - so a
+       single-field scan of a wide collection touches a small fraction of the
+       pages a table scan would.  with no filter and no requested order, key
+       order is as good as any. */
+    static IndexDetails* findCoveringIndex( NamespaceDetails *d, const Projection *fields ) {
+        NamespaceDetails::IndexIterator it = d->ii();
+        while ( it.more() ) {
+            int idxNo = it.pos();
+            IndexDetails& ix = it.next();
+            if ( ix.getSpec().getType() )
+                continue;
+            if ( d->isMultikey( idxNo ) )
+                continue;
+            BSONObj info = ix.info.obj();
+            if ( info["sparse"].trueValue() || !info["filter"].eoo() )
+                continue;
+            scoped_ptr<Projection::KeyOnly> probe( fields->checkKey( ix.keyPattern() ) );
+            if ( probe )
+                return &ix;
+        }
+        return 0;
+    }
+
+    /* detect count queries of the form { field : <scalar> } or
+       { field : { $gt/$gte/$lt/$lte : <scalar>, ... } } whose answer is exactly
+       the number of index keys in a single btree range, and count that range by
+       walking buckets (BtreeBucket::rangeCount()) instead of advancing a cursor
+       key by key.  sets 'count' and returns true if it could; the caller falls
+       back to the cursor based plans otherwise. */
+    static bool tryBtreeRangeCount( const char *ns, NamespaceDetails *d, const BSONObj &query, long long &count ) {
+        if ( query.nFields() != 1 )
+            return false;
+        BSONElement q = query.firstElement();
+        const char *field = q.fieldName();
+        if ( field[0] == '$' )
+            return false;
+        if ( q.type() == Object ) {
+            if ( q.embeddedObject().isEmpty() )
+                return false;
+            int canonical = 0;
+            BSONObjIterator i( q.embeddedObject() );
+            while ( i.more() ) {
+                BSONElement op = i.next();
+                const char *o = op.fieldName();
+                if ( strcmp( o, "$gt" ) != 0 && strcmp( o, "$gte" ) != 0 &&
+                     strcmp( o, "$lt" ) != 0 && strcmp( o, "$lte" ) != 0 )
+                    return false;
+                // the type bracketing FieldRange's optimize step applies to an
+                // open bound only covers simple types, and operands of mixed
+                // canonical types (e.g. { $gt : 5, $lt : "a" }) intersect to an
+                // interval containing keys the matcher would reject
+                if ( !op.isSimpleType() || !btreeCountableValue( op ) )
+                    return false;
+                if ( canonical == 0 )
+                    canonical = op.canonicalType();
+                else if ( canonical != op.canonicalType() )
+                    return false;
+            }
+        }
+        else if ( !btreeCountableValue( q ) ) {
+            return false;
+        }
+
+        // a multikey index can hold several keys per document and sparse or
+        // partial indexes can be missing documents, so none of those count one
+        // key per matching doc.
+        IndexDetails *idx = findPlainIndexOn( d, field, true );
+        if ( !idx )
+            return false;
+
+        FieldRangeSet frs( ns, query, true );
+        if ( !frs.getSpecial().empty() )
+            return false;
+        const FieldRangeSet &cfrs = frs;
+        const FieldRange &r = cfrs.range( field );
+        if ( r.empty() ) {
+            // e.g. $gt and $lt bounds that cannot both hold
+            count = 0;
+            return true;
+        }
+        if ( r.intervals().size() != 1 )
+            return false;
+        const FieldInterval &fi = r.intervals()[ 0 ];
+
+        BSONObj lo, hi;
+        {
+            BSONObjBuilder lb, hb;
+            lb.appendAs( fi._lower._bound, "" );
+            hb.appendAs( fi._upper._bound, "" );
+            lo = lb.obj();
+            hi = hb.obj();
+        }
+        bool loIncl = fi._lower._inclusive;
+        bool hiIncl = fi._upper._inclusive;
+
+        IndexInterface &ii = idx->idxInterface();
+        Ordering order = Ordering::make( idx->keyPattern() );
+        if ( ii.keyCompare( lo, hi, order ) > 0 ) {
+            // descending index - the lower valued bound sorts last in tree order
+            swap( lo, hi );
+            swap( loIncl, hiIncl );
+        }
+        count = ii.rangeCount( idx->head, order, lo, loIncl, hi, hiIncl );
+        return true;
+    }
+
     /* { count: "collectionname"[, query: <query>] }
        returns -1 on ns does not exist error.
     */
@@ -370,6 +784,27 @@ namespace mongo {
         if ( query.isEmpty() ) {
             return applySkipLimit( d->stats.nrecords , cmd );
         }
+
+        // single field range or equality against a plain index: count index keys
+        // bucket by bucket rather than advancing a cursor over each of them
+        {
+            long long n;
+            if ( tryBtreeRangeCount( ns, d, query, n ) ) {
+                return applySkipLimit( n, cmd );
+            }
+        }
+
+        // for big collections where the planner would table scan anyway, fan the
+        // scan out across a thread pool.  with a limit a serial scan can stop
+        // early, so stay with CountOp in that case.
+        if ( cmd["limit"].numberLong() == 0 && parallelScanEligible( d, query ) ) {
+            shared_ptr<Cursor> probe = bestGuessCursor( ns, query, BSONObj() );
+            if ( probe && probe->toString() == "BasicCursor" ) {
+                probe.reset();
+                return applySkipLimit( parallelScanCount( ns, d, query ), cmd );
+            }
+        }
+
         MultiPlanScanner mps( ns, query, BSONObj(), 0, true, BSONObj(), BSONObj(), false, true );
         CountOp original( ns , cmd );
         shared_ptr< CountOp > res = mps.runOp( original );
@@ -469,7 +904,7 @@ namespace mongo {
     public:
 
         UserQueryOp( const ParsedQuery& pq, Message &response, ExplainBuilder &eb, CurOp &curop ) :
-            _buf( 32768 ) , // TODO be smarter here
+            _buf( BufBuilder::UseOpScratch(), 32768 ) , // TODO be smarter here
             _pq( pq ) ,
             _ntoskip( pq.getSkip() ) ,
             _nscanned(0), _oldNscanned(0), _nscannedObjects(0), _oldNscannedObjects(0),
@@ -601,6 +1036,7 @@ namespace mongo {
             }
 
             _nscanned = _c->nscanned();
+            cc().curop()->checkBudgets( _nscanned );
             if ( !matcher( _c )->matchesCurrent(_c.get() , &_details ) ) {
                 // not a match, continue onward
                 if ( _details._loadedObject )
@@ -659,7 +1095,7 @@ namespace mongo {
                             }
                             _n++;
                             if ( ! _c->supportGetMore() ) {
-                                if ( _pq.enough( n() ) || _buf.len() >= MaxBytesToReturnToClientAtOnce ) {
+                                if ( _pq.enough( n() ) || _buf.len() >= _pq.maxBatchBytes() ) {
                                     finish( true );
                                     return;
                                 }
@@ -713,8 +1149,12 @@ namespace mongo {
             }
             else {
                 if ( _buf.len() ) {
-                    _response.appendData( _buf.buf(), _buf.len() );
-                    _buf.decouple();
+                    // when _buf is op-arena scratch the message only gets a view; the
+                    // arena outlives the send
+                    bool own = !_buf.opScratch();
+                    _response.appendData( _buf.buf(), _buf.len(), own );
+                    if ( own )
+                        _buf.decouple();
                 }
             }
 
@@ -732,8 +1172,10 @@ namespace mongo {
             fillQueryResultFromObj(_buf, 0, obj);
             _n = 1;
             _oldN = 0;
-            _response.appendData( _buf.buf(), _buf.len() );
-            _buf.decouple();
+            bool own = !_buf.opScratch();
+            _response.appendData( _buf.buf(), _buf.len(), own );
+            if ( own )
+                _buf.decouple();
         }
 
         virtual bool mayRecordPlan() const {
@@ -828,13 +1270,15 @@ namespace mongo {
         curop.setQuery(jsobj);
 
         if ( pq.couldBeCommand() ) {
+            // marked before running so shard version checks made during the
+            // command see it is not a plain (read only) query
+            curop.markCommand();
             BufBuilder bb;
             bb.skip(sizeof(QueryResult));
             BSONObjBuilder cmdResBuf;
             if ( runCommands(ns, jsobj, curop, bb, cmdResBuf, false, queryOptions) ) {
                 curop.debug().iscommand = true;
                 curop.debug().query = jsobj;
-                curop.markCommand();
 
                 auto_ptr< QueryResult > qr;
                 qr.reset( (QueryResult *) bb.buf() );
@@ -856,6 +1300,12 @@ namespace mongo {
 
         /* --- regular query --- */
 
+        // execution budgets: the query's own $maxTimeMS wins over the server
+        // wide default; the scan ceiling is server wide only ($maxScan keeps
+        // its historical truncate-not-kill behavior)
+        curop.setBudgets( pq.getMaxTimeMS() ? pq.getMaxTimeMS() : cmdLine.opTimeBudgetMS ,
+                          cmdLine.opScanBudget );
+
         int n = 0;
         BSONElement hint = useHints ? pq.getHint() : BSONElement();
         bool explain = pq.isExplain();
@@ -945,6 +1395,71 @@ namespace mongo {
             }
         }
 
+        /* single result at an index edge, e.g. find().sort({ts:-1}).limit(1) -
+           the "latest record" lookup.  descend straight to the extreme entry of
+           a matching index instead of building a plan set, matcher and cursor
+           for a one document scan.  only when the full result is a lone
+           unconditional extreme: no filter, skip, hint or batch continuation. */
+        if ( !explain && !snapshot && !pq.showDiskLoc() && !pq.returnKey() &&
+             query.isEmpty() && pq.getNumToReturn() == 1 && !pq.wantMore() &&
+             pq.getSkip() == 0 && pq.getMaxScan() == 0 && !pq.hasIndexSpecifier() &&
+             !pq.hasOption( QueryOption_CursorTailable ) &&
+             order.nFields() == 1 && order.firstElementFieldName()[0] != '$' &&
+             order.firstElement().isNumber() &&
+             !shardingState.needShardChunkManager( ns ) ) {
+            NamespaceDetails *d = nsdetails( ns );
+            if ( d ) {
+                IndexDetails *idx = findPlainIndexOn( d, order.firstElementFieldName(), false );
+                if ( idx ) {
+                    int sortDir = order.firstElement().number() >= 0 ? 1 : -1;
+                    int idxDir = idx->keyPattern().firstElement().number() >= 0 ? 1 : -1;
+                    BSONObj resObject;
+                    if ( indexEdgeEntry( *idx, sortDir * idxDir, resObject ) )
+                        n = 1;
+                    BufBuilder bb( sizeof(QueryResult) + resObject.objsize() + 32 );
+                    bb.skip( sizeof(QueryResult) );
+                    if ( n )
+                        fillQueryResultFromObj( bb, pq.getFields(), resObject );
+                    auto_ptr< QueryResult > qr;
+                    qr.reset( (QueryResult *) bb.buf() );
+                    bb.decouple();
+                    qr->setResultFlagsToOk();
+                    qr->len = bb.len();
+                    curop.debug().responseLength = bb.len();
+                    qr->setOperation(opReply);
+                    qr->cursorId = 0;
+                    qr->startingFrom = 0;
+                    qr->nReturned = n;
+                    result.setData( qr.release(), true );
+                    return NULL;
+                }
+            }
+        }
+
+        /* a filterless projected scan can be answered entirely from an index
+           containing the projected fields - the index serves as a column chunk
+           for those fields and the documents are never faulted in.  steer the
+           optimizer at such an index with a hint; the covered-key path in
+           UserQueryOp::_init() does the rest (explain shows indexOnly:true).
+           no point under sharding: the chunk ownership check loads each
+           document anyway. */
+        BSONObj coveredHint; // put here to keep the data in scope, as with snapshotHint
+        if ( hint.eoo() && !snapshot && query.isEmpty() && order.isEmpty() &&
+             !pq.returnKey() && !pq.showDiskLoc() && !pq.hasIndexSpecifier() &&
+             !pq.hasOption( QueryOption_CursorTailable ) && pq.getFields() &&
+             !shardingState.needShardChunkManager( ns ) ) {
+            NamespaceDetails *d = nsdetails( ns );
+            if ( d ) {
+                IndexDetails *idx = findCoveringIndex( d, pq.getFields() );
+                if ( idx ) {
+                    BSONObjBuilder b;
+                    b.append( "$hint", idx->indexName() );
+                    coveredHint = b.obj();
+                    hint = coveredHint.firstElement();
+                }
+            }
+        }
+
         // regular, not QO bypass query
 
         BSONObj oldPlan;
@@ -31,8 +31,13 @@
 namespace mongo {
 
     extern const int MaxBytesToReturnToClientAtOnce;
+    // ceiling for adaptively grown (or $batchBytes requested) getMore batches
+    extern const int MaxAdaptiveBatchBytes;
 
-    QueryResult* processGetMore(const char *ns, int ntoreturn, long long cursorid , CurOp& op, int pass, bool& exhaust);
+    /** @param awaitTicket if nonzero and we return 0 (tailable cursor awaiting data), receives
+                the capped insert ticket for ns so the caller can block on waitForCappedInsert
+                instead of polling.  set while still read locked, so no insert is missed. */
+    QueryResult* processGetMore(const char *ns, int ntoreturn, long long cursorid , CurOp& op, int pass, bool& exhaust, Message& result, unsigned long long *awaitTicket = 0);
 
     long long runCount(const char *ns, const BSONObj& cmd, string& err);
 
@@ -102,6 +107,8 @@ namespace mongo {
         const BSONObj& getOrder() const { return _order; }
         const BSONElement& getHint() const { return _hint; }
         int getMaxScan() const { return _maxScan; }
+        /** per-query deadline ($maxTimeMS), 0 if none */
+        int getMaxTimeMS() const { return _maxTimeMS; }
 
         bool couldBeCommand() const {
             /* we assume you are using findOne() for running a cmd... */
@@ -112,6 +119,12 @@ namespace mongo {
             return ! _hint.eoo() || ! _min.isEmpty() || ! _max.isEmpty();
         }
 
+        /** client requested per-batch byte target ($batchBytes), 0 if none */
+        int getBatchBytes() const { return _batchBytes; }
+
+        /** byte cap for a batch of this query - $batchBytes if given, else the default */
+        int maxBatchBytes() const { return _batchBytes ? _batchBytes : MaxBytesToReturnToClientAtOnce; }
+
         /* if ntoreturn is zero, we return up to 101 objects.  on the subsequent getmore, there
            is only a size limit.  The idea is that on a find() where one doesn't use much results,
            we don't return much, but once getmore kicks in, we start pushing significant quantities.
@@ -120,6 +133,8 @@ namespace mongo {
            objects, which causes massive scanning server-side.
         */
         bool enoughForFirstBatch( int n , int len ) const {
+            if ( _batchBytes )
+                return len > _batchBytes || ( _ntoreturn && n >= _ntoreturn );
             if ( _ntoreturn == 0 )
                 return ( len > 1024 * 1024 ) || n >= 101;
             return n >= _ntoreturn || len > MaxBytesToReturnToClientAtOnce;
@@ -166,6 +181,8 @@ namespace mongo {
             _returnKey = false;
             _showDiskLoc = false;
             _maxScan = 0;
+            _maxTimeMS = 0;
+            _batchBytes = 0;
         }
 
         void _initTop( const BSONObj& top ) {
@@ -204,8 +221,19 @@ namespace mongo {
                         _returnKey = e.trueValue();
                     else if ( strcmp( "maxScan" , name ) == 0 )
                         _maxScan = e.numberInt();
+                    else if ( strcmp( "maxTimeMS" , name ) == 0 )
+                        _maxTimeMS = e.numberInt();
                     else if ( strcmp( "showDiskLoc" , name ) == 0 )
                         _showDiskLoc = e.trueValue();
+                    else if ( strcmp( "batchBytes" , name ) == 0 ) {
+                        // byte target per batch; clamped so a bad value can't
+                        // produce tiny batches or oversized reply messages
+                        _batchBytes = e.numberInt();
+                        if ( _batchBytes < 4096 )
+                            _batchBytes = 4096;
+                        if ( _batchBytes > MaxAdaptiveBatchBytes )
+                            _batchBytes = MaxAdaptiveBatchBytes;
+                    }
                     else if ( strcmp( "comment" , name ) == 0 ) {
                         ; // no-op
                     }
@@ -242,6 +270,8 @@ namespace mongo {
         BSONObj _max;
         BSONElement _hint;
         int _maxScan;
+        int _maxTimeMS;
+        int _batchBytes;
     };
 
 
@@ -69,15 +69,15 @@ namespace mongo {
             ms.inclong = elt.numberLong() + in.numberLong();
         }
         else {
-            int x = elt.numberInt() + in.numberInt();
-            if ( x < 0 && elt.numberInt() > 0 && in.numberInt() > 0 ) {
-                // overflow
+            long long r = elt.numberLong() + in.numberLong();
+            if ( r > numeric_limits<int>::max() || r < numeric_limits<int>::min() ) {
+                // overflow or underflow
                 ms.incType = NumberLong;
-                ms.inclong = elt.numberLong() + in.numberLong();
+                ms.inclong = r;
             }
             else {
                 ms.incType = NumberInt;
-                ms.incint = elt.numberInt() + in.numberInt();
+                ms.incint = (int) r;
             }
         }
 
@@ -406,21 +406,34 @@ namespace mongo {
                 uassert( 10140 ,  "Cannot apply $inc modifier to non-number", e.isNumber() || e.eoo() );
                 if ( mss->amIInPlacePossible( e.isNumber() ) ) {
                     // check more typing info here
-                    if ( m.elt.type() != e.type() ) {
-                        // if i'm incrementing with a double, then the storage has to be a double
-                        mss->amIInPlacePossible( m.elt.type() != NumberDouble );
+                    if ( m.elt.type() == NumberDouble && e.type() != NumberDouble ) {
+                        // incrementing by a double promotes the field to a double.  a
+                        // long is the same width, so the type byte and value can be
+                        // rewritten in place; int storage is too narrow.
+                        if ( mss->amIInPlacePossible( e.type() == NumberLong ) ) {
+                            ms.incType = NumberDouble;
+                            ms.incdouble = m.elt.numberDouble() + e.numberDouble();
+                        }
                     }
 
-                    // check for overflow
-                    if ( e.type() == NumberInt && e.numberLong() + m.elt.numberLong() > numeric_limits<int>::max() ) {
-                        mss->amIInPlacePossible( false );
+                    // check for overflow/underflow of int storage
+                    if ( e.type() == NumberInt ) {
+                        long long r = e.numberLong() + m.elt.numberLong();
+                        if ( r > numeric_limits<int>::max() || r < numeric_limits<int>::min() ) {
+                            mss->amIInPlacePossible( false );
+                        }
                     }
                 }
                 break;
 
             case Mod::SET:
-                mss->amIInPlacePossible( m.elt.type() == e.type() &&
-                                         m.elt.valuesize() == e.valuesize() );
+                // the type byte is rewritten along with the value, so any same-width
+                // value can go in place even when the type differs (e.g. setting a
+                // NumberLong field to a Date, or a string to a same-length symbol)
+                if ( mss->amIInPlacePossible( m.elt.valuesize() == e.valuesize() ) ) {
+                    // the rebuild path runs this check when appending; match it
+                    m._checkForAppending( m.elt );
+                }
                 break;
 
             case Mod::PUSH:
@@ -584,6 +597,21 @@ namespace mongo {
                 break;
                 // [dm] the BSONElementManipulator statements below are for replication (correct?)
             case Mod::INC:
+                if ( m.incType ) {
+                    // $inc with a double on a NumberLong field: prepare okayed
+                    // rewriting the type byte and (same width) value in place
+                    BSONObjBuilder b;
+                    m.appendIncValue( b , false );
+                    assert( m._objData.isEmpty() );
+                    m._objData = b.obj();
+                    BSONElement n = m._objData.firstElement();
+                    if ( isOnDisk )
+                        BSONElementManipulator( m.old ).ReplaceTypeAndValue( n );
+                    else
+                        BSONElementManipulator( m.old ).replaceTypeAndValue( n );
+                    // appendForOpLog logs a $set of the promoted value via incType
+                    break;
+                }
                 if ( isOnDisk )
                     m.m->IncrementMe( m.old );
                 else
@@ -937,6 +965,7 @@ namespace mongo {
                 return;
             }
             _nscanned = _c->nscanned();
+            cc().curop()->checkBudgets( _nscanned );
             if ( _orClauseIndex > 0 && _nscanned >= 100 ) {
                 setComplete();
                 return;
@@ -1071,6 +1100,183 @@ namespace mongo {
         return UpdateResult( 1 , 0 , 1 );
     }
 
+    namespace {
+        /** one matching document queued by the batched multi update executor */
+        struct QueuedMatch {
+            DiskLoc loc;
+            bool hasElemMatchKey;
+            string elemMatchKey;
+        };
+    }
+
+    /* batched executor for multi $operator updates.  matching locations are
+       collected in blocks -- so the scan isn't interleaved with btree
+       maintenance -- and the mods are then applied to the whole block, noting
+       and checking the cursor's location once per block rather than once per
+       modified document and group committing once per block.  we never yield
+       while a block is pending, so the collected locations stay valid until
+       their mods are applied.
+       @return number of documents modified
+    */
+    static long long _updateObjectsMulti( const char *ns, ModSet& mods, int modsIsIndexed,
+                                          const BSONObj& updateobj, const BSONObj& patternOrig,
+                                          bool logop, OpDebug& debug, RemoveSaver* rs,
+                                          const shared_ptr<MultiCursor>& c,
+                                          NamespaceDetails *d, NamespaceDetailsTransient *nsdt,
+                                          long long& nscanned ) {
+        enum { BlockDocs = 64, BlockScan = 256 };
+        long long numModded = 0;
+        bool autoDedup = c->autoDedup();
+        set<DiskLoc> seenObjects;
+        MatchDetails details;
+        auto_ptr<ClientCursor> cc;
+        vector<QueuedMatch> block;
+
+        while( c->ok() ) {
+            bool atomic = c->matcher()->docMatcher().atomic();
+
+            if ( !atomic ) {
+                if ( cc.get() == 0 ) {
+                    shared_ptr< Cursor > cPtr = c;
+                    cc.reset( new ClientCursor( QueryOption_NoCursorTimeout , cPtr , ns ) );
+                }
+
+                bool didYield;
+                if ( ! cc->yieldSometimes( ClientCursor::WillNeed, &didYield ) ) {
+                    cc.release();
+                    break;
+                }
+                if ( !c->ok() ) {
+                    break;
+                }
+
+                if ( didYield ) {
+                    d = nsdetails(ns);
+                    nsdt = &NamespaceDetailsTransient::get(ns);
+                }
+            }
+
+            // collect a block of matching locations
+            block.clear();
+            int scannedHere = 0;
+            while ( c->ok() && (int)block.size() < BlockDocs && scannedHere < BlockScan ) {
+                nscanned++;
+                scannedHere++;
+
+                // May have already matched in UpdateOp, but do again to get details set correctly
+                details.reset();
+                if ( ! c->matcher()->matchesCurrent( c.get(), &details ) ) {
+                    c->advance();
+                    continue;
+                }
+
+                DiskLoc loc = c->currLoc();
+                c->advance(); // go to next record in case this one moves
+
+                bool dup = c->getsetdup( loc );
+                if ( autoDedup && ( dup || seenObjects.count( loc ) ) )
+                    continue;
+
+                QueuedMatch qm;
+                qm.loc = loc;
+                qm.hasElemMatchKey = details._elemMatchKey != 0;
+                if ( qm.hasElemMatchKey )
+                    qm.elemMatchKey = details._elemMatchKey;
+                block.push_back( qm );
+            }
+
+            if ( block.empty() )
+                continue;
+
+            // note the cursor's position once for the whole block
+            if ( cc.get() )
+                cc->updateLocation();
+            else
+                c->noteLocation();
+
+            for( vector<QueuedMatch>::iterator it = block.begin(); it != block.end(); ++it ) {
+                DiskLoc loc = it->loc;
+                BSONObj js( loc.rec() );
+
+                BSONObj pattern = patternOrig;
+
+                if ( logop ) {
+                    BSONObjBuilder idPattern;
+                    BSONElement id;
+                    // NOTE: If the matching object lacks an id, we'll log
+                    // with the original pattern.  This isn't replay-safe.
+                    // It might make sense to suppress the log instead
+                    // if there's no id.
+                    if ( js.getObjectID( id ) ) {
+                        idPattern.append( id );
+                        pattern = idPattern.obj();
+                    }
+                    else {
+                        uasserted( 10157 , "multi-update requires all modified objects to have an _id" );
+                    }
+                }
+
+                const BSONObj& onDisk = loc.obj();
+
+                ModSet * useMods = &mods;
+                bool forceRewrite = false;
+
+                auto_ptr<ModSet> mymodset;
+                if ( it->hasElemMatchKey && mods.hasDynamicArray() ) {
+                    useMods = mods.fixDynamicArray( it->elemMatchKey.c_str() );
+                    mymodset.reset( useMods );
+                    forceRewrite = true;
+                }
+
+                auto_ptr<ModSetState> mss = useMods->prepare( onDisk );
+
+                if ( modsIsIndexed <= 0 && mss->canApplyInPlace() ) {
+                    mss->applyModsInPlace( true );
+                    DEBUGUPDATE( "\t\t\t doing in place update" );
+                    d->paddingFits();
+                }
+                else {
+                    if ( rs )
+                        rs->goingToDelete( onDisk );
+
+                    BSONObj newObj = mss->createNewFromMods();
+                    checkTooLarge(newObj);
+                    DiskLoc newLoc = theDataFileMgr.updateRecord(ns, d, nsdt, loc.rec(), loc , newObj.objdata(), newObj.objsize(), debug);
+                    if ( newLoc != loc || modsIsIndexed ) {
+                        // object moved, need to make sure we don' get again
+                        seenObjects.insert( newLoc );
+                    }
+                }
+
+                if ( logop ) {
+                    DEV assert( mods.size() );
+
+                    if ( mss->haveArrayDepMod() ) {
+                        BSONObjBuilder patternBuilder;
+                        patternBuilder.appendElements( pattern );
+                        mss->appendSizeSpecForArrayDepMods( patternBuilder );
+                        pattern = patternBuilder.obj();
+                    }
+
+                    if ( forceRewrite || mss->needOpLogRewrite() ) {
+                        DEBUGUPDATE( "\t rewrite update: " << mss->getOpLogRewrite() );
+                        logOp("u", ns, mss->getOpLogRewrite() , &pattern );
+                    }
+                    else {
+                        logOp("u", ns, updateobj, &pattern );
+                    }
+                }
+                numModded++;
+            }
+
+            // one location check and one group commit window per block
+            c->checkLocation();
+            getDur().commitIfNeeded();
+        }
+
+        return numModded;
+    }
+
     UpdateResult _updateObjects(bool god, const char *ns, const BSONObj& updateobj, BSONObj patternOrig, bool upsert, bool multi, bool logop , OpDebug& debug, RemoveSaver* rs ) {
         DEBUGUPDATE( "update: " << ns << " update: " << updateobj << " query: " << patternOrig << " upsert: " << upsert << " multi: " << multi );
         Client& client = cc();
@@ -1117,7 +1323,7 @@ namespace mongo {
             }
         }
 
-        int numModded = 0;
+        long long numModded = 0;
         long long nscanned = 0;
         shared_ptr< MultiCursor::CursorOp > opPtr( new UpdateOp( mods.get() && mods->hasDynamicArray() ) );
         shared_ptr< MultiCursor > c( new MultiCursor( ns, patternOrig, BSONObj(), opPtr, true ) );
@@ -1126,7 +1332,14 @@ namespace mongo {
         nsdt = &NamespaceDetailsTransient::get(ns);
         bool autoDedup = c->autoDedup();
 
-        if( c->ok() ) {
+        if ( multi && isOperatorUpdate ) {
+            // batched block-at-a-time executor; falls through to the upsert
+            // handling below if nothing matched
+            if( c->ok() )
+                numModded = _updateObjectsMulti( ns, *mods, modsIsIndexed, updateobj, patternOrig,
+                                                 logop, debug, rs, c, d, nsdt, nscanned );
+        }
+        else if( c->ok() ) {
             set<DiskLoc> seenObjects;
             MatchDetails details;
             auto_ptr<ClientCursor> cc;
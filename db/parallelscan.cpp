@@ -0,0 +1,309 @@
+// parallelscan.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "parallelscan.h"
+#include "pdfile.h"
+#include "matcher.h"
+#include "hasher.h"
+#include "../util/concurrency/thread_pool.h"
+
+namespace mongo {
+
+    static unsigned scanThreads() {
+        unsigned n = boost::thread::hardware_concurrency();
+        if ( n == 0 )
+            n = 1;
+        if ( n > 8 )
+            n = 8;
+        return n;
+    }
+
+    void partitionExtents( NamespaceDetails *d, unsigned nParts, vector< vector<DiskLoc> > &parts ) {
+        assert( nParts > 0 );
+        parts.clear();
+        parts.resize( nParts );
+        vector<long long> sizes( nParts, 0 );
+        for ( DiskLoc el = d->firstExtent; !el.isNull(); el = el.ext()->xnext ) {
+            // greedy: each extent goes in the currently smallest group
+            unsigned min = 0;
+            for ( unsigned i = 1; i < nParts; i++ ) {
+                if ( sizes[i] < sizes[min] )
+                    min = i;
+            }
+            parts[min].push_back( el );
+            sizes[min] += el.ext()->length;
+        }
+    }
+
+    /* $where needs a js scope bound to the requesting client's thread, so a
+       query using it anywhere can't be matched from pool workers */
+    static bool hasWhereClause( const BSONObj &query ) {
+        BSONObjIterator i( query );
+        while ( i.more() ) {
+            BSONElement e = i.next();
+            if ( strcmp( e.fieldName(), "$where" ) == 0 )
+                return true;
+            if ( ( e.type() == Object || e.type() == Array ) && hasWhereClause( e.embeddedObject() ) )
+                return true;
+        }
+        return false;
+    }
+
+    bool parallelScanEligible( NamespaceDetails *d, const BSONObj &query ) {
+        if ( d->capped )
+            return false; // capped order/overrun semantics are the cursor's business
+        if ( scanThreads() < 2 )
+            return false;
+        if ( d->stats.datasize < 64 * 1024 * 1024 )
+            return false; // not worth the fan out
+        if ( hasWhereClause( query ) )
+            return false;
+        return true;
+    }
+
+    // one parallel scan at a time - concurrent fan outs would just fight over
+    // the disk, and it keeps the pool's join() unambiguous
+    static SimpleMutex parallelScanMutex( "parallelScan" );
+    static threadpool::ThreadPool& parallelScanPool() {
+        static threadpool::ThreadPool tp( scanThreads() );
+        return tp;
+    }
+
+    namespace {
+        struct ExtentCountTask {
+            const vector<DiskLoc> *extents;
+            BSONObj query;
+            long long n;
+            bool failed;
+        };
+    }
+
+    static void countWorker( ExtentCountTask *t ) {
+        try {
+            Matcher m( t->query );
+            long long n = 0;
+            for ( vector<DiskLoc>::const_iterator i = t->extents->begin(); i != t->extents->end(); ++i ) {
+                Extent *e = i->ext();
+                for ( DiskLoc l = e->firstRecord; !l.isNull(); ) {
+                    Record *r = l.rec();
+                    BSONObj o( r );
+                    if ( m.matches( o ) )
+                        n++;
+                    l = r->nextInExtent( l );
+                }
+            }
+            t->n = n;
+        }
+        catch ( std::exception& ex ) {
+            log() << "parallel count worker exception: " << ex.what() << endl;
+            t->failed = true;
+        }
+    }
+
+    long long parallelScanCount( const char *ns, NamespaceDetails *d, const BSONObj &query ) {
+        unsigned nThreads = scanThreads();
+        vector< vector<DiskLoc> > parts;
+        partitionExtents( d, nThreads, parts );
+
+        vector<ExtentCountTask> tasks( parts.size() );
+        for ( unsigned i = 0; i < parts.size(); i++ ) {
+            tasks[i].extents = &parts[i];
+            tasks[i].query = query.getOwned();
+            tasks[i].n = 0;
+            tasks[i].failed = false;
+        }
+
+        LOG(1) << "parallel count ns: " << ns << " threads: " << nThreads << endl;
+
+        {
+            SimpleMutex::scoped_lock lk( parallelScanMutex );
+            threadpool::ThreadPool &tp = parallelScanPool();
+            for ( unsigned i = 0; i < tasks.size(); i++ ) {
+                if ( !tasks[i].extents->empty() )
+                    tp.schedule( countWorker, &tasks[i] );
+            }
+            tp.join();
+        }
+
+        long long total = 0;
+        bool failed = false;
+        for ( unsigned i = 0; i < tasks.size(); i++ ) {
+            total += tasks[i].n;
+            failed = failed || tasks[i].failed;
+        }
+        massert( 16224, "exception during parallel count", !failed );
+        return total;
+    }
+
+    namespace {
+        struct ExtentHashTask {
+            const vector<DiskLoc> *extents;
+            unsigned long long h;
+            long long n;
+            bool failed;
+        };
+    }
+
+    static void hashWorker( ExtentHashTask *t ) {
+        try {
+            unsigned long long h = 0;
+            long long n = 0;
+            for ( vector<DiskLoc>::const_iterator i = t->extents->begin(); i != t->extents->end(); ++i ) {
+                Extent *e = i->ext();
+                for ( DiskLoc l = e->firstRecord; !l.isNull(); ) {
+                    Record *r = l.rec();
+                    BSONObj o( r );
+                    // addition is commutative, so the partitioning can't change the result
+                    h += bsonHashAppend( o.objdata(), o.objsize(), bsonHashSeed );
+                    n++;
+                    l = r->nextInExtent( l );
+                }
+            }
+            t->h = h;
+            t->n = n;
+        }
+        catch ( std::exception& ex ) {
+            log() << "parallel hash worker exception: " << ex.what() << endl;
+            t->failed = true;
+        }
+    }
+
+    unsigned long long parallelCollectionHash( const char *ns, NamespaceDetails *d, long long &count ) {
+        unsigned nThreads = scanThreads();
+        vector< vector<DiskLoc> > parts;
+        partitionExtents( d, nThreads, parts );
+
+        vector<ExtentHashTask> tasks( parts.size() );
+        for ( unsigned i = 0; i < parts.size(); i++ ) {
+            tasks[i].extents = &parts[i];
+            tasks[i].h = 0;
+            tasks[i].n = 0;
+            tasks[i].failed = false;
+        }
+
+        LOG(1) << "parallel hash ns: " << ns << " threads: " << nThreads << endl;
+
+        {
+            SimpleMutex::scoped_lock lk( parallelScanMutex );
+            threadpool::ThreadPool &tp = parallelScanPool();
+            for ( unsigned i = 0; i < tasks.size(); i++ ) {
+                if ( !tasks[i].extents->empty() )
+                    tp.schedule( hashWorker, &tasks[i] );
+            }
+            tp.join();
+        }
+
+        unsigned long long h = 0;
+        count = 0;
+        bool failed = false;
+        for ( unsigned i = 0; i < tasks.size(); i++ ) {
+            h += tasks[i].h;
+            count += tasks[i].n;
+            failed = failed || tasks[i].failed;
+        }
+        massert( 16277, "exception during parallel hash", !failed );
+        return h;
+    }
+
+    namespace {
+        struct ExtentValidateTask {
+            const vector<DiskLoc> *extents;
+            const char *ns;
+            bool full;
+            unsigned recsQuota;
+            long long n;
+            long long len;
+            long long nlen;
+            int nInvalid;
+            vector<DiskLoc> recs;
+            bool failed;
+        };
+    }
+
+    static void validateWorker( ExtentValidateTask *t ) {
+        try {
+            for ( vector<DiskLoc>::const_iterator i = t->extents->begin(); i != t->extents->end(); ++i ) {
+                Extent *e = i->ext();
+                for ( DiskLoc l = e->firstRecord; !l.isNull(); ) {
+                    Record *r = l.rec();
+                    t->n++;
+                    t->len += r->lengthWithHeaders;
+                    t->nlen += r->netLength();
+                    if ( t->recs.size() < t->recsQuota )
+                        t->recs.push_back( l );
+                    if ( t->full ) {
+                        BSONObj obj( r );
+                        if ( !obj.isValid() || !obj.valid() ) { // both fast and deep checks
+                            if ( t->nInvalid == 0 ) // only log once per worker
+                                log() << "Invalid bson detected in " << t->ns << " at " << l.toString() << endl;
+                            t->nInvalid++;
+                        }
+                    }
+                    l = r->nextInExtent( l );
+                }
+            }
+        }
+        catch ( std::exception& ex ) {
+            log() << "parallel validate worker exception: " << ex.what() << endl;
+            t->failed = true;
+        }
+    }
+
+    void parallelScanValidate( const char *ns, NamespaceDetails *d, bool full, ParallelValidateResult &res ) {
+        unsigned nThreads = scanThreads();
+        vector< vector<DiskLoc> > parts;
+        partitionExtents( d, nThreads, parts );
+
+        vector<ExtentValidateTask> tasks( parts.size() );
+        for ( unsigned i = 0; i < parts.size(); i++ ) {
+            tasks[i].extents = &parts[i];
+            tasks[i].ns = ns;
+            tasks[i].full = full;
+            // same overall bound as the serial scan's 1M record sample
+            tasks[i].recsQuota = 1000000 / parts.size();
+            tasks[i].n = tasks[i].len = tasks[i].nlen = 0;
+            tasks[i].nInvalid = 0;
+            tasks[i].failed = false;
+        }
+
+        LOG(1) << "parallel validate ns: " << ns << " threads: " << nThreads << endl;
+
+        {
+            SimpleMutex::scoped_lock lk( parallelScanMutex );
+            threadpool::ThreadPool &tp = parallelScanPool();
+            for ( unsigned i = 0; i < tasks.size(); i++ ) {
+                if ( !tasks[i].extents->empty() )
+                    tp.schedule( validateWorker, &tasks[i] );
+            }
+            tp.join();
+        }
+
+        bool failed = false;
+        for ( unsigned i = 0; i < tasks.size(); i++ ) {
+            res.n += tasks[i].n;
+            res.len += tasks[i].len;
+            res.nlen += tasks[i].nlen;
+            res.nInvalid += tasks[i].nInvalid;
+            res.recs.insert( tasks[i].recs.begin(), tasks[i].recs.end() );
+            failed = failed || tasks[i].failed;
+        }
+        massert( 16278, "exception during parallel validate", !failed );
+    }
+
+}
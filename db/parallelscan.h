@@ -0,0 +1,76 @@
+// parallelscan.h
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "jsobj.h"
+#include "diskloc.h"
+
+namespace mongo {
+
+    class NamespaceDetails;
+
+    /** partition a collection's extent chain into at most nParts disjoint groups of
+        roughly equal total byte size.  together the groups cover the whole chain.
+    */
+    void partitionExtents( NamespaceDetails *d, unsigned nParts, vector< vector<DiskLoc> > &parts );
+
+    /** @return true if a multithreaded table scan of this collection is supported and
+        likely worthwhile.  does not check that a table scan is the right plan for a
+        particular query - that is the caller's job.
+    */
+    bool parallelScanEligible( NamespaceDetails *d, const BSONObj &query );
+
+    /** count records matching query by fanning a table scan out across a thread pool,
+        one group of extents per worker.
+
+        the caller must hold at least a read lock for the whole call; unlike CountOp we
+        never yield, so this is intended for analytics style counts where blocking
+        writers for the duration of the scan is acceptable.
+    */
+    long long parallelScanCount( const char *ns, NamespaceDetails *d, const BSONObj &query );
+
+    /** order independent content hash of a collection: per record FNV-1a hashes
+        combined by addition, so physical record layout does not matter and replicas
+        whose extents are arranged differently still compare equal.  fanned out
+        across the scan pool, one group of extents per worker.
+
+        the caller must hold at least a read lock for the whole call and we do not
+        yield, same contract as parallelScanCount.  @param count set to the number
+        of records hashed.
+    */
+    unsigned long long parallelCollectionHash( const char *ns, NamespaceDetails *d, long long &count );
+
+    /** record stats gathered by a parallel validate scan */
+    struct ParallelValidateResult {
+        ParallelValidateResult() : n(0), len(0), nlen(0), nInvalid(0) {}
+        long long n;       // records seen
+        long long len;     // total lengthWithHeaders
+        long long nlen;    // total netLength
+        int nInvalid;      // full mode: records failing bson validation
+        set<DiskLoc> recs; // sampled record locations (bounded), for deleted list cross checks
+    };
+
+    /** the record walking part of validate, fanned out per extent group.  with full,
+        each record's bson is deep checked as in the serial scan.  same locking
+        contract as parallelScanCount.  capped collections are not supported here:
+        their validation also checks record order.
+    */
+    void parallelScanValidate( const char *ns, NamespaceDetails *d, bool full, ParallelValidateResult &res );
+
+}
@@ -46,6 +46,12 @@ _ disallow system* manipulations from the database.
 #include "ops/delete.h"
 #include "instance.h"
 #include "replutil.h"
+#include "tailnotify.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
 
 namespace mongo {
 
@@ -63,6 +69,49 @@ namespace mongo {
         return *x > 0;
     }
 
+    static bool dbpathIsNonRotational() {
+#if defined(__linux__)
+        struct stat s;
+        if ( stat( dbpath.c_str(), &s ) != 0 )
+            return false;
+        char sysfs[64];
+        sprintf( sysfs, "/sys/dev/block/%d:%d/queue/rotational",
+                 (int) major( s.st_dev ), (int) minor( s.st_dev ) );
+        FILE *f = fopen( sysfs, "r" );
+        if ( f == 0 ) {
+            // a partition has no queue directory - ask the parent device
+            sprintf( sysfs, "/sys/dev/block/%d:%d/../queue/rotational",
+                     (int) major( s.st_dev ), (int) minor( s.st_dev ) );
+            f = fopen( sysfs, "r" );
+        }
+        if ( f == 0 )
+            return false;
+        char c = 0;
+        size_t n = fread( &c, 1, 1, f );
+        fclose( f );
+        return n == 1 && c == '0';
+#else
+        return false;
+#endif
+    }
+
+    bool storageIsSSD() {
+        static int resolved = -1; // benign if two threads race to resolve
+        if ( resolved == -1 ) {
+            if ( cmdLine.storageProfile == "ssd" )
+                resolved = 1;
+            else if ( cmdLine.storageProfile == "hdd" )
+                resolved = 0;
+            else {
+                if ( cmdLine.storageProfile != "auto" )
+                    log() << "warning: unknown --storageProfile '" << cmdLine.storageProfile << "', using auto" << endl;
+                resolved = dbpathIsNonRotational() ? 1 : 0;
+                log() << "storage profile: " << ( resolved ? "ssd" : "hdd" ) << " (auto-detected)" << endl;
+            }
+        }
+        return resolved == 1;
+    }
+
     bool inDBRepair = false;
     struct doingRepair {
         doingRepair() {
@@ -424,7 +473,7 @@ namespace mongo {
         assert( size % 4096 == 0 );
 
         if ( preallocateOnly ) {
-            if ( cmdLine.prealloc ) {
+            if ( cmdLine.prealloc && !MongoMMF::isEphemeralPath( filename ) ) {
                 FileAllocator::get()->requestAllocation( filename, size );
             }
             return;
@@ -467,6 +516,8 @@ namespace mongo {
             dw->lastExtentSize = e->length;
         }
         details->addDeletedRec(emptyLoc.drec(), emptyLoc);
+
+        NamespaceDetailsTransient::get( ns ).clearStorageStats();
     }
 
     Extent* MongoDataFile::createExtent(const char *ns, int approxSize, bool newCapped, int loops) {
@@ -811,7 +862,29 @@ namespace mongo {
         log() << "end freelist" << endl;
     }
 
-    /** free a list of extents that are no longer in use.  this is a double linked list of extents 
+    /** return a freed extent's space to the device on flash tiers.  the
+        extent header stays live - the $freelist chains through it - so only
+        the body is punched, aligned inward to page boundaries.  the punched
+        pages read back as zeroes, which extent reuse tolerates (the body of
+        a free extent is garbage anyway).
+    */
+    static void punchHoleInExtent( DiskLoc extLoc, int length ) {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+        boost::filesystem::path p = cc().database()->fileName( extLoc.a() );
+        int fd = open( p.string().c_str(), O_RDWR );
+        if ( fd < 0 )
+            return;
+        long long begin = ( (long long) extLoc.getOfs() + Extent::HeaderSize() + 4095 ) & ~4095LL;
+        long long end = ( (long long) extLoc.getOfs() + length ) & ~4095LL;
+        if ( end > begin &&
+             fallocate( fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, begin, end - begin ) != 0 ) {
+            log(1) << "hole punch failed on " << p.string() << ' ' << errnoWithDescription() << endl;
+        }
+        close( fd );
+#endif
+    }
+
+    /** free a list of extents that are no longer in use.  this is a double linked list of extents
         (could be just one in the list)
     */
     void freeExtents(DiskLoc firstExt, DiskLoc lastExt) {
@@ -825,6 +898,11 @@ namespace mongo {
             assert( f==l || !l->xprev.isNull() );
         }
 
+        if( storageIsSSD() ) {
+            for( DiskLoc a = firstExt; !a.isNull(); a = a.ext()->xnext )
+                punchHoleInExtent( a, a.ext()->length );
+        }
+
         string s = cc().database()->name + FREELIST_NS;
         NamespaceDetails *freeExtents = nsdetails(s.c_str());
         if( freeExtents == 0 ) {
@@ -911,29 +989,82 @@ namespace mongo {
         dropNS(name);
     }
 
+    /* unindex one key for this record. */
+    static void _unindexKey(IndexDetails& id, const BSONObj& key, const BSONObj& obj, const DiskLoc& dl, bool logMissing) {
+        bool ok = false;
+        try {
+            ok = id.idxInterface().unindex(id.head, id, key, dl);
+        }
+        catch (AssertionException& e) {
+            problem() << "Assertion failure: _unindex failed " << id.indexNamespace() << endl;
+            out() << "Assertion failure: _unindex failed: " << e.what() << '\n';
+            out() << "  obj:" << obj.toString() << '\n';
+            out() << "  key:" << key.toString() << '\n';
+            out() << "  dl:" << dl.toString() << endl;
+            sayDbContext();
+        }
+
+        if ( !ok && logMissing ) {
+            log() << "unindex failed (key too big?) " << id.indexNamespace() << " key: " << key << " " << obj["_id"] << endl;
+        }
+    }
+
     /* unindex all keys in index for this record. */
-    static void _unindexRecord(IndexDetails& id, BSONObj& obj, const DiskLoc& dl, bool logMissing = true) {
+    static void _unindexRecord(IndexDetails& id, BSONObj& obj, const DiskLoc& dl, bool logMissing = true, BSONObjFieldIndex *docIndex = 0) {
         BSONObjSet keys;
-        id.getKeysFromObject(obj, keys);
-        IndexInterface& ii = id.idxInterface();
+        id.getKeysFromObject(obj, keys, docIndex);
         for ( BSONObjSet::iterator i=keys.begin(); i != keys.end(); i++ ) {
-            BSONObj j = *i;
+            _unindexKey(id, *i, obj, dl, logMissing);
+        }
+    }
 
-            bool ok = false;
-            try {
-                ok = ii.unindex(id.head, id, j, dl);
-            }
-            catch (AssertionException& e) {
-                problem() << "Assertion failure: _unindex failed " << id.indexNamespace() << endl;
-                out() << "Assertion failure: _unindex failed: " << e.what() << '\n';
-                out() << "  obj:" << obj.toString() << '\n';
-                out() << "  key:" << j.toString() << '\n';
-                out() << "  dl:" << dl.toString() << endl;
-                sayDbContext();
+    /* compare (key,loc) pairs in key order for one index, so bulk unindexing can
+       walk the btree left to right instead of hopping randomly per document. */
+    struct UnindexKeyLess {
+        UnindexKeyLess( const BSONObj& keyPattern ) : _keyPattern( keyPattern ) {}
+        bool operator()( const pair<BSONObj,DiskLoc>& l, const pair<BSONObj,DiskLoc>& r ) const {
+            int c = l.first.woCompare( r.first, _keyPattern, false );
+            if ( c )
+                return c < 0;
+            return l.second < r.second;
+        }
+        BSONObj _keyPattern;
+    };
+
+    /* unindex all keys in all indexes for a batch of records.  done one index at a
+       time with that index's keys sorted, so consecutive deletes tend to hit the
+       same (hot) buckets rather than touching random pages across every index. */
+    static void unindexRecords(NamespaceDetails *d, const vector<DiskLoc>& dls, bool noWarn = false) {
+        int n = d->nIndexes + ( d->indexBuildInProgress ? 1 : 0 );
+
+        // the index loop is outermost (to keep each btree walk sorted), so every
+        // record is revisited once per index; share one field table per record
+        // across those visits
+        vector< shared_ptr<BSONObjFieldIndex> > docIndexes;
+        if ( n > 1 ) {
+            docIndexes.reserve( dls.size() );
+            for ( unsigned j = 0; j < dls.size(); j++ )
+                docIndexes.push_back( shared_ptr<BSONObjFieldIndex>( new BSONObjFieldIndex( BSONObj( dls[j].rec() ) ) ) );
+        }
+
+        for ( int i = 0; i < n; i++ ) {
+            IndexDetails& id = d->idx(i);
+            // the in-progress background index may legitimately be missing keys
+            bool logMissing = !noWarn && i < d->nIndexes;
+
+            vector< pair<BSONObj,DiskLoc> > keys;
+            for ( unsigned j = 0; j < dls.size(); j++ ) {
+                BSONObj obj( dls[j].rec() );
+                BSONObjSet ks;
+                id.getKeysFromObject(obj, ks, docIndexes.empty() ? 0 : docIndexes[j].get());
+                for ( BSONObjSet::iterator k = ks.begin(); k != ks.end(); k++ )
+                    keys.push_back( make_pair( *k, dls[j] ) );
             }
+            sort( keys.begin(), keys.end(), UnindexKeyLess( id.keyPattern() ) );
 
-            if ( !ok && logMissing ) {
-                log() << "unindex failed (key too big?) " << id.indexNamespace() << " key: " << j << " " << obj["_id"] << endl;
+            for ( unsigned j = 0; j < keys.size(); j++ ) {
+                BSONObj obj( keys[j].second.rec() );
+                _unindexKey(id, keys[j].first, obj, keys[j].second, logMissing);
             }
         }
     }
@@ -942,11 +1073,14 @@ namespace mongo {
     static void unindexRecord(NamespaceDetails *d, Record *todelete, const DiskLoc& dl, bool noWarn = false) {
         BSONObj obj(todelete);
         int n = d->nIndexes;
+        // every index extracts from the same document; share one field table
+        BSONObjFieldIndex docIndex( obj );
+        BSONObjFieldIndex *di = n + ( d->indexBuildInProgress ? 1 : 0 ) > 1 ? &docIndex : 0;
         for ( int i = 0; i < n; i++ )
-            _unindexRecord(d->idx(i), obj, dl, !noWarn);
+            _unindexRecord(d->idx(i), obj, dl, !noWarn, di);
         if( d->indexBuildInProgress ) { // background index
             // always pass nowarn here, as this one may be missing for valid reasons as we are concurrently building it
-            _unindexRecord(d->idx(n), obj, dl, false);
+            _unindexRecord(d->idx(n), obj, dl, false, di);
         }
     }
 
@@ -1037,9 +1171,64 @@ namespace mongo {
         }
     }
 
+    /* delete a batch of records.  phase 1 unindexes everything, one index at a time
+       in key-sorted runs (see unindexRecords); phase 2 frees the records.  caller
+       handles the oplog - and capped collections are not supported here.
+    */
+    void DataFileMgr::bulkDeleteRecords(const char *ns, const vector<DiskLoc>& dls, bool noWarn) {
+        if ( dls.empty() )
+            return;
+
+        NamespaceDetails* d = nsdetails(ns);
+        uassert( 16254 , "can't bulk delete from a capped collection" , ! d->capped );
+
+        unindexRecords(d, dls, noWarn);
+
+        for ( unsigned i = 0; i < dls.size(); i++ ) {
+            DiskLoc dl = dls[i];
+            /* check if any cursors point to us.  if so, advance them.  done per
+               record just before the free so nothing can land on a freed record. */
+            ClientCursor::aboutToDelete(dl);
+            _deleteRecord(d, ns, dl.rec(), dl);
+        }
+        NamespaceDetailsTransient::get( ns ).notifyOfWriteOp();
+    }
+
 
     /** Note: if the object shrinks a lot, we don't free up space, we leave extra at end of the record.
      */
+    /* copy src over dst, declaring write intents only for the spans that actually
+       differ.  a rewritten document usually shares most bytes with its old image -
+       an unchanged prefix, a few changed fields, a shifted tail - and the journal
+       writes every declared byte, so narrowing the intents to the real deltas cuts
+       journal volume on update heavy loads.  nearby differing spans (closer than
+       SkipGap) are merged so pathological interleavings don't pay per-intent
+       bookkeeping for every few bytes. */
+    static void writeDelta( char *dst, const char *src, int len ) {
+        if ( !cmdLine.dur ) {
+            // no journal: a straight copy is cheaper than diffing
+            memcpy( getDur().writingPtr(dst, len), src, len );
+            return;
+        }
+        const int SkipGap = 64;
+        int i = 0;
+        while ( i < len ) {
+            while ( i < len && dst[i] == src[i] )
+                i++;
+            if ( i == len )
+                break;
+            int start = i;
+            int lastDiff = i;
+            while ( i < len && i - lastDiff < SkipGap ) {
+                if ( dst[i] != src[i] )
+                    lastDiff = i;
+                i++;
+            }
+            int spanLen = lastDiff - start + 1;
+            memcpy( getDur().writingPtr( dst + start, spanLen ), src + start, spanLen );
+        }
+    }
+
     const DiskLoc DataFileMgr::updateRecord(
         const char *ns,
         NamespaceDetails *d,
@@ -1129,9 +1318,8 @@ namespace mongo {
             debug.keyUpdates = keyUpdates;
         }
 
-        //  update in place
-        int sz = objNew.objsize();
-        memcpy(getDur().writingPtr(toupdate->data, sz), objNew.objdata(), sz);
+        //  update in place, journaling only the bytes that changed
+        writeDelta(toupdate->data, objNew.objdata(), objNew.objsize());
         return dl;
     }
 
@@ -1139,7 +1327,13 @@ namespace mongo {
         assert( len < Extent::maxSize() );
         int x = initialSize(len);
         // changed from 1.20 to 1.35 in v2.1.x to get to larger extent size faster
-        int y = (int) (lastExtentLen < 4000000 ? lastExtentLen * 4.0 : lastExtentLen * 1.35);
+        double mult = lastExtentLen < 4000000 ? 4.0 : 1.35;
+        if ( storageIsSSD() ) {
+            // big extents buy locality, which flash doesn't need - grow more
+            // slowly and waste less space on the tail extent
+            mult = lastExtentLen < 4000000 ? 2.0 : 1.2;
+        }
+        int y = (int) (lastExtentLen * mult);
         int sz = y > x ? y : x;
 
         if ( sz < lastExtentLen ) {
@@ -1160,8 +1354,8 @@ namespace mongo {
     /* step one of adding keys to index idxNo for a new record 
        @return true means done.  false means multikey involved and more work to do
     */
-    static void _addKeysToIndexStepOneOfTwo(BSONObjSet & /*out*/keys, NamespaceDetails *d, int idxNo, BSONObj& obj, DiskLoc recordLoc, IndexDetails& idx) {
-        idx.getKeysFromObject(obj, keys);
+    static void _addKeysToIndexStepOneOfTwo(BSONObjSet & /*out*/keys, NamespaceDetails *d, int idxNo, BSONObj& obj, DiskLoc recordLoc, IndexDetails& idx, BSONObjFieldIndex *docIndex = 0) {
+        idx.getKeysFromObject(obj, keys, docIndex);
         if( keys.empty() )
             return;
         bool dupsAllowed = !idx.unique();
@@ -1221,12 +1415,14 @@ namespace mongo {
         IndexInterface::phasedBegin();
 
         int n = d->nIndexesBeingBuilt();
+        // one field table for the document, shared by every index's key extraction
+        BSONObjFieldIndex docIndex( obj );
         {
             BSONObjSet keys;
             for ( int i = 0; i < n; i++ ) {
                 IndexDetails& idx = d->idx(i);
                 // this call throws on unique constraint violation.  we haven't done any writes yet so that is fine.
-                _addKeysToIndexStepOneOfTwo(/*out*/keys, d, i, obj, loc, idx);
+                _addKeysToIndexStepOneOfTwo(/*out*/keys, d, i, obj, loc, idx, n > 1 ? &docIndex : 0);
                 if( keys.size() > 1 ) {
                     multi.push_back(i);
                     multiKeys.push_back(BSONObjSet());
@@ -1434,6 +1630,12 @@ namespace mongo {
 
         if( phase1->multi )
             d->setIndexIsMultikey(idxNo);
+        else {
+            // a full rebuild (reIndex, compact, repair) is authoritative: if no
+            // document produced multiple keys, clear any stale multikey flag so
+            // the query optimizer gets its non-multikey plans back.
+            d->clearIndexIsMultikey(idxNo);
+        }
 
         if ( logLevel > 1 ) printMemInfo( "before final sort" );
         phase1->sorter->sort();
@@ -1461,6 +1663,49 @@ namespace mongo {
         return phase1->n;
     }
 
+    /* IO budget for background index builds, in MB of document data indexed per
+       second.  0 (the default) means unthrottled.  runtime adjustable via
+       { setParameter : 1 , indexBuildThrottleMBPerSec : <n> } and re-read on every
+       pacing decision, so it takes effect on a build already in progress. */
+    int indexBuildThrottleMBPerSec = 0;
+
+    namespace {
+        /* token bucket pacing for background index builds.  charge() the bytes just
+           indexed; owedMicros() drains tokens earned since the last check and, once
+           the deficit is worth a real sleep, returns how long to pause.  callers
+           must only sleep with the db lock yielded - throttling must slow the
+           build, never the operations it is trying to protect. */
+        class IndexBuildPacer {
+        public:
+            IndexBuildPacer() : _debt(0), _last(curTimeMicros64()) {}
+
+            void charge( int bytes ) { _debt += bytes; }
+
+            long long owedMicros() {
+                unsigned long long now = curTimeMicros64();
+                long long budget = indexBuildThrottleMBPerSec; // MB/s == bytes/microsecond
+                if ( budget <= 0 ) {
+                    _debt = 0;
+                    _last = now;
+                    return 0;
+                }
+                _debt -= (long long)( now - _last ) * budget;
+                _last = now;
+                if ( _debt < 0 )
+                    _debt = 0; // idle time doesn't bank a burst
+                long long micros = _debt / budget;
+                if ( micros < 10000 )
+                    return 0; // not worth a yield yet; keep accumulating
+                _debt = 0; // the caller is about to sleep it off
+                return micros < 1000000 ? micros : 1000000; // stay responsive to kill/setParameter
+            }
+
+        private:
+            long long _debt; // bytes indexed but not yet paid for
+            unsigned long long _last;
+        };
+    }
+
     class BackgroundIndexBuildJob : public BackgroundOperation {
 
         unsigned long long addExistingToIndex(const char *ns, NamespaceDetails *d, IndexDetails& idx, int idxNo) {
@@ -1470,6 +1715,7 @@ namespace mongo {
             ProgressMeter& progress = cc().curop()->setMessage( "bg index build" , d->stats.nrecords );
 
             unsigned long long n = 0;
+            IndexBuildPacer pacer;
             auto_ptr<ClientCursor> cc;
             {
                 shared_ptr<Cursor> c = theDataFileMgr.findAll(ns);
@@ -1479,6 +1725,7 @@ namespace mongo {
 
             while ( cc->ok() ) {
                 BSONObj js = cc->current();
+                pacer.charge( js.objsize() );
                 try {
                     {
                         if ( !dupsAllowed && dropDups ) {
@@ -1522,7 +1769,19 @@ namespace mongo {
 
                 getDur().commitIfNeeded();
 
-                if ( cc->yieldSometimes( ClientCursor::WillNeed ) ) {
+                long long paceMicros = pacer.owedMicros();
+                if ( paceMicros > 0 ) {
+                    // over budget: a forced yield that sleeps with the lock released
+                    if ( cc->yield( (int) paceMicros ) ) {
+                        progress.setTotalWhileRunning( d->stats.nrecords );
+                    }
+                    else {
+                        cc.release();
+                        uasserted(16299, "cursor gone during bg index");
+                        break;
+                    }
+                }
+                else if ( cc->yieldSometimes( ClientCursor::WillNeed ) ) {
                     progress.setTotalWhileRunning( d->stats.nrecords );
                 }
                 else {
@@ -1535,6 +1794,104 @@ namespace mongo {
             return n;
         }
 
+        /* incremental build used when the collection has an _id index.  existing docs are
+           read in _id order in small chunks; each chunk is indexed with the write lock
+           held only briefly and the lock is released completely in between, so concurrent
+           operations never wait on us for more than a few milliseconds.
+
+           a chunk boundary is a clean snapshot point because writers maintain the
+           in-progress index themselves (see indexRecordUsingTwoSteps / unindexRecord):
+           docs behind our resume point are kept up to date by the writers, docs ahead of
+           it we will reach via the _id index, and a doc indexed by both sides just hits
+           the benign "key already in index" case in addKeysToIndex.  resuming is a btree
+           seek on the last _id handled, so nothing depends on a cursor surviving the
+           unlocked window.
+        */
+        unsigned long long addExistingToIndexChunked(const char *ns, NamespaceDetails *d, IndexDetails& idx, int idxNo, int idIdxNo) {
+            bool dupsAllowed = !idx.unique();
+            bool dropDups = idx.dropDups();
+
+            enum { ChunkDocs = 1000, ChunkMillis = 10 };
+
+            ProgressMeter& progress = cc().curop()->setMessage( "bg index build" , d->stats.nrecords );
+
+            unsigned long long n = 0;
+            IndexBuildPacer pacer;
+            BSONObj lastKey; // resume point - empty means start at the beginning
+            bool done = false;
+            while( !done ) {
+                { // bounded locked interval
+                    Timer chunkTimer;
+                    list<DiskLoc> toDelete;
+                    BSONObj start = lastKey.isEmpty() ? BSON( "" << MINKEY ) : lastKey;
+                    scoped_ptr<BtreeCursor> c( BtreeCursor::make( d, idIdxNo, d->idx(idIdxNo), start, BSON( "" << MAXKEY ), true, 1 ) );
+                    int docs = 0;
+                    while( 1 ) {
+                        if( !c->ok() ) {
+                            done = true;
+                            break;
+                        }
+                        if( !lastKey.isEmpty() && c->currKey().woCompare( lastKey ) == 0 ) {
+                            // _id is unique so this is just the doc we ended the last chunk on
+                            c->advance();
+                            continue;
+                        }
+                        DiskLoc loc = c->currLoc();
+                        BSONObj js = loc.obj();
+                        try {
+                            if ( !dupsAllowed && dropDups ) {
+                                LastError::Disabled led( lastError.get() );
+                                addKeysToIndex(d, idxNo, js, loc, dupsAllowed);
+                            }
+                            else {
+                                addKeysToIndex(d, idxNo, js, loc, dupsAllowed);
+                            }
+                        }
+                        catch( AssertionException& e ) {
+                            if( e.interrupted() ) {
+                                killCurrentOp.checkForInterrupt();
+                            }
+                            if ( !dropDups ) {
+                                log() << "background addExistingToIndexChunked exception " << e.what() << endl;
+                                throw;
+                            }
+                            toDelete.push_back(loc);
+                        }
+                        n++;
+                        docs++;
+                        pacer.charge( js.objsize() );
+                        progress.hit();
+                        lastKey = c->currKey().getOwned();
+                        c->advance();
+                        if( docs >= ChunkDocs || chunkTimer.millis() >= ChunkMillis )
+                            break;
+                    }
+                    c.reset();
+                    // now that the cursor is gone, drop the dups we collected
+                    for( list<DiskLoc>::iterator i = toDelete.begin(); i != toDelete.end(); i++ ) {
+                        theDataFileMgr.deleteRecord( ns, i->rec(), *i, false, true , true );
+                    }
+                    getDur().commitIfNeeded();
+                }
+                if( done )
+                    break;
+                {
+                    dbtemprelease release; // let waiting readers and writers in
+                    killCurrentOp.checkForInterrupt();
+                    // pay off the chunk's IO debt here, where we hold nothing
+                    long long paceMicros = pacer.owedMicros();
+                    if ( paceMicros > 0 )
+                        sleepmicros( paceMicros );
+                }
+                // things may have changed while we were unlocked
+                uassert( 16230 , "ns gone during incremental bg index build" ,
+                         cc().database() && nsdetails(ns) == d && idxNo == d->nIndexes && d->indexBuildInProgress );
+                progress.setTotalWhileRunning( d->stats.nrecords );
+            }
+            progress.finished();
+            return n;
+        }
+
         /* we do set a flag in the namespace for quick checking, but this is our authoritative info -
            that way on a crash/restart, we don't think we are still building one. */
         set<NamespaceDetails*> bgJobsInProgress;
@@ -1559,7 +1916,11 @@ namespace mongo {
             assert( idxNo == d->nIndexes );
             try {
                 idx.head.writing() = idx.idxInterface().addBucket(idx);
-                n = addExistingToIndex(ns.c_str(), d, idx, idxNo);
+                int idIdxNo = d->capped ? -1 : d->findIdIndex();
+                if( idIdxNo >= 0 )
+                    n = addExistingToIndexChunked(ns.c_str(), d, idx, idxNo, idIdxNo);
+                else
+                    n = addExistingToIndex(ns.c_str(), d, idx, idxNo);
             }
             catch(...) {
                 if( cc().database() && nsdetails(ns.c_str()) == d ) {
@@ -1721,11 +2082,12 @@ namespace mongo {
     // dummy data here, keeping pointers to the btree nodes holding the dummy data and then
     // updating the dummy data with the DiskLoc of the real record.
     void checkNoIndexConflicts( NamespaceDetails *d, const BSONObj &obj ) {
+        BSONObjFieldIndex docIndex( obj ); // lazy; only built if a unique index extracts
         for ( int idxNo = 0; idxNo < d->nIndexes; idxNo++ ) {
             if( d->idx(idxNo).unique() ) {
                 IndexDetails& idx = d->idx(idxNo);
                 BSONObjSet keys;
-                idx.getKeysFromObject(obj, keys);
+                idx.getKeysFromObject(obj, keys, d->nIndexes > 1 ? &docIndex : 0);
                 BSONObj order = idx.keyPattern();
                 IndexInterface& ii = idx.idxInterface();
                 for ( BSONObjSet::iterator i=keys.begin(); i != keys.end(); i++ ) {
@@ -2000,7 +2362,11 @@ namespace mongo {
         Record *r = loc.rec();
         {
             assert( r->lengthWithHeaders >= lenWHdr );
-            r = (Record*) getDur().writingPtr(r, lenWHdr);
+            // declare write intent over the header and the document bytes only, not
+            // the allocation padding - otherwise the journal copies and writes the
+            // (garbage) padding of every insert, which with paddingFactor near 2
+            // nearly doubles journal traffic on ingest
+            r = (Record*) getDur().writingPtr(r, Record::HeaderSize + len);
             if( addID ) {
                 /* a little effort was made here to avoid a double copy when we add an ID */
                 ((int&)*r->data) = *((int*) obuf) + idToInsert.size();
@@ -2059,9 +2425,233 @@ namespace mongo {
 
         d->paddingFits();
 
+        if ( d->capped )
+            notifyCappedInsert( ns ); // wake tailable cursors awaiting data
+
         return loc;
     }
 
+    namespace {
+        /** one queued index entry during a batch insert */
+        struct BatchedKey {
+            BSONObj key;
+            DiskLoc loc;
+        };
+        /** order entries by key so each btree is walked roughly left to right rather
+            than jumping to a random bucket once per document */
+        struct BatchedKeyCmp {
+            IndexInterface& ii;
+            const Ordering& ordering;
+            BatchedKeyCmp( IndexInterface& i, const Ordering& o ) : ii( i ), ordering( o ) { }
+            bool operator()( const BatchedKey& l, const BatchedKey& r ) const {
+                int x = ii.keyCompare( l.key, r.key, ordering );
+                if ( x != 0 )
+                    return x < 0;
+                return l.loc < r.loc;
+            }
+        };
+    }
+
+    /** see comments in pdfile.h.  the strategy is, per chunk of documents:
+        (1) generate all index keys and screen unique constraints before anything is
+            written -- the write lock is never released, so the screening stays
+            authoritative -- then
+        (2) allocate, copy and link all the records, then
+        (3) apply index keys one index at a time, each in sorted key order, then
+        (4) write the oplog entries in the original document order.
+        a document that fails screening is left out of the batch; its position is
+        returned so the caller can re-run it through the ordinary insert path, which
+        raises the real error (e.g. the dup key message names the index).  note
+        findSingle is not guaranteed for compound unique indexes, so (3) can in
+        principle still hit a dup; if it does we unwind the chunk's records via
+        deleteRecord and rethrow, sacrificing the prefix-inserted guarantee for
+        consistency in that rare case.
+    */
+    int DataFileMgr::insertBatch(const char *ns, const vector<BSONObj>& objs, bool keepGoing, int& nComplete) {
+        NamespaceDetails *d = nsdetails(ns);
+        massert( 16233, "insertBatch: collection missing or capped", d && !d->capped );
+
+        enum { ChunkDocs = 256 };
+        int retry = -1;
+
+        for( unsigned base = 0; base < objs.size(); base += ChunkDocs ) {
+            unsigned n = objs.size() - base;
+            if ( n > ChunkDocs )
+                n = ChunkDocs;
+            int nIndexes = d->nIndexesBeingBuilt();
+
+            // (1) key generation and unique screening
+            vector< vector<BSONObjSet> > keys( nIndexes, vector<BSONObjSet>( n ) );
+            vector<BSONObjSet> seen( nIndexes ); // unique keys queued so far this chunk
+            vector<bool> skip( n, false );
+            unsigned nTake = n;
+            for( unsigned k = 0; k < nTake; k++ ) {
+                try {
+                    // one field table per document, shared by every index's key extraction
+                    BSONObjFieldIndex docIndex( objs[base+k] );
+                    for( int i = 0; i < nIndexes; i++ )
+                        d->idx(i).getKeysFromObject( objs[base+k], keys[i][k], nIndexes > 1 ? &docIndex : 0 );
+                    for( int i = 0; i < nIndexes; i++ ) {
+                        IndexDetails& idx = d->idx(i);
+                        if ( !idx.unique() )
+                            continue;
+                        IndexInterface& ii = idx.idxInterface();
+                        for( BSONObjSet::const_iterator j = keys[i][k].begin(); j != keys[i][k].end(); j++ ) {
+                            uassert( 16234, "insertBatch: duplicate key", ii.findSingle( idx, idx.head, *j ).isNull() );
+                            uassert( 16235, "insertBatch: duplicate key in batch", !seen[i].count( *j ) );
+                        }
+                    }
+                    // all screens passed -- only now queue this document's keys, so a
+                    // skipped document can't falsely dup a later one against itself
+                    for( int i = 0; i < nIndexes; i++ ) {
+                        if ( d->idx(i).unique() )
+                            seen[i].insert( keys[i][k].begin(), keys[i][k].end() );
+                    }
+                }
+                catch ( const AssertionException& ) {
+                    if ( !keepGoing ) {
+                        // stop before this document; the caller retries it alone and
+                        // its error stops the whole operation, as the serial loop would
+                        retry = base + k;
+                        nTake = k;
+                    }
+                    else {
+                        skip[k] = true;
+                        if ( base + k == objs.size() - 1 )
+                            retry = base + k; // a failing final document is always surfaced
+                    }
+                }
+            }
+
+            // (2) allocate and copy the records.  they are reachable by collection
+            // scans from here on but have no index keys yet; we hold the write lock
+            // until (3) completes so that state is never visible.
+            vector<DiskLoc> locs( nTake );
+            try {
+                for( unsigned k = 0; k < nTake; k++ ) {
+                    if ( skip[k] )
+                        continue;
+                    const BSONObj& o = objs[base+k];
+                    BSONElementManipulator::lookForTimestamps( o );
+                    int lenWHdr = o.objsize() + Record::HeaderSize;
+                    lenWHdr = (int) (lenWHdr * d->paddingFactor);
+                    if ( lenWHdr == 0 ) {
+                        // old datafiles, backward compatible here.
+                        assert( d->paddingFactor == 0 );
+                        *getDur().writing(&d->paddingFactor) = 1.0;
+                        lenWHdr = o.objsize() + Record::HeaderSize;
+                    }
+                    DiskLoc loc = allocateSpaceForANewRecord( ns, d, lenWHdr, false );
+                    massert( 16236, "insertBatch: couldn't alloc space for object", !loc.isNull() );
+                    Record *r = loc.rec();
+                    assert( r->lengthWithHeaders >= lenWHdr );
+                    // header + document bytes only - see the matching comment in insert()
+                    r = (Record*) getDur().writingPtr(r, Record::HeaderSize + o.objsize());
+                    memcpy(r->data, o.objdata(), o.objsize());
+                    addRecordToRecListInExtent(r, loc);
+                    {
+                        NamespaceDetails::Stats *s = getDur().writing(&d->stats);
+                        s->datasize += r->netLength();
+                        s->nrecords++;
+                    }
+                    locs[k] = loc;
+                }
+            }
+            catch( ... ) {
+                // e.g. out of space mid chunk.  drop the keyless records already
+                // placed so the collection stays consistent, then surface the error.
+                for( unsigned k = 0; k < nTake; k++ ) {
+                    if ( !skip[k] && !locs[k].isNull() )
+                        _deleteRecord( d, ns, locs[k].rec(), locs[k] );
+                }
+                throw;
+            }
+
+            // (3) index the chunk, index-major, keys sorted
+            try {
+                for( int i = 0; i < nIndexes; i++ ) {
+                    IndexDetails& idx = d->idx(i);
+                    IndexInterface& ii = idx.idxInterface();
+                    Ordering ordering = Ordering::make( idx.keyPattern() );
+                    vector<BatchedKey> entries;
+                    for( unsigned k = 0; k < nTake; k++ ) {
+                        if ( skip[k] )
+                            continue;
+                        BSONObjSet& ks = keys[i][k];
+                        if ( ks.size() > 1 )
+                            d->setIndexIsMultikey( i );
+                        for( BSONObjSet::const_iterator j = ks.begin(); j != ks.end(); j++ ) {
+                            BatchedKey e;
+                            e.key = *j;
+                            e.loc = locs[k];
+                            entries.push_back( e );
+                        }
+                    }
+                    sort( entries.begin(), entries.end(), BatchedKeyCmp( ii, ordering ) );
+                    for( vector<BatchedKey>::const_iterator e = entries.begin(); e != entries.end(); e++ ) {
+                        try {
+                            ii.bt_insert( idx.head, e->loc, e->key, ordering, !idx.unique(), idx );
+                        }
+                        catch ( AssertionException& ae ) {
+                            if ( ae.getCode() == 10287 && i == d->nIndexes ) {
+                                // dup key exception on the index being built in the background; that's ok
+                                DEV log() << "info: caught key already in index on bg indexing (ok)" << endl;
+                                continue;
+                            }
+                            throw;
+                        }
+                    }
+                }
+            }
+            catch( ... ) {
+                // unexpected -- (1) screened unique constraints with the lock held
+                // throughout.  unwind the chunk (deleteRecord unindexes whatever keys
+                // did land; missing ones just warn) and rethrow.
+                for( unsigned k = 0; k < nTake; k++ ) {
+                    if ( skip[k] || locs[k].isNull() )
+                        continue;
+                    try {
+                        deleteRecord( ns, locs[k].rec(), locs[k], false, true );
+                    }
+                    catch( DBException& ) {
+                        log() << "insertBatch: couldn't roll back record " << locs[k].toString() << endl;
+                    }
+                }
+                throw;
+            }
+
+            // (4) oplog and bookkeeping, original document order.  the ops share
+            // one oplog allocation per chunk - see logOps.
+            NamespaceDetailsTransient& nsdt = NamespaceDetailsTransient::get( ns );
+            vector<BSONObj> toLog;
+            for( unsigned k = 0; k < nTake; k++ ) {
+                if ( skip[k] ) {
+                    // the serial keepGoing loop counts skipped documents too -- but
+                    // not the one handed back for retry, which is counted (or not)
+                    // by the caller depending on how its retry goes
+                    if ( (int)(base + k) != retry )
+                        nComplete++;
+                    continue;
+                }
+                toLog.push_back( objs[base+k] );
+                nsdt.notifyOfWriteOp();
+                d->paddingFits();
+                nComplete++;
+            }
+            logOps("i", ns, toLog);
+
+            // everything this far is complete and logged, so it is safe to group
+            // commit and to bail out on a killOp between chunks
+            getDur().commitIfNeeded();
+            killCurrentOp.checkForInterrupt();
+
+            if ( retry != -1 )
+                break;
+        }
+
+        return retry;
+    }
+
     /* special version of insert for transaction logging -- streamlined a bit.
        assumes ns is capped and no indexes
     */
@@ -2105,6 +2695,63 @@ namespace mongo {
         return r;
     }
 
+    void DataFileMgr::fast_oplog_insert_batch(NamespaceDetails *d, const char *ns, const vector<int>& lens, vector<Record*>& out) {
+        assert( d );
+        RARELY assert( d == nsdetails(ns) );
+        DEV assert( d == nsdetails(ns) );
+        assert( !lens.empty() );
+
+        /* one allocation for the whole batch; each record gets the 4 byte alignment
+           alloc() would have given it individually */
+        int total = 0;
+        for( unsigned i = 0; i < lens.size(); i++ )
+            total += (lens[i] + Record::HeaderSize + 3) & 0xfffffffc;
+
+        DiskLoc extentLoc;
+        DiskLoc loc = d->alloc(ns, total, extentLoc);
+        assert( !loc.isNull() );
+        int regionlen = loc.rec()->lengthWithHeaders;
+        assert( regionlen >= total );
+        int extentOfs = loc.rec()->extentOfs;
+        Extent *e = loc.rec()->myExtent(loc);
+
+        out.clear();
+        for( unsigned i = 0; i < lens.size(); i++ ) {
+            int lenWHdr = (lens[i] + Record::HeaderSize + 3) & 0xfffffffc;
+            if ( i + 1 == lens.size() )
+                lenWHdr = regionlen; // last record absorbs the allocator's slop
+            regionlen -= lenWHdr;
+
+            Record *r = loc.rec();
+            Record *rw = (Record *) getDur().writingPtr(r, Record::HeaderSize);
+            rw->lengthWithHeaders = lenWHdr;
+            rw->extentOfs = extentOfs; // the region never spans extents
+
+            // link to the tail of the extent's record list, as in fast_oplog_insert
+            if ( e->lastRecord.isNull() ) {
+                Extent::FL *fl = getDur().writing( e->fl() );
+                fl->firstRecord = fl->lastRecord = loc;
+                rw->nextOfs = rw->prevOfs = DiskLoc::NullOfs;
+            }
+            else {
+                Record *oldlast = e->lastRecord.rec();
+                rw->prevOfs = e->lastRecord.getOfs();
+                rw->nextOfs = DiskLoc::NullOfs;
+                getDur().writingInt( oldlast->nextOfs ) = loc.getOfs();
+                e->lastRecord.writing() = loc;
+            }
+
+            {
+                NamespaceDetails::Stats *s = getDur().writing(&d->stats);
+                s->datasize += r->netLength();
+                s->nrecords++;
+            }
+
+            out.push_back(r);
+            loc.inc(lenWHdr);
+        }
+    }
+
 } // namespace mongo
 
 #include "clientcursor.h"
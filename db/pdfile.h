@@ -54,6 +54,11 @@ namespace mongo {
 
     bool isValidNS( const StringData& ns );
 
+    /** true if the dbpath device is non-rotational (forced or auto-detected
+        per --storageProfile).  steers extent sizing, extent freeing and
+        flush pacing. */
+    bool storageIsSSD();
+
     /*---------------------------------------------------------------------*/
 
     class MongoDataFile {
@@ -135,6 +140,19 @@ namespace mongo {
         void insertNoReturnVal(const char *ns, BSONObj o, bool god = false);
 
         DiskLoc insert(const char *ns, const void *buf, int len, bool god = false, bool mayAddIndex = true, bool *addedID = 0);
+
+        /** bulk insert into an ordinary (existing, non-capped) collection, amortizing
+            the index btree work across the batch.  documents must already have _id
+            fields; the caller screens for eligibility (see insertMulti) and holds the
+            write lock for the duration.
+            @param nComplete incremented as documents complete, so op counters stay
+                   accurate if we throw partway through
+            @return position of a document the batch could not take -- to be retried
+                    via the single document path, which raises the authentic error --
+                    or -1 if all documents were handled here
+        */
+        int insertBatch(const char *ns, const vector<BSONObj>& objs, bool keepGoing, int& nComplete);
+
         static shared_ptr<Cursor> findAll(const char *ns, const DiskLoc &startLoc = DiskLoc());
 
         /* special version of insert for transaction logging -- streamlined a bit.
@@ -143,12 +161,21 @@ namespace mongo {
         */
         Record* fast_oplog_insert(NamespaceDetails *d, const char *ns, int len);
 
+        /* batch version of the above: one capped allocation carved into one record
+           per op.  @param lens data length of each op (without record header);
+           @param out filled with one Record* per len, bodies not yet written. */
+        void fast_oplog_insert_batch(NamespaceDetails *d, const char *ns, const vector<int>& lens, vector<Record*>& out);
+
         static Extent* getExtent(const DiskLoc& dl);
         static Record* getRecord(const DiskLoc& dl);
         static DeletedRecord* makeDeletedRecord(const DiskLoc& dl, int len);
 
         void deleteRecord(const char *ns, Record *todelete, const DiskLoc& dl, bool cappedOK = false, bool noWarn = false, bool logOp=false);
 
+        /* delete a batch of records, unindexing each index in key-sorted runs to keep
+           btree bucket pages hot.  no oplog and no capped support - see deleteRecord. */
+        void bulkDeleteRecords(const char *ns, const vector<DiskLoc>& dls, bool noWarn = false);
+
         /* does not clean up indexes, etc. : just deletes the record in the pdfile. use deleteRecord() to unindex */
         void _deleteRecord(NamespaceDetails *d, const char *ns, Record *todelete, const DiskLoc& dl);
 
@@ -158,6 +185,10 @@ namespace mongo {
 
     extern DataFileMgr theDataFileMgr;
 
+    /* MB of document data indexed per second by background index builds; 0 means
+       unthrottled.  runtime adjustable via setParameter. */
+    extern int indexBuildThrottleMBPerSec;
+
 #pragma pack(1)
 
     class DeletedRecord {
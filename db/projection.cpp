@@ -126,21 +126,52 @@ namespace mongo {
     }
 
     void Projection::transform( const BSONObj& in , BSONObjBuilder& b ) const {
+        /* fast path: documents are almost always field-sorted in practice (they
+           come out the way they went in), and the flat field table is sorted, so
+           we can walk both in one merged pass - one strcmp per document field
+           instead of a table lookup.  the moment the document stops being
+           strictly sorted we drop to the general per-field lookup for the rest,
+           which is correct for any field order (including duplicates). */
+        const vector< pair<const char*,Projection*> > &flat = _flat();
+        unsigned fi = 0;          // next unmatched table entry
+        const char *prev = 0;     // last field seen while the doc looked sorted
+        bool ordered = true;
+
         BSONObjIterator i(in);
         while ( i.more() ) {
             BSONElement e = i.next();
-            if ( mongoutils::str::equals( "_id" , e.fieldName() ) ) {
+            const char *name = e.fieldName();
+
+            if ( ordered && prev && strcmp( prev, name ) >= 0 )
+                ordered = false;
+            prev = name;
+
+            Projection *field;
+            if ( ordered ) {
+                int x = -1;
+                while ( fi < flat.size() && ( x = strcmp( name, flat[fi].first ) ) > 0 )
+                    fi++; // table field not present in this (sorted) doc
+                field = ( fi < flat.size() && x == 0 ) ? flat[fi++].second : 0;
+            }
+            else {
+                field = _findField( name );
+            }
+
+            if ( mongoutils::str::equals( "_id" , name ) ) {
                 if ( _includeID )
                     b.append( e );
             }
             else {
-                append( b , e );
+                _appendWith( b , e , field );
             }
         }
     }
 
     BSONObj Projection::transform( const BSONObj& in ) const {
-        BSONObjBuilder b;
+        // the tracker remembers recent output sizes and the builder reports its
+        // final size back to it on obj(), so after the first few documents the
+        // initial buffer is usually big enough and grow() never fires
+        BSONObjBuilder b( _sizeTracker );
         transform( in , b );
         return b.obj();
     }
@@ -192,15 +223,44 @@ namespace mongo {
         }
     }
 
+    const vector< pair<const char*,Projection*> >& Projection::_flat() const {
+        if ( _flatFields.size() != _fields.size() ) {
+            _flatFields.clear();
+            _flatFields.reserve( _fields.size() );
+            for ( FieldMap::const_iterator i = _fields.begin(); i != _fields.end(); ++i )
+                _flatFields.push_back( make_pair( i->first.c_str(), i->second.get() ) );
+        }
+        return _flatFields;
+    }
+
+    Projection* Projection::_findField( const char* name ) const {
+        _flat();
+        int lo = 0;
+        int hi = (int)_flatFields.size() - 1;
+        while ( lo <= hi ) {
+            int mid = ( lo + hi ) / 2;
+            int x = strcmp( name , _flatFields[mid].first );
+            if ( x == 0 )
+                return _flatFields[mid].second;
+            if ( x < 0 )
+                hi = mid - 1;
+            else
+                lo = mid + 1;
+        }
+        return 0;
+    }
+
     void Projection::append( BSONObjBuilder& b , const BSONElement& e ) const {
-        FieldMap::const_iterator field = _fields.find( e.fieldName() );
+        _appendWith( b , e , _findField( e.fieldName() ) );
+    }
 
-        if (field == _fields.end()) {
+    void Projection::_appendWith( BSONObjBuilder& b , const BSONElement& e , Projection* field ) const {
+        if ( ! field ) {
             if (_include)
                 b.append(e);
         }
         else {
-            Projection& subfm = *field->second;
+            Projection& subfm = *field;
 
             if ((subfm._fields.empty() && !subfm._special) || !(e.type()==Object || e.type()==Array) ) {
                 if (subfm._include)
@@ -247,11 +307,8 @@ namespace mongo {
 
             if ( _source[k.fieldName()].type() ) {
 
-                if ( strchr( k.fieldName() , '.' ) ) {
-                    // TODO we currently don't support dotted fields
-                    //      SERVER-2104
-                    return 0;
-                }
+                // dotted key fields are fine as long as the projection names the
+                // exact same path - hydrate() nests them back into subobjects
 
                 if ( ! _includeID && mongoutils::str::equals( k.fieldName() , "_id" ) ) {
                     p->addNo();
@@ -280,11 +337,56 @@ namespace mongo {
         return 0;
     }
 
+    /* append the given (name,value) pairs to b, grouping names that share a
+       dotted prefix into subobjects, so { "x.a", "x.b" } emits as
+       { x : { a : ... , b : ... } }
+    */
+    static void appendHydrated( BSONObjBuilder &b, const vector< pair<string,BSONElement> > &fields ) {
+        vector<bool> used( fields.size(), false );
+        for ( unsigned i = 0; i < fields.size(); i++ ) {
+            if ( used[i] )
+                continue;
+            const string &name = fields[i].first;
+            size_t dot = name.find( '.' );
+            if ( dot == string::npos ) {
+                b.appendAs( fields[i].second, name );
+                continue;
+            }
+            string prefix = name.substr( 0, dot + 1 ); // "x."
+            vector< pair<string,BSONElement> > sub;
+            for ( unsigned j = i; j < fields.size(); j++ ) {
+                if ( !used[j] && fields[j].first.compare( 0, prefix.size(), prefix ) == 0 ) {
+                    sub.push_back( make_pair( fields[j].first.substr( prefix.size() ), fields[j].second ) );
+                    used[j] = true;
+                }
+            }
+            BSONObjBuilder s( b.subobjStart( name.substr( 0, dot ) ) );
+            appendHydrated( s, sub );
+            s.done();
+        }
+    }
+
     BSONObj Projection::KeyOnly::hydrate( const BSONObj& key ) const {
         assert( _include.size() == _names.size() );
 
         BSONObjBuilder b( key.objsize() + _stringSize + 16 );
 
+        if ( _haveDotted ) {
+            vector< pair<string,BSONElement> > fields;
+            BSONObjIterator i(key);
+            unsigned n=0;
+            while ( i.more() ) {
+                assert( n < _include.size() );
+                BSONElement e = i.next();
+                if ( _include[n] ) {
+                    fields.push_back( make_pair( _names[n], e ) );
+                }
+                n++;
+            }
+            appendHydrated( b, fields );
+            return b.obj();
+        }
+
         BSONObjIterator i(key);
         unsigned n=0;
         while ( i.more() ) {
@@ -33,7 +33,7 @@ namespace mongo {
         class KeyOnly {
         public:
 
-            KeyOnly() : _stringSize(0) {}
+            KeyOnly() : _stringSize(0) , _haveDotted(false) {}
 
             BSONObj hydrate( const BSONObj& key ) const;
 
@@ -46,12 +46,15 @@ namespace mongo {
                 _include.push_back( b );
                 _names.push_back( name );
                 _stringSize += name.size();
+                if ( name.find( '.' ) != string::npos )
+                    _haveDotted = true;
             }
 
             vector<bool> _include; // one entry per field in key.  true iff should be in output
-            vector<string> _names; // name of field since key doesn't have names
+            vector<string> _names; // name of field since key doesn't have names.  may be dotted.
 
             int _stringSize;
+            bool _haveDotted; // a dotted name means hydrate must build subobjects
         };
 
         Projection() :
@@ -104,6 +107,10 @@ namespace mongo {
          */
         void append( BSONObjBuilder& b , const BSONElement& e ) const;
 
+        /** append() after the sub-projection for e has already been looked up
+            (0 if the projection doesn't name e's field) */
+        void _appendWith( BSONObjBuilder& b , const BSONElement& e , Projection* field ) const;
+
 
         void add( const string& field, bool include );
         void add( const string& field, int skip, int limit );
@@ -112,9 +119,20 @@ namespace mongo {
         bool _include; // true if default at this level is to include
         bool _special; // true if this level can't be skipped or included without recursing
 
+        /** look a top level field up without constructing a string temporary.
+            @return the sub-projection for the field, or 0 if there is none */
+        Projection* _findField( const char* name ) const;
+
+        /** the sorted flat field table, built on first use */
+        const vector< pair<const char*,Projection*> >& _flat() const;
+
         //TODO: benchmark vector<pair> vs map
         typedef map<string, boost::shared_ptr<Projection> > FieldMap;
         FieldMap _fields;
+
+        // flat view of _fields (c string keys, in map order so already sorted),
+        // built lazily by _findField(); _fields is stable once init() is done
+        mutable vector< pair<const char*,Projection*> > _flatFields;
         BSONObj _source;
         bool _includeID;
 
@@ -123,6 +141,11 @@ namespace mongo {
         int _limit;
 
         bool _hasNonSimple;
+
+        // learned output sizes for the object-returning transform(), so repeated
+        // transforms (e.g. findAndModify's per-match projection) start with a big
+        // enough buffer instead of growing through several reallocations
+        mutable BSONSizeTracker _sizeTracker;
     };
 
 
@@ -475,17 +475,27 @@ doneCheckOrder:
                     p.reset( new QueryPlan( d, -1, *_frsp, _originalFrsp.get(), _originalQuery, _order, _mustAssertOnYieldFailure ) );
                 }
 
+                bool recordedPlanUseless = false;
                 NamespaceDetails::IndexIterator i = d->ii();
                 while( i.more() ) {
                     int j = i.pos();
                     IndexDetails& ii = i.next();
                     if( ii.keyPattern().woCompare(bestIndex) == 0 ) {
-                        p.reset( new QueryPlan( d, j, *_frsp, _originalFrsp.get(), _originalQuery, _order, _mustAssertOnYieldFailure ) );
+                        if ( QueryUtilIndexed::indexUseful( *_frsp, d, j, _order ) ) {
+                            p.reset( new QueryPlan( d, j, *_frsp, _originalFrsp.get(), _originalQuery, _order, _mustAssertOnYieldFailure ) );
+                        }
+                        else {
+                            // can happen with a partial (filtered) index : query patterns don't
+                            // distinguish equality values, so a plan recorded for a query that
+                            // implied the index filter may be looked up by one that doesn't.
+                            // fall through and replan.
+                            recordedPlanUseless = true;
+                        }
                     }
                 }
 
-                massert( 10368 ,  "Unable to locate previously recorded index", p.get() );
-                if ( !( _bestGuessOnly && p->scanAndOrderRequired() ) ) {
+                massert( 10368 ,  "Unable to locate previously recorded index", p.get() || recordedPlanUseless );
+                if ( p.get() && !( _bestGuessOnly && p->scanAndOrderRequired() ) ) {
                     _usingPrerecordedPlan = true;
                     _mayRecordPlan = false;
                     _plans.push_back( p );
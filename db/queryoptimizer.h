@@ -550,6 +550,9 @@ namespace mongo {
     /** NOTE min, max, and keyPattern will be updated to be consistent with the selected index. */
     IndexDetails *indexDetailsForRange( const char *ns, string &errmsg, BSONObj &min, BSONObj &max, BSONObj &keyPattern );
 
+    /** a key just beyond the index's edge in baseDirection (all MaxKey components for 1, all MinKey for -1) */
+    BSONObj extremeKeyForIndex( const BSONObj &idxPattern, int baseDirection );
+
     bool isSimpleIdQuery( const BSONObj& query );
 
     /**
@@ -77,6 +77,27 @@ namespace mongo {
         return BSON( "query" << b.done() << "sort" << _sort ).toString();
     }
     
+    BSONObj QueryPattern::toBson() const {
+        BSONObjBuilder fields;
+        for( map<string,Type>::const_iterator i = _fieldTypes.begin(); i != _fieldTypes.end(); ++i )
+            fields.append( i->first, (int)i->second );
+        BSONObjBuilder b;
+        b.append( "fields", fields.obj() );
+        b.append( "sort", _sort );
+        return b.obj();
+    }
+
+    QueryPattern QueryPattern::fromBson( const BSONObj &o ) {
+        QueryPattern pattern;
+        BSONObjIterator i( o.getObjectField( "fields" ) );
+        while( i.more() ) {
+            BSONElement e = i.next();
+            pattern._fieldTypes[ e.fieldName() ] = (Type)e.numberInt();
+        }
+        pattern._sort = o.getObjectField( "sort" ).getOwned();
+        return pattern;
+    }
+
     void QueryPattern::setSort( const BSONObj sort ) {
         _sort = normalizeSort( sort );
     }
@@ -46,7 +46,12 @@ namespace mongo {
         bool operator!=( const QueryPattern &other ) const;
         /** for development / debugging */
         string toString() const;
+        /** serialize so a recorded plan can be persisted across restarts */
+        BSONObj toBson() const;
+        /** inverse of toBson() */
+        static QueryPattern fromBson( const BSONObj &o );
     private:
+        QueryPattern() {} // for fromBson()
         void setSort( const BSONObj sort );
         static BSONObj normalizeSort( const BSONObj &spec );
         map<string,Type> _fieldTypes;
@@ -30,6 +30,49 @@ namespace mongo {
     extern BSONObj staticNull;
     extern BSONObj staticUndefined;
 
+    /** if regex points just past a "(?:" and the group holds only plain
+        literal alternatives - no metacharacters, no nesting, no quantifier on
+        the group - advance regex past the closing paren and return through
+        common the longest prefix shared by every alternative.
+        returns false, leaving regex untouched, otherwise.
+    */
+    static bool literalAlternationPrefix( const char *&regex, string &common ) {
+        const char *p = regex;
+        vector<string> alts( 1 );
+        while( *p && *p != ')' ) {
+            char c = *(p++);
+            if ( c == '|' ) {
+                alts.push_back( string() );
+            }
+            else if ( c == '\\' ) {
+                c = *(p++);
+                if ( c == 0 || isalnum( (unsigned char)c ) )
+                    return false; // escape sequence or backreference
+                alts.back() += c;
+            }
+            else if ( strchr( "^$.[({*+?", c ) ) {
+                return false; // nested metacharacter
+            }
+            else {
+                alts.back() += c;
+            }
+        }
+        if ( *p != ')' )
+            return false;
+        ++p;
+        if ( *p == '*' || *p == '?' || *p == '{' )
+            return false; // quantified group - its prefix is not guaranteed
+        common = alts[ 0 ];
+        for( unsigned i = 1; i < alts.size(); i++ ) {
+            unsigned j = 0;
+            while( j < common.size() && j < alts[ i ].size() && common[ j ] == alts[ i ][ j ] )
+                j++;
+            common.resize( j );
+        }
+        regex = p;
+        return true;
+    }
+
     /** returns a string that when used as a matcher, would match a super set of regex()
         returns "" for complex regular expressions
         used to optimize queries in some simple regex cases that start with '^'
@@ -101,7 +144,7 @@ namespace mongo {
                 }
                 else if ((c >= 'A' && c <= 'Z') ||
                         (c >= 'a' && c <= 'z') ||
-                        (c >= '0' && c <= '0') ||
+                        (c >= '0' && c <= '9') || // \1 etc is a backreference
                         (c == '\0')) {
                     // don't know what to do with these
                     r = ss.str();
@@ -114,6 +157,15 @@ namespace mongo {
             }
             else if (strchr("^$.[()+{", c)) {
                 // list of "metacharacters" from man pcrepattern
+                if ( !extended && c == '(' && regex[0] == '?' && regex[1] == ':' ) {
+                    // a group of plain literal alternatives still guarantees
+                    // whatever prefix its alternatives share, e.g.
+                    // ^INFO:(?:login|logout) -> "INFO:log"
+                    const char *p = regex + 2;
+                    string common;
+                    if ( literalAlternationPrefix( p, common ) )
+                        ss << common;
+                }
                 r = ss.str();
                 break;
             }
@@ -405,6 +457,9 @@ namespace mongo {
         case BSONObj::opWITHIN:
             _special = "2d";
             break;
+        case BSONObj::opTEXT:
+            _special = "text";
+            break;
         case BSONObj::opEXISTS: {
             if ( !existsSpec ) {
                 lower = upper = staticNull.firstElement();
@@ -873,8 +928,232 @@ namespace mongo {
         }
     }
 
+    /* --- compiled range programs ---
+       Simple conjunctive queries - equalities and $gt/$gte/$lt/$lte constraints
+       on plain fields - repeat with the same shape (field names, operators and
+       operand types) while only the literal values change.  For those we compile
+       bounds construction once: per operator, which literal slot supplies the
+       bound and what type bracket the optimize step would add on the open side.
+       Replaying the program fills a FieldRangeSet's intervals straight from the
+       query's literal elements and skips the parser.  Anything a program can't
+       represent falls back to the parser, so behavior is unchanged. */
+
+    namespace {
+
+        struct CompiledRangeOp {
+            int slot;                   // literal element index, in query walk order
+            int op;                     // BSONObj::Equality / GT / GTE / LT / LTE
+            BSONObj bracket;            // {"": min/maxForType} for the open side, empty if none
+            bool bracketLowerExclusive; // the min bracket for a Date bound is exclusive
+        };
+
+        struct CompiledRangeField {
+            string fieldName;
+            vector<CompiledRangeOp> ops;
+        };
+
+        struct CompiledRangeProgram {
+            vector<CompiledRangeField> fields;
+            bool multiOp; // some field carries more than one operator
+        };
+
+        SimpleMutex rangeProgramMutex( "rangePrograms" );
+        typedef map< string, shared_ptr<CompiledRangeProgram> > RangeProgramMap;
+        RangeProgramMap rangePrograms;
+        enum { MaxRangePrograms = 1000 };
+
+        /* one walk of a candidate query: append its shape (field names,
+           operators and operand types) to 'shape' and collect the literal
+           elements in walk order.  @return false if the query contains anything
+           a compiled program can't represent. */
+        bool rangeShapeOf( const BSONObj &query, StringBuilder &shape, vector<BSONElement> &literals ) {
+            vector<const char *> names;
+            BSONObjIterator i( query );
+            while( i.more() ) {
+                BSONElement e = i.next();
+                const char *name = e.fieldName();
+                if ( name[ 0 ] == '$' || e.type() == RegEx )
+                    return false;
+                // a duplicated field would need the parser's intersection rules
+                for( vector<const char *>::const_iterator n = names.begin(); n != names.end(); ++n ) {
+                    if ( strcmp( *n, name ) == 0 )
+                        return false;
+                }
+                names.push_back( name );
+                shape << name << '\0';
+                if ( e.type() == Object && e.embeddedObject().firstElementFieldName()[ 0 ] == '$' ) {
+                    BSONObjIterator j( e.embeddedObject() );
+                    while( j.more() ) {
+                        BSONElement f = j.next();
+                        const char *o = f.fieldName();
+                        char code;
+                        if ( strcmp( o, "$gt" ) == 0 )
+                            code = 'g';
+                        else if ( strcmp( o, "$gte" ) == 0 )
+                            code = 'G';
+                        else if ( strcmp( o, "$lt" ) == 0 )
+                            code = 'l';
+                        else if ( strcmp( o, "$lte" ) == 0 )
+                            code = 'L';
+                        else
+                            return false;
+                        if ( f.type() == RegEx ) // the parser rejects these loudly
+                            return false;
+                        shape << code << (char)( f.type() + 2 );
+                        literals.push_back( f );
+                    }
+                }
+                else {
+                    // object and array equality get multiple or content
+                    // dependent intervals from the parser
+                    if ( e.type() == Object || e.type() == Array )
+                        return false;
+                    shape << 'e' << (char)( e.type() + 2 );
+                    literals.push_back( e );
+                }
+                shape << '\0';
+            }
+            return !literals.empty();
+        }
+
+        /* build the program for a query rangeShapeOf() accepted */
+        shared_ptr<CompiledRangeProgram> compileRangeProgram( const BSONObj &query ) {
+            shared_ptr<CompiledRangeProgram> p( new CompiledRangeProgram() );
+            p->multiOp = false;
+            int slot = 0;
+            BSONObjIterator i( query );
+            while( i.more() ) {
+                BSONElement e = i.next();
+                p->fields.push_back( CompiledRangeField() );
+                CompiledRangeField &cf = p->fields.back();
+                cf.fieldName = e.fieldName();
+                if ( e.type() == Object && e.embeddedObject().firstElementFieldName()[ 0 ] == '$' ) {
+                    BSONObjIterator j( e.embeddedObject() );
+                    while( j.more() ) {
+                        BSONElement f = j.next();
+                        CompiledRangeOp op;
+                        op.slot = slot++;
+                        op.op = f.getGtLtOp();
+                        op.bracketLowerExclusive = false;
+                        if ( f.isSimpleType() ) { // mirrors the optimize step below
+                            BSONObjBuilder b( 32 );
+                            if ( op.op == BSONObj::GT || op.op == BSONObj::GTE ) {
+                                b.appendMaxForType( "", f.type() );
+                            }
+                            else {
+                                b.appendMinForType( "", f.type() );
+                                op.bracketLowerExclusive = ( f.type() == Date );
+                            }
+                            op.bracket = b.obj();
+                        }
+                        cf.ops.push_back( op );
+                    }
+                    if ( cf.ops.size() > 1 )
+                        p->multiOp = true;
+                }
+                else {
+                    CompiledRangeOp op;
+                    op.slot = slot++;
+                    op.op = BSONObj::Equality;
+                    op.bracketLowerExclusive = false;
+                    cf.ops.push_back( op );
+                }
+            }
+            return p;
+        }
+
+        /* the interval a single compiled operator yields for literal v */
+        FieldInterval compiledInterval( const CompiledRangeOp &op, const BSONElement &v ) {
+            FieldInterval iv;
+            switch( op.op ) {
+            case BSONObj::Equality:
+                iv._lower._bound = iv._upper._bound = v;
+                iv._lower._inclusive = iv._upper._inclusive = true;
+                break;
+            case BSONObj::GT:
+            case BSONObj::GTE:
+                iv._lower._bound = v;
+                iv._lower._inclusive = ( op.op == BSONObj::GTE );
+                iv._upper._bound = op.bracket.isEmpty() ? maxKey.firstElement() : op.bracket.firstElement();
+                iv._upper._inclusive = true;
+                break;
+            case BSONObj::LT:
+            case BSONObj::LTE:
+                iv._upper._bound = v;
+                iv._upper._inclusive = ( op.op == BSONObj::LTE );
+                iv._lower._bound = op.bracket.isEmpty() ? minKey.firstElement() : op.bracket.firstElement();
+                iv._lower._inclusive = !op.bracketLowerExclusive;
+                break;
+            default:
+                assert( false );
+            }
+            return iv;
+        }
+
+    } // namespace
+
+    bool FieldRangeSet::tryCompiledInit( bool optimize ) {
+        if ( !optimize ) {
+            // programs bake the optimize step's type brackets in
+            return false;
+        }
+        const BSONObj &query = _queries[ 0 ];
+        if ( query.isEmpty() )
+            return false;
+        StringBuilder shape( 64 );
+        vector<BSONElement> literals;
+        if ( !rangeShapeOf( query, shape, literals ) )
+            return false;
+        string key = shape.str();
+        shared_ptr<CompiledRangeProgram> prog;
+        {
+            SimpleMutex::scoped_lock lk( rangeProgramMutex );
+            RangeProgramMap::const_iterator it = rangePrograms.find( key );
+            if ( it != rangePrograms.end() )
+                prog = it->second;
+        }
+        if ( !prog ) {
+            prog = compileRangeProgram( query );
+            SimpleMutex::scoped_lock lk( rangeProgramMutex );
+            if ( rangePrograms.size() >= MaxRangePrograms )
+                rangePrograms.clear();
+            rangePrograms[ key ] = prog;
+        }
+        if ( prog->multiOp && !_singleKey ) {
+            // several operators on one field would need the multikey
+            // intersection rules - leave that to the parser
+            return false;
+        }
+        for( vector<CompiledRangeField>::const_iterator f = prog->fields.begin(); f != prog->fields.end(); ++f ) {
+            FieldRange &r = range( f->fieldName.c_str() );
+            FieldInterval result = compiledInterval( f->ops[ 0 ], literals[ f->ops[ 0 ].slot ] );
+            bool empty = false;
+            for( unsigned k = 1; k < f->ops.size(); k++ ) {
+                FieldInterval next = compiledInterval( f->ops[ k ], literals[ f->ops[ k ].slot ] );
+                FieldInterval overlap;
+                if ( !fieldIntervalOverlap( result, next, overlap ) ) {
+                    empty = true;
+                    break;
+                }
+                result = overlap;
+            }
+            r._intervals.clear();
+            if ( !empty )
+                r._intervals.push_back( result );
+            // literal bounds point into _queries[0]; bracket bounds must keep
+            // their (shared) program buffers alive with this range
+            for( vector<CompiledRangeOp>::const_iterator o = f->ops.begin(); o != f->ops.end(); ++o ) {
+                if ( !o->bracket.isEmpty() )
+                    r._objData.push_back( o->bracket );
+            }
+        }
+        return true;
+    }
+
     FieldRangeSet::FieldRangeSet( const char *ns, const BSONObj &query, bool singleKey, bool optimize )
         : _ns( ns ), _queries( 1, query.getOwned() ), _singleKey( singleKey ) {
+        if ( tryCompiledInit( optimize ) )
+            return;
         BSONObjIterator i( _queries[ 0 ] );
 
         while( i.more() ) {
@@ -1521,6 +1800,14 @@ namespace mongo {
                 assert( simpleRegex("^\\Qas\\Q[df\\E", "", NULL) == "as\\Q[df" );
                 assert( simpleRegex("^\\Qas\\E\\\\E\\Q$df\\E", "", NULL) == "as\\E$df" ); // quoted string containing \E
             }
+            {
+                // literal alternation groups contribute their common prefix
+                assert( simpleRegex("^INFO:(?:login|logout)", "", NULL) == "INFO:log" );
+                assert( simpleRegex("^(?:abc|abd)$", "", NULL) == "ab" );
+                assert( simpleRegex("^a(?:b|c)?", "", NULL) == "a" ); // quantified group guarantees nothing
+                assert( simpleRegex("^a(?:b.|c)", "", NULL) == "a" ); // metacharacter inside group
+                assert( simpleRegex("^a\\1", "", NULL) == "a" ); // backreference
+            }
 
         }
     } simple_regex_unittest;
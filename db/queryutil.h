@@ -108,6 +108,8 @@ namespace mongo {
 
         string toString() const;
     private:
+        // for the compiled query shape fast path, which fills intervals directly
+        friend class FieldRangeSet;
         BSONObj addObj( const BSONObj &o );
         void finishOperation( const vector<FieldInterval> &newIntervals, const FieldRange &other );
         vector<FieldInterval> _intervals;
@@ -207,6 +209,10 @@ namespace mongo {
         
         BSONObj originalQuery() const { return _queries[ 0 ]; }
     private:
+        /** try to build the ranges by replaying a compiled program cached for
+            this query's shape instead of parsing.  @return false (leaving the
+            set untouched) if the query isn't a shape we compile. */
+        bool tryCompiledInit( bool optimize );
         void appendQueries( const FieldRangeSet &other );
         void makeEmpty();
         void processQueryField( const BSONElement &e, bool optimize );
@@ -1126,6 +1126,9 @@ namespace mongo {
                 log() << "repl: " << errmsg << endl;
                 return false;
             }
+            // sync sources are frequently in another DC; size the tcp windows
+            // for that and bucket the traffic under "repl" in serverStatus
+            _conn->port().setConnectionClass( ConnClass_Repl );
         }
         return true;
     }
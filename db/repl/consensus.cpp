@@ -110,36 +110,47 @@ namespace mongo {
         }
     } cmdReplSetElect;
 
+    /* the vote counts below read the published heartbeat snapshot rather than
+       walking the member list, so each check sees one consistent view and
+       takes no locks. */
+
     int Consensus::totalVotes() const {
         static int complain = 0;
-        int vTot = rs._self->config().votes;
-        for( Member *m = rs.head(); m; m=m->next() )
-            vTot += m->config().votes;
+        shared_ptr<const ReplSetImpl::HBSnapshot> snap = rs.hbSnapshot();
+        int vTot = snap->selfVotes;
+        for( vector<ReplSetImpl::HBSnapshot::Entry>::const_iterator i = snap->members.begin(); i != snap->members.end(); i++ )
+            vTot += i->votes;
         if( vTot % 2 == 0 && vTot && complain++ == 0 )
             log() << "replSet " /*buildbot! warning */ "total number of votes is even - add arbiter or give one member an extra vote" << rsLog;
         return vTot;
     }
 
     bool Consensus::aMajoritySeemsToBeUp() const {
-        int vUp = rs._self->config().votes;
-        for( Member *m = rs.head(); m; m=m->next() )
-            vUp += m->hbinfo().up() ? m->config().votes : 0;
-        return vUp * 2 > totalVotes();
+        shared_ptr<const ReplSetImpl::HBSnapshot> snap = rs.hbSnapshot();
+        int vUp = snap->selfVotes;
+        int vTot = snap->selfVotes;
+        for( vector<ReplSetImpl::HBSnapshot::Entry>::const_iterator i = snap->members.begin(); i != snap->members.end(); i++ ) {
+            vTot += i->votes;
+            vUp += i->hb.up() ? i->votes : 0;
+        }
+        return vUp * 2 > vTot;
     }
 
     bool Consensus::shouldRelinquish() const {
-        int vUp = rs._self->config().votes;
+        shared_ptr<const ReplSetImpl::HBSnapshot> snap = rs.hbSnapshot();
+        int vUp = snap->selfVotes;
+        int vTot = snap->selfVotes;
         const long long T = rs.config().ho.heartbeatTimeoutMillis * rs.config().ho.heartbeatConnRetries;
-        for( Member *m = rs.head(); m; m=m->next() ) {
-            long long dt = m->hbinfo().timeDown();
-            if( dt < T )
-                vUp += m->config().votes;
+        for( vector<ReplSetImpl::HBSnapshot::Entry>::const_iterator i = snap->members.begin(); i != snap->members.end(); i++ ) {
+            vTot += i->votes;
+            if( i->hb.timeDown() < T )
+                vUp += i->votes;
         }
 
         // the manager will handle calling stepdown if another node should be
         // primary due to priority
 
-        return !( vUp * 2 > totalVotes() );
+        return !( vUp * 2 > vTot );
     }
 
     static const int VETO = -10000;
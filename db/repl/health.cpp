@@ -390,38 +390,40 @@ namespace mongo {
             v.push_back(bb.obj());
         }
 
-        Member *m =_members.head();
-        while( m ) {
+        // walk the published heartbeat snapshot rather than _members - no
+        // locking needed and the view of each member is internally consistent
+        shared_ptr<const HBSnapshot> snap = hbSnapshot();
+        for( vector<HBSnapshot::Entry>::const_iterator i = snap->members.begin(); i != snap->members.end(); i++ ) {
+            const HBSnapshot::Entry& e = *i;
             BSONObjBuilder bb;
-            bb.append("_id", (int) m->id());
-            bb.append("name", m->fullName());
-            double h = m->hbinfo().health;
+            bb.append("_id", (int) e.id);
+            bb.append("name", e.name);
+            double h = e.hb.health;
             bb.append("health", h);
-            bb.append("state", (int) m->state().s);
+            bb.append("state", (int) e.hb.hbstate.s);
             if( h == 0 ) {
                 // if we can't connect the state info is from the past and could be confusing to show
                 bb.append("stateStr", "(not reachable/healthy)");
             }
             else {
-                bb.append("stateStr", m->state().toString());
+                bb.append("stateStr", e.hb.hbstate.toString());
             }
-            bb.append("uptime", (unsigned) (m->hbinfo().upSince ? (time(0)-m->hbinfo().upSince) : 0));
-            if (!m->config().arbiterOnly) {
-                bb.appendTimestamp("optime", m->hbinfo().opTime.asDate());
-                bb.appendDate("optimeDate", m->hbinfo().opTime.getSecs() * 1000LL);
+            bb.append("uptime", (unsigned) (e.hb.upSince ? (time(0)-e.hb.upSince) : 0));
+            if (!e.arbiterOnly) {
+                bb.appendTimestamp("optime", e.hb.opTime.asDate());
+                bb.appendDate("optimeDate", e.hb.opTime.getSecs() * 1000LL);
             }
-            bb.appendTimeT("lastHeartbeat", m->hbinfo().lastHeartbeat);
-            bb.append("pingMs", m->hbinfo().ping);
-            string s = m->lhb();
+            bb.appendTimeT("lastHeartbeat", e.hb.lastHeartbeat);
+            bb.append("pingMs", e.hb.ping);
+            string s = e.hb.lastHeartbeatMsg.get();
             if( !s.empty() )
                 bb.append("errmsg", s);
 
-            if (m->hbinfo().authIssue) {
+            if (e.hb.authIssue) {
                 bb.append("authenticated", false);
             }
 
             v.push_back(bb.obj());
-            m = m->next();
         }
         sort(v.begin(), v.end());
         b.append("set", name());
@@ -22,6 +22,7 @@
 #include "../commands.h"
 #include "../../util/concurrency/value.h"
 #include "../../util/concurrency/task.h"
+#include "../../util/concurrency/thread_pool.h"
 #include "../../util/concurrency/msg.h"
 #include "../../util/mongoutils/html.h"
 #include "../../util/goodies.h"
@@ -165,20 +166,36 @@ namespace mongo {
      * Once B is restarted with the correct keyFile, everything should work as
      * expected.
      */
-    class ReplSetHealthPollTask : public task::Task {
+    class ReplSetHealthPollTask {
     private:
         HostAndPort h;
         HeartbeatInfo m;
         int tries;
         const int threshold;
+        volatile bool _halted; // stop polling; the scheduler deletes us once idle
+        volatile bool _busy;   // a pool worker is polling us right now
     public:
         ReplSetHealthPollTask(const HostAndPort& hh, const HeartbeatInfo& mm)
-            : h(hh), m(mm), tries(0), threshold(15) { }
+            : h(hh), m(mm), tries(0), threshold(15), _halted(false), _busy(false) { }
 
-        string name() const { return "rsHealthPoll"; }
-        void doWork() {
-            if ( !theReplSet ) {
+        void halt() { _halted = true; }
+        bool halted() const { return _halted; }
+        bool busy() const { return _busy; }
+
+        /* called from the scheduler thread only, so setting _busy doesn't race
+           with another scheduling attempt */
+        bool tryAcquire() {
+            if ( _halted || _busy )
+                return false;
+            _busy = true;
+            return true;
+        }
+
+        /* one heartbeat round for this member; runs on a shared pool worker */
+        void poll() {
+            if ( _halted || !theReplSet ) {
                 LOG(2) << "replSet not initialized yet, skipping health poll this round" << rsLog;
+                _busy = false;
                 return;
             }
 
@@ -228,6 +245,8 @@ namespace mongo {
                 last = now;
                 theReplSet->mgr->send( boost::bind(&Manager::msgCheckNewState, theReplSet->mgr) );
             }
+
+            _busy = false;
         }
 
     private:
@@ -342,19 +361,75 @@ namespace mongo {
         }
     };
 
+    /* number of pool workers shared by all member heartbeats.  this used to be a
+       dedicated thread (and repeat task) per member, so a 30 node set burned 29
+       threads per node on liveness alone; now it is one scheduler thread plus
+       this many workers regardless of set size.  a down member occupies a worker
+       only until its connect/socket timeout fires. */
+    static const int replHealthPollWorkers = 4;
+
+    /* dispatches every member's heartbeat onto the shared worker pool each round,
+       skipping members whose previous round is still in flight (a member slower
+       than the period is simply polled at the rate it can sustain, as before).
+       also the reaper for halted poll tasks, deleting them once idle. */
+    class HealthPollScheduler : public task::Task {
+    public:
+        HealthPollScheduler() : _m("healthPollScheduler"), _pool(replHealthPollWorkers) {}
+        string name() const { return "rsHealthPoll"; }
+
+        void add(ReplSetHealthPollTask* t) {
+            scoped_lock lk(_m);
+            _tasks.push_back(t);
+        }
+
+        void doWork() {
+            list<ReplSetHealthPollTask*> todo;
+            {
+                scoped_lock lk(_m);
+                for( list<ReplSetHealthPollTask*>::iterator i = _tasks.begin(); i != _tasks.end(); ) {
+                    if( (*i)->halted() ) {
+                        if( (*i)->busy() ) {
+                            i++; // a worker still has it; reap next round
+                            continue;
+                        }
+                        delete *i;
+                        i = _tasks.erase(i);
+                        continue;
+                    }
+                    if( (*i)->tryAcquire() )
+                        todo.push_back(*i);
+                    i++;
+                }
+            }
+            for( list<ReplSetHealthPollTask*>::iterator i = todo.begin(); i != todo.end(); i++ )
+                _pool.schedule( &ReplSetHealthPollTask::poll, *i );
+        }
+
+    private:
+        mongo::mutex _m; // protects _tasks
+        list<ReplSetHealthPollTask*> _tasks;
+        ThreadPool _pool;
+    };
+
+    static HealthPollScheduler *healthScheduler = 0;
+
     void ReplSetImpl::endOldHealthTasks() {
         unsigned sz = healthTasks.size();
         for( set<ReplSetHealthPollTask*>::iterator i = healthTasks.begin(); i != healthTasks.end(); i++ )
-            (*i)->halt();
+            (*i)->halt(); // the scheduler deletes halted tasks once idle
         healthTasks.clear();
         if( sz )
             DEV log() << "replSet debug: cleared old tasks " << sz << endl;
     }
 
     void ReplSetImpl::startHealthTaskFor(Member *m) {
+        if( healthScheduler == 0 ) {
+            healthScheduler = new HealthPollScheduler();
+            task::repeat(healthScheduler, 2000);
+        }
         ReplSetHealthPollTask *task = new ReplSetHealthPollTask(m->h(), m->hbinfo());
         healthTasks.insert(task);
-        task::repeat(task, 2000);
+        healthScheduler->add(task);
     }
 
     void startSyncThread();
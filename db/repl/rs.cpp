@@ -194,11 +194,28 @@ namespace mongo {
         for( Member *m = _members.head(); m; m=m->next() ) {
             if( m->id() == h.id() ) {
                 m->_hbinfo = h;
+                publishHBSnapshot();
                 return;
             }
         }
     }
 
+    void ReplSetImpl::publishHBSnapshot() {
+        shared_ptr<HBSnapshot> s( new HBSnapshot() );
+        s->selfVotes = _self ? _self->config().votes : 1;
+        for( Member *m = _members.head(); m; m=m->next() ) {
+            HBSnapshot::Entry e;
+            e.id = m->id();
+            e.name = m->fullName();
+            e.votes = m->config().votes;
+            e.arbiterOnly = m->config().arbiterOnly;
+            e.hb = m->hbinfo();
+            s->members.push_back(e);
+        }
+        scoped_lock lk(_hbSnapshotMutex);
+        _hbSnapshot = s;
+    }
+
     list<HostAndPort> ReplSetImpl::memberHostnames() const {
         list<HostAndPort> L;
         L.push_back(_self->h());
@@ -327,7 +344,10 @@ namespace mongo {
         }
     }
 
-    ReplSetImpl::ReplSetImpl(ReplSetCmdline& replSetCmdline) : elect(this),
+    ReplSetImpl::ReplSetImpl(ReplSetCmdline& replSetCmdline) :
+        _hbSnapshotMutex("hbSnapshot"),
+        _hbSnapshot( new HBSnapshot() ),
+        elect(this),
         _currentSyncTarget(0),
         _blockSync(false),
         _hbmsgTime(0),
@@ -424,8 +444,8 @@ namespace mongo {
 
         list<ReplSetConfig::MemberCfg*> newOnes;
         // additive short-cuts the new config setup. If we are just adding a
-        // node/nodes and nothing else is changing, this is additive. If it's
-        // not a reconfig, we're not adding anything
+        // node/nodes and/or changing tags and nothing else is changing, this is
+        // additive. If it's not a reconfig, we're not adding anything
         bool additive = reconf;
         {
             unsigned nfound = 0;
@@ -448,7 +468,11 @@ namespace mongo {
                         nfound++;
                         assert( (int) old->id() == m._id );
                         if( old->config() != m ) {
-                            additive = false;
+                            /* a tag-only change is applied in place by the additive
+                               path below; tearing all the members down for it would
+                               needlessly drop our sync source and restart sync. */
+                            if( !old->config().sameIgnoringTags(m) )
+                                additive = false;
                         }
                     }
                     else {
@@ -498,9 +522,22 @@ namespace mongo {
             }
 
             // if we aren't creating new members, we may have to update the
-            // groups for the current ones
+            // groups and tags for the current ones
             _cfg->updateMembers(_members);
 
+            // ourself is not on the _members list
+            if( _self ) {
+                for( vector<ReplSetConfig::MemberCfg>::iterator i = _cfg->members.begin(); i != _cfg->members.end(); i++ ) {
+                    if( (*i)._id == (int) _self->id() ) {
+                        _self->configw().groupsw() = (*i).groups();
+                        _self->configw().tags = (*i).tags;
+                        _config = _self->config();
+                        break;
+                    }
+                }
+            }
+
+            publishHBSnapshot();
             return true;
         }
 
@@ -551,6 +588,7 @@ namespace mongo {
             log() << "replSet warning did not detect own host in full reconfig, members " << members << " config: " << c << rsLog;
         }
 
+        publishHBSnapshot();
         return true;
     }
 
@@ -323,11 +323,37 @@ namespace mongo {
         /* todo thread */
         void msgUpdateHBInfo(HeartbeatInfo);
 
+        /** snapshot of the other members' heartbeat state, published whole
+            (StateBox style) by the manager thread on every heartbeat update and
+            config change.  readers - replSetGetStatus, the Consensus vote
+            counts - take the shared_ptr and walk it without the rs lock. */
+        struct HBSnapshot {
+            struct Entry {
+                unsigned id;
+                string name;
+                int votes;
+                bool arbiterOnly;
+                HeartbeatInfo hb;
+            };
+            vector<Entry> members; // everyone but _self
+            int selfVotes;
+        };
+        shared_ptr<const HBSnapshot> hbSnapshot() const {
+            scoped_lock lk(_hbSnapshotMutex);
+            return _hbSnapshot;
+        }
+
         StateBox box;
 
         OpTime lastOpTimeWritten;
         long long lastH; // hash we use to make sure we are reading the right flow of ops and aren't on an out-of-date "fork"
     private:
+        /* rebuild _hbSnapshot from _members and swap it in.  call after any
+           change to the membership or a member's hbinfo. */
+        void publishHBSnapshot();
+        mutable mongo::mutex _hbSnapshotMutex;
+        shared_ptr<const HBSnapshot> _hbSnapshot;
+
         set<ReplSetHealthPollTask*> healthTasks;
         void endOldHealthTasks();
         void startHealthTaskFor(Member *m);
@@ -496,7 +522,7 @@ namespace mongo {
         void _syncThread();
         bool tryToGoLiveAsASecondary(OpTime&); // readlocks
         void syncTail();
-        bool syncApply(const BSONObj &o);
+        bool syncApply(const BSONObj &o, bool firstApply = false);
         unsigned _syncRollback(OplogReader& r);
         void syncRollback(OplogReader& r);
         void syncFixUp(HowToFixUp& h, OplogReader& r);
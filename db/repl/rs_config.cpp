@@ -98,6 +98,7 @@ namespace mongo {
             for( Member *d = dest.head(); d; d = d->next() ) {
                 if (d->fullName() == (*source).h.toString()) {
                     d->configw().groupsw() = (*source).groups();
+                    d->configw().tags = (*source).tags;
                 }
             }
         }
@@ -102,6 +102,16 @@ namespace mongo {
                        buildIndexes == buildIndexes;
             }
             bool operator!=(const MemberCfg& r) const { return !(*this == r); }
+
+            /** @return true if the configs differ only in ways that don't affect the
+                member state machines (currently: tags).  such a change can be applied
+                in place on reconfig without rebuilding the member list -- important as
+                rebuilding drops our sync source and restarts the sync thread. */
+            bool sameIgnoringTags(const MemberCfg& r) const {
+                return _id == r._id && votes == r.votes && h == r.h && priority == r.priority &&
+                       arbiterOnly == r.arbiterOnly && slaveDelay == r.slaveDelay && hidden == r.hidden &&
+                       buildIndexes == r.buildIndexes;
+            }
         };
 
         vector<MemberCfg> members;
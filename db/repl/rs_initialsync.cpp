@@ -96,36 +96,40 @@ namespace mongo {
             buildIndexes = myConfig().buildIndexes;
         }
 
-        // find the member with the lowest ping time that has more data than me
+        /* find the member with the lowest ping time that has more data than me.
+           the whole membership is scanned, so a nearby up-to-date secondary wins
+           over a distant primary and the set syncs in a chain; the ghost sync
+           percolation (see GhostSync) keeps the primary's w accounting right
+           when that happens. */
         for (Member *m = _members.head(); m; m = m->next()) {
-            if (m->hbinfo().up() &&
-                // make sure members with buildIndexes sync from other members w/indexes
-                (!buildIndexes || (buildIndexes && m->config().buildIndexes)) &&
-                (m->state() == MemberState::RS_PRIMARY ||
-                 (m->state() == MemberState::RS_SECONDARY && m->hbinfo().opTime > lastOpTimeWritten)) &&
-                (!closest || m->hbinfo().ping < closest->hbinfo().ping)) {
-
-                map<string,time_t>::iterator vetoed = _veto.find(m->fullName());
-                if (vetoed == _veto.end()) {
-                    closest = m;
-                    break;
-                }
-
+            if (!m->hbinfo().up())
+                continue;
+            // make sure members with buildIndexes sync from other members w/indexes
+            if (buildIndexes && !m->config().buildIndexes)
+                continue;
+            if (m->state() != MemberState::RS_PRIMARY &&
+                !(m->state() == MemberState::RS_SECONDARY && m->hbinfo().opTime > lastOpTimeWritten))
+                continue;
+            if (closest && !(m->hbinfo().ping < closest->hbinfo().ping))
+                continue;
+
+            map<string,time_t>::iterator vetoed = _veto.find(m->fullName());
+            if (vetoed != _veto.end()) {
                 if (now == 0) {
                     now = time(0);
                 }
 
-                // if this was on the veto list, check if it was vetoed in the last "while"
-                if ((*vetoed).second < now) {
-                    _veto.erase(vetoed);
-                    closest = m;
-                    break;
+                // if it was recently vetoed, skip
+                if ((*vetoed).second >= now) {
+                    log() << "replSet not trying to sync from " << (*vetoed).first
+                          << ", it is vetoed for " << ((*vetoed).second - now) << " more seconds" << rsLog;
+                    continue;
                 }
 
-                // if it was recently vetoed, skip
-                log() << "replSet not trying to sync from " << (*vetoed).first
-                      << ", it is vetoed for " << ((*vetoed).second - now) << " more seconds" << rsLog;
+                _veto.erase(vetoed);
             }
+
+            closest = m;
         }
 
         {
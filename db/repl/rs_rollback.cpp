@@ -88,6 +88,9 @@ namespace mongo {
            need to refetch it once. */
         set<DocID> toRefetch;
 
+        /* decompressed --oplogCompress entries; DocIDs in toRefetch may point into these */
+        list<bo> refetchOwned;
+
         /* collections to drop */
         set<string> toDrop;
 
@@ -99,7 +102,14 @@ namespace mongo {
         int rbid; // remote server's current rollback sequence #
     };
 
-    static void refetch(HowToFixUp& h, const BSONObj& ourObj) {
+    static void refetch(HowToFixUp& h, const BSONObj& ourObjRaw) {
+        bo ourObj = ourObjRaw;
+        if( ourObjRaw["o"].type() == BinData ) {
+            /* --oplogCompress entry.  the decompressed copy must outlive us, as the
+               DocIDs below keep pointers into it - park it in h. */
+            h.refetchOwned.push_back( decompressOplogEntry(ourObjRaw) );
+            ourObj = h.refetchOwned.back();
+        }
         const char *op = ourObj.getStringField("op");
         if( *op == 'n' )
             return;
@@ -35,7 +35,7 @@ namespace mongo {
     /* apply the log op that is in param o 
        @return bool failedUpdate
     */
-    bool ReplSetImpl::syncApply(const BSONObj &o) {
+    bool ReplSetImpl::syncApply(const BSONObj &o, bool firstApply) {
         const char *ns = o.getStringField("ns");
         if ( *ns == '.' || *ns == 0 ) {
             blank(o);
@@ -44,7 +44,67 @@ namespace mongo {
 
         Client::Context ctx(ns);
         ctx.getClient()->curop()->reset();
-        return applyOperation_inlock(o);
+        return applyOperation_inlock(o, true, firstApply);
+    }
+
+    /* true if no two insert ops in the batch target the same (ns,_id).  when
+       that holds each insert can be applied directly instead of as an upsert,
+       skipping the _id pre-image lookup - see applyOperation_inlock.  cheap:
+       one map pass over a batch of at most 128 ops, done outside the db lock. */
+    static bool noDuplicateInsertIds( const vector<BSONObj>& batch ) {
+        BSONObjSet seen;
+        for( vector<BSONObj>::const_iterator i = batch.begin(); i != batch.end(); ++i ) {
+            const BSONObj& op = *i;
+            if( *op.getStringField("op") != 'i' )
+                continue;
+            BSONElement id = op.getObjectField("o")["_id"];
+            if( id.eoo() )
+                continue; // takes the slow no-_id path regardless
+            BSONObjBuilder b;
+            b.append( op["ns"] );
+            b.appendAs( id , "id" );
+            if( ! seen.insert( b.obj() ).second )
+                return false;
+        }
+        return true;
+    }
+
+    /* number of worker threads used to page in the documents and index paths a
+       batch of oplog entries will touch, before the batch is applied */
+    static const int replPrefetchThreads = 4;
+
+    /* fault in, in parallel, the pages a batch of ops will touch when applied.
+       the pool join is the barrier: we do not take the write lock to apply until
+       every worker is done, so the applies themselves fault in almost nothing
+       and the time the write lock is held stays short.  read-only and advisory,
+       so the ops can be partitioned arbitrarily across the workers. */
+    static void prefetchOps( vector<BSONObj>& batch ) {
+        static ThreadPool* tp = 0;
+        if( tp == 0 )
+            tp = new ThreadPool( replPrefetchThreads );
+        unsigned m = ( batch.size() + replPrefetchThreads - 1 ) / replPrefetchThreads;
+        unsigned a = 0;
+        while( a < batch.size() ) {
+            unsigned b = a + m - 1; // batch[a..b]
+            if( b >= batch.size() )
+                b = batch.size() - 1;
+            tp->schedule(pretouchN, batch, a, b);
+            a += m;
+        }
+        tp->join();
+    }
+
+    /* batch-boundary read gate.  the write lock is greedy: if we request the next
+       batch's lock the instant we drop the previous one, a secondary serving
+       analytics reads sees thousands of tiny read/write handoffs a second and
+       every new reader queues behind us.  instead, while readers are in the lock,
+       hold off requesting it - bounded to a couple of milliseconds per batch so a
+       streaming read load cannot make replication fall behind. */
+    static void readGate() {
+        const unsigned long long maxGateMicros = 2000;
+        unsigned long long start = curTimeMicros64();
+        while( dbMutex.readerCount() && curTimeMicros64() - start < maxGateMicros )
+            sleepmicros( 200 );
     }
 
     /* initial oplog application, during initial sync, after cloning.
@@ -121,8 +181,22 @@ namespace mongo {
         time_t start = time(0);
         unsigned long long n = 0;
         int fails = 0;
+        int prefetched = 0; // ops in the current batch already paged in below
         while( ts < minValid ) {
             try {
+                if( prefetched == 0 && r.moreInCurrentBatch() ) {
+                    // peek ahead in the fetched batch and fault in the pages the
+                    // coming ops will touch, releasing the write lock while the
+                    // prefetch pool runs so the faults overlap
+                    vector<BSONObj> v;
+                    r.peek(v, 128);
+                    if( v.size() > 1 ) {
+                        dbtemprelease t;
+                        prefetchOps(v);
+                        prefetched = v.size();
+                    }
+                }
+
                 // There are some special cases with initial sync (see the catch block), so we
                 // don't want to break out of this while until we've reached minvalid. Thus, we'll
                 // keep trying to requery.
@@ -143,6 +217,8 @@ namespace mongo {
                 }
 
                 BSONObj o = r.nextSafe(); /* note we might get "not master" at some point */
+                if( prefetched > 0 )
+                    prefetched--;
                 ts = o["ts"]._opTime();
 
                 {
@@ -385,112 +461,132 @@ namespace mongo {
             tryToGoLiveAsASecondary(minvalid);
         }
 
+        /* ops are gathered into batches outside the db lock, their pages are
+           faulted in by the prefetch pool, and then the whole batch is applied
+           under a single write lock acquisition.  lastOpTimeWritten advances as
+           each op is logged, but the lock is only released at batch boundaries,
+           and the read gate above keeps us from immediately re-gating readers
+           that were admitted when we released. */
+        vector<BSONObj> batch;
         while( 1 ) {
-            {
-                Timer timeInWriteLock;
-                writelock lk("");
-                while( 1 ) {
-                    if( !r.moreInCurrentBatch() ) {
-                        dbtemprelease tempRelease;
-                        {
-                            // we need to occasionally check some things. between
-                            // batches is probably a good time.                            
-                            if( state().recovering() ) { // perhaps we should check this earlier? but not before the rollback checks.
-                                /* can we go to RS_SECONDARY state?  we can if not too old and if minvalid achieved */
-                                OpTime minvalid;
-                                bool golive = ReplSetImpl::tryToGoLiveAsASecondary(minvalid);
-                                if( golive ) {
-                                    ;
-                                }
-                                else {
-                                    sethbmsg(str::stream() << "still syncing, not yet to minValid optime" << minvalid.toString());
-                                }
-                                // todo: too stale capability
-                            }
-                            if( !target->hbinfo().hbstate.readable() ) {
-                                return;
-                            }
-                        }
-                        r.more(); // to make the requestmore outside the db lock, which obviously is quite important
+            batch.clear();
+
+            // with slaveDelay we keep the old op-at-a-time pacing
+            const unsigned maxBatch = myConfig().slaveDelay ? 1 : 128;
+
+            if( !r.moreInCurrentBatch() ) {
+                // we need to occasionally check some things. between
+                // batches is probably a good time.
+                if( state().recovering() ) { // perhaps we should check this earlier? but not before the rollback checks.
+                    /* can we go to RS_SECONDARY state?  we can if not too old and if minvalid achieved */
+                    OpTime minvalid;
+                    bool golive = ReplSetImpl::tryToGoLiveAsASecondary(minvalid);
+                    if( golive ) {
+                        ;
                     }
-                    if( timeInWriteLock.micros() > 1000 ) {
-                        dbtemprelease tempRelease;
-                        timeInWriteLock.reset();
+                    else {
+                        sethbmsg(str::stream() << "still syncing, not yet to minValid optime" << minvalid.toString());
                     }
-                    if( !r.more() )
-                        break;
-                    {
-                        BSONObj o = r.nextSafe(); // note we might get "not master" at some point
-
-                        int sd = myConfig().slaveDelay;
-                        // ignore slaveDelay if the box is still initializing. once
-                        // it becomes secondary we can worry about it.
-                        if( sd && box.getState().secondary() ) {
-                            const OpTime ts = o["ts"]._opTime();
-                            long long a = ts.getSecs();
-                            long long b = time(0);
-                            long long lag = b - a;
-                            long long sleeptime = sd - lag;
-                            if( sleeptime > 0 ) {
-                                dbtemprelease tempRelease;
-                                uassert(12000, "rs slaveDelay differential too big check clocks and systems", sleeptime < 0x40000000);
-                                if( sleeptime < 60 ) {
-                                    sleepsecs((int) sleeptime);
-                                }
-                                else {
-                                    log() << "replSet slavedelay sleep long time: " << sleeptime << rsLog;
-                                    // sleep(hours) would prevent reconfigs from taking effect & such!
-                                    long long waitUntil = b + sleeptime;
-                                    while( 1 ) {
-                                        sleepsecs(6);
-                                        if( time(0) >= waitUntil )
-                                            break;
-
-                                        if( !target->hbinfo().hbstate.readable() ) {
-                                            break;
-                                        }
-                                    
-                                        if( myConfig().slaveDelay != sd ) // reconf
-                                            break;
-                                    }
-                                }
-                            }
-                        } // endif slaveDelay
-
-                        dbMutex.assertWriteLocked();
-                        try {
-                            /* if we have become primary, we dont' want to apply things from elsewhere
-                               anymore. assumePrimary is in the db lock so we are safe as long as
-                               we check after we locked above. */
-                            if( box.getState().primary() ) {
-                                log(0) << "replSet stopping syncTail we are now primary" << rsLog;
-                                return;
+                    // todo: too stale capability
+                }
+                if( !target->hbinfo().hbstate.readable() ) {
+                    return;
+                }
+                r.more(); // request more with no db lock held, which obviously is quite important
+            }
+
+            while( r.moreInCurrentBatch() && batch.size() < maxBatch ) {
+                batch.push_back( r.nextSafe().getOwned() ); // note we might get "not master" at some point
+            }
+
+            if( batch.empty() ) {
+                r.tailCheck();
+                if( !r.haveCursor() ) {
+                    LOG(1) << "replSet end syncTail pass with " << hn << rsLog;
+                    // TODO : reuse our connection to the primary.
+                    return;
+                }
+
+                if( !target->hbinfo().hbstate.readable() ) {
+                    return;
+                }
+                // looping back is ok because this is a tailable cursor
+                continue;
+            }
+
+            int sd = myConfig().slaveDelay;
+            // ignore slaveDelay if the box is still initializing. once
+            // it becomes secondary we can worry about it.
+            if( sd && box.getState().secondary() ) {
+                // delay against the newest op in the batch; the earlier ops just
+                // get held back a little longer than strictly required
+                const OpTime ts = batch.back()["ts"]._opTime();
+                long long a = ts.getSecs();
+                long long b = time(0);
+                long long lag = b - a;
+                long long sleeptime = sd - lag;
+                if( sleeptime > 0 ) {
+                    uassert(12000, "rs slaveDelay differential too big check clocks and systems", sleeptime < 0x40000000);
+                    if( sleeptime < 60 ) {
+                        sleepsecs((int) sleeptime);
+                    }
+                    else {
+                        log() << "replSet slavedelay sleep long time: " << sleeptime << rsLog;
+                        // sleep(hours) would prevent reconfigs from taking effect & such!
+                        long long waitUntil = b + sleeptime;
+                        while( 1 ) {
+                            sleepsecs(6);
+                            if( time(0) >= waitUntil )
+                                break;
+
+                            if( !target->hbinfo().hbstate.readable() ) {
+                                break;
                             }
 
-                            syncApply(o);
-                            _logOpObjRS(o);   // with repl sets we write the ops to our oplog too 
-                        }
-                        catch (DBException& e) {
-                            sethbmsg(str::stream() << "syncTail: " << e.toString() << ", syncing: " << o);
-                            veto(target->fullName(), 300);
-                            sleepsecs(30);
-                            return;
+                            if( myConfig().slaveDelay != sd ) // reconf
+                                break;
                         }
                     }
-                } // end while
-            } // end writelock scope
+                }
+            } // endif slaveDelay
 
-            r.tailCheck();
-            if( !r.haveCursor() ) {
-                LOG(1) << "replSet end syncTail pass with " << hn << rsLog;
-                // TODO : reuse our connection to the primary.
-                return;
+            if( batch.size() > 1 ) {
+                prefetchOps( batch );
             }
-            
-            if( !target->hbinfo().hbstate.readable() ) {
-                return;
-            }
-            // looping back is ok because this is a tailable cursor
+
+            const bool firstApply = noDuplicateInsertIds( batch );
+
+            readGate();
+
+            {
+                writelock lk("");
+                dbMutex.assertWriteLocked();
+
+                /* if we have become primary, we dont' want to apply things from elsewhere
+                   anymore. assumePrimary is in the db lock so we are safe as long as
+                   we check after we locked above. */
+                if( box.getState().primary() ) {
+                    log(0) << "replSet stopping syncTail we are now primary" << rsLog;
+                    return;
+                }
+
+                for( vector<BSONObj>::const_iterator i = batch.begin(); i != batch.end(); ++i ) {
+                    try {
+                        syncApply(*i, firstApply);
+                        _logOpObjRS(*i);   // with repl sets we write the ops to our oplog too
+                    }
+                    catch (DBException& e) {
+                        sethbmsg(str::stream() << "syncTail: " << e.toString() << ", syncing: " << *i);
+                        veto(target->fullName(), 300);
+                        sleepsecs(30);
+                        return;
+                    }
+                }
+            } // end writelock scope
+
+            // tell the sync source where we are now so that w: waits there see
+            // our apply progress immediately instead of on our next getMore
+            r.reportApplied( rsoplog , lastOpTimeWritten );
         }
     }
 
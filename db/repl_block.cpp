@@ -20,6 +20,7 @@
 #include "repl.h"
 #include "repl_block.h"
 #include "instance.h"
+#include "commands.h"
 #include "dbhelpers.h"
 #include "../util/background.h"
 #include "../util/mongoutils/str.h"
@@ -57,7 +58,7 @@ namespace mongo {
         };
 
         struct Info {
-            Info() : loc(0) {}
+            Info() : loc(0), selfReporting(false) {}
             ~Info() {
                 if ( loc && owned ) {
                     delete loc;
@@ -65,6 +66,19 @@ namespace mongo {
             }
             bool owned; // true if loc is a pointer of our creation (and not a pointer into a MMF)
             OpTime * loc;
+            bool selfReporting; // slave streams its applied position to us via syncApplied
+        };
+
+        /* a getLastError w waiter parked on the wait queue.  stack allocated in
+           the waiting thread; only touched under _mutex, and the waiting thread
+           does not return (and free it) until it has been removed from the
+           queue or removes itself on timeout. */
+        struct Waiter : boost::noncopyable {
+            Waiter( OpTime o , int n ) : op(o), need(n), satisfied(false) {}
+            const OpTime op;
+            const int need;   // # slaves that must reach op; 0 = wake on every update and recheck (tag rules)
+            bool satisfied;
+            boost::condition cv;
         };
 
         SlaveTracking() : _mutex("SlaveTracking") {
@@ -109,7 +123,7 @@ namespace mongo {
             _slaves.clear();
         }
 
-        void update( const BSONObj& rid , const string& host , const string& ns , OpTime last ) {
+        void update( const BSONObj& rid , const string& host , const string& ns , OpTime last , bool selfReported = false ) {
             REPLDEBUG( host << " " << rid << " " << ns << " " << last );
 
             scoped_lock mylk(_mutex);
@@ -121,6 +135,16 @@ namespace mongo {
             Ident ident(rid,host,ns);
             Info& i = _slaves[ ident ];
 
+            if ( selfReported ) {
+                i.selfReporting = true;
+            }
+            else if ( i.selfReporting ) {
+                /* the slave tells us its applied position after every batch; its
+                   oplog read position is ahead of that and would overstate its
+                   progress, so ignore the read position once it starts reporting. */
+                return;
+            }
+
             if (theReplSet && theReplSet->isPrimary()) {
                 theReplSet->ghost->updateSlave(ident.obj["_id"].OID(), last);
             }
@@ -130,6 +154,7 @@ namespace mongo {
                     i.loc[0] = last;
                 else
                     getDur().setNoJournal(i.loc, &last, sizeof(last));
+                _wakeWaiters_inlock();
                 return;
             }
 
@@ -141,12 +166,14 @@ namespace mongo {
                 i.owned = false;
                 i.loc = (OpTime*)res["syncedTo"].value();
                 getDur().setNoJournal(i.loc, &last, sizeof(last));
+                _wakeWaiters_inlock();
                 return;
             }
 
             i.owned = true;
             i.loc = new OpTime(last);
             _dirty = true;
+            _wakeWaiters_inlock();
 
             if ( ! _started ) {
                 // start background thread here since we definitely need it
@@ -187,17 +214,90 @@ namespace mongo {
             if ( w <= 1 || ! _isMaster() )
                 return true;
 
-            w--; // now this is the # of slaves i need
             scoped_lock mylk(_mutex);
+            return _replicatedToNum_inlock( op, w - 1 );
+        }
+
+        /* @param need # of slaves that must have reached op */
+        bool _replicatedToNum_inlock(const OpTime& op, int need) {
             for ( map<Ident,Info>::iterator i=_slaves.begin(); i!=_slaves.end(); i++) {
                 OpTime s = *(i->second.loc);
                 if ( s < op ) {
                     continue;
                 }
-                if ( --w == 0 )
+                if ( --need == 0 )
                     return true;
             }
-            return w <= 0;
+            return need <= 0;
+        }
+
+        /* one notification pass per progress update: wake only the waiters the
+           new slave positions satisfy.  for numeric w, a waiter is satisfied iff
+           its optime is <= the optime the need'th fastest slave has reached, so
+           satisfaction is monotone in the waiter's optime and the optime-ordered
+           queue can be cut off early.  tag-rule waiters (need 0) are just woken
+           to recheck; they are rare. */
+        void _wakeWaiters_inlock() {
+            if ( _waiters.empty() && _modeWaiters.empty() )
+                return;
+
+            vector<OpTime> fastest; // slave positions, descending
+            for ( map<Ident,Info>::iterator i=_slaves.begin(); i!=_slaves.end(); i++ )
+                fastest.push_back( *(i->second.loc) );
+            sort( fastest.rbegin(), fastest.rend() );
+
+            for ( Waiters::iterator i = _waiters.begin(); i != _waiters.end(); ) {
+                Waiter *w = i->second;
+                if ( fastest.empty() || w->op > fastest[0] )
+                    break; // no waiter past here can be satisfied yet
+                if ( (unsigned)w->need > fastest.size() || fastest[w->need-1] < w->op ) {
+                    i++;
+                    continue;
+                }
+                w->satisfied = true;
+                w->cv.notify_one();
+                _waiters.erase(i++);
+            }
+
+            for ( list<Waiter*>::iterator i = _modeWaiters.begin(); i != _modeWaiters.end(); i++ )
+                (*i)->cv.notify_one();
+        }
+
+        void awaitReplication( OpTime op , BSONElement w , int millis ) {
+            int need = 0;
+            if ( w.isNumber() )
+                need = w.numberInt() - 1;
+            else if ( theReplSet && w.type() == String && w.String() == "majority" )
+                need = theReplSet->config().getMajority() - 1;
+
+            if ( w.isNumber() && need <= 0 )
+                return; // w <= 1; nothing to wait for
+
+            Waiter waiter( op, need > 0 ? need : 0 );
+            scoped_lock mylk(_mutex);
+
+            // recheck under the lock so an update cannot slip in between the
+            // caller's opReplicatedEnough poll and our registration
+            if ( waiter.need && _replicatedToNum_inlock( op, waiter.need ) )
+                return;
+
+            Waiters::iterator pos;
+            list<Waiter*>::iterator modePos;
+            if ( waiter.need )
+                pos = _waiters.insert( make_pair( op, &waiter ) );
+            else
+                modePos = _modeWaiters.insert( _modeWaiters.end(), &waiter );
+
+            waiter.cv.timed_wait( mylk.boost(), boost::posix_time::milliseconds( millis ) );
+
+            // on timeout (or a tag-rule wake) we are still queued; remove ourselves
+            if ( waiter.need ) {
+                if ( !waiter.satisfied )
+                    _waiters.erase( pos );
+            }
+            else {
+                _modeWaiters.erase( modePos );
+            }
         }
 
         unsigned getSlaveCount() const {
@@ -209,6 +309,9 @@ namespace mongo {
         // need to be careful not to deadlock with this
         mutable mongo::mutex _mutex;
         map<Ident,Info> _slaves;
+        typedef multimap<OpTime,Waiter*> Waiters;
+        Waiters _waiters;            // numeric w waiters, ordered by optime
+        list<Waiter*> _modeWaiters;  // tag-rule waiters; woken on every update
         bool _dirty;
         bool _started;
 
@@ -216,7 +319,7 @@ namespace mongo {
 
     const char * SlaveTracking::NS = "local.slaves";
 
-    void updateSlaveLocation( CurOp& curop, const char * ns , OpTime lastOp ) {
+    static void _updateSlaveLocation( CurOp& curop, const char * ns , OpTime lastOp , bool selfReported ) {
         if ( lastOp.isNull() )
             return;
 
@@ -228,7 +331,7 @@ namespace mongo {
         if ( rid.isEmpty() )
             return;
 
-        slaveTracking.update( rid , curop.getRemoteString( false ) , ns , lastOp );
+        slaveTracking.update( rid , curop.getRemoteString( false ) , ns , lastOp , selfReported );
 
         if (theReplSet && !theReplSet->isPrimary()) {
             // we don't know the slave's port, so we make the replica set keep
@@ -238,6 +341,41 @@ namespace mongo {
         }
     }
 
+    void updateSlaveLocation( CurOp& curop, const char * ns , OpTime lastOp ) {
+        _updateSlaveLocation( curop , ns , lastOp , false );
+    }
+
+    void reportSlaveApplied( CurOp& curop, const char * ns , OpTime appliedOp ) {
+        _updateSlaveLocation( curop , ns , appliedOp , true );
+    }
+
+    /** internal - the slave sends this over its oplog reading connection (so
+        getRemoteID() identifies it) each time it finishes applying a batch.
+        getLastError w: waits then track actual apply progress rather than the
+        slave's oplog read position.
+        { syncApplied : <oplog ns> , optime : <applied> } */
+    class CmdSyncApplied : public Command {
+    public:
+        CmdSyncApplied() : Command( "syncApplied" ) {}
+        virtual void help( stringstream& h ) const { h << "internal"; }
+        virtual bool slaveOk() const { return true; } // chained slaves report to secondaries too
+        virtual LockType locktype() const { return READ; } // SlaveTracking::update may read local.slaves
+        virtual bool run(const string& , BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl) {
+            const char * ns = cmdObj.firstElement().valuestrsafe();
+            if ( ! str::startsWith( ns , "local.oplog." ) ) {
+                errmsg = "invalid oplog ns";
+                return false;
+            }
+            BSONElement e = cmdObj["optime"];
+            if ( e.type() != Timestamp && e.type() != Date ) {
+                errmsg = "no optime";
+                return false;
+            }
+            reportSlaveApplied( *cc().curop() , ns , e._opTime() );
+            return true;
+        }
+    } cmdSyncApplied;
+
     bool opReplicatedEnough( OpTime op , BSONElement w ) {
         return slaveTracking.opReplicatedEnough( op , w );
     }
@@ -246,6 +384,10 @@ namespace mongo {
         return slaveTracking.replicatedToNum( op , w );
     }
 
+    void awaitOpReplicated( OpTime op , BSONElement w , int millis ) {
+        slaveTracking.awaitReplication( op , w , millis );
+    }
+
     void resetSlaveCache() {
         slaveTracking.reset();
     }
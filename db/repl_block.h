@@ -30,10 +30,20 @@ namespace mongo {
 
     void updateSlaveLocation( CurOp& curop, const char * oplog_ns , OpTime lastOp );
 
+    /** record a slave's applied (not just read) oplog position, as streamed to
+        us by the syncApplied command.  once a slave self-reports, its oplog
+        read position no longer counts toward getLastError w: waits. */
+    void reportSlaveApplied( CurOp& curop, const char * oplog_ns , OpTime appliedOp );
+
     /** @return true if op has made it to w servers */
     bool opReplicatedEnough( OpTime op , int w );
     bool opReplicatedEnough( OpTime op , BSONElement w );
 
+    /** park the calling thread on the replication wait queue until a slave
+        progress update satisfies (op,w), or millis elapse.  advisory - the
+        caller still confirms with opReplicatedEnough(). */
+    void awaitOpReplicated( OpTime op , BSONElement w , int millis );
+
     void resetSlaveCache();
     unsigned getSlaveCount();
 }
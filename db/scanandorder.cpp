@@ -20,17 +20,24 @@
 
 #include "pch.h"
 #include "scanandorder.h"
+#include "extsort.h"
+#include "index.h"
+#include "../util/memaccount.h"
 
 namespace mongo {
 
     const unsigned ScanAndOrder::MaxScanAndOrderBytes = 32 * 1024 * 1024;
 
+    ScanAndOrder::~ScanAndOrder() {
+        memaccount::noteBytes( memaccount::ScanAndOrder , -(long long)_approxSize );
+    }
+
     void ScanAndOrder::_add(BSONObj& k, BSONObj o, DiskLoc* loc) {
         if (!loc) {
             _best.insert(make_pair(k.getOwned(),o.getOwned()));
         }
         else {
-            BSONObjBuilder b;
+            BSONObjBuilder b( o.objsize() + 64 ); // the document plus a $diskLoc element
             b.appendElements(o);
             b.append("$diskLoc", loc->toBSONObj());
             _best.insert(make_pair(k.getOwned(), b.obj().getOwned()));
@@ -38,16 +45,51 @@ namespace mongo {
     }
 
     void ScanAndOrder::_addIfBetter(BSONObj& k, BSONObj o, BestMap::iterator i, DiskLoc* loc) {
-        /* todo : we don't correct _approxSize here. */
         const BSONObj& worstBestKey = i->first;
         int c = worstBestKey.woCompare(k, _order._spec.keyPattern);
         if ( c > 0 ) {
             // k is better, 'upgrade'
+            memaccount::noteBytes( memaccount::ScanAndOrder ,
+                                   k.objsize() + o.objsize() - i->first.objsize() - i->second.objsize() );
+            _approxSize -= i->first.objsize() + i->second.objsize();
             _best.erase(i);
+            _approxSize += k.objsize() + o.objsize();
             _add(k, o, loc);
         }
     }
 
+    /* the external sorter stores pair<BSONObj,DiskLoc>.  we sort key+document pairs, so
+       we wrap each entry as a single bson object : the key's elements first (those drive
+       the comparison) followed by the full document as a trailing object-valued element.
+       the trailing element participates in comparisons only to break ties among equal
+       keys, which is harmless as the order of ties is unspecified anyway.
+    */
+    void ScanAndOrder::_sorterAdd(const BSONObj& k, const BSONObj& o, DiskLoc* loc) {
+        BSONObjBuilder b( k.objsize() + o.objsize() + 64 );
+        b.appendElements(k);
+        if ( loc ) {
+            BSONObjBuilder d( b.subobjStart( "" ) );
+            d.appendElements(o);
+            d.append("$diskLoc", loc->toBSONObj());
+            d.done();
+        }
+        else {
+            b.append("", o);
+        }
+        _sorter->add(b.obj(), DiskLoc());
+    }
+
+    void ScanAndOrder::_spill() {
+        log() << "too much data for in memory sort() with no index, using external sort" << endl;
+        _sorter.reset( new BSONObjExternalSorter( *IndexDetails::iis[1], _order._spec.keyPattern ) );
+        for ( BestMap::const_iterator i = _best.begin(); i != _best.end(); ++i ) {
+            _sorterAdd(i->first, i->second, 0);
+        }
+        _best.clear();
+        // these bytes now live in the external sorter, which accounts them itself
+        memaccount::noteBytes( memaccount::ScanAndOrder , -(long long)_approxSize );
+        _approxSize = 0;
+    }
 
     void ScanAndOrder::add(BSONObj o, DiskLoc* loc) {
         assert( o.isValid() );
@@ -65,15 +107,29 @@ namespace mongo {
         }
 
         if ( k.isEmpty() ) {
-            return;   
+            return;
+        }
+        if ( _sorter ) {
+            _sorterAdd(k, o, loc);
+            return;
         }
         if ( (int) _best.size() < _limit ) {
             _approxSize += k.objsize();
             _approxSize += o.objsize();
-            
-            /* note : adjust when bson return limit adjusts. note this limit should be a bit higher. */
-            uassert( 10128 ,  "too much data for sort() with no index.  add an index or specify a smaller limit", _approxSize < MaxScanAndOrderBytes );
-            
+            memaccount::noteBytes( memaccount::ScanAndOrder , k.objsize() + o.objsize() );
+
+            if ( _approxSize >= MaxScanAndOrderBytes ) {
+                if ( !_limited() ) {
+                    // no limit was specified, so we can't cap the result set in memory -
+                    // shift to a disk based sort and carry on
+                    _spill();
+                    _sorterAdd(k, o, loc);
+                    return;
+                }
+                /* note : adjust when bson return limit adjusts. note this limit should be a bit higher. */
+                uasserted( 10128 ,  "too much data for sort() with no index.  add an index or specify a smaller limit" );
+            }
+
             _add(k, o, loc);
             return;
         }
@@ -85,7 +141,29 @@ namespace mongo {
     }
 
 
-    void ScanAndOrder::fill(BufBuilder& b, Projection *filter, int& nout ) const {
+    void ScanAndOrder::fill(BufBuilder& b, Projection *filter, int& nout ) {
+        if ( _sorter ) {
+            _sorter->sort();
+            int n = 0;
+            int nFilled = 0;
+            auto_ptr<BSONObjExternalSorter::Iterator> i = _sorter->iterator();
+            while ( i->more() ) {
+                BSONObj wrapped = i->next().first;
+                n++;
+                if ( n <= _startFrom )
+                    continue;
+                // the document is the trailing element - see _sorterAdd()
+                BSONElement last;
+                BSONObjIterator wi( wrapped );
+                while ( wi.more() )
+                    last = wi.next();
+                fillQueryResultFromObj(b, filter, last.embeddedObject());
+                nFilled++;
+                uassert( 10129 ,  "too much data for sort() with no index", b.len() < (int)MaxScanAndOrderBytes ); // appserver limit
+            }
+            nout = nFilled;
+            return;
+        }
         int n = 0;
         int nFilled = 0;
         for ( BestMap::const_iterator i = _best.begin(); i != _best.end(); i++ ) {
@@ -75,6 +75,8 @@ namespace mongo {
         }
     }
 
+    class BSONObjExternalSorter;
+
     typedef multimap<BSONObj,BSONObj,BSONObjCmp> BestMap;
     class ScanAndOrder {
     public:
@@ -87,12 +89,14 @@ namespace mongo {
             _approxSize = 0;
         }
 
+        ~ScanAndOrder(); // out of line for the sorter's sake
+
         int size() const { return _best.size(); }
 
         void add(BSONObj o, DiskLoc* loc);
 
         /* scanning complete. stick the query result in b for n objects. */
-        void fill(BufBuilder& b, Projection *filter, int& nout ) const;
+        void fill(BufBuilder& b, Projection *filter, int& nout );
 
     private:
 
@@ -100,11 +104,20 @@ namespace mongo {
 
         void _addIfBetter(BSONObj& k, BSONObj o, BestMap::iterator i, DiskLoc* loc);
 
+        /* unlimited sort hit the memory cap - move what we have to an external
+           sorter on disk and keep scanning with bounded memory */
+        void _spill();
+
+        void _sorterAdd(const BSONObj& k, const BSONObj& o, DiskLoc* loc);
+
+        bool _limited() const { return _limit != 0x7fffffff; }
+
         BestMap _best; // key -> full object
         int _startFrom;
         int _limit;   // max to send back.
         KeyType _order;
         unsigned _approxSize;
+        scoped_ptr<BSONObjExternalSorter> _sorter; // spill path for unlimited sorts
 
     };
 
@@ -47,24 +47,27 @@ namespace mongo {
     public:
         bool isLocalHost;
         
-        AuthenticationInfo(){ isLocalHost = false; }
+        AuthenticationInfo() : _snapshotLevel(Auth::NONE), _snapshotEpoch(0) { isLocalHost = false; }
         ~AuthenticationInfo() {}
 
         // -- modifiers ----
-        
+
         void logout(const string& dbname ) {
             scoped_spinlock lk(_lock);
             _dbs.erase(dbname);
+            ++_authEpoch; // snapshots taken before this are no longer trusted
         }
         void authorize(const string& dbname , const string& user ) {
             scoped_spinlock lk(_lock);
             _dbs[dbname].level = Auth::WRITE;
             _dbs[dbname].user = user;
+            ++_authEpoch;
         }
         void authorizeReadOnly(const string& dbname , const string& user ) {
             scoped_spinlock lk(_lock);
             _dbs[dbname].level = Auth::READ;
             _dbs[dbname].user = user;
+            ++_authEpoch;
         }
         
         // -- accessors ---
@@ -102,11 +105,38 @@ namespace mongo {
         bool _isAuthorizedSpecialChecks( const string& dbname ) const ;
 
     private:
+        /** remember a level we just verified for dbname so the next check on this
+            connection can skip the lock.  call with the epoch read BEFORE the locked
+            verification: if auth state changed in between, the stale epoch makes the
+            snapshot fail closed to the locked path. */
+        void _noteAuthorized( const string& dbname, Auth::Level level, unsigned epoch ) const {
+            if ( epoch == _snapshotEpoch && dbname == _snapshotDb ) {
+                if ( level > _snapshotLevel )
+                    _snapshotLevel = level;
+            }
+            else {
+                _snapshotDb = dbname;
+                _snapshotLevel = level;
+                _snapshotEpoch = epoch;
+            }
+        }
+
         mutable SpinLock _lock;
 
         typedef map<string,Auth> MA;
         MA _dbs; // dbname -> auth
 
+        /* per-op authorization hammers the same db name over and over on a
+           connection, so we keep a connection-local snapshot of the last level
+           granted.  the snapshot is only read and written by the connection's own
+           thread; the global epoch (bumped on any authorize/logout anywhere) is
+           what makes trusting it safe without synchronization. */
+        mutable string _snapshotDb;
+        mutable Auth::Level _snapshotLevel;
+        mutable unsigned _snapshotEpoch;
+
+        static AtomicUInt _authEpoch;
+
         static bool _warned;
     };
 
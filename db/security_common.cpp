@@ -121,21 +121,29 @@ namespace mongo {
     }
 
 
-    bool AuthenticationInfo::_isAuthorized(const string& dbname, Auth::Level level) const {
-        {
-            scoped_spinlock lk(_lock);
+    AtomicUInt AuthenticationInfo::_authEpoch;
 
-            if ( _isAuthorizedSingle_inlock( dbname , level ) )
-                return true;
+    bool AuthenticationInfo::_isAuthorized(const string& dbname, Auth::Level level) const {
+        if ( noauth )
+            return true;
 
-            if ( noauth )
-                return true;
+        // unsynchronized fast path: a snapshot this connection took earlier is good
+        // while the global epoch hasn't moved.  the snapshot is only written by the
+        // connection's own thread, so a plain read is safe; an epoch mismatch just
+        // falls through to the locked check.
+        if ( _snapshotEpoch == _authEpoch.get() && _snapshotLevel >= level && dbname == _snapshotDb )
+            return true;
 
-            if ( _isAuthorizedSingle_inlock( "admin" , level ) )
-                return true;
+        unsigned epoch = _authEpoch.get(); // read before verifying - see _noteAuthorized
+        {
+            scoped_spinlock lk(_lock);
 
-            if ( _isAuthorizedSingle_inlock( "local" , level ) )
+            if ( _isAuthorizedSingle_inlock( dbname , level ) ||
+                 _isAuthorizedSingle_inlock( "admin" , level ) ||
+                 _isAuthorizedSingle_inlock( "local" , level ) ) {
+                _noteAuthorized( dbname, level, epoch );
                 return true;
+            }
         }
         return _isAuthorizedSpecialChecks( dbname );
     }
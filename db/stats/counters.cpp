@@ -22,26 +22,6 @@
 
 namespace mongo {
 
-    OpCounters::OpCounters() {
-        int zero = 0;
-
-        BSONObjBuilder b;
-        b.append( "insert" , zero );
-        b.append( "query" , zero );
-        b.append( "update" , zero );
-        b.append( "delete" , zero );
-        b.append( "getmore" , zero );
-        b.append( "command" , zero );
-        _obj = b.obj();
-
-        _insert = (AtomicUInt*)_obj["insert"].value();
-        _query = (AtomicUInt*)_obj["query"].value();
-        _update = (AtomicUInt*)_obj["update"].value();
-        _delete = (AtomicUInt*)_obj["delete"].value();
-        _getmore = (AtomicUInt*)_obj["getmore"].value();
-        _command = (AtomicUInt*)_obj["command"].value();
-    }
-
     void OpCounters::gotOp( int op , bool isCommand ) {
         switch ( op ) {
         case dbInsert: /*gotInsert();*/ break; // need to handle multi-insert
@@ -63,28 +43,37 @@ namespace mongo {
         }
     }
 
-    BSONObj& OpCounters::getObj() {
-        const unsigned MAX = 1 << 30;
+    BSONObj OpCounters::getObj() {
+        // historically these were 32 bit and wrapped to zero before overflowing;
+        // keep that so downstream delta-computing tools (mongostat) see the same thing
+        const long long MAX = 1LL << 30;
         RARELY {
             bool wrap =
-            _insert->get() > MAX ||
-            _query->get() > MAX ||
-            _update->get() > MAX ||
-            _delete->get() > MAX ||
-            _getmore->get() > MAX ||
-            _command->get() > MAX;
+            _insert.get() > MAX ||
+            _query.get() > MAX ||
+            _update.get() > MAX ||
+            _delete.get() > MAX ||
+            _getmore.get() > MAX ||
+            _command.get() > MAX;
 
             if ( wrap ) {
-                _insert->zero();
-                _query->zero();
-                _update->zero();
-                _delete->zero();
-                _getmore->zero();
-                _command->zero();
+                _insert.zero();
+                _query.zero();
+                _update.zero();
+                _delete.zero();
+                _getmore.zero();
+                _command.zero();
             }
 
         }
-        return _obj;
+        BSONObjBuilder b;
+        b.appendNumber( "insert" , _insert.get() );
+        b.appendNumber( "query" , _query.get() );
+        b.appendNumber( "update" , _update.get() );
+        b.appendNumber( "delete" , _delete.get() );
+        b.appendNumber( "getmore" , _getmore.get() );
+        b.appendNumber( "command" , _command.get() );
+        return b.obj();
     }
 
     IndexCounters::IndexCounters() {
@@ -195,6 +184,17 @@ namespace mongo {
         b.appendNumber( "bytesOut" , _bytesOut );
         b.appendNumber( "numRequests" , _requests );
         _lock.unlock();
+
+        BSONObjBuilder byClass( b.subobjStart( "byConnectionClass" ) );
+        for ( int i = 0; i < ConnClass_Count; i++ ) {
+            ConnectionClassCounts c = getConnectionClassCounts( (ConnectionClass)i );
+            BSONObjBuilder cb( byClass.subobjStart( connectionClassName( (ConnectionClass)i ) ) );
+            cb.appendNumber( "bytesIn" , c.bytesIn );
+            cb.appendNumber( "bytesOut" , c.bytesOut );
+            cb.appendNumber( "retransmits" , c.retransmits );
+            cb.done();
+        }
+        byClass.done();
     }
 
 
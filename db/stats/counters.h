@@ -22,48 +22,46 @@
 #include "../../util/net/message.h"
 #include "../../util/processinfo.h"
 #include "../../util/concurrency/spin_lock.h"
+#include "../../util/concurrency/sharded_counter.h"
 
 namespace mongo {
 
     /**
-     * for storing operation counters
-     * note: not thread safe.  ok with that for speed
+     * for storing operation counters.  bumped on every operation, so the counters are
+     * sharded per thread (see sharded_counter.h) - a bump is one uncontended atomic
+     * add and the totals are only computed when serverStatus asks.
      */
     class OpCounters {
     public:
 
-        OpCounters();
+        OpCounters() { }
 
-        AtomicUInt * getInsert() { return _insert; }
-        AtomicUInt * getQuery() { return _query; }
-        AtomicUInt * getUpdate() { return _update; }
-        AtomicUInt * getDelete() { return _delete; }
-        AtomicUInt * getGetMore() { return _getmore; }
-        AtomicUInt * getCommand() { return _command; }
+        long long getInsert() const { return _insert.get(); }
+        long long getQuery() const { return _query.get(); }
+        long long getUpdate() const { return _update.get(); }
+        long long getDelete() const { return _delete.get(); }
+        long long getGetMore() const { return _getmore.get(); }
+        long long getCommand() const { return _command.get(); }
 
-        void incInsertInWriteLock(int n) { _insert->x += n; }
-        void gotInsert() { _insert[0]++; }
-        void gotQuery() { _query[0]++; }
-        void gotUpdate() { _update[0]++; }
-        void gotDelete() { _delete[0]++; }
-        void gotGetMore() { _getmore[0]++; }
-        void gotCommand() { _command[0]++; }
+        void incInsertInWriteLock(int n) { _insert.increment( n ); }
+        void gotInsert() { _insert.increment(); }
+        void gotQuery() { _query.increment(); }
+        void gotUpdate() { _update.increment(); }
+        void gotDelete() { _delete.increment(); }
+        void gotGetMore() { _getmore.increment(); }
+        void gotCommand() { _command.increment(); }
 
         void gotOp( int op , bool isCommand );
 
-        BSONObj& getObj();
+        BSONObj getObj();
 
     private:
-        BSONObj _obj;
-
-        // todo: there will be a lot of cache line contention on these.  need to do something 
-        //       else eventually.
-        AtomicUInt * _insert;
-        AtomicUInt * _query;
-        AtomicUInt * _update;
-        AtomicUInt * _delete;
-        AtomicUInt * _getmore;
-        AtomicUInt * _command;
+        ShardedCounter64 _insert;
+        ShardedCounter64 _query;
+        ShardedCounter64 _update;
+        ShardedCounter64 _delete;
+        ShardedCounter64 _getmore;
+        ShardedCounter64 _command;
     };
 
     extern OpCounters globalOpCounters;
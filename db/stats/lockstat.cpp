@@ -0,0 +1,99 @@
+// lockstat.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "lockstat.h"
+#include "../jsobj.h"
+#include "../../util/time_support.h"
+
+namespace mongo {
+
+    LockHoldProfile::LockHoldProfile() : _pos(0) {
+        memset( _entries , 0 , sizeof( _entries ) );
+    }
+
+    namespace {
+        inline unsigned saturate( unsigned long long micros ) {
+            return micros > 0xffffffffULL ? 0xffffffffU : (unsigned) micros;
+        }
+    }
+
+    void LockHoldProfile::record( const char * desc , unsigned long long holdMicros , unsigned long long waitMicros ) {
+        Entry& e = _entries[ _pos % NumEntries ];
+        strncpy( e.desc , desc , DescSize - 1 );
+        e.desc[ DescSize - 1 ] = 0;
+        e.hold = saturate( holdMicros );
+        e.wait = saturate( waitMicros );
+        e.when = curTimeMicros64(); // set last: a racing reader skips when==0 slots
+        _pos++;
+    }
+
+    void LockHoldProfile::append( BSONObjBuilder& b , int windowSecs , int maxEntries ) const {
+        unsigned long long now = curTimeMicros64();
+        unsigned long long span = windowSecs * 1000000ULL;
+        unsigned long long cutoff = now > span ? now - span : 0;
+
+        struct Agg {
+            Agg() : count(0) , hold(0) , maxHold(0) , wait(0) {}
+            long long count;
+            long long hold;
+            long long maxHold;
+            long long wait;
+        };
+        map<string,Agg> agg;
+
+        for ( unsigned i = 0; i < NumEntries; i++ ) {
+            const Entry& e = _entries[i];
+            if ( e.when == 0 || e.when < cutoff )
+                continue;
+            Agg& a = agg[ e.desc ];
+            a.count++;
+            a.hold += e.hold;
+            if ( e.hold > a.maxHold )
+                a.maxHold = e.hold;
+            a.wait += e.wait;
+        }
+
+        b.append( "windowSecs" , windowSecs );
+        b.append( "note" , "times in microseconds" );
+
+        // sort by total hold, descending
+        vector< pair<long long,string> > order;
+        for ( map<string,Agg>::const_iterator i = agg.begin(); i != agg.end(); ++i )
+            order.push_back( make_pair( i->second.hold , i->first ) );
+        sort( order.rbegin() , order.rend() );
+
+        BSONArrayBuilder arr( b.subarrayStart( "top" ) );
+        int n = 0;
+        for ( vector< pair<long long,string> >::const_iterator i = order.begin();
+              i != order.end() && n < maxEntries; ++i , ++n ) {
+            const Agg& a = agg[ i->second ];
+            BSONObjBuilder eb( arr.subobjStart() );
+            eb.append( "desc" , i->second );
+            eb.appendNumber( "count" , a.count );
+            eb.appendNumber( "totalHold" , a.hold );
+            eb.appendNumber( "maxHold" , a.maxHold );
+            eb.appendNumber( "totalWait" , a.wait );
+            eb.done();
+        }
+        arr.done();
+    }
+
+    LockHoldProfile lockHoldProfile;
+
+}
@@ -0,0 +1,68 @@
+// lockstat.h : write lock hold-time profiler
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /** ring buffer of recent write lock holds, for answering "what held the
+        write lock" without attaching a profiler.
+
+        record() runs at write lock release, while the lock is still held -
+        holders are therefore serialized and the ring needs no locking of its
+        own (cf. RamLog, which needs a mutex because its writers race).
+        readers scan the ring without coordination; a racing writer can make
+        the oldest entry torn, which aggregation tolerates.
+
+        MutexInfo keeps the aggregate; this attributes hold and wait time to
+        the operations (op type + namespace) that spent it.
+    */
+    class LockHoldProfile {
+    public:
+        enum { NumEntries = 1024 , DescSize = 56 };
+
+        LockHoldProfile();
+
+        /** record one write lock hold.  call with the lock still held.
+            @param desc  op attribution, e.g. "insert test.foo"; truncated to fit
+            @param holdMicros how long the lock was held
+            @param waitMicros how long the holder waited to acquire it
+        */
+        void record( const char * desc , unsigned long long holdMicros , unsigned long long waitMicros );
+
+        /** top lock consumers over the trailing window, aggregated by desc and
+            ordered by total hold time.  appends { windowSecs , top : [ ... ] }. */
+        void append( BSONObjBuilder& b , int windowSecs = 60 , int maxEntries = 10 ) const;
+
+    private:
+        struct Entry {
+            unsigned long long when; // curTimeMicros64 at release; 0 = never written
+            unsigned hold;           // micros, saturated
+            unsigned wait;           // micros, saturated
+            char desc[DescSize];     // nul terminated
+        };
+
+        Entry _entries[NumEntries];
+        unsigned _pos; // next slot; only advanced under the write lock
+    };
+
+    extern LockHoldProfile lockHoldProfile;
+
+}
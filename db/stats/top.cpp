@@ -29,8 +29,46 @@ namespace mongo {
         count = (newer.count >= older.count) ? (newer.count - older.count) : newer.count;
     }
 
+    Top::LatencyHistogram::LatencyHistogram( const LatencyHistogram& older , const LatencyHistogram& newer ) {
+        // same caveat as UsageData: not 100% accurate across rollovers/drops,
+        // but never negative
+        count = (newer.count >= older.count) ? (newer.count - older.count) : newer.count;
+        for ( int i = 0; i < NumBuckets; i++ )
+            buckets[i] = (newer.buckets[i] >= older.buckets[i]) ?
+                (newer.buckets[i] - older.buckets[i]) : newer.buckets[i];
+    }
+
+    void Top::LatencyHistogram::add( const LatencyHistogram& other ) {
+        count += other.count;
+        for ( int i = 0; i < NumBuckets; i++ )
+            buckets[i] += other.buckets[i];
+    }
+
+    long long Top::LatencyHistogram::percentile( double q ) const {
+        if ( count == 0 )
+            return 0;
+        long long target = (long long)( q * count );
+        if ( target >= count )
+            target = count - 1;
+        long long seen = 0;
+        for ( int i = 0; i < NumBuckets; i++ ) {
+            seen += buckets[i];
+            if ( seen > target )
+                return ( 1LL << ( i + 1 ) ) - 1; // upper bound of bucket i
+        }
+        return 0; // not reached - the buckets sum to count
+    }
+
+    void Top::LatencyHistogram::appendPercentiles( BSONObjBuilder& b ) const {
+        b.appendNumber( "count" , count );
+        b.appendNumber( "p50" , percentile( .5 ) );
+        b.appendNumber( "p99" , percentile( .99 ) );
+        b.appendNumber( "p999" , percentile( .999 ) );
+    }
+
     Top::CollectionData::CollectionData( const CollectionData& older , const CollectionData& newer )
         : total( older.total , newer.total ) ,
+          latency( older.latency , newer.latency ) ,
           readLock( older.readLock , newer.readLock ) ,
           writeLock( older.writeLock , newer.writeLock ) ,
           queries( older.queries , newer.queries ) ,
@@ -42,25 +80,61 @@ namespace mongo {
 
     }
 
+    void Top::CollectionData::add( const CollectionData& other ) {
+        total.add( other.total );
+        latency.add( other.latency );
+        readLock.add( other.readLock );
+        writeLock.add( other.writeLock );
+        queries.add( other.queries );
+        getmore.add( other.getmore );
+        insert.add( other.insert );
+        update.add( other.update );
+        remove.add( other.remove );
+        commands.add( other.commands );
+    }
+
     void Top::record( const string& ns , int op , int lockType , long long micros , bool command ) {
         if ( ns[0] == '?' )
             return;
 
         //cout << "record: " << ns << "\t" << op << "\t" << command << endl;
-        scoped_lock lk(_lock);
-
-        if ( ( command || op == dbQuery ) && ns == _lastDropped ) {
-            _lastDropped = "";
-            return;
+        Shard& s = _myShard();
+        {
+            scoped_lock lk(s.lock);
+            if ( ! ( ( command || op == dbQuery ) && ns == s.lastDropped ) ) {
+                CollectionData& coll = s.usage[ns];
+                _record( coll , op , lockType , micros , command );
+                _record( s.global , op , lockType , micros , command );
+                int lt = _latencyType( op , command );
+                if ( lt >= 0 )
+                    s.opLatency[lt].inc( micros );
+                return;
+            }
         }
+        // first operation against a just-dropped ns: don't credit it to the fresh
+        // entry.  clear the marker in all shards, one lock at a time (never holding
+        // two shard locks at once, so ordering stays trivial).
+        for ( int i = 0; i < NumShards; i++ ) {
+            scoped_lock lk(_shards[i].lock);
+            if ( _shards[i].lastDropped == ns )
+                _shards[i].lastDropped = "";
+        }
+    }
 
-        CollectionData& coll = _usage[ns];
-        _record( coll , op , lockType , micros , command );
-        _record( _global , op , lockType , micros , command );
+    int Top::_latencyType( int op , bool command ) {
+        switch ( op ) {
+        case dbUpdate:  return LatencyUpdate;
+        case dbInsert:  return LatencyInsert;
+        case dbQuery:   return command ? LatencyCommand : LatencyQuery;
+        case dbGetMore: return LatencyGetMore;
+        case dbDelete:  return LatencyRemove;
+        default:        return -1;
+        }
     }
 
     void Top::_record( CollectionData& c , int op , int lockType , long long micros , bool command ) {
         c.total.inc( micros );
+        c.latency.inc( micros );
 
         if ( lockType > 0 )
             c.writeLock.inc( micros );
@@ -103,19 +177,73 @@ namespace mongo {
 
     void Top::collectionDropped( const string& ns ) {
         //cout << "collectionDropped: " << ns << endl;
-        scoped_lock lk(_lock);
-        _usage.erase(ns);
-        _lastDropped = ns;
+        for ( int i = 0; i < NumShards; i++ ) {
+            scoped_lock lk(_shards[i].lock);
+            _shards[i].usage.erase(ns);
+            _shards[i].lastDropped = ns;
+        }
     }
 
     void Top::cloneMap(Top::UsageMap& out) const {
-        scoped_lock lk(_lock);
-        out = _usage;
+        out.clear();
+        for ( int i = 0; i < NumShards; i++ ) {
+            scoped_lock lk(_shards[i].lock);
+            for ( UsageMap::const_iterator j = _shards[i].usage.begin(); j != _shards[i].usage.end(); j++ )
+                out[j->first].add( j->second );
+        }
+    }
+
+    Top::CollectionData Top::getGlobalData() const {
+        CollectionData d;
+        for ( int i = 0; i < NumShards; i++ ) {
+            scoped_lock lk(_shards[i].lock);
+            d.add( _shards[i].global );
+        }
+        return d;
+    }
+
+    void Top::_mergeOpLatency( LatencyHistogram * merged ) const {
+        for ( int i = 0; i < NumShards; i++ ) {
+            scoped_lock lk(_shards[i].lock);
+            for ( int t = 0; t < NumLatencyTypes; t++ )
+                merged[t].add( _shards[i].opLatency[t] );
+        }
+    }
+
+    namespace {
+        const char * latencyTypeNames[] = { "queries" , "getmore" , "insert" , "update" , "remove" , "commands" };
+    }
+
+    void Top::appendLatencyStats( BSONObjBuilder& b ) const {
+        LatencyHistogram merged[NumLatencyTypes];
+        _mergeOpLatency( merged );
+        for ( int t = 0; t < NumLatencyTypes; t++ ) {
+            BSONObjBuilder bb( b.subobjStart( latencyTypeNames[t] ) );
+            merged[t].appendPercentiles( bb );
+            bb.done();
+        }
+    }
+
+    void Top::latencyHTML( stringstream& ss ) const {
+        LatencyHistogram merged[NumLatencyTypes];
+        _mergeOpLatency( merged );
+        ss << "<b>op latency (&micro;s)</b><br>\n";
+        ss << "<table border=1 cellpadding=2 cellspacing=0>\n";
+        ss << "<tr><th>op</th><th>count</th><th>p50</th><th>p99</th><th>p999</th></tr>\n";
+        for ( int t = 0; t < NumLatencyTypes; t++ ) {
+            ss << "<tr><td>" << latencyTypeNames[t] << "</td>"
+               << "<td>" << merged[t].count << "</td>"
+               << "<td>" << merged[t].percentile( .5 ) << "</td>"
+               << "<td>" << merged[t].percentile( .99 ) << "</td>"
+               << "<td>" << merged[t].percentile( .999 ) << "</td></tr>\n";
+        }
+        ss << "</table>\n";
     }
 
     void Top::append( BSONObjBuilder& b ) {
-        scoped_lock lk( _lock );
-        _appendToUsageMap( b , _usage );
+        UsageMap merged;
+        cloneMap( merged );
+        _appendToUsageMap( b , merged );
     }
 
     void Top::_appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ) const {
@@ -125,6 +253,11 @@ namespace mongo {
             const CollectionData& coll = i->second;
 
             _appendStatsEntry( b , "total" , coll.total );
+            {
+                BSONObjBuilder lb( b.subobjStart( "latency" ) );
+                coll.latency.appendPercentiles( lb );
+                lb.done();
+            }
 
             _appendStatsEntry( b , "readLock" , coll.readLock );
             _appendStatsEntry( b , "writeLock" , coll.writeLock );
@@ -21,15 +21,55 @@
 #undef assert
 #define assert MONGO_assert
 
+#include "../../util/concurrency/sharded_counter.h"
+
 namespace mongo {
 
     /**
-     * tracks usage by collection
+     * tracks usage by collection.  record() runs on every operation, so state is
+     * sharded by thread: each shard has its own mutex and usage map and record()
+     * only ever touches its own shard (uncontended).  readers merge the shards.
      */
     class Top {
 
     public:
-        Top() : _lock("Top") { }
+        Top() { }
+
+        /** log-bucketed latency recorder: bucket n counts operations that took
+            [2^n, 2^(n+1)) microseconds.  inc() is a bit scan plus two
+            increments, so every operation is recorded rather than a sample -
+            the shard lock record() already holds keeps it uncontended.
+            percentile() answers with the containing bucket's upper bound,
+            i.e. exact to within a factor of two, which is plenty for
+            p50/p99/p999 trending without a profiler attached. */
+        struct LatencyHistogram {
+            enum { NumBuckets = 32 };
+            long long buckets[NumBuckets];
+            long long count;
+
+            LatencyHistogram() : count(0) { memset( buckets , 0 , sizeof( buckets ) ); }
+            /** constructs a diff, same convention as UsageData( older , newer ) */
+            LatencyHistogram( const LatencyHistogram& older , const LatencyHistogram& newer );
+
+            void inc( long long micros ) {
+                unsigned long long m = micros > 0 ? (unsigned long long)micros : 0;
+                int b = 0;
+                while ( m >>= 1 )
+                    b++;
+                if ( b >= NumBuckets )
+                    b = NumBuckets - 1;
+                buckets[b]++;
+                count++;
+            }
+
+            void add( const LatencyHistogram& other );
+
+            /** micros at or below which fraction q (0..1) of recorded ops completed */
+            long long percentile( double q ) const;
+
+            /** appends { count , p50 , p99 , p999 } (micros) */
+            void appendPercentiles( BSONObjBuilder& b ) const;
+        };
 
         struct UsageData {
             UsageData() : time(0) , count(0) {}
@@ -41,6 +81,11 @@ namespace mongo {
                 count++;
                 time += micros;
             }
+
+            void add( const UsageData& other ) {
+                time += other.time;
+                count += other.count;
+            }
         };
 
         struct CollectionData {
@@ -50,8 +95,15 @@ namespace mongo {
             CollectionData() {}
             CollectionData( const CollectionData& older , const CollectionData& newer );
 
+            void add( const CollectionData& other );
+
             UsageData total;
 
+            // all-op latency distribution for this collection.  one histogram per
+            // collection rather than one per op type - the per-type breakdown is
+            // kept globally (see opLatency below) to bound per-namespace memory
+            LatencyHistogram latency;
+
             UsageData readLock;
             UsageData writeLock;
 
@@ -65,11 +117,23 @@ namespace mongo {
 
         typedef map<string,CollectionData> UsageMap;
 
+        /** op-type buckets for the global latency histograms */
+        enum LatencyType {
+            LatencyQuery = 0 , LatencyGetMore , LatencyInsert ,
+            LatencyUpdate , LatencyRemove , LatencyCommand ,
+            NumLatencyTypes
+        };
+
     public:
         void record( const string& ns , int op , int lockType , long long micros , bool command );
         void append( BSONObjBuilder& b );
+        /** per-op-type latency percentiles - serverStatus "opLatencies" section */
+        void appendLatencyStats( BSONObjBuilder& b ) const;
+        /** same data as an html table for the admin web console */
+        void latencyHTML( stringstream& ss ) const;
+        /** merged view across the shards */
         void cloneMap(UsageMap& out) const;
-        CollectionData getGlobalData() const { return _global; }
+        CollectionData getGlobalData() const;
         void collectionDropped( const string& ns );
 
     public: // static stuff
@@ -79,11 +143,24 @@ namespace mongo {
         void _appendToUsageMap( BSONObjBuilder& b , const UsageMap& map ) const;
         void _appendStatsEntry( BSONObjBuilder& b , const char * statsName , const UsageData& map ) const;
         void _record( CollectionData& c , int op , int lockType , long long micros , bool command );
+        /** LatencyType for op, or -1 if the op isn't latency-tracked */
+        static int _latencyType( int op , bool command );
+        void _mergeOpLatency( LatencyHistogram * merged ) const;
+
+        enum { NumShards = 8 }; // power of two
+
+        struct Shard {
+            Shard() : lock("Top") { }
+            mutable mongo::mutex lock;
+            CollectionData global;
+            LatencyHistogram opLatency[NumLatencyTypes];
+            UsageMap usage;
+            string lastDropped;
+        };
+
+        Shard& _myShard() { return _shards[ threadCounterSlot() & (NumShards-1) ]; }
 
-        mutable mongo::mutex _lock;
-        CollectionData _global;
-        UsageMap _usage;
-        string _lastDropped;
+        Shard _shards[NumShards];
     };
 
     /* Records per namespace utilization of the mongod process.
@@ -0,0 +1,93 @@
+// @file tailnotify.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "tailnotify.h"
+#include "../util/concurrency/mutex.h"
+#include "../bson/util/atomic_int.h"
+
+namespace mongo {
+
+    /** per capped collection insert ticker.  each collection that has ever been
+        tailed gets an entry with a tick counter and its own condition, so an
+        insert wakes only that collection's tailers.  entries are never removed;
+        the set is bounded by the number of capped collections tailed, which is
+        small.
+    */
+    class CappedTailNotifier : boost::noncopyable {
+        struct Entry {
+            Entry() : tick(0) { }
+            unsigned long long tick;
+            boost::condition cond;
+        };
+    public:
+        CappedTailNotifier() : _mutex("CappedTailNotifier") { }
+
+        void notify(const char *ns) {
+            if( _nRegistered == 0 )
+                return; // nothing has ever tailed anything -- stay off the insert path
+            scoped_lock lk(_mutex);
+            map< string, shared_ptr<Entry> >::const_iterator it = _entries.find(ns);
+            if( it != _entries.end() ) {
+                it->second->tick++;
+                it->second->cond.notify_all();
+            }
+        }
+
+        unsigned long long ticket(const char *ns) {
+            scoped_lock lk(_mutex);
+            return _entry(ns)->tick;
+        }
+
+        unsigned long long waitFor(const char *ns, unsigned long long since, unsigned millis) {
+            scoped_lock lk(_mutex);
+            shared_ptr<Entry> e = _entry(ns);
+            if( e->tick == since )
+                e->cond.timed_wait(lk.boost(), boost::posix_time::milliseconds(millis));
+            return e->tick;
+        }
+
+    private:
+        // call with _mutex held
+        shared_ptr<Entry>& _entry(const char *ns) {
+            shared_ptr<Entry>& e = _entries[ns];
+            if( !e ) {
+                e.reset(new Entry());
+                _nRegistered++;
+            }
+            return e;
+        }
+
+        AtomicUInt _nRegistered; // gates the insert path; nonzero once any ns registered
+        mongo::mutex _mutex;
+        map< string, shared_ptr<Entry> > _entries;
+    } cappedTailNotifier;
+
+    void notifyCappedInsert(const char *ns) {
+        cappedTailNotifier.notify(ns);
+    }
+
+    unsigned long long cappedInsertTicket(const char *ns) {
+        return cappedTailNotifier.ticket(ns);
+    }
+
+    unsigned long long waitForCappedInsert(const char *ns, unsigned long long since, unsigned millis) {
+        return cappedTailNotifier.waitFor(ns, since, millis);
+    }
+
+}
@@ -0,0 +1,41 @@
+// @file tailnotify.h wake tailable getMores on capped collection inserts instead of polling
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+namespace mongo {
+
+    /** note an insert into capped collection ns so tailable cursors waiting on it
+        wake up.  called from the insert path, under the write lock.  cheap (one
+        load, no mutex) until the first tailable cursor ever waits on a collection.
+    */
+    void notifyCappedInsert(const char *ns);
+
+    /** current insert tick for ns; registers ns with the notifier.  call while at
+        least read locked, before releasing the lock, so an insert between the
+        snapshot and a later wait cannot be missed.
+    */
+    unsigned long long cappedInsertTicket(const char *ns);
+
+    /** wait up to millis ms for an insert into ns after tick 'since'.  call
+        without the db lock held.
+        @return the latest tick (pass it to the next wait)
+    */
+    unsigned long long waitForCappedInsert(const char *ns, unsigned long long since, unsigned millis);
+
+}
@@ -0,0 +1,132 @@
+// @file text.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "namespace-inl.h"
+#include "jsobj.h"
+#include "index.h"
+#include "text.h"
+#include "pdfile.h"
+#include "btree.h"
+#include "matcher.h"
+
+/**
+ * a minimal inverted index via the IndexPlugin mechanism.
+ *
+ *   db.articles.ensureIndex( { body : "text" } )
+ *   db.articles.find( { body : { $text : "mongodb durability" } } )
+ *
+ * each distinct token of the indexed string field becomes an index key, so a
+ * term lookup is a plain btree range.  multi term queries descend on one term
+ * (the longest, as a cheap rarity heuristic) and let the matcher enforce the
+ * rest on the candidate documents.  no stemming, no scoring - this replaces
+ * unanchored $regex collection scans, it is not a search engine.
+ */
+namespace mongo {
+
+    static const string TEXTNAME = "text";
+
+    class TextIndexType : public IndexType {
+    public:
+        TextIndexType( const IndexPlugin* plugin , const IndexSpec* spec )
+            : IndexType( plugin , spec ) {
+            BSONObjIterator i( spec->keyPattern );
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                if ( e.type() == String && TEXTNAME == e.valuestr() ) {
+                    uassert( 16313 , "can't have 2 text fields" , _field.size() == 0 );
+                    _field = e.fieldName();
+                }
+                else {
+                    uassert( 16314 , "text index can't have other fields" , false );
+                }
+            }
+            uassert( 16315 , "no text field specified" , _field.size() );
+        }
+
+        void getKeys( const BSONObj& obj , BSONObjSet& keys ) const {
+            BSONElementSet vals;
+            obj.getFieldsDotted( _field , vals );
+            set<string> terms;
+            for ( BSONElementSet::const_iterator i = vals.begin(); i != vals.end(); ++i ) {
+                if ( i->type() == String )
+                    text::tokenize( i->valuestr() , terms );
+            }
+            for ( set<string>::const_iterator i = terms.begin(); i != terms.end(); ++i ) {
+                BSONObjBuilder b;
+                b.append( "" , *i );
+                keys.insert( b.obj() );
+            }
+        }
+
+        shared_ptr<Cursor> newCursor( const BSONObj& query , const BSONObj& order , int numWanted ) const {
+            set<string> terms = queryTerms( query );
+            uassert( 16316 , "$text needs at least one term of 2+ characters" , !terms.empty() );
+
+            // descend on the longest term as a cheap rarity heuristic; the
+            // matcher enforces the remaining terms on the candidates
+            string pick;
+            for ( set<string>::const_iterator i = terms.begin(); i != terms.end(); ++i )
+                if ( i->size() > pick.size() )
+                    pick = *i;
+
+            const IndexDetails *id = _spec->getDetails();
+            NamespaceDetails *d = nsdetails( id->parentNS().c_str() );
+            massert( 16317 , "ns dropped under text cursor?" , d );
+            int idxNo = d->idxNo( *const_cast<IndexDetails*>( id ) );
+            BSONObj key = BSON( "" << pick );
+            return shared_ptr<Cursor>( BtreeCursor::make( d , idxNo , *id , key , key , true , 1 ) );
+        }
+
+        virtual IndexSuitability suitability( const BSONObj& query , const BSONObj& order ) const {
+            if ( queryTerms( query ).empty() )
+                return USELESS;
+            return OPTIMAL;
+        }
+
+        virtual bool scanAndOrderRequired( const BSONObj& query , const BSONObj& order ) const {
+            return ! order.isEmpty();
+        }
+
+    private:
+        /** terms of a { <field> : { $text : "..." } } clause of query, if any */
+        set<string> queryTerms( const BSONObj& query ) const {
+            set<string> terms;
+            BSONElement e = query.getFieldDotted( _field );
+            if ( e.type() == Object ) {
+                BSONElement t = e.embeddedObject().firstElement();
+                if ( t.type() == String && str::equals( t.fieldName() , "$text" ) )
+                    text::tokenize( t.valuestr() , terms );
+            }
+            return terms;
+        }
+
+        string _field;
+    };
+
+    class TextIndexPlugin : public IndexPlugin {
+    public:
+        TextIndexPlugin() : IndexPlugin( TEXTNAME ) {}
+
+        virtual IndexType* generate( const IndexSpec* spec ) const {
+            return new TextIndexType( this , spec );
+        }
+
+    } textIndexPlugin;
+
+}
@@ -0,0 +1,54 @@
+// @file text.h
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "../pch.h"
+
+namespace mongo {
+
+    /** tokenizer shared by the text index plugin (text.cpp) and the $text
+        matcher (matcher.cpp).  both sides must split identically or lookups
+        and verification disagree. */
+    namespace text {
+
+        const size_t MinTermLen = 2;
+        const size_t MaxTermLen = 32;
+
+        /** split s into lowercased alphanumeric terms.  terms outside
+            [MinTermLen,MaxTermLen] are dropped; duplicates collapse (the index
+            stores one posting per distinct term per document). */
+        inline void tokenize( const char* s , set<string>& terms ) {
+            string cur;
+            while ( 1 ) {
+                char c = *s++;
+                if ( isalnum( (unsigned char)c ) ) {
+                    cur += (char) tolower( (unsigned char)c );
+                    continue;
+                }
+                if ( cur.size() >= MinTermLen && cur.size() <= MaxTermLen )
+                    terms.insert( cur );
+                cur.clear();
+                if ( c == 0 )
+                    break;
+            }
+        }
+
+    }
+
+}
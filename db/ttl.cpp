@@ -0,0 +1,131 @@
+// ttl.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "ttl.h"
+#include "db.h"
+#include "instance.h"
+#include "ops/delete.h"
+#include "replutil.h"
+#include "../util/background.h"
+
+namespace mongo {
+
+    /** expires documents out of collections with a TTL index: a single field index
+        on a date field created with { expireAfterSeconds : <n> } in the index info.
+        each pass deletes whatever has aged out, a little at a time, instead of the
+        traditional nightly remove({ts:{$lt:cutoff}}) avalanche.  the deletes go
+        through deleteObjects so they use the index, yield the write lock
+        periodically, and get logged to the oplog like any other remove.
+    */
+    class TTLMonitor : public BackgroundJob {
+    public:
+        string name() const { return "TTLMonitor"; }
+
+        static string secondsExpireField;
+
+        void doTTLForDB( const string& dbName ) {
+
+            if ( ! isMaster( dbName.c_str() ) ) {
+                // slaves just apply the deletes they see in the oplog
+                return;
+            }
+
+            vector<BSONObj> indexes;
+            {
+                DBDirectClient db;
+                auto_ptr<DBClientCursor> cursor = db.query( dbName + ".system.indexes" ,
+                                                            BSON( secondsExpireField << BSON( "$exists" << true ) ) );
+                if ( cursor.get() ) {
+                    while ( cursor->more() ) {
+                        indexes.push_back( cursor->next().getOwned() );
+                    }
+                }
+            }
+
+            for ( unsigned i = 0; i < indexes.size(); i++ ) {
+                BSONObj idx = indexes[i];
+
+                BSONObj key = idx["key"].Obj();
+                if ( key.nFields() != 1 ) {
+                    error() << "TTL index can only have 1 field, skipping: " << idx << endl;
+                    continue;
+                }
+
+                BSONObj query;
+                {
+                    BSONObjBuilder b;
+                    b.appendDate( "$lt" , curTimeMillis64() - ( 1000 * idx[secondsExpireField].numberLong() ) );
+                    query = BSON( key.firstElement().fieldName() << b.obj() );
+                }
+
+                LOG(1) << "TTL: " << key << " \t " << query << endl;
+
+                long long n = 0;
+                {
+                    string ns = idx["ns"].String();
+                    writelock lk( ns );
+                    Client::Context ctx( ns );
+                    NamespaceDetails* nsd = nsdetails( ns.c_str() );
+                    if ( ! nsd ) {
+                        // collection was dropped
+                        continue;
+                    }
+                    n = deleteObjects( ns.c_str() , query , false , true );
+                }
+
+                LOG(1) << "\tTTL deleted: " << n << endl;
+            }
+        }
+
+        void run() {
+            Client::initThread( name().c_str() );
+            Client& client = cc();
+
+            while ( ! inShutdown() ) {
+                sleepsecs( 60 );
+
+                set<string> dbs;
+                {
+                    readlock lk;
+                    dbHolder().getAllShortNames( false, dbs );
+                }
+
+                for ( set<string>::const_iterator i = dbs.begin(); i != dbs.end(); ++i ) {
+                    string db = *i;
+                    try {
+                        doTTLForDB( db );
+                    }
+                    catch ( DBException& e ) {
+                        error() << "error processing ttl for db: " << db << " " << e << endl;
+                    }
+                }
+            }
+
+            client.shutdown();
+        }
+    };
+
+    string TTLMonitor::secondsExpireField = "expireAfterSeconds";
+
+    void startTTLBackgroundJob() {
+        TTLMonitor* ttl = new TTLMonitor();
+        ttl->go();
+    }
+
+}
@@ -634,7 +634,55 @@ namespace BasicTests {
         }
     };
 
-    struct CompressionTest1 { 
+    class OpArenaTest {
+    public:
+        void run() {
+            OpArena a;
+
+            // alignment and chunk growth
+            char *p1 = (char*)a.alloc( 3 );
+            char *p2 = (char*)a.alloc( 10 );
+            ASSERT_EQUALS( 8, (int)( p2 - p1 ) );
+            for( int i = 0; i < 100; i++ )
+                memset( a.alloc( 4000 ), 0xab, 4000 );
+            memset( a.alloc( 200 * 1024 ), 0xcd, 200 * 1024 ); // oversized allocation
+
+            // rewind drops only what came after the mark
+            a.reset();
+            char *base = (char*)a.alloc( 16 );
+            OpArena::Mark m = a.mark();
+            for( int i = 0; i < 100; i++ )
+                a.alloc( 4000 );
+            a.rewind( m );
+            ASSERT_EQUALS( base + 16, (char*)a.alloc( 16 ) );
+
+            // only the outermost scope resets
+            {
+                OpArena::Scope outer( a );
+                char *p = (char*)a.alloc( 16 );
+                memset( p, 1, 16 );
+                {
+                    OpArena::Scope inner( a );
+                    a.alloc( 16 );
+                }
+                ASSERT_EQUALS( 1, (int)p[ 0 ] ); // inner scope must not have reset
+            }
+
+            // an op scratch BufBuilder draws from the thread's client's arena
+            {
+                OpArena::Scope scope( cc().opArena() );
+                BufBuilder b( BufBuilder::UseOpScratch(), 64 );
+                ASSERT( b.opScratch() );
+                for( int i = 0; i < 10000; i++ )
+                    b.appendNum( i );
+                for( int i = 0; i < 10000; i++ )
+                    ASSERT_EQUALS( i, ((int*)b.buf())[ i ] );
+                ASSERT_THROWS( b.decouple(), AssertionException );
+            }
+        }
+    };
+
+    struct CompressionTest1 {
         void run() { 
             const char * c = "this is a test";
             std::string s;
@@ -686,6 +734,7 @@ namespace BasicTests {
             add< HostAndPortTests >();
             add< RelativePathTest >();
             add< CmdLineParseConfigTest >();
+            add< OpArenaTest >();
 
             add< CompressionTest1 >();
         }
@@ -82,6 +82,17 @@ namespace JsobjTests {
                     k.woEqual(*kLast);
                     ASSERT(false);
                 }
+                {
+                    // woCompareSkipMatched with no skip must agree with woCompare, and
+                    // skipping the prefix it reports as matched must give the same answer
+                    int matched = 0;
+                    int r4 = k.woCompareSkipMatched(*kLast, Ordering::make(BSONObj()), 0, &matched);
+                    ASSERT( (r4<0) == (r2<0) && (r4>0) == (r2>0) );
+                    int matchedAgain = 0;
+                    int r5 = k.woCompareSkipMatched(*kLast, Ordering::make(BSONObj()), matched, &matchedAgain);
+                    ASSERT( (r5<0) == (r2<0) && (r5>0) == (r2>0) );
+                    ASSERT( matchedAgain >= matched );
+                }
             }
         }
 
@@ -1823,6 +1834,27 @@ namespace JsobjTests {
 
     };
 
+    class bsonfieldindextest {
+    public:
+        void run() {
+            BSONObj o = BSON( "z" << 1 << "ab" << 2 << "a" << 3 << "a" << 4 << "c" << BSON( "x" << 9 ) );
+            BSONObjFieldIndex idx( o );
+
+            ASSERT_EQUALS( 3 , idx.getField( "a" ).numberInt() ); // first occurrence wins, as with getField()
+            ASSERT_EQUALS( 2 , idx.getField( "ab" ).numberInt() ); // no prefix confusion
+            ASSERT_EQUALS( 1 , idx.getField( "z" ).numberInt() );
+            ASSERT( idx.getField( "q" ).eoo() );
+            ASSERT( idx.getField( "" ).eoo() );
+
+            const char * name = "c.x";
+            ASSERT_EQUALS( 9 , idx.getFieldDottedOrArray( name ).numberInt() );
+            ASSERT( *name == 0 );
+
+            name = "c.nope";
+            ASSERT( idx.getFieldDottedOrArray( name ).eoo() );
+        }
+    };
+
     class checkForStorageTests {
     public:
 
@@ -2191,6 +2223,7 @@ namespace JsobjTests {
             add< ArrayMacroTest >();
             add< NumberParsing >();
             add< bson2settest >();
+            add< bsonfieldindextest >();
             add< checkForStorageTests >();
             add< InvalidIDFind >();
             add< ElementSetTest >();
@@ -68,6 +68,17 @@ namespace MatcherTests {
         }
     };
 
+    /** two predicates on one field must both apply (quick path regression) */
+    class RangeOneField {
+    public:
+        void run() {
+            Matcher m( fromjson( "{\"a\":{\"$gt\":1,\"$lt\":5}}" ) );
+            ASSERT( m.matches( fromjson( "{\"a\":3}" ) ) );
+            ASSERT( !m.matches( fromjson( "{\"a\":0}" ) ) );
+            ASSERT( !m.matches( fromjson( "{\"a\":7}" ) ) );
+        }
+    };
+
     class MixedNumericIN {
     public:
         void run() {
@@ -152,6 +163,7 @@ namespace MatcherTests {
             add< DoubleEqual >();
             add< MixedNumericEqual >();
             add< MixedNumericGt >();
+            add< RangeOneField >();
             add< MixedNumericIN >();
             add< Size >();
             add< MixedNumericEmbedded >();
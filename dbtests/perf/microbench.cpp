@@ -0,0 +1,262 @@
+// microbench.cpp : microbenchmarks for server hot paths.
+//
+// unlike perftest.cpp these run against in-process code only - no client
+// connection, no data files - so a run takes seconds and the numbers are
+// stable enough to gate library and compiler upgrades on.  output is one
+// json document per line, suitable for diffing between builds.
+
+/**
+ *    Copyright (C) 2011 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pch.h"
+
+#include "../../db/key.h"
+#include "../../db/matcher.h"
+#include "../../s/shardkey.h"
+#include "../../util/alignedbuilder.h"
+#include "../../util/timer.h"
+
+namespace mongo {
+
+    // keeps the optimizer from discarding benchmark bodies
+    volatile long long microbenchSink;
+
+    namespace {
+
+        /** one microbenchmark.  timed(n) performs the measured operation n
+            times; the harness grows n until a sample runs long enough for
+            Timer's microsecond resolution to give a stable rate. */
+        class Micro {
+        public:
+            virtual ~Micro() {}
+            virtual string name() const = 0;
+            virtual void timed( long long n ) = 0;
+
+            void run() {
+                // calibration doubles as warmup
+                long long n = 1024;
+                long long micros;
+                while ( 1 ) {
+                    Timer t;
+                    timed( n );
+                    micros = (long long) t.micros();
+                    if ( micros >= 200 * 1000 )
+                        break;
+                    n *= 4;
+                }
+                cout << "{ \"name\" : \"" << name() << "\""
+                     << " , \"iters\" : " << n
+                     << " , \"totalMicros\" : " << micros
+                     << " , \"nsPerOp\" : " << ( micros * 1000.0 / n )
+                     << " , \"opsPerSec\" : " << (long long)( n * 1000000.0 / micros )
+                     << " }" << endl;
+            }
+        };
+
+        /* --- btree ------------------------------------------------------ */
+
+        // key compares dominate btree descent with v1 format indexes
+        class KeyV1Compare : public Micro {
+        public:
+            KeyV1Compare()
+                : _o( Ordering::make( BSON( "a" << 1 << "b" << 1 ) ) ) ,
+                  _a( BSON( "" << 123456 << "" << "some_indexed_value" ) ) ,
+                  _b( BSON( "" << 123456 << "" << "some_indexed_valuf" ) ) {}
+            string name() const { return "btree.KeyV1.woCompare"; }
+            void timed( long long n ) {
+                long long x = 0;
+                for ( long long i = 0; i < n; i++ )
+                    x += _a.woCompare( _b , _o );
+                microbenchSink += x;
+            }
+        private:
+            Ordering _o;
+            KeyV1Owned _a, _b;
+        };
+
+        // bson -> compact key conversion, done once per inserted index entry
+        class KeyV1Construct : public Micro {
+        public:
+            KeyV1Construct() : _obj( BSON( "" << 123456 << "" << "some_indexed_value" ) ) {}
+            string name() const { return "btree.KeyV1Owned.construct"; }
+            void timed( long long n ) {
+                long long x = 0;
+                for ( long long i = 0; i < n; i++ ) {
+                    KeyV1Owned k( _obj );
+                    x += k.dataSize();
+                }
+                microbenchSink += x;
+            }
+        private:
+            BSONObj _obj;
+        };
+
+        /* --- matcher ---------------------------------------------------- */
+
+        class MatcherMatches : public Micro {
+        public:
+            MatcherMatches()
+                : _m( BSON( "a" << GT << 50 << "b" << "hello" ) ) ,
+                  _matching( BSON( "a" << 71 << "b" << "hello" << "c" << 3 ) ) ,
+                  _failing( BSON( "a" << 44 << "b" << "hello" << "c" << 3 ) ) {}
+            string name() const { return "matcher.Matcher.matches"; }
+            void timed( long long n ) {
+                long long x = 0;
+                for ( long long i = 0; i < n; i++ ) {
+                    x += _m.matches( _matching );
+                    x += _m.matches( _failing );
+                }
+                microbenchSink += x;
+            }
+        private:
+            Matcher _m;
+            BSONObj _matching, _failing;
+        };
+
+        /* --- bson builder ----------------------------------------------- */
+
+        // typical document assembly, including BufBuilder growth from empty
+        class BsonBuild : public Micro {
+        public:
+            BsonBuild() {
+                for ( int i = 0; i < 20; i++ ) {
+                    stringstream ss;
+                    ss << "field" << i;
+                    _names.push_back( ss.str() );
+                }
+            }
+            string name() const { return "bson.BSONObjBuilder.build20"; }
+            void timed( long long n ) {
+                long long x = 0;
+                for ( long long i = 0; i < n; i++ ) {
+                    BSONObjBuilder b;
+                    for ( unsigned j = 0; j < _names.size(); j++ )
+                        b.append( _names[j] , (int) j );
+                    x += b.obj().objsize();
+                }
+                microbenchSink += x;
+            }
+        private:
+            vector<string> _names;
+        };
+
+        // raw BufBuilder::grow/realloc path, isolated from bson overhead
+        class BufBuilderGrow : public Micro {
+        public:
+            BufBuilderGrow() { memset( _data , 7 , sizeof( _data ) ); }
+            string name() const { return "bson.BufBuilder.grow4k"; }
+            void timed( long long n ) {
+                long long x = 0;
+                for ( long long i = 0; i < n; i++ ) {
+                    BufBuilder b( 0 );
+                    for ( int j = 0; j < 128; j++ )
+                        b.appendBuf( _data , sizeof( _data ) );
+                    x += b.len();
+                }
+                microbenchSink += x;
+            }
+        private:
+            char _data[32];
+        };
+
+        /* --- dur -------------------------------------------------------- */
+
+        // PREPLOGBUFFER itself needs a running journal; AlignedBuilder is the
+        // buffer it assembles write intents into, and the append below is the
+        // loop body it spends its time in
+        class DurAlignedBuilderAppend : public Micro {
+        public:
+            DurAlignedBuilderAppend() : _b( 8 * 1024 * 1024 ) {
+                memset( _data , 7 , sizeof( _data ) );
+            }
+            string name() const { return "dur.AlignedBuilder.append256"; }
+            void timed( long long n ) {
+                long long x = 0;
+                for ( long long i = 0; i < n; i++ ) {
+                    if ( _b.len() > 4 * 1024 * 1024 )
+                        _b.reset();
+                    _b.appendBuf( _data , sizeof( _data ) );
+                    x += _b.len();
+                }
+                microbenchSink += x;
+            }
+        private:
+            AlignedBuilder _b;
+            char _data[256];
+        };
+
+        /* --- routing ---------------------------------------------------- */
+
+        // mongos findChunk = shard key extraction plus an upper_bound on a
+        // BSONObjCmp ordered map; a full ChunkManager needs a config server,
+        // so time the two pieces over synthetic chunk bounds instead
+        class FindChunkLookup : public Micro {
+        public:
+            FindChunkLookup() : _key( BSON( "uid" << 1 ) ) {
+                for ( int i = 0; i < 10000; i++ )
+                    _chunks[ BSON( "uid" << i * 1000 ) ] = i;
+                for ( int i = 0; i < 64; i++ )
+                    _docs.push_back( BSON( "uid" << ( i * 155557 ) % 10000000
+                                           << "name" << "someuser"
+                                           << "x" << 3.14 ) );
+            }
+            string name() const { return "routing.shardkey.findChunk"; }
+            void timed( long long n ) {
+                long long x = 0;
+                for ( long long i = 0; i < n; i++ ) {
+                    const BSONObj& doc = _docs[ i & 63 ];
+                    BSONObj k = _key.extractKey( doc );
+                    map<BSONObj,int,BSONObjCmp>::const_iterator it = _chunks.upper_bound( k );
+                    if ( it != _chunks.end() )
+                        x += it->second;
+                }
+                microbenchSink += x;
+            }
+        private:
+            ShardKeyPattern _key;
+            map<BSONObj,int,BSONObjCmp> _chunks;
+            vector<BSONObj> _docs;
+        };
+
+    } // namespace
+
+    int microbenchMain( int argc , char* argv[] ) {
+        const char * filter = argc > 1 ? argv[1] : 0;
+
+        Micro * micros[] = {
+            new KeyV1Compare() ,
+            new KeyV1Construct() ,
+            new MatcherMatches() ,
+            new BsonBuild() ,
+            new BufBuilderGrow() ,
+            new DurAlignedBuilderAppend() ,
+            new FindChunkLookup() ,
+            0
+        };
+
+        for ( int i = 0; micros[i]; i++ ) {
+            if ( ! filter || micros[i]->name().find( filter ) != string::npos )
+                micros[i]->run();
+            delete micros[i];
+        }
+        return 0;
+    }
+
+} // namespace mongo
+
+int main( int argc , char* argv[] ) {
+    return mongo::microbenchMain( argc , argv );
+}
@@ -1331,12 +1331,27 @@ namespace QueryTests {
 
 
                 {
-                    // TODO: this is temporary SERVER-2104
+                    // SERVER-2104 dotted fields are covered when the key has the exact path
                     Projection m;
                     m.init( BSON( "x.a" << 1 << "_id" << 0 ) );
 
                     scoped_ptr<Projection::KeyOnly> x( m.checkKey( BSON( "a" << 1 << "x.a" << 1 ) ) );
-                    ASSERT( ! x );
+                    ASSERT( x );
+
+                    ASSERT_EQUALS( BSON( "x" << BSON( "a" << 7 ) ) ,
+                                   x->hydrate( BSON( "" << 5 << "" << 7 ) ) );
+                }
+
+                {
+                    // dotted fields sharing a prefix land in one subobject
+                    Projection m;
+                    m.init( BSON( "x.a" << 1 << "x.b" << 1 << "_id" << 0 ) );
+
+                    scoped_ptr<Projection::KeyOnly> x( m.checkKey( BSON( "x.a" << 1 << "x.b" << 1 ) ) );
+                    ASSERT( x );
+
+                    ASSERT_EQUALS( BSON( "x" << BSON( "a" << 5 << "b" << 7 ) ) ,
+                                   x->hydrate( BSON( "" << 5 << "" << 7 ) ) );
                 }
 
             }
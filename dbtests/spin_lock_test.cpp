@@ -92,11 +92,15 @@ namespace {
             }
       
             int ms = timer.millis();
-            log() << "spinlock ConcurrentIncs time: " << ms << endl;
-            
+            log() << "spinlock ConcurrentIncs time: " << ms
+                  << " contentions: " << spin.contentions()
+                  << " parks: " << spin.parks() << endl;
+
             ASSERT_EQUALS( counter, threads*incs );
 #if defined(__linux__)
             ASSERT( SpinLock::isfast() );
+            // 64 threads hammering one lock must have hit the slow path
+            ASSERT( spin.contentions() > 0 );
 #endif
 
         }
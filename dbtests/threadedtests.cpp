@@ -21,6 +21,7 @@
 #include "../bson/util/atomic_int.h"
 #include "../util/concurrency/mvar.h"
 #include "../util/concurrency/thread_pool.h"
+#include "../util/concurrency/batch_rwlock.h"
 #include "../util/concurrency/list.h"
 #include "../util/timer.h"
 #include <boost/thread.hpp>
@@ -218,6 +219,16 @@ namespace ThreadedTests {
             tp.join();
 
             ASSERT(counter == (unsigned)(iterations * 2));
+
+            // elastic pool + priorities: everything scheduled must still run
+            counter.zero();
+            ThreadPool elastic(2, nThreads);
+            for (int i=0; i < iterations; i++) {
+                elastic.schedulePriority(i % 3 ? ThreadPool::PRIORITY_NORMAL : ThreadPool::PRIORITY_HIGH,
+                                         boost::bind(&ThreadPoolTest::increment, this, 2));
+            }
+            elastic.join();
+            ASSERT(counter == (unsigned)(iterations * 2));
         }
     };
 
@@ -398,7 +409,62 @@ namespace ThreadedTests {
 
             assert( x1 == 2 );
             t1.join();
-#endif            
+#endif
+        }
+    };
+
+    class BatchRWLockTest {
+        BatchRWLock _lk;
+        AtomicUInt _readersIn;
+        AtomicUInt _writersIn;
+        int _data; // written under the write lock only
+    public:
+        BatchRWLockTest() : _lk( "batchtest" ) , _data(0) { }
+
+        void reader( int n ) {
+            for ( int i=0; i<n; i++ ) {
+                _lk.lock_shared();
+                _readersIn++;
+                assert( _writersIn == 0 );
+                _readersIn--;
+                _lk.unlock_shared();
+            }
+        }
+
+        void writer( int n ) {
+            for ( int i=0; i<n; i++ ) {
+                _lk.lock();
+                _writersIn++;
+                assert( _writersIn == 1 && _readersIn == 0 );
+                _data++;
+                _writersIn--;
+                _lk.unlock();
+            }
+        }
+
+        void run() {
+            const int nReaders = 8;
+            const int nWriters = 2;
+            const int iterations = 10000;
+
+            vector< shared_ptr<boost::thread> > threads;
+            for ( int i=0; i<nReaders; i++ )
+                threads.push_back( shared_ptr<boost::thread>(
+                    new boost::thread( boost::bind( &BatchRWLockTest::reader , this , iterations ) ) ) );
+            for ( int i=0; i<nWriters; i++ )
+                threads.push_back( shared_ptr<boost::thread>(
+                    new boost::thread( boost::bind( &BatchRWLockTest::writer , this , iterations ) ) ) );
+            for ( unsigned i=0; i<threads.size(); i++ )
+                threads[i]->join();
+
+            ASSERT_EQUALS( _data , nWriters * iterations );
+
+            // try paths
+            ASSERT( _lk.lock_try(0) );
+            _lk.unlock();
+            ASSERT( _lk.lock_shared_try(0) );
+            ASSERT( ! _lk.lock_try(0) ); // we hold it shared
+            _lk.unlock_shared();
         }
     };
 
@@ -601,6 +667,7 @@ namespace ThreadedTests {
             //add< RWLockTest2 >(); // SERVER-2996
             add< RWLockTest3 >();
             add< RWLockTest4 >();
+            add< BatchRWLockTest >();
 
             add< MongoMutexTest >();
         }
@@ -183,6 +183,18 @@ namespace UpdateTests {
         }
     };
 
+    class SetSameWidthDifferentType : public SetBase {
+    public:
+        void run() {
+            // same width but different type - applied in place with a type rewrite
+            client().insert( ns(), BSON( "a" << 100LL ) );
+            client().update( ns(), Query(), BSON( "$set" << BSON( "a" << 5.5 ) ) );
+            BSONObj o = client().findOne( ns(), BSONObj() );
+            ASSERT_EQUALS( NumberDouble, o["a"].type() );
+            ASSERT_EQUALS( 5.5, o["a"].numberDouble() );
+        }
+    };
+
     class ModDotted : public SetBase {
     public:
         void run() {
@@ -766,6 +778,32 @@ namespace UpdateTests {
             }
         };
 
+        class inc7 : public Base {
+            // $inc with a double promotes a long field to a double, in place
+            const char * ns() {
+                return "unittests.inc7";
+            }
+            void dotest() {
+                client().insert( ns() , BSON( "x" << 5LL ) );
+                update( BSON( "$inc" << BSON( "x" << 1.5 ) ) );
+                ASSERT( findOne()["x"].type() == NumberDouble );
+                ASSERT_EQUALS( 6.5 , findOne()["x"].numberDouble() );
+            }
+        };
+
+        class inc8 : public Base {
+            // decrementing an int below int min widens to a long
+            const char * ns() {
+                return "unittests.inc8";
+            }
+            void dotest() {
+                client().insert( ns() , BSON( "x" << numeric_limits<int>::min() ) );
+                update( BSON( "$inc" << BSON( "x" << -5 ) ) );
+                ASSERT( findOne()["x"].type() == NumberLong );
+                ASSERT_EQUALS( numeric_limits<int>::min() - 5ll , findOne()["x"].numberLong() );
+            }
+        };
+
         class bit1 : public Base {
             const char * ns() {
                 return "unittests.bit1";
@@ -820,6 +858,7 @@ namespace UpdateTests {
             add< SetStringDifferentLength >();
             add< SetStringToNum >();
             add< SetStringToNumInPlace >();
+            add< SetSameWidthDifferentType >();
             add< ModDotted >();
             add< SetInPlaceDotted >();
             add< SetRecreateDotted >();
@@ -867,6 +906,8 @@ namespace UpdateTests {
             add< basic::inc4 >();
             add< basic::inc5 >();
             add< basic::inc6 >();
+            add< basic::inc7 >();
+            add< basic::inc8 >();
             add< basic::bit1 >();
             add< basic::unset >();
             add< basic::setswitchint >();
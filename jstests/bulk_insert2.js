@@ -0,0 +1,49 @@
+// Tests bulk inserts where the documents already carry an _id, which the
+// server handles on its batched insert path.
+
+var t = db.bulkInsertTest2
+t.drop()
+
+var bulk = []
+for( var i = 0; i < 1000; i++ ){
+    bulk.push({ _id : i, x : i, arr : [ i, i + 1 ] })
+}
+t.insert( bulk )
+assert.isnull( db.getLastError(), "A" )
+assert.eq( 1000, t.count(), "B" )
+assert.eq( 17, t.findOne({ _id : 17 }).x, "C" )
+
+// multikey index state must be right after a batched insert
+t.ensureIndex({ arr : 1 })
+assert.eq( 1, t.find({ arr : 500 }).itcount(), "D1" )
+bulk = []
+for( var i = 1000; i < 1100; i++ ){
+    bulk.push({ _id : i, x : i, arr : [ i, i + 1 ] })
+}
+t.insert( bulk )
+assert.isnull( db.getLastError(), "D2" )
+assert.eq( 2, t.find({ arr : 1000 }).itcount(), "D3" )
+
+// a duplicate _id mid-batch stops the batch there, and the documents before
+// it stay inserted
+bulk = []
+for( var i = 2000; i < 2010; i++ ){
+    bulk.push({ _id : i, x : i })
+}
+bulk[5]._id = 0 // dup of the very first document
+t.insert( bulk )
+assert( /E11000/.test( db.getLastError() ), "E1" )
+assert.eq( 5, t.find({ _id : { $gte : 2000 } }).itcount(), "E2" )
+
+// same through a secondary unique index
+t.ensureIndex({ x : 1 }, { unique : true })
+bulk = [ { _id : 3000, x : 3000 }, { _id : 3001, x : 17 }, { _id : 3002, x : 3002 } ]
+t.insert( bulk )
+assert( /E11000/.test( db.getLastError() ), "F1" )
+assert.eq( 1, t.find({ _id : { $gte : 3000 } }).itcount(), "F2" )
+
+// duplicates within one batch are also caught
+bulk = [ { _id : 4000, x : 4000 }, { _id : 4001, x : 4000 } ]
+t.insert( bulk )
+assert( db.getLastError() != null, "G1" )
+assert.eq( 1, t.find({ _id : { $gte : 4000 } }).itcount(), "G2" )
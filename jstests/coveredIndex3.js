@@ -0,0 +1,25 @@
+// covered queries with dotted projection fields (SERVER-2104)
+
+t = db["jstests_coveredIndex3"];
+t.drop();
+
+t.save({fn: "john", obj: {a: 1, b: "x"}})
+t.save({fn: "jack", obj: {a: 2, b: "y"}})
+t.save({fn: "bob", obj: {a: 3, b: "z"}})
+
+t.ensureIndex({"obj.a": 1, "obj.b": 1});
+
+// exact dotted paths are covered and hydrate back into subobjects
+assert.eq( t.find({"obj.a": 2}, {"obj.a": 1, _id: 0}).explain().indexOnly, true, "dotted find is not using covered index");
+assert.eq( t.findOne({"obj.a": 2}, {"obj.a": 1, _id: 0}), {obj: {a: 2}}, "dotted covered result is wrong");
+assert.eq( t.find({"obj.a": 2}, {"obj.a": 1, "obj.b": 1, _id: 0}).explain().indexOnly, true, "shared prefix find is not using covered index");
+assert.eq( t.findOne({"obj.a": 2}, {"obj.a": 1, "obj.b": 1, _id: 0}), {obj: {a: 2, b: "y"}}, "shared prefix covered result is wrong");
+
+// asking for the whole subobject still needs the document
+assert.eq( t.find({"obj.a": 2}, {obj: 1, _id: 0}).explain().indexOnly, false, "shouldnt cover whole subobject from dotted keys");
+
+// multikey indexes are never covered
+t.save({fn: "arr", obj: [{a: 4}, {a: 5}]})
+assert.eq( t.find({"obj.a": 4}, {"obj.a": 1, _id: 0}).explain().indexOnly, false, "multikey index shouldnt be covered");
+
+assert(t.validate().valid);
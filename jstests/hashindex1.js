@@ -0,0 +1,42 @@
+// basic tests for the hashed index type
+
+t = db.hashindex1;
+t.drop();
+
+t.ensureIndex({a: "hashed"});
+assert.eq( db.getLastError(), null, "could not create hashed index");
+
+for (i = 0; i < 100; i++)
+    t.save({_id: i, a: i, b: i % 10});
+t.save({_id: 100, a: "str"});
+t.save({_id: 101});
+
+// equality lookups use the hashed index and return exact matches
+assert.eq( t.find({a: 7}).explain().cursor, "HashedCursor", "equality not using hashed index");
+assert.eq( t.findOne({a: 7})._id, 7, "wrong doc from hashed lookup");
+assert.eq( t.find({a: "str"}).itcount(), 1, "string lookup failed");
+
+// numeric types bridge like regular equality
+assert.eq( t.find({a: NumberLong(7)}).itcount(), 1, "NumberLong lookup failed");
+assert.eq( t.find({a: 7.0}).itcount(), 1, "double lookup failed");
+
+// missing values are indexed as null
+assert.eq( t.find({a: null}).sort({_id: 1}).toArray()[0]._id, 101, "missing not found via null");
+
+// ranges and sorts can't use the hash
+assert.neq( t.find({a: {$gt: 3}}).explain().cursor, "HashedCursor", "range should not use hashed index");
+assert.neq( t.find().sort({a: 1}).explain().cursor, "HashedCursor", "sort should not use hashed index");
+assert.eq( t.find({a: {$gt: 3}, b: 4}).itcount(), 10, "range results wrong");
+
+// array values are not supported
+t.save({a: [1, 2]});
+assert( db.getLastError(), "array value should fail to index");
+
+// neither are unique hashed indexes
+t.dropIndexes();
+t.ensureIndex({a: "hashed"}, {unique: true});
+assert( db.getLastError(), "unique hashed index should be refused");
+
+// or compound ones for now
+t.ensureIndex({a: "hashed", b: 1});
+assert( db.getLastError(), "compound hashed index should be refused");
@@ -39,66 +39,95 @@ namespace mongo {
     Balancer::~Balancer() {
     }
 
-    int Balancer::_moveChunks( const vector<CandidateChunkPtr>* candidateChunks ) {
-        int movedCount = 0;
+    bool Balancer::_moveChunk( const CandidateChunkPtr& chunkInfoPtr ) {
+        const CandidateChunk& chunkInfo = *chunkInfoPtr.get();
 
-        for ( vector<CandidateChunkPtr>::const_iterator it = candidateChunks->begin(); it != candidateChunks->end(); ++it ) {
-            const CandidateChunk& chunkInfo = *it->get();
+        DBConfigPtr cfg = grid.getDBConfig( chunkInfo.ns );
+        assert( cfg );
 
-            DBConfigPtr cfg = grid.getDBConfig( chunkInfo.ns );
-            assert( cfg );
+        ChunkManagerPtr cm = cfg->getChunkManager( chunkInfo.ns );
+        assert( cm );
 
-            ChunkManagerPtr cm = cfg->getChunkManager( chunkInfo.ns );
+        const BSONObj& chunkToMove = chunkInfo.chunk;
+        ChunkPtr c = cm->findChunk( chunkToMove["min"].Obj() );
+        if ( c->getMin().woCompare( chunkToMove["min"].Obj() ) || c->getMax().woCompare( chunkToMove["max"].Obj() ) ) {
+            // likely a split happened somewhere
+            cm = cfg->getChunkManager( chunkInfo.ns , true /* reload */);
             assert( cm );
 
-            const BSONObj& chunkToMove = chunkInfo.chunk;
-            ChunkPtr c = cm->findChunk( chunkToMove["min"].Obj() );
+            c = cm->findChunk( chunkToMove["min"].Obj() );
             if ( c->getMin().woCompare( chunkToMove["min"].Obj() ) || c->getMax().woCompare( chunkToMove["max"].Obj() ) ) {
-                // likely a split happened somewhere
-                cm = cfg->getChunkManager( chunkInfo.ns , true /* reload */);
-                assert( cm );
-
-                c = cm->findChunk( chunkToMove["min"].Obj() );
-                if ( c->getMin().woCompare( chunkToMove["min"].Obj() ) || c->getMax().woCompare( chunkToMove["max"].Obj() ) ) {
-                    log() << "chunk mismatch after reload, ignoring will retry issue cm: "
-                          << c->getMin() << " min: " << chunkToMove["min"].Obj() << endl;
-                    continue;
-                }
+                log() << "chunk mismatch after reload, ignoring will retry issue cm: "
+                      << c->getMin() << " min: " << chunkToMove["min"].Obj() << endl;
+                return false;
             }
+        }
 
-            BSONObj res;
-            if ( c->moveAndCommit( Shard::make( chunkInfo.to ) , Chunk::MaxChunkSize , res ) ) {
-                movedCount++;
-                continue;
-            }
+        BSONObj res;
+        if ( c->moveAndCommit( Shard::make( chunkInfo.to ) , Chunk::MaxChunkSize , res ) ) {
+            return true;
+        }
 
-            // the move requires acquiring the collection metadata's lock, which can fail
-            log() << "balancer move failed: " << res << " from: " << chunkInfo.from << " to: " << chunkInfo.to
-                  << " chunk: " << chunkToMove << endl;
+        // the move requires acquiring the collection metadata's lock, which can fail
+        log() << "balancer move failed: " << res << " from: " << chunkInfo.from << " to: " << chunkInfo.to
+              << " chunk: " << chunkToMove << endl;
 
-            if ( res["chunkTooBig"].trueValue() ) {
-                // reload just to be safe
-                cm = cfg->getChunkManager( chunkInfo.ns );
-                assert( cm );
-                c = cm->findChunk( chunkToMove["min"].Obj() );
-                
-                log() << "forcing a split because migrate failed for size reasons" << endl;
-                
-                res = BSONObj();
-                c->singleSplit( true , res );
-                log() << "forced split results: " << res << endl;
-                
-                if ( ! res["ok"].trueValue() ) {
-                    log() << "marking chunk as jumbo: " << c->toString() << endl;
-                    c->markAsJumbo();
-                    // we increment moveCount so we do another round right away
-                    movedCount++;
-                }
+        if ( res["chunkTooBig"].trueValue() ) {
+            // reload just to be safe
+            cm = cfg->getChunkManager( chunkInfo.ns );
+            assert( cm );
+            c = cm->findChunk( chunkToMove["min"].Obj() );
+
+            log() << "forcing a split because migrate failed for size reasons" << endl;
 
+            res = BSONObj();
+            c->singleSplit( true , res );
+            log() << "forced split results: " << res << endl;
+
+            if ( ! res["ok"].trueValue() ) {
+                log() << "marking chunk as jumbo: " << c->toString() << endl;
+                c->markAsJumbo();
+                // we count this as a move so we do another round right away
+                return true;
             }
+
+        }
+
+        return false;
+    }
+
+    void Balancer::_moveChunkInThread( CandidateChunkPtr chunkInfo , AtomicUInt* movedCount ) {
+        // an exception escaping a boost::thread would terminate the process, so contain it here
+        try {
+            if ( _moveChunk( chunkInfo ) )
+                (*movedCount)++;
+        }
+        catch ( std::exception& e ) {
+            log() << "balancer move " << chunkInfo->chunk << " to " << chunkInfo->to
+                  << " threw exception: " << e.what() << endl;
         }
+        catch ( ... ) {
+            log() << "balancer move " << chunkInfo->chunk << " to " << chunkInfo->to
+                  << " threw unknown exception" << endl;
+        }
+    }
 
-        return movedCount;
+    int Balancer::_moveChunks( const vector<CandidateChunkPtr>* candidateChunks ) {
+        // the policy guarantees each shard is part of at most one candidate migration, so
+        // the whole batch can be issued concurrently, one thread per migration
+        AtomicUInt movedCount;
+
+        vector< shared_ptr<boost::thread> > migrateThreads;
+        for ( vector<CandidateChunkPtr>::const_iterator it = candidateChunks->begin(); it != candidateChunks->end(); ++it ) {
+            migrateThreads.push_back( shared_ptr<boost::thread>(
+                    new boost::thread( boost::bind( &Balancer::_moveChunkInThread , this , *it , &movedCount ) ) ) );
+        }
+
+        for ( vector< shared_ptr<boost::thread> >::iterator it = migrateThreads.begin(); it != migrateThreads.end(); ++it ) {
+            (*it)->join();
+        }
+
+        return (int) movedCount;
     }
 
     void Balancer::_ping( DBClientBase& conn ) {
@@ -185,10 +214,23 @@ namespace mongo {
             const Shard& s = *it;
             ShardStatus status = s.getStatus();
 
+            // per collection op rates for load-aware balancing.  a shard
+            // without the command just balances on chunk counts as before.
+            BSONObj nsLoad;
+            try {
+                BSONObj res = s.runCommand( "admin" , "_shardLoadStats" );
+                if ( res["ns"].isABSONObj() )
+                    nsLoad = res["ns"].Obj().getOwned();
+            }
+            catch ( DBException& e ) {
+                LOG(1) << "could not get load stats from " << s.getName() << causedBy( e ) << endl;
+            }
+
             BSONObj limitsObj = BSON( ShardFields::maxSize( s.getMaxSize() ) <<
                                       LimitsFields::currSize( status.mapped() ) <<
                                       ShardFields::draining( s.isDraining() )  <<
-                                      LimitsFields::hasOpsQueued( status.hasOpsQueued() )
+                                      LimitsFields::hasOpsQueued( status.hasOpsQueued() ) <<
+                                      LimitsFields::nsLoad( nsLoad )
                                     );
 
             shardLimitsMap[ s.getName() ] = limitsObj;
@@ -198,6 +240,10 @@ namespace mongo {
         // 3. For each collection, check if the balancing policy recommends moving anything around.
         //
 
+        // each shard takes part in at most one migration per round, across all collections, so
+        // the candidate moves are pairwise disjoint and can be issued concurrently
+        set<string> usedShards;
+
         for (vector<string>::const_iterator it = collections.begin(); it != collections.end(); ++it ) {
             const string& ns = *it;
 
@@ -223,8 +269,10 @@ namespace mongo {
                 shardToChunksMap[s.getName()].size();
             }
 
-            CandidateChunk* p = _policy->balance( ns , shardLimitsMap , shardToChunksMap , _balancedLastTime );
-            if ( p ) candidateChunks->push_back( CandidateChunkPtr( p ) );
+            vector<CandidateChunk*> moves;
+            _policy->balance( ns , shardLimitsMap , shardToChunksMap , _balancedLastTime , usedShards , moves );
+            for ( vector<CandidateChunk*>::const_iterator j = moves.begin(); j != moves.end(); ++j )
+                candidateChunks->push_back( CandidateChunkPtr( *j ) );
         }
     }
 
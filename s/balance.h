@@ -31,8 +31,8 @@ namespace mongo {
      * uses a 'DistributedLock' for that coordination.
      *
      * The balancer does act continuously but in "rounds". At a given round, it would decide if there is an imbalance by
-     * checking the difference in chunks between the most and least loaded shards. It would issue a request for a chunk
-     * migration per round, if it found so.
+     * checking the difference in chunks between the most and least loaded shards. It issues the migrations the policy
+     * suggested for the round concurrently; the policy guarantees they involve pairwise disjoint shards.
      */
     class Balancer : public BackgroundJob {
     public:
@@ -80,13 +80,25 @@ namespace mongo {
         void _doBalanceRound( DBClientBase& conn, vector<CandidateChunkPtr>* candidateChunks );
 
         /**
-         * Issues chunk migration request, one at a time.
+         * Issues all the chunk migration requests concurrently, one thread each; safe because the
+         * policy never puts a shard in more than one migration of a batch.
          *
          * @param candidateChunks possible chunks to move
          * @return number of chunks effectively moved
          */
         int _moveChunks( const vector<CandidateChunkPtr>* candidateChunks );
 
+        /**
+         * Issues a single chunk migration request and waits for it.
+         *
+         * @param chunkInfo the chunk to move and where to
+         * @return true if the chunk was effectively moved
+         */
+        bool _moveChunk( const CandidateChunkPtr& chunkInfo );
+
+        /** thread body wrapping _moveChunk: bumps '*movedCount' on success, swallows exceptions */
+        void _moveChunkInThread( CandidateChunkPtr chunkInfo , AtomicUInt* movedCount );
+
         /**
          * Marks this balancer as being live on the config server(s).
          *
@@ -31,21 +31,57 @@ namespace mongo {
     // limits map fields
     BSONField<long long> LimitsFields::currSize( "currSize" );
     BSONField<bool> LimitsFields::hasOpsQueued( "hasOpsQueued" );
+    BSONField<BSONObj> LimitsFields::nsLoad( "nsLoad" );
 
-    BalancerPolicy::ChunkInfo* BalancerPolicy::balance( const string& ns,
+    // load-based moves need real traffic and a clear skew before kicking in,
+    // so an idle or evenly loaded cluster never shuffles chunks over noise
+    static const double minOpsPerSecToLoadBalance = 50;
+
+    void BalancerPolicy::balance( const string& ns,
             const ShardToLimitsMap& shardToLimitsMap,
             const ShardToChunksMap& shardToChunksMap,
-            int balancedLastTime ) {
+            int balancedLastTime,
+            set<string>& usedShards,
+            vector<ChunkInfo*>& moves ) {
+        // keep picking migrations until no eligible donor/receiver pair is left; the
+        // shards of each pick are marked used so the batch stays pairwise disjoint
+        while ( true ) {
+            ChunkInfo* p = _singleBalance( ns , shardToLimitsMap , shardToChunksMap , balancedLastTime , usedShards );
+            if ( p == NULL )
+                break;
+
+            usedShards.insert( p->from );
+            usedShards.insert( p->to );
+            moves.push_back( p );
+        }
+    }
+
+    BalancerPolicy::ChunkInfo* BalancerPolicy::_singleBalance( const string& ns,
+            const ShardToLimitsMap& shardToLimitsMap,
+            const ShardToChunksMap& shardToChunksMap,
+            int balancedLastTime,
+            const set<string>& usedShards ) {
         pair<string,unsigned> min("",numeric_limits<unsigned>::max());
         pair<string,unsigned> max("",0);
         vector<string> drainingShards;
 
+        // this collection's op rate extremes, for load-based moves when the
+        // chunk counts themselves look even
+        pair<string,double> minLoad( "" , 0 );
+        pair<string,double> maxLoad( "" , 0 );
+        unsigned minLoadChunks = 0;
+        unsigned maxLoadChunks = 0;
+
         bool maxOpsQueued = false;
 
         for (ShardToChunksIter i = shardToChunksMap.begin(); i!=shardToChunksMap.end(); ++i ) {
 
             // Find whether this shard's capacity or availability are exhausted
             const string& shard = i->first;
+
+            // a shard already migrating this round can't be donor or receiver again
+            if ( usedShards.count( shard ) > 0 )
+                continue;
             BSONObj shardLimits;
             ShardToLimitsIter it = shardToLimitsMap.find( shard );
             if ( it != shardToLimitsMap.end() ) shardLimits = it->second;
@@ -60,10 +96,21 @@ namespace mongo {
             // + draining shards
             // + shards with operations queued for writeback
             const unsigned size = i->second.size();
+
+            // this collection's op rate on this shard, if the shard reports it
+            double load = 0;
+            BSONElement le = shardLimits[ LimitsFields::nsLoad.name() ];
+            if ( le.isABSONObj() )
+                load = le.Obj()[ ns ].numberDouble();
+
             if ( ! maxedOut && ! draining && ! opsQueued ) {
                 if ( size < min.second ) {
                     min = make_pair( shard , size );
                 }
+                if ( minLoad.first.empty() || load < minLoad.second ) {
+                    minLoad = make_pair( shard , load );
+                    minLoadChunks = size;
+                }
             }
             else if ( opsQueued ) {
                 LOG(1) << "won't send a chunk to: " << shard << " because it has ops queued" << endl;
@@ -79,15 +126,20 @@ namespace mongo {
                 max = make_pair( shard , size );
                 maxOpsQueued = opsQueued;
             }
+            if ( ! opsQueued && ! draining && size > 0 && load > maxLoad.second ) {
+                maxLoad = make_pair( shard , load );
+                maxLoadChunks = size;
+            }
             if ( draining && (size > 0)) {
                 drainingShards.push_back( shard );
             }
         }
 
         // If there is no candidate chunk receiver -- they may have all been maxed out,
-        // draining, ... -- there's not much that the policy can do.
+        // draining, picked already this round, ... -- there's not much that the policy can do.
         if ( min.second == numeric_limits<unsigned>::max() ) {
-            log() << "no available shards to take chunks" << endl;
+            if ( usedShards.empty() )
+                log() << "no available shards to take chunks" << endl;
             return NULL;
         }
 
@@ -106,7 +158,8 @@ namespace mongo {
         }
 
         // Solving imbalances takes a higher priority than draining shards. Many shards can
-        // be draining at once but we choose only one of them to cater to per round.
+        // be draining at once but we choose only one of them to cater to per migration;
+        // the batch loop in balance() may pick several in one round.
         // Important to start balanced, so when there are few chunks any imbalance must be fixed.
         const int imbalance = max.second - min.second;
         int threshold = 8;
@@ -123,6 +176,23 @@ namespace mongo {
             to = min.first;
 
         }
+        else if ( ! maxLoad.first.empty() && ! minLoad.first.empty() &&
+                  maxLoad.first != minLoad.first &&
+                  maxLoad.second >= minOpsPerSecToLoadBalance &&
+                  maxLoad.second > 4 * ( minLoad.second + 1 ) &&
+                  maxLoadChunks > minLoadChunks ) {
+            // Chunk counts look even but the op load isn't: a hot collection
+            // can pin one shard while space balancing sees nothing to do, so
+            // move one of its chunks toward the coolest shard.  Requiring the
+            // donor to hold more chunks than the receiver keeps the count
+            // imbalance inside the threshold so the next round won't bounce
+            // the chunk straight back.
+            from = maxLoad.first;
+            to = minLoad.first;
+            log() << "chunks for " << ns << " are even but load is not: "
+                  << maxLoad.second << " ops/s on " << from << " vs "
+                  << minLoad.second << " ops/s on " << to << endl;
+        }
         else {
             // Everything is balanced here!
             return NULL;
@@ -28,9 +28,10 @@ namespace mongo {
         struct ChunkInfo;
 
         /**
-         * Returns a suggested chunk to move whithin a collection's shards, given information about
-         * space usage and number of chunks for that collection. If the policy doesn't recommend
-         * moving, it returns NULL.
+         * Appends to 'moves' a conflict-free batch of suggested chunk migrations whithin a
+         * collection's shards, given information about space usage and number of chunks for
+         * that collection.  Each shard appears in at most one suggested migration - as donor
+         * or as receiver - so all the moves of a batch can be issued concurrently.
          *
          * @param ns is the collections namepace.
          * @param shardLimitMap is a map from shardId to an object that describes (for now) space
@@ -38,12 +39,16 @@ namespace mongo {
          * @param shardToChunksMap is a map from shardId to chunks that live there. A chunk's format
          * is { }.
          * @param balancedLastTime is the number of chunks effectively moved in the last round.
-         * @returns NULL or ChunkInfo of the best move to make towards balacing the collection.
+         * @param usedShards (IN/OUT) shards already part of a migration this round; they won't be
+         * picked again, and the shards this call picks are added.  Shared across the collections
+         * of a round so the whole round stays conflict free.
+         * @param moves (OUT) the suggested migrations; caller owns the ChunkInfos.
          */
         typedef map< string,BSONObj > ShardToLimitsMap;
         typedef map< string,vector<BSONObj> > ShardToChunksMap;
-        static ChunkInfo* balance( const string& ns, const ShardToLimitsMap& shardToLimitsMap,
-                                   const ShardToChunksMap& shardToChunksMap, int balancedLastTime );
+        static void balance( const string& ns, const ShardToLimitsMap& shardToLimitsMap,
+                             const ShardToChunksMap& shardToChunksMap, int balancedLastTime,
+                             set<string>& usedShards, vector<ChunkInfo*>& moves );
 
         // below exposed for testing purposes only -- treat it as private --
 
@@ -72,6 +77,10 @@ namespace mongo {
         typedef ShardToChunksMap::const_iterator ShardToChunksIter;
         typedef ShardToLimitsMap::const_iterator ShardToLimitsIter;
 
+        /** one migration suggestion among the shards not in 'usedShards', or NULL */
+        static ChunkInfo* _singleBalance( const string& ns, const ShardToLimitsMap& shardToLimitsMap,
+                                          const ShardToChunksMap& shardToChunksMap, int balancedLastTime,
+                                          const set<string>& usedShards );
     };
 
     struct BalancerPolicy::ChunkInfo {
@@ -91,6 +100,8 @@ namespace mongo {
         // we use 'draining' and 'maxSize' from the 'shards' collection plus the following
         static BSONField<long long> currSize; // currently used disk space in bytes
         static BSONField<bool> hasOpsQueued;  // writeback queue is not empty?
+        static BSONField<BSONObj> nsLoad;     // collection -> ops/sec on that shard,
+                                              // from the _shardLoadStats command
     };
 
 }  // namespace mongo
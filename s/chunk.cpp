@@ -78,6 +78,13 @@ namespace mongo {
         : _manager(info), _min(min), _max(max), _shard(shard), _lastmod(0), _jumbo(false), _dataWritten(mkDataWritten())
     {}
 
+    Chunk::Chunk(const ChunkManager * info , const Chunk& other)
+        : _manager(info), _min(other._min), _max(other._max), _shard(other._shard),
+          _lastmod(other._lastmod), _jumbo(other._jumbo),
+          // carry the split heuristic along so a refresh doesn't reset it
+          _dataWritten(other._dataWritten)
+    {}
+
     long Chunk::mkDataWritten() {
         return rand() % ( MaxChunkSize / 5 );
     }
@@ -541,7 +548,7 @@ namespace mongo {
 
     AtomicUInt ChunkManager::NextSequenceNumber = 1;
 
-    ChunkManager::ChunkManager( string ns , ShardKeyPattern pattern , bool unique ) :
+    ChunkManager::ChunkManager( string ns , ShardKeyPattern pattern , bool unique , ChunkManagerPtr oldManager ) :
         _ns( ns ) , _key( pattern ) , _unique( unique ) , _chunkRanges(), _mutex("ChunkManager"),
         _nsLock( ConnectionString( configServer.modelServer() , ConnectionString::SYNC ) , ns ),
 
@@ -559,12 +566,27 @@ namespace mongo {
             set<Shard> shards;
             ShardVersionMap shardVersions;
             Timer t;
-            _load(chunkMap, shards, shardVersions);
+
+            bool incremental = false;
+            if ( oldManager && oldManager->getVersion().isSet() ) {
+                incremental = _loadIncremental(*oldManager, chunkMap, shards, shardVersions);
+                if ( ! incremental ) {
+                    // diff couldn't be applied (e.g. collection dropped and
+                    // resharded); start over with a full load
+                    chunkMap.clear();
+                    shards.clear();
+                    shardVersions.clear();
+                    _version = 0;
+                }
+            }
+            if ( ! incremental )
+                _load(chunkMap, shards, shardVersions);
             {
                 int ms = t.millis();
-                log() << "ChunkManager: time to load chunks for " << ns << ": " << ms << "ms" 
-                      << " sequenceNumber: " << _sequenceNumber 
-                      << " version: " << _version.toString() 
+                log() << "ChunkManager: time to load chunks for " << ns << ": " << ms << "ms"
+                      << " sequenceNumber: " << _sequenceNumber
+                      << " version: " << _version.toString()
+                      << ( incremental ? " (incremental)" : "" )
                       << endl;
             }
 
@@ -576,6 +598,7 @@ namespace mongo {
                 const_cast<set<Shard>&>(_shards).swap(shards);
                 const_cast<ShardVersionMap&>(_shardVersions).swap(shardVersions);
                 const_cast<ChunkRangeManager&>(_chunkRanges).reloadAll(_chunkMap);
+                _buildFlatIndex();
                 return;
             }
             
@@ -585,6 +608,10 @@ namespace mongo {
             
             warning() << "ChunkManager loaded an invalid config, trying again" << endl;
 
+            // don't trust a diff after producing an invalid map; retry full
+            oldManager.reset();
+            _version = 0;
+
             sleepmillis(10 * (3-tries));
         }
 
@@ -627,6 +654,75 @@ namespace mongo {
         conn.done();
     }
 
+    bool ChunkManager::_loadIncremental(const ChunkManager& old, ChunkMap& chunkMap, set<Shard>& shards, ShardVersionMap& shardVersions) {
+        if ( old._chunkMap.empty() )
+            return false;
+
+        // start from the predecessor's view.  its chunks are cloned rather than
+        // shared because each Chunk points back at its manager, which may be
+        // destroyed before we are.
+        for ( ChunkMap::const_iterator i = old._chunkMap.begin(); i != old._chunkMap.end(); ++i ) {
+            ChunkPtr c( new Chunk( this , *i->second ) );
+            chunkMap[c->getMax()] = c;
+        }
+        _version = old._version;
+
+        // only chunks split or moved since the old version, oldest first so a
+        // chunk changed twice in the window is applied in order
+        BSONObjBuilder q;
+        q.append( "ns" , _ns );
+        {
+            BSONObjBuilder gt( q.subobjStart( "lastmod" ) );
+            gt.appendTimestamp( "$gt" , old._version.toLong() );
+            gt.done();
+        }
+
+        int nDiff = 0;
+        ScopedDbConnection conn( configServer.modelServer() );
+        auto_ptr<DBClientCursor> cursor = conn->query( Chunk::chunkMetadataNS, Query( q.obj() ).sort( "lastmod" , 1 ) );
+        assert( cursor.get() );
+        while ( cursor->more() ) {
+            BSONObj d = cursor->next();
+            if ( d["isMaxMarker"].trueValue() ) {
+                continue;
+            }
+
+            ChunkPtr c( new Chunk( this , d ) );
+
+            // drop whatever the new chunk overlaps -- a split's parent, or the
+            // prior version of a moved chunk
+            ChunkMap::iterator i = chunkMap.upper_bound( c->getMin() );
+            while ( i != chunkMap.end() && i->second->getMin().woCompare( c->getMax() ) < 0 )
+                chunkMap.erase( i++ );
+
+            chunkMap[c->getMax()] = c;
+            nDiff++;
+
+            if ( c->getLastmod() > _version )
+                _version = c->getLastmod();
+        }
+        conn.done();
+
+        if ( nDiff == 0 ) {
+            // we were created because the version changed, yet nothing is newer
+            // than the old version -- it must have gone backwards (dropped and
+            // resharded collection)
+            return false;
+        }
+
+        // shard membership and per-shard max versions are rederived from the
+        // patched map so a fully drained shard drops out
+        for ( ChunkMap::const_iterator i = chunkMap.begin(); i != chunkMap.end(); ++i ) {
+            shards.insert( i->second->getShard() );
+            ShardChunkVersion& shardMax = shardVersions[i->second->getShard()];
+            if ( i->second->getLastmod() > shardMax )
+                shardMax = i->second->getLastmod();
+        }
+
+        LOG(1) << "ChunkManager: incremental refresh of " << _ns << " applied " << nDiff << " chunk diffs" << endl;
+        return true;
+    }
+
     bool ChunkManager::_isValid(const ChunkMap& chunkMap) {
 #define ENSURE(x) do { if(!(x)) { log() << "ChunkManager::_isValid failed: " #x << endl; return false; } } while(0)
 
@@ -725,6 +821,38 @@ namespace mongo {
 
     }
 
+    namespace {
+        // same ordering as ChunkMap's BSONObjCmp, in the shape upper_bound wants
+        struct FlatKeyLess {
+            bool operator()( const BSONObj& key , const ChunkManager::FlatEntry& e ) const {
+                return key.woCompare( e.max ) < 0;
+            }
+        };
+    }
+
+    void ChunkManager::_buildFlatIndex() {
+        // only called from the constructor, before this manager is published
+        vector<FlatEntry>& flat = const_cast< vector<FlatEntry>& >( _flat );
+        vector<char>& keyBuf = const_cast< vector<char>& >( _flatKeyBuf );
+        flat.clear();
+        flat.reserve( _chunkMap.size() );
+
+        unsigned keyBytes = 0;
+        for ( ChunkMap::const_iterator i = _chunkMap.begin(); i != _chunkMap.end(); ++i )
+            keyBytes += i->first.objsize();
+        keyBuf.resize( keyBytes );
+
+        char* p = keyBytes ? &keyBuf[0] : 0;
+        for ( ChunkMap::const_iterator i = _chunkMap.begin(); i != _chunkMap.end(); ++i ) {
+            memcpy( p , i->first.objdata() , i->first.objsize() );
+            FlatEntry e;
+            e.max = BSONObj( p );
+            e.chunk = i->second;
+            flat.push_back( e );
+            p += i->first.objsize();
+        }
+    }
+
     ChunkPtr ChunkManager::findChunk( const BSONObj & obj ) const {
         BSONObj key = _key.extractKey(obj);
 
@@ -732,10 +860,11 @@ namespace mongo {
             BSONObj foo;
             ChunkPtr c;
             {
-                ChunkMap::const_iterator it = _chunkMap.upper_bound(key);
-                if (it != _chunkMap.end()) {
-                    foo = it->first;
-                    c = it->second;
+                vector<FlatEntry>::const_iterator it =
+                    std::upper_bound( _flat.begin() , _flat.end() , key , FlatKeyLess() );
+                if ( it != _flat.end() ) {
+                    foo = it->max;
+                    c = it->chunk;
                 }
             }
 
@@ -757,6 +886,38 @@ namespace mongo {
         throw UserException( 8070 , str::stream() << "couldn't find a chunk which should be impossible: " << key );
     }
 
+    bool ChunkManager::mergeChunks( const BSONObj& min , const BSONObj& max , BSONObj& res ) const {
+        ChunkPtr first = findChunk( min );
+        uassert( 16309 , str::stream() << "no chunk starts at " << min , first->getMin().woCompare( min ) == 0 );
+
+        // the shard validates the whole run - contiguity, coverage up to 'max' and
+        // ownership - under the collection's distributed lock and commits the config
+        // update and its ShardChunkManager refresh there, just as splitChunk does
+        ScopedDbConnection conn( first->getShard().getConnString() );
+
+        BSONObjBuilder cmd;
+        cmd.append( "mergeChunks" , _ns );
+        cmd.append( "min" , min );
+        cmd.append( "max" , max );
+        cmd.append( "from" , first->getShard().getConnString() );
+        cmd.append( "configdb" , configServer.modelServer() );
+        BSONObj cmdObj = cmd.obj();
+
+        if ( ! conn->runCommand( "admin" , cmdObj , res ) ) {
+            warning() << "mergeChunks failed - cmd: " << cmdObj << " result: " << res << endl;
+            conn.done();
+            reload();
+            return false;
+        }
+
+        conn.done();
+
+        // force reload of config
+        reload();
+
+        return true;
+    }
+
     ChunkPtr ChunkManager::findChunkOnServer( const Shard& shard ) const {
         for ( ChunkMap::const_iterator i=_chunkMap.begin(); i!=_chunkMap.end(); ++i ) {
             ChunkPtr c = i->second;
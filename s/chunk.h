@@ -57,6 +57,10 @@ namespace mongo {
         Chunk( const ChunkManager * info , BSONObj from);
         Chunk( const ChunkManager * info , const BSONObj& min, const BSONObj& max, const Shard& shard);
 
+        /** used when a refreshed ChunkManager inherits an unchanged chunk from
+            its predecessor; each Chunk points back at its own manager */
+        Chunk( const ChunkManager * info , const Chunk& other );
+
         //
         // serialization support
         //
@@ -299,7 +303,21 @@ namespace mongo {
     public:
         typedef map<Shard,ShardChunkVersion> ShardVersionMap;
 
-        ChunkManager( string ns , ShardKeyPattern pattern , bool unique );
+        /** flat, binary-searchable copy of the chunk map used by findChunk.
+            the max keys live back to back in an arena, so a lookup searches
+            contiguous memory instead of chasing map nodes. */
+        struct FlatEntry {
+            BSONObj max; // view into the manager's key arena
+            ChunkPtr chunk;
+        };
+
+        /**
+         * @param oldManager if set, load differentially: start from its chunks
+         *        and fetch only those with lastmod greater than its version,
+         *        falling back to a full load when the diff can't be applied
+         */
+        ChunkManager( string ns , ShardKeyPattern pattern , bool unique ,
+                      ChunkManagerPtr oldManager = ChunkManagerPtr() );
 
         string getns() const { return _ns; }
 
@@ -310,6 +328,14 @@ namespace mongo {
         ChunkPtr findChunk( const BSONObj& obj ) const;
         ChunkPtr findChunkOnServer( const Shard& shard ) const;
 
+        /**
+         * Merges the contiguous run of chunks covering [min, max) - which must all live on
+         * one shard - into a single chunk, by delegating to the shard's mergeChunks command.
+         * @param res the command result from the shard, for error reporting
+         * @return true if the merge was committed
+         */
+        bool mergeChunks( const BSONObj& min , const BSONObj& max , BSONObj& res ) const;
+
         const ShardKeyPattern& getShardKey() const {  return _key; }
         bool isUnique() const { return _unique; }
 
@@ -317,7 +343,7 @@ namespace mongo {
         void getAllShards( set<Shard>& all ) const;
         void getShardsForRange(set<Shard>& shards, const BSONObj& min, const BSONObj& max, bool fullKeyReq = true) const; // [min, max)
 
-        ChunkMap getChunkMap() const { return _chunkMap; }
+        const ChunkMap& getChunkMap() const { return _chunkMap; }
 
         /**
          * Returns true if, for this shard, the chunks are identical in both chunk managers
@@ -354,6 +380,8 @@ namespace mongo {
 
         // helpers for constructor
         void _load(ChunkMap& chunks, set<Shard>& shards, ShardVersionMap& shardVersions);
+        bool _loadIncremental(const ChunkManager& old, ChunkMap& chunks, set<Shard>& shards, ShardVersionMap& shardVersions);
+        void _buildFlatIndex();
         static bool _isValid(const ChunkMap& chunks);
 
         // All members should be const for thread-safety
@@ -364,6 +392,9 @@ namespace mongo {
         const ChunkMap _chunkMap;
         const ChunkRangeManager _chunkRanges;
 
+        const vector<FlatEntry> _flat;
+        const vector<char> _flatKeyBuf; // arena backing _flat's max keys
+
         const set<Shard> _shards;
 
         const ShardVersionMap _shardVersions; // max version per shard
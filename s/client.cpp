@@ -32,16 +32,21 @@
 #include "stats.h"
 #include "cursors.h"
 #include "grid.h"
-#include "s/writeback_listener.h"
 
 namespace mongo {
 
     /* todo: rename this file clientinfo.cpp would be more intuitive? */
 
+    // how many writes a client may send without a getLastError before we go
+    // collect and replay any the shards rejected for a stale shard version
+    static const int maxUnsafeWritesBeforeHarvest = 100;
+
     ClientInfo::ClientInfo() {
         _cur = &_a;
         _prev = &_b;
+        _unsafeWritesPending = 0;
         _autoSplitOk = true;
+        _shardConnsPinned = false;
         newRequest();
     }
 
@@ -94,55 +99,150 @@ namespace mongo {
         _lastAccess = 0;
     }
 
-    void ClientInfo::_addWriteBack( vector<WBInfo>& all , const BSONObj& gle ) {
-        BSONElement w = gle["writeback"];
+    void ClientInfo::_addRejectedWrites( vector<BSONObj>& all , const BSONObj& gle ) {
+        BSONElement w = gle["rejectedWrites"];
 
-        if ( w.type() != jstOID )
+        if ( w.type() != Array )
             return;
 
-        BSONElement cid = gle["connectionId"];
-
-        if ( cid.eoo() ) {
-            error() << "getLastError writeback can't work because of version mismatch" << endl;
-            return;
-        }
-
-        string ident = "";
-        if ( gle["instanceIdent"].type() == String )
-            ident = gle["instanceIdent"].String();
-
-        all.push_back( WBInfo( WriteBackListener::ConnectionIdent( ident , cid.numberLong() ) , w.OID() ) );
+        BSONObjIterator i( w.Obj() );
+        while ( i.more() )
+            all.push_back( i.next().Obj().getOwned() );
     }
 
-    vector<BSONObj> ClientInfo::_handleWriteBacks( vector<WBInfo>& all , bool fromWriteBackListener ) {
+    vector<BSONObj> ClientInfo::_retryRejectedWrites( const vector<BSONObj>& all , bool fromRetry ) {
         vector<BSONObj> res;
 
         if ( all.size() == 0 )
             return res;
-        
-        if ( fromWriteBackListener ) {
-            LOG(1) << "not doing recursive writeback" << endl;
+
+        if ( fromRetry ) {
+            LOG(1) << "not retrying rejected writes recursively" << endl;
             return res;
         }
-        
+
+        bool autoSplitWas = _autoSplitOk;
+        _autoSplitOk = false; // the replays below shouldn't trigger splits
+
         for ( unsigned i=0; i<all.size(); i++ ) {
-            res.push_back( WriteBackListener::waitFor( all[i].ident , all[i].id ) );
+            const BSONObj& data = all[i];
+
+            string ns = data["ns"].valuestrsafe();
+
+            int len; // not used, but needed for next call
+            Message m( (void*)data["msg"].binData( len ) , false );
+            massert( 10427 ,  "invalid rejected write message" , m.header()->valid() );
+
+            DBConfigPtr db = grid.getDBConfig( ns );
+            ShardChunkVersion needVersion( data["version"] );
+
+            ChunkManagerPtr manager = db->getChunkManagerIfExists( ns );
+
+            LOG(1) << "retrying write rejected for stale config, ns: " << ns
+                   << " needVersion : " << needVersion.toString()
+                   << " mine : " << ( manager ? manager->getVersion().toString() : "(unknown)" ) << endl;
+            LOG(1) << m.toString() << endl;
+
+            if ( needVersion.isSet() && manager && needVersion <= manager->getVersion() ) {
+                // the write went out with an old version but we've refreshed
+                // past the version the shard wants already; just resend
+            }
+            else {
+                // reload the chunk manager and get the new shard versions
+                manager = db->getChunkManager( ns , true );
+            }
+
+            // do request and then call getLastError
+            // we have to call getLastError so we can return the right fields to the user if they decide to call getLastError
+
+            BSONObj gle;
+            int attempts = 0;
+            while ( true ) {
+                attempts++;
+
+                try {
+                    Request r( m , 0 );
+                    r.init();
+
+                    r.d().reservedField() |= DbMessage::Reserved_FromWriteback;
+
+                    r.process();
+
+                    newRequest(); // this so we flip prev and cur shards
+
+                    BSONObjBuilder b;
+                    if ( ! getLastError( BSON( "getLastError" << 1 ) , b , true /* fromRetry */ ) ) {
+                        b.appendBool( "commandFailed" , true );
+                    }
+                    gle = b.obj();
+
+                    if ( gle["code"].numberInt() == 9517 ) {
+                        log() << "retried write is still stale, attempts: " << attempts << endl;
+                        if( ! db->getChunkManagerIfExists( ns , true, attempts > 2 ) ){
+                            uassert( 15884, str::stream() << "Could not reload chunk manager after " << attempts << " attempts.", attempts <= 4 );
+                            sleepsecs( attempts - 1 );
+                        }
+                        continue;
+                    }
+
+                    clearSinceLastGetError();
+                }
+                catch ( DBException& e ) {
+                    error() << "error retrying rejected write: " << e << endl;
+                    BSONObjBuilder b;
+                    b.append( "err" , e.toString() );
+                    e.getInfo().append( b );
+                    gle = b.obj();
+                }
+
+                break;
+            }
+
+            res.push_back( gle );
         }
 
+        _autoSplitOk = autoSplitWas;
+
         return res;
     }
 
 
 
-    bool ClientInfo::getLastError( const BSONObj& options , BSONObjBuilder& result , bool fromWriteBackListener ) {
+    void ClientInfo::harvestRejectedWrites() {
+        if ( _unsafeWritesPending < maxUnsafeWritesBeforeHarvest )
+            return;
+        _unsafeWritesPending = 0; // before the replays, which route through Request::process again
+
+        vector<BSONObj> rejects;
+        for ( set<string>::const_iterator i=sinceLastGetError().begin(); i!=sinceLastGetError().end(); ++i ) {
+            ShardConnection conn( *i , "" );
+            try {
+                _addRejectedWrites( rejects , conn->getLastErrorDetailed() );
+            }
+            catch( std::exception &e ){
+                warning() << "could not harvest rejected writes from shard " << *i << causedBy( e ) << endl;
+            }
+            conn.done();
+        }
+        clearSinceLastGetError();
+
+        if ( rejects.size() ) {
+            log() << "replaying " << rejects.size() << " rejected write(s) for a client not calling getLastError" << endl;
+            _retryRejectedWrites( rejects , false );
+        }
+    }
+
+    bool ClientInfo::getLastError( const BSONObj& options , BSONObjBuilder& result , bool fromRetry ) {
+        _unsafeWritesPending = 0;
         set<string> * shards = getPrev();
 
         if ( shards->size() == 0 ) {
+            unpinShardConns();
             result.appendNull( "err" );
             return true;
         }
 
-        vector<WBInfo> writebacks;
+        vector<BSONObj> rejects;
 
         // handle single server
         if ( shards->size() == 1 ) {
@@ -168,9 +268,9 @@ namespace mongo {
             
             res = res.getOwned();
             conn.done();
-            
 
-            _addWriteBack( writebacks , res );
+
+            _addRejectedWrites( rejects , res );
 
             // hit other machines just to block
             for ( set<string>::const_iterator i=sinceLastGetError().begin(); i!=sinceLastGetError().end(); ++i ) {
@@ -181,7 +281,7 @@ namespace mongo {
                 ShardConnection conn( temp , "" );
 
                 try {
-                    _addWriteBack( writebacks , conn->getLastErrorDetailed() );
+                    _addRejectedWrites( rejects , conn->getLastErrorDetailed() );
                 }
                 catch( std::exception &e ){
                     warning() << "could not clear last error from shard " << temp << causedBy( e ) << endl;
@@ -190,23 +290,24 @@ namespace mongo {
                 conn.done();
             }
             clearSinceLastGetError();
-            
-            if ( writebacks.size() ){
-                vector<BSONObj> v = _handleWriteBacks( writebacks , fromWriteBackListener );
-                if ( v.size() == 0 && fromWriteBackListener ) {
+            unpinShardConns();
+
+            if ( rejects.size() ){
+                vector<BSONObj> v = _retryRejectedWrites( rejects , fromRetry );
+                if ( v.size() == 0 && fromRetry ) {
                     // ok
                 }
                 else {
                     // this will usually be 1
-                    // it can be greater than 1 if a write to a different shard
-                    // than the last write op had a writeback
-                    // all we're going to report is the first
+                    // it can be greater than 1 if several writes were
+                    // rejected before this getLastError
+                    // all we're going to report is the last
                     // since that's the current write
-                    // but we block for all
+                    // but we retry all of them
                     assert( v.size() >= 1 );
-                    result.appendElements( v[0] );
+                    result.appendElements( v.back() );
                     result.appendElementsUnique( res );
-                    result.append( "writebackGLE" , v[0] );
+                    result.append( "retriedGLE" , v.back() );
                     result.append( "initialGLEHost" , theShard );
                 }
             }
@@ -249,8 +350,8 @@ namespace mongo {
                 return false;
             }
             
-            _addWriteBack( writebacks, res );
-            
+            _addRejectedWrites( rejects, res );
+
             string temp = DBClientWithCommands::getLastErrorString( res );
             if ( conn->type() != ConnectionString::SYNC && ( ok == false || temp.size() ) ) {
                 errors.push_back( temp );
@@ -283,7 +384,7 @@ namespace mongo {
 
             ShardConnection conn( temp , "" );
             try {
-                _addWriteBack( writebacks, conn->getLastErrorDetailed() );
+                _addRejectedWrites( rejects, conn->getLastErrorDetailed() );
             }
             catch( std::exception &e ){
                 warning() << "could not clear last error from a shard " << temp << causedBy( e ) << endl;
@@ -291,10 +392,11 @@ namespace mongo {
             conn.done();
         }
         clearSinceLastGetError();
+        unpinShardConns();
 
         if ( errors.size() == 0 ) {
             result.appendNull( "err" );
-            _handleWriteBacks( writebacks , fromWriteBackListener );
+            _retryRejectedWrites( rejects , fromRetry );
             return true;
         }
 
@@ -317,7 +419,7 @@ namespace mongo {
             }
             all.done();
         }
-        _handleWriteBacks( writebacks , fromWriteBackListener );
+        _retryRejectedWrites( rejects , fromRetry );
         return true;
     }
 
@@ -19,7 +19,6 @@
 #pragma once
 
 #include "../pch.h"
-#include "writeback_listener.h"
 #include "../db/security.h"
 #include "../db/client_common.h"
 
@@ -41,6 +40,11 @@ namespace mongo {
         /** client disconnected */
         void disconnect();
 
+        /** tears down this thread's ClientInfo.  called when a handler thread
+            finishes one connection and may be reused for another (see
+            pms::HandlerPool); the next get() on the thread starts fresh. */
+        static void resetThread() { _tlInfo.reset(); }
+
         bool hasRemote() const { return true; }
 
         /**
@@ -78,30 +82,49 @@ namespace mongo {
         /**
          * calls getLastError
          * resets shards since get last error
+         * @param fromRetry true when called while replaying a write a shard
+         *        rejected for a stale shard version - suppresses recursion
          * @return if the command was ok or if there was an error
          */
-        bool getLastError( const BSONObj& options , BSONObjBuilder& result , bool fromWriteBackListener = false );
+        bool getLastError( const BSONObj& options , BSONObjBuilder& result , bool fromRetry = false );
+
+        /**
+         * a client that never calls getLastError (fire-and-forget) would
+         * strand writes the shards rejected for a stale shard version, since
+         * getLastError is what normally collects and replays them.  the write
+         * path notes each write sent and, once enough have gone out that
+         * rejects may be sitting on the shards, harvests and replays them
+         * itself before routing the next write.
+         */
+        void noteUnsafeWrite() { _unsafeWritesPending++; }
+        void harvestRejectedWrites();
 
         /** @return if its ok to auto split from this client */
         bool autoSplitOk() const { return _autoSplitOk; }
-        
+
         void noAutoSplit() { _autoSplitOk = false; }
 
+        /**
+         * while a fire-and-forget write's result has not been collected by a
+         * getLastError, this client's thread must keep its shard connections:
+         * the getLastError has to run on the sockets that took the writes
+         */
+        bool shardConnsPinned() const { return _shardConnsPinned; }
+        void pinShardConns() { _shardConnsPinned = true; }
+        void unpinShardConns() { _shardConnsPinned = false; }
+
         static ClientInfo * get();
         const AuthenticationInfo* getAuthenticationInfo() const { return (AuthenticationInfo*)&_ai; }
         AuthenticationInfo* getAuthenticationInfo() { return (AuthenticationInfo*)&_ai; }
         bool isAdmin() { return _ai.isAuthorized( "admin" ); }
     private:
         AuthenticationInfo _ai;
-        struct WBInfo {
-            WBInfo( const WriteBackListener::ConnectionIdent& c , OID o ) : ident( c ) , id( o ) {}
-            WriteBackListener::ConnectionIdent ident;
-            OID id;
-        };
 
-        // for getLastError
-        void _addWriteBack( vector<WBInfo>& all , const BSONObj& o );
-        vector<BSONObj> _handleWriteBacks( vector<WBInfo>& all , bool fromWriteBackListener );
+        // for getLastError: writes a shard rejected because our shard version
+        // was stale come back in its getLastError response; we refresh the
+        // ChunkManager and replay them ourselves
+        void _addRejectedWrites( vector<BSONObj>& all , const BSONObj& gle );
+        vector<BSONObj> _retryRejectedWrites( const vector<BSONObj>& all , bool fromRetry );
 
 
         int _id; // unique client id
@@ -120,7 +143,9 @@ namespace mongo {
         set<string> _sinceLastGetError; // all shards accessed since last getLastError
 
         int _lastAccess;
-        bool _autoSplitOk; 
+        int _unsafeWritesPending; // writes routed since the last getLastError, see harvestRejectedWrites()
+        bool _autoSplitOk;
+        bool _shardConnsPinned;
 
         static boost::thread_specific_ptr<ClientInfo> _tlInfo;
     };
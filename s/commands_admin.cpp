@@ -44,7 +44,6 @@
 #include "grid.h"
 #include "strategy.h"
 #include "stats.h"
-#include "writeback_listener.h"
 #include "client.h"
 #include "../util/ramlog.h"
 
@@ -653,6 +652,67 @@ namespace mongo {
             }
         } splitCollectionCmd;
 
+        class MergeChunksCmd : public GridAdminCmd {
+        public:
+            MergeChunksCmd() : GridAdminCmd( "mergeChunks" ) {}
+            virtual void help( stringstream& help ) const {
+                help
+                        << " example: - merge the adjacent chunks between the two keys into one \n"
+                        << " { mergeChunks : 'alleyinsider.blog.posts' , min : { ts : 0 } , max : { ts : 100 } }\n"
+                        << " all chunks in [min, max) must be adjacent and live on the same shard \n"
+                        ;
+            }
+
+            bool run(const string& , BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool) {
+
+                if ( ! okForConfigChanges( errmsg ) )
+                    return false;
+
+                ShardConnection::sync();
+
+                string ns = cmdObj.firstElement().valuestrsafe();
+                if ( ns.size() == 0 ) {
+                    errmsg = "no ns";
+                    return false;
+                }
+
+                DBConfigPtr config = grid.getDBConfig( ns );
+                if ( ! config->isSharded( ns ) ) {
+                    config->reload();
+                    if ( ! config->isSharded( ns ) ) {
+                        errmsg = "ns not sharded.  have to shard before can merge";
+                        return false;
+                    }
+                }
+
+                BSONObj min = cmdObj.getObjectField( "min" );
+                BSONObj max = cmdObj.getObjectField( "max" );
+                if ( min.isEmpty() || max.isEmpty() ) {
+                    errmsg = "need to specify min and max";
+                    return false;
+                }
+
+                ChunkManagerPtr info = config->getChunkManager( ns );
+                if ( !fieldsMatch( min , info->getShardKey().key() ) ||
+                     !fieldsMatch( max , info->getShardKey().key() ) ) {
+                    errmsg = "min and max need the same fields (and order) as the shard key";
+                    return false;
+                }
+
+                log() << "merging chunks: " << ns << " from " << min << " to " << max << endl;
+
+                BSONObj res;
+                if ( ! info->mergeChunks( min , max , res ) ) {
+                    errmsg = "merge failed";
+                    result.append( "cause" , res );
+                    return false;
+                }
+
+                config->getChunkManager( ns , true );
+                return true;
+            }
+        } mergeChunksCmd;
+
         class MoveChunkCmd : public GridAdminCmd {
         public:
             MoveChunkCmd() : GridAdminCmd( "moveChunk" ) {}
@@ -800,6 +800,149 @@ namespace mongo {
             }
         } disinctCmd;
 
+        class AggregateCmd : public PublicGridCommand {
+        public:
+            AggregateCmd() : PublicGridCommand("aggregate") {}
+            virtual void help( stringstream &help ) const {
+                help << "{ aggregate : 'collection name' , pipeline : [ ... ] }";
+            }
+            virtual bool passOptions() const { return true; }
+            bool run(const string& dbName , BSONObj& cmdObj, int options, string& errmsg, BSONObjBuilder& result, bool) {
+                string collection = cmdObj.firstElement().valuestrsafe();
+                string fullns = dbName + "." + collection;
+
+                DBConfigPtr conf = grid.getDBConfig( dbName , false );
+
+                if ( ! conf || ! conf->isShardingEnabled() || ! conf->isSharded( fullns ) ) {
+                    return passthrough( conf , cmdObj , options, result );
+                }
+
+                // for sharded collections we can run per-document stages on the
+                // shards and concatenate - $group and mid-pipeline $sort/$skip/$limit
+                // don't distribute that way, so refuse them as group does
+                if ( cmdObj["pipeline"].type() != Array ) {
+                    errmsg = "aggregate requires a pipeline array";
+                    return false;
+                }
+                vector<BSONObj> stages;
+                {
+                    BSONObjIterator it( cmdObj["pipeline"].embeddedObject() );
+                    while ( it.more() ) {
+                        BSONElement e = it.next();
+                        if ( e.type() != Object || e.embeddedObject().nFields() != 1 ) {
+                            errmsg = "each pipeline stage must be an object with exactly one operator";
+                            return false;
+                        }
+                        stages.push_back( e.embeddedObject().getOwned() );
+                    }
+                }
+
+                BSONObj sortPattern;
+                long long skip = 0;
+                long long limit = -1;
+                unsigned tail = stages.size();
+                // peel a trailing $limit, a $skip just ahead of it, and then a
+                // trailing $sort - i.e. only the $sort/$skip/$limit composition
+                // order, which is exactly what the merge below reapplies.  $skip
+                // and $limit don't commute ($limit n then $skip k yields
+                // max(0,n-k) docs, not n docs at offset k), so any other order
+                // stays in the pipeline and is refused rather than reordered
+                if ( tail > 0 && str::equals( stages[tail-1].firstElement().fieldName() , "$limit" ) ) {
+                    limit = stages[tail-1].firstElement().numberLong();
+                    tail--;
+                }
+                if ( tail > 0 && str::equals( stages[tail-1].firstElement().fieldName() , "$skip" ) ) {
+                    skip = stages[tail-1].firstElement().numberLong();
+                    tail--;
+                }
+                if ( tail > 0 && str::equals( stages[tail-1].firstElement().fieldName() , "$sort" ) ) {
+                    sortPattern = stages[tail-1].firstElement().embeddedObjectUserCheck().getOwned();
+                    tail--;
+                }
+                for ( unsigned i = 0; i < tail; i++ ) {
+                    const char *name = stages[i].firstElement().fieldName();
+                    if ( ! str::equals( name , "$match" ) &&
+                         ! str::equals( name , "$project" ) &&
+                         ! str::equals( name , "$unwind" ) ) {
+                        errmsg = str::stream() << "can't do pipeline stage: " << name
+                                               << " on sharded collection";
+                        return false;
+                    }
+                }
+
+                // shards run everything except the trailing $skip; a trailing $limit
+                // becomes skip+limit there since each shard only sees its own slice
+                BSONObjBuilder shardCmd;
+                shardCmd.append( cmdObj.firstElement() );
+                {
+                    BSONArrayBuilder p( shardCmd.subarrayStart( "pipeline" ) );
+                    for ( unsigned i = 0; i < tail; i++ )
+                        p.append( stages[i] );
+                    if ( ! sortPattern.isEmpty() )
+                        p.append( BSON( "$sort" << sortPattern ) );
+                    if ( limit >= 0 )
+                        p.append( BSON( "$limit" << skip + limit ) );
+                    p.done();
+                }
+                BSONObj shardCmdObj = shardCmd.obj();
+
+                ChunkManagerPtr cm = conf->getChunkManager( fullns );
+                massert( 16297 , "how could chunk manager be null!" , cm );
+
+                BSONObj query;
+                if ( tail > 0 && str::equals( stages[0].firstElement().fieldName() , "$match" ) )
+                    query = stages[0].firstElement().embeddedObjectUserCheck();
+                set<Shard> shards;
+                cm->getShardsForQuery( shards , query );
+
+                vector<BSONObj> all;
+                for ( set<Shard>::iterator i=shards.begin(), end=shards.end() ; i != end; ++i ) {
+                    ShardConnection conn( *i , fullns );
+                    BSONObj res;
+                    bool ok = conn->runCommand( conf->getName() , shardCmdObj , res, options );
+                    conn.done();
+
+                    if ( ! ok ) {
+                        result.appendElements( res );
+                        return false;
+                    }
+
+                    BSONObjIterator it( res["result"].embeddedObject() );
+                    while ( it.more() )
+                        all.push_back( it.next().embeddedObjectUserCheck().getOwned() );
+                }
+
+                if ( ! sortPattern.isEmpty() )
+                    std::stable_sort( all.begin() , all.end() , BSONObjCmpDotted( sortPattern ) );
+
+                BSONArrayBuilder arr( result.subarrayStart( "result" ) );
+                long long n = 0;
+                for ( vector<BSONObj>::iterator i = all.begin(); i != all.end(); ++i ) {
+                    if ( skip > 0 ) {
+                        skip--;
+                        continue;
+                    }
+                    if ( limit >= 0 && n >= limit )
+                        break;
+                    uassert( 16298 , "aggregation result exceeds maximum document size" ,
+                             arr.len() + i->objsize() < BSONObjMaxUserSize );
+                    arr.append( *i );
+                    n++;
+                }
+                arr.done();
+                return true;
+            }
+
+        private:
+            struct BSONObjCmpDotted {
+                BSONObjCmpDotted( const BSONObj& p ) : pattern( p ) {}
+                bool operator()( const BSONObj& l , const BSONObj& r ) const {
+                    return l.woSortOrder( r , pattern , true ) < 0;
+                }
+                BSONObj pattern;
+            };
+        } aggregateCmd;
+
         class FileMD5Cmd : public PublicGridCommand {
         public:
             FileMD5Cmd() : PublicGridCommand("filemd5") {}
@@ -20,6 +20,7 @@
 #include "../util/net/message.h"
 #include "../util/stringutils.h"
 #include "../util/unittest.h"
+#include "../util/queue.h"
 #include "../client/connpool.h"
 #include "../client/model.h"
 #include "../db/pdfile.h"
@@ -188,12 +189,13 @@ namespace mongo {
         BSONObj key;
         bool unique;
         ShardChunkVersion oldVersion;
+        ChunkManagerPtr oldManager;
 
         {
             scoped_lock lk( _lock );
-            
+
             CollectionInfo& ci = _collections[ns];
-            
+
             bool earlyReload = ! ci.isSharded() && ( shouldReload || forceReload );
             if ( earlyReload ) {
                 // this is to catch cases where there this is a new sharded collection
@@ -202,14 +204,16 @@ namespace mongo {
             }
             massert( 10181 ,  (string)"not sharded:" + ns , ci.isSharded() );
             assert( ! ci.key().isEmpty() );
-            
+
             if ( ! ( shouldReload || forceReload ) || earlyReload )
                 return ci.getCM();
 
             key = ci.key().copy();
             unique = ci.unique();
-            if ( ci.getCM() )
+            if ( ci.getCM() ) {
+                oldManager = ci.getCM();
                 oldVersion = ci.getCM()->getVersion();
+            }
         }
         
         assert( ! key.isEmpty() );
@@ -259,7 +263,10 @@ namespace mongo {
                 
             }
             
-            temp.reset( new ChunkManager( ns , key , unique ) );
+            // a forced reload starts from scratch; otherwise patch the old
+            // manager's chunks with just the ones changed since its version
+            temp.reset( new ChunkManager( ns , key , unique ,
+                                          forceReload ? ChunkManagerPtr() : oldManager ) );
             if ( temp->numChunks() == 0 ) {
                 // maybe we're not sharded any more
                 reload(); // this is a full reload
@@ -774,6 +781,54 @@ namespace mongo {
         return name;
     }
 
+    // changelog entries wait here for the writer thread; the sync-cluster insert they
+    // need is fsync-checked on every config server and has no business on the operation
+    // that triggered the event
+    static BlockingQueue<BSONObj> changelogQueue;
+
+    static void changelogWriterThread() {
+        Client::initThread( "changelog" );
+
+        while ( ! inShutdown() ) {
+            BSONObj first;
+            if ( ! changelogQueue.blockingPop( first , 10 /* secs */ ) )
+                continue;
+
+            // coalesce whatever else is already queued into a single insert
+            vector<BSONObj> batch;
+            batch.push_back( first );
+            BSONObj next;
+            while ( batch.size() < 100 && changelogQueue.tryPop( next ) )
+                batch.push_back( next );
+
+            try {
+                ScopedDbConnection conn( configServer.modelServer(), 30.0 );
+
+                static bool createdCapped = false;
+                if ( ! createdCapped ) {
+                    try {
+                        conn->createCollection( "config.changelog" , 1024 * 1024 * 10 , true );
+                    }
+                    catch ( UserException& e ) {
+                        LOG(1) << "couldn't create changelog (like race condition): " << e << endl;
+                        // don't care
+                    }
+                    createdCapped = true;
+                }
+
+                conn->insert( "config.changelog" , batch );
+
+                conn.done();
+            }
+            catch ( std::exception& e ) {
+                // the changes are only in the log; they didn't make it to config.changelog
+                log() << "not logging " << batch.size() << " config change(s): " << e.what() << endl;
+            }
+        }
+
+        cc().shutdown();
+    }
+
     /* must never throw */
     void ConfigServer::logChange( const string& what , const string& ns , const BSONObj& detail ) {
         string changeID;
@@ -793,24 +848,19 @@ namespace mongo {
 
             assert( _primary.ok() );
 
-            ScopedDbConnection conn( _primary, 30.0 );
-
-            static bool createdCapped = false;
-            if ( ! createdCapped ) {
-                try {
-                    conn->createCollection( "config.changelog" , 1024 * 1024 * 10 , true );
-                }
-                catch ( UserException& e ) {
-                    LOG(1) << "couldn't create changelog (like race condition): " << e << endl;
-                    // don't care
+            // hand the entry to the writer thread, which batches queued entries into
+            // single inserts; start the thread lazily on the first event
+            static mongo::mutex changelogWriterLock( "changelogWriter" );
+            {
+                scoped_lock lk( changelogWriterLock );
+                static bool writerStarted = false;
+                if ( ! writerStarted ) {
+                    boost::thread t( changelogWriterThread );
+                    writerStarted = true;
                 }
-                createdCapped = true;
             }
 
-            conn->insert( "config.changelog" , msg );
-
-            conn.done();
-
+            changelogQueue.push( msg );
         }
 
         catch ( std::exception& e ) {
@@ -36,6 +36,7 @@ namespace mongo {
         _ntoreturn = q.ntoreturn;
 
         _totalSent = 0;
+        _lastBatchLen = 0;
         _done = false;
 
         _id = 0;
@@ -79,7 +80,9 @@ namespace mongo {
         if ( _totalSent > 0 )
             maxSize *= 3;
 
-        BufBuilder b(32768);
+        // batches of a cursor tend to be about the same size, so reserve what the
+        // last one took (plus a little slack) and skip most of the buffer doublings
+        BufBuilder b( _lastBatchLen ? _lastBatchLen + 4096 : 32768 );
 
         int num = 0;
         bool sendMore = true;
@@ -115,6 +118,7 @@ namespace mongo {
         LOG(6) << "\t hasMore:" << hasMore << " wouldSendMoreIfHad: " << sendMore << " id:" << getId() << " totalSent: " << _totalSent << endl;
 
         replyToQuery( 0 , r.p() , r.m() , b.buf() , b.len() , num , _totalSent , hasMore ? getId() : 0 );
+        _lastBatchLen = b.len();
         _totalSent += num;
         _done = ! hasMore;
 
@@ -126,27 +130,35 @@ namespace mongo {
     long long CursorCache::TIMEOUT = 600000;
 
     CursorCache::CursorCache()
-        :_mutex( "CursorCache" ), _shardedTotal(0) {
+        : _sweepBucket(0) {
     }
 
     CursorCache::~CursorCache() {
         // TODO: delete old cursors?
+        unsigned sharded = 0;
+        unsigned passthrough = 0;
+        for ( int i = 0; i < NumBuckets; i++ ) {
+            sharded += _buckets[i].cursors.size();
+            passthrough += _buckets[i].refs.size();
+        }
+
         bool print = logLevel > 0;
-        if ( _cursors.size() || _refs.size() )
+        if ( sharded || passthrough )
             print = true;
-        
-        if ( print ) 
+
+        if ( print )
             cout << " CursorCache at shutdown - "
-                 << " sharded: " << _cursors.size()
-                 << " passthrough: " << _refs.size()
+                 << " sharded: " << sharded
+                 << " passthrough: " << passthrough
                  << endl;
     }
 
     ShardedClientCursorPtr CursorCache::get( long long id ) const {
         LOG(_myLogLevel) << "CursorCache::get id: " << id << endl;
-        scoped_lock lk( _mutex );
-        MapSharded::const_iterator i = _cursors.find( id );
-        if ( i == _cursors.end() ) {
+        Bucket& b = _bucketFor( id );
+        scoped_lock lk( b.mutex );
+        MapSharded::const_iterator i = b.cursors.find( id );
+        if ( i == b.cursors.end() ) {
             OCCASIONALLY log() << "Sharded CursorCache missing cursor id: " << id << endl;
             return ShardedClientCursorPtr();
         }
@@ -157,29 +169,33 @@ namespace mongo {
     void CursorCache::store( ShardedClientCursorPtr cursor ) {
         LOG(_myLogLevel) << "CursorCache::store cursor " << " id: " << cursor->getId() << endl;
         assert( cursor->getId() );
-        scoped_lock lk( _mutex );
-        _cursors[cursor->getId()] = cursor;
-        _shardedTotal++;
+        Bucket& b = _bucketFor( cursor->getId() );
+        scoped_lock lk( b.mutex );
+        b.cursors[cursor->getId()] = cursor;
+        b.shardedTotal++;
     }
     void CursorCache::remove( long long id ) {
         assert( id );
-        scoped_lock lk( _mutex );
-        _cursors.erase( id );
+        Bucket& b = _bucketFor( id );
+        scoped_lock lk( b.mutex );
+        b.cursors.erase( id );
     }
-    
+
     void CursorCache::storeRef( const string& server , long long id ) {
         LOG(_myLogLevel) << "CursorCache::storeRef server: " << server << " id: " << id << endl;
         assert( id );
-        scoped_lock lk( _mutex );
-        _refs[id] = server;
+        Bucket& b = _bucketFor( id );
+        scoped_lock lk( b.mutex );
+        b.refs[id] = server;
     }
 
     string CursorCache::getRef( long long id ) const {
         LOG(_myLogLevel) << "CursorCache::getRef id: " << id << endl;
         assert( id );
-        scoped_lock lk( _mutex );
-        MapNormal::const_iterator i = _refs.find( id );
-        if ( i == _refs.end() )
+        Bucket& b = _bucketFor( id );
+        scoped_lock lk( b.mutex );
+        MapNormal::const_iterator i = b.refs.find( id );
+        if ( i == b.refs.end() )
             return "";
         return i->second;
     }
@@ -193,13 +209,13 @@ namespace mongo {
             if ( x < 0 )
                 x *= -1;
 
-            scoped_lock lk( _mutex );
-            MapSharded::iterator i = _cursors.find( x );
-            if ( i != _cursors.end() )
+            // both maps an id can live in share the id's bucket, so this is the only
+            // bucket we have to check for a collision
+            Bucket& b = _bucketFor( x );
+            scoped_lock lk( b.mutex );
+            if ( b.cursors.count( x ) )
                 continue;
-
-            MapNormal::iterator j = _refs.find( x );
-            if ( j != _refs.end() )
+            if ( b.refs.count( x ) )
                 continue;
 
             return x;
@@ -231,21 +247,22 @@ namespace mongo {
 
             string server;
             {
-                scoped_lock lk( _mutex );
+                Bucket& b = _bucketFor( id );
+                scoped_lock lk( b.mutex );
 
-                MapSharded::iterator i = _cursors.find( id );
-                if ( i != _cursors.end() ) {
-                    _cursors.erase( i );
+                MapSharded::iterator i = b.cursors.find( id );
+                if ( i != b.cursors.end() ) {
+                    b.cursors.erase( i );
                     continue;
                 }
 
-                MapNormal::iterator j = _refs.find( id );
-                if ( j == _refs.end() ) {
+                MapNormal::iterator j = b.refs.find( id );
+                if ( j == b.refs.end() ) {
                     log( LL_WARNING ) << "can't find cursor: " << id << endl;
                     continue;
                 }
                 server = j->second;
-                _refs.erase( j );
+                b.refs.erase( j );
             }
 
             LOG(_myLogLevel) << "CursorCache::found gotKillCursors id: " << id << " server: " << server << endl;
@@ -258,26 +275,37 @@ namespace mongo {
     }
 
     void CursorCache::appendInfo( BSONObjBuilder& result ) const {
-        scoped_lock lk( _mutex );
-        result.append( "sharded" , (int)_cursors.size() );
-        result.appendNumber( "shardedEver" , _shardedTotal );
-        result.append( "refs" , (int)_refs.size() );
-        result.append( "totalOpen" , (int)(_cursors.size() + _refs.size() ) );
+        int sharded = 0;
+        int refs = 0;
+        long long shardedTotal = 0;
+        for ( int i = 0; i < NumBuckets; i++ ) {
+            Bucket& b = _buckets[i];
+            scoped_lock lk( b.mutex );
+            sharded += b.cursors.size();
+            refs += b.refs.size();
+            shardedTotal += b.shardedTotal;
+        }
+        result.append( "sharded" , sharded );
+        result.appendNumber( "shardedEver" , shardedTotal );
+        result.append( "refs" , refs );
+        result.append( "totalOpen" , sharded + refs );
     }
 
     void CursorCache::doTimeouts() {
         long long now = Listener::getElapsedTimeMillis();
-        scoped_lock lk( _mutex );
-        for ( MapSharded::iterator i=_cursors.begin(); i!=_cursors.end(); ++i ) {
+
+        // sweep one bucket per call; the timeout task fires often enough that every
+        // bucket still gets visited many times per TIMEOUT period
+        Bucket& b = _buckets[ _sweepBucket++ % (unsigned) NumBuckets ];
+        scoped_lock lk( b.mutex );
+        for ( MapSharded::iterator i = b.cursors.begin(); i != b.cursors.end(); ) {
             long long idleFor = i->second->idleTime( now );
             if ( idleFor < TIMEOUT ) {
+                ++i;
                 continue;
             }
             log() << "killing old cursor " << i->second->getId() << " idle for: " << idleFor << "ms" << endl; // TODO: make log(1)
-            _cursors.erase( i );
-            i = _cursors.begin(); // possible 2nd entry will get skipped, will get on next pass
-            if ( i == _cursors.end() )
-                break;
+            b.cursors.erase( i++ );
         }
     }
 
@@ -54,6 +54,7 @@ namespace mongo {
         int _ntoreturn;
 
         int _totalSent;
+        int _lastBatchLen; // bytes in the last batch sent; sizes the next batch's buffer
         bool _done;
 
         long long _id;
@@ -92,12 +93,25 @@ namespace mongo {
         void doTimeouts();
         void startTimeoutThread();
     private:
-        mutable mongo::mutex _mutex;
 
-        MapSharded _cursors;
-        MapNormal _refs;
-
-        long long _shardedTotal;
+        /* cursors are sharded by id across these buckets so concurrent getMores don't
+           all serialize on one lock; mirrors the server-side ClientCursor registry.
+           both maps of a bucket are guarded by its mutex, so genId only has to check
+           one bucket for a collision */
+        enum { NumBuckets = 64 };
+        struct Bucket {
+            Bucket() : mutex( "CursorCache::bucket" ) , shardedTotal( 0 ) {}
+            mongo::mutex mutex;
+            MapSharded cursors;
+            MapNormal refs;
+            long long shardedTotal; // # of sharded cursors ever stored here
+        };
+        mutable Bucket _buckets[NumBuckets];
+        Bucket& _bucketFor( long long id ) const {
+            return _buckets[ ((unsigned long long)id) % (unsigned) NumBuckets ];
+        }
+
+        unsigned _sweepBucket; // next bucket for doTimeouts; only the timeout task touches it
 
         static int _myLogLevel;
     };
@@ -132,6 +132,14 @@ namespace mongo {
         assert( ! min.isEmpty() );
 
         _rangesMap.insert( make_pair( min , max ) );
+
+        // flatten the ranges' borders into a sorted array of encoded keys; coalescing
+        // guarantees the borders are strictly increasing, so _belongsToMe can binary
+        // search the array and decide ownership from the parity of the landing spot
+        for ( RangeMap::const_iterator i = _rangesMap.begin(); i != _rangesMap.end(); ++i ) {
+            _rangeBorders.push_back( shared_ptr<KeyV1Owned>( new KeyV1Owned( i->first ) ) );
+            _rangeBorders.push_back( shared_ptr<KeyV1Owned>( new KeyV1Owned( i->second ) ) );
+        }
     }
 
     static bool contains( const BSONObj& min , const BSONObj& max , const BSONObj& point ) {
@@ -140,36 +148,39 @@ namespace mongo {
     
     bool ShardChunkManager::belongsToMe( ClientCursor* cc ) const {
         verify( 15851 , cc );
-        if ( _rangesMap.size() == 0 )
+        if ( _rangeBorders.empty() )
             return false;
-        
+
         return _belongsToMe( cc->extractFields( _key , true ) );
     }
 
     bool ShardChunkManager::belongsToMe( const BSONObj& obj ) const {
-        if ( _rangesMap.size() == 0 )
+        if ( _rangeBorders.empty() )
             return false;
 
         return _belongsToMe( obj.extractFields( _key , true ) );
     }
 
     bool ShardChunkManager::_belongsToMe( const BSONObj& x ) const {
-        RangeMap::const_iterator it = _rangesMap.upper_bound( x );
-        if ( it != _rangesMap.begin() )
-            it--;
-
-        bool good = contains( it->first , it->second , x );
-
-#if 0
-        if ( ! good ) {
-            log() << "bad: " << x << " " << it->first << " " << x.woCompare( it->first ) << " " << x.woCompare( it->second ) << endl;
-            for ( RangeMap::const_iterator i=_rangesMap.begin(); i!=_rangesMap.end(); ++i ) {
-                log() << "\t" << i->first << "\t" << i->second << "\t" << endl;
-            }
+        KeyV1Owned key( x );
+
+        // _fillCollectionKey normalizes the key pattern to all-ascending, so comparing
+        // the encoded keys with the all-ascending ordering is always correct here
+        const Ordering ordering = Ordering::make( BSONObj() );
+
+        // upper_bound over the flattened (min0, max0, min1, max1, ...) borders; the key
+        // is inside a [min, max) range exactly when it lands at an odd position
+        unsigned lo = 0;
+        unsigned hi = _rangeBorders.size();
+        while ( lo < hi ) {
+            unsigned mid = ( lo + hi ) / 2;
+            if ( key.woCompare( *_rangeBorders[mid] , ordering ) >= 0 )
+                lo = mid + 1;
+            else
+                hi = mid;
         }
-#endif
 
-        return good;
+        return ( lo & 1 ) == 1;
     }
 
     bool ShardChunkManager::getNextChunk( const BSONObj& lookupKey, BSONObj* foundMin , BSONObj* foundMax ) const {
@@ -323,6 +334,48 @@ namespace mongo {
         return p.release();
     }
 
+    ShardChunkManager* ShardChunkManager::cloneMerged( const BSONObj& min , const BSONObj& max ,
+            const ShardChunkVersion& version ) {
+
+        // merges, like splits, may only move the version forward - anything else would make
+        // a stale mongos trust cached boundaries that no longer exist
+        if ( version <= _version ) {
+            uasserted( 16303 , str::stream() << "version " << version.toString() << " not greater than " << _version.toString() );
+        }
+
+        // walk the contiguous run of chunks covering [min, max) exactly
+        RangeMap::const_iterator it = _chunksMap.find( min );
+        uassert( 16304 , str::stream() << "cannot merge, no chunk starts at " << min , it != _chunksMap.end() );
+
+        unsigned merged = 0;
+        BSONObj prevMax = min;
+        while ( it != _chunksMap.end() && it->second.woCompare( max ) <= 0 ) {
+            if ( it->first.woCompare( prevMax ) != 0 ) {
+                uasserted( 16305 , str::stream() << "cannot merge, hole between " << prevMax << " and " << it->first );
+            }
+            prevMax = it->second;
+            merged++;
+            ++it;
+        }
+        uassert( 16306 , str::stream() << "cannot merge, chunks don't cover up to " << max
+                                       << " (reached " << prevMax << ")" , prevMax.woCompare( max ) == 0 );
+        uassert( 16307 , str::stream() << "cannot merge a single chunk " << min << " -> " << max , merged > 1 );
+
+        auto_ptr<ShardChunkManager> p( new ShardChunkManager );
+
+        p->_key = this->_key;
+        p->_chunksMap = this->_chunksMap;
+        RangeMap::iterator doomed = p->_chunksMap.find( min );
+        for ( unsigned i = 0; i < merged; i++ ) {
+            p->_chunksMap.erase( doomed++ );
+        }
+        p->_chunksMap.insert( make_pair( min.getOwned() , max.getOwned() ) );
+        p->_version = version;
+        p->_fillRanges();
+
+        return p.release();
+    }
+
     string ShardChunkManager::toString() const {
         StringBuilder ss;
         ss << " ShardChunkManager version: " << _version << " key: " << _key;
@@ -21,6 +21,7 @@
 #include "../pch.h"
 
 #include "../db/jsobj.h"
+#include "../db/key.h"
 #include "util.h"
 
 namespace mongo {
@@ -95,6 +96,18 @@ namespace mongo {
         ShardChunkManager* cloneSplit( const BSONObj& min , const BSONObj& max , const vector<BSONObj>& splitKeys ,
                                        const ShardChunkVersion& version );
 
+        /**
+         * Generates a new manager by merging the contiguous run of chunks covering [min, max)
+         * into a single chunk.  Throws if the run has holes, or doesn't start at 'min' or end
+         * at 'max' exactly.
+         *
+         * @param min max boundaries of the resulting merged chunk
+         * @param version to be used in the merged chunk. Has to be higher than the current one.
+         * @return a new ShardChunkManager with the chunks merged, to be owned by the caller
+         */
+        ShardChunkManager* cloneMerged( const BSONObj& min , const BSONObj& max ,
+                                        const ShardChunkVersion& version );
+
         /**
          * Checks whether a document belongs to this shard.
          *
@@ -150,6 +163,13 @@ namespace mongo {
         // redundant but we expect high chunk continguity, expecially in small installations
         RangeMap _rangesMap;
 
+        // the ranges' boundaries in KeyV1 encoded form, flattened into one sorted array
+        // (min0, max0, min1, max1, ...); since the ranges are disjoint and the maxes are
+        // exclusive, a shard key falls inside one iff an upper_bound binary search over
+        // the encoded borders lands at an odd position. this is what the per-document
+        // belongsToMe() checks search -- encoded compares are much cheaper than BSONObj's
+        vector< shared_ptr<KeyV1Owned> > _rangeBorders;
+
         /** constructors helpers */
         void _fillCollectionKey( const BSONObj& collectionDoc );
         void _fillChunks( DBClientCursorInterface* cursor );
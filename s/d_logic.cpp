@@ -33,11 +33,8 @@
 
 #include "../client/connpool.h"
 
-#include "../util/queue.h"
-
 #include "shard.h"
 #include "d_logic.h"
-#include "d_writeback.h"
 
 using namespace std;
 
@@ -56,7 +53,7 @@ namespace mongo {
         DbMessage d(m);
         const char *ns = d.getns();
         string errmsg;
-        if ( shardVersionOk( ns , errmsg ) ) {
+        if ( shardVersionOk( ns , op == dbQuery , errmsg ) ) {
             return false;
         }
 
@@ -88,32 +85,27 @@ namespace mongo {
             return true;
         }
         
-        uassert( 9517 , "writeback" , ( d.reservedField() & DbMessage::Reserved_FromWriteback ) == 0 );
-
-        OID writebackID;
-        writebackID.init();
-        lastError.getSafe()->writeback( writebackID );
+        /* if mongos already retried this op it still holds the message, so a
+           plain error (picked up by its getLastError) is enough to make it
+           refresh and retry once more */
+        uassert( 9517 , "stale config on a retried write" , ( d.reservedField() & DbMessage::Reserved_FromWriteback ) == 0 );
 
-        const OID& clientID = ShardedConnectionInfo::get(false)->getID();
-        massert( 10422 ,  "write with bad shard config and no server id!" , clientID.isSet() );
+        ShardedConnectionInfo* info = ShardedConnectionInfo::get( false );
+        massert( 10422 ,  "write with bad shard config and no sharded connection info!" , info );
 
-        LOG(1) << "got write with an old config - writing back ns: " << ns << endl;
+        LOG(1) << "got write with an old config - rejecting for mongos retry, ns: " << ns << endl;
         LOG(1) << m.toString() << endl;
 
+        /* buffer the raw message on this connection; the next getLastError
+           returns it to mongos, which refreshes its ChunkManager and retries
+           the op itself.  see ClientInfo::_retryRejectedWrites(). */
         BSONObjBuilder b;
-        b.appendBool( "writeBack" , true );
         b.append( "ns" , ns );
-        b.append( "id" , writebackID );
-        b.append( "connectionId" , cc().getConnectionId() );
-        b.append( "instanceIdent" , prettyHostName() );
         b.appendTimestamp( "version" , shardingState.getVersion( ns ) );
-        
-        ShardedConnectionInfo* info = ShardedConnectionInfo::get( false );
-        b.appendTimestamp( "yourVersion" , info ? info->getVersion(ns) : (ConfigVersion)0 );
-
+        b.appendTimestamp( "yourVersion" , info->getVersion( ns ) );
         b.appendBinData( "msg" , m.header()->len , bdtCustom , (char*)(m.singleData()) );
-        LOG(2) << "writing back msg with len: " << m.header()->len << " op: " << m.operation() << endl;
-        writeBackManager.queueWriteBack( clientID.str() , b.obj() );
+        LOG(2) << "rejecting msg with len: " << m.header()->len << " op: " << m.operation() << endl;
+        info->noteRejectedWrite( b.obj() );
 
         return true;
     }
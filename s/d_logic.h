@@ -134,6 +134,32 @@ namespace mongo {
         void splitChunk( const string& ns , const BSONObj& min , const BSONObj& max , const vector<BSONObj>& splitKeys ,
                          ShardChunkVersion version );
 
+        /**
+         * Creates and installs a new chunk manager for a given collection by merging the contiguous
+         * run of its chunks covering [min, max) into one.
+         *
+         * @param ns the collection
+         * @param min max boundaries of the resulting merged chunk
+         * @param version at which the new manager should be at
+         */
+        void mergeChunks( const string& ns , const BSONObj& min , const BSONObj& max ,
+                          ShardChunkVersion version );
+
+        /**
+         * After donateChunk() bumps the version, clients still carrying the
+         * pre-migration version would get bounced with a stale config error
+         * even though the donated data is physically still here until the
+         * migration cleanup thread removes it.  To keep migrations invisible
+         * to read latency we keep answering such reads during that window.
+         *
+         * @return true if a read at clientVersion may still be served
+         */
+        bool readThroughOk( const string& ns , const ConfigVersion& clientVersion ) const;
+
+        /** closes the read-through window for ns; called by the migration
+            cleanup thread just before deleting the donated range */
+        void endDonateGrace( const string& ns );
+
         bool inCriticalMigrateSection();
 
     private:
@@ -151,6 +177,16 @@ namespace mongo {
         // a ShardChunkManager carries all state we need for a collection at this shard, including its version information
         typedef map<string,ShardChunkManagerPtr> ChunkManagersMap;
         ChunkManagersMap _chunks;
+
+        // per collection read-through window opened by donateChunk():
+        // version before the donation and a wall clock expiry in case the
+        // cleanup thread never runs.  see readThroughOk()
+        struct DonateGrace {
+            ConfigVersion prevVersion;
+            time_t expires;
+        };
+        typedef map<string,DonateGrace> DonateGraceMap;
+        DonateGraceMap _donateGrace;
     };
 
     extern ShardingState shardingState;
@@ -181,6 +217,22 @@ namespace mongo {
         void enterForceVersionOkMode() { _forceVersionOk = true; }
         void leaveForceVersionOkMode() { _forceVersionOk = false; }
 
+        /**
+         * a fire-and-forget write arrived on this connection with a stale shard
+         * version.  we hold the raw message here until the next getLastError on
+         * this connection hands it back to mongos, which refreshes its
+         * ChunkManager and retries the op itself.  mongos harvests these
+         * periodically even for clients that never call getLastError; should
+         * that not happen, the buffer is capped and overflow is dropped with
+         * a warning rather than growing without bound.
+         */
+        void noteRejectedWrite( const BSONObj& info );
+
+        bool hasRejectedWrites() const { return ! _rejectedWrites.empty(); }
+
+        /** move the buffered rejected writes into a getLastError response */
+        void appendRejectedWrites( BSONObjBuilder& b );
+
     private:
 
         OID _id;
@@ -189,6 +241,11 @@ namespace mongo {
         typedef map<string,ConfigVersion> NSVersionMap;
         NSVersionMap _versions;
 
+        enum { MaxRejectedWrites = 1000 , MaxRejectedWritesBytes = 64 * 1024 * 1024 };
+
+        vector<BSONObj> _rejectedWrites; // see noteRejectedWrite()
+        long long _rejectedWritesBytes;  // total objsize() buffered above
+
         static boost::thread_specific_ptr<ShardedConnectionInfo> _tl;
     };
 
@@ -219,9 +276,11 @@ namespace mongo {
     bool haveLocalShardingInfo( const string& ns );
 
     /**
+     * @param isRead true for operations that don't modify data; a stale read
+     *        may still be served during a migration's read-through window
      * @return true if the current threads shard version is ok, or not in sharded version
      */
-    bool shardVersionOk( const string& ns , string& errmsg );
+    bool shardVersionOk( const string& ns , bool isRead , string& errmsg );
 
     /**
      * @return true if we took care of the message and nothing else should be done
@@ -39,6 +39,7 @@
 #include "../client/connpool.h"
 #include "../client/distlock.h"
 
+#include "../util/bloom.h"
 #include "../util/queue.h"
 #include "../util/unittest.h"
 #include "../util/processinfo.h"
@@ -215,6 +216,7 @@ namespace mongo {
             _active = false;
             _inCriticalSection = false;
             _memoryUsed = 0;
+            _cloneLocsPos = 0;
         }
 
         void start( string ns , const BSONObj& min , const BSONObj& max ) {
@@ -246,7 +248,10 @@ namespace mongo {
                 scoped_spinlock lk( _trackerLocks );
                 _deleted.clear();
                 _reload.clear();
-                _cloneLocs.clear();
+                vector<DiskLoc>().swap( _cloneLocs ); // clear() keeps the capacity
+                _cloneLocsPos = 0;
+                _cloneSkips.clear();
+                _cloneFilter.reset();
             }
             _memoryUsed = 0;
 
@@ -419,6 +424,17 @@ namespace mongo {
                 maxRecsWhenFull = numeric_limits<long long>::max();
             }
 
+            {
+                // approximate membership over the clone set: deletes during the
+                // migration consult this before paying for an exact record in
+                // _cloneSkips.  sized from the most locs we would ever track.
+                unsigned long long est = maxRecsWhenFull;
+                if ( est > 4 * 1024 * 1024 )
+                    est = 4 * 1024 * 1024;
+                scoped_spinlock lk( _trackerLocks );
+                _cloneFilter.reset( new BloomFilter( est ) );
+            }
+
             // do a full traversal of the chunk and don't stop even if we think it is a large chunk
             // we want the number of records to better report, in that case
             bool isLargeChunk = false;
@@ -427,7 +443,8 @@ namespace mongo {
                 DiskLoc dl = cc->currLoc();
                 if ( ! isLargeChunk ) {
                     scoped_spinlock lk( _trackerLocks );
-                    _cloneLocs.insert( dl );
+                    _cloneLocs.push_back( dl );
+                    _cloneFilter->insert( &dl , sizeof( dl ) );
                 }
                 cc->advance();
 
@@ -455,7 +472,12 @@ namespace mongo {
             }
 
             {
+                // the btree traversal above produced key order; clone wants disk
+                // order to avoid seeking.  no writers can run here - we hold the
+                // read lock and did not yield since the scan finished.
                 scoped_spinlock lk( _trackerLocks );
+                sort( _cloneLocs.begin() , _cloneLocs.end() );
+                _cloneLocs.erase( unique( _cloneLocs.begin() , _cloneLocs.end() ) , _cloneLocs.end() );
                 log() << "moveChunk number of documents: " << _cloneLocs.size() << migrateLog;
             }
             return true;
@@ -476,7 +498,7 @@ namespace mongo {
                 NamespaceDetails *d = nsdetails( _ns.c_str() );
                 assert( d );
                 scoped_spinlock lk( _trackerLocks );
-                allocSize = std::min(BSONObjMaxUserSize, (int)((12 + d->averageObjectSize()) * _cloneLocs.size()));
+                allocSize = std::min(BSONObjMaxUserSize, (int)((12 + d->averageObjectSize()) * ( _cloneLocs.size() - _cloneLocsPos )));
             }
             BSONArrayBuilder a (allocSize);
             
@@ -486,12 +508,15 @@ namespace mongo {
                 readlock l( _ns );
                 Client::Context ctx( _ns );
                 scoped_spinlock lk( _trackerLocks );
-                set<DiskLoc>::iterator i = _cloneLocs.begin();
-                for ( ; i!=_cloneLocs.end(); ++i ) {
+                size_t i = _cloneLocsPos;
+                for ( ; i < _cloneLocs.size(); ++i ) {
                     if (tracker.intervalHasElapsed()) // should I yield?
                         break;
 
-                    DiskLoc dl = *i;
+                    DiskLoc dl = _cloneLocs[i];
+                    if ( _cloneSkips.count( dl ) )
+                        continue; // invalidated by a write during the clone; sent via transferMods
+
                     BSONObj o = dl.obj();
 
                     // use the builder size instead of accumulating 'o's size so that we take into consideration
@@ -504,9 +529,9 @@ namespace mongo {
                     a.append( o );
                 }
 
-                _cloneLocs.erase( _cloneLocs.begin() , i );
+                _cloneLocsPos = i;
 
-                if ( _cloneLocs.empty() || filledBuffer )
+                if ( _cloneLocsPos >= _cloneLocs.size() || filledBuffer )
                     break;
             }
 
@@ -523,12 +548,20 @@ namespace mongo {
             if ( ! db->ownsNS( _ns ) )
                 return;
 
-            
+
             // not needed right now
             // but trying to prevent a future bug
-            scoped_spinlock lk( _trackerLocks ); 
+            scoped_spinlock lk( _trackerLocks );
+
+            if ( ! _cloneFilter )
+                return;
 
-            _cloneLocs.erase( dl );
+            // the filter has no false negatives, so a miss means the loc was
+            // never in the clone set and we record nothing
+            if ( ! _cloneFilter->maybeContains( &dl , sizeof( dl ) ) )
+                return;
+
+            _cloneSkips.insert( dl );
         }
 
         long long mbUsed() const { return _memoryUsed / ( 1024 * 1024 ); }
@@ -567,10 +600,19 @@ namespace mongo {
         SpinLock _trackerLocks;
 
         // disk locs yet to be transferred from here to the other side
-        // no locking needed because built initially by 1 thread in a read lock
-        // emptied by 1 thread in a read lock
-        // updates applied by 1 thread in a write lock
-        set<DiskLoc> _cloneLocs;
+        // built initially by 1 thread in a read lock, then sorted to disk order;
+        // the recipient empties it with several concurrent _migrateClone calls,
+        // each advancing _cloneLocsPos past a disjoint batch under _trackerLocks;
+        // updates applied in a write lock.  a flat sorted vector instead of a
+        // set: an 8 byte entry rather than a tree node per doc, which is what
+        // used to exhaust memory on big chunk moves.  locs invalidated by
+        // writes during the clone can no longer be erased in place, so they go
+        // to _cloneSkips, prefiltered by _cloneFilter so writes outside the
+        // clone set cost no memory at all
+        vector<DiskLoc> _cloneLocs;
+        size_t _cloneLocsPos;
+        set<DiskLoc> _cloneSkips;
+        scoped_ptr<BloomFilter> _cloneFilter;
 
         list<BSONObj> _reload; // objects that were modified that must be recloned
         list<BSONObj> _deleted; // objects deleted during clone that should be deleted later
@@ -632,6 +674,10 @@ namespace mongo {
             }
         }
 
+        // the donated data is about to go away - stop answering reads from
+        // clients that still carry the pre-migration version
+        shardingState.endDonateGrace( cleanup.ns );
+
         migrateFromStatus.doRemove( cleanup );
 
         cc().shutdown();
@@ -1196,9 +1242,116 @@ namespace mongo {
        commend to "commit"
     */
 
+    /* streams _migrateClone batches from the donor on a couple of connections
+       of its own so the network fetches overlap the insert side of the
+       migration.  the queue of pending batches is bounded: a fetcher blocks
+       once maxQueued batches (each capped near BSONObjMaxUserSize by the
+       donor) are waiting, so a slow apply side can't balloon memory. */
+    class MigrateCloneFetcher : boost::noncopyable {
+    public:
+        MigrateCloneFetcher( const string& from , int nThreads , int maxQueued )
+            : _mutex("MigrateCloneFetcher"), _from(from), _maxQueued(maxQueued),
+              _running(0), _failed(false) {
+            for( int i = 0; i < nThreads; i++ ) {
+                _running++;
+                _threads.push_back( shared_ptr<boost::thread>( new boost::thread( boost::bind( &MigrateCloneFetcher::run , this ) ) ) );
+            }
+        }
+
+        ~MigrateCloneFetcher() {
+            {
+                // stops fetchers still running if we unwind early
+                scoped_lock lk(_mutex);
+                _failed = true;
+                _full.notify_all();
+            }
+            for( unsigned i = 0; i < _threads.size(); i++ )
+                _threads[i]->join();
+        }
+
+        /** block for the next batch of cloned objects.  returns false once the
+            donor is drained or a fetch failed; check failed() to distinguish. */
+        bool next( BSONObj& batch ) {
+            scoped_lock lk(_mutex);
+            while ( _queue.empty() && _running > 0 && ! _failed )
+                _empty.wait( lk.boost() );
+            if ( _queue.empty() )
+                return false;
+            batch = _queue.front();
+            _queue.pop_front();
+            _full.notify_one();
+            return true;
+        }
+
+        bool failed( string& errmsg ) const {
+            scoped_lock lk(_mutex);
+            if ( _failed )
+                errmsg = _errmsg;
+            return _failed;
+        }
+
+    private:
+        void run() {
+            Client::initThread( "migrateCloneFetch" );
+            try {
+                ScopedDbConnection conn( _from );
+                while ( 1 ) {
+                    BSONObj res;
+                    if ( ! conn->runCommand( "admin" , BSON( "_migrateClone" << 1 ) , res ) ) {
+                        fail( str::stream() << "_migrateClone failed: " << res.toString() );
+                        break;
+                    }
+
+                    BSONObj arr = res["objects"].Obj().getOwned();
+                    if ( arr.isEmpty() )
+                        break; // donor's clone set is drained
+
+                    scoped_lock lk(_mutex);
+                    while ( (int)_queue.size() >= _maxQueued && ! _failed )
+                        _full.wait( lk.boost() );
+                    if ( _failed )
+                        break;
+                    _queue.push_back( arr );
+                    _empty.notify_one();
+                }
+                conn.done();
+            }
+            catch ( std::exception& e ) {
+                fail( str::stream() << "migrate clone fetcher exception: " << e.what() );
+            }
+            {
+                scoped_lock lk(_mutex);
+                _running--;
+                _empty.notify_all();
+            }
+            cc().shutdown();
+        }
+
+        void fail( const string& m ) {
+            scoped_lock lk(_mutex);
+            if ( ! _failed ) {
+                _failed = true;
+                _errmsg = m;
+            }
+            _full.notify_all();
+            _empty.notify_all();
+        }
+
+        mutable mongo::mutex _mutex;
+        boost::condition _empty; // consumer waits on this for batches
+        boost::condition _full;  // fetchers wait on this while at the bound
+        string _from;
+        int _maxQueued;
+        list<BSONObj> _queue;
+        int _running; // fetcher threads not yet finished
+        bool _failed;
+        string _errmsg;
+        vector< shared_ptr<boost::thread> > _threads;
+    };
+
     class MigrateStatus {
     public:
-        
+
         MigrateStatus() : m_active("MigrateStatus") { active = false; }
 
         void prepare() {
@@ -1282,20 +1435,14 @@ namespace mongo {
                 // 3. initial bulk clone
                 state = CLONE;
 
-                while ( true ) {
-                    BSONObj res;
-                    if ( ! conn->runCommand( "admin" , BSON( "_migrateClone" << 1 ) , res ) ) {
-                        state = FAIL;
-                        errmsg = "_migrateClone failed: ";
-                        errmsg += res.toString();
-                        error() << errmsg << migrateLog;
-                        conn.done();
-                        return;
-                    }
-
-                    BSONObj arr = res["objects"].Obj();
-                    int thisTime = 0;
+                // fetchers stream batches from the donor while we apply, so the
+                // network reads overlap the inserts.  the donor pops each batch
+                // from its clone set under a lock, so concurrent _migrateClone
+                // calls see disjoint documents.
+                MigrateCloneFetcher fetcher( from , 2 /*threads*/ , 3 /*max queued batches*/ );
 
+                BSONObj arr;
+                while ( fetcher.next( arr ) ) {
                     BSONObjIterator i( arr );
                     while( i.more() ) {
                         BSONObj o = i.next().Obj();
@@ -1303,13 +1450,16 @@ namespace mongo {
                             writelock lk( ns );
                             Helpers::upsert( ns , o );
                         }
-                        thisTime++;
                         numCloned++;
                         clonedBytes += o.objsize();
                     }
+                }
 
-                    if ( thisTime == 0 )
-                        break;
+                if ( fetcher.failed( errmsg ) ) {
+                    state = FAIL;
+                    error() << errmsg << migrateLog;
+                    conn.done();
+                    return;
                 }
 
                 timing.done(3);
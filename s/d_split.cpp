@@ -369,6 +369,57 @@ namespace mongo {
                     keyCount = maxChunkObjects;
                 }
                 
+                //
+                // 2.a For a big chunk, estimate the split keys from the btree structure
+                //     instead of visiting every entry.  The key count in [min, max) is
+                //     exact - rangeCount() walks buckets, not entries - and each split
+                //     key is then an O(tree depth) quantile descent that assumes sibling
+                //     subtrees are evenly filled.  Small chunks fall through to the
+                //     entry-by-entry scan below, which is exact and cheap at that size.
+                //
+
+                {
+                    IndexInterface &ii = idx->idxInterface();
+                    const Ordering ordering = Ordering::make( idx->keyPattern() );
+                    const long long rangeKeys = ii.rangeCount( idx->head, ordering, min, true, max, false );
+
+                    if ( rangeKeys > 16384 ) {
+                        long long nSplits = force ? 1 : rangeKeys / ( keyCount + 1 );
+                        if ( maxSplitPoints && nSplits > maxSplitPoints ) {
+                            log() << "limiting split vector to " << maxSplitPoints << " (from " << nSplits << ") split points" << endl;
+                            nSplits = maxSplitPoints;
+                        }
+
+                        Timer estTimer;
+                        for ( long long i = 1; i <= nSplits; i++ ) {
+                            BSONObj k;
+                            if ( ! ii.keyAtApproxQuantile( idx->head, ordering, min, max,
+                                                           (double) i / ( nSplits + 1 ), k ) )
+                                break;
+                            k = k.replaceFieldNames( idx->keyPattern() ).clientReadable().getOwned();
+
+                            // all the instances of a given key value live in the same
+                            // chunk, so a pick repeating the previous one (or the lower
+                            // bound) means that key is too frequent to split at
+                            if ( k.woCompare( min ) == 0 )
+                                continue;
+                            if ( ! splitKeys.empty() && k.woCompare( splitKeys.back() ) == 0 ) {
+                                warning() << "chunk is larger than " << maxChunkSize
+                                          << " bytes because of key " << k << endl;
+                                continue;
+                            }
+
+                            splitKeys.push_back( k );
+                        }
+
+                        log() << "estimated " << splitKeys.size() << " split points over " << rangeKeys
+                              << " keys from btree structure, " << estTimer.millis() << "ms" << endl;
+
+                        result.append( "splitKeys" , splitKeys );
+                        return true;
+                    }
+                }
+
                 //
                 // 2. Traverse the index and add the keyCount-th key to the result vector. If that key
                 //    appeared in the vector before, we omit it. The invariant here is that all the
@@ -827,4 +878,261 @@ namespace mongo {
         }
     } cmdSplitChunk;
 
+    class MergeChunksCommand : public Command {
+    public:
+        MergeChunksCommand() : Command( "mergeChunks" ) {}
+        virtual void help( stringstream& help ) const {
+            help <<
+                 "Merge the contiguous run of this shard's chunks covering [min, max) into one chunk.\n"
+                 "All chunks in the range must live on this shard and have no holes between them.\n"
+                 "example:\n"
+                 " { mergeChunks:\"db.foo\" , min : {a:100} , max: {a:200} , from : \"shardhost:27018\" }";
+        }
+
+        virtual bool slaveOk() const { return false; }
+        virtual bool adminOnly() const { return true; }
+        virtual LockType locktype() const { return NONE; }
+
+        bool run(const string& dbname, BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool fromRepl ) {
+
+            //
+            // 1. check whether parameters passed to mergeChunks are sound
+            //
+
+            const string ns = cmdObj.firstElement().str();
+            if ( ns.empty() ) {
+                errmsg  = "need to specify namespace in command";
+                return false;
+            }
+
+            const BSONObj min = cmdObj["min"].Obj();
+            if ( min.isEmpty() ) {
+                errmsg = "need to specify the min key of the range to merge";
+                return false;
+            }
+
+            const BSONObj max = cmdObj["max"].Obj();
+            if ( max.isEmpty() ) {
+                errmsg = "need to specify the max key of the range to merge";
+                return false;
+            }
+
+            const string from = cmdObj["from"].str();
+            if ( from.empty() ) {
+                errmsg = "need specify server to merge chunks at";
+                return false;
+            }
+
+            if ( ! shardingState.enabled() ) {
+                if ( cmdObj["configdb"].type() != String ) {
+                    errmsg = "sharding not enabled";
+                    return false;
+                }
+                string configdb = cmdObj["configdb"].String();
+                shardingState.enable( configdb );
+                configServer.init( configdb );
+            }
+
+            Shard myShard( from );
+
+            log() << "received mergeChunks request: " << cmdObj << endl;
+
+            //
+            // 2. lock the collection's metadata and gather the run of chunks to merge
+            //
+
+            DistributedLock lockSetup( ConnectionString( shardingState.getConfigServer() , ConnectionString::SYNC) , ns );
+            dist_lock_try dlk;
+
+            try{
+                dlk = dist_lock_try( &lockSetup, string("merge-") + min.toString() );
+            }
+            catch( LockException& e ){
+                errmsg = str::stream() << "Error locking distributed lock for merge." << causedBy( e );
+                return false;
+            }
+
+            if ( ! dlk.got() ) {
+                errmsg = "the collection's metadata lock is taken";
+                result.append( "who" , dlk.other() );
+                return false;
+            }
+
+            ShardChunkVersion maxVersion;
+            string shard;
+            vector<ChunkInfo> chunksToMerge;
+            {
+                ScopedDbConnection conn( shardingState.getConfigServer() );
+
+                BSONObj x = conn->findOne( ShardNS::chunk , Query( BSON( "ns" << ns ) ).sort( BSON( "lastmod" << -1 ) ) );
+                maxVersion = x["lastmod"];
+
+                auto_ptr<DBClientCursor> cursor =
+                    conn->query( ShardNS::chunk ,
+                                 Query( BSON( "ns" << ns << "min" << BSON( "$gte" << min << "$lt" << max ) ) ).sort( BSON( "min" << 1 ) ) );
+                while ( cursor->more() ) {
+                    BSONObj chunk = cursor->next().getOwned();
+                    if ( shard.empty() ) {
+                        shard = chunk["shard"].String();
+                    }
+                    else if ( shard != chunk["shard"].String() ) {
+                        errmsg = str::stream() << "cannot merge, chunks are not all on shard " << shard
+                                               << " (" << chunk["min"].Obj() << " is on " << chunk["shard"].String() << ")";
+                        conn.done();
+                        return false;
+                    }
+                    chunksToMerge.push_back( ChunkInfo( chunk["min"].Obj().getOwned() ,
+                                                        chunk["max"].Obj().getOwned() ,
+                                                        ShardChunkVersion( chunk["lastmod"] ) ) );
+                }
+                conn.done();
+
+                if ( chunksToMerge.size() < 2 ) {
+                    errmsg = str::stream() << "need at least two chunks in " << min << " -->> " << max << " to merge"
+                                           << " (found " << (int) chunksToMerge.size() << ")";
+                    return false;
+                }
+
+                // range has to be covered exactly, with no holes - a hole would mean a chunk
+                // on another shard (or an outdated request) and merging across it would
+                // claim data this shard doesn't own
+                if ( chunksToMerge.front().min.woCompare( min ) != 0 ||
+                     chunksToMerge.back().max.woCompare( max ) != 0 ) {
+                    errmsg = "chunk boundaries are outdated (likely a split or migrate occurred)";
+                    result.append( "currMin" , chunksToMerge.front().min );
+                    result.append( "currMax" , chunksToMerge.back().max );
+                    result.append( "requestedMin" , min );
+                    result.append( "requestedMax" , max );
+                    return false;
+                }
+                for ( size_t i = 1; i < chunksToMerge.size(); i++ ) {
+                    if ( chunksToMerge[i-1].max.woCompare( chunksToMerge[i].min ) != 0 ) {
+                        errmsg = str::stream() << "cannot merge, hole between " << chunksToMerge[i-1].max
+                                               << " and " << chunksToMerge[i].min;
+                        return false;
+                    }
+                }
+
+                if ( shard != myShard.getName() ) {
+                    errmsg = "location is outdated (likely balance or migrate occurred)";
+                    result.append( "from" , myShard.getName() );
+                    result.append( "official" , shard );
+                    return false;
+                }
+
+                if ( maxVersion < shardingState.getVersion( ns ) ) {
+                    errmsg = "official version less than mine?";
+                    result.appendTimestamp( "officialVersion" , maxVersion );
+                    result.appendTimestamp( "myVersion" , shardingState.getVersion( ns ) );
+                    return false;
+                }
+
+                // since this could be the first call that enables sharding, make sure the
+                // chunk manager is up to date
+                shardingState.gotShardName( shard );
+                ShardChunkVersion shardVersion;
+                shardingState.trySetVersion( ns , shardVersion /* will return updated */ );
+
+                log() << "mergeChunks accepted at version " << shardVersion << endl;
+            }
+
+            //
+            // 3. update the metadata via 'applyOps': one update for the surviving (first) chunk
+            //    document and a delete per absorbed chunk, all or nothing
+            //
+
+            ShardChunkVersion myVersion = maxVersion;
+            myVersion.incMinor(); // merges, like splits, only update the 'minor' portion of version
+
+            BSONObjBuilder cmdBuilder;
+            {
+                BSONArrayBuilder updates( cmdBuilder.subarrayStart( "applyOps" ) );
+
+                {
+                    BSONObjBuilder op;
+                    op.append( "op" , "u" );
+                    op.appendBool( "b" , true );
+                    op.append( "ns" , ShardNS::chunk );
+
+                    BSONObjBuilder n( op.subobjStart( "o" ) );
+                    n.append( "_id" , Chunk::genID( ns , min ) );
+                    n.appendTimestamp( "lastmod" , myVersion );
+                    n.append( "ns" , ns );
+                    n.append( "min" , min );
+                    n.append( "max" , max );
+                    n.append( "shard" , shard );
+                    n.done();
+
+                    BSONObjBuilder q( op.subobjStart( "o2" ) );
+                    q.append( "_id" , Chunk::genID( ns , min ) );
+                    q.done();
+
+                    updates.append( op.obj() );
+                }
+
+                for ( size_t i = 1; i < chunksToMerge.size(); i++ ) {
+                    BSONObjBuilder op;
+                    op.append( "op" , "d" );
+                    op.append( "ns" , ShardNS::chunk );
+                    op.append( "o" , BSON( "_id" << Chunk::genID( ns , chunksToMerge[i].min ) ) );
+                    updates.append( op.obj() );
+                }
+
+                updates.done();
+            }
+
+            {
+                BSONArrayBuilder preCond( cmdBuilder.subarrayStart( "preCondition" ) );
+                BSONObjBuilder b;
+                b.append( "ns" , ShardNS::chunk );
+                b.append( "q" , BSON( "query" << BSON( "ns" << ns ) << "orderby" << BSON( "lastmod" << -1 ) ) );
+                {
+                    BSONObjBuilder bb( b.subobjStart( "res" ) );
+                    bb.appendTimestamp( "lastmod" , maxVersion );
+                    bb.done();
+                }
+                preCond.append( b.obj() );
+                preCond.done();
+            }
+
+            BSONObj cmd = cmdBuilder.obj();
+
+            LOG(1) << "mergeChunks update: " << cmd << endl;
+
+            bool ok;
+            BSONObj cmdResult;
+            {
+                ScopedDbConnection conn( shardingState.getConfigServer() );
+                ok = conn->runCommand( "config" , cmd , cmdResult );
+                conn.done();
+            }
+
+            if ( ! ok ) {
+                stringstream ss;
+                ss << "saving merged chunk failed.  cmd: " << cmd << " result: " << cmdResult;
+                error() << ss.str() << endl;
+                msgasserted( 16308 , ss.str() );
+            }
+
+            // install a chunk manager with the absorbed chunks collapsed into one
+            shardingState.mergeChunks( ns , min , max , myVersion );
+
+            //
+            // 4. logChanges
+            //
+
+            BSONObjBuilder logDetail;
+            chunksToMerge.front().appendShortVersion( "firstBefore" , logDetail );
+            chunksToMerge.back().appendShortVersion( "lastBefore" , logDetail );
+            logDetail.append( "number" , (int) chunksToMerge.size() );
+            ChunkInfo( min , max , myVersion ).appendShortVersion( "merged" , logDetail );
+            configServer.logChange( "merge" , ns , logDetail.obj() );
+
+            result.append( "mergedChunks" , (int) chunksToMerge.size() );
+            result.appendTimestamp( "lastmod" , myVersion );
+
+            return true;
+        }
+    } cmdMergeChunks;
+
 }  // namespace mongo
@@ -30,6 +30,8 @@
 #include "../db/jsobj.h"
 #include "../db/db.h"
 #include "../db/replutil.h"
+#include "../db/stats/top.h"
+#include "../util/processinfo.h"
 #include "../client/connpool.h"
 
 #include "../util/queue.h"
@@ -149,6 +151,14 @@ namespace mongo {
         assert( it != _chunks.end() ) ;
         ShardChunkManagerPtr p = it->second;
 
+        // until the donated range is actually removed, reads from clients
+        // that still carry the old version can be answered here - see
+        // readThroughOk()
+        DonateGrace g;
+        g.prevVersion = p->getVersion();
+        g.expires = time( 0 ) + 300; // backstop in case cleanup never runs
+        _donateGrace[ns] = g;
+
         // empty shards should have version 0
         version = ( p->getNumChunks() > 1 ) ? version : ShardChunkVersion( 0 , 0 );
 
@@ -163,6 +173,30 @@ namespace mongo {
         assert( it != _chunks.end() ) ;
         ShardChunkManagerPtr p( it->second->clonePlus( min , max , version ) );
         _chunks[ns] = p;
+
+        // the migration was aborted, so old-version clients are simply current again
+        _donateGrace.erase( ns );
+    }
+
+    bool ShardingState::readThroughOk( const string& ns , const ConfigVersion& clientVersion ) const {
+        scoped_lock lk( _mutex );
+
+        DonateGraceMap::const_iterator it = _donateGrace.find( ns );
+        if ( it == _donateGrace.end() )
+            return false;
+
+        const DonateGrace& g = it->second;
+        if ( time( 0 ) > g.expires )
+            return false;
+
+        // minor bumps (splits) on top of the pre-donation version are fine;
+        // anything older than the donated-away version is genuinely stale
+        return clientVersion.majorVersion() == g.prevVersion.majorVersion();
+    }
+
+    void ShardingState::endDonateGrace( const string& ns ) {
+        scoped_lock lk( _mutex );
+        _donateGrace.erase( ns );
     }
 
     void ShardingState::splitChunk( const string& ns , const BSONObj& min , const BSONObj& max , const vector<BSONObj>& splitKeys ,
@@ -175,6 +209,16 @@ namespace mongo {
         _chunks[ns] = p;
     }
 
+    void ShardingState::mergeChunks( const string& ns , const BSONObj& min , const BSONObj& max ,
+                                     ShardChunkVersion version ) {
+        scoped_lock lk( _mutex );
+
+        ChunkManagersMap::const_iterator it = _chunks.find( ns );
+        assert( it != _chunks.end() ) ;
+        ShardChunkManagerPtr p( it->second->cloneMerged( min , max , version ) );
+        _chunks[ns] = p;
+    }
+
     void ShardingState::resetVersion( const string& ns ) {
         scoped_lock lk( _mutex );
 
@@ -282,6 +326,7 @@ namespace mongo {
 
     ShardedConnectionInfo::ShardedConnectionInfo() {
         _forceVersionOk = false;
+        _rejectedWritesBytes = 0;
         _id.clear();
     }
 
@@ -327,6 +372,34 @@ namespace mongo {
         _id = id;
     }
 
+    void ShardedConnectionInfo::noteRejectedWrite( const BSONObj& info ) {
+        // the mongos on the other end may be partitioned or gone before it
+        // harvests; dropping the overflow loses the write, but that is what
+        // always happened to a rejected fire-and-forget write before this
+        // buffer existed, and better than unbounded memory per connection
+        if ( _rejectedWrites.size() >= MaxRejectedWrites ||
+             _rejectedWritesBytes + info.objsize() > MaxRejectedWritesBytes ) {
+            OCCASIONALLY warning() << "rejected write buffer full ( " << _rejectedWrites.size()
+                                   << " entries , " << _rejectedWritesBytes
+                                   << " bytes ) dropping rejected write for: "
+                                   << info["ns"].valuestrsafe() << endl;
+            return;
+        }
+        _rejectedWrites.push_back( info.getOwned() );
+        _rejectedWritesBytes += info.objsize();
+    }
+
+    void ShardedConnectionInfo::appendRejectedWrites( BSONObjBuilder& b ) {
+        if ( _rejectedWrites.empty() )
+            return;
+        BSONArrayBuilder arr( b.subarrayStart( "rejectedWrites" ) );
+        for ( unsigned i = 0; i < _rejectedWrites.size(); i++ )
+            arr.append( _rejectedWrites[i] );
+        arr.done();
+        _rejectedWrites.clear();
+        _rejectedWritesBytes = 0;
+    }
+
     // -----ShardedConnectionInfo END ----
 
     unsigned long long extractVersion( BSONElement e , string& errmsg ) {
@@ -470,7 +543,7 @@ namespace mongo {
             lastError.disableForCommand();
             ShardedConnectionInfo* info = ShardedConnectionInfo::get( true );
 
-            // make sure we have the mongos id for writebacks
+            // make sure we have the mongos id for diagnostics
             if ( ! checkMongosID( info , cmdObj["serverID"] , errmsg ) ) 
                 return false;
 
@@ -679,11 +752,64 @@ namespace mongo {
 
     } shardingStateCmd;
 
+    /**
+     * load report for the balancer: per collection op rates since the
+     * previous invocation, plus a working set estimate (resident memory).
+     * mongos calls this once per balancing round, so the rate window matches
+     * the round interval.
+     */
+    class ShardLoadStatsCmd : public MongodShardCommand {
+    public:
+        ShardLoadStatsCmd() : MongodShardCommand( "_shardLoadStats" ) ,
+            _m( "ShardLoadStatsCmd" ) , _lastTimeMicros( 0 ) {}
+
+        virtual LockType locktype() const { return NONE; }
+
+        bool run(const string& , BSONObj& cmdObj, int, string& errmsg, BSONObjBuilder& result, bool) {
+            Top::UsageMap now;
+            Top::global.cloneMap( now );
+            unsigned long long t = curTimeMicros64();
+
+            scoped_lock lk( _m );
+            double dt = ( t - _lastTimeMicros ) / 1000000.0;
+
+            bool haveWindow = _lastTimeMicros > 0 && dt > 0;
+            BSONObjBuilder ns( result.subobjStart( "ns" ) );
+            if ( haveWindow ) {
+                for ( Top::UsageMap::const_iterator i = now.begin(); i != now.end(); ++i ) {
+                    long long prev = 0;
+                    Top::UsageMap::const_iterator j = _prev.find( i->first );
+                    if ( j != _prev.end() )
+                        prev = j->second.total.count;
+                    double rate = ( i->second.total.count - prev ) / dt;
+                    if ( rate > 0 )
+                        ns.append( i->first , rate );
+                }
+            }
+            ns.done(); // must close before appending top level fields below
+            if ( haveWindow )
+                result.append( "sinceSec" , dt );
+
+            ProcessInfo pi;
+            if ( pi.supported() )
+                result.append( "residentMB" , pi.getResidentSize() );
+
+            _prev.swap( now );
+            _lastTimeMicros = t;
+            return true;
+        }
+
+    private:
+        mongo::mutex _m; // one snapshot for all callers; in practice only the balancer asks
+        Top::UsageMap _prev;
+        unsigned long long _lastTimeMicros;
+    } shardLoadStatsCmd;
+
     /**
      * @ return true if not in sharded mode
                      or if version for this client is ok
      */
-    bool shardVersionOk( const string& ns , string& errmsg ) {
+    bool shardVersionOk( const string& ns , bool isRead , string& errmsg ) {
         if ( ! shardingState.enabled() )
             return true;
 
@@ -717,6 +843,10 @@ namespace mongo {
 
 
         if ( version == 0 && clientVersion > 0 ) {
+            if ( isRead && shardingState.readThroughOk( ns , clientVersion ) ) {
+                // our last chunk was just donated but its data is still here
+                return true;
+            }
             stringstream ss;
             ss << "collection was dropped or this shard no longer valid version: " << version << " clientVersion: " << clientVersion;
             errmsg = ss.str();
@@ -741,6 +871,14 @@ namespace mongo {
             return true;
         }
 
+        if ( isRead && shardingState.readThroughOk( ns , clientVersion ) ) {
+            // a moveChunk just committed here.  the donated data stays on
+            // this shard until the cleanup thread removes it, so answer the
+            // read instead of bouncing the client a full round trip while
+            // the new config propagates to mongos
+            return true;
+        }
+
         stringstream ss;
         ss << "your version is too old  ns: " + ns << " global: " << version << " client: " << clientVersion;
         errmsg = ss.str();
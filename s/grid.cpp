@@ -379,11 +379,27 @@ namespace mongo {
     }
 
     bool Grid::shouldBalance() const {
-        ShardConnection conn( configServer.getPrimary() , "" );
+        // the balancer marker changes rarely (an admin flipping the switch), so a briefly
+        // stale answer is fine; caching it keeps the migrate check that can follow an
+        // autosplit from reading the config servers on the write path
+        BSONObj balancerDoc;
+        bool cached = false;
+        {
+            scoped_lock lk( _balancerSettingsLock );
+            if ( _balancerSettingsTime > 0 && time(0) - _balancerSettingsTime < 30 ) {
+                balancerDoc = _balancerSettings;
+                cached = true;
+            }
+        }
 
-        // look for the stop balancer marker
-        BSONObj balancerDoc = conn->findOne( ShardNS::settings, BSON( "_id" << "balancer" ) );
-        conn.done();
+        if ( ! cached ) {
+            // look for the stop balancer marker
+            balancerDoc = getConfigSetting( "balancer" ).getOwned();
+
+            scoped_lock lk( _balancerSettingsLock );
+            _balancerSettings = balancerDoc;
+            _balancerSettingsTime = time(0);
+        }
 
         boost::posix_time::ptime now = boost::posix_time::second_clock::local_time();
         if ( _balancerStopped( balancerDoc ) || ! _inBalancingWindow( balancerDoc , now ) ) {
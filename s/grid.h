@@ -33,7 +33,8 @@ namespace mongo {
      */
     class Grid {
     public:
-        Grid() : _lock( "Grid" ) , _allowLocalShard( true ) { }
+        Grid() : _lock( "Grid" ) , _allowLocalShard( true ) ,
+                 _balancerSettingsLock( "Grid::balancerSettings" ) , _balancerSettingsTime( 0 ) { }
 
         /**
          * gets the config the db.
@@ -109,6 +110,12 @@ namespace mongo {
         map<string, DBConfigPtr > _databases;       // maps ns to DBConfig's
         bool                      _allowLocalShard; // can 'localhost' be used in shard addresses?
 
+        // cached copy of config.settings' balancer document, so shouldBalance() doesn't
+        // read the config servers every time; refreshed when older than 30 seconds
+        mutable mongo::mutex      _balancerSettingsLock; // protects the two below
+        mutable BSONObj           _balancerSettings;
+        mutable time_t            _balancerSettingsTime; // when fetched; 0 = never
+
         /**
          * @param name is the chose name for the shard. Parameter is mandatory.
          * @return true if it managed to generate a shard name. May return false if (currently)
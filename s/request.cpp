@@ -22,6 +22,8 @@
 #include "../db/commands.h"
 #include "../db/dbmessage.h"
 #include "../db/stats/counters.h"
+#include "../util/optrace.h"
+#include "../util/timer.h"
 
 #include "../client/connpool.h"
 
@@ -105,6 +107,7 @@ namespace mongo {
     }
 
     void Request::process( int attempt ) {
+        Timer routeTimer; // init() resolves the db config and chunk manager
         init();
         int op = _m.operation();
         assert( op > dbMsg );
@@ -114,6 +117,21 @@ namespace mongo {
             return;
         }
 
+        // sampled tracing: non-query ops carry the id to the shards in their reserved
+        // field so both sides record spans under it (OP_QUERY's leading int is the query
+        // flags, so queries only get the mongos-side spans). retries keep the first id.
+        unsigned traceId = 0;
+        if ( attempt == 0 ) {
+            traceId = OpTraceRing::sample();
+            if ( traceId && op != dbQuery )
+                _d.reservedField() |= (int)( traceId << DbMessage::Reserved_TraceIdShift );
+        }
+        else if ( op != dbQuery ) {
+            traceId = ( (unsigned) _d.reservedField() ) >> DbMessage::Reserved_TraceIdShift;
+        }
+
+        if ( traceId )
+            opTraceRing.record( traceId , "mongos route" , routeTimer.micros() , getns() );
 
         LOG(3) << "Request::process ns: " << getns() << " msg id:" << (int)(_m.header()->id) << " attempt: " << attempt << endl;
 
@@ -127,6 +145,8 @@ namespace mongo {
             _counter = &opsSharded;
         }
 
+        Timer opTimer; // covers the strategy, including the waits on the shards
+
         bool iscmd = false;
         if ( op == dbQuery ) {
             iscmd = isCommand();
@@ -151,9 +171,22 @@ namespace mongo {
         }
         else {
             checkAuth( Auth::WRITE );
+            // a fire-and-forget client may never call getLastError, which is
+            // what normally collects and replays writes a shard rejected for a
+            // stale shard version -- every so often go do that ourselves.
+            // safe to do before routing: once the client has sent this write,
+            // the previous one's getLastError state is unreachable to it anyway
+            bool fromRetry = ( _d.reservedField() & DbMessage::Reserved_FromWriteback ) != 0;
+            if ( ! fromRetry )
+                _clientInfo->harvestRejectedWrites();
             s->writeOp( op, *this );
+            if ( ! fromRetry )
+                _clientInfo->noteUnsafeWrite();
         }
 
+        if ( traceId )
+            opTraceRing.record( traceId , opToString( op ) , opTimer.micros() , getns() );
+
         globalOpCounters.gotOp( op , iscmd );
         _counter->gotOp( op , iscmd );
     }
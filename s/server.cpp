@@ -118,11 +118,29 @@ namespace mongo {
                     replyToQuery( ResultFlag_ErrSet, p , m , err );
                 }
             }
+
+            if ( releaseConnectionsAfterResponse ) {
+                ClientInfo* ci = ClientInfo::get();
+                int op = m.operation();
+                if ( op == dbInsert || op == dbUpdate || op == dbDelete ) {
+                    // the client may follow with a getLastError, which has to
+                    // run on the sockets that took the writes -- keep them
+                    ci->pinShardConns();
+                }
+                if ( ! ci->shardConnsPinned() )
+                    ShardConnection::releaseMyConnections();
+            }
         }
 
         virtual void disconnected( AbstractMessagingPort* p ) {
             // all things are thread local
         }
+
+        virtual void destroyConnectionState() {
+            // the thread may serve another client connection, and ClientInfo
+            // remembers the remote address (see newRequest)
+            ClientInfo::resetThread();
+        }
     };
 
     void sighandler(int sig) {
@@ -220,6 +238,7 @@ int _main(int argc, char* argv[]) {
     ( "ipv6", "enable IPv6 support (disabled by default)" )
     ( "jsonp","allow JSONP access via http (has security implications)" )
     ("noscripting", "disable scripting engine")
+    ("releaseConnectionsAfterResponse", "return cached shard connections to the pool after each response, trading some pool contention for far fewer sockets" )
     ;
 
     options.add(sharding_options);
@@ -262,6 +281,10 @@ int _main(int argc, char* argv[]) {
         cmdLine.jsonp = true;
     }
 
+    if ( params.count( "releaseConnectionsAfterResponse" ) ) {
+        releaseConnectionsAfterResponse = true;
+    }
+
     if ( params.count( "test" ) ) {
         logLevel = 5;
         UnitTest::runTests();
@@ -319,6 +342,9 @@ int _main(int argc, char* argv[]) {
 
     shardConnectionPool.addHook( new ShardingConnectionHook( true ) );
     shardConnectionPool.setName( "mongos shardconnection connectionpool" );
+    // keep a couple of warm connections per shard so the first requests after
+    // a restart or a pool trim don't pay connect latency
+    shardConnectionPool.setTargetAvailable( 2 );
 
     
     DBClientConnection::setLazyKillCursor( false );
@@ -353,7 +353,9 @@ namespace mongo {
     ShardStatus::ShardStatus( const Shard& shard , const BSONObj& obj )
         : _shard( shard ) {
         _mapped = obj.getFieldDotted( "mem.mapped" ).numberLong();
-        _hasOpsQueued = obj["writeBacksQueued"].Bool();
+        // only pre-2.1 shards report this; newer ones reject stale writes for
+        // mongos to retry instead of queueing them
+        _hasOpsQueued = obj["writeBacksQueued"].trueValue();
         _writeLock = 0; // TODO
     }
 
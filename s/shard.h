@@ -204,7 +204,7 @@ namespace mongo {
     private:
         Shard _shard;
         long long _mapped;
-        bool _hasOpsQueued;  // true if 'writebacks' are pending
+        bool _hasOpsQueued;  // true if a pre-2.1 shard has 'writebacks' pending
         double _writeLock;
     };
 
@@ -263,6 +263,11 @@ namespace mongo {
         /** checks all of my thread local connections for the version of this ns */
         static void checkMyConnectionVersions( const string & ns );
 
+        /** returns all of this thread's cached shard connections to the shared
+            pool.  only call when no un-fetched write results can be pending on
+            them (a getLastError must run on the socket that took the write). */
+        static void releaseMyConnections();
+
     private:
         void _init();
         void _finishInit();
@@ -278,6 +283,12 @@ namespace mongo {
 
     extern DBConnectionPool shardConnectionPool;
 
+    /** mongos mode: hand the thread's shard connections back to the pool after
+        each response instead of caching one per shard per thread for the life
+        of the thread.  collapses socket counts from threads x shards to about
+        active ops x shards. */
+    extern bool releaseConnectionsAfterResponse;
+
     class ShardingConnectionHook : public DBConnectionHook {
     public:
 
@@ -23,7 +23,6 @@
 #include "grid.h"
 #include "util.h"
 #include "shard.h"
-#include "writeback_listener.h"
 
 #include "shard_version.h"
 
@@ -116,8 +115,6 @@ namespace mongo {
 
     bool initShardVersion( DBClientBase& conn_in, BSONObj& result ){
 
-        WriteBackListener::init( conn_in );
-
         DBClientBase* conn = getVersionable( &conn_in );
         assert( conn ); // errors thrown above
 
@@ -169,8 +166,6 @@ namespace mongo {
     bool checkShardVersion( DBClientBase& conn_in , const string& ns , bool authoritative , int tryNumber ) {
         // TODO: cache, optimize, etc...
 
-        WriteBackListener::init( conn_in );
-
         DBConfigPtr conf = grid.getDBConfig( ns );
         if ( ! conf )
             return false;
@@ -58,6 +58,8 @@ namespace mongo {
 
     DBConnectionPool shardConnectionPool;
 
+    bool releaseConnectionsAfterResponse = false;
+
     /**
      * holds all the actual db connections for a client to various servers
      * 1 per thread, so doesn't have to be thread safe
@@ -166,6 +168,22 @@ namespace mongo {
             shardConnectionPool.release( addr , conn );
         }
 
+        /** hand every cached connection back to the shared pool.  without this
+            a mongos holds threads x shards sockets even when idle; with it the
+            socket count tracks concurrently active operations instead.  shard
+            version state travels with the connection object, so a connection
+            is as good as any other once it is back in the pool. */
+        void releaseAll() {
+            for ( HostMap::iterator i=_hosts.begin(); i!=_hosts.end(); ++i ) {
+                Status* ss = i->second;
+                assert( ss );
+                if ( ss->avail ) {
+                    release( i->first , ss->avail );
+                    ss->avail = 0;
+                }
+            }
+        }
+
         void _check( const string& ns ) {
             if ( ns.size() == 0 || _seenNS.count( ns ) )
                 return;
@@ -264,6 +282,10 @@ namespace mongo {
         ClientConnections::threadInstance()->checkVersions( ns );
     }
 
+    void ShardConnection::releaseMyConnections() {
+        ClientConnections::threadInstance()->releaseAll();
+    }
+
     ShardConnection::~ShardConnection() {
         if ( _conn ) {
             if ( ! _conn->isFailed() ) {
@@ -24,7 +24,6 @@
 #include "grid.h"
 #include "request.h"
 #include "server.h"
-#include "writeback_listener.h"
 
 #include "strategy.h"
 
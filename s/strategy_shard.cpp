@@ -123,7 +123,8 @@ namespace mongo {
 
         void _insert( Request& r , DbMessage& d, ChunkManagerPtr manager ) {
             const int flags = d.reservedField() | InsertOption_ContinueOnError; // ContinueOnError is always on when using sharding.
-            map<ChunkPtr, vector<BSONObj> > insertsForChunk; // Group bulk insert for appropriate shards
+            map<Shard, vector<BSONObj> > insertsForShard; // coalesce into one wire message per shard, not per chunk
+            map<ChunkPtr, int> bytesForChunk; // but keep the autosplit tally per chunk
             try {
                 while ( d.moreJSObjs() ) {
                     BSONObj o = d.nextJsObj();
@@ -148,26 +149,24 @@ namespace mongo {
 
                     // Many operations benefit from having the shard key early in the object
                     o = manager->getShardKey().moveToFront(o);
-                    insertsForChunk[manager->findChunk(o)].push_back(o);
+                    ChunkPtr c = manager->findChunk( o );
+                    insertsForShard[c->getShard()].push_back(o);
+                    bytesForChunk[c] += o.objsize();
                 }
-                for (map<ChunkPtr, vector<BSONObj> >::iterator it = insertsForChunk.begin(); it != insertsForChunk.end(); ++it) {
-                    ChunkPtr c = it->first;
-                    vector<BSONObj> objs = it->second;
+                for (map<Shard, vector<BSONObj> >::iterator it = insertsForShard.begin(); it != insertsForShard.end(); ++it) {
+                    const Shard& shard = it->first;
+                    vector<BSONObj>& objs = it->second;
                     const int maxTries = 30;
 
                     bool gotThrough = false;
                     for ( int i=0; i<maxTries; i++ ) {
                         try {
-                            LOG(4) << "  server:" << c->getShard().toString() << " bulk insert " << objs.size() << " documents" << endl;
-                            insert( c->getShard() , r.getns() , objs , flags);
+                            LOG(4) << "  server:" << shard.toString() << " bulk insert " << objs.size() << " documents" << endl;
+                            insert( shard , r.getns() , objs , flags);
 
-                            int bytesWritten = 0;
                             for (vector<BSONObj>::iterator vecIt = objs.begin(); vecIt != objs.end(); ++vecIt) {
                                 r.gotInsert(); // Record the correct number of individual inserts
-                                bytesWritten += (*vecIt).objsize();
                             }
-                            if ( r.getClientInfo()->autoSplitOk() )
-                                c->splitIfShould( bytesWritten );
                             gotThrough = true;
                             break;
                         }
@@ -182,7 +181,7 @@ namespace mongo {
                             }
 
                             unsigned long long old = manager->getSequenceNumber();
-                            
+
                             LOG( logLevel ) << "  sequence number - old: " << old << " new: " << manager->getSequenceNumber() << endl;
                         }
                         sleepmillis( i * 20 );
@@ -190,6 +189,12 @@ namespace mongo {
 
                     assert( inShutdown() || gotThrough ); // not caught below
                 }
+
+                if ( r.getClientInfo()->autoSplitOk() ) {
+                    for (map<ChunkPtr, int>::iterator it = bytesForChunk.begin(); it != bytesForChunk.end(); ++it) {
+                        it->first->splitIfShould( it->second );
+                    }
+                }
             } catch (const UserException&){
                 if (!d.moreJSObjs()){
                     throw;
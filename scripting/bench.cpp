@@ -20,9 +20,12 @@
 #include "engine.h"
 #include "../util/md5.hpp"
 #include "../util/version.h"
+#include "../util/histogram.h"
+#include "../util/time_support.h"
 #include "../client/dbclient.h"
 #include "../client/connpool.h"
 #include <pcrecpp.h>
+#include <cmath>
 
 // ---------------------------------
 // ---- benchmarking system --------
@@ -59,12 +62,26 @@ namespace mongo {
             hideErrors = false;
             hideResults = true;
 
+            targetRate = 0;
+            warmupSeconds = 0;
+            recording = true;
+
             active = true;
             threadsReady = 0;
             error = false;
             errCount = 0;
             throwGLE = false;
             breakOnTrap = true;
+
+            opCount = 0;
+            totalLatencyMicros = 0;
+            maxLatencyMicros = 0;
+
+            Histogram::Options hopts;
+            hopts.numBuckets = 26;
+            hopts.bucketSize = 16; // micros; exponential: 16us .. ~537s
+            hopts.exponential = true;
+            latency.reset( new Histogram( hopts ) );
         }
 
         string host;
@@ -73,6 +90,10 @@ namespace mongo {
         unsigned parallel;
         double seconds;
 
+        int targetRate;        // total ops/sec across all threads; 0 = flat out
+        double warmupSeconds;  // run this long before recording anything
+        volatile bool recording; // false until warmup has elapsed
+
         bool hideResults;
         bool handleErrors;
         bool hideErrors;
@@ -96,6 +117,50 @@ namespace mongo {
         mongo::mutex _mutex;
         long long errCount;
         BSONArrayBuilder trapped;
+
+        // latency capture, all under _mutex
+        shared_ptr<Histogram> latency;
+        long long opCount;
+        long long totalLatencyMicros;
+        long long maxLatencyMicros;
+
+        void recordLatency( long long micros ) {
+            if ( ! recording )
+                return;
+            scoped_lock lock( _mutex );
+            opCount++;
+            totalLatencyMicros += micros;
+            if ( micros > maxLatencyMicros )
+                maxLatencyMicros = micros;
+            latency->insert( micros > 0xffffffffLL ? 0xffffffffU : (boost::uint32_t) micros );
+        }
+
+        /** percentile answers are bucket upper bounds, so they err high */
+        long long latencyPercentile( double q ) const {
+            long long target = (long long)( q * opCount );
+            long long seen = 0;
+            for ( unsigned i = 0; i < latency->getBucketsNum(); i++ ) {
+                seen += latency->getCount( i );
+                if ( seen >= target )
+                    return latency->getBoundary( i );
+            }
+            return maxLatencyMicros;
+        }
+
+        BSONObj latencyReport() {
+            scoped_lock lock( _mutex );
+            BSONObjBuilder b;
+            b.append( "note" , "times in microseconds; percentiles are histogram bucket bounds" );
+            b.appendNumber( "ops" , opCount );
+            if ( opCount > 0 ) {
+                b.appendNumber( "avg" , totalLatencyMicros / opCount );
+                b.appendNumber( "max" , maxLatencyMicros );
+                b.appendNumber( "p50" , latencyPercentile( .50 ) );
+                b.appendNumber( "p90" , latencyPercentile( .90 ) );
+                b.appendNumber( "p99" , latencyPercentile( .99 ) );
+            }
+            return b.obj();
+        }
     };
 
     static bool _hasSpecial( const BSONObj& obj ) {
@@ -129,6 +194,19 @@ namespace mongo {
             int x = min + ( rand() % ( max - min ) );
             b.append( e.fieldName() , x );
         }
+        else if ( str::equals( "#ZIPF_INT" , f.fieldName() ) ) {
+            BSONObjIterator i( f.Obj() );
+            int min = i.next().numberInt();
+            int max = i.next().numberInt();
+
+            // zipf (s=1) by inverting P(x <= r) = log(r)/log(n): values near
+            // min are hot and each decade of the range gets equal total
+            // traffic, which is close to most production key popularity curves
+            int n = max - min;
+            double u = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 );
+            int x = (int) exp( u * log( (double) n ) ); // 1..n
+            b.append( e.fieldName() , min + x - 1 );
+        }
         else {
             uasserted( 14811 , str::stream() << "invalid bench dynamic piece: " << f.fieldName() );
         }
@@ -166,238 +244,298 @@ namespace mongo {
     }
 
 
-    static void _benchThread( BenchRunConfig * config, ScopedDbConnection& conn ){
+    /** execute one op from the workload.  @return false if the thread should stop. */
+    static bool _benchRunOp( BenchRunConfig * config , ScopedDbConnection& conn , const BSONElement& e , long long& count ) {
 
-        long long count = 0;
-        while ( config->active ) {
-            BSONObjIterator i( config->ops );
-            while ( i.more() ) {
-                BSONElement e = i.next();
-
-                string ns = e["ns"].String();
-                string op = e["op"].String();
+        string ns = e["ns"].String();
+        string op = e["op"].String();
 
-                int delay = e["delay"].eoo() ? 0 : e["delay"].Int();
+        int delay = e["delay"].eoo() ? 0 : e["delay"].Int();
 
-                auto_ptr<Scope> scope;
-                ScriptingFunction scopeFunc = 0;
-                BSONObj scopeObj;
+        auto_ptr<Scope> scope;
+        ScriptingFunction scopeFunc = 0;
+        BSONObj scopeObj;
 
-                bool check = ! e["check"].eoo();
-                if( check ){
-                    if ( e["check"].type() == CodeWScope || e["check"].type() == Code || e["check"].type() == String ) {
-                        scope = globalScriptEngine->getPooledScope( ns );
-                        assert( scope.get() );
-
-                        if ( e.type() == CodeWScope ) {
-                            scopeFunc = scope->createFunction( e["check"].codeWScopeCode() );
-                            scopeObj = BSONObj( e.codeWScopeScopeData() );
-                        }
-                        else {
-                            scopeFunc = scope->createFunction( e["check"].valuestr() );
-                        }
+        bool check = ! e["check"].eoo();
+        if( check ){
+            if ( e["check"].type() == CodeWScope || e["check"].type() == Code || e["check"].type() == String ) {
+                scope = globalScriptEngine->getPooledScope( ns );
+                assert( scope.get() );
 
-                        scope->init( &scopeObj );
-                        assert( scopeFunc );
-                    }
-                    else {
-                        warning() << "Invalid check type detected in benchRun op : " << e << endl;
-                        check = false;
-                    }
+                if ( e.type() == CodeWScope ) {
+                    scopeFunc = scope->createFunction( e["check"].codeWScopeCode() );
+                    scopeObj = BSONObj( e.codeWScopeScopeData() );
+                }
+                else {
+                    scopeFunc = scope->createFunction( e["check"].valuestr() );
                 }
 
-                try {
-                    if ( op == "findOne" ) {
-
-                        BSONObj result = conn->findOne( ns , fixQuery( e["query"].Obj() ) );
+                scope->init( &scopeObj );
+                assert( scopeFunc );
+            }
+            else {
+                warning() << "Invalid check type detected in benchRun op : " << e << endl;
+                check = false;
+            }
+        }
 
-                        if( check ){
-                            int err = scope->invoke( scopeFunc , 0 , &result,  1000 * 60 , false );
-                            if( err ){
-                                log() << "Error checking in benchRun thread [findOne]" << causedBy( scope->getError() ) << endl;
-                                return;
-                            }
-                        }
+        try {
+            if ( op == "findOne" ) {
 
-                        if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [findOne] : " << result << endl;
+                BSONObj result = conn->findOne( ns , fixQuery( e["query"].Obj() ) );
 
+                if( check ){
+                    int err = scope->invoke( scopeFunc , 0 , &result,  1000 * 60 , false );
+                    if( err ){
+                        log() << "Error checking in benchRun thread [findOne]" << causedBy( scope->getError() ) << endl;
+                        return false;
                     }
-                    else if ( op == "command" ) {
-
-                        BSONObj result;
-                        // TODO
-                        /* bool ok = */ conn->runCommand( ns , /* fixQuery( */ e["command"].Obj() /* ) */, result, e["options"].numberInt() );
-
-                        if( check ){
-                            int err = scope->invoke( scopeFunc , 0 , &result,  1000 * 60 , false );
-                            if( err ){
-                                log() << "Error checking in benchRun thread [command]" << causedBy( scope->getError() ) << endl;
-                                return;
-                            }
-                        }
+                }
 
-                        if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [command] : " << result << endl;
+                if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [findOne] : " << result << endl;
 
+            }
+            else if ( op == "command" ) {
+
+                BSONObj result;
+                // TODO
+                /* bool ok = */ conn->runCommand( ns , /* fixQuery( */ e["command"].Obj() /* ) */, result, e["options"].numberInt() );
+
+                if( check ){
+                    int err = scope->invoke( scopeFunc , 0 , &result,  1000 * 60 , false );
+                    if( err ){
+                        log() << "Error checking in benchRun thread [command]" << causedBy( scope->getError() ) << endl;
+                        return false;
                     }
-                    else if( op == "find" || op == "query" ) {
+                }
 
-                        int limit = e["limit"].eoo() ? 0 : e["limit"].numberInt();
-                        int skip = e["skip"].eoo() ? 0 : e["skip"].Int();
-                        int options = e["options"].eoo() ? 0 : e["options"].Int();
-                        int batchSize = e["batchSize"].eoo() ? 0 : e["batchSize"].Int();
-                        BSONObj filter = e["filter"].eoo() ? BSONObj() : e["filter"].Obj();
+                if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [command] : " << result << endl;
 
-                        auto_ptr<DBClientCursor> cursor = conn->query( ns, fixQuery( e["query"].Obj() ), limit, skip, &filter, options, batchSize );
+            }
+            else if( op == "find" || op == "query" ) {
 
-                        int count = cursor->itcount();
+                int limit = e["limit"].eoo() ? 0 : e["limit"].numberInt();
+                int skip = e["skip"].eoo() ? 0 : e["skip"].Int();
+                int options = e["options"].eoo() ? 0 : e["options"].Int();
+                int batchSize = e["batchSize"].eoo() ? 0 : e["batchSize"].Int();
+                BSONObj filter = e["filter"].eoo() ? BSONObj() : e["filter"].Obj();
 
-                        if( check ){
-                            BSONObj thisValue = BSON( "count" << count );
-                            int err = scope->invoke( scopeFunc , 0 , &thisValue, 1000 * 60 , false );
-                            if( err ){
-                                log() << "Error checking in benchRun thread [find]" << causedBy( scope->getError() ) << endl;
-                                return;
-                            }
-                        }
+                auto_ptr<DBClientCursor> cursor = conn->query( ns, fixQuery( e["query"].Obj() ), limit, skip, &filter, options, batchSize );
 
-                        if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [query] : " << count << endl;
+                int count = cursor->itcount();
 
+                if( check ){
+                    BSONObj thisValue = BSON( "count" << count );
+                    int err = scope->invoke( scopeFunc , 0 , &thisValue, 1000 * 60 , false );
+                    if( err ){
+                        log() << "Error checking in benchRun thread [find]" << causedBy( scope->getError() ) << endl;
+                        return false;
                     }
-                    else if( op == "update" ) {
+                }
 
-                        bool multi = e["multi"].trueValue();
-                        bool upsert = e["upsert"].trueValue();
-                        BSONObj query = e["query"].eoo() ? BSONObj() : e["query"].Obj();
-                        BSONObj update = e["update"].Obj();
+                if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [query] : " << count << endl;
 
-                        conn->update( ns, fixQuery( query ), update, multi, upsert );
+            }
+            else if( op == "update" ) {
 
-                        bool safe = e["safe"].trueValue();
-                        if( safe ){
-                            BSONObj result = conn->getLastErrorDetailed();
+                bool multi = e["multi"].trueValue();
+                bool upsert = e["upsert"].trueValue();
+                BSONObj query = e["query"].eoo() ? BSONObj() : e["query"].Obj();
+                BSONObj update = e["update"].Obj();
 
-                            if( check ){
-                                int err = scope->invoke( scopeFunc , 0 , &result, 1000 * 60 , false );
-                                if( err ){
-                                    log() << "Error checking in benchRun thread [update]" << causedBy( scope->getError() ) << endl;
-                                    return;
-                                }
-                            }
+                conn->update( ns, fixQuery( query ), update, multi, upsert );
 
-                            if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [safe update] : " << result << endl;
+                bool safe = e["safe"].trueValue();
+                if( safe ){
+                    BSONObj result = conn->getLastErrorDetailed();
 
-                            if( ! result["err"].eoo() && result["err"].type() == String && ( config->throwGLE || e["throwGLE"].trueValue() ) )
-                                throw DBException( (string)"From benchRun GLE" + causedBy( result["err"].String() ),
-                                                   result["code"].eoo() ? 0 : result["code"].Int() );
+                    if( check ){
+                        int err = scope->invoke( scopeFunc , 0 , &result, 1000 * 60 , false );
+                        if( err ){
+                            log() << "Error checking in benchRun thread [update]" << causedBy( scope->getError() ) << endl;
+                            return false;
                         }
                     }
-                    else if( op == "insert" ) {
 
-                        conn->insert( ns, fixQuery( e["doc"].Obj() ) );
+                    if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [safe update] : " << result << endl;
 
-                        bool safe = e["safe"].trueValue();
-                        if( safe ){
-                            BSONObj result = conn->getLastErrorDetailed();
+                    if( ! result["err"].eoo() && result["err"].type() == String && ( config->throwGLE || e["throwGLE"].trueValue() ) )
+                        throw DBException( (string)"From benchRun GLE" + causedBy( result["err"].String() ),
+                                           result["code"].eoo() ? 0 : result["code"].Int() );
+                }
+            }
+            else if( op == "insert" ) {
 
-                            if( check ){
-                                int err = scope->invoke( scopeFunc , 0 , &result, 1000 * 60 , false );
-                                if( err ){
-                                    log() << "Error checking in benchRun thread [insert]" << causedBy( scope->getError() ) << endl;
-                                    return;
-                                }
-                            }
+                conn->insert( ns, fixQuery( e["doc"].Obj() ) );
 
-                            if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [safe insert] : " << result << endl;
+                bool safe = e["safe"].trueValue();
+                if( safe ){
+                    BSONObj result = conn->getLastErrorDetailed();
 
-                            if( ! result["err"].eoo() && result["err"].type() == String && ( config->throwGLE || e["throwGLE"].trueValue() ) )
-                                throw DBException( (string)"From benchRun GLE" + causedBy( result["err"].String() ),
-                                                   result["code"].eoo() ? 0 : result["code"].Int() );
+                    if( check ){
+                        int err = scope->invoke( scopeFunc , 0 , &result, 1000 * 60 , false );
+                        if( err ){
+                            log() << "Error checking in benchRun thread [insert]" << causedBy( scope->getError() ) << endl;
+                            return false;
                         }
                     }
-                    else if( op == "delete" || op == "remove" ) {
 
-                        bool multi = e["multi"].eoo() ? true : e["multi"].trueValue();
-                        BSONObj query = e["query"].eoo() ? BSONObj() : e["query"].Obj();
+                    if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [safe insert] : " << result << endl;
 
-                        conn->remove( ns, fixQuery( query ), ! multi );
+                    if( ! result["err"].eoo() && result["err"].type() == String && ( config->throwGLE || e["throwGLE"].trueValue() ) )
+                        throw DBException( (string)"From benchRun GLE" + causedBy( result["err"].String() ),
+                                           result["code"].eoo() ? 0 : result["code"].Int() );
+                }
+            }
+            else if( op == "delete" || op == "remove" ) {
 
-                        bool safe = e["safe"].trueValue();
-                        if( safe ){
-                            BSONObj result = conn->getLastErrorDetailed();
+                bool multi = e["multi"].eoo() ? true : e["multi"].trueValue();
+                BSONObj query = e["query"].eoo() ? BSONObj() : e["query"].Obj();
 
-                            if( check ){
-                                int err = scope->invoke( scopeFunc , 0 , &result, 1000 * 60 , false );
-                                if( err ){
-                                    log() << "Error checking in benchRun thread [delete]" << causedBy( scope->getError() ) << endl;
-                                    return;
-                                }
-                            }
+                conn->remove( ns, fixQuery( query ), ! multi );
 
-                            if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [safe remove] : " << result << endl;
+                bool safe = e["safe"].trueValue();
+                if( safe ){
+                    BSONObj result = conn->getLastErrorDetailed();
 
-                            if( ! result["err"].eoo() && result["err"].type() == String && ( config->throwGLE || e["throwGLE"].trueValue() ) )
-                                throw DBException( (string)"From benchRun GLE " + causedBy( result["err"].String() ),
-                                                   result["code"].eoo() ? 0 : result["code"].Int() );
+                    if( check ){
+                        int err = scope->invoke( scopeFunc , 0 , &result, 1000 * 60 , false );
+                        if( err ){
+                            log() << "Error checking in benchRun thread [delete]" << causedBy( scope->getError() ) << endl;
+                            return false;
                         }
                     }
-                    else if ( op == "createIndex" ) {
-                        conn->ensureIndex( ns , e["key"].Obj() , false , "" , false );
-                    }
-                    else if ( op == "dropIndex" ) {
-                        conn->dropIndex( ns , e["key"].Obj()  );
-                    }
-                    else {
-                        log() << "don't understand op: " << op << endl;
-                        config->error = true;
-                        return;
-                    }
-                }
-                catch( DBException& ex ){
-                    if( ! config->hideErrors || e["showError"].trueValue() ){
 
-                        bool yesWatch = ( config->watchPattern && config->watchPattern->FullMatch( ex.what() ) );
-                        bool noWatch = ( config->noWatchPattern && config->noWatchPattern->FullMatch( ex.what() ) );
+                    if( ! config->hideResults || e["showResult"].trueValue() ) log() << "Result from benchRun thread [safe remove] : " << result << endl;
 
-                        if( ( ! config->watchPattern && config->noWatchPattern && ! noWatch ) || // If we're just ignoring things
-                            ( ! config->noWatchPattern && config->watchPattern && yesWatch ) || // If we're just watching things
-                            ( config->watchPattern && config->noWatchPattern && yesWatch && ! noWatch ) )
-                            log() << "Error in benchRun thread for op " << e << causedBy( ex ) << endl;
-                    }
+                    if( ! result["err"].eoo() && result["err"].type() == String && ( config->throwGLE || e["throwGLE"].trueValue() ) )
+                        throw DBException( (string)"From benchRun GLE " + causedBy( result["err"].String() ),
+                                           result["code"].eoo() ? 0 : result["code"].Int() );
+                }
+            }
+            else if ( op == "createIndex" ) {
+                conn->ensureIndex( ns , e["key"].Obj() , false , "" , false );
+            }
+            else if ( op == "dropIndex" ) {
+                conn->dropIndex( ns , e["key"].Obj()  );
+            }
+            else {
+                log() << "don't understand op: " << op << endl;
+                config->error = true;
+                return false;
+            }
+        }
+        catch( DBException& ex ){
+            if( ! config->hideErrors || e["showError"].trueValue() ){
 
-                    bool yesTrap = ( config->trapPattern && config->trapPattern->FullMatch( ex.what() ) );
-                    bool noTrap = ( config->noTrapPattern && config->noTrapPattern->FullMatch( ex.what() ) );
+                bool yesWatch = ( config->watchPattern && config->watchPattern->FullMatch( ex.what() ) );
+                bool noWatch = ( config->noWatchPattern && config->noWatchPattern->FullMatch( ex.what() ) );
 
-                    if( ( ! config->trapPattern && config->noTrapPattern && ! noTrap ) ||
-                        ( ! config->noTrapPattern && config->trapPattern && yesTrap ) ||
-                        ( config->trapPattern && config->noTrapPattern && yesTrap && ! noTrap ) ){
-                        {
-                            scoped_lock lock( config->_mutex );
-                            config->trapped.append( BSON( "error" << ex.what() << "op" << e << "count" << count ) );
-                        }
-                        if( config->breakOnTrap ) return;
-                    }
-                    if( ! config->handleErrors && ! e["handleError"].trueValue() ) return;
+                if( ( ! config->watchPattern && config->noWatchPattern && ! noWatch ) || // If we're just ignoring things
+                    ( ! config->noWatchPattern && config->watchPattern && yesWatch ) || // If we're just watching things
+                    ( config->watchPattern && config->noWatchPattern && yesWatch && ! noWatch ) )
+                    log() << "Error in benchRun thread for op " << e << causedBy( ex ) << endl;
+            }
 
-                    {
-                        scoped_lock lock( config->_mutex );
-                        config->errCount++;
-                    }
-                }
-                catch( ... ){
-                    if( ! config->hideErrors || e["showError"].trueValue() ) log() << "Error in benchRun thread caused by unknown error for op " << e << endl;
-                    if( ! config->handleErrors && ! e["handleError"].trueValue() ) return;
+            bool yesTrap = ( config->trapPattern && config->trapPattern->FullMatch( ex.what() ) );
+            bool noTrap = ( config->noTrapPattern && config->noTrapPattern->FullMatch( ex.what() ) );
 
-                    {
-                        scoped_lock lock( config->_mutex );
-                        config->errCount++;
-                    }
+            if( ( ! config->trapPattern && config->noTrapPattern && ! noTrap ) ||
+                ( ! config->noTrapPattern && config->trapPattern && yesTrap ) ||
+                ( config->trapPattern && config->noTrapPattern && yesTrap && ! noTrap ) ){
+                {
+                    scoped_lock lock( config->_mutex );
+                    config->trapped.append( BSON( "error" << ex.what() << "op" << e << "count" << count ) );
                 }
+                if( config->breakOnTrap ) return false;
+            }
+            if( ! config->handleErrors && ! e["handleError"].trueValue() ) return false;
 
-                count++;
-                sleepmillis( delay );
+            {
+                scoped_lock lock( config->_mutex );
+                config->errCount++;
+            }
+        }
+        catch( ... ){
+            if( ! config->hideErrors || e["showError"].trueValue() ) log() << "Error in benchRun thread caused by unknown error for op " << e << endl;
+            if( ! config->handleErrors && ! e["handleError"].trueValue() ) return false;
 
+            {
+                scoped_lock lock( config->_mutex );
+                config->errCount++;
             }
         }
+
+        count++;
+        sleepmillis( delay );
+        return true;
+    }
+
+    static void _benchThread( BenchRunConfig * config, ScopedDbConnection& conn ){
+
+        // weights: if any op carries one, each iteration runs a single op
+        // drawn with probability proportional to its weight (unweighted ops
+        // count as 1).  otherwise ops run in sequence as they always have.
+        vector<BSONElement> ops;
+        double totalWeight = 0;
+        bool weighted = false;
+        {
+            BSONObjIterator i( config->ops );
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                ops.push_back( e );
+                totalWeight += e["weight"].eoo() ? 1 : e["weight"].number();
+                if ( ! e["weight"].eoo() )
+                    weighted = true;
+            }
+        }
+        if ( ops.empty() )
+            return;
+
+        // rate shaping: each thread owns an equal share of the target rate
+        // and schedules ops on a fixed cadence.  latency is measured from the
+        // scheduled start rather than the actual send, so a stalled server
+        // shows up as slow ops instead of silently fewer ops (the coordinated
+        // omission problem).
+        long long intervalMicros = 0;
+        if ( config->targetRate > 0 )
+            intervalMicros = (long long)( 1000000.0 * config->parallel / config->targetRate );
+
+        long long scheduled = (long long) curTimeMicros64();
+        long long count = 0;
+        unsigned cur = 0;
+
+        while ( config->active ) {
+            unsigned idx;
+            if ( weighted ) {
+                double r = ( rand() / ( RAND_MAX + 1.0 ) ) * totalWeight;
+                idx = 0;
+                while ( idx + 1 < ops.size() ) {
+                    r -= ops[idx]["weight"].eoo() ? 1 : ops[idx]["weight"].number();
+                    if ( r <= 0 )
+                        break;
+                    idx++;
+                }
+            }
+            else {
+                idx = cur++ % ops.size();
+            }
+
+            if ( intervalMicros ) {
+                scheduled += intervalMicros;
+                long long now = (long long) curTimeMicros64();
+                if ( now < scheduled )
+                    sleepmicros( scheduled - now );
+            }
+            else {
+                scheduled = (long long) curTimeMicros64();
+            }
+
+            if ( ! _benchRunOp( config , conn , ops[idx] , count ) )
+                return;
+
+            config->recordLatency( (long long) curTimeMicros64() - scheduled );
+        }
     }
 
     static void benchThread( BenchRunConfig * config ) {
@@ -448,6 +586,10 @@ namespace mongo {
                 config.parallel = args["parallel"].numberInt();
             if ( args["seconds"].isNumber() )
                 config.seconds = args["seconds"].numberInt();
+            if ( args["rate"].isNumber() )
+                config.targetRate = args["rate"].numberInt();
+            if ( args["warmup"].isNumber() )
+                config.warmupSeconds = args["warmup"].number();
             if ( ! args["hideResults"].eoo() )
                 config.hideResults = args["hideResults"].trueValue();
             if ( ! args["handleErrors"].eoo() )
@@ -488,7 +630,10 @@ namespace mongo {
             conn = shared_ptr< ScopedDbConnection >( new ScopedDbConnection( config.host ) );
 
             // Get initial stats
-            conn->get()->simpleCommand( "admin" , &before , "serverStatus" );
+            if ( config.warmupSeconds > 0 )
+                config.recording = false;
+            else
+                conn->get()->simpleCommand( "admin" , &before , "serverStatus" );
 
             // Start threads
             for ( unsigned i = 0; i < config.parallel; i++ )
@@ -497,6 +642,14 @@ namespace mongo {
             // Give them time to init
             while ( config.threadsReady < config.parallel ) sleepmillis( 1 );
 
+            if ( config.warmupSeconds > 0 ) {
+                // measurement starts after warmup; the baseline stats are
+                // sampled then too so ops/sec excludes warmup traffic
+                sleepmillis( (long long)( 1000 * config.warmupSeconds ) );
+                conn->get()->simpleCommand( "admin" , &before , "serverStatus" );
+                config.recording = true;
+            }
+
         }
 
         void done(){
@@ -555,6 +708,7 @@ namespace mongo {
             buf.append( "note" , "values per second" );
             buf.append( "errCount", (long long) runner->config.errCount );
             buf.append( "trapped", runner->config.trapped.arr() );
+            buf.append( "latency" , runner->config.latencyReport() );
             {
                 BSONObjIterator i( after );
                 while ( i.more() ) {
@@ -587,7 +741,18 @@ namespace mongo {
 
 
     /**
-     * benchRun( { ops : [] , host : XXX , db : XXXX , parallel : 5 , seconds : 5 }
+     * benchRun( { ops : [] , host : XXX , db : XXXX , parallel : 5 , seconds : 5 ,
+     *             rate : 10000 , warmup : 5 } )
+     *
+     * optional:
+     *   rate    - target total ops/sec across threads; omit to run flat out
+     *   warmup  - seconds to run before stats and latencies start recording
+     *   per op: weight : 19 - run ops in proportion to weight instead of in
+     *           sequence (unweighted ops count as 1)
+     *   in queries/docs: { "#ZIPF_INT" : [ min , max ] } draws hot keys near
+     *           min on a zipf curve; { "#RAND_INT" : [ min , max ] } stays uniform
+     *
+     * results include a 'latency' subdocument with avg/max/p50/p90/p99 micros.
      */
     BSONObj benchRun( const BSONObj& argsFake, void* data ) {
         assert( argsFake.firstElement().isABSONObj() );
@@ -606,7 +771,13 @@ namespace mongo {
             config.parallel = args["parallel"].numberInt();
         if ( args["seconds"].isNumber() )
             config.seconds = args["seconds"].number();
-
+        if ( args["rate"].isNumber() )
+            config.targetRate = args["rate"].numberInt();
+        if ( args["warmup"].isNumber() ) {
+            config.warmupSeconds = args["warmup"].number();
+            if ( config.warmupSeconds > 0 )
+                config.recording = false;
+        }
 
         config.ops = args["ops"].Obj();
 
@@ -623,6 +794,11 @@ namespace mongo {
         while ( config.threadsReady < config.parallel )
             sleepmillis( 1 );
 
+        if ( config.warmupSeconds > 0 ) {
+            sleepmillis( (long long)( 1000 * config.warmupSeconds ) );
+            config.recording = true;
+        }
+
         BSONObj before;
         conn->simpleCommand( "admin" , &before , "serverStatus" );
 
@@ -663,6 +839,7 @@ namespace mongo {
                 buf.append( e.fieldName() , x );
             }
         }
+        buf.append( "latency" , config.latencyReport() );
         BSONObj zoo = buf.obj();
         return BSON( "" << zoo );
     }
@@ -18,6 +18,7 @@
 #include "pch.h"
 #include "engine.h"
 #include "../util/file.h"
+#include "../util/background.h"
 #include "../client/dbclient.h"
 
 namespace mongo {
@@ -269,6 +270,15 @@ namespace mongo {
 
         ScopeCache() : _mutex("ScopeCache") {
             _magic = 17;
+
+            // a recycled scope keeps its compiled-function cache (see
+            // Scope::createFunction), so how long scopes live decides how often
+            // $where/map-reduce code gets recompiled.  scale the pool with the
+            // machine instead of hardcoding for a small box.
+            unsigned cores = boost::thread::hardware_concurrency();
+            if ( cores < 1 )
+                cores = 1;
+            _maxPerPool = cores > 10 ? cores : 10;
         }
 
         ~ScopeCache() {
@@ -286,11 +296,19 @@ namespace mongo {
             list<Scope*> & l = _pools[pool];
             bool oom = s->hasOutOfMemoryException();
 
-            // do not keep too many contexts, or use them for too long
-            if ( l.size() > 10 || s->getTimeUsed() > 100 || oom ) {
+            // do not keep too many contexts, or ones that have accumulated too
+            // much state.  long-lived scopes are what keep compiled functions
+            // warm, so recycle them for a long time and gc periodically instead
+            // of throwing the function cache away after a handful of uses.
+            if ( l.size() > _maxPerPool ||
+                 s->getTimeUsed() > maxScopeReuse ||
+                 s->numCachedFunctions() > maxCachedFunctions ||
+                 oom ) {
                 delete s;
             }
             else {
+                if ( s->getTimeUsed() % gcInterval == 0 )
+                    s->gc();
                 l.push_back( s );
                 s->reset();
             }
@@ -331,8 +349,14 @@ namespace mongo {
         }
 
     private:
+        enum { maxScopeReuse = 10000 ,      // retire a scope after this many uses
+               maxCachedFunctions = 1000 ,  // ... or this many distinct compiled functions
+               gcInterval = 64              // gc a recycled scope every n uses
+             };
+
         PoolToScopes _pools;
         mongo::mutex _mutex;
+        unsigned _maxPerPool;
         int _magic;
     };
 
@@ -463,12 +487,79 @@ namespace mongo {
         Scope * _real;
     };
 
+    /* cold scope construction for v8 means a new isolate, fresh object templates
+       and a full installDBTypes pass - several milliseconds.  rather than paying
+       that inside a $where or map-reduce whenever a thread's pool is empty, this
+       job keeps a few blank scopes prebuilt and restocks after each take, so a
+       pool miss costs a mutex and a pop.  only started for engines whose scopes
+       can cross threads (ScriptEngine::scopesCrossThreads). */
+    class SpareScopeKeeper : public BackgroundJob {
+    public:
+        SpareScopeKeeper( ScriptEngine * engine )
+            : _engine( engine ) , _mutex( "SpareScopeKeeper" ) {
+            unsigned cores = boost::thread::hardware_concurrency();
+            _target = cores < 2 ? 2 : ( cores > 4 ? 4 : cores );
+        }
+
+        virtual string name() const { return "SpareScopeKeeper"; }
+
+        /** @return a prebuilt blank scope, or 0 if the stash is empty */
+        Scope * take() {
+            scoped_lock lk( _mutex );
+            if ( _spares.empty() )
+                return 0;
+            Scope * s = _spares.back();
+            _spares.pop_back();
+            _restock.notify_one();
+            return s;
+        }
+
+        virtual void run() {
+            while ( ! inShutdown() ) {
+                Scope * s = 0;
+                try {
+                    s = _engine->newScope();
+                }
+                catch ( std::exception& e ) {
+                    log() << "spare scope build failed: " << e.what() << endl;
+                    sleepsecs( 1 );
+                    continue;
+                }
+                scoped_lock lk( _mutex );
+                _spares.push_back( s );
+                while ( _spares.size() >= _target && ! inShutdown() )
+                    _restock.wait( lk.boost() );
+            }
+        }
+
+    private:
+        ScriptEngine * _engine;
+        mongo::mutex _mutex;
+        boost::condition _restock;
+        unsigned _target;
+        vector<Scope*> _spares;
+    };
+
+    static SpareScopeKeeper * spareScopeKeeper = 0;
+    static mongo::mutex spareScopeKeeperMutex( "spareScopeKeeperStart" );
+
     auto_ptr<Scope> ScriptEngine::getPooledScope( const string& pool ) {
         if ( ! scopeCache.get() ) {
             scopeCache.reset( new ScopeCache() );
         }
 
         Scope * s = scopeCache->get( pool );
+        if ( ! s && scopesCrossThreads() ) {
+            {
+                scoped_lock lk( spareScopeKeeperMutex );
+                if ( ! spareScopeKeeper ) {
+                    // lives for the life of the process, like the engine itself
+                    spareScopeKeeper = new SpareScopeKeeper( this );
+                    spareScopeKeeper->go();
+                }
+            }
+            s = spareScopeKeeper->take();
+        }
         if ( ! s ) {
             s = newScope();
         }
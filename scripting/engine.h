@@ -138,6 +138,12 @@ namespace mongo {
         /** gets the number of times a scope was used */
         int getTimeUsed() { return _numTimeUsed; }
 
+        /** number of functions in this scope's compiled-function cache.  the
+            cache (see createFunction) survives reset() on all engines, so a
+            pooled scope only pays compilation the first time it sees a given
+            piece of code. */
+        size_t numCachedFunctions() const { return _cachedFunctions.size(); }
+
     protected:
 
         virtual ScriptingFunction _createFunction( const char * code ) = 0;
@@ -173,6 +179,12 @@ namespace mongo {
 
         virtual bool utf8Ok() const = 0;
 
+        /** true if this engine's scopes may be constructed on one thread and used
+            on another.  engines that can say yes (v8 - every entry point takes the
+            isolate's locker) get cold scope construction moved off the query path;
+            see the spare scope keeper in engine.cpp. */
+        virtual bool scopesCrossThreads() const { return false; }
+
         static void setup();
 
         /** gets a scope from the pool or a new one if pool is empty
@@ -114,6 +114,12 @@ namespace mongo {
     }
 
     static Handle<v8::Value> namedGetRO(Local<v8::String> name, const v8::AccessorInfo &info) {
+      // the object is read only so a real property can only be our own cache of a
+      // previous decode - return it rather than converting the field again
+      Handle<v8::Value> cached = info.This()->GetRealNamedProperty(name);
+      if (!cached.IsEmpty() && !cached->IsUndefined())
+          return cached;
+
       string key = toSTLString(name);
       BSONObj *obj = unwrapBSONObj(info.Holder());
       BSONElement elmt = obj->getField(key.c_str());
@@ -122,6 +128,9 @@ namespace mongo {
       Local< External > scp = External::Cast( *info.Data() );
       V8Scope* scope = (V8Scope*)(scp->Value());
       Handle<v8::Value> val = scope->mongoToV8Element(elmt, true);
+      // DontEnum so enumeration still comes solely from namedEnumerator and the
+      // cached copy never shows up twice in a for-in
+      info.This()->ForceSet(name, val, DontEnum);
       return val;
     }
 
@@ -219,6 +219,10 @@ namespace mongo {
 
         bool utf8Ok() const { return true; }
 
+        /** each V8Scope has its own isolate and relocks it on every entry, so a
+            scope prebuilt on the spare-scope thread is safe to hand to a worker */
+        virtual bool scopesCrossThreads() const { return true; }
+
         class V8UnlockForClient : public Unlocker {
             V8Unlock u_;
         };
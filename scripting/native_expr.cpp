@@ -0,0 +1,547 @@
+// native_expr.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+#include "native_expr.h"
+#include "engine.h"
+
+#include <cmath>
+
+namespace mongo {
+
+    bool NativeExpr::Value::truthy() const {
+        switch ( type ) {
+        case TMissing:
+        case TNull:
+            return false;
+        case TBool:
+            return b;
+        case TNumber:
+            return n != 0 && n == n; // 0, -0 and NaN are falsy
+        case TString:
+            return ! s.empty();
+        }
+        return false;
+    }
+
+    bool NativeExpr::evalBool( const BSONObj& doc , bool& ok ) const {
+        ok = true;
+        Value v = eval( doc , ok );
+        if ( ! ok )
+            return false;
+        return v.truthy();
+    }
+
+    namespace {
+
+        typedef NativeExpr::Value Value;
+
+        Value numberValue( double n ) {
+            Value v;
+            v.type = Value::TNumber;
+            v.n = n;
+            return v;
+        }
+
+        Value boolValue( bool b ) {
+            Value v;
+            v.type = Value::TBool;
+            v.b = b;
+            return v;
+        }
+
+        bool allAscii( const string& s ) {
+            for ( size_t i = 0; i < s.size(); i++ )
+                if ( (unsigned char)s[i] >= 0x80 )
+                    return false;
+            return true;
+        }
+
+        bool nullish( const Value& v ) {
+            return v.type == Value::TMissing || v.type == Value::TNull;
+        }
+
+        bool sameTypeEq( const Value& l , const Value& r ) {
+            switch ( l.type ) {
+            case Value::TMissing:
+            case Value::TNull:
+                return true;
+            case Value::TBool:
+                return l.b == r.b;
+            case Value::TNumber:
+                return l.n == r.n; // NaN != NaN, as in js
+            case Value::TString:
+                return l.s == r.s;
+            }
+            return false;
+        }
+
+        /** js ==, without the coercions: mixed non-nullish types bail out */
+        bool looseEq( const Value& l , const Value& r , bool& ok ) {
+            if ( l.type == r.type )
+                return sameTypeEq( l , r );
+            if ( nullish( l ) && nullish( r ) )
+                return true;  // null == undefined
+            if ( nullish( l ) || nullish( r ) )
+                return false; // null/undefined never == a real value
+            ok = false; // js would coerce (e.g. 1 == '1') - use the engine
+            return false;
+        }
+
+        bool strictEq( const Value& l , const Value& r ) {
+            if ( l.type != r.type )
+                return false;
+            return sameTypeEq( l , r );
+        }
+
+        // ---- expression nodes ----
+
+        /** a this.x.y / obj.x.y reference */
+        class FieldExpr : public NativeExpr {
+        public:
+            FieldExpr( const vector<string>& parts ) : _parts( parts ) {}
+        protected:
+            virtual Value eval( const BSONObj& doc , bool& ok ) const {
+                BSONObj cur = doc;
+                BSONElement e;
+                for ( unsigned i = 0; i < _parts.size(); i++ ) {
+                    e = cur.getField( _parts[i] );
+                    if ( i + 1 == _parts.size() )
+                        break;
+                    if ( e.type() != Object ) {
+                        // js throws on member access through a non-object
+                        // (and array access works differently) - let the
+                        // engine produce the real behavior
+                        ok = false;
+                        return Value();
+                    }
+                    cur = e.embeddedObject();
+                }
+
+                Value v;
+                switch ( e.type() ) {
+                case EOO:
+                case Undefined:
+                    v.type = Value::TMissing;
+                    break;
+                case jstNULL:
+                    v.type = Value::TNull;
+                    break;
+                case NumberDouble:
+                case NumberInt:
+                case NumberLong:
+                    v.type = Value::TNumber;
+                    v.n = e.number();
+                    break;
+                case Bool:
+                    v.type = Value::TBool;
+                    v.b = e.boolean();
+                    break;
+                case String:
+                case Symbol:
+                    v.type = Value::TString;
+                    v.s = string( e.valuestr() , e.valuestrsize() - 1 );
+                    break;
+                default:
+                    ok = false; // dates, arrays, subobjects, ... go to js
+                }
+                return v;
+            }
+        private:
+            vector<string> _parts;
+        };
+
+        class LitExpr : public NativeExpr {
+        public:
+            LitExpr( const Value& v ) : _v( v ) {}
+        protected:
+            virtual Value eval( const BSONObj& , bool& ) const { return _v; }
+        private:
+            Value _v;
+        };
+
+        class UnaryExpr : public NativeExpr {
+        public:
+            UnaryExpr( char op , NativeExpr * e ) : _op( op ) , _e( e ) {}
+        protected:
+            virtual Value eval( const BSONObj& doc , bool& ok ) const {
+                Value v = _e->eval( doc , ok );
+                if ( ! ok )
+                    return Value();
+                if ( _op == '!' )
+                    return boolValue( ! v.truthy() );
+                // unary +/- : numbers only, js would coerce anything else
+                if ( v.type != Value::TNumber ) {
+                    ok = false;
+                    return Value();
+                }
+                return numberValue( _op == '-' ? -v.n : v.n );
+            }
+        private:
+            char _op;
+            scoped_ptr<NativeExpr> _e;
+        };
+
+        class BinExpr : public NativeExpr {
+        public:
+            enum Op { AND , OR , EQ , NE , SEQ , SNE , LT , LE , GT , GE , ADD , SUB , MUL , DIV , MOD };
+
+            BinExpr( Op op , NativeExpr * l , NativeExpr * r ) : _op( op ) , _l( l ) , _r( r ) {}
+
+        protected:
+            virtual Value eval( const BSONObj& doc , bool& ok ) const {
+                Value l = _l->eval( doc , ok );
+                if ( ! ok )
+                    return Value();
+
+                // js && and || return an operand, not a bool
+                if ( _op == AND )
+                    return l.truthy() ? _r->eval( doc , ok ) : l;
+                if ( _op == OR )
+                    return l.truthy() ? l : _r->eval( doc , ok );
+
+                Value r = _r->eval( doc , ok );
+                if ( ! ok )
+                    return Value();
+
+                switch ( _op ) {
+                case EQ:  return boolValue(   looseEq( l , r , ok ) );
+                case NE:  return boolValue( ! looseEq( l , r , ok ) );
+                case SEQ: return boolValue(   strictEq( l , r ) );
+                case SNE: return boolValue( ! strictEq( l , r ) );
+
+                case LT: case LE: case GT: case GE: {
+                    if ( l.type == Value::TNumber && r.type == Value::TNumber ) {
+                        switch ( _op ) {
+                        case LT: return boolValue( l.n <  r.n );
+                        case LE: return boolValue( l.n <= r.n );
+                        case GT: return boolValue( l.n >  r.n );
+                        default: return boolValue( l.n >= r.n );
+                        }
+                    }
+                    if ( l.type == Value::TString && r.type == Value::TString &&
+                         allAscii( l.s ) && allAscii( r.s ) ) {
+                        // byte order matches js code unit order for ascii only
+                        int c = l.s.compare( r.s );
+                        switch ( _op ) {
+                        case LT: return boolValue( c <  0 );
+                        case LE: return boolValue( c <= 0 );
+                        case GT: return boolValue( c >  0 );
+                        default: return boolValue( c >= 0 );
+                        }
+                    }
+                    ok = false; // js relational coercion (null >= 0 is true...)
+                    return Value();
+                }
+
+                default: { // arithmetic
+                    if ( l.type != Value::TNumber || r.type != Value::TNumber ) {
+                        ok = false; // js would concatenate or coerce
+                        return Value();
+                    }
+                    switch ( _op ) {
+                    case ADD: return numberValue( l.n + r.n );
+                    case SUB: return numberValue( l.n - r.n );
+                    case MUL: return numberValue( l.n * r.n );
+                    case DIV: return numberValue( l.n / r.n );
+                    default:  return numberValue( fmod( l.n , r.n ) );
+                    }
+                }
+                }
+            }
+
+        private:
+            Op _op;
+            scoped_ptr<NativeExpr> _l;
+            scoped_ptr<NativeExpr> _r;
+        };
+
+        // ---- parser (recursive descent, js precedence) ----
+
+        class WhereParser {
+        public:
+            WhereParser( const char * code ) : _p( code ) {}
+
+            NativeExpr * parse() {
+                skip();
+                auto_ptr<NativeExpr> e;
+                if ( peekWord( "function" ) ) {
+                    eatWord( "function" );
+                    if ( ! eat( '(' ) )
+                        return 0;
+                    if ( ! eat( ')' ) ) // parameters -> not our subset
+                        return 0;
+                    if ( ! eat( '{' ) )
+                        return 0;
+                    if ( ! eatWord( "return" ) )
+                        return 0;
+                    e.reset( parseOr() );
+                    if ( ! e.get() )
+                        return 0;
+                    eat( ';' ); // optional
+                    if ( ! eat( '}' ) )
+                        return 0;
+                }
+                else {
+                    e.reset( parseOr() );
+                    if ( ! e.get() )
+                        return 0;
+                    eat( ';' ); // tolerate a trailing semicolon
+                }
+                skip();
+                if ( *_p )
+                    return 0; // trailing junk - not our subset
+                return e.release();
+            }
+
+        private:
+
+            void skip() { _p = jsSkipWhiteSpace( _p ); }
+
+            bool eat( char c ) {
+                skip();
+                if ( *_p != c )
+                    return false;
+                _p++;
+                return true;
+            }
+
+            static bool identStart( char c ) { return isalpha( (unsigned char)c ) || c == '_' || c == '$'; }
+            static bool identChar( char c ) { return identStart( c ) || isdigit( (unsigned char)c ); }
+
+            bool peekWord( const char * w ) {
+                skip();
+                size_t len = strlen( w );
+                return strncmp( _p , w , len ) == 0 && ! identChar( _p[len] );
+            }
+
+            bool eatWord( const char * w ) {
+                if ( ! peekWord( w ) )
+                    return false;
+                _p += strlen( w );
+                return true;
+            }
+
+            string readIdent() {
+                skip();
+                string s;
+                if ( ! identStart( *_p ) )
+                    return s;
+                while ( identChar( *_p ) )
+                    s += *_p++;
+                return s;
+            }
+
+            NativeExpr * parseOr() {
+                auto_ptr<NativeExpr> l( parseAnd() );
+                while ( l.get() ) {
+                    skip();
+                    if ( _p[0] != '|' || _p[1] != '|' )
+                        break;
+                    _p += 2;
+                    auto_ptr<NativeExpr> r( parseAnd() );
+                    if ( ! r.get() )
+                        return 0;
+                    l.reset( new BinExpr( BinExpr::OR , l.release() , r.release() ) );
+                }
+                return l.release();
+            }
+
+            NativeExpr * parseAnd() {
+                auto_ptr<NativeExpr> l( parseCmp() );
+                while ( l.get() ) {
+                    skip();
+                    if ( _p[0] != '&' || _p[1] != '&' )
+                        break;
+                    _p += 2;
+                    auto_ptr<NativeExpr> r( parseCmp() );
+                    if ( ! r.get() )
+                        return 0;
+                    l.reset( new BinExpr( BinExpr::AND , l.release() , r.release() ) );
+                }
+                return l.release();
+            }
+
+            NativeExpr * parseCmp() {
+                auto_ptr<NativeExpr> l( parseAdd() );
+                if ( ! l.get() )
+                    return 0;
+                skip();
+
+                BinExpr::Op op;
+                if      ( strncmp( _p , "===" , 3 ) == 0 ) { op = BinExpr::SEQ; _p += 3; }
+                else if ( strncmp( _p , "!==" , 3 ) == 0 ) { op = BinExpr::SNE; _p += 3; }
+                else if ( strncmp( _p , "==" , 2 ) == 0 )  { op = BinExpr::EQ;  _p += 2; }
+                else if ( strncmp( _p , "!=" , 2 ) == 0 )  { op = BinExpr::NE;  _p += 2; }
+                else if ( strncmp( _p , "<=" , 2 ) == 0 )  { op = BinExpr::LE;  _p += 2; }
+                else if ( strncmp( _p , ">=" , 2 ) == 0 )  { op = BinExpr::GE;  _p += 2; }
+                else if ( *_p == '<' )                     { op = BinExpr::LT;  _p += 1; }
+                else if ( *_p == '>' )                     { op = BinExpr::GT;  _p += 1; }
+                else
+                    return l.release();
+
+                auto_ptr<NativeExpr> r( parseAdd() );
+                if ( ! r.get() )
+                    return 0;
+                return new BinExpr( op , l.release() , r.release() );
+            }
+
+            NativeExpr * parseAdd() {
+                auto_ptr<NativeExpr> l( parseMul() );
+                while ( l.get() ) {
+                    skip();
+                    char c = *_p;
+                    // leave += ++ -= -- alone
+                    if ( ( c != '+' && c != '-' ) || _p[1] == '=' || _p[1] == c )
+                        break;
+                    _p++;
+                    auto_ptr<NativeExpr> r( parseMul() );
+                    if ( ! r.get() )
+                        return 0;
+                    l.reset( new BinExpr( c == '+' ? BinExpr::ADD : BinExpr::SUB , l.release() , r.release() ) );
+                }
+                return l.release();
+            }
+
+            NativeExpr * parseMul() {
+                auto_ptr<NativeExpr> l( parseUnary() );
+                while ( l.get() ) {
+                    skip();
+                    char c = *_p;
+                    if ( ( c != '*' && c != '/' && c != '%' ) || _p[1] == '=' )
+                        break;
+                    _p++;
+                    auto_ptr<NativeExpr> r( parseUnary() );
+                    if ( ! r.get() )
+                        return 0;
+                    BinExpr::Op op = c == '*' ? BinExpr::MUL : ( c == '/' ? BinExpr::DIV : BinExpr::MOD );
+                    l.reset( new BinExpr( op , l.release() , r.release() ) );
+                }
+                return l.release();
+            }
+
+            NativeExpr * parseUnary() {
+                skip();
+                char c = *_p;
+                if ( ( c == '!' && _p[1] != '=' ) || c == '-' || c == '+' ) {
+                    _p++;
+                    NativeExpr * e = parseUnary();
+                    if ( ! e )
+                        return 0;
+                    return new UnaryExpr( c , e );
+                }
+                return parsePrimary();
+            }
+
+            NativeExpr * parsePrimary() {
+                skip();
+                char c = *_p;
+
+                if ( c == '(' ) {
+                    _p++;
+                    auto_ptr<NativeExpr> e( parseOr() );
+                    if ( ! e.get() || ! eat( ')' ) )
+                        return 0;
+                    return e.release();
+                }
+
+                if ( c == '\'' || c == '"' )
+                    return parseStringLit();
+
+                if ( isdigit( (unsigned char)c ) || ( c == '.' && isdigit( (unsigned char)_p[1] ) ) ) {
+                    char * end = 0;
+                    double d = strtod( _p , &end );
+                    if ( end == _p )
+                        return 0;
+                    _p = end;
+                    return new LitExpr( numberValue( d ) );
+                }
+
+                if ( ! identStart( c ) )
+                    return 0;
+
+                string id = readIdent();
+                if ( id == "true" )
+                    return new LitExpr( boolValue( true ) );
+                if ( id == "false" )
+                    return new LitExpr( boolValue( false ) );
+                if ( id == "null" ) {
+                    Value v;
+                    v.type = Value::TNull;
+                    return new LitExpr( v );
+                }
+                if ( id == "undefined" )
+                    return new LitExpr( Value() );
+
+                if ( id != "this" && id != "obj" )
+                    return 0; // free variables, function calls, ... -> js
+
+                vector<string> parts;
+                while ( eat( '.' ) ) {
+                    string part = readIdent();
+                    if ( part.empty() )
+                        return 0;
+                    parts.push_back( part );
+                }
+                if ( parts.empty() ) // bare this/obj
+                    return 0;
+                return new FieldExpr( parts );
+            }
+
+            NativeExpr * parseStringLit() {
+                char quote = *_p++;
+                string s;
+                while ( *_p && *_p != quote ) {
+                    char c = *_p++;
+                    if ( c == '\\' ) {
+                        switch ( *_p++ ) {
+                        case '\\': c = '\\'; break;
+                        case '\'': c = '\''; break;
+                        case '"':  c = '"';  break;
+                        case '/':  c = '/';  break;
+                        case 'n':  c = '\n'; break;
+                        case 't':  c = '\t'; break;
+                        case 'r':  c = '\r'; break;
+                        default:
+                            return 0; // \uXXXX etc - not our subset
+                        }
+                    }
+                    s += c;
+                }
+                if ( *_p != quote )
+                    return 0; // unterminated
+                _p++;
+                Value v;
+                v.type = Value::TString;
+                v.s = s;
+                return new LitExpr( v );
+            }
+
+            const char * _p;
+        };
+
+    } // namespace
+
+    NativeExpr * NativeExpr::parseWhere( const char * code ) {
+        if ( ! code || ! *code )
+            return 0;
+        WhereParser p( code );
+        return p.parse();
+    }
+
+}
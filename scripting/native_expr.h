@@ -0,0 +1,73 @@
+// native_expr.h
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "../pch.h"
+#include "../db/jsobj.h"
+
+namespace mongo {
+
+    /**
+     * Native evaluator for a small, safe subset of javascript expressions, so
+     * common $where clauses can run directly over BSONElement values instead of
+     * converting every document into a js object.
+     *
+     * Supported: field references off this/obj (dotted), number/string/bool/null
+     * literals, ! && ||, the comparison operators, and + - * / % on numbers.
+     * parseWhere() returns NULL for anything else; eval() reports via its ok
+     * flag when a particular document uses values the subset doesn't cover
+     * (e.g. mixed-type coercing comparisons), so the caller can fall back to
+     * the real js engine for that document only.
+     */
+    class NativeExpr : boost::noncopyable {
+    public:
+        virtual ~NativeExpr() {}
+
+        /**
+         * evaluate against doc as a boolean, js truthiness rules.
+         * @param ok cleared if the expression can't be evaluated natively for
+         *           this document; the return value is then meaningless
+         */
+        bool evalBool( const BSONObj& doc , bool& ok ) const;
+
+        /**
+         * parse $where source: either a bare expression or
+         * function() { return <expr>; }
+         * @return the compiled expression, or NULL if the code falls outside
+         *         the supported subset (caller keeps using the js engine)
+         */
+        static NativeExpr * parseWhere( const char * code );
+
+        // runtime value; anything outside these types bails out to js
+        struct Value {
+            enum Type { TMissing , TNull , TBool , TNumber , TString } type;
+            bool b;
+            double n;
+            string s;
+
+            Value() : type( TMissing ) , b( false ) , n( 0 ) {}
+            bool truthy() const; // js ToBoolean
+        };
+
+    protected:
+        NativeExpr() {}
+        virtual Value eval( const BSONObj& doc , bool& ok ) const = 0;
+    };
+
+}
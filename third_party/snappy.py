@@ -8,7 +8,8 @@ def configure( env , fileLists , options ):
     
     files = ["third_party/snappy/snappy.cc", "third_party/snappy/snappy-sinksource.cc"]
 
-    fileLists["serverOnlyFiles"] += [ myenv.Object(f) for f in files ]
+    # in commonFiles since the messaging layer (wire compression) uses snappy too
+    fileLists["commonFiles"] += [ myenv.Object(f) for f in files ]
 
 def configureSystem( env , fileLists , options ):
     configure( env , fileLists , options )
@@ -19,6 +19,7 @@
 #include "../pch.h"
 #include "../client/dbclient.h"
 #include "../db/db.h"
+#include "../util/compress.h"
 #include "tool.h"
 
 #include <fcntl.h>
@@ -44,7 +45,12 @@ public:
         ("oplog", "Use oplog for point-in-time snapshotting" )
         ("repair", "try to recover a crashed database" )
         ("forceTableScan", "force a table scan (do not use $snapshot)" )
+        ("parallel,j", po::value<int>(), "number of collections to dump concurrently (network dumps only)" )
+        ("compress", "snappy compress output files (written as <collection>.bson.snappy)" )
         ;
+        _usingMongos = false;
+        _compress = false;
+        _dumpThreads = 1;
     }
 
     virtual void preSetup() {
@@ -60,32 +66,64 @@ public:
         out << "Export MongoDB data to BSON files.\n" << endl;
     }
 
-    // This is a functor that writes a BSONObj to a file
+    // This is a functor that writes a BSONObj to a file.
+    // When a compression buffer is supplied, whole objects are accumulated
+    // and written as snappy blocks: 4 byte little endian compressed length,
+    // then the compressed bytes.  blocks always end on an object boundary so
+    // a reader can decompress and iterate block by block.  the buffer is
+    // owned by the caller because boost::function copies its functors.
     struct Writer {
-        Writer(FILE* out, ProgressMeter* m) :_out(out), _m(m) {}
+        Writer(FILE* out, ProgressMeter* m, string* compressBuf = NULL) :_out(out), _m(m), _compressBuf(compressBuf) {}
 
         void operator () (const BSONObj& obj) {
-            size_t toWrite = obj.objsize();
+            if (_compressBuf) {
+                _compressBuf->append( obj.objdata() , obj.objsize() );
+                if (_compressBuf->size() >= 1024 * 1024) // compression block size
+                    flushBlock();
+            }
+            else {
+                _write( obj.objdata() , obj.objsize() );
+            }
+
+            // if there's a progress bar, hit it
+            if (_m) {
+                _m->hit();
+            }
+        }
+
+        /** compress and write out whatever is buffered.  call when done. */
+        void flushBlock() {
+            if ( !_compressBuf || _compressBuf->empty() )
+                return;
+            string compressed;
+            mongo::compress( _compressBuf->data() , _compressBuf->size() , &compressed );
+            int len = (int)compressed.size();
+            _write( (const char*)&len , 4 );
+            _write( compressed.data() , compressed.size() );
+            _compressBuf->clear();
+        }
+
+        void _write( const char* data , size_t toWrite ) {
             size_t written = 0;
 
             while (toWrite) {
-                size_t ret = fwrite( obj.objdata()+written, 1, toWrite, _out );
+                size_t ret = fwrite( data+written, 1, toWrite, _out );
                 uassert(14035, errnoWithPrefix("couldn't write to file"), ret);
                 toWrite -= ret;
                 written += ret;
             }
-
-            // if there's a progress bar, hit it
-            if (_m) {
-                _m->hit();
-            }
         }
 
         FILE* _out;
         ProgressMeter* _m;
+        string* _compressBuf;
     };
 
     void doCollection( const string coll , FILE* out , ProgressMeter *m ) {
+        doCollection( coll , conn( true ) , out , m );
+    }
+
+    void doCollection( const string coll , DBClientBase& connBase , FILE* out , ProgressMeter *m ) {
         Query q = _query;
 
         int queryOptions = QueryOption_SlaveOk | QueryOption_NoCursorTimeout;
@@ -93,9 +131,9 @@ public:
             queryOptions |= QueryOption_OplogReplay;
         else if ( _query.isEmpty() && !hasParam("dbpath") && !hasParam("forceTableScan") )
             q.snapshot();
-        
-        DBClientBase& connBase = conn(true);
-        Writer writer(out, m);
+
+        string compressBuf;
+        Writer writer(out, m, _compress ? &compressBuf : NULL);
 
         // use low-latency "exhaust" mode if going over the network
         if (!_usingMongos && typeid(connBase) == typeid(DBClientConnection&)) {
@@ -110,18 +148,24 @@ public:
                 writer(cursor->next());
             }
         }
+
+        writer.flushBlock();
     }
 
     void writeCollectionFile( const string coll , path outputFile ) {
+        writeCollectionFile( coll , outputFile , conn( true ) );
+    }
+
+    void writeCollectionFile( const string coll , path outputFile , DBClientBase& c ) {
         cout << "\t" << coll << " to " << outputFile.string() << endl;
 
         FilePtr f (fopen(outputFile.string().c_str(), "wb"));
         uassert(10262, errnoWithPrefix("couldn't open file"), f);
 
-        ProgressMeter m( conn( true ).count( coll.c_str() , BSONObj() , QueryOption_SlaveOk ) );
+        ProgressMeter m( c.count( coll.c_str() , BSONObj() , QueryOption_SlaveOk ) );
         m.setUnits("objects");
 
-        doCollection(coll, f, &m);
+        doCollection(coll, c, f, &m);
 
         cout << "\t\t " << m.done() << " objects" << endl;
     }
@@ -130,12 +174,49 @@ public:
         doCollection(coll, stdout, NULL);
     }
 
+    /** picks collections off a shared list, each worker over its own connection */
+    void dumpWorker( const string db , const vector< pair<string,path> >* tasks , unsigned* next , mongo::mutex* mu , string* firstError ) {
+        try {
+            string errmsg;
+            ConnectionString cs = ConnectionString::parse( _host , errmsg );
+            scoped_ptr<DBClientBase> myconn( cs.connect( errmsg ) );
+            uassert( 16241 , str::stream() << "dump worker couldn't connect to [" << _host << "] " << errmsg , myconn.get() );
+
+            if ( _username.size() || _password.size() ) {
+                // same fallback as Tool::auth(): the db itself, then admin
+                string err;
+                if ( ! myconn->auth( db , _username , _password , err ) &&
+                     ! myconn->auth( "admin" , _username , _password , err ) )
+                    throw UserException( 9997 , (string)"authentication failed: " + err );
+            }
+
+            while ( true ) {
+                unsigned i;
+                {
+                    scoped_lock lk( *mu );
+                    if ( *next >= tasks->size() || ! firstError->empty() )
+                        break;
+                    i = (*next)++;
+                }
+                writeCollectionFile( (*tasks)[i].first , (*tasks)[i].second , *myconn );
+            }
+        }
+        catch ( std::exception& e ) {
+            scoped_lock lk( *mu );
+            if ( firstError->empty() )
+                *firstError = e.what();
+        }
+    }
+
     void go( const string db , const path outdir ) {
         cout << "DATABASE: " << db << "\t to \t" << outdir.string() << endl;
 
         create_directories( outdir );
 
         string sns = db + ".system.namespaces";
+        const string ext = _compress ? ".bson.snappy" : ".bson";
+
+        vector< pair<string,path> > tasks; // collection name -> output file
 
         auto_ptr<DBClientCursor> cursor = conn( true ).query( sns.c_str() , Query() , 0 , 0 , 0 , QueryOption_SlaveOk | QueryOption_NoCursorTimeout );
         while ( cursor->more() ) {
@@ -153,10 +234,31 @@ public:
             if ( _coll != "" && db + "." + _coll != name && _coll != name )
                 continue;
 
-            writeCollectionFile( name.c_str() , outdir / ( filename + ".bson" ) );
-
+            tasks.push_back( make_pair( name , outdir / ( filename + ext ) ) );
         }
 
+        if ( _dumpThreads > 1 && tasks.size() > 1 ) {
+            unsigned next = 0;
+            string firstError;
+            mongo::mutex mu( "dumpTasks" );
+
+            unsigned nThreads = _dumpThreads;
+            if ( nThreads > tasks.size() )
+                nThreads = tasks.size();
+
+            vector< shared_ptr<boost::thread> > workers;
+            for ( unsigned t = 0; t < nThreads; t++ )
+                workers.push_back( shared_ptr<boost::thread>( new boost::thread(
+                    boost::bind( &Dump::dumpWorker , this , db , &tasks , &next , &mu , &firstError ) ) ) );
+            for ( unsigned t = 0; t < workers.size(); t++ )
+                workers[t]->join();
+
+            uassert( 16242 , firstError , firstError.empty() );
+        }
+        else {
+            for ( unsigned i = 0; i < tasks.size(); i++ )
+                writeCollectionFile( tasks[i].first , tasks[i].second );
+        }
     }
 
     int repair() {
@@ -346,6 +448,16 @@ public:
                 _query = fromjson( q );
         }
 
+        _compress = hasParam( "compress" );
+
+        _dumpThreads = getParam( "parallel" , 1 );
+        if ( _dumpThreads < 1 )
+            _dumpThreads = 1;
+        if ( _dumpThreads > 1 && hasParam( "dbpath" ) ) {
+            cout << "--parallel requires a network connection; dumping serially" << endl;
+            _dumpThreads = 1;
+        }
+
         string opLogName = "";
         unsigned long long opLogStart = 0;
         if (hasParam("oplog")) {
@@ -381,6 +493,8 @@ public:
             opLogStart = op["ts"]._numberLong();
         }
 
+        _usingMongos = isMongos();
+
         // check if we're outputting to stdout
         string out = getParam("out");
         if ( out == "-" ) {
@@ -394,8 +508,6 @@ public:
             }
         }
 
-        _usingMongos = isMongos();
-
         path root( out );
         string db = _db;
 
@@ -439,13 +551,15 @@ public:
 
             _query = BSON("ts" << b.obj());
 
-            writeCollectionFile( opLogName , root / "oplog.bson" );
+            writeCollectionFile( opLogName , root / ( _compress ? "oplog.bson.snappy" : "oplog.bson" ) );
         }
 
         return 0;
     }
 
     bool _usingMongos;
+    bool _compress;
+    int _dumpThreads;
     BSONObj _query;
 };
 
@@ -41,6 +41,7 @@ public:
         ("out,o", po::value<string>(), "output file; if not specified, stdout is used")
         ("jsonArray", "output to a json array rather than one object per line")
         ("slaveOk,k", po::value<bool>()->default_value(true) , "use secondaries for export if available, default true")
+        ("convThreads", po::value<int>(), "number of threads to convert documents with (default 1)" )
         ;
         _usesstdout = false;
     }
@@ -125,6 +126,38 @@ public:
         return "";
     }
 
+    // converts one document to its output row (no trailing newline).  csv rows
+    // build up in a StringBuilder so numbers format with snprintf, not iostreams
+    string convertRow( const BSONObj& obj , bool csv ) {
+        if ( ! csv )
+            return obj.jsonString();
+        StringBuilder sb;
+        for ( vector<string>::iterator i=_fields.begin(); i != _fields.end(); i++ ) {
+            if ( i != _fields.begin() )
+                sb << ',';
+            const BSONElement & e = obj.getFieldDotted(i->c_str());
+            if ( ! e.eoo() )
+                sb << csvString(e);
+        }
+        return sb.str();
+    }
+
+    /** one document of output, converted on a worker thread but written in input order */
+    struct ConvRow {
+        ConvRow( const BSONObj& o ) : obj( o ) {}
+        BSONObj obj; // owned copy; the cursor's batch buffer is recycled as we read ahead
+        string text; // converted row, without trailing newline
+    };
+
+    /*
+     * Converts every stride'th row of the chunk starting at offset.  Striping a
+     * shared vector this way needs no locking and keeps output order intact.
+     */
+    void convertChunkStripe( vector<ConvRow>* chunk , unsigned offset , unsigned stride , bool csv ) {
+        for ( unsigned i = offset; i < chunk->size(); i += stride )
+            (*chunk)[i].text = convertRow( (*chunk)[i].obj , csv );
+    }
+
     int run() {
         string ns;
         const bool csv = hasParam( "csv" );
@@ -193,7 +226,20 @@ public:
 
         bool slaveOk = _params["slaveOk"].as<bool>();
 
-        auto_ptr<DBClientCursor> cursor = conn().query( ns.c_str() , q , 0 , 0 , fieldsToReturn , ( slaveOk ? QueryOption_SlaveOk : 0 ) | QueryOption_NoCursorTimeout );
+        int queryOptions = ( slaveOk ? QueryOption_SlaveOk : 0 ) | QueryOption_NoCursorTimeout;
+
+        DBClientBase& connBase = conn();
+
+        // stream with low-latency "exhaust" mode when going over the network to
+        // a mongod; mongos and direct mode don't support it
+        if ( !isMongos() && typeid(connBase) == typeid(DBClientConnection&) )
+            queryOptions |= QueryOption_Exhaust;
+
+        auto_ptr<DBClientCursor> cursor = connBase.query( ns.c_str() , q , 0 , 0 , fieldsToReturn , queryOptions );
+
+        int convThreads = getParam( "convThreads" , 1 );
+        if ( convThreads < 1 )
+            convThreads = 1;
 
         if ( csv ) {
             for ( vector<string>::iterator i=_fields.begin(); i != _fields.end(); i++ ) {
@@ -201,35 +247,52 @@ public:
                     out << ",";
                 out << *i;
             }
-            out << endl;
+            out << '\n';
         }
 
         if (jsonArray)
             out << '[';
 
         long long num = 0;
-        while ( cursor->more() ) {
-            num++;
-            BSONObj obj = cursor->next();
-            if ( csv ) {
-                for ( vector<string>::iterator i=_fields.begin(); i != _fields.end(); i++ ) {
-                    if ( i != _fields.begin() )
-                        out << ",";
-                    const BSONElement & e = obj.getFieldDotted(i->c_str());
-                    if ( ! e.eoo() ) {
-                        out << csvString(e);
-                    }
+        if ( convThreads > 1 ) {
+            // bson to text conversion is the cpu cost of an export, so convert
+            // chunks of documents on a small thread pool and write them out in
+            // cursor order; '\n' instead of endl avoids a flush per row
+            const unsigned chunkDocs = 1024;
+            while ( cursor->more() ) {
+                vector<ConvRow> chunk;
+                chunk.reserve( chunkDocs );
+                while ( chunk.size() < chunkDocs && cursor->more() )
+                    chunk.push_back( ConvRow( cursor->next().getOwned() ) );
+
+                vector< shared_ptr<boost::thread> > workers;
+                for ( int t = 1; t < convThreads; t++ )
+                    workers.push_back( shared_ptr<boost::thread>(
+                        new boost::thread( boost::bind( &Export::convertChunkStripe , this , &chunk , t , convThreads , csv ) ) ) );
+                convertChunkStripe( &chunk , 0 , convThreads , csv );
+                for ( unsigned t = 0; t < workers.size(); t++ )
+                    workers[t]->join();
+
+                for ( unsigned i = 0; i < chunk.size(); i++ ) {
+                    num++;
+                    if ( !csv && jsonArray && num != 1 )
+                        out << ',';
+                    out.write( chunk[i].text.data() , chunk[i].text.size() );
+                    if ( csv || !jsonArray )
+                        out << '\n';
                 }
-                out << endl;
             }
-            else {
-                if (jsonArray && num != 1)
+        }
+        else {
+            while ( cursor->more() ) {
+                num++;
+                BSONObj obj = cursor->next();
+                if ( !csv && jsonArray && num != 1 )
                     out << ',';
-
-                out << obj.jsonString();
-
-                if (!jsonArray)
-                    out << endl;
+                string row = convertRow( obj , csv );
+                out.write( row.data() , row.size() );
+                if ( csv || !jsonArray )
+                    out << '\n';
             }
         }
 
@@ -18,6 +18,7 @@
 
 #include "pch.h"
 #include "client/dbclient.h"
+#include "client/bulk.h"
 #include "db/json.h"
 
 #include "tool.h"
@@ -44,8 +45,10 @@ class Import : public Tool {
     bool _upsert;
     bool _doimport;
     bool _jsonArray;
+    int _parseThreads;
     vector<string> _upsertFields;
     static const int BUF_SIZE = 1024 * 1024 * 4;
+    boost::scoped_array<char> _lineBuf; // parseRow's line buffer, allocated once
 
     void csvTokenizeRow(const string& row, vector<string>& tokens) {
         bool inQuotes = false;
@@ -92,6 +95,27 @@ class Import : public Tool {
         }
     }
 
+    // builds the object for one tokenized csv/tsv row using the current field list
+    BSONObj rowToObj( const vector<string>& tokens ) {
+        BSONObjBuilder b;
+        unsigned int pos = 0;
+        for (vector<string>::const_iterator it = tokens.begin(); it != tokens.end(); ++it) {
+            string name;
+            if ( pos < _fields.size() ) {
+                name = _fields[pos];
+            }
+            else {
+                stringstream ss;
+                ss << "field" << pos;
+                name = ss.str();
+            }
+            pos++;
+
+            _append( b , name , *it );
+        }
+        return b.obj();
+    }
+
     void _append( BSONObjBuilder& b , const string& fieldName , const string& data ) {
         if ( _ignoreBlanks && data.size() == 0 )
             return;
@@ -152,14 +176,257 @@ class Import : public Tool {
         return len;
     }
 
+    /** one line of json input, parsed on a worker thread but kept in input order */
+    struct ParsedLine {
+        ParsedLine( const string& l ) : line( l ) , ok( false ) {}
+        string line;
+        BSONObj obj;
+        bool ok;
+        string errmsg;
+    };
+
+    /*
+     * Parses every stride'th line of the chunk starting at offset.  Striping a
+     * shared vector this way needs no locking and keeps input order intact.
+     */
+    void parseChunkStripe( vector<ParsedLine>* chunk , unsigned offset , unsigned stride ) {
+        for ( unsigned i = offset; i < chunk->size(); i += stride ) {
+            ParsedLine& p = (*chunk)[i];
+            try {
+                if ( ! isValidUTF8( p.line.c_str() ) ) {
+                    p.errmsg = "Invalid UTF8 character detected";
+                    continue;
+                }
+                p.obj = fromjson( p.line );
+                p.ok = true;
+            }
+            catch ( std::exception& e ) {
+                p.errmsg = e.what();
+            }
+        }
+    }
+
+    /*
+     * Inserts one parsed chunk in input order through the bulk builder.
+     * Returns true if importing should stop (error with stopOnError set).
+     */
+    bool consumeParsedChunk( vector<ParsedLine>& chunk , const string& ns , int& num , int& errors ) {
+        BulkOperationBuilder bulk( conn() , ns );
+        bool stop = false;
+        for ( unsigned i = 0; i < chunk.size(); i++ ) {
+            ParsedLine& p = chunk[i];
+            if ( ! p.ok ) {
+                cout << "exception:" << p.errmsg << endl;
+                cout << p.line << endl;
+                errors++;
+                if ( hasParam( "stopOnError" ) ) {
+                    stop = true;
+                    break;
+                }
+                continue;
+            }
+
+            num++;
+            if ( ! _doimport )
+                continue;
+
+            if ( _upsert ) {
+                bool doUpsert = true;
+                BSONObjBuilder b;
+                for (vector<string>::const_iterator it=_upsertFields.begin(), end=_upsertFields.end(); it!=end; ++it) {
+                    BSONElement e = p.obj.getFieldDotted(it->c_str());
+                    if (e.eoo()) {
+                        doUpsert = false;
+                        break;
+                    }
+                    b.appendAs(e, *it);
+                }
+                if ( doUpsert )
+                    bulk.update( Query(b.obj()) , p.obj , true );
+                else
+                    bulk.insert( p.obj );
+                continue;
+            }
+
+            bulk.insert( p.obj );
+        }
+
+        string err;
+        bulk.execute( &err );
+        if ( err.size() )
+            cout << "insert error: " << err << endl;
+
+        return stop;
+    }
+
+    /*
+     * json (one object per line) import with --parseThreads: fromjson dominates
+     * import cpu time, so lines are parsed on a small thread pool while inserts
+     * go out in batches.  fills num/errors like the serial loop.
+     */
+    void importParallelJson( istream* in , const string& ns , ProgressMeter& pm , time_t start , int& num , int& errors ) {
+        const unsigned chunkLines = 4096;
+
+        bool stop = false;
+        while ( ! stop ) {
+            vector<ParsedLine> chunk;
+            chunk.reserve( chunkLines );
+            long long chunkBytes = 0;
+
+            string line;
+            while ( chunk.size() < chunkLines && getline( *in , line ) ) {
+                chunkBytes += line.size() + 1;
+                if ( strncmp( "\xEF\xBB\xBF" , line.c_str() , 3 ) == 0 ) // UTF-8 BOM (notepad is stupid)
+                    line = line.substr( 3 );
+                while ( line.size() && isspace( line[ line.size() - 1 ] ) )
+                    line.resize( line.size() - 1 );
+                if ( line.empty() )
+                    continue;
+                chunk.push_back( ParsedLine( line ) );
+            }
+            uassert( 16240 , "unknown error reading file" , ! ( in->rdstate() & ios_base::badbit ) );
+            if ( chunk.empty() )
+                break;
+
+            vector< shared_ptr<boost::thread> > workers;
+            for ( int t = 1; t < _parseThreads; t++ )
+                workers.push_back( shared_ptr<boost::thread>(
+                    new boost::thread( boost::bind( &Import::parseChunkStripe , this , &chunk , t , _parseThreads ) ) ) );
+            parseChunkStripe( &chunk , 0 , _parseThreads );
+            for ( unsigned t = 0; t < workers.size(); t++ )
+                workers[t]->join();
+
+            stop = consumeParsedChunk( chunk , ns , num , errors );
+
+            if ( pm.hit( (int)chunkBytes ) ) {
+                cout << "\t\t\t" << num << "\t" << ( num / ( time(0) - start ) ) << "/second" << endl;
+            }
+        }
+    }
+
+    /*
+     * Reads one logical csv/tsv row into row; a csv row spans several lines
+     * when a quoted field contains newlines.  Returns false at end of input.
+     */
+    bool getDelimitedRow( istream& in , string& row ) {
+        row.clear();
+        bool insideQuotes = false;
+        string line;
+        while ( getline( in , line ) ) {
+            if ( strncmp( "\xEF\xBB\xBF" , line.c_str() , 3 ) == 0 ) // UTF-8 BOM (notepad is stupid)
+                line = line.substr( 3 );
+            if ( _type == CSV ) {
+                for ( size_t i = 0; i < line.size(); i++ )
+                    if ( line[i] == '"' )
+                        insideQuotes = ! insideQuotes;
+            }
+            if ( row.size() )
+                row += '\n';
+            row += line;
+            if ( ! insideQuotes )
+                return true;
+        }
+        uassert( 16273 , "CSV file ends while inside quoted field" , ! insideQuotes );
+        return false;
+    }
+
+    /*
+     * Parses every stride'th row of the chunk starting at offset, tokenizing
+     * and building objects.  _fields is read only here so no locking needed.
+     */
+    void parseDelimitedStripe( vector<ParsedLine>* chunk , unsigned offset , unsigned stride ) {
+        for ( unsigned i = offset; i < chunk->size(); i += stride ) {
+            ParsedLine& p = (*chunk)[i];
+            try {
+                if ( ! isValidUTF8( p.line.c_str() ) ) {
+                    p.errmsg = "Invalid UTF8 character detected";
+                    continue;
+                }
+                vector<string> tokens;
+                if ( _type == CSV ) {
+                    csvTokenizeRow( p.line , tokens );
+                }
+                else {
+                    const char * line = p.line.c_str();
+                    while (line[0] != '\t' && isspace(line[0])) { // Strip leading whitespace, but not tabs
+                        line++;
+                    }
+                    boost::split(tokens, line, boost::is_any_of(_sep));
+                }
+                p.obj = rowToObj( tokens );
+                p.ok = true;
+            }
+            catch ( std::exception& e ) {
+                p.errmsg = e.what();
+            }
+        }
+    }
+
+    /*
+     * csv/tsv import with --parseThreads: quote state makes row splitting
+     * inherently sequential, so a reader thread of control produces logical
+     * rows and the tokenize+build work fans out to a thread pool.
+     */
+    void importParallelDelimited( istream* in , const string& ns , ProgressMeter& pm , time_t start , int& num , int& errors ) {
+        const unsigned chunkRows = 4096;
+
+        if ( _headerLine ) {
+            string header;
+            if ( getDelimitedRow( *in , header ) ) {
+                vector<string> tokens;
+                if ( _type == CSV )
+                    csvTokenizeRow( header , tokens );
+                else
+                    boost::split( tokens , header , boost::is_any_of( _sep ) );
+                for ( vector<string>::iterator it = tokens.begin(); it != tokens.end(); ++it )
+                    _fields.push_back( *it );
+                num++; // run() subtracts headerRows from the final count
+            }
+            _headerLine = false;
+        }
+
+        bool stop = false;
+        while ( ! stop ) {
+            vector<ParsedLine> chunk;
+            chunk.reserve( chunkRows );
+            long long chunkBytes = 0;
+
+            string row;
+            while ( chunk.size() < chunkRows && getDelimitedRow( *in , row ) ) {
+                chunkBytes += row.size() + 1;
+                if ( row.empty() )
+                    continue;
+                chunk.push_back( ParsedLine( row ) );
+            }
+            uassert( 16274 , "unknown error reading file" , ! ( in->rdstate() & ios_base::badbit ) );
+            if ( chunk.empty() )
+                break;
+
+            vector< shared_ptr<boost::thread> > workers;
+            for ( int t = 1; t < _parseThreads; t++ )
+                workers.push_back( shared_ptr<boost::thread>(
+                    new boost::thread( boost::bind( &Import::parseDelimitedStripe , this , &chunk , t , _parseThreads ) ) ) );
+            parseDelimitedStripe( &chunk , 0 , _parseThreads );
+            for ( unsigned t = 0; t < workers.size(); t++ )
+                workers[t]->join();
+
+            stop = consumeParsedChunk( chunk , ns , num , errors );
+
+            if ( pm.hit( (int)chunkBytes ) ) {
+                cout << "\t\t\t" << num << "\t" << ( num / ( time(0) - start ) ) << "/second" << endl;
+            }
+        }
+    }
+
     /*
      * Parses one object from the input file.  This usually corresponds to one line in the input
      * file, unless the file is a CSV and contains a newline within a quoted string entry.
      * Returns a true if a BSONObj was successfully created and false if not.
      */
     bool parseRow(istream* in, BSONObj& o, int& numBytesRead) {
-        boost::scoped_array<char> buffer(new char[BUF_SIZE+2]);
-        char* line = buffer.get();
+        if ( ! _lineBuf )
+            _lineBuf.reset( new char[BUF_SIZE+2] );
+        char* line = _lineBuf.get();
 
         numBytesRead = getLine(in, line);
         line += numBytesRead;
@@ -221,29 +488,14 @@ class Import : public Tool {
         }
 
         // Now that the row is tokenized, create a BSONObj out of it.
-        BSONObjBuilder b;
-        unsigned int pos=0;
-        for (vector<string>::iterator it = tokens.begin(); it != tokens.end(); ++it) {
-            string token = *it;
-            if ( _headerLine ) {
-                _fields.push_back(token);
-            }
-            else {
-                string name;
-                if ( pos < _fields.size() ) {
-                    name = _fields[pos];
-                }
-                else {
-                    stringstream ss;
-                    ss << "field" << pos;
-                    name = ss.str();
-                }
-                pos++;
-
-                _append( b , name , token );
-            }
+        if ( _headerLine ) {
+            for (vector<string>::iterator it = tokens.begin(); it != tokens.end(); ++it)
+                _fields.push_back(*it);
+            o = BSONObj();
+        }
+        else {
+            o = rowToObj( tokens );
         }
-        o = b.obj();
         return true;
     }
 
@@ -260,6 +512,7 @@ public:
         ("upsertFields", po::value<string>(), "comma-separated fields for the query part of the upsert. You should make sure this is indexed" )
         ("stopOnError", "stop importing at first error rather than continuing" )
         ("jsonArray", "load a json array, not one item per line. Currently limited to 4MB." )
+        ("parseThreads", po::value<int>(), "number of threads to parse input with (default 1; not applicable to --jsonArray)" )
         ;
         add_hidden_options()
         ("noimport", "don't actually import. useful for benchmarking parser" )
@@ -271,6 +524,7 @@ public:
         _upsert = false;
         _doimport = true;
         _jsonArray = false;
+        _parseThreads = 1;
     }
 
     virtual void printExtraHelp( ostream & out ) {
@@ -371,6 +625,14 @@ public:
             _jsonArray = true;
         }
 
+        _parseThreads = getParam( "parseThreads" , 1 );
+        if ( _parseThreads < 1 )
+            _parseThreads = 1;
+        if ( _parseThreads > 1 && _jsonArray ) {
+            cerr << "--parseThreads does not apply to --jsonArray input" << endl;
+            return -1;
+        }
+
         time_t start = time(0);
         log(1) << "filesize: " << fileSize << endl;
         ProgressMeter pm( fileSize );
@@ -381,7 +643,16 @@ public:
         boost::scoped_array<char> buffer(new char[BUF_SIZE+2]);
         char* line = buffer.get();
 
-        while ( _jsonArray || in->rdstate() == 0 ) {
+        // batches the serial path's writes; unused when the parallel paths run
+        BulkOperationBuilder bulk( conn() , ns );
+
+        if ( _parseThreads > 1 ) {
+            if ( _type == JSON )
+                importParallelJson( in , ns , pm , start , num , errors );
+            else
+                importParallelDelimited( in , ns , pm , start , num , errors );
+        }
+        else while ( _jsonArray || in->rdstate() == 0 ) {
             try {
                 BSONObj o;
                 if (_jsonArray) {
@@ -422,10 +693,10 @@ public:
                     }
 
                     if (doUpsert) {
-                        conn().update(ns, Query(b.obj()), o, true);
+                        bulk.update(Query(b.obj()), o, true);
                     }
                     else {
-                        conn().insert( ns.c_str() , o );
+                        bulk.insert( o );
                     }
                 }
 
@@ -445,6 +716,11 @@ public:
             }
         }
 
+        string bulkErr;
+        bulk.execute( &bulkErr );
+        if ( bulkErr.size() )
+            cout << "insert error: " << bulkErr << endl;
+
         cout << "imported " << ( num - headerRows ) << " objects" << endl;
 
         conn().getLastError();
@@ -18,6 +18,7 @@
 
 #include "../pch.h"
 #include "../client/dbclient.h"
+#include "../client/bulk.h"
 #include "../util/mmap.h"
 #include "../util/version.h"
 #include "tool.h"
@@ -25,6 +26,7 @@
 #include <boost/program_options.hpp>
 
 #include <fcntl.h>
+#include <fstream>
 #include <set>
 
 using namespace mongo;
@@ -45,12 +47,16 @@ public:
     string _curdb;
     set<string> _users; // For restoring users with --drop
     auto_ptr<Matcher> _opmatcher; // For oplog replay
+    scoped_ptr<BulkOperationBuilder> _bulk; // batches plain inserts for _curns
+    set<string> _alreadyRestored; // files listed in the progress manifest with --resume
+    ofstream _manifest;
     Restore() : BSONTool( "restore" ) , _drop(false) {
         add_options()
         ("drop" , "drop each collection before import" )
         ("oplogReplay", "replay oplog for point-in-time restore")
         ("oplogLimit", po::value<string>(), "exclude oplog entries newer than provided timestamp (epoch[:ordinal])")
         ("keepIndexVersion" , "don't upgrade indexes to newest version")
+        ("resume" , "skip files already listed in the .restore_progress manifest of a previous run" )
         ("w" , po::value<int>()->default_value(1) , "minimum number of replicas per write" )
         ;
         add_hidden_options()
@@ -88,7 +94,7 @@ public:
                 return -1;
             }
 
-            if ( ! exists(root / "oplog.bson") ) {
+            if ( ! exists(root / "oplog.bson") && ! exists(root / "oplog.bson.snappy") ) {
                 cout << "No oplog file to replay. Make sure you run mongodump with --oplog." << endl;
                 return -1;
             }
@@ -125,6 +131,26 @@ public:
             }
         }
 
+        /* Progress manifest: one restored file path per line so an interrupted
+         * restore can be resumed with --resume.  Only kept when restoring from
+         * a directory; the manifest lives inside it as a dot file so drillDown
+         * never treats it as input.
+         */
+        if ( is_directory( root ) ) {
+            path manifestPath = root / ".restore_progress";
+            if ( hasParam( "resume" ) && exists( manifestPath ) ) {
+                ifstream in( manifestPath.string().c_str() );
+                string line;
+                while ( getline( in , line ) ) {
+                    if ( line.size() )
+                        _alreadyRestored.insert( line );
+                }
+                out() << "\t resuming, skipping " << _alreadyRestored.size() << " already restored file(s)" << endl;
+            }
+            _manifest.open( manifestPath.string().c_str() ,
+                            hasParam( "resume" ) ? ( ios_base::out | ios_base::app ) : ( ios_base::out | ios_base::trunc ) );
+        }
+
         /* If _db is not "" then the user specified a db name to restore as.
          *
          * In that case we better be given either a root directory that
@@ -142,7 +168,7 @@ public:
         if (doOplog) {
             out() << "\t Replaying oplog" << endl;
             _curns = OPLOG_SENTINEL;
-            processFile( root / "oplog.bson" );
+            processFile( exists(root / "oplog.bson") ? root / "oplog.bson" : root / "oplog.bson.snappy" );
         }
 
         return EXIT_CLEAN;
@@ -182,10 +208,10 @@ public:
                 }
 
                 // don't insert oplog
-                if (top_level && !use_db && p.leaf() == "oplog.bson")
+                if (top_level && !use_db && leafIs(p, "oplog.bson"))
                     continue;
 
-                if ( p.leaf() == "system.indexes.bson" )
+                if ( leafIs(p, "system.indexes.bson") )
                     indexes = p;
                 else
                     drillDown(p, use_db, use_coll);
@@ -198,18 +224,24 @@ public:
         }
 
         if ( ! ( endsWith( root.string().c_str() , ".bson" ) ||
-                 endsWith( root.string().c_str() , ".bin" ) ) ) {
+                 endsWith( root.string().c_str() , ".bin" ) ||
+                 endsWith( root.string().c_str() , ".bson.snappy" ) ) ) {
             cerr << "don't know what to do with file [" << root.string() << "]" << endl;
             return;
         }
 
         log() << root.string() << endl;
 
-        if ( root.leaf() == "system.profile.bson" ) {
+        if ( leafIs(root, "system.profile.bson") ) {
             log() << "\t skipping" << endl;
             return;
         }
 
+        if ( _alreadyRestored.count( root.string() ) ) {
+            out() << "\t already restored, skipping" << endl;
+            return;
+        }
+
         string ns;
         if (use_db) {
             ns += _db;
@@ -232,6 +264,8 @@ public:
         }
         else {
             string l = root.leaf();
+            if ( endsWith( l.c_str() , ".snappy" ) )
+                l = l.substr( 0 , l.size() - 7 );
             l = l.substr( 0 , l.find_last_of( "." ) );
             ns += "." + l;
         }
@@ -239,7 +273,7 @@ public:
         out() << "\t going into namespace [" << ns << "]" << endl;
 
         if ( _drop ) {
-            if (root.leaf() != "system.users.bson" ) {
+            if ( ! leafIs(root, "system.users.bson") ) {
                 out() << "\t dropping" << endl;
                 conn().dropCollection( ns );
             } else {
@@ -255,8 +289,10 @@ public:
 
         _curns = ns.c_str();
         _curdb = NamespaceString(_curns).db;
+        _bulk.reset( new BulkOperationBuilder( conn() , _curns ) );
         processFile( root );
-        if (_drop && root.leaf() == "system.users.bson") {
+        flushInserts();
+        if (_drop && leafIs(root, "system.users.bson")) {
             // Delete any users that used to exist but weren't in the dump file
             for (set<string>::iterator it = _users.begin(); it != _users.end(); ++it) {
                 BSONObj userMatch = BSON("user" << *it);
@@ -264,6 +300,18 @@ public:
             }
             _users.clear();
         }
+
+        if ( _manifest.is_open() ) {
+            // the file only goes in the manifest once its writes are known good
+            conn().getLastError();
+            _manifest << root.string() << '\n';
+            _manifest.flush();
+        }
+    }
+
+    /** true if the file is <name> or its compressed variant <name>.snappy */
+    static bool leafIs( const path& p , const string& name ) {
+        return p.leaf() == name || p.leaf() == name + ".snappy";
     }
 
     virtual void gotObject( const BSONObj& obj ) {
@@ -330,18 +378,25 @@ public:
             // Since system collections can't be dropped, we have to manually
             // replace the contents of the system.users collection
             BSONObj userMatch = BSON("user" << obj["user"].String());
-            conn().update(_curns, Query(userMatch), obj);
+            // through the builder so it stays ordered after any buffered inserts
+            _bulk->update(Query(userMatch), obj);
             _users.erase(obj["user"].String());
         } else {
-            conn().insert( _curns , obj );
-
-            // wait for insert to propagate to "w" nodes (doesn't warn if w used without replset)
-            if ( _w > 1 ) {
-                conn().getLastErrorDetailed(false, false, _w);
-            }
+            // the builder batches and splits for us; it copies the object, which
+            // may point into a temporary decompressed block
+            _bulk->insert( obj );
         }
     }
 
+    void flushInserts() {
+        if ( ! _bulk )
+            return;
+
+        // dispatch anything queued; with "w" also wait for propagation to that
+        // many nodes (doesn't warn if w used without replset)
+        _bulk->execute( 0 , _w );
+    }
+
 
 };
 
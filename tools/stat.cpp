@@ -37,6 +37,7 @@ namespace mongo {
         Stat() : Tool( "stat" , REMOTE_SERVER , "admin" ) {
             _http = false;
             _many = false;
+            _lite = false;
 
             add_hidden_options()
             ( "sleep" , po::value<int>() , "time to sleep between calls" )
@@ -47,6 +48,7 @@ namespace mongo {
             ("http", "use http instead of raw db connection")
             ("discover" , "discover nodes and display stats for all" )
             ("all" , "all optional fields" )
+            ("lite" , "poll serverStatusLite instead of serverStatus - much cheaper on the server, omits mem/faults/flushes/repl columns (requires 2.1+)" )
             ;
 
             addPositionArg( "sleep" , 1 );
@@ -120,7 +122,7 @@ namespace mongo {
                 return e.embeddedObjectUserCheck();
             }
             BSONObj out;
-            if ( ! conn().simpleCommand( _db , &out , "serverStatus" ) ) {
+            if ( ! conn().simpleCommand( _db , &out , _lite ? "serverStatusLite" : "serverStatus" ) ) {
                 cout << "error: " << out << endl;
                 return BSONObj();
             }
@@ -134,6 +136,10 @@ namespace mongo {
                 _noconnection = true;
             }
 
+            if ( hasParam( "lite" ) ) {
+                _lite = true;
+            }
+
             if ( hasParam( "host" ) &&
                     getParam( "host" ).find( ',' ) != string::npos ) {
                 _noconnection = true;
@@ -514,6 +520,7 @@ namespace mongo {
         StatUtil _statUtil;
         bool _http;
         bool _many;
+        bool _lite;
 
         struct Row {
             Row( string h , string e ) {
@@ -108,7 +108,16 @@ namespace mongo {
         }
 
         if (!isMongos) {
-            _append( result , "locked %" , 8 , percent( "globalLock.totalTime" , "globalLock.lockTime" , a , b ) );
+            if ( b.getFieldDotted( "snapshot.writeLockedPercent" ).isNumber() ) {
+                // serverStatusLite pre-diffs this server side over the snapshot
+                // thread's window, which is both cheaper and less noisy than
+                // diffing two of our own samples
+                double p = b.getFieldDotted( "snapshot.writeLockedPercent" ).number();
+                _append( result , "locked %" , 8 , (double)((int)(p * 10)) / 10 );
+            }
+            else {
+                _append( result , "locked %" , 8 , percent( "globalLock.totalTime" , "globalLock.lockTime" , a , b ) );
+            }
             _append( result , "idx miss %" , 8 , percent( "indexCounters.btree.accesses" , "indexCounters.btree.misses" , a , b ) );
         }
 
@@ -23,6 +23,7 @@
 #include <boost/filesystem/operations.hpp>
 #include "pcrecpp.h"
 
+#include "util/compress.h"
 #include "util/file_allocator.h"
 #include "util/password.h"
 #include "util/version.h"
@@ -438,6 +439,31 @@ namespace mongo {
         return doRun();
     }
 
+    bool BSONTool::_handleObj( const BSONObj& o ) {
+        if ( _objcheck && ! o.valid() ) {
+            cerr << "INVALID OBJECT - going try and pring out " << endl;
+            cerr << "size: " << o.objsize() << endl;
+            BSONObjIterator i(o);
+            while ( i.more() ) {
+                BSONElement e = i.next();
+                try {
+                    e.validate();
+                }
+                catch ( ... ) {
+                    cerr << "\t\t NEXT ONE IS INVALID" << endl;
+                }
+                cerr << "\t name : " << e.fieldName() << " " << e.type() << endl;
+                cerr << "\t " << e << endl;
+            }
+        }
+
+        if ( _matcher.get() == 0 || _matcher->matches( o ) ) {
+            gotObject( o );
+            return true;
+        }
+        return false;
+    }
+
     long long BSONTool::processFile( const path& root ) {
         _fileName = root.string();
 
@@ -472,7 +498,42 @@ namespace mongo {
         ProgressMeter m( fileLength );
         m.setUnits( "bytes" );
 
+        // snappy compressed dumps (mongodump --compress) are a sequence of
+        // blocks: 4 byte little endian compressed length, then the compressed
+        // bytes.  blocks end on object boundaries.
+        bool compressed = endsWith( _fileName.c_str() , ".snappy" );
+
         while ( read < fileLength ) {
+            if ( compressed ) {
+                size_t amt = fread(buf, 1, 4, file);
+                assert( amt == 4 );
+
+                int blockLen = ((int*)buf)[0];
+                uassert( 16243 , str::stream() << "invalid compressed block size: " << blockLen ,
+                         blockLen > 0 && blockLen < BUF_SIZE );
+
+                amt = fread(buf, 1, blockLen, file);
+                assert( amt == (size_t)blockLen );
+
+                string uncompressed;
+                uassert( 16244 , str::stream() << "corrupt snappy block in " << _fileName ,
+                         mongo::uncompress( buf , blockLen , &uncompressed ) );
+
+                const char * p = uncompressed.data();
+                const char * end = p + uncompressed.size();
+                while ( p < end ) {
+                    BSONObj o( p );
+                    if ( _handleObj( o ) )
+                        processed++;
+                    p += o.objsize();
+                    num++;
+                }
+
+                read += 4 + blockLen;
+                m.hit( 4 + blockLen );
+                continue;
+            }
+
             size_t amt = fread(buf, 1, 4, file);
             assert( amt == 4 );
 
@@ -483,27 +544,8 @@ namespace mongo {
             assert( amt == (size_t)( size - 4 ) );
 
             BSONObj o( buf );
-            if ( _objcheck && ! o.valid() ) {
-                cerr << "INVALID OBJECT - going try and pring out " << endl;
-                cerr << "size: " << size << endl;
-                BSONObjIterator i(o);
-                while ( i.more() ) {
-                    BSONElement e = i.next();
-                    try {
-                        e.validate();
-                    }
-                    catch ( ... ) {
-                        cerr << "\t\t NEXT ONE IS INVALID" << endl;
-                    }
-                    cerr << "\t name : " << e.fieldName() << " " << e.type() << endl;
-                    cerr << "\t " << e << endl;
-                }
-            }
-
-            if ( _matcher.get() == 0 || _matcher->matches( o ) ) {
-                gotObject( o );
+            if ( _handleObj( o ) )
                 processed++;
-            }
 
             read += o.objsize();
             num++;
@@ -514,7 +556,7 @@ namespace mongo {
         fclose( file );
 
         uassert( 10265 ,  "counts don't match" , m.done() == fileLength );
-        (_usesstdout ? cout : cerr ) << m.hits() << " objects found" << endl;
+        (_usesstdout ? cout : cerr ) << num << " objects found" << endl;
         if ( _matcher.get() )
             (_usesstdout ? cout : cerr ) << processed << " objects processed" << endl;
         return processed;
@@ -155,6 +155,10 @@ namespace mongo {
 
         long long processFile( const path& file );
 
+    private:
+        /** objcheck + matcher + gotObject for one document. returns true if the object was processed. */
+        bool _handleObj( const BSONObj& o );
+
     };
 
 }
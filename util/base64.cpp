@@ -24,50 +24,43 @@ namespace mongo {
 
         Alphabet alphabet;
 
-        void encode( stringstream& ss , const char * data , int size ) {
-            for ( int i=0; i<size; i+=3 ) {
-                int left = size - i;
+        string encode( const char * data , int size ) {
+            string s;
+            s.resize( 4 * ( ( size + 2 ) / 3 ) );
+            char * out = size ? &s[0] : 0;
+
+            int i = 0;
+            // full 3 byte groups: four lookups and four stores each, no
+            // branches and no stream call per output character
+            for ( ; i + 3 <= size; i += 3 ) {
                 const unsigned char * start = (const unsigned char*)data + i;
+                out[0] = alphabet.e( start[0] >> 2 );
+                out[1] = alphabet.e( ( start[0] << 4 ) | ( start[1] >> 4 ) );
+                out[2] = alphabet.e( ( start[1] << 2 ) | ( start[2] >> 6 ) );
+                out[3] = alphabet.e( start[2] );
+                out += 4;
+            }
 
-                // byte 0
-                ss << alphabet.e(start[0]>>2);
-
-                // byte 1
-                unsigned char temp = ( start[0] << 4 );
-                if ( left == 1 ) {
-                    ss << alphabet.e(temp);
-                    break;
+            // 1 or 2 trailing bytes plus padding
+            if ( i < size ) {
+                const unsigned char * start = (const unsigned char*)data + i;
+                out[0] = alphabet.e( start[0] >> 2 );
+                if ( size - i == 1 ) {
+                    out[1] = alphabet.e( start[0] << 4 );
+                    out[2] = '=';
                 }
-                temp |= ( ( start[1] >> 4 ) & 0xF );
-                ss << alphabet.e(temp);
-
-                // byte 2
-                temp = ( start[1] & 0xF ) << 2;
-                if ( left == 2 ) {
-                    ss << alphabet.e(temp);
-                    break;
+                else {
+                    out[1] = alphabet.e( ( start[0] << 4 ) | ( start[1] >> 4 ) );
+                    out[2] = alphabet.e( start[1] << 2 );
                 }
-                temp |= ( ( start[2] >> 6 ) & 0x3 );
-                ss << alphabet.e(temp);
-
-                // byte 3
-                ss << alphabet.e(start[2] & 0x3f);
+                out[3] = '=';
             }
 
-            int mod = size % 3;
-            if ( mod == 1 ) {
-                ss << "==";
-            }
-            else if ( mod == 2 ) {
-                ss << "=";
-            }
+            return s;
         }
 
-
-        string encode( const char * data , int size ) {
-            stringstream ss;
-            encode( ss , data ,size );
-            return ss.str();
+        void encode( stringstream& ss , const char * data , int size ) {
+            ss << encode( data , size );
         }
 
         string encode( const string& s ) {
@@ -75,33 +68,48 @@ namespace mongo {
         }
 
 
-        void decode( stringstream& ss , const string& s ) {
+        string decode( const string& s ) {
             uassert( 10270 ,  "invalid base64" , s.size() % 4 == 0 );
+            if ( s.empty() )
+                return string();
             const unsigned char * data = (const unsigned char*)s.c_str();
             int size = s.size();
 
-            unsigned char buf[3];
-            for ( int i=0; i<size; i+=4) {
+            int outLen = size / 4 * 3;
+            if ( data[size-1] == '=' ) {
+                outLen--;
+                if ( data[size-2] == '=' )
+                    outLen--;
+            }
+
+            string out;
+            out.resize( outLen );
+            char * dst = &out[0];
+
+            int i = 0;
+            // every group but the last decodes to exactly 3 bytes, stored
+            // straight into the result
+            for ( ; i + 4 < size; i += 4 ) {
                 const unsigned char * start = data + i;
-                buf[0] = ( ( alphabet.decode[start[0]] << 2 ) & 0xFC ) | ( ( alphabet.decode[start[1]] >> 4 ) & 0x3 );
-                buf[1] = ( ( alphabet.decode[start[1]] << 4 ) & 0xF0 ) | ( ( alphabet.decode[start[2]] >> 2 ) & 0xF );
-                buf[2] = ( ( alphabet.decode[start[2]] << 6 ) & 0xC0 ) | ( ( alphabet.decode[start[3]] & 0x3F ) );
-
-                int len = 3;
-                if ( start[3] == '=' ) {
-                    len = 2;
-                    if ( start[2] == '=' ) {
-                        len = 1;
-                    }
-                }
-                ss.write( (const char*)buf , len );
+                dst[0] = ( ( alphabet.decode[start[0]] << 2 ) & 0xFC ) | ( ( alphabet.decode[start[1]] >> 4 ) & 0x3 );
+                dst[1] = ( ( alphabet.decode[start[1]] << 4 ) & 0xF0 ) | ( ( alphabet.decode[start[2]] >> 2 ) & 0xF );
+                dst[2] = ( ( alphabet.decode[start[2]] << 6 ) & 0xC0 ) | ( ( alphabet.decode[start[3]] & 0x3F ) );
+                dst += 3;
             }
+
+            // the last group may decode to 1, 2 or 3 bytes depending on padding
+            unsigned char buf[3];
+            const unsigned char * start = data + i;
+            buf[0] = ( ( alphabet.decode[start[0]] << 2 ) & 0xFC ) | ( ( alphabet.decode[start[1]] >> 4 ) & 0x3 );
+            buf[1] = ( ( alphabet.decode[start[1]] << 4 ) & 0xF0 ) | ( ( alphabet.decode[start[2]] >> 2 ) & 0xF );
+            buf[2] = ( ( alphabet.decode[start[2]] << 6 ) & 0xC0 ) | ( ( alphabet.decode[start[3]] & 0x3F ) );
+            memcpy( dst , buf , outLen - ( i / 4 * 3 ) );
+
+            return out;
         }
 
-        string decode( const string& s ) {
-            stringstream ss;
-            decode( ss , s );
-            return ss.str();
+        void decode( stringstream& ss , const string& s ) {
+            ss << decode( s );
         }
 
     }
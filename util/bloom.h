@@ -0,0 +1,87 @@
+// @file bloom.h
+
+/*    Copyright 2011 10gen Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+#include "../pch.h"
+
+namespace mongo {
+
+    /** simple bloom filter: approximate set membership in a few bits per entry.
+        maybeContains() can return false positives but never false negatives, so
+        it is a prefilter - a "no" answer skips an exact (and more expensive)
+        structure entirely, a "yes" answer means consult it.  not thread safe;
+        callers synchronize as they would around any container.
+    */
+    class BloomFilter : boost::noncopyable {
+    public:
+        /** @param expectedEntries sizing hint; at that load the false positive
+                   rate is roughly 1% (10 bits and 4 probes per entry) */
+        BloomFilter( unsigned long long expectedEntries ) {
+            unsigned long long bits = expectedEntries * BitsPerEntry;
+            if ( bits < 64 )
+                bits = 64;
+            _nbits = ( bits + 63 ) / 64 * 64;
+            _bits.resize( (size_t)( _nbits / 64 ) , 0 );
+        }
+
+        void insert( const void* data , int len ) {
+            unsigned long long h1, h2;
+            _hash( data , len , h1 , h2 );
+            for ( int i = 0; i < NProbes; i++ ) {
+                unsigned long long b = ( h1 + i * h2 ) % _nbits;
+                _bits[ (size_t)( b >> 6 ) ] |= 1ULL << ( b & 63 );
+            }
+        }
+
+        /** @return false if the entry was definitely never inserted */
+        bool maybeContains( const void* data , int len ) const {
+            unsigned long long h1, h2;
+            _hash( data , len , h1 , h2 );
+            for ( int i = 0; i < NProbes; i++ ) {
+                unsigned long long b = ( h1 + i * h2 ) % _nbits;
+                if ( ! ( _bits[ (size_t)( b >> 6 ) ] & ( 1ULL << ( b & 63 ) ) ) )
+                    return false;
+            }
+            return true;
+        }
+
+        long long memUsage() const { return _bits.size() * 8; }
+
+    private:
+        enum { BitsPerEntry = 10 , NProbes = 4 };
+
+        /** 64 bit fnv-1a, run twice with different offset bases; the probe
+            sequence is double hashing h1 + i*h2.  h2 is forced odd so the
+            probes don't collapse when _nbits shares factors with it. */
+        static void _hash( const void* data , int len , unsigned long long& h1 , unsigned long long& h2 ) {
+            const unsigned char *p = static_cast<const unsigned char*>( data );
+            unsigned long long a = 14695981039346656037ULL;
+            unsigned long long b = 1099511628211ULL;
+            for ( int i = 0; i < len; i++ ) {
+                a = ( a ^ p[i] ) * 1099511628211ULL;
+                b = ( b ^ p[i] ) * 14695981039346656037ULL;
+            }
+            h1 = a;
+            h2 = b | 1;
+        }
+
+        vector<unsigned long long> _bits;
+        unsigned long long _nbits;
+    };
+
+} // namespace mongo
@@ -0,0 +1,210 @@
+// @file batch_rwlock.h reader-writer lock with striped reader counts and reader batching
+
+/*
+ *    Copyright (C) 2011 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "mutex.h"
+#include "threadlocal.h"
+#include "../time_support.h"
+#include "../../bson/util/atomic_int.h"
+
+namespace mongo {
+
+    /** Reader-writer lock built for the "many readers, occasional writer"
+        profile of the global db mutex.  Not recursive -- MongoMutex layers
+        recursion on top via its thread local state.
+
+        Readers count themselves in striped, cache line sized counters
+        ("big-reader" style), so concurrent read acquisition doesn't bounce
+        one shared line between cores.  The read fast path is an atomic
+        increment plus one load; the internal mutex is touched only when a
+        writer is involved.
+
+        Writer wait is bounded: a pending writer immediately gates new
+        readers, so it waits only for the readers already holding the lock.
+        Readers aren't starved either: everything that queued behind a writer
+        is released as one explicit batch before the next writer may enter,
+        so back-to-back writes can't shut readers out.
+    */
+    class BatchRWLock : boost::noncopyable {
+    public:
+        const char * const _name;
+
+        BatchRWLock(const char *name)
+            : _name(name) , _mutex("BatchRWLock") ,
+              _writerActive(false) , _batchGen(0) , _readersWaiting(0) , _batchLeaving(0) { }
+
+        void lock_shared() {
+            unsigned s = _mySlot();
+            _readers[s].count++;
+            if ( _wantWrite == 0 )
+                return; // fast path
+            // a writer is in or wants in: get out of the way and queue
+            _readers[s].count--;
+            scoped_lock lk(_mutex);
+            _wakeWriterIfDrained();
+            _readersWaiting++;
+            unsigned gen = _batchGen;
+            while ( _writerActive || ( _wantWrite && gen == _batchGen ) )
+                _canRead.wait(lk.boost());
+            _admitted(s, gen);
+        }
+
+        bool lock_shared_try( int millis ) {
+            unsigned s = _mySlot();
+            _readers[s].count++;
+            if ( _wantWrite == 0 )
+                return true;
+            _readers[s].count--;
+            unsigned long long deadline = curTimeMicros64() + millis * 1000ULL;
+            scoped_lock lk(_mutex);
+            _wakeWriterIfDrained();
+            _readersWaiting++;
+            unsigned gen = _batchGen;
+            while ( _writerActive || ( _wantWrite && gen == _batchGen ) ) {
+                if ( curTimeMicros64() >= deadline ) {
+                    _readersWaiting--;
+                    return false;
+                }
+                _canRead.timed_wait(lk.boost(), boost::posix_time::milliseconds(1));
+            }
+            _admitted(s, gen);
+            return true;
+        }
+
+        void unlock_shared() {
+            _readers[_mySlot()].count--;
+            if ( _wantWrite ) {
+                scoped_lock lk(_mutex);
+                _wakeWriterIfDrained();
+            }
+        }
+
+        void lock() {
+            _wantWrite++; // gates the read fast path from here on
+            scoped_lock lk(_mutex);
+            while ( _writerActive || _batchLeaving )
+                _canWrite.wait(lk.boost());
+            _writerActive = true;
+            // only the readers already counted can be in; wait them out
+            while ( _readerTotal() != 0 )
+                _canWrite.wait(lk.boost());
+        }
+
+        bool lock_try( int millis = 0 ) {
+            _wantWrite++;
+            unsigned long long deadline = curTimeMicros64() + millis * 1000ULL;
+            scoped_lock lk(_mutex);
+            while ( _writerActive || _batchLeaving || _readerTotal() != 0 ) {
+                if ( curTimeMicros64() >= deadline ) {
+                    _wantWrite--;
+                    // we may have been the only gate; let queued readers recheck
+                    _canRead.notify_all();
+                    return false;
+                }
+                _canWrite.timed_wait(lk.boost(), boost::posix_time::milliseconds(1));
+            }
+            _writerActive = true;
+            return true;
+        }
+
+        /** true if a writer holds or is queued for the lock.  one volatile
+            load; cheap enough to poll per document scanned. */
+        bool writerWanted() const { return _wantWrite > 0; }
+
+        /** readers currently holding the lock.  advisory - the answer can be
+            stale by the time the caller acts on it. */
+        unsigned readerCount() const { return _readerTotal(); }
+
+        void unlock() {
+            scoped_lock lk(_mutex);
+            _writerActive = false;
+            _wantWrite--;
+            if ( _readersWaiting ) {
+                // release everything that queued behind us as one batch; the
+                // next writer holds off until the whole batch is in
+                _batchGen++;
+                _batchLeaving = _readersWaiting;
+                _canRead.notify_all();
+            }
+            else {
+                _canWrite.notify_all();
+            }
+        }
+
+    private:
+        enum { NSlots = 16, SlotMask = NSlots - 1 };
+
+        /** one reader count per cache line */
+        struct PaddedCount {
+            AtomicUInt count;
+            char pad[64 - sizeof(AtomicUInt)];
+        };
+
+        /** stable stripe for this thread; assigned round robin on first use */
+        unsigned _mySlot() {
+            int i = _slotId.get();
+            if ( i == 0 ) {
+                i = (int)( _slotCursor++ | 0x40000000 ); // nonzero
+                _slotId.set(i);
+            }
+            return (unsigned)i & SlotMask;
+        }
+
+        unsigned _readerTotal() const {
+            unsigned n = 0;
+            for ( int i = 0; i < NSlots; i++ )
+                n += _readers[i].count;
+            return n;
+        }
+
+        // call with _mutex held.  a draining writer sleeps on _canWrite; poke
+        // it if the last reader (or a backing-out fast path reader) just left.
+        void _wakeWriterIfDrained() {
+            if ( _writerActive && _readerTotal() == 0 )
+                _canWrite.notify_all();
+        }
+
+        // call with _mutex held, after being released from the wait loop as
+        // part of batch 'gen'.  counts us in and lets the next writer go once
+        // the whole batch is in.
+        void _admitted( unsigned s , unsigned gen ) {
+            _readersWaiting--;
+            _readers[s].count++;
+            if ( gen != _batchGen && _batchLeaving > 0 ) {
+                if ( --_batchLeaving == 0 )
+                    _canWrite.notify_all();
+            }
+        }
+
+        PaddedCount _readers[NSlots];
+        AtomicUInt _wantWrite;   // writers pending + active
+        AtomicUInt _slotCursor;
+
+        mongo::mutex _mutex;     // protects the state below
+        boost::condition _canRead;
+        boost::condition _canWrite;
+        bool _writerActive;
+        unsigned _batchGen;      // bumped each time a reader batch is released
+        int _readersWaiting;
+        int _batchLeaving;       // released readers the next writer must wait for
+
+        ThreadLocalValue<int> _slotId;
+    };
+
+}  // namespace mongo
@@ -0,0 +1,87 @@
+// @file sharded_counter.h
+// counters split across padded per-thread slots so hot-path bumps don't share cache lines
+
+/*
+ *    Copyright (C) 2011 10gen Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "threadlocal.h"
+#include "../../bson/util/atomic_int.h"
+
+namespace mongo {
+
+    /** small dense id for the current thread, assigned on first use.  used to pick a
+        slot in sharded data structures; ids are never reused so after many thread
+        births slots get shared (that's correctness-neutral, just a bit of contention).
+    */
+    inline unsigned threadCounterSlot() {
+        static AtomicUInt next;
+        static ThreadLocalValue<unsigned> mine; // holds id+1; 0 means unassigned
+        unsigned s = mine.get();
+        if ( s == 0 ) {
+            s = ++next;
+            mine.set( s );
+        }
+        return s - 1;
+    }
+
+    /** 64 bit counter sharded over cache-line padded slots selected per thread.
+
+        increment() is a single atomic add on a line no other running thread is
+        touching, so there is no lock and (with fewer threads than slots) no
+        cache-line ping-pong.  get() sums the slots and is comparatively expensive:
+        use this for hot-path statistics that are read rarely (serverStatus et al).
+    */
+    class ShardedCounter64 : boost::noncopyable {
+    public:
+        ShardedCounter64() { zero(); }
+
+        void increment( long long n = 1 ) {
+            Slot& s = _slots[ threadCounterSlot() & (NumSlots-1) ];
+#if defined(_WIN32)
+            InterlockedExchangeAdd64( (volatile long long*)&s.n , n );
+#else
+            __sync_fetch_and_add( &s.n , n );
+#endif
+        }
+
+        /** sum of the slots.  not a point-in-time snapshot versus concurrent
+            increments, which is fine for statistics. */
+        long long get() const {
+            long long t = 0;
+            for ( int i = 0; i < NumSlots; i++ )
+                t += _slots[i].n;
+            return t;
+        }
+
+        /** also not atomic versus concurrent increments - a bump can survive the
+            reset.  acceptable for stats rollover. */
+        void zero() {
+            for ( int i = 0; i < NumSlots; i++ )
+                _slots[i].n = 0;
+        }
+
+    private:
+        enum { NumSlots = 32 }; // power of two; comfortably more than typical core counts
+        struct Slot {
+            volatile long long n;
+            char _pad[ 64 - sizeof(long long) ]; // one slot per cache line
+        };
+        Slot _slots[NumSlots];
+    };
+
+} // namespace mongo
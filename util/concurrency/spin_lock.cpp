@@ -20,11 +20,19 @@
 #include <time.h>
 #include "spin_lock.h"
 
+#if defined(__linux__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace mongo {
 
     SpinLock::~SpinLock() {
 #if defined(_WIN32)
         DeleteCriticalSection(&_cs);
+#elif defined(__linux__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+        // nothing to do
 #elif defined(__USE_XOPEN2K)
         pthread_spin_destroy(&_lock);
 #endif
@@ -33,6 +41,8 @@ namespace mongo {
     SpinLock::SpinLock()
 #if defined(_WIN32)
     { InitializeCriticalSectionAndSpinCount(&_cs, 4000); }
+#elif defined(__linux__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+    : _state( 0 ) { }
 #elif defined(__USE_XOPEN2K)
     { pthread_spin_init( &_lock , 0 ); }
 #elif defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
@@ -41,7 +51,47 @@ namespace mongo {
     : _mutex( "SpinLock" ) { }
 #endif
 
-#if defined(__USE_XOPEN2K)
+#if defined(__linux__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+
+    namespace {
+        void futexWait( volatile int* addr , int expected ) {
+            syscall( SYS_futex , (int*)addr , FUTEX_WAIT , expected , (const struct timespec*)0 , 0 , 0 );
+        }
+        void futexWake( volatile int* addr , int n ) {
+            syscall( SYS_futex , (int*)addr , FUTEX_WAKE , n , (const struct timespec*)0 , 0 , 0 );
+        }
+    }
+
+    NOINLINE_DECL void SpinLock::_lockSlow() {
+        _contentions++;
+
+        // test-and-test-and-set: read until the lock looks free before
+        // touching the line exclusively, and back off exponentially so
+        // contending cores don't slam it in lockstep
+        int backoff = 1;
+        for ( int spins = 0; spins < 1000; spins++ ) {
+            if ( _state == 0 && __sync_bool_compare_and_swap( &_state , 0 , 1 ) )
+                return;
+            for ( int i = 0; i < backoff; i++ )
+                asm volatile ( "pause" );
+            if ( backoff < 256 )
+                backoff <<= 1;
+        }
+
+        // still held: park in the kernel until unlock() wakes us.  we take the
+        // lock with state 2 ("waiters") so the eventual unlock knows to wake;
+        // at worst that costs one spurious FUTEX_WAKE after contention ends.
+        _parks++;
+        while ( __sync_lock_test_and_set( &_state , 2 ) != 0 ) {
+            futexWait( &_state , 2 );
+        }
+    }
+
+    void SpinLock::_wake() {
+        futexWake( &_state , 1 );
+    }
+
+#elif defined(__USE_XOPEN2K)
     NOINLINE_DECL void SpinLock::_lk() {
         /**
          * this is designed to perform close to the default spin lock
@@ -51,7 +101,9 @@ namespace mongo {
          * which is good because even with this change they are about 8x faster on linux
          */
         
-        for ( int i=0; i<1000; i++ ) {            
+        _contentions++;
+
+        for ( int i=0; i<1000; i++ ) {
             if ( pthread_spin_trylock( &_lock ) == 0 )
                 return;
             asm volatile ( "pause" ) ; // maybe trylock does this; just in case.
@@ -62,11 +114,12 @@ namespace mongo {
                 return;
             pthread_yield();
         }
-        
+
         struct timespec t;
         t.tv_sec = 0;
         t.tv_nsec = 5000000;
 
+        _parks++;
         while ( pthread_spin_trylock( &_lock ) != 0 ) {
             nanosleep(&t, NULL);
         }
@@ -79,6 +132,8 @@ namespace mongo {
             return;
         }
 
+        _contentions++;
+
         // wait for lock
         int wait = 1000;
         while ((wait-- > 0) && (_locked)) {
@@ -89,8 +144,11 @@ namespace mongo {
         struct timespec t;
         t.tv_sec = 0;
         t.tv_nsec = 5000000;
-        while (__sync_lock_test_and_set(&_locked, true)) {
-            nanosleep(&t, NULL);
+        if (__sync_lock_test_and_set(&_locked, true)) {
+            _parks++;
+            do {
+                nanosleep(&t, NULL);
+            } while (__sync_lock_test_and_set(&_locked, true));
         }
     }
 #endif
@@ -19,11 +19,18 @@
 #pragma once
 
 #include "mutex.h"
+#include "../../bson/util/atomic_int.h"
 
 namespace mongo {
 
     /**
-     * The spinlock currently requires late GCC support routines to be efficient.
+     * On linux this is an adaptive lock: test-and-test-and-set with
+     * exponential backoff while spinning, then parking in the kernel on a
+     * futex once the lock looks held for a while.  That keeps the uncontended
+     * path at a single compare-and-swap while avoiding both burned cpu and
+     * fixed sleep latency cliffs when contention spikes.
+     *
+     * The spinlock requires late GCC support routines to be efficient.
      * Other platforms default to a mutex implemenation.
      */
     class SpinLock : boost::noncopyable {
@@ -33,12 +40,35 @@ namespace mongo {
 
         static bool isfast(); // true if a real spinlock on this platform
 
+        /** diagnostic counters, updated on the gcc slow paths only (stay 0
+            on windows and the mutex fallback). */
+        unsigned contentions() const { return _contentions; } // lock() took a slow path
+        unsigned parks() const { return _parks; }             // ... and ended up sleeping
+
     private:
+        AtomicUInt _contentions;
+        AtomicUInt _parks;
+
 #if defined(_WIN32)
         CRITICAL_SECTION _cs;
     public:
         void lock() {EnterCriticalSection(&_cs); }
         void unlock() { LeaveCriticalSection(&_cs); }
+#elif defined(__linux__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4)
+        volatile int _state; // 0 = free, 1 = locked, 2 = locked and waiter(s) parked
+        void _lockSlow();
+        void _wake();
+    public:
+        void lock() {
+            if ( __sync_bool_compare_and_swap( &_state, 0, 1 ) )
+                return;
+            _lockSlow();
+        }
+        void unlock() {
+            // xchg is a full barrier; a previous value of 2 means someone parked
+            if ( __sync_lock_test_and_set( &_state, 0 ) == 2 )
+                _wake();
+        }
 #elif defined(__USE_XOPEN2K)
         pthread_spinlock_t _lock;
         void _lk();
@@ -57,20 +57,29 @@ namespace mongo {
     void NotifyAll::waitFor(When e) {
         scoped_lock lock( _mutex );
         ++_nWaiting;
+        _entryCondition.notify_one();
         while( _lastDone < e ) {
             _condition.wait( lock.boost() );
         }
     }
 
-    void NotifyAll::awaitBeyondNow() { 
+    void NotifyAll::awaitBeyondNow() {
         scoped_lock lock( _mutex );
         ++_nWaiting;
+        _entryCondition.notify_one();
         When e = ++_lastReturned;
         while( _lastDone <= e ) {
             _condition.wait( lock.boost() );
         }
     }
 
+    void NotifyAll::waitForWaiter(unsigned millis) {
+        scoped_lock lock( _mutex );
+        if( _nWaiting )
+            return;
+        _entryCondition.timed_wait( lock.boost() , boost::posix_time::milliseconds(millis) );
+    }
+
     void NotifyAll::notifyAll(When e) {
         scoped_lock lock( _mutex );
         _lastDone = e;
@@ -75,9 +75,16 @@ namespace mongo {
         /** indicates how many threads are waiting for a notify. */
         unsigned nWaiting() const { return _nWaiting; }
 
+        /** for the notifier: sleep up to millis ms, but return immediately if a
+            waiter arrives (or is already present).  lets the notifier react to a
+            new waiter right away instead of finishing its sleep first.
+        */
+        void waitForWaiter(unsigned millis);
+
     private:
         mongo::mutex _mutex;
         boost::condition _condition;
+        boost::condition _entryCondition; // signaled when a waiter arrives
         When _lastDone;
         When _lastReturned;
         unsigned _nWaiting;
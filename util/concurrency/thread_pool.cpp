@@ -18,83 +18,64 @@
 
 #include "pch.h"
 #include "thread_pool.h"
-#include "mvar.h"
+#include "spin_lock.h"
+
+#include <deque>
 
 namespace mongo {
     namespace threadpool {
 
-        // Worker thread
-        class Worker : boost::noncopyable {
-        public:
-            explicit Worker(ThreadPool& owner)
-                : _owner(owner)
-                , _is_done(true)
-                , _thread(boost::bind(&Worker::loop, this))
-            {}
-
-            // destructor will block until current operation is completed
-            // Acts as a "join" on this thread
-            ~Worker() {
-                _task.put(Task());
-                _thread.join();
-            }
-
-            void set_task(Task& func) {
-                assert(!func.empty());
-                assert(_is_done);
-                _is_done = false;
+        namespace {
+            const int sleepIntervalMs = 1000;        // idle workers recheck the deques at least this often
+            const int idleIntervalsBeforeRetire = 5; // ~5s idle and an elastic worker exits
+        }
 
-                _task.put(func);
-            }
+        // One worker's task deque.  schedule() pushes under the spinlock
+        // (front for PRIORITY_HIGH, back otherwise); the owning thread pops
+        // from the front and thieves pop from the back, so stealing takes the
+        // oldest, lowest priority work.
+        class Slot : boost::noncopyable {
+        public:
+            SpinLock lock;
+            deque<Task> tasks;
+        };
 
-        private:
-            ThreadPool& _owner;
-            MVar<Task> _task;
-            bool _is_done; // only used for error detection
-            boost::thread _thread;
+        ThreadPool::ThreadPool(int nThreads, int maxThreads)
+            : _mutex("ThreadPool") , _shutdown(false) {
+            if (nThreads < 1)
+                nThreads = 1;
+            if (maxThreads < nThreads)
+                maxThreads = nThreads;
+            _core = nThreads;
 
-            void loop() {
-                while (true) {
-                    Task task = _task.take();
-                    if (task.empty())
-                        break; // ends the thread
+            for (int i = 0; i < maxThreads; i++)
+                _slots.push_back(new Slot());
+            _threads.resize(maxThreads);
 
-                    try {
-                        task();
-                    }
-                    catch (std::exception e) {
-                        log() << "Unhandled exception in worker thread: " << e.what() << endl;;
-                    }
-                    catch (...) {
-                        log() << "Unhandled non-exception in worker thread" << endl;
-                    }
-                    _is_done = true;
-                    _owner.task_done(this);
-                }
-            }
-        };
-
-        ThreadPool::ThreadPool(int nThreads)
-            : _mutex("ThreadPool"), _tasksRemaining(0)
-            , _nThreads(nThreads) {
             scoped_lock lock(_mutex);
-            while (nThreads-- > 0) {
-                Worker* worker = new Worker(*this);
-                _freeWorkers.push_front(worker);
+            for (int i = 0; i < nThreads; i++) {
+                _nRunning++;
+                _threads[i].reset(new boost::thread(boost::bind(&ThreadPool::_workerLoop, this, i)));
             }
         }
 
         ThreadPool::~ThreadPool() {
             join();
 
-            assert(_tasks.empty());
+            {
+                scoped_lock lock(_mutex);
+                _shutdown = true;
+                _sleepCondition.notify_all();
+            }
 
-            // O(n) but n should be small
-            assert(_freeWorkers.size() == (unsigned)_nThreads);
+            for (unsigned i = 0; i < _threads.size(); i++) {
+                if (_threads[i])
+                    _threads[i]->join();
+            }
 
-            while(!_freeWorkers.empty()) {
-                delete _freeWorkers.front();
-                _freeWorkers.pop_front();
+            for (unsigned i = 0; i < _slots.size(); i++) {
+                assert(_slots[i]->tasks.empty());
+                delete _slots[i];
             }
         }
 
@@ -105,36 +86,129 @@ namespace mongo {
             }
         }
 
-        void ThreadPool::schedule(Task task) {
-            scoped_lock lock(_mutex);
-
+        void ThreadPool::schedulePriority(Priority priority, Task task) {
             _tasksRemaining++;
 
-            if (!_freeWorkers.empty()) {
-                _freeWorkers.front()->set_task(task);
-                _freeWorkers.pop_front();
+            // round robin over the deques of the running workers; the only
+            // lock a submission normally takes is the target's spinlock
+            unsigned nRunning = _nRunning;
+            Slot& slot = *_slots[_submitCounter++ % nRunning];
+            {
+                scoped_spinlock lk(slot.lock);
+                if (priority == PRIORITY_HIGH)
+                    slot.tasks.push_front(task);
+                else
+                    slot.tasks.push_back(task);
+            }
+
+            if (_idleWorkers) {
+                // a worker advertises in _idleWorkers before its final check
+                // of the deques, so if one went to sleep without seeing this
+                // task we are guaranteed to see it here and wake it
+                scoped_lock lock(_mutex);
+                _sleepCondition.notify_one();
             }
-            else {
-                _tasks.push_back(task);
+            else if (nRunning < _slots.size()) {
+                _maybeGrow();
             }
         }
 
-        // should only be called by a worker from the worker thread
-        void ThreadPool::task_done(Worker* worker) {
+        void ThreadPool::_maybeGrow() {
             scoped_lock lock(_mutex);
+            if (_shutdown || _idleWorkers || _nRunning >= _slots.size())
+                return;
+
+            unsigned i = _nRunning;
+            if (_threads[i])
+                _threads[i]->join(); // previously retired; reclaim the thread object
+            _nRunning++;
+            _threads[i].reset(new boost::thread(boost::bind(&ThreadPool::_workerLoop, this, i)));
+        }
 
-            if (!_tasks.empty()) {
-                worker->set_task(_tasks.front());
-                _tasks.pop_front();
+        bool ThreadPool::_getTask(unsigned home, Task& task) {
+            {
+                scoped_spinlock lk(_slots[home]->lock);
+                if (!_slots[home]->tasks.empty()) {
+                    task = _slots[home]->tasks.front();
+                    _slots[home]->tasks.pop_front();
+                    return true;
+                }
             }
-            else {
-                _freeWorkers.push_front(worker);
+
+            // steal from the back of someone else's deque.  all slots are
+            // scanned, including those of retired workers, so nothing a
+            // racing schedule() left behind is ever stranded.
+            for (unsigned n = 1; n < _slots.size(); n++) {
+                Slot& victim = *_slots[(home + n) % _slots.size()];
+                scoped_spinlock lk(victim.lock);
+                if (!victim.tasks.empty()) {
+                    task = victim.tasks.back();
+                    victim.tasks.pop_back();
+                    return true;
+                }
             }
 
-            _tasksRemaining--;
+            return false;
+        }
 
-            if(_tasksRemaining == 0)
-                _condition.notify_all();
+        bool ThreadPool::_anyQueued() {
+            for (unsigned i = 0; i < _slots.size(); i++) {
+                scoped_spinlock lk(_slots[i]->lock);
+                if (!_slots[i]->tasks.empty())
+                    return true;
+            }
+            return false;
+        }
+
+        void ThreadPool::_workerLoop(unsigned home) {
+            int idleIntervals = 0;
+
+            while (true) {
+                Task task;
+                if (_getTask(home, task)) {
+                    idleIntervals = 0;
+
+                    try {
+                        task();
+                    }
+                    catch (std::exception& e) {
+                        log() << "Unhandled exception in worker thread: " << e.what() << endl;
+                    }
+                    catch (...) {
+                        log() << "Unhandled non-exception in worker thread" << endl;
+                    }
+
+                    if (--_tasksRemaining == 0) {
+                        scoped_lock lock(_mutex);
+                        _condition.notify_all();
+                    }
+                    continue;
+                }
+
+                scoped_lock lock(_mutex);
+                if (_shutdown)
+                    return;
+
+                // elastic pools retire the highest numbered worker once it has
+                // been idle a while; its deque stays visible to thieves so any
+                // task a racing schedule() put there still runs
+                if (idleIntervals >= idleIntervalsBeforeRetire &&
+                        (int)_nRunning > _core && home + 1 == _nRunning) {
+                    _nRunning--;
+                    return;
+                }
+
+                _idleWorkers++;
+                if (_anyQueued()) {
+                    // recheck after advertising idleness so schedule() cannot
+                    // miss us; see the comment there
+                    _idleWorkers--;
+                    continue;
+                }
+                _sleepCondition.timed_wait(lock.boost(), boost::posix_time::milliseconds(sleepIntervalMs));
+                _idleWorkers--;
+                idleIntervals++;
+            }
         }
 
     } //namespace threadpool
@@ -22,17 +22,41 @@
 #undef assert
 #define assert MONGO_assert
 
+#include "../../bson/util/atomic_int.h"
+
 namespace mongo {
 
     namespace threadpool {
-        class Worker;
+        class Slot; // per-worker task deque, defined in thread_pool.cpp
 
         typedef boost::function<void(void)> Task; //nullary function or functor
 
+        /** Pool of worker threads.
+
+            Each worker owns its own task deque; schedule() distributes tasks
+            round robin across the deques so submitters normally contend only
+            on a per-deque spinlock, never on one global list.  A worker that
+            drains its own deque steals from the back of the others', so a
+            few long tasks don't convoy the rest of the pool.
+
+            The pool can optionally be elastic: pass maxThreads > nThreads and
+            extra workers are started while there is a backlog and no idle
+            thread, then retired after ~5 seconds of idleness.  The default is
+            a fixed size, which is what the existing callers expect.
+        */
         // exported to the mongo namespace
         class ThreadPool : boost::noncopyable {
         public:
-            explicit ThreadPool(int nThreads=8);
+            enum Priority {
+                PRIORITY_HIGH = 0,   // runs before anything already queued on its deque
+                PRIORITY_NORMAL = 1
+            };
+
+            /** @param nThreads threads started immediately; also the floor an
+                       elastic pool shrinks back to
+                @param maxThreads upper bound for dynamic growth. 0 (the
+                       default) means maxThreads == nThreads, i.e. fixed size. */
+            explicit ThreadPool(int nThreads=8, int maxThreads=0);
 
             // blocks until all tasks are complete (tasks_remaining() == 0)
             // You should not call schedule while in the destructor
@@ -44,7 +68,12 @@ namespace mongo {
             void join();
 
             // task will be copied a few times so make sure it's relatively cheap
-            void schedule(Task task);
+            void schedule(Task task) { schedulePriority(PRIORITY_NORMAL, task); }
+
+            // as schedule(), but PRIORITY_HIGH tasks jump ahead of work already
+            // queued on their deque.  a distinct name keeps the schedule()
+            // template helpers below from swallowing the priority argument.
+            void schedulePriority(Priority priority, Task task);
 
             // Helpers that wrap schedule and boost::bind.
             // Functor and args will be copied a few times so make sure it's relatively cheap
@@ -61,18 +90,29 @@ namespace mongo {
 
             int tasks_remaining() { return _tasksRemaining; }
 
-        private:
-            mongo::mutex _mutex;
-            boost::condition _condition;
-
-            list<Worker*> _freeWorkers; //used as LIFO stack (always front)
-            list<Task> _tasks; //used as FIFO queue (push_back, pop_front)
-            int _tasksRemaining; // in queue + currently processing
-            int _nThreads; // only used for sanity checking. could be removed in the future.
+            /** current number of worker threads (varies for an elastic pool) */
+            int nThreads() const { return _nRunning; }
 
-            // should only be called by a worker from the worker's thread
-            void task_done(Worker* worker);
-            friend class Worker;
+        private:
+            // front of own deque first, then steal from the back of the others'
+            bool _getTask( unsigned home , Task& task );
+            bool _anyQueued();
+            void _workerLoop( unsigned home );
+            void _maybeGrow();
+
+            mongo::mutex _mutex;              // protects thread start/retire and the conditions below
+            boost::condition _condition;      // join() waiters
+            boost::condition _sleepCondition; // idle workers
+
+            vector<Slot*> _slots;             // fixed at maxThreads; slot i belongs to thread i
+            vector< shared_ptr<boost::thread> > _threads; // parallel to _slots
+
+            AtomicUInt _tasksRemaining;       // in queues + currently processing
+            AtomicUInt _submitCounter;        // round robin cursor for schedule()
+            AtomicUInt _idleWorkers;          // workers blocked in _sleepCondition
+            AtomicUInt _nRunning;             // threads currently servicing slots [0, _nRunning)
+            int _core;                        // never shrink below this many threads
+            bool _shutdown;
         };
 
     } //namespace threadpool
@@ -78,6 +78,7 @@ namespace mongo {
     public:
         T* get() const;
         void reset(T* v);
+        T* release(); // relinquish ownership without deleting; thread slot becomes empty
     };
 
 # if defined(_WIN32)
@@ -90,7 +91,12 @@ namespace mongo {
     void TSP<T>::reset(T* v) { \
         tsp.reset(v); \
         _ ## p = v; \
-    } 
+    } \
+    template<> T* TSP<T>::release() { \
+        T* v = tsp.release(); \
+        _ ## p = 0; \
+        return v; \
+    }
 # else
 
 #  define TSP_DECLARE(T,p) \
@@ -104,6 +110,11 @@ namespace mongo {
         tsp.reset(v); \
         _ ## p = v; \
     } \
+    template<> T* TSP<T>::release() { \
+        T* v = tsp.release(); \
+        _ ## p = 0; \
+        return v; \
+    } \
     TSP<T> p;
 # endif
 
@@ -115,6 +126,7 @@ namespace mongo {
     public:
         T* get() const { return tsp.get(); }
         void reset(T* v) { tsp.reset(v); }
+        T* release() { return tsp.release(); }
     };
 
 #  define TSP_DECLARE(T,p) extern TSP<T> p;
@@ -81,10 +81,14 @@ namespace mongo {
         return false;
     }
 
+    bool FileAllocator::recentlyOutpaced() const {
+        return false;
+    }
+
 #else
 
     FileAllocator::FileAllocator()
-        : _pendingMutex("FileAllocator"), _failed() {
+        : _pendingMutex("FileAllocator"), _failed(), _lastAsapWait(0) {
     }
 
 
@@ -125,6 +129,11 @@ namespace mongo {
             _pending.insert( i, name );
         }
         _pendingUpdated.notify_all();
+        if ( inProgress( name ) ) {
+            // the writer is stalling on allocation - growth has outpaced the
+            // preallocation headroom.  remember it so callers keep further ahead
+            _lastAsapWait = time( 0 );
+        }
         while( inProgress( name ) ) {
             checkFailure();
             _pendingUpdated.wait( lk.boost() );
@@ -132,6 +141,11 @@ namespace mongo {
 
     }
 
+    bool FileAllocator::recentlyOutpaced() const {
+        scoped_lock lk( _pendingMutex );
+        return _lastAsapWait && time( 0 ) - _lastAsapWait < 60 * 10;
+    }
+
     void FileAllocator::waitUntilFinished() const {
         if ( _failed )
             return;
@@ -141,6 +155,15 @@ namespace mongo {
     }
 
     void FileAllocator::ensureLength(int fd , long size) {
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+        // raw fallocate first: on filesystems with extent support (ext4, xfs)
+        // the kernel reserves zeroed extents without writing them, and unlike
+        // posix_fallocate it reports EOPNOTSUPP elsewhere instead of falling
+        // back to writing every block inside libc, so we keep control of the
+        // fallback path
+        if ( fallocate( fd, 0, 0, size ) == 0 )
+            return;
+#endif
 #if defined(__linux__)
         int ret = posix_fallocate(fd,0,size);
         if ( ret == 0 )
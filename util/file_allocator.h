@@ -47,9 +47,14 @@ namespace mongo {
         void allocateAsap( const string &name, unsigned long long &size );
 
         void waitUntilFinished() const;
-        
+
         bool hasFailed() const;
 
+        /** true if a writer recently had to block in allocateAsap(), i.e. file
+            growth outpaced preallocation.  callers use this to preallocate
+            further ahead while ingest stays heavy. */
+        bool recentlyOutpaced() const;
+
         static void ensureLength(int fd , long size);
 
         /** @return the singletone */
@@ -79,6 +84,7 @@ namespace mongo {
         mutable map< string, long > _pendingSize;
 
         bool _failed;
+        time_t _lastAsapWait; // when a writer last blocked in allocateAsap(); 0 if never
 #endif
         
         static FileAllocator* _instance;
@@ -177,6 +177,7 @@ namespace mongo {
             _done = 0;
             _hits = 0;
             _lastTime = (int)time(0);
+            _startTime = _lastTime;
 
             _active = 1;
         }
@@ -212,6 +213,10 @@ namespace mongo {
                 int per = (int)( ( (double)_done * 100.0 ) / (double)_total );
                 cout << "\t\t" << _done << "/" << _total << "\t" << per << "%";
 
+                int remaining = secondsRemaining();
+                if ( remaining >= 0 )
+                    cout << "\t~" << remaining << " secs remaining";
+
                 if ( ! _units.empty() ) {
                     cout << "\t(" << _units << ")" << endl;
                 }
@@ -231,6 +236,20 @@ namespace mongo {
             _total = total;
         }
 
+        /** @return estimated seconds until completion based on the rate so far,
+                    or -1 when there is not enough history to estimate.
+                    _total may be adjusted while running (setTotalWhileRunning); the
+                    estimate tracks that, so it stays honest for paced operations. */
+        int secondsRemaining() const {
+            if ( ! _active || _done == 0 || _total <= _done )
+                return -1;
+            int elapsed = (int)time(0) - _startTime;
+            if ( elapsed <= 0 )
+                return -1;
+            double rate = (double)_done / elapsed;
+            return (int)( ( _total - _done ) / rate );
+        }
+
         unsigned long long done() const { return _done; }
 
         unsigned long long hits() const { return _hits; }
@@ -243,6 +262,10 @@ namespace mongo {
             stringstream buf;
             buf << _done << "/" << _total << " " << (_done*100)/_total << "%";
 
+            int remaining = secondsRemaining();
+            if ( remaining >= 0 )
+                buf << " ~" << remaining << " secs remaining";
+
             if ( ! _units.empty() ) {
                 buf << "\t(" << _units << ")" << endl;
             }
@@ -264,6 +287,7 @@ namespace mongo {
         unsigned long long _done;
         unsigned long long _hits;
         int _lastTime;
+        int _startTime;
 
         string _units;
     };
@@ -124,6 +124,14 @@ namespace mongo {
             return 0;
         }
 
+        /** @return the node for k, 0 if not present.  for callers that cache node
+            addresses: open addressing, so nodes never move once placed. */
+        Node* getNode(const Key& k) {
+            bool found;
+            int i = _find(k, found);
+            return found ? &nodes(i) : 0;
+        }
+
         void kill(const Key& k) {
             bool found;
             int i = _find(k, found);
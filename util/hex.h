@@ -20,48 +20,42 @@
 namespace mongo {
     //can't use hex namespace because it conflicts with hex iostream function
     inline int fromHex( char c ) {
-        if ( '0' <= c && c <= '9' )
-            return c - '0';
-        if ( 'a' <= c && c <= 'f' )
-            return c - 'a' + 10;
-        if ( 'A' <= c && c <= 'F' )
-            return c - 'A' + 10;
-        assert( false );
-        return 0xff;
+        assert( ( '0' <= c && c <= '9' ) ||
+                ( 'a' <= c && c <= 'f' ) ||
+                ( 'A' <= c && c <= 'F' ) );
+        // branch free conversion: an ascii hex letter (either case) has bit
+        // 0x40 set and a low nibble of 1..6, so nibble + 9 is its value
+        return ( c & 0xf ) + ( ( c >> 6 ) & 1 ) * 9;
     }
     inline char fromHex( const char *c ) {
         return (char)(( fromHex( c[ 0 ] ) << 4 ) | fromHex( c[ 1 ] ));
     }
 
-    inline string toHex(const void* inRaw, int len) {
-        static const char hexchars[] = "0123456789ABCDEF";
-
-        StringBuilder out;
-        const char* in = reinterpret_cast<const char*>(inRaw);
-        for (int i=0; i<len; ++i) {
-            char c = in[i];
-            char hi = hexchars[(c & 0xF0) >> 4];
-            char lo = hexchars[(c & 0x0F)];
-
-            out << hi << lo;
+    /** encode len bytes of in as 2*len hex characters at out (no terminator).
+        the inner loop is two table lookups and two stores per byte - no stream
+        or append call per character. */
+    inline void hexEncode( char* out, const void* inRaw, int len, const char* hexchars ) {
+        const unsigned char* in = reinterpret_cast<const unsigned char*>(inRaw);
+        for ( int i=0; i<len; ++i ) {
+            out[0] = hexchars[ in[i] >> 4 ];
+            out[1] = hexchars[ in[i] & 0xF ];
+            out += 2;
         }
+    }
 
-        return out.str();
+    inline string toHex(const void* inRaw, int len) {
+        static const char hexchars[] = "0123456789ABCDEF";
+        string out( 2 * len, 0 );
+        if ( len )
+            hexEncode( &out[0], inRaw, len, hexchars );
+        return out;
     }
 
     inline string toHexLower(const void* inRaw, int len) {
         static const char hexchars[] = "0123456789abcdef";
-
-        StringBuilder out;
-        const char* in = reinterpret_cast<const char*>(inRaw);
-        for (int i=0; i<len; ++i) {
-            char c = in[i];
-            char hi = hexchars[(c & 0xF0) >> 4];
-            char lo = hexchars[(c & 0x0F)];
-
-            out << hi << lo;
-        }
-
-        return out.str();
+        string out( 2 * len, 0 );
+        if ( len )
+            hexEncode( &out[0], inRaw, len, hexchars );
+        return out;
     }
 }
@@ -0,0 +1,75 @@
+// @file memaccount.cpp
+
+/*    Copyright 2011 10gen Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#include "pch.h"
+#include "memaccount.h"
+#include "concurrency/sharded_counter.h"
+#include "../db/jsobj.h"
+
+namespace mongo {
+
+    namespace memaccount {
+
+        static ShardedCounter64 counters[NSubsystems];
+        static volatile long long limit = 0;
+
+        static const char * names[NSubsystems] = {
+            "extSort",
+            "scanAndOrder",
+            "mapReduce",
+            "messageBuffers"
+        };
+
+        void noteBytes( Subsystem s , long long n ) {
+            counters[s].increment( n );
+        }
+
+        long long used( Subsystem s ) {
+            return counters[s].get();
+        }
+
+        long long totalUsed() {
+            long long t = 0;
+            for ( int i = 0; i < NSubsystems; i++ )
+                t += counters[i].get();
+            return t;
+        }
+
+        void setLimit( long long bytes ) {
+            limit = bytes;
+        }
+
+        bool underPressure() {
+            return limit > 0 && totalUsed() > limit;
+        }
+
+        void append( BSONObjBuilder& b ) {
+            BSONObjBuilder t( b.subobjStart( "transient" ) );
+            long long total = 0;
+            for ( int i = 0; i < NSubsystems; i++ ) {
+                long long n = counters[i].get();
+                total += n;
+                t.appendNumber( names[i] , n );
+            }
+            t.appendNumber( "total" , total );
+            if ( limit > 0 )
+                t.appendNumber( "limit" , limit );
+            t.done();
+        }
+    }
+
+} // namespace mongo
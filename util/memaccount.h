@@ -0,0 +1,63 @@
+// @file memaccount.h
+
+/*    Copyright 2011 10gen Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+#pragma once
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /** byte accounting for the major transient heap consumers, so a climbing
+        RSS can be attributed to a subsystem instead of guessed at.  consumers
+        report acquisitions and releases with noteBytes(); the totals show up
+        in the serverStatus mem section.
+
+        a single soft limit can be set over the accounted total (see
+        --transientMemoryLimitMB).  nothing is enforced here: consumers that
+        can shed poll underPressure() and move work to disk earlier (the
+        external sorter and map/reduce do).  counters are approximate by
+        design - they track the payload sizes callers know about, not
+        allocator overhead.
+    */
+    namespace memaccount {
+
+        enum Subsystem {
+            ExtSort = 0,     // external sort runs (index builds, scanandorder spills)
+            ScanAndOrder,    // in memory sort-without-index result maps
+            MapReduce,       // map/reduce in memory emit maps
+            MessageBuffer,   // network message buffers owned by Message objects
+            NSubsystems
+        };
+
+        /** record bytes acquired ( n > 0 ) or released ( n < 0 ).  cheap: one
+            sharded-counter add, safe on any thread with no lock held. */
+        void noteBytes( Subsystem s , long long n );
+
+        long long used( Subsystem s );
+        long long totalUsed();
+
+        /** soft limit on the accounted total; 0 (the default) disables */
+        void setLimit( long long bytes );
+
+        /** true when a limit is set and the accounted total exceeds it */
+        bool underPressure();
+
+        /** append the per subsystem breakdown (plus total and limit) to b */
+        void append( BSONObjBuilder& b );
+    }
+
+} // namespace mongo
@@ -19,6 +19,7 @@
 #include "mmap.h"
 #include "processinfo.h"
 #include "concurrency/rwlock.h"
+#include "../bson/util/atomic_int.h"
 #include "../db/namespace.h"
 #include "../db/cmdline.h"
 
@@ -27,6 +28,10 @@ namespace mongo {
     set<MongoFile*> MongoFile::mmfiles;
     map<string,MongoFile*> MongoFile::pathToFile;
 
+    bool mapHugePagesHint = false;
+    bool numaInterleaved = false;
+    bool evictBehindScans = false;
+
     /* Create. Must not exist.
     @param zero fill file with zeros when true
     */
@@ -171,6 +176,50 @@ namespace mongo {
         return seen.size();
     }
 
+    namespace {
+        /** work list for flushAllParallel.  workers pull the next file off a
+            shared cursor so a few huge files don't serialize behind each other. */
+        struct ParallelFlush {
+            vector< boost::shared_ptr<MongoFile::Flushable> > work;
+            AtomicUInt next;
+            void worker() {
+                while( 1 ) {
+                    unsigned i = next++;
+                    if ( i >= work.size() )
+                        break;
+                    work[i]->flush();
+                }
+            }
+        };
+    }
+
+    /*static*/ int MongoFile::flushAllParallel( int nThreads ) {
+        notifyPreFlush();
+
+        ParallelFlush pf;
+        {
+            RWLockRecursive::Shared lk(mmmutex);
+            for ( set<MongoFile*>::iterator i = mmfiles.begin(); i != mmfiles.end(); i++ ) {
+                MongoFile * mmf = *i;
+                if ( mmf )
+                    pf.work.push_back( boost::shared_ptr<Flushable>( mmf->prepareFlush() ) );
+            }
+        }
+
+        if ( nThreads > (int) pf.work.size() )
+            nThreads = pf.work.size();
+        vector< boost::shared_ptr<boost::thread> > helpers;
+        for ( int i = 1; i < nThreads; i++ )
+            helpers.push_back( boost::shared_ptr<boost::thread>(
+                                   new boost::thread( boost::bind( &ParallelFlush::worker , &pf ) ) ) );
+        pf.worker(); // this thread pulls its share too
+        for ( unsigned i = 0; i < helpers.size(); i++ )
+            helpers[i]->join();
+
+        notifyPostFlush();
+        return pf.work.size();
+    }
+
     void MongoFile::created() {
         RWLockRecursive::Exclusive lk(mmmutex);
         mmfiles.insert(this);
@@ -21,15 +21,34 @@
 
 namespace mongo {
 
-    class MAdvise { 
+    class MAdvise {
         void *_p;
         unsigned _len;
     public:
         enum Advice { Sequential=1 };
-        MAdvise(void *p, unsigned len, Advice a); 
+        MAdvise(void *p, unsigned len, Advice a);
         ~MAdvise(); // destructor resets the range to MADV_NORMAL
     };
 
+    /** hint the OS to asynchronously page in the given mapped range (MADV_WILLNEED).
+        purely a hint - the range may have been unmapped by the time the advice is
+        processed, which is harmless.  no-op on platforms without madvise.
+    */
+    void adviseWillNeed(void *p, size_t len);
+
+    /** hint the OS that the given mapped range is a cheap eviction candidate
+        (MADV_DONTNEED).  only safe on shared file-backed views - the kernel
+        repopulates from the up-to-date file contents on the next access.  never
+        use on a private (journal) or ephemeral view; those would lose data.
+        no-op on platforms without madvise.
+    */
+    void adviseDontNeed(void *p, size_t len);
+
+    /** opt-in memory mapping tweaks for big-memory boxes; linux only, see db.cpp option parsing */
+    extern bool mapHugePagesHint;  // --hugePages : madvise(MADV_HUGEPAGE) new mappings
+    extern bool numaInterleaved;   // --numaInterleave : set_mempolicy(MPOL_INTERLEAVE) succeeded at startup
+    extern bool evictBehindScans;  // --evictBehindScans : advisory eviction/retention hints, see db/cursor.cpp
+
     /* the administrative-ish stuff here */
     class MongoFile : boost::noncopyable {
     public:
@@ -62,6 +81,12 @@ namespace mongo {
         static void (*notifyPostFlush)();
 
         static int flushAll( bool sync ); // returns n flushed
+
+        /** like flushAll(true) but runs the per-file msyncs on several threads.
+            intended for shutdown where we want the whole set durable as fast as
+            the disks allow.  @param nThreads IO ceiling - max concurrent msyncs.
+            @return n flushed */
+        static int flushAllParallel( int nThreads );
         static long long totalMappedLength();
         static void closeAllFiles( stringstream &message );
 
@@ -183,6 +208,11 @@ namespace mongo {
         void* create(string filename, unsigned long long len, bool zero);
 
         void flush(bool sync);
+
+        /** flush just [ofs,ofs+len) of the flushing view.  lets callers spread
+            the IO of a big file over time instead of one huge msync. */
+        void flushRange(size_t ofs, unsigned len, bool sync);
+
         virtual Flushable * prepareFlush();
 
         long shortLength() const          { return (long) len; }
@@ -225,8 +255,18 @@ namespace mongo {
         virtual void _lock();
         virtual void _unlock();
 
+        /** for subclasses that acquire memory other than via map() (see MongoMMF
+            ephemeral arenas) so length() still answers correctly */
+        void setLength( unsigned long long l ) { len = l; }
+
         /** close the current private view and open a new replacement */
         void* remapPrivateView(void *oldPrivateAddr);
+
+        /** remap just [ofs,ofs+sz) of the private view, in place.  cheaper than
+            remapPrivateView when only part of the view has copy-on-write pages.
+            ofs must be page aligned.  the view address does not change.
+        */
+        void remapPrivateViewRange(void *oldPrivateAddr, size_t ofs, size_t sz);
     };
 
     typedef MemoryMappedFile MMF;
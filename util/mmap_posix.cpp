@@ -61,15 +61,40 @@ namespace mongo {
 #if defined(__sunos__)
     MAdvise::MAdvise(void *,unsigned, Advice) { }
     MAdvise::~MAdvise() { }
+    void adviseWillNeed(void *, size_t) { }
+    void adviseDontNeed(void *, size_t) { }
 #else
     MAdvise::MAdvise(void *p, unsigned len, Advice a) : _p(p), _len(len) {
         assert( a == Sequential ); // more later
         madvise(_p,_len,MADV_SEQUENTIAL);
     }
-    MAdvise::~MAdvise() { 
+    MAdvise::~MAdvise() {
         madvise(_p,_len,MADV_NORMAL);
     }
+    void adviseWillNeed(void *p, size_t len) {
+        madvise(p, len, MADV_WILLNEED);
+    }
+    void adviseDontNeed(void *p, size_t len) {
+        madvise(p, len, MADV_DONTNEED);
+    }
+#endif
+
+    /** ask for transparent huge page backing when --hugePages was given.  a hint; older
+        kernels (or ranges thp can't back) just refuse, which we log only once.
+    */
+    static void adviseHugePages( void *p , size_t len ) {
+#if defined(MADV_HUGEPAGE)
+        if ( ! mapHugePagesHint )
+            return;
+        if ( madvise( p , len , MADV_HUGEPAGE ) ) {
+            static bool warned = false;
+            if ( ! warned ) {
+                warned = true;
+                warning() << "hugePages: madvise(MADV_HUGEPAGE) not honored " << errnoWithDescription() << endl;
+            }
+        }
 #endif
+    }
 
     void* MemoryMappedFile::map(const char *filename, unsigned long long &length, int options) {
         // length may be updated by callee.
@@ -111,6 +136,7 @@ namespace mongo {
                 warning() << "map: madvise failed for " << filename << ' ' << errnoWithDescription() << endl;
             }
         }
+        adviseHugePages( view , length );
 #endif
 
         views.push_back( view );
@@ -147,12 +173,13 @@ namespace mongo {
                     error() << "mmap private failed with out of memory. (64 bit build)" << endl;
                 }
             }
-            else { 
+            else {
                 error() << "mmap private failed " << errnoWithDescription() << endl;
             }
             return 0;
         }
 
+        adviseHugePages( x , len );
         views.push_back(x);
         return x;
     }
@@ -171,6 +198,19 @@ namespace mongo {
         return x;
     }
 
+    void MemoryMappedFile::remapPrivateViewRange(void *oldPrivateAddr, size_t ofs, size_t sz) {
+        void *addr = ((char *)oldPrivateAddr) + ofs;
+        void *x = mmap( addr, sz , PROT_READ|PROT_WRITE , MAP_PRIVATE|MAP_NORESERVE|MAP_FIXED , fd , (off_t) ofs );
+        if( x == MAP_FAILED ) {
+            int err = errno;
+            error()  << "13601 Couldn't remap private view range: " << errnoWithDescription(err) << endl;
+            log() << "aborting" << endl;
+            printMemInfo();
+            abort();
+        }
+        assert( x == addr );
+    }
+
     void MemoryMappedFile::flush(bool sync) {
         if ( views.empty() || fd == 0 )
             return;
@@ -178,6 +218,18 @@ namespace mongo {
             problem() << "msync " << errnoWithDescription() << endl;
     }
 
+    void MemoryMappedFile::flushRange( size_t ofs , unsigned _len , bool sync ) {
+        void *view = viewForFlushing();
+        if ( view == 0 || fd == 0 )
+            return;
+        // msync wants a page aligned address; widen to page boundaries
+        const size_t pg = 4096;
+        size_t start = ofs & ~(pg-1);
+        size_t end = min( (size_t) len , (size_t) (ofs + _len + pg - 1) & ~(pg-1) );
+        if ( msync( ((char*)view) + start , end - start , sync ? MS_SYNC : MS_ASYNC ) )
+            problem() << "msync (range) " << errnoWithDescription() << endl;
+    }
+
     class PosixFlushable : public MemoryMappedFile::Flushable {
     public:
         PosixFlushable( void * view , HANDLE fd , long len )
@@ -28,6 +28,8 @@ namespace mongo {
 
     MAdvise::MAdvise(void *,unsigned, Advice) { }
     MAdvise::~MAdvise() { }
+    void adviseWillNeed(void *, size_t) { }
+    void adviseDontNeed(void *, size_t) { }
 
     /** notification on unmapping so we can clear writable bits */
     void MemoryMappedFile::clearWritableBits(void *p) {
@@ -193,6 +195,23 @@ namespace mongo {
         }
     }
 
+    void MemoryMappedFile::flushRange( size_t ofs , unsigned _len , bool sync ) {
+        void *view = viewForFlushing();
+        if ( view == 0 || fd == 0 )
+            return;
+        scoped_lock lk(*_flushMutex);
+        // FlushViewOfFile starts the writes but returns before they hit disk -
+        // async semantics, which is what the trickle flusher wants
+        if ( ! FlushViewOfFile( ((char*)view) + ofs , _len ) ) {
+            int err = GetLastError();
+            out() << "FlushViewOfFile (range) failed " << err << " file: " << filename() << endl;
+        }
+        if ( sync && ! FlushFileBuffers(fd) ) {
+            int err = GetLastError();
+            out() << "FlushFileBuffers failed " << err << " file: " << filename() << endl;
+        }
+    }
+
     MemoryMappedFile::Flushable * MemoryMappedFile::prepareFlush() {
         return new WindowsFlushable( viewForFlushing() , fd , filename() , _flushMutex );
     }
@@ -35,6 +35,7 @@
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
 #ifdef __openbsd__
 # include <sys/uio.h>
@@ -125,6 +126,33 @@ namespace mongo {
 
 #endif
 
+    namespace {
+        // listen sockets are accepted in batches per select() wakeup (see
+        // initAndListen), which requires accept() not to block once the
+        // queue is drained
+        void setNonBlocking( SOCKET sock ) {
+#ifdef _WIN32
+            u_long one = 1;
+            ioctlsocket( sock, FIONBIO, &one );
+#else
+            fcntl( sock, F_SETFL, fcntl( sock, F_GETFL, 0 ) | O_NONBLOCK );
+#endif
+        }
+
+        // windows and the BSDs hand an accepted socket the listen socket's
+        // non-blocking mode (linux always returns them blocking), and the recv
+        // path treats EWOULDBLOCK without a timeout as a hard error, so put
+        // accepted sockets back into blocking mode explicitly
+        void setBlocking( SOCKET sock ) {
+#ifdef _WIN32
+            u_long zero = 0;
+            ioctlsocket( sock, FIONBIO, &zero );
+#else
+            fcntl( sock, F_SETFL, fcntl( sock, F_GETFL, 0 ) & ~O_NONBLOCK );
+#endif
+        }
+    }
+
     bool Listener::_setupSockets( const vector<SockAddr>& mine , vector<SOCKET>& socks ) {
         for (vector<SockAddr>::const_iterator it=mine.begin(), end=mine.end(); it != end; ++it) {
             const SockAddr& me = *it;
@@ -176,12 +204,16 @@ namespace mongo {
             }
 #endif
             
-            if ( ::listen(sock, 128) != 0 ) {
+            // a deep backlog so reconnect storms queue rather than get SYN
+            // drops while we drain; the kernel caps this at its own limit
+            if ( ::listen(sock, 512) != 0 ) {
                 error() << "listen(): listen() failed " << errnoWithDescription() << endl;
                 closesocket(sock);
                 return false;
             }
 
+            setNonBlocking( sock );
+
             ListeningSockets::get()->add( sock );
 
             socks.push_back(sock);
@@ -284,42 +316,62 @@ namespace mongo {
                 if (! (FD_ISSET(*it, fds)))
                     continue;
 
-                SockAddr from;
-                int s = accept(*it, from.raw(), &from.addressSize);
-                if ( s < 0 ) {
-                    int x = errno; // so no global issues
-                    if ( x == ECONNABORTED || x == EBADF ) {
-                        log() << "Listener on port " << _port << " aborted" << endl;
-                        return;
-                    }
-                    if ( x == 0 && inShutdown() ) {
-                        return;   // socket closed
-                    }
-                    if( !inShutdown() ) {
-                        log() << "Listener: accept() returns " << s << " " << errnoWithDescription(x) << endl;
-                        if (x == EMFILE || x == ENFILE) {
-                            // Connection still in listen queue but we can't accept it yet
-                            error() << "Out of file descriptors. Waiting one second before trying to accept more connections." << warnings;
-                            sleepsecs(1);
+                // the sockets are non-blocking: drain the whole accept queue
+                // per wakeup rather than taking one connection per select(),
+                // so reconnect storms clear quickly
+                while ( ! inShutdown() ) {
+                    SockAddr from;
+                    int s = accept(*it, from.raw(), &from.addressSize);
+                    if ( s < 0 ) {
+                        int x = errno; // so no global issues
+                        if ( x == EAGAIN || x == EWOULDBLOCK
+#ifdef _WIN32
+                             || x == WSAEWOULDBLOCK
+#endif
+                           ) {
+                            break;    // queue drained
+                        }
+                        if ( x == ECONNABORTED ) {
+                            // that client gave up while queued; the listen
+                            // socket itself is fine, keep draining
+                            continue;
+                        }
+                        if ( x == EBADF ) {
+                            log() << "Listener on port " << _port << " aborted" << endl;
+                            return;
+                        }
+                        if ( x == 0 && inShutdown() ) {
+                            return;   // socket closed
                         }
+                        if( !inShutdown() ) {
+                            log() << "Listener: accept() returns " << s << " " << errnoWithDescription(x) << endl;
+                            if (x == EMFILE || x == ENFILE) {
+                                // Connection still in listen queue but we can't accept it yet
+                                error() << "Out of file descriptors. Waiting one second before trying to accept more connections." << warnings;
+                                sleepsecs(1);
+                            }
+                        }
+                        break;
                     }
-                    continue;
-                }
-                if (from.getType() != AF_UNIX)
-                    disableNagle(s);
-                if ( _logConnect && ! cmdLine.quiet ){
-                    int conns = connTicketHolder.used()+1;
-                    const char* word = (conns == 1 ? " connection" : " connections");
-                    log() << "connection accepted from " << from.toString() << " #" << ++connNumber << " (" << conns << word << " now open)" << endl;
-                }
-                
-                Socket newSock = Socket(s, from);
+#if !defined(__linux__)
+                    setBlocking(s);
+#endif
+                    if (from.getType() != AF_UNIX)
+                        disableNagle(s);
+                    if ( _logConnect && ! cmdLine.quiet ){
+                        int conns = connTicketHolder.used()+1;
+                        const char* word = (conns == 1 ? " connection" : " connections");
+                        log() << "connection accepted from " << from.toString() << " #" << ++connNumber << " (" << conns << word << " now open)" << endl;
+                    }
+
+                    Socket newSock = Socket(s, from);
 #ifdef MONGO_SSL
-                if ( _ssl && ( _sslPort == 0 || sslSocks.count(*it) ) ) {
-                    newSock.secureAccepted( _ssl );
-                }
+                    if ( _ssl && ( _sslPort == 0 || sslSocks.count(*it) ) ) {
+                        newSock.secureAccepted( _ssl );
+                    }
 #endif
-                accepted( newSock );
+                    accepted( newSock );
+                }
             }
         }
     }
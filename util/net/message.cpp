@@ -38,7 +38,11 @@ namespace mongo {
             p.send( (char*)_buf, _buf->len, context );
         }
         else {
-            p.send( _data, context );
+            vector< pair< char *, int > > d;
+            d.reserve( _data.size() );
+            for( MsgVec::const_iterator i = _data.begin(); i != _data.end(); ++i )
+                d.push_back( make_pair( i->data, i->len ) );
+            p.send( d, context );
         }
     }
 
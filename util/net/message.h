@@ -19,6 +19,7 @@
 
 #include "sock.h"
 #include "../../bson/util/atomic_int.h"
+#include "../memaccount.h"
 #include "hostandport.h"
 
 namespace mongo {
@@ -38,7 +39,8 @@ namespace mongo {
         dbQuery = 2004,
         dbGetMore = 2005,
         dbDelete = 2006,
-        dbKillCursors = 2007
+        dbKillCursors = 2007,
+        dbCompressed = 2012  /* envelope holding a snappy-compressed message; see MessagingPort */
     };
 
     bool doesOpGetAResponse( int op );
@@ -54,6 +56,7 @@ namespace mongo {
         case dbGetMore: return "getmore";
         case dbDelete: return "remove";
         case dbKillCursors: return "killcursors";
+        case dbCompressed: return "compressed";
         default:
             PRINT(op);
             assert(0);
@@ -153,12 +156,12 @@ namespace mongo {
     class Message {
     public:
         // we assume here that a vector with initial size 0 does no allocation (0 is the default, but wanted to make it explicit).
-        Message() : _buf( 0 ), _data( 0 ), _freeIt( false ) {}
+        Message() : _buf( 0 ), _data( 0 ), _freeIt( false ), _accounted( 0 ) {}
         Message( void * data , bool freeIt ) :
-            _buf( 0 ), _data( 0 ), _freeIt( false ) {
+            _buf( 0 ), _data( 0 ), _freeIt( false ), _accounted( 0 ) {
             _setData( reinterpret_cast< MsgData* >( data ), freeIt );
         };
-        Message(Message& r) : _buf( 0 ), _data( 0 ), _freeIt( false ) {
+        Message(Message& r) : _buf( 0 ), _data( 0 ), _freeIt( false ), _accounted( 0 ) {
             *this = r;
         }
         ~Message() {
@@ -169,7 +172,7 @@ namespace mongo {
 
         MsgData *header() const {
             assert( !empty() );
-            return _buf ? _buf : reinterpret_cast< MsgData* > ( _data[ 0 ].first );
+            return _buf ? _buf : reinterpret_cast< MsgData* > ( _data[ 0 ].data );
         }
         int operation() const { return header()->operation(); }
 
@@ -187,7 +190,7 @@ namespace mongo {
             }
             else {
                 for (MsgVec::const_iterator it = _data.begin(); it != _data.end(); ++it) {
-                    res += it->second;
+                    res += it->len;
                 }
             }
             return res;
@@ -198,20 +201,32 @@ namespace mongo {
         // concat multiple buffers - noop if <2 buffers already, otherwise can be expensive copy
         // can get rid of this if we make response handling smarter
         void concat() {
-            if ( _buf || empty() ) {
+            if ( empty() ) {
+                return;
+            }
+            if ( _buf ) {
+                if ( !_freeIt ) {
+                    // unowned single buffer (op-arena scratch) - materialize a copy we
+                    // own, since callers of concat() go on to take ownership
+                    int sz = _buf->len;
+                    char *buf = (char*)malloc( sz );
+                    memcpy( buf, _buf, sz );
+                    reset();
+                    _setData( (MsgData*)buf, true );
+                }
                 return;
             }
 
             assert( _freeIt );
             int totalSize = 0;
-            for( vector< pair< char *, int > >::const_iterator i = _data.begin(); i != _data.end(); ++i ) {
-                totalSize += i->second;
+            for( MsgVec::const_iterator i = _data.begin(); i != _data.end(); ++i ) {
+                totalSize += i->len;
             }
             char *buf = (char*)malloc( totalSize );
             char *p = buf;
-            for( vector< pair< char *, int > >::const_iterator i = _data.begin(); i != _data.end(); ++i ) {
-                memcpy( p, i->first, i->second );
-                p += i->second;
+            for( MsgVec::const_iterator i = _data.begin(); i != _data.end(); ++i ) {
+                memcpy( p, i->data, i->len );
+                p += i->len;
             }
             reset();
             _setData( (MsgData*)buf, true );
@@ -228,6 +243,8 @@ namespace mongo {
             }
             r._freeIt = false;
             _freeIt = true;
+            _accounted = r._accounted; // ownership of the bytes moved with the buffers
+            r._accounted = 0;
             return *this;
         }
 
@@ -236,34 +253,55 @@ namespace mongo {
                 if ( _buf ) {
                     free( _buf );
                 }
-                for( vector< pair< char *, int > >::const_iterator i = _data.begin(); i != _data.end(); ++i ) {
-                    free(i->first);
+                for( MsgVec::const_iterator i = _data.begin(); i != _data.end(); ++i ) {
+                    if ( i->freeIt )
+                        free(i->data);
                 }
             }
             _buf = 0;
             _data.clear();
             _freeIt = false;
+            if ( _accounted ) {
+                memaccount::noteBytes( memaccount::MessageBuffer , -_accounted );
+                _accounted = 0;
+            }
         }
 
         // use to add a buffer
-        // assumes message will free everything
-        void appendData(char *d, int size) {
+        // @param ownIt message frees the buffer on reset when true; when false the
+        //        fragment is only a view and the caller guarantees the region stays
+        //        valid (and unchanged) until the message has been sent
+        void appendData(char *d, int size, bool ownIt = true) {
             if ( size <= 0 ) {
                 return;
             }
             if ( empty() ) {
+                // first fragment holds the MsgData header we update in place, so it
+                // must be writable even when unowned (e.g. op-arena scratch) - never
+                // pass read-only memory first
                 MsgData *md = (MsgData*)d;
                 md->len = size; // can be updated later if more buffers added
-                _setData( md, true );
+                _setData( md, ownIt );
                 return;
             }
-            assert( _freeIt );
             if ( _buf ) {
-                _data.push_back( make_pair( (char*)_buf, _buf->len ) );
+                _data.push_back( Fragment( (char*)_buf, _buf->len, _freeIt ) );
                 _buf = 0;
+                _freeIt = true; // in fragment mode the per-fragment flags carry ownership
             }
-            _data.push_back( make_pair( d, size ) );
+            assert( _freeIt );
+            _data.push_back( Fragment( d, size, ownIt ) );
             header()->len += size;
+            if ( ownIt ) {
+                _accounted += size;
+                memaccount::noteBytes( memaccount::MessageBuffer , size );
+            }
+        }
+
+        /** append a region owned by someone else (e.g. a memory mapped document) to be
+            sent scatter-gather with the rest of the message.  see appendData re lifetime. */
+        void appendDataView(const char *d, int size) {
+            appendData( const_cast<char*>(d), size, false );
         }
 
         // use to set first buffer if empty
@@ -288,6 +326,24 @@ namespace mongo {
             return _freeIt;
         }
 
+        /** release ownership of the single buffer d, without freeing it, if this
+            message still holds it.  used by MessagingPort to reclaim its receive
+            buffer for reuse; returns false (and changes nothing) if the buffer
+            was stolen (operator=), replaced, or the message went multi-fragment
+            since recv().
+        */
+        bool releaseBufferIfIs( MsgData * d ) {
+            if ( ! _freeIt || _buf != d || ! _data.empty() )
+                return false;
+            _buf = 0;
+            _freeIt = false;
+            if ( _accounted ) {
+                memaccount::noteBytes( memaccount::MessageBuffer , -_accounted );
+                _accounted = 0;
+            }
+            return true;
+        }
+
         void send( MessagingPort &p, const char *context );
         
         string toString() const;
@@ -296,13 +352,26 @@ namespace mongo {
         void _setData( MsgData *d, bool freeIt ) {
             _freeIt = freeIt;
             _buf = d;
+            if ( freeIt ) {
+                // d->len can be grown in place later (appendData), so remember
+                // what we charged rather than re-reading it at release time
+                _accounted += d->len;
+                memaccount::noteBytes( memaccount::MessageBuffer , d->len );
+            }
         }
         // if just one buffer, keep it in _buf, otherwise keep a sequence of buffers in _data
         MsgData * _buf;
         // byte buffer(s) - the first must contain at least a full MsgData unless using _buf for storage instead
-        typedef vector< pair< char*, int > > MsgVec;
+        struct Fragment {
+            Fragment( char *d , int l , bool f ) : data(d), len(l), freeIt(f) {}
+            char *data;
+            int len;
+            bool freeIt; // owned by this Message, or just a view?
+        };
+        typedef vector< Fragment > MsgVec;
         MsgVec _data;
         bool _freeIt;
+        int _accounted; // owned bytes reported to memaccount::MessageBuffer
     };
 
 
@@ -25,6 +25,7 @@
 #include "message_port.h"
 #include "listen.h"
 
+#include "../compress.h"
 #include "../goodies.h"
 #include "../background.h"
 #include "../time_support.h"
@@ -95,6 +96,73 @@ namespace mongo {
         char * _cur;
     };
 
+    /* recvbufcache --------------------------------------------------------------- */
+
+    RecvBufCache::RecvBufCache() {
+        for ( int i = 0; i < NumClasses; i++ ) {
+            _entries[i].buf = 0;
+            _entries[i].idle = 0;
+        }
+    }
+
+    RecvBufCache::~RecvBufCache() {
+        for ( int i = 0; i < NumClasses; i++ ) {
+            if ( _entries[i].buf )
+                free( _entries[i].buf );
+        }
+    }
+
+    int RecvBufCache::_classFor( int size ) const {
+        int c = 0;
+        int cap = MinClassBytes;
+        while ( cap < size ) {
+            cap <<= 1;
+            c++;
+        }
+        return c < NumClasses ? c : -1;
+    }
+
+    char * RecvBufCache::get( int size , int & cap ) {
+        int c = _classFor( size );
+        if ( c < 0 ) {
+            // too large to be worth caching - plain malloc, put() will free it
+            cap = size;
+            return (char*)malloc( size );
+        }
+
+        // age the other classes so ones this connection stops using get freed
+        for ( int i = 0; i < NumClasses; i++ ) {
+            Entry& e = _entries[i];
+            if ( e.buf == 0 || i == c )
+                continue;
+            if ( ++e.idle > MaxIdleGets ) {
+                free( e.buf );
+                e.buf = 0;
+                e.idle = 0;
+            }
+        }
+
+        cap = MinClassBytes << c;
+        Entry& e = _entries[c];
+        e.idle = 0;
+        if ( e.buf ) {
+            char * b = e.buf;
+            e.buf = 0;
+            return b;
+        }
+        return (char*)malloc( cap );
+    }
+
+    void RecvBufCache::put( char * buf , int cap ) {
+        int c = _classFor( cap );
+        if ( c < 0 || ( MinClassBytes << c ) != cap || _entries[c].buf ) {
+            free( buf );
+            return;
+        }
+        _entries[c].buf = buf;
+        _entries[c].idle = 0;
+    }
+
     class Ports {
         set<MessagingPort*> ports;
         mongo::mutex m;
@@ -126,19 +194,19 @@ namespace mongo {
         ports.closeAll(mask);
     }
 
-    MessagingPort::MessagingPort(int fd, const SockAddr& remote) 
-        : Socket( fd , remote ) , piggyBackData(0) {
+    MessagingPort::MessagingPort(int fd, const SockAddr& remote)
+        : Socket( fd , remote ) , piggyBackData(0) , _compress(false) , _lastRecvBuf(0) , _lastRecvCap(0) {
         ports.insert(this);
     }
 
-    MessagingPort::MessagingPort( double timeout, int ll ) 
-        : Socket( timeout, ll ) {
+    MessagingPort::MessagingPort( double timeout, int ll )
+        : Socket( timeout, ll ) , _compress(false) , _lastRecvBuf(0) , _lastRecvCap(0) {
         ports.insert(this);
         piggyBackData = 0;
     }
 
     MessagingPort::MessagingPort( Socket& sock )
-        : Socket( sock ) , piggyBackData( 0 ) {
+        : Socket( sock ) , piggyBackData( 0 ) , _compress(false) , _lastRecvBuf(0) , _lastRecvCap(0) {
         ports.insert(this);
     }
 
@@ -187,7 +255,8 @@ again:
 
             int z = (len+1023)&0xfffffc00;
             assert(z>=len);
-            MsgData *md = (MsgData *) malloc(z);
+            int cap;
+            MsgData *md = (MsgData *) _recvBufCache.get( z , cap );
             assert(md);
             md->len = len;
 
@@ -198,11 +267,28 @@ again:
                 Socket::recv( p, left );
             }
             catch (...) {
-                free(md);
+                _recvBufCache.put( (char*)md , cap );
                 throw;
             }
 
             m.setData(md, true);
+
+            if ( md->operation() == dbCompressed ) {
+                // peer compresses - reciprocate on our sends from here on
+                _compress = true;
+                if ( ! _uncompressMessage( m ) ) {
+                    log(0) << "recv(): bad compressed message from " << remoteString() << endl;
+                    m.reset();
+                    return false;
+                }
+                // the message now holds a fresh exact-sized buffer and md was
+                // freed; record nothing so recycle() leaves it alone
+            }
+            else {
+                _lastRecvBuf = md;
+                _lastRecvCap = cap;
+            }
+
             return true;
 
         }
@@ -249,16 +335,83 @@ again:
         return true;
     }
 
-    void MessagingPort::assertStillConnected() { 
+    void MessagingPort::recycle( Message& m ) {
+        MsgData * b = _lastRecvBuf;
+        _lastRecvBuf = 0;
+        if ( b == 0 )
+            return;
+        // reclaim only the exact buffer we handed out, and only if the message
+        // still owns it - e.g. exhaust queries steal it (originalMessage) and
+        // those keep plain free() semantics.  b is never dereferenced here.
+        if ( m.releaseBufferIfIs( b ) )
+            _recvBufCache.put( (char*)b , _lastRecvCap );
+    }
+
+    void MessagingPort::assertStillConnected() {
         uassert(15901, "client disconnected during operation", Socket::stillConnected());
     }
 
+    namespace {
+        // below this size the envelope overhead and cpu aren't worth it
+        const int minBytesToCompress = 1024;
+    }
+
+    /** wrap m in a dbCompressed envelope: [int originalOp][int originalDataLen][snappy bytes].
+        leaves m untouched if it doesn't actually shrink. */
+    void MessagingPort::_compressMessage( Message& m ) {
+        m.concat(); // snappy wants contiguous input
+        MsgData * md = m.singleData();
+        string out;
+        mongo::compress( md->_data , md->dataLen() , &out );
+        if ( (int)out.size() + 8 >= md->dataLen() )
+            return; // incompressible; send as is
+        MsgData * d = (MsgData*)malloc( MsgDataHeaderSize + 8 + out.size() );
+        d->len = MsgDataHeaderSize + 8 + out.size();
+        d->id = md->id;
+        d->responseTo = md->responseTo;
+        d->setOperation( dbCompressed );
+        d->dataAsInt() = md->operation();
+        *((int*)(d->_data + 4)) = md->dataLen();
+        memcpy( d->_data + 8 , out.data() , out.size() );
+        Message c( d , true );
+        m.reset();
+        m = c;
+    }
+
+    bool MessagingPort::_uncompressMessage( Message& m ) {
+        MsgData * md = m.singleData();
+        if ( md->dataLen() < 8 )
+            return false;
+        int originalOp = md->dataAsInt();
+        int originalLen = *((int*)(md->_data + 4));
+        if ( originalLen < 0 || originalLen > 48000000 )
+            return false;
+        string out;
+        if ( ! mongo::uncompress( md->_data + 8 , md->dataLen() - 8 , &out ) )
+            return false;
+        if ( (int)out.size() != originalLen )
+            return false;
+        MsgData * d = (MsgData*)malloc( MsgDataHeaderSize + originalLen );
+        d->len = MsgDataHeaderSize + originalLen;
+        d->id = md->id;
+        d->responseTo = md->responseTo;
+        d->setOperation( originalOp );
+        memcpy( d->_data , out.data() , out.size() );
+        Message u( d , true );
+        m.reset();
+        m = u;
+        return true;
+    }
+
     void MessagingPort::say(Message& toSend, int responseTo) {
         assert( !toSend.empty() );
         mmm( log() << "*  say() sock:" << this->sock << " thr:" << GetCurrentThreadId() << endl; )
         toSend.header()->id = nextMessageId();
         toSend.header()->responseTo = responseTo;
 
+        if ( _compress && toSend.header()->len >= minBytesToCompress && toSend.operation() != dbCompressed )
+            _compressMessage( toSend );
+
         if ( piggyBackData && piggyBackData->len() ) {
             mmm( log() << "*     have piggy back" << endl; )
             if ( ( piggyBackData->len() + toSend.header()->len ) > 1300 ) {
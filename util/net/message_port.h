@@ -47,6 +47,43 @@ namespace mongo {
 
     };
 
+    /** small per-connection cache of receive buffers.  recv() needs a fresh
+        buffer per message and most connections see a steady stream of similarly
+        sized requests, so recycling the previous request's buffer removes a
+        malloc/free pair from every op.  buffers live in power-of-two size
+        classes, at most one per class, and a class that goes unused is freed
+        after a while so an idle or formerly-bursty connection doesn't pin
+        memory.  not thread safe - each port is serviced by one thread.
+    */
+    class RecvBufCache : boost::noncopyable {
+    public:
+        RecvBufCache();
+        ~RecvBufCache();
+
+        /** a buffer of at least size bytes.  cap receives the true capacity to
+            pass back to put(). */
+        char * get( int size , int & cap );
+
+        /** return a buffer obtained from get() for reuse (or freeing) */
+        void put( char * buf , int cap );
+
+    private:
+        enum {
+            MinClassBytes = 1024 , // recv() already rounds lengths up to 1k
+            NumClasses = 11 ,      // 1k .. 1mb; larger buffers aren't cached
+            MaxIdleGets = 64       // free a class this many gets go by without using it
+        };
+
+        /** size class index for size, or -1 if too large to cache */
+        int _classFor( int size ) const;
+
+        struct Entry {
+            char * buf;
+            int idle;
+        };
+        Entry _entries[NumClasses];
+    };
+
     class MessagingPort : public AbstractMessagingPort , public Socket {
     public:
         MessagingPort(int fd, const SockAddr& remote);
@@ -85,15 +122,42 @@ namespace mongo {
 
         void piggyBack( Message& toSend , int responseTo = -1 );
 
+        /** hand the receive buffer of a fully processed message back for reuse
+            by this port's next recv().  safe to call with any message: only the
+            buffer the last recv() here produced is reclaimed, and only if m
+            still owns it - messages whose buffer was stolen (Message::operator=)
+            or replaced (decompression) recycle nothing and keep plain free()
+            semantics.
+        */
+        void recycle( Message& m );
+
+        /** wire compression (snappy).  when on, say() wraps payloads above a small
+            threshold in a dbCompressed envelope and recv() transparently unwraps
+            incoming ones.  a port that receives a compressed message starts
+            compressing its own sends, so servers reciprocate automatically; the
+            initiating side opts in explicitly (--networkCompression).
+        */
+        void setCompression( bool on ) { _compress = on; }
+        bool isCompressionEnabled() const { return _compress; }
+
         unsigned remotePort() const { return Socket::remotePort(); }
         virtual HostAndPort remote() const;
 
         void assertStillConnected();
 
     private:
-        
+
+        void _compressMessage( Message& m );
+        bool _uncompressMessage( Message& m );
+
         PiggyBackData * piggyBackData;
-        
+
+        bool _compress;
+
+        RecvBufCache _recvBufCache;
+        MsgData * _lastRecvBuf; // what recv() last handed out, so recycle() can verify identity
+        int _lastRecvCap;       // its capacity per _recvBufCache - never rederive from the header
+
         // this is the parsed version of remote
         // mutable because its initialized only on call to remote()
         mutable HostAndPort _remoteParsed; 
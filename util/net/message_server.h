@@ -45,6 +45,26 @@ namespace mongo {
          * called once when a socket is disconnected
          */
         virtual void disconnected( AbstractMessagingPort* p ) = 0;
+
+        /**
+         * event-driven servers service many connections from a pool of threads, so
+         * per-connection thread-local state (Client, ...) has to be parked when a
+         * connection goes idle and restored when another worker picks it up.
+         * releaseConnectionState() is called after the last process() of a burst and
+         * returns an opaque handle; restoreConnectionState() is called with that
+         * handle before the next process() (possibly on a different thread).
+         * thread-per-connection servers never call these.
+         */
+        virtual void* releaseConnectionState() { return 0; }
+        virtual void restoreConnectionState( void* state ) {}
+
+        /**
+         * called after disconnected() to dispose of whatever thread-local state the
+         * handler set up for the connection.  event-driven servers call it from a
+         * pooled worker; the port server calls it before a handler thread parks
+         * itself to await another connection (see pms::HandlerPool).
+         */
+        virtual void destroyConnectionState() {}
     };
 
     class MessageServer {
@@ -52,8 +72,9 @@ namespace mongo {
         struct Options {
             int port;                   // port to bind to
             string ipList;             // addresses to bind to
+            bool eventLoop;            // epoll event loop + worker pool rather than thread per connection (linux only)
 
-            Options() : port(0), ipList("") {}
+            Options() : port(0), ipList(""), eventLoop(false) {}
         };
 
         virtual ~MessageServer() {}
@@ -61,6 +82,10 @@ namespace mongo {
         virtual void setAsTimeTracker() = 0;
     };
 
-    // TODO use a factory here to decide between port and asio variations
     MessageServer * createServer( const MessageServer::Options& opts , MessageHandler * handler );
+
+#if defined(__linux__)
+    /** see message_server_epoll.cpp */
+    MessageServer * createEPollServer( const MessageServer::Options& opts , MessageHandler * handler );
+#endif
 }
@@ -0,0 +1,241 @@
+// message_server_epoll.cpp
+
+/*    Copyright 2011 10gen Inc.
+ *
+ *    Licensed under the Apache License, Version 2.0 (the "License");
+ *    you may not use this file except in compliance with the License.
+ *    You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the License is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the License for the specific language governing permissions and
+ *    limitations under the License.
+ */
+
+/* event-driven alternative to PortMessageServer (--eventLoop).
+
+   thread-per-connection falls over past a few thousand connections: a megabyte of
+   stack each plus scheduler churn.  here idle connections are parked in an epoll set
+   and own no thread at all; when one becomes readable it is handed to a small worker
+   pool (sized to cores).  EPOLLONESHOT keeps a connection owned by at most one
+   worker, and MessageHandler::releaseConnectionState/restoreConnectionState move the
+   per-connection thread-local state (Client, ...) between workers.
+*/
+
+#include "pch.h"
+
+#if defined(__linux__)
+
+#include <sys/epoll.h>
+
+#include "message.h"
+#include "message_port.h"
+#include "message_server.h"
+#include "listen.h"
+
+#include "../queue.h"
+#include "../../db/cmdline.h"
+#include "../../db/lasterror.h"
+#include "../../db/stats/counters.h"
+
+namespace mongo {
+
+    namespace pmse {
+
+        class EPollMessageServer;
+
+        /** a connection parked in the epoll set.  owned by the server; deleted on
+            disconnect by whichever worker observes it. */
+        struct Connection : boost::noncopyable {
+            Connection( MessagingPort * port ) :
+                p( port ),
+                le( new LastError() ),
+                handlerState( 0 ),
+                started( false ) {
+                otherSide = p->remoteString();
+            }
+            ~Connection() {
+                delete le;
+                delete p;
+            }
+            MessagingPort * const p;
+            LastError * const le;   // this connection's last error; lent to the servicing thread's TLS
+            void * handlerState;    // opaque, from MessageHandler::releaseConnectionState()
+            string otherSide;
+            bool started;           // handler->connected() done?
+        };
+
+        class EPollMessageServer : public MessageServer , public Listener {
+        public:
+            EPollMessageServer( const MessageServer::Options& opts , MessageHandler * handler ) :
+                Listener( "" , opts.ipList , opts.port ),
+                _handler( handler ),
+                _epfd( -1 ) {
+            }
+
+            virtual void accepted(MessagingPort * p) {
+                if ( ! connTicketHolder.tryAcquire() ) {
+                    log() << "connection refused because too many open connections: " << connTicketHolder.used() << endl;
+                    p->shutdown();
+                    delete p;
+                    sleepmillis(2); // otherwise we'll hard loop
+                    return;
+                }
+                Connection * c = new Connection( p );
+                struct epoll_event ev;
+                ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+                ev.data.ptr = c;
+                if ( epoll_ctl( _epfd , EPOLL_CTL_ADD , p->rawFD() , &ev ) ) {
+                    log() << "epoll_ctl add failed: " << errnoWithDescription() << endl;
+                    connTicketHolder.release();
+                    p->shutdown();
+                    delete c;
+                }
+            }
+
+            virtual void setAsTimeTracker() {
+                Listener::setAsTimeTracker();
+            }
+
+            void run() {
+                _epfd = epoll_create( 1024 /* size hint, ignored by modern kernels */ );
+                massert( 16221 , "epoll_create failed" , _epfd >= 0 );
+
+                unsigned workers = boost::thread::hardware_concurrency();
+                if ( workers == 0 )
+                    workers = 4;
+                log() << "event loop message server starting with " << workers << " workers" << endl;
+                for ( unsigned i = 0; i < workers; i++ )
+                    boost::thread( boost::bind( &EPollMessageServer::workerThread , this ) );
+                boost::thread( boost::bind( &EPollMessageServer::eventThread , this ) );
+
+                initAndListen();
+            }
+
+            virtual bool useUnixSockets() const { return true; }
+
+        private:
+            void eventThread() {
+                setThreadName( "eventloop" );
+                const int MaxEvents = 128;
+                struct epoll_event events[MaxEvents];
+                while ( ! inShutdown() ) {
+                    int n = epoll_wait( _epfd , events , MaxEvents , 1000 );
+                    if ( n < 0 ) {
+                        if ( errno == EINTR )
+                            continue;
+                        log() << "epoll_wait failed: " << errnoWithDescription() << endl;
+                        break;
+                    }
+                    for ( int i = 0; i < n; i++ ) {
+                        // hand off to a worker; EPOLLONESHOT means this fd won't fire
+                        // again until that worker re-arms it
+                        _ready.push( (Connection*)events[i].data.ptr );
+                    }
+                }
+            }
+
+            void workerThread() {
+                setThreadName( "conn" );
+                while ( ! inShutdown() ) {
+                    Connection * c = 0;
+                    if ( ! _ready.blockingPop( c , 1 ) )
+                        continue;
+                    service( c );
+                }
+            }
+
+            /** handle whatever is pending on c, then either park it back in the epoll
+                set or tear it down. */
+            void service( Connection * c ) {
+                MessagingPort * p = c->p;
+
+                if ( ! c->started ) {
+                    _handler->connected( p );
+                    c->started = true;
+                }
+                else {
+                    _handler->restoreConnectionState( c->handlerState );
+                    c->handlerState = 0;
+                }
+                lastError.reset( c->le );
+
+                bool open = true;
+                try {
+                    Message m;
+                    p->clearCounters();
+                    if ( ! p->recv(m) ) {
+                        if ( ! cmdLine.quiet ) {
+                            int conns = connTicketHolder.used()-1;
+                            const char* word = (conns == 1 ? " connection" : " connections");
+                            log() << "end connection " << c->otherSide << " (" << conns << word << " now open)" << endl;
+                        }
+                        open = false;
+                    }
+                    else {
+                        _handler->process( m , p , c->le );
+                        p->recycle( m );
+                        networkCounter.hit( p->getBytesIn() , p->getBytesOut() );
+                    }
+                }
+                catch ( AssertionException& e ) {
+                    log() << "AssertionException handling request, closing client connection: " << e << endl;
+                    open = false;
+                }
+                catch ( SocketException& e ) {
+                    log() << "SocketException handling request, closing client connection: " << e << endl;
+                    open = false;
+                }
+                catch ( const ClockSkewException & ) {
+                    log() << "ClockSkewException - shutting down" << endl;
+                    exitCleanly( EXIT_CLOCK_SKEW );
+                }
+                catch ( const DBException& e ) { // must be right above std::exception to avoid catching subclasses
+                    log() << "DBException handling request, closing client connection: " << e << endl;
+                    open = false;
+                }
+                catch ( std::exception &e ) {
+                    error() << "Uncaught std::exception: " << e.what() << ", terminating" << endl;
+                    dbexit( EXIT_UNCAUGHT );
+                }
+
+                // the le stays owned by the Connection
+                lastError.release();
+
+                if ( open ) {
+                    c->handlerState = _handler->releaseConnectionState();
+                    struct epoll_event ev;
+                    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+                    ev.data.ptr = c;
+                    if ( epoll_ctl( _epfd , EPOLL_CTL_MOD , p->rawFD() , &ev ) == 0 )
+                        return; // parked again; we no longer own c
+                    log() << "epoll_ctl re-arm failed: " << errnoWithDescription() << endl;
+                    _handler->restoreConnectionState( c->handlerState );
+                    c->handlerState = 0;
+                }
+
+                // teardown.  fd deregisters from epoll automatically on close.
+                p->shutdown();
+                _handler->disconnected( p );
+                _handler->destroyConnectionState();
+                delete c;
+                connTicketHolder.release();
+            }
+
+            MessageHandler * _handler;
+            int _epfd;
+            BlockingQueue<Connection*> _ready;
+        };
+
+    } // namespace pmse
+
+    MessageServer * createEPollServer( const MessageServer::Options& opts , MessageHandler * handler ) {
+        return new pmse::EPollMessageServer( opts , handler );
+    }
+
+}
+
+#endif // __linux__
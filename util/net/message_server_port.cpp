@@ -17,6 +17,8 @@
 
 #include "pch.h"
 
+#include <deque>
+
 #ifndef USE_ASIO
 
 #include "message.h"
@@ -38,11 +40,63 @@ namespace mongo {
 
         MessageHandler * handler;
 
-        void threadRun( MessagingPort * inPort) {
+        /** parked "conn" threads.  a finished connection's thread offers
+            itself here instead of exiting, and accepted() hands new sockets to
+            a parked thread when one is available, so a reconnect storm mostly
+            reuses threads that already exist rather than paying a
+            pthread_create (and a thread stack mapping) per connection. */
+        class HandlerPool {
+        public:
+            HandlerPool() : _lock( "pms::HandlerPool" ), _idle(0) {}
+
+            /** hand a new connection to a parked thread.
+                @return false if none is free; caller should spawn instead */
+            bool dispatch( MessagingPort * p ) {
+                scoped_lock lk( _lock );
+                if ( _idle <= (int)_ready.size() )
+                    return false;
+                _ready.push_back( p );
+                _work.notify_one();
+                return true;
+            }
+
+            /** park the calling thread until another connection arrives.
+                @return 0 if nothing showed up in time; caller should exit */
+            MessagingPort * park() {
+                scoped_lock lk( _lock );
+                if ( _idle >= MaxIdleThreads || inShutdown() )
+                    return 0;
+                _idle++;
+                boost::xtime deadline;
+                boost::xtime_get( &deadline , boost::TIME_UTC );
+                deadline.sec += IdleTimeoutSecs;
+                while ( _ready.empty() && ! inShutdown() ) {
+                    if ( ! _work.timed_wait( lk.boost() , deadline ) )
+                        break;
+                }
+                _idle--;
+                if ( _ready.empty() )
+                    return 0;
+                MessagingPort * p = _ready.front();
+                _ready.pop_front();
+                return p;
+            }
+
+        private:
+            // enough parked threads to absorb an app tier reconnecting all at
+            // once; beyond this idle threads exit and storms fall back to
+            // spawning as before
+            enum { MaxIdleThreads = 50 , IdleTimeoutSecs = 60 };
+
+            mongo::mutex _lock;
+            boost::condition _work;
+            int _idle;                      // threads waiting in park()
+            std::deque<MessagingPort*> _ready; // dispatched, not yet claimed
+        } handlerPool;
+
+        void serveConnection( MessagingPort * inPort ) {
             TicketHolderReleaser connTicketReleaser( &connTicketHolder );
 
-            setThreadName( "conn" );
-            
             assert( inPort );
             inPort->setLogLevel(1);
             scoped_ptr<MessagingPort> p( inPort );
@@ -75,6 +129,7 @@ namespace mongo {
                     }
 
                     handler->process( m , p.get() , le );
+                    p->recycle( m );
                     networkCounter.hit( p->getBytesIn() , p->getBytesOut() );
                 }
             }
@@ -104,6 +159,30 @@ namespace mongo {
             }
 
             handler->disconnected( p.get() );
+
+            // this thread may pick up another connection (see threadRun), so
+            // tear thread-local state down now instead of at thread exit
+            handler->destroyConnectionState();
+        }
+
+        void threadRun( MessagingPort * inPort ) {
+            setThreadName( "conn" );
+
+            // inPort may be 0 for a pre-warmed thread: it parks straight away
+            while ( 1 ) {
+                if ( inPort )
+                    serveConnection( inPort );
+                inPort = handlerPool.park();
+                if ( inPort == 0 )
+                    break;
+            }
+        }
+
+        /** spawn a few handler threads ahead of the first connections so even
+            a storm right after startup finds parked threads waiting */
+        void prewarmHandlerPool() {
+            for ( int i = 0; i < 4; i++ )
+                boost::thread thr( boost::bind( &threadRun , (MessagingPort*)0 ) );
         }
 
     }
@@ -130,6 +209,12 @@ namespace mongo {
                 return;
             }
 
+            if ( pms::handlerPool.dispatch( p ) ) {
+                // a parked handler thread took it; no spawn needed.  its
+                // TicketHolderReleaser releases the ticket we just acquired.
+                return;
+            }
+
             try {
 #ifndef __linux__  // TODO: consider making this ifdef _WIN32
                 boost::thread thr( boost::bind( &pms::threadRun , p ) );
@@ -188,6 +273,7 @@ namespace mongo {
         }
 
         void run() {
+            pms::prewarmHandlerPool();
             initAndListen();
         }
 
@@ -196,6 +282,10 @@ namespace mongo {
 
 
     MessageServer * createServer( const MessageServer::Options& opts , MessageHandler * handler ) {
+#if defined(__linux__)
+        if ( opts.eventLoop )
+            return createEPollServer( opts , handler );
+#endif
         return new PortMessageServer( opts , handler );
     }
 
@@ -52,8 +52,13 @@ namespace mongo {
         static string urlDecode(const char* s);
         static string urlDecode(string s) {return urlDecode(s.c_str());}
 
+    protected:
+        /** reads one request, calls doRequest() and sends the response.  runs
+            on the listener thread unless a subclass's override dispatches it
+            elsewhere (see DbWebServer). */
+        virtual void accepted(Socket socket);
+
     private:
-        void accepted(Socket socket);
         static bool fullReceive( const char *buf );
     };
 
@@ -19,6 +19,7 @@
 #include "sock.h"
 #include "../background.h"
 #include "../concurrency/value.h"
+#include "../concurrency/sharded_counter.h"
 #include "../mongoutils/str.h"
 
 #if !defined(_WIN32)
@@ -52,6 +53,39 @@ namespace mongo {
     void enableIPv6(bool state) { ipv6 = state; }
     bool IPv6Enabled() { return ipv6; }
     
+    // ------ per connection class tuning and counters ------
+
+    namespace {
+        struct ConnClassTuning {
+            const char * name;
+            int bufferBytes;    // SO_RCVBUF/SO_SNDBUF; 0 = leave the kernel default
+        };
+        const ConnClassTuning connClassTuning[ ConnClass_Count ] = {
+            { "client"    , 0 },                // kernel defaults suit the LAN
+            { "repl"      , 4 * 1024 * 1024 },  // cross-DC: cover a high BDP
+            { "config"    , 0 },
+            { "migration" , 4 * 1024 * 1024 },  // bulk chunk copies
+        };
+
+        struct ConnClassStats {
+            ShardedCounter64 bytesIn;
+            ShardedCounter64 bytesOut;
+            ShardedCounter64 retransmits;
+        } connClassStats[ ConnClass_Count ];
+    }
+
+    const char * connectionClassName( ConnectionClass cls ) {
+        return connClassTuning[ cls ].name;
+    }
+
+    ConnectionClassCounts getConnectionClassCounts( ConnectionClass cls ) {
+        ConnectionClassCounts c;
+        c.bytesIn = connClassStats[ cls ].bytesIn.get();
+        c.bytesOut = connClassStats[ cls ].bytesOut.get();
+        c.retransmits = connClassStats[ cls ].retransmits.get();
+        return c;
+    }
+
     void setSockTimeouts(int sock, double secs) {
         struct timeval tv;
         tv.tv_sec = (int)secs;
@@ -441,12 +475,37 @@ namespace mongo {
     void Socket::_init() {
         _bytesOut = 0;
         _bytesIn = 0;
+        _connClass = ConnClass_Client;
 #ifdef MONGO_SSL
         _sslAccepted = 0;
 #endif
     }
 
+    void Socket::setConnectionClass( ConnectionClass cls ) {
+        _connClass = cls;
+        if ( _fd < 0 || _remote.getType() == AF_UNIX )
+            return;
+        int bytes = connClassTuning[ cls ].bufferBytes;
+        if ( bytes == 0 )
+            return;
+        if ( setsockopt( _fd, SOL_SOCKET, SO_RCVBUF, (char *) &bytes, sizeof(bytes) ) )
+            log(_logLevel) << "can't set SO_RCVBUF for " << connectionClassName(cls)
+                           << " connection: " << errnoWithDescription() << endl;
+        if ( setsockopt( _fd, SOL_SOCKET, SO_SNDBUF, (char *) &bytes, sizeof(bytes) ) )
+            log(_logLevel) << "can't set SO_SNDBUF for " << connectionClassName(cls)
+                           << " connection: " << errnoWithDescription() << endl;
+    }
+
     void Socket::close() {
+#if defined(__linux__) && defined(TCP_INFO)
+        // fold this connection's lifetime retransmits into its class's total
+        if ( _fd >= 0 && _remote.getType() != AF_UNIX ) {
+            struct tcp_info ti;
+            socklen_t len = sizeof(ti);
+            if ( getsockopt( _fd, IPPROTO_TCP, TCP_INFO, (char *) &ti, &len ) == 0 )
+                connClassStats[ _connClass ].retransmits.increment( ti.tcpi_total_retrans );
+        }
+#endif
 #ifdef MONGO_SSL
         _ssl.reset();
 #endif
@@ -595,6 +654,7 @@ namespace mongo {
             }
             else {
                 _bytesOut += ret;
+                connClassStats[ _connClass ].bytesOut.increment( ret );
 
                 assert( ret <= len );
                 len -= ret;
@@ -635,6 +695,7 @@ namespace mongo {
                 d[ i ].iov_len = j->second;
                 ++i;
                 _bytesOut += j->second;
+                connClassStats[ _connClass ].bytesOut.increment( j->second );
             }
         }
         struct msghdr meta;
@@ -721,7 +782,10 @@ namespace mongo {
 
     int Socket::unsafe_recv( char *buf, int max ) {
         int x = _recv( buf , max );
-        _bytesIn += x;
+        if ( x > 0 ) {
+            _bytesIn += x;
+            connClassStats[ _connClass ].bytesIn.increment( x );
+        }
         return x;
     }
 
@@ -173,6 +173,28 @@ namespace mongo {
     };
 #endif
 
+    /** what a socket is used for.  picks that class's tcp tuning (buffer
+        sizes) and buckets traffic totals for serverStatus -- replication links
+        are often cross-DC and want windows sized for a high
+        bandwidth-delay-product, while client links are usually same-LAN. */
+    enum ConnectionClass {
+        ConnClass_Client = 0,   // app connections; also the default
+        ConnClass_Repl,         // replication links
+        ConnClass_Config,       // config server traffic
+        ConnClass_Migration,    // chunk migration bulk copies
+        ConnClass_Count
+    };
+
+    const char * connectionClassName( ConnectionClass cls );
+
+    /** running totals for one class; see NetworkCounter::append */
+    struct ConnectionClassCounts {
+        long long bytesIn;
+        long long bytesOut;
+        long long retransmits;  // linux only (TCP_INFO, sampled at close); 0 elsewhere
+    };
+    ConnectionClassCounts getConnectionClassCounts( ConnectionClass cls );
+
     /**
      * thin wrapped around file descriptor and system calls
      * todo: ssl
@@ -202,6 +224,9 @@ namespace mongo {
         int getLogLevel() const { return _logLevel; }
         void setLogLevel( int ll ) { _logLevel = ll; }
 
+        /** file descriptor for registering with poll/epoll; don't read or write it directly */
+        int rawFD() const { return _fd; }
+
         SockAddr remoteAddr() const { return _remote; }
         string remoteString() const { return _remote.toString(); }
         unsigned remotePort() const { return _remote.getPort(); }
@@ -212,6 +237,12 @@ namespace mongo {
         
         void setTimeout( double secs );
 
+        /** tags this socket with the role it serves and applies that class's
+            tcp tuning.  call right after connect/accept; buffer sizes set
+            later have less effect on the advertised window. */
+        void setConnectionClass( ConnectionClass cls );
+        ConnectionClass connectionClass() const { return _connClass; }
+
         bool stillConnected();
 
 #ifdef MONGO_SSL
@@ -247,6 +278,8 @@ namespace mongo {
         long long _bytesIn;
         long long _bytesOut;
 
+        ConnectionClass _connClass;
+
 #ifdef MONGO_SSL
         shared_ptr<SSL> _ssl;
         SSLManager * _sslAccepted;
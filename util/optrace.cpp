@@ -0,0 +1,68 @@
+// @file optrace.cpp
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pch.h"
+
+#include "../db/nonce.h"
+
+#include "optrace.h"
+#include "time_support.h"
+
+namespace mongo {
+
+    unsigned OpTraceRing::sample() {
+        static AtomicUInt counter;
+        if ( ( counter++ % (unsigned) SampleRate ) != 0 )
+            return 0;
+
+        unsigned id = (unsigned)( Security::getNonce() & 0xffff );
+        if ( id == 0 )
+            id = 1;
+        return id;
+    }
+
+    void OpTraceRing::record( unsigned traceId , const char* span , unsigned long long micros , const string& detail ) {
+        assert( traceId );
+        scoped_lock lk( _lock );
+        Entry& e = _entries[ _next++ % (unsigned) Size ];
+        e.traceId = traceId;
+        e.when = curTimeMillis64();
+        e.micros = micros;
+        e.span = span;
+        e.detail = detail;
+    }
+
+    void OpTraceRing::appendTrace( unsigned traceId , BSONArrayBuilder& b ) const {
+        scoped_lock lk( _lock );
+        for ( unsigned i = 0; i < (unsigned) Size; i++ ) {
+            const Entry& e = _entries[ ( _next + i ) % (unsigned) Size ];
+            if ( e.traceId != traceId )
+                continue;
+            BSONObjBuilder eb( b.subobjStart() );
+            eb.appendDate( "when" , e.when );
+            eb.append( "span" , e.span );
+            eb.appendNumber( "micros" , (long long) e.micros );
+            if ( ! e.detail.empty() )
+                eb.append( "detail" , e.detail );
+            eb.done();
+        }
+    }
+
+    OpTraceRing opTraceRing;
+
+}  // namespace mongo
@@ -0,0 +1,69 @@
+// @file optrace.h sampled operation tracing across mongos and shards
+
+/**
+*    Copyright (C) 2011 10gen Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "../pch.h"
+#include "../db/jsobj.h"
+
+namespace mongo {
+
+    /**
+     * Small sampled tracing facility. mongos tags roughly 1 in SampleRate operations
+     * with a random 16 bit trace id, carried to the shards in the high bits of the
+     * reserved field of write and getMore messages (see DbMessage::ReservedOptions).
+     * Each node records its timing spans for tagged operations in a fixed ring buffer,
+     * and the getTrace command reads a node's buffer back, so one slow operation's
+     * spans can be stitched together across mongos and the shards by id.
+     */
+    class OpTraceRing : boost::noncopyable {
+    public:
+        enum { Size = 4096 , SampleRate = 256 };
+
+        OpTraceRing() : _lock( "OpTraceRing" ) , _next( 0 ) {}
+
+        /** @return a new nonzero trace id for roughly 1 in SampleRate calls, 0 otherwise */
+        static unsigned sample();
+
+        /**
+         * records one timing span of a tagged operation
+         * @param span a description of what was timed; must be a static string
+         */
+        void record( unsigned traceId , const char* span , unsigned long long micros , const string& detail );
+
+        /** appends this node's buffered spans for 'traceId' to 'b', oldest first */
+        void appendTrace( unsigned traceId , BSONArrayBuilder& b ) const;
+
+    private:
+        struct Entry {
+            Entry() : traceId( 0 ) , when( 0 ) , micros( 0 ) , span( "" ) {}
+            unsigned traceId;        // 0 means the slot was never used
+            unsigned long long when; // wall clock millis when recorded
+            unsigned long long micros;
+            const char* span;
+            string detail;
+        };
+
+        mutable mongo::mutex _lock; // only taken for sampled operations
+        Entry _entries[Size];
+        unsigned _next;
+    };
+
+    extern OpTraceRing opTraceRing;
+
+}  // namespace mongo
@@ -56,6 +56,13 @@ namespace mongo {
         static bool blockCheckSupported();
         static bool blockInMemory( char * start );
 
+        /**
+         * @return number of pages of [start,start+length) resident in memory,
+         *         or -1 if that can't be determined on this platform.
+         *         start is rounded down to a page boundary.
+         */
+        static int pagesInMemory( char * start , size_t length );
+
     private:
         pid_t _pid;
     };
@@ -16,6 +16,7 @@
  */
 
 #include "processinfo.h"
+#include "mmap.h"
 
 #include <iostream>
 #include <stdio.h>
@@ -219,6 +220,10 @@ namespace mongo {
 
         LinuxProc p(_pid);
         info.append("page_faults", (int)p._maj_flt);
+
+        // memory mapping modes in effect (see --hugePages / --numaInterleave)
+        info.append("hugePagesHint", mapHugePagesHint);
+        info.append("numaInterleave", numaInterleaved);
     }
 
     bool ProcessInfo::blockCheckSupported() {
@@ -239,5 +244,24 @@ namespace mongo {
         return x & 0x1;
     }
 
+    int ProcessInfo::pagesInMemory( char * start , size_t length ) {
+        static long pageSize = 0;
+        if ( pageSize == 0 ) {
+            pageSize = sysconf( _SC_PAGESIZE );
+        }
+        char * aligned = start - ( (unsigned long long)start % pageSize );
+        length += start - aligned;
+        size_t pages = ( length + pageSize - 1 ) / pageSize;
+        scoped_array<unsigned char> vec( new unsigned char[pages] );
+        if ( mincore( aligned , length , vec.get() ) ) {
+            log() << "mincore failed: " << errnoWithDescription() << endl;
+            return -1;
+        }
+        int n = 0;
+        for ( size_t i = 0; i < pages; i++ )
+            if ( vec[i] & 0x1 )
+                n++;
+        return n;
+    }
 
 }
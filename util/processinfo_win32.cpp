@@ -81,4 +81,8 @@ namespace mongo {
         return true;
     }
 
+    int ProcessInfo::pagesInMemory( char * start , size_t length ) {
+        return -1;
+    }
+
 }